@@ -0,0 +1,1449 @@
+// AssetPacker
+// Command line tool for cooking loose asset files into a .pak archive (see AssetArchive.h)
+//
+//   AssetPacker pack <output.pak> <directory> [--chunk-size <KB>] [--threads <N>]
+//       Packs every file under directory. Names are stored relative to it with forward slashes.
+//   AssetPacker list <archive.pak>
+//   AssetPacker bench <archive.pak> [--threads <N>] [--iterations <N>] [--source <directory>]
+//       Decompresses the whole archive into a staging buffer laid out the same way the
+//       upload ring would be, and reports MB/s of decompressed data. With --source, checks the
+//       decompressed files byte for byte against the directory that was packed. Returns 1 if they differ.
+//   AssetPacker readbench <file> [--queue-depth <N>] [--read-size <KB>]
+//       Reads the whole file through the AsyncFileQueue and reports the bandwidth and queue depth achieved,
+//       then checks the bytes against a plain read of the file. Returns 1 if a read failed or the bytes differ.
+//   AssetPacker bcbench [--size <N>] [--threads <N>]
+//       Generates the mip chain of a synthetic NxN texture, encodes it in every BCn format and quality,
+//       and reports megapixels per second (total and per thread) and the PSNR of the decoded top mip.
+//   AssetPacker meshlets <input.obj> <output.meshlets> [--max-vertices <N>] [--max-primitives <N>]
+//       Cuts the triangles of an .obj into meshlets (see Meshlet.h), front faces clockwise.
+//   AssetPacker meshletbench [--size <N>] [--iterations <N>] [--threads <N>]
+//       Builds the meshlets of an NxN segment sphere and reports triangles per second (one mesh at a time, then
+//       one per thread), then checks the result: every triangle once, the limits, the bounds, conservative cone and
+//       frustum culling from cameras all around, and a .meshlets round trip. Returns 1 if any check fails.
+//   AssetPacker meshopt <input.obj>... [--output <directory>] [--threads <N>]
+//       Reorders each mesh's triangles for the vertex cache and overdraw and its vertices for fetch (see MeshOptimizer.h),
+//       the meshes in parallel, and reports ACMR, ATVR and overdraw before and after. --output writes the results there.
+//   AssetPacker meshoptbench [--size <N>] [--meshes <N>] [--threads <N>]
+//       Optimizes a batch of shuffled tori serially and in parallel, reports triangles per second and the stats after
+//       each pass, and checks the triangles and their winding survive, the parallel result is the same and the ACMR
+//       drops. Returns 1 if any check fails.
+//   AssetPacker vertexbench [--vertices <N>] [--iterations <N>]
+//       Packs random vertices into the compressed format of VertexPacker.h and back, reports the bytes per vertex
+//       saved and vertices per second each way, and checks every attribute stays within its error bound and the SSE2
+//       kernels match the scalar code bit for bit. Returns 1 if any check fails.
+//   AssetPacker mipcheck [--threads <N>]
+//       Generates the mip chains of small odd and non power of two textures (5x3, 7x1, ...), UNORM and sRGB, and checks
+//       the level sizes and every texel against an area weighted box filter done in double, then that CompareMipLevel
+//       honours the row pitch and finds a changed byte. Returns 1 if any check fails.
+//
+// Only uses the STL plus the archive code, so it builds on Windows and Linux alike, e.g.
+//   g++ -std=c++17 -O2 -pthread -I../DirectX12Intro AssetPacker.cpp ../DirectX12Intro/AssetArchive.cpp
+//       ../DirectX12Intro/AsyncFileQueue.cpp ../DirectX12Intro/BCEncoder.cpp ../DirectX12Intro/LZ.cpp ../DirectX12Intro/MipChain.cpp ../DirectX12Intro/ThreadPool.cpp
+//       ../DirectX12Intro/Meshlet.cpp ../DirectX12Intro/MeshOptimizer.cpp ../DirectX12Intro/VertexPacker.cpp -o AssetPacker
+
+#include "AssetArchive.h"
+#include "AsyncFileQueue.h"
+#include "BCEncoder.h"
+#include "Meshlet.h"
+#include "MeshOptimizer.h"
+#include "MipChain.h"
+#include "ThreadPool.h"
+#include "VertexPacker.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    void PrintUsage()
+    {
+        std::printf(
+            "Usage:\n"
+            "  AssetPacker pack <output.pak> <directory> [--chunk-size <KB>] [--threads <N>]\n"
+            "  AssetPacker list <archive.pak>\n"
+            "  AssetPacker bench <archive.pak> [--threads <N>] [--iterations <N>] [--source <directory>]\n"
+            "  AssetPacker readbench <file> [--queue-depth <N>] [--read-size <KB>]\n"
+            "  AssetPacker bcbench [--size <N>] [--threads <N>]\n"
+            "  AssetPacker meshlets <input.obj> <output.meshlets> [--max-vertices <N>] [--max-primitives <N>]\n"
+            "  AssetPacker meshletbench [--size <N>] [--iterations <N>] [--threads <N>]\n"
+            "  AssetPacker meshopt <input.obj>... [--output <directory>] [--threads <N>]\n"
+            "  AssetPacker meshoptbench [--size <N>] [--meshes <N>] [--threads <N>]\n"
+            "  AssetPacker vertexbench [--vertices <N>] [--iterations <N>]\n"
+            "  AssetPacker mipcheck [--threads <N>]\n");
+    }
+
+    // Finds "--name <value>" among the optional arguments
+    uint32_t GetOption(int argc, char** argv, int first, const char* name, uint32_t defaultValue)
+    {
+        for (int i = first; i + 1 < argc; ++i)
+        {
+            if (std::strcmp(argv[i], name) == 0)
+            {
+                return static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+            }
+        }
+        return defaultValue;
+    }
+
+    // One line of a self check, returns ok
+    bool Check(const char* name, bool ok, const std::string& detail = std::string())
+    {
+        std::printf("  %-40s : %s%s%s\n", name, ok ? "ok" : "FAILED", detail.empty() ? "" : ", ", detail.c_str());
+        return ok;
+    }
+
+    std::vector<uint8_t> ReadFile(const fs::path& path)
+    {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in)
+        {
+            throw std::runtime_error("Failed to open " + path.string());
+        }
+
+        std::vector<uint8_t> data(static_cast<size_t>(in.tellg()));
+        in.seekg(0);
+        in.read(reinterpret_cast<char*>(data.data()), data.size());
+        return data;
+    }
+
+    int Pack(int argc, char** argv)
+    {
+        const char* output = argv[2];
+        fs::path root = argv[3];
+        uint32_t chunkSize = GetOption(argc, argv, 4, "--chunk-size", PACK_DEFAULT_CHUNK_SIZE / 1024) * 1024;
+        ThreadPool pool(GetOption(argc, argv, 4, "--threads", 0));
+
+        PackBuilder builder(chunkSize);
+        uint64_t totalSize = 0;
+        uint32_t numFiles = 0;
+        for (const fs::directory_entry& file : fs::recursive_directory_iterator(root))
+        {
+            if (!file.is_regular_file())
+            {
+                continue;
+            }
+
+            std::vector<uint8_t> data = ReadFile(file.path());
+            totalSize += data.size();
+            ++numFiles;
+            builder.AddFile(file.path().lexically_relative(root).generic_string(), std::move(data));
+        }
+
+        builder.Write(output, &pool);
+
+        uint64_t archiveSize = fs::file_size(output);
+        std::printf("Packed %u files, %.2f MB -> %.2f MB (%.1f%%)\n", numFiles,
+            totalSize / (1024.0 * 1024.0), archiveSize / (1024.0 * 1024.0),
+            totalSize > 0 ? 100.0 * archiveSize / totalSize : 100.0);
+        return 0;
+    }
+
+    int List(char** argv)
+    {
+        AssetArchive archive;
+        archive.Open(argv[2]);
+
+        for (uint32_t i = 0; i < archive.GetNumEntries(); ++i)
+        {
+            const PackEntry& entry = archive.GetEntry(i);
+            std::printf("%12llu  %4u chunks  %s\n", static_cast<unsigned long long>(entry.Size),
+                entry.NumChunks, archive.GetName(entry).c_str());
+        }
+        return 0;
+    }
+
+    int Bench(int argc, char** argv)
+    {
+        AssetArchive archive;
+        archive.Open(argv[2]);
+        ThreadPool pool(GetOption(argc, argv, 3, "--threads", 0));
+        uint32_t iterations = std::max(1u, GetOption(argc, argv, 3, "--iterations", 10));
+
+        // Lay every file out back to back like consecutive upload ring allocations
+        std::vector<PackRead> reads;
+        uint64_t stagingSize = 0;
+        uint64_t totalSize = 0;
+        for (uint32_t i = 0; i < archive.GetNumEntries(); ++i)
+        {
+            const PackEntry& entry = archive.GetEntry(i);
+            reads.push_back({ &entry, reinterpret_cast<void*>(static_cast<uintptr_t>(stagingSize)) });
+            stagingSize += archive.GetStagingSize(entry);
+            totalSize += entry.Size;
+        }
+
+        // Over allocate so the base can be aligned like upload heap memory
+        std::unique_ptr<uint8_t[]> staging(new uint8_t[stagingSize + archive.GetAlignment()]);
+        uintptr_t base = (reinterpret_cast<uintptr_t>(staging.get()) + archive.GetAlignment() - 1) & ~uintptr_t(archive.GetAlignment() - 1);
+        for (PackRead& read : reads)
+        {
+            read.Destination = reinterpret_cast<void*>(base + reinterpret_cast<uintptr_t>(read.Destination));
+        }
+
+        // Warm up, which also faults the archive pages in so we measure decompression rather than the disk
+        archive.Decompress(reads, &pool);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            archive.Decompress(reads, &pool);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        double megabytes = totalSize * double(iterations) / (1024.0 * 1024.0);
+        std::printf("%u files, %.2f MB, %u threads: %.1f MB/s decompressed into staging\n",
+            archive.GetNumEntries(), totalSize / (1024.0 * 1024.0), pool.GetThreadCount(),
+            megabytes / elapsed.count());
+
+        // What the last pass left in staging has to be the files that went in
+        fs::path source;
+        for (int i = 3; i + 1 < argc; ++i)
+        {
+            if (std::strcmp(argv[i], "--source") == 0)
+            {
+                source = argv[i + 1];
+            }
+        }
+        if (source.empty())
+        {
+            return 0;
+        }
+
+        uint32_t mismatched = 0;
+        for (const PackRead& read : reads)
+        {
+            std::string name = archive.GetName(*read.Entry);
+            std::vector<uint8_t> expected = ReadFile(source / name);
+            if (expected.size() != read.Entry->Size || std::memcmp(expected.data(), read.Destination, expected.size()) != 0)
+            {
+                std::printf("  %s doesn't match the source\n", name.c_str());
+                ++mismatched;
+            }
+        }
+
+        uint32_t numSourceFiles = 0;
+        for (const fs::directory_entry& file : fs::recursive_directory_iterator(source))
+        {
+            numSourceFiles += file.is_regular_file() ? 1 : 0;
+        }
+
+        bool passed = Check("decompressed files match the source", mismatched == 0, std::to_string(mismatched) + " mismatched");
+        passed &= Check("every source file is in the archive", numSourceFiles == archive.GetNumEntries(),
+            std::to_string(numSourceFiles) + " source files");
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    int ReadBench(int argc, char** argv)
+    {
+        AsyncFileQueue queue(GetOption(argc, argv, 3, "--queue-depth", 8));
+        uint64_t readSize = std::max(1u, GetOption(argc, argv, 3, "--read-size", 256)) * 1024ull;
+
+        uint32_t file = queue.OpenFile(argv[2]);
+        uint64_t fileSize = queue.GetFileSize(file);
+        std::unique_ptr<uint8_t[]> staging(new uint8_t[fileSize]);
+
+        // Queue the reads back to front, Submit is expected to put them in order again. The front half goes in a
+        // second batch submitted while the first is in flight, which has to start without waiting for a completion.
+        uint32_t failed = 0;
+        uint64_t end = (fileSize + readSize - 1) / readSize * readSize;
+        for (uint64_t offset = end; offset > 0;)
+        {
+            offset -= readSize;
+            queue.Read(file, offset, std::min(readSize, fileSize - offset), staging.get() + offset,
+                [&failed](bool success) { failed += success ? 0 : 1; });
+            if (offset == end / readSize / 2 * readSize)
+            {
+                queue.Submit();
+            }
+        }
+        queue.Submit();
+        queue.WaitIdle();
+
+        AsyncIOStats stats = queue.GetStats();
+        std::printf("%.2f MB in %llu reads (%u failed): %.1f MB/s, queue depth %.1f average, %u max\n",
+            stats.BytesRead / (1024.0 * 1024.0), static_cast<unsigned long long>(stats.NumReads), failed,
+            stats.BandwidthMBps, stats.AverageQueueDepth, stats.MaxQueueDepth);
+
+        // The same bytes as a plain blocking read of the file
+        std::vector<uint8_t> expected = ReadFile(argv[2]);
+        bool passed = Check("every read succeeded", failed == 0, std::to_string(failed) + " failed");
+        passed &= Check("bytes match the file", expected.size() == fileSize &&
+            std::memcmp(expected.data(), staging.get(), expected.size()) == 0);
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    // Smooth gradients, hard edges and a bit of noise, so every encoder path gets exercised
+    std::vector<uint8_t> MakeTestImage(uint32_t size)
+    {
+        std::vector<uint8_t> pixels(size_t(size) * size * 4);
+        uint32_t noise = 12345;
+        for (uint32_t y = 0; y < size; ++y)
+        {
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                noise = noise * 1664525u + 1013904223u;
+                uint8_t* pixel = &pixels[(size_t(y) * size + x) * 4];
+                bool checker = ((x / 64) + (y / 64)) % 2 == 0;
+                pixel[0] = static_cast<uint8_t>(std::min(255u, x * 240 / size + (noise >> 28)));
+                pixel[1] = static_cast<uint8_t>(checker ? y * 255 / size : 255 - y * 255 / size) ^ ((noise >> 20) & 7);
+                pixel[2] = static_cast<uint8_t>(std::min(255u, (x ^ y) % 256 / 2 + (noise >> 28)));
+                pixel[3] = static_cast<uint8_t>(checker ? 255 : (x + y) * 255 / (2 * size));
+            }
+        }
+        return pixels;
+    }
+
+    // Blocks built by hand from the D3D format rules, with endpoints picked so every interpolated value is exact and
+    // doesn't depend on how a decoder rounds. Texel i decodes to Expected[i % NumExpected].
+    bool CheckBCReferenceBlocks()
+    {
+        const struct
+        {
+            const char* Name;
+            BCFormat Format;
+            uint8_t Block[16];
+            uint32_t NumExpected;
+            uint8_t Expected[16][4];
+        } cases[] =
+        {
+            // c0 = white > c1 = black: 4 colors, 2/3 and 1/3 of the way
+            { "BC1 4 color block", BCFormat::BC1, { 0xFF, 0xFF, 0x00, 0x00, 0xE4, 0xE4, 0xE4, 0xE4 }, 4,
+                { { 255, 255, 255, 255 }, { 0, 0, 0, 255 }, { 170, 170, 170, 255 }, { 85, 85, 85, 255 } } },
+            // c0 = black <= c1 = red 16 (132): 3 colors and transparent black
+            { "BC1 3 color block", BCFormat::BC1, { 0x00, 0x00, 0x00, 0x80, 0xE4, 0xE4, 0xE4, 0xE4 }, 4,
+                { { 0, 0, 0, 255 }, { 132, 0, 0, 255 }, { 66, 0, 0, 255 }, { 0, 0, 0, 0 } } },
+            // Alpha 210 > 0: 8 values. The color half has c0 <= c1 but BC3 always uses 4 colors.
+            { "BC3 block", BCFormat::BC3, { 0xD2, 0x00, 0x88, 0xC6, 0xFA, 0x88, 0xC6, 0xFA, 0x00, 0x00, 0xFF, 0xFF, 0xE4, 0xE4, 0xE4, 0xE4 }, 8,
+                { { 0, 0, 0, 210 }, { 255, 255, 255, 0 }, { 85, 85, 85, 180 }, { 170, 170, 170, 150 },
+                  { 0, 0, 0, 120 }, { 255, 255, 255, 90 }, { 85, 85, 85, 60 }, { 170, 170, 170, 30 } } },
+            // 0 <= 200: 6 values plus 0 and 255
+            { "BC4 block", BCFormat::BC4, { 0x00, 0xC8, 0x88, 0xC6, 0xFA, 0x88, 0xC6, 0xFA }, 8,
+                { { 0, 0, 0, 255 }, { 200, 0, 0, 255 }, { 40, 0, 0, 255 }, { 80, 0, 0, 255 },
+                  { 120, 0, 0, 255 }, { 160, 0, 0, 255 }, { 0, 0, 0, 255 }, { 255, 0, 0, 255 } } },
+            // Red in the 8 value mode, green in the 6 value one
+            { "BC5 block", BCFormat::BC5, { 0xD2, 0x00, 0x88, 0xC6, 0xFA, 0x88, 0xC6, 0xFA, 0x00, 0xC8, 0x88, 0xC6, 0xFA, 0x88, 0xC6, 0xFA }, 8,
+                { { 210, 0, 0, 255 }, { 0, 200, 0, 255 }, { 180, 40, 0, 255 }, { 150, 80, 0, 255 },
+                  { 120, 120, 0, 255 }, { 90, 160, 0, 255 }, { 60, 0, 0, 255 }, { 30, 255, 0, 255 } } },
+            // Mode 6, endpoints (0, 127, 10, 127) p 0 and (127, 0, 100, 127) p 1, texel i uses index i
+            { "BC7 mode 6 block", BCFormat::BC7, { 0x40, 0xC0, 0xFF, 0x0F, 0x50, 0x90, 0xFF, 0x7F, 0x11, 0x32, 0x54, 0x76, 0x98, 0xBA, 0xDC, 0xFE }, 16,
+                { { 0, 254, 20, 254 }, { 16, 238, 31, 254 }, { 36, 218, 45, 254 }, { 52, 203, 57, 254 },
+                  { 68, 187, 68, 254 }, { 84, 171, 79, 254 }, { 104, 151, 94, 254 }, { 120, 135, 105, 254 },
+                  { 135, 120, 116, 255 }, { 151, 104, 127, 255 }, { 171, 84, 142, 255 }, { 187, 68, 153, 255 },
+                  { 203, 52, 164, 255 }, { 219, 37, 176, 255 }, { 239, 17, 190, 255 }, { 255, 1, 201, 255 } } },
+        };
+
+        bool passed = true;
+        for (const auto& test : cases)
+        {
+            uint8_t pixels[64];
+            DecodeBCBlock(test.Format, test.Block, pixels);
+
+            uint32_t wrong = 0;
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                wrong += std::memcmp(pixels + i * 4, test.Expected[i % test.NumExpected], 4) != 0 ? 1 : 0;
+            }
+            passed &= Check((std::string(test.Name) + " matches the spec").c_str(), wrong == 0,
+                std::to_string(wrong) + " wrong texels");
+        }
+        return passed;
+    }
+
+    int BCBench(int argc, char** argv)
+    {
+        uint32_t size = std::max(4u, GetOption(argc, argv, 2, "--size", 1024));
+        ThreadPool pool(GetOption(argc, argv, 2, "--threads", 0));
+
+        std::vector<uint8_t> image = MakeTestImage(size);
+
+        auto mipStart = std::chrono::high_resolution_clock::now();
+        std::vector<MipLevel> chain = GenerateMipChain(image.data(), size, size, size * 4, true, &pool);
+        std::chrono::duration<double> mipElapsed = std::chrono::high_resolution_clock::now() - mipStart;
+
+        std::vector<BCSurface> mips;
+        double megapixels = 0.0;
+        for (const MipLevel& level : chain)
+        {
+            mips.push_back({ level.Pixels.data(), level.Width, level.Height, level.Width * 4 });
+            megapixels += double(level.Width) * level.Height / 1e6;
+        }
+
+        const struct
+        {
+            BCFormat Format;
+            const char* Name;
+        } formats[] = { { BCFormat::BC1, "BC1" }, { BCFormat::BC3, "BC3" }, { BCFormat::BC4, "BC4" }, { BCFormat::BC5, "BC5" }, { BCFormat::BC7, "BC7" } };
+        const struct
+        {
+            BCQuality Quality;
+            const char* Name;
+        } qualities[] = { { BCQuality::Fast, "fast" }, { BCQuality::Normal, "normal" }, { BCQuality::High, "high" } };
+
+        // PSNR floors of each preset on the test image, about 1.5 dB under what 256x256 gets. Smaller images are mostly
+        // hard edges and noise, so only the ordering of the presets is checked there.
+        const double psnrFloors[5][3] = { { 37.0, 38.5, 38.5 }, { 38.5, 39.5, 39.5 }, { 50.0, 50.5, 50.5 },
+            { 51.0, 52.0, 52.0 }, { 40.5, 42.0, 42.0 } };
+        bool checkFloors = size >= 256;
+
+        std::printf("%ux%u, %zu mips, %u threads, sRGB mip chain generated in %.2f ms\n",
+            size, size, chain.size(), pool.GetThreadCount(), mipElapsed.count() * 1000.0);
+        bool passed = true;
+        for (size_t f = 0; f < std::size(formats); ++f)
+        {
+            const auto& format = formats[f];
+            double psnr[3] = {};
+            for (size_t q = 0; q < std::size(qualities); ++q)
+            {
+                const auto& quality = qualities[q];
+                auto start = std::chrono::high_resolution_clock::now();
+                std::vector<std::vector<uint8_t>> encoded = EncodeBC(format.Format, quality.Quality, mips, &pool);
+                std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+                std::vector<uint8_t> decoded = DecodeBC(format.Format, encoded[0].data(), size, size);
+                psnr[q] = ComputeBCPSNR(format.Format, mips[0], decoded.data());
+                std::printf("  %s %-6s : %8.2f MP/s (%7.2f MP/s per thread), PSNR %.2f dB\n", format.Name, quality.Name,
+                    megapixels / elapsed.count(), megapixels / elapsed.count() / pool.GetThreadCount(), psnr[q]);
+                if (checkFloors)
+                {
+                    char detail[64];
+                    std::snprintf(detail, sizeof(detail), "%.2f dB, floor %.1f dB", psnr[q], psnrFloors[f][q]);
+                    passed &= Check((std::string(format.Name) + " " + quality.Name + " PSNR above its floor").c_str(),
+                        psnr[q] >= psnrFloors[f][q], detail);
+                }
+            }
+
+            char detail[64];
+            std::snprintf(detail, sizeof(detail), "%.2f, %.2f, %.2f dB", psnr[0], psnr[1], psnr[2]);
+            passed &= Check((std::string(format.Name) + " PSNR fast <= normal <= high").c_str(),
+                psnr[0] <= psnr[1] && psnr[1] <= psnr[2], detail);
+        }
+
+        passed &= CheckBCReferenceBlocks();
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    // Positions and triangles of an .obj, polygons as fans. Normals, UVs and everything else are ignored.
+    void ReadObj(const fs::path& path, std::vector<float>& positions, std::vector<uint32_t>& indices)
+    {
+        std::ifstream in(path);
+        if (!in)
+        {
+            throw std::runtime_error("Failed to open " + path.string());
+        }
+
+        std::string line;
+        while (std::getline(in, line))
+        {
+            std::istringstream tokens(line);
+            std::string type;
+            tokens >> type;
+            if (type == "v")
+            {
+                float position[3] = {};
+                tokens >> position[0] >> position[1] >> position[2];
+                positions.insert(positions.end(), position, position + 3);
+            }
+            else if (type == "f")
+            {
+                // "f 1 2 3", "f 1/1/1 2/2/2 3/3/3", negative indices count back from the last vertex
+                std::vector<uint32_t> face;
+                std::string vertex;
+                while (tokens >> vertex)
+                {
+                    long index = std::strtol(vertex.c_str(), nullptr, 10);
+                    long numVertices = static_cast<long>(positions.size() / 3);
+                    index = index < 0 ? numVertices + index : index - 1;
+                    if (index < 0 || index >= numVertices)
+                    {
+                        throw std::runtime_error("Bad face in " + path.string() + ": " + line);
+                    }
+                    face.push_back(static_cast<uint32_t>(index));
+                }
+                for (size_t i = 2; i < face.size(); ++i)
+                {
+                    indices.insert(indices.end(), { face[0], face[i - 1], face[i] });
+                }
+            }
+        }
+    }
+
+    int Meshlets(int argc, char** argv)
+    {
+        MeshletSettings settings;
+        settings.MaxVertices = GetOption(argc, argv, 4, "--max-vertices", MESHLET_MAX_VERTICES);
+        settings.MaxPrimitives = GetOption(argc, argv, 4, "--max-primitives", MESHLET_MAX_PRIMITIVES);
+
+        std::vector<float> positions;
+        std::vector<uint32_t> indices;
+        ReadObj(argv[2], positions, indices);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        MeshletMesh mesh = BuildMeshlets(positions.data(), static_cast<uint32_t>(positions.size() / 3), sizeof(float) * 3,
+            indices.data(), static_cast<uint32_t>(indices.size()), settings);
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+        SaveMeshlets(argv[3], mesh);
+
+        std::printf("%zu vertices, %zu triangles -> %zu meshlets (%.1f vertices, %.1f triangles each) in %.2f ms\n",
+            positions.size() / 3, indices.size() / 3, mesh.Meshlets.size(),
+            mesh.Meshlets.empty() ? 0.0 : double(mesh.VertexIndices.size()) / mesh.Meshlets.size(),
+            mesh.Meshlets.empty() ? 0.0 : double(mesh.PrimitiveIndices.size()) / mesh.Meshlets.size(), elapsed.count() * 1000.0);
+        return 0;
+    }
+
+    // A UV sphere of radius 1 with clockwise front faces, rings and segments of it, in row order
+    void MakeTestSphere(uint32_t size, std::vector<float>& positions, std::vector<uint32_t>& indices)
+    {
+        const float PI = 3.14159265f;
+        for (uint32_t ring = 0; ring <= size; ++ring)
+        {
+            float theta = PI * ring / size;
+            for (uint32_t segment = 0; segment <= size; ++segment)
+            {
+                float phi = 2.0f * PI * segment / size;
+                positions.insert(positions.end(), { std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) });
+            }
+        }
+        for (uint32_t ring = 0; ring < size; ++ring)
+        {
+            for (uint32_t segment = 0; segment < size; ++segment)
+            {
+                uint32_t v0 = ring * (size + 1) + segment;
+                uint32_t v1 = v0 + size + 1;
+                indices.insert(indices.end(), { v0, v0 + 1, v1, v0 + 1, v1 + 1, v1 }); // the poles' zero area triangles included
+            }
+        }
+    }
+
+    // Whether every triangle of the meshlet faces away from the camera, by brute force
+    bool IsBackFacing(const MeshletMesh& mesh, const Meshlet& meshlet, const float* camera)
+    {
+        const uint32_t* vertices = &mesh.VertexIndices[meshlet.VertexOffset];
+        for (uint32_t i = 0; i < meshlet.PrimitiveCount; ++i)
+        {
+            uint32_t i0, i1, i2;
+            UnpackMeshletPrimitive(mesh.PrimitiveIndices[meshlet.PrimitiveOffset + i], i0, i1, i2);
+            const float* p0 = &mesh.Positions[vertices[i0] * 3];
+            const float* p1 = &mesh.Positions[vertices[i1] * 3];
+            const float* p2 = &mesh.Positions[vertices[i2] * 3];
+            float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float normal[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+            float toVertex[3] = { p0[0] - camera[0], p0[1] - camera[1], p0[2] - camera[2] };
+            if (normal[0] * toVertex[0] + normal[1] * toVertex[1] + normal[2] * toVertex[2] < -1e-6f)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The culling tests must never throw away a triangle that could be seen
+    bool CheckCulling(const MeshletMesh& mesh, const MeshletCullView& view, uint32_t& numCulled)
+    {
+        bool ok = true;
+        numCulled = 0;
+        for (size_t m = 0; m < mesh.Meshlets.size(); ++m)
+        {
+            if (IsMeshletVisible(mesh.Bounds[m], view))
+            {
+                continue;
+            }
+            ++numCulled;
+
+            const Meshlet& meshlet = mesh.Meshlets[m];
+            const uint32_t* vertices = &mesh.VertexIndices[meshlet.VertexOffset];
+            bool outsidePlane = false;
+            for (const float* plane : view.FrustumPlanes)
+            {
+                bool allOutside = true;
+                for (uint32_t i = 0; i < meshlet.VertexCount; ++i)
+                {
+                    const float* p = &mesh.Positions[vertices[i] * 3];
+                    allOutside &= plane[0] * p[0] + plane[1] * p[1] + plane[2] * p[2] + plane[3] < 0.0f;
+                }
+                outsidePlane |= allOutside;
+            }
+
+            ok &= outsidePlane || IsBackFacing(mesh, meshlet, view.CameraPosition);
+        }
+        return ok;
+    }
+
+    int MeshletBench(int argc, char** argv)
+    {
+        uint32_t size = std::max(4u, GetOption(argc, argv, 2, "--size", 512));
+        uint32_t iterations = std::max(1u, GetOption(argc, argv, 2, "--iterations", 4));
+        ThreadPool pool(GetOption(argc, argv, 2, "--threads", 0));
+
+        std::vector<float> positions;
+        std::vector<uint32_t> indices;
+        MakeTestSphere(size, positions, indices);
+        uint32_t numVertices = static_cast<uint32_t>(positions.size() / 3);
+        uint32_t numTriangles = static_cast<uint32_t>(indices.size() / 3);
+        std::printf("Sphere of %u vertices, %u triangles, %u iterations\n", numVertices, numTriangles, iterations);
+
+        MeshletMesh mesh;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            mesh = BuildMeshlets(positions.data(), numVertices, sizeof(float) * 3, indices.data(), static_cast<uint32_t>(indices.size()));
+        }
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+        double singleRate = numTriangles * double(iterations) / elapsed.count() / 1e6;
+
+        // Meshes are independent, so a level's worth of them is spread across the pool
+        start = std::chrono::high_resolution_clock::now();
+        pool.ParallelFor(iterations * pool.GetThreadCount(), [&](uint32_t)
+        {
+            BuildMeshlets(positions.data(), numVertices, sizeof(float) * 3, indices.data(), static_cast<uint32_t>(indices.size()));
+        });
+        elapsed = std::chrono::high_resolution_clock::now() - start;
+        double poolRate = numTriangles * double(iterations) * pool.GetThreadCount() / elapsed.count() / 1e6;
+
+        std::printf("  %zu meshlets, %.1f vertices and %.1f triangles each, %.2f vertex references per vertex\n",
+            mesh.Meshlets.size(), double(mesh.VertexIndices.size()) / mesh.Meshlets.size(),
+            double(mesh.PrimitiveIndices.size()) / mesh.Meshlets.size(), double(mesh.VertexIndices.size()) / numVertices);
+        std::printf("  %.2f M triangles/s on one thread, %.2f M triangles/s on %u threads\n", singleRate, poolRate, pool.GetThreadCount());
+
+        std::printf("Checks:\n");
+        bool passed = true;
+
+        // Every triangle with an area ends up in exactly one meshlet, within the limits
+        {
+            std::vector<std::array<uint32_t, 3>> expected;
+            for (uint32_t t = 0; t < numTriangles; ++t)
+            {
+                const uint32_t* triangle = &indices[t * 3];
+                if (triangle[0] != triangle[1] && triangle[1] != triangle[2] && triangle[0] != triangle[2])
+                {
+                    // Rotated so the smallest index is first, which keeps the winding
+                    uint32_t first = triangle[0] < triangle[1] ? (triangle[0] < triangle[2] ? 0 : 2) : (triangle[1] < triangle[2] ? 1 : 2);
+                    expected.push_back({ triangle[first], triangle[(first + 1) % 3], triangle[(first + 2) % 3] });
+                }
+            }
+
+            std::vector<std::array<uint32_t, 3>> actual;
+            bool withinLimits = true;
+            bool boundsContain = true;
+            for (size_t m = 0; m < mesh.Meshlets.size(); ++m)
+            {
+                const Meshlet& meshlet = mesh.Meshlets[m];
+                const MeshletBounds& bounds = mesh.Bounds[m];
+                withinLimits &= meshlet.VertexCount <= MESHLET_MAX_VERTICES && meshlet.PrimitiveCount <= MESHLET_MAX_PRIMITIVES;
+                for (uint32_t i = 0; i < meshlet.PrimitiveCount; ++i)
+                {
+                    uint32_t local[3];
+                    UnpackMeshletPrimitive(mesh.PrimitiveIndices[meshlet.PrimitiveOffset + i], local[0], local[1], local[2]);
+                    uint32_t triangle[3];
+                    for (uint32_t k = 0; k < 3; ++k)
+                    {
+                        withinLimits &= local[k] < meshlet.VertexCount;
+                        triangle[k] = mesh.VertexIndices[meshlet.VertexOffset + std::min(local[k], meshlet.VertexCount - 1)];
+
+                        const float* p = &mesh.Positions[triangle[k] * 3];
+                        float d[3] = { p[0] - bounds.Center[0], p[1] - bounds.Center[1], p[2] - bounds.Center[2] };
+                        boundsContain &= std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) <= bounds.Radius * 1.0001f + 1e-6f;
+                    }
+                    uint32_t first = triangle[0] < triangle[1] ? (triangle[0] < triangle[2] ? 0 : 2) : (triangle[1] < triangle[2] ? 1 : 2);
+                    actual.push_back({ triangle[first], triangle[(first + 1) % 3], triangle[(first + 2) % 3] });
+                }
+            }
+            std::sort(expected.begin(), expected.end());
+            std::sort(actual.begin(), actual.end());
+            passed &= Check("every triangle once, same winding", expected == actual,
+                std::to_string(actual.size()) + " of " + std::to_string(expected.size()));
+            passed &= Check("vertex and primitive limits", withinLimits);
+            passed &= Check("bounding spheres", boundsContain);
+        }
+
+        // Cone and frustum culling only drop meshlets that can't be seen, from anywhere around the sphere
+        {
+            std::mt19937 random(1234);
+            std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+            bool ok = true;
+            uint32_t totalCulled = 0;
+            for (uint32_t i = 0; i < 64; ++i)
+            {
+                MeshletCullView view = {};
+                float d[3] = { direction(random), direction(random), direction(random) };
+                float length = std::max(1e-3f, std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]));
+                for (uint32_t c = 0; c < 3; ++c)
+                {
+                    view.CameraPosition[c] = d[c] / length * 3.0f;
+                }
+                for (float* plane : view.FrustumPlanes)
+                {
+                    plane[3] = 1.0f; // everything inside
+                }
+                // Half space through the middle of the sphere, facing a random way
+                float n[3] = { direction(random), direction(random), direction(random) };
+                length = std::max(1e-3f, std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]));
+                for (uint32_t c = 0; c < 3; ++c)
+                {
+                    view.FrustumPlanes[0][c] = n[c] / length;
+                }
+                view.FrustumPlanes[0][3] = 0.0f;
+
+                uint32_t numCulled = 0;
+                ok &= CheckCulling(mesh, view, numCulled);
+                totalCulled += numCulled;
+            }
+            passed &= Check("culling is conservative", ok,
+                std::to_string(100.0 * totalCulled / (64.0 * mesh.Meshlets.size())).substr(0, 4) + "% culled on average");
+
+            // How close the cones get to culling every meshlet that faces away (they're looser the more a meshlet curves)
+            MeshletCullView view = {};
+            view.CameraPosition[2] = -3.0f;
+            for (float* plane : view.FrustumPlanes)
+            {
+                plane[3] = 1.0f;
+            }
+            std::vector<uint32_t> visible;
+            CullMeshlets(mesh, view, visible);
+            uint32_t numBackFacing = 0;
+            for (const Meshlet& meshlet : mesh.Meshlets)
+            {
+                numBackFacing += IsBackFacing(mesh, meshlet, view.CameraPosition) ? 1 : 0;
+            }
+            size_t numCulled = mesh.Meshlets.size() - visible.size();
+            std::printf("  from 3 radii away the cones cull %zu meshlets, %u face away entirely\n", numCulled, numBackFacing);
+        }
+
+        // Through a file and back
+        {
+            fs::path path = fs::temp_directory_path() / "meshletbench.meshlets";
+            SaveMeshlets(path.string(), mesh);
+            MeshletMesh loaded = LoadMeshlets(path.string());
+            bool same = loaded.Positions == mesh.Positions && loaded.VertexIndices == mesh.VertexIndices
+                && loaded.PrimitiveIndices == mesh.PrimitiveIndices && loaded.Meshlets.size() == mesh.Meshlets.size()
+                && std::memcmp(loaded.Meshlets.data(), mesh.Meshlets.data(), mesh.Meshlets.size() * sizeof(Meshlet)) == 0
+                && std::memcmp(loaded.Bounds.data(), mesh.Bounds.data(), mesh.Bounds.size() * sizeof(MeshletBounds)) == 0;
+            passed &= Check(".meshlets round trip", same);
+
+            // A truncated file is refused
+            fs::resize_file(path, fs::file_size(path) - 4);
+            bool refused = false;
+            try
+            {
+                LoadMeshlets(path.string());
+            }
+            catch (const std::exception&)
+            {
+                refused = true;
+            }
+            fs::remove(path);
+            passed &= Check("truncated file refused", refused);
+        }
+
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    void WriteObj(const fs::path& path, const IndexedMesh& mesh)
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            throw std::runtime_error("Failed to open " + path.string() + " for writing");
+        }
+        out.precision(9); // round trips a float
+        for (uint32_t v = 0; v < mesh.GetNumVertices(); ++v)
+        {
+            float position[3];
+            std::memcpy(position, &mesh.Vertices[size_t(v) * mesh.VertexStride], sizeof(position));
+            out << "v " << position[0] << ' ' << position[1] << ' ' << position[2] << '\n';
+        }
+        for (size_t i = 0; i < mesh.Indices.size(); i += 3)
+        {
+            out << "f " << mesh.Indices[i] + 1 << ' ' << mesh.Indices[i + 1] + 1 << ' ' << mesh.Indices[i + 2] + 1 << '\n';
+        }
+        if (!out)
+        {
+            throw std::runtime_error("Failed to write " + path.string());
+        }
+    }
+
+    void PrintMeshStats(const char* label, const IndexedMesh& mesh)
+    {
+        VertexCacheStats cache = AnalyzeVertexCache(mesh.Indices.data(), static_cast<uint32_t>(mesh.Indices.size()), mesh.GetNumVertices());
+        OverdrawStats overdraw = AnalyzeOverdraw(mesh);
+        std::printf("    %-8s ACMR %.3f  ATVR %.3f  overdraw %.3f\n", label, cache.ACMR, cache.ATVR, overdraw.Overdraw);
+    }
+
+    int MeshOpt(int argc, char** argv)
+    {
+        const char* output = nullptr;
+        uint32_t numThreads = 0;
+        std::vector<fs::path> inputs;
+        for (int i = 2; i < argc; ++i)
+        {
+            if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            {
+                output = argv[++i];
+            }
+            else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            {
+                numThreads = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+            }
+            else
+            {
+                inputs.push_back(argv[i]);
+            }
+        }
+
+        std::vector<IndexedMesh> meshes(inputs.size());
+        for (size_t i = 0; i < inputs.size(); ++i)
+        {
+            std::vector<float> positions;
+            ReadObj(inputs[i], positions, meshes[i].Indices);
+            meshes[i].Vertices.resize(positions.size() * sizeof(float));
+            std::memcpy(meshes[i].Vertices.data(), positions.data(), meshes[i].Vertices.size());
+        }
+        std::vector<IndexedMesh> original = meshes;
+
+        ThreadPool pool(numThreads);
+        auto start = std::chrono::high_resolution_clock::now();
+        OptimizeMeshes(meshes, &pool);
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        for (size_t i = 0; i < meshes.size(); ++i)
+        {
+            std::printf("  %s: %u vertices, %zu triangles\n", inputs[i].string().c_str(), original[i].GetNumVertices(), original[i].Indices.size() / 3);
+            PrintMeshStats("before", original[i]);
+            PrintMeshStats("after", meshes[i]);
+            if (output)
+            {
+                fs::create_directories(output);
+                WriteObj(fs::path(output) / inputs[i].filename(), meshes[i]);
+            }
+        }
+        std::printf("Optimized %zu meshes in %.2f ms on %u threads\n", meshes.size(), elapsed.count() * 1000.0, pool.GetThreadCount());
+        return 0;
+    }
+
+    // A torus with a vertex id after each position (to follow vertices through the reordering), triangles shuffled
+    // the way a careless exporter might leave them. Clockwise front faces.
+    IndexedMesh MakeTestTorus(uint32_t size, uint32_t seed)
+    {
+        const float PI = 3.14159265f;
+        IndexedMesh mesh;
+        mesh.VertexStride = sizeof(float) * 3 + sizeof(uint32_t);
+        uint32_t rings = size;
+        uint32_t segments = size / 2 + 3;
+        for (uint32_t ring = 0; ring < rings; ++ring)
+        {
+            float theta = 2.0f * PI * ring / rings;
+            for (uint32_t segment = 0; segment < segments; ++segment)
+            {
+                float phi = 2.0f * PI * segment / segments;
+                float r = 1.0f + 0.4f * std::cos(phi);
+                float position[3] = { r * std::cos(theta), 0.4f * std::sin(phi), r * std::sin(theta) };
+                uint32_t id = ring * segments + segment;
+                size_t offset = mesh.Vertices.size();
+                mesh.Vertices.resize(offset + mesh.VertexStride);
+                std::memcpy(&mesh.Vertices[offset], position, sizeof(position));
+                std::memcpy(&mesh.Vertices[offset + sizeof(position)], &id, sizeof(id));
+            }
+        }
+
+        std::vector<std::array<uint32_t, 3>> triangles;
+        for (uint32_t ring = 0; ring < rings; ++ring)
+        {
+            for (uint32_t segment = 0; segment < segments; ++segment)
+            {
+                uint32_t v00 = ring * segments + segment;
+                uint32_t v01 = ring * segments + (segment + 1) % segments;
+                uint32_t v10 = (ring + 1) % rings * segments + segment;
+                uint32_t v11 = (ring + 1) % rings * segments + (segment + 1) % segments;
+                triangles.push_back({ v00, v10, v01 });
+                triangles.push_back({ v01, v10, v11 });
+            }
+        }
+        std::shuffle(triangles.begin(), triangles.end(), std::mt19937(seed));
+        for (const auto& triangle : triangles)
+        {
+            mesh.Indices.insert(mesh.Indices.end(), triangle.begin(), triangle.end());
+        }
+        return mesh;
+    }
+
+    // The triangles as vertex ids, rotated so the smallest comes first (keeps the winding) and sorted
+    std::vector<std::array<uint32_t, 3>> GetTriangleIds(const IndexedMesh& mesh)
+    {
+        std::vector<std::array<uint32_t, 3>> triangles;
+        for (size_t i = 0; i < mesh.Indices.size(); i += 3)
+        {
+            uint32_t ids[3];
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                std::memcpy(&ids[k], &mesh.Vertices[size_t(mesh.Indices[i + k]) * mesh.VertexStride + sizeof(float) * 3], sizeof(uint32_t));
+            }
+            uint32_t first = ids[0] < ids[1] ? (ids[0] < ids[2] ? 0 : 2) : (ids[1] < ids[2] ? 1 : 2);
+            triangles.push_back({ ids[first], ids[(first + 1) % 3], ids[(first + 2) % 3] });
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    int MeshOptBench(int argc, char** argv)
+    {
+        uint32_t size = std::max(8u, GetOption(argc, argv, 2, "--size", 128));
+        uint32_t numMeshes = std::max(1u, GetOption(argc, argv, 2, "--meshes", 16));
+        ThreadPool pool(GetOption(argc, argv, 2, "--threads", 0));
+
+        std::vector<IndexedMesh> original;
+        size_t numTriangles = 0;
+        for (uint32_t i = 0; i < numMeshes; ++i)
+        {
+            original.push_back(MakeTestTorus(size, 1234 + i));
+            numTriangles += original.back().Indices.size() / 3;
+        }
+        std::printf("%u shuffled tori of %u vertices, %zu triangles each\n", numMeshes, original[0].GetNumVertices(), original[0].Indices.size() / 3);
+
+        std::vector<IndexedMesh> serial = original;
+        auto start = std::chrono::high_resolution_clock::now();
+        OptimizeMeshes(serial);
+        std::chrono::duration<double> serialElapsed = std::chrono::high_resolution_clock::now() - start;
+
+        std::vector<IndexedMesh> parallel = original;
+        start = std::chrono::high_resolution_clock::now();
+        OptimizeMeshes(parallel, &pool);
+        std::chrono::duration<double> parallelElapsed = std::chrono::high_resolution_clock::now() - start;
+
+        std::printf("  %.2f M triangles/s on one thread, %.2f M triangles/s on %u threads\n", numTriangles / serialElapsed.count() / 1e6,
+            numTriangles / parallelElapsed.count() / 1e6, pool.GetThreadCount());
+
+        // Each pass on its own, on the first mesh
+        const IndexedMesh& mesh = original[0];
+        uint32_t numIndices = static_cast<uint32_t>(mesh.Indices.size());
+        IndexedMesh cacheOnly = mesh;
+        cacheOnly.Indices = OptimizeVertexCache(mesh.Indices.data(), numIndices, mesh.GetNumVertices());
+        PrintMeshStats("shuffled", mesh);
+        PrintMeshStats("cache", cacheOnly);
+        PrintMeshStats("all", serial[0]);
+
+        std::printf("Checks:\n");
+        bool passed = true;
+
+        std::vector<std::array<uint32_t, 3>> expected = GetTriangleIds(mesh);
+        bool sameTriangles = true;
+        bool sameResults = true;
+        bool firstUseOrder = true;
+        for (uint32_t i = 0; i < numMeshes; ++i)
+        {
+            sameTriangles &= GetTriangleIds(serial[i]) == GetTriangleIds(original[i]);
+            sameResults &= serial[i].Indices == parallel[i].Indices && serial[i].Vertices == parallel[i].Vertices;
+
+            uint32_t next = 0;
+            for (uint32_t index : serial[i].Indices)
+            {
+                firstUseOrder &= index <= next;
+                next += index == next ? 1 : 0;
+            }
+            firstUseOrder &= next == serial[i].GetNumVertices();
+        }
+        passed &= Check("same triangles, same winding", sameTriangles);
+        passed &= Check("parallel matches serial", sameResults);
+        passed &= Check("vertices in first use order", firstUseOrder);
+
+        VertexCacheStats before = AnalyzeVertexCache(mesh.Indices.data(), numIndices, mesh.GetNumVertices());
+        VertexCacheStats cache = AnalyzeVertexCache(cacheOnly.Indices.data(), numIndices, mesh.GetNumVertices());
+        VertexCacheStats after = AnalyzeVertexCache(serial[0].Indices.data(), numIndices, serial[0].GetNumVertices());
+        passed &= Check("cache order cuts ACMR", cache.ACMR < before.ACMR * 0.5 && cache.ACMR < 0.8);
+        passed &= Check("overdraw pass ACMR within threshold", after.ACMR <= cache.ACMR * DEFAULT_OVERDRAW_THRESHOLD + 0.01,
+            std::to_string(after.ACMR).substr(0, 5) + " vs " + std::to_string(cache.ACMR).substr(0, 5));
+
+        // Bad input is refused before any worker starts
+        std::vector<IndexedMesh> bad = { original[0] };
+        bad[0].Indices.back() = bad[0].GetNumVertices();
+        bool refused = false;
+        try
+        {
+            OptimizeMeshes(bad, &pool);
+        }
+        catch (const std::exception&)
+        {
+            refused = true;
+        }
+        passed &= Check("out of range index refused", refused);
+
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    // Streams of a made up mesh: positions in a box, random unit normals, tangents perpendicular to them with either
+    // sign and texcoords that tile a few times. The first vertices get the directions octahedral encoding finds hardest.
+    struct TestVertices
+    {
+        std::vector<float> Positions;
+        std::vector<float> Normals;
+        std::vector<float> Tangents;
+        std::vector<float> TexCoords;
+
+        VertexStreams GetStreams() const
+        {
+            VertexStreams streams;
+            streams.NumVertices = static_cast<uint32_t>(Positions.size() / 3);
+            streams.Positions = Positions.data();
+            streams.Normals = Normals.data();
+            streams.Tangents = Tangents.data();
+            streams.TexCoords = TexCoords.data();
+            return streams;
+        }
+    };
+
+    void Normalize(float* v)
+    {
+        float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+    }
+
+    TestVertices MakeTestVertices(uint32_t numVertices)
+    {
+        const float SPECIAL_DIRECTIONS[][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+            { 1, 1, 1 }, { -1, -1, -1 }, { 1, -1, -0.001f }, { -1, 1, 0.001f }, { 0.001f, 0, -1 }, { -0.001f, 0.001f, -1 } };
+
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> box(-50.0f, 75.0f);
+        std::uniform_real_distribution<float> tile(-4.0f, 4.0f);
+        std::normal_distribution<float> gaussian;
+
+        TestVertices vertices;
+        for (uint32_t v = 0; v < numVertices; ++v)
+        {
+            float normal[3];
+            if (v < std::size(SPECIAL_DIRECTIONS))
+            {
+                std::memcpy(normal, SPECIAL_DIRECTIONS[v], sizeof(normal));
+            }
+            else
+            {
+                normal[0] = gaussian(random);
+                normal[1] = gaussian(random);
+                normal[2] = gaussian(random);
+            }
+            Normalize(normal);
+
+            // Any direction crossed with the normal is perpendicular to it
+            float other[3] = { gaussian(random), gaussian(random), gaussian(random) };
+            float tangent[4] = { normal[1] * other[2] - normal[2] * other[1], normal[2] * other[0] - normal[0] * other[2],
+                normal[0] * other[1] - normal[1] * other[0], random() & 1 ? 1.0f : -1.0f };
+            Normalize(tangent);
+
+            vertices.Positions.insert(vertices.Positions.end(), { box(random), box(random) * 0.1f, box(random) });
+            vertices.Normals.insert(vertices.Normals.end(), normal, normal + 3);
+            vertices.Tangents.insert(vertices.Tangents.end(), tangent, tangent + 4);
+            vertices.TexCoords.insert(vertices.TexCoords.end(), { tile(random), tile(random) });
+        }
+        return vertices;
+    }
+
+    float GetAngle(const float* a, const float* b)
+    {
+        // atan2 of |a x b| and a.b stays accurate for tiny angles, where acos of the dot product doesn't
+        float cross[3] = { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+        return std::atan2(std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]), a[0] * b[0] + a[1] * b[1] + a[2] * b[2]);
+    }
+
+    int VertexBench(int argc, char** argv)
+    {
+        uint32_t numVertices = std::max(16u, GetOption(argc, argv, 2, "--vertices", 1000000));
+        uint32_t iterations = std::max(1u, GetOption(argc, argv, 2, "--iterations", 10));
+
+        TestVertices test = MakeTestVertices(numVertices);
+        VertexStreams streams = test.GetStreams();
+
+        uint32_t unpackedStride = 0;
+        GetUnpackedLayout(streams, &unpackedStride);
+        PackedVertices packed = PackVertices(streams);
+        UnpackedVertices unpacked = UnpackVertices(packed);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            packed = PackVertices(streams);
+        }
+        std::chrono::duration<double> packElapsed = std::chrono::high_resolution_clock::now() - start;
+
+        start = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            unpacked = UnpackVertices(packed);
+        }
+        std::chrono::duration<double> unpackElapsed = std::chrono::high_resolution_clock::now() - start;
+
+        std::printf("%u vertices, position, normal, tangent and texcoord\n", numVertices);
+        std::printf("  %u -> %u bytes per vertex, %.2f -> %.2f MB (%.0f%% saved)\n", unpackedStride, packed.Stride,
+            double(unpackedStride) * numVertices / (1024.0 * 1024.0), double(packed.Data.size()) / (1024.0 * 1024.0),
+            100.0 * (1.0 - double(packed.Stride) / unpackedStride));
+        for (const VertexElement& element : packed.Layout)
+        {
+            std::printf("    %-8s at %2u, %u bytes\n", element.SemanticName, element.Offset, GetVertexElementSize(element.Format));
+        }
+        std::printf("  pack   : %8.2f M vertices/s\n", double(numVertices) * iterations / packElapsed.count() / 1e6);
+        std::printf("  unpack : %8.2f M vertices/s\n", double(numVertices) * iterations / unpackElapsed.count() / 1e6);
+
+        // Worst errors against the limits VertexPacker.h promises
+        float positionError = 0.0f; // as a fraction of the limit checked
+        float normalError = 0.0f;
+        float tangentError = 0.0f;
+        float texCoordError = 0.0f;
+        bool positionsInBounds = true;
+        bool texCoordsInBounds = true;
+        bool signsKept = true;
+        for (uint32_t v = 0; v < numVertices; ++v)
+        {
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                // Half a step, plus the float rounding of the encode and decode around the bounds
+                float error = std::fabs(unpacked.Positions[v * 3 + c] - test.Positions[v * 3 + c]);
+                float limit = packed.BoundsExtent[c] / 131070.0f + (std::fabs(packed.BoundsMin[c]) + packed.BoundsExtent[c]) * 4.0f * FLT_EPSILON;
+                positionsInBounds &= error <= limit;
+                positionError = std::max(positionError, error / limit);
+            }
+            for (uint32_t c = 0; c < 2; ++c)
+            {
+                float value = test.TexCoords[v * 2 + c];
+                float error = std::fabs(unpacked.TexCoords[v * 2 + c] - value);
+                texCoordsInBounds &= error <= std::max(std::fabs(value) / 2048.0f, 1.0f / (1 << 25));
+                texCoordError = std::max(texCoordError, error);
+            }
+            normalError = std::max(normalError, GetAngle(&unpacked.Normals[v * 3], &test.Normals[v * 3]));
+            tangentError = std::max(tangentError, GetAngle(&unpacked.Tangents[v * 4], &test.Tangents[v * 4]));
+            signsKept &= unpacked.Tangents[v * 4 + 3] == test.Tangents[v * 4 + 3];
+        }
+        std::printf("  worst position error %.3f of the limit, normal %.6f rad, tangent %.6f rad, texcoord %.2e\n",
+            positionError, normalError, tangentError, texCoordError);
+
+        std::printf("Checks:\n");
+        bool passed = true;
+        passed &= Check("positions within half a step + rounding", positionsInBounds,
+            std::to_string(positionError) + " of the limit");
+        passed &= Check("normals within the octahedral limit", normalError <= OCTAHEDRAL_MAX_ERROR);
+        passed &= Check("tangents within the octahedral limit", tangentError <= OCTAHEDRAL_MAX_ERROR);
+        passed &= Check("tangent signs kept", signsKept);
+        passed &= Check("texcoords within half an ulp", texCoordsInBounds);
+
+        // The vector kernels against the scalar ones: packing fewer than 4 vertices never takes the vector path, so
+        // pack each vertex with the two corners of the bounds (which keeps the same quantization) and compare
+        bool samePacked = true;
+        bool sameUnpacked = true;
+        float corners[2][3];
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            corners[0][c] = packed.BoundsMin[c];
+            corners[1][c] = packed.BoundsMin[c] + packed.BoundsExtent[c];
+        }
+        for (uint32_t v = 0; v < numVertices; v += std::max(1u, numVertices / 4096))
+        {
+            TestVertices single;
+            single.Positions.insert(single.Positions.end(), &corners[0][0], &corners[0][0] + 6);
+            single.Positions.insert(single.Positions.end(), &test.Positions[v * 3], &test.Positions[v * 3] + 3);
+            single.Normals.insert(single.Normals.end(), &test.Normals[0], &test.Normals[0] + 6);
+            single.Normals.insert(single.Normals.end(), &test.Normals[v * 3], &test.Normals[v * 3] + 3);
+            single.Tangents.insert(single.Tangents.end(), &test.Tangents[0], &test.Tangents[0] + 8);
+            single.Tangents.insert(single.Tangents.end(), &test.Tangents[v * 4], &test.Tangents[v * 4] + 4);
+            single.TexCoords.insert(single.TexCoords.end(), &test.TexCoords[0], &test.TexCoords[0] + 4);
+            single.TexCoords.insert(single.TexCoords.end(), &test.TexCoords[v * 2], &test.TexCoords[v * 2] + 2);
+
+            PackedVertices scalar = PackVertices(single.GetStreams());
+            UnpackedVertices scalarUnpacked = UnpackVertices(scalar);
+            samePacked &= std::memcmp(&scalar.Data[scalar.Stride * 2], &packed.Data[size_t(v) * packed.Stride], packed.Stride) == 0
+                && std::memcmp(scalar.BoundsMin, packed.BoundsMin, sizeof(packed.BoundsMin)) == 0
+                && std::memcmp(scalar.BoundsExtent, packed.BoundsExtent, sizeof(packed.BoundsExtent)) == 0;
+            sameUnpacked &= std::memcmp(&scalarUnpacked.Positions[6], &unpacked.Positions[v * 3], sizeof(float) * 3) == 0
+                && std::memcmp(&scalarUnpacked.Normals[6], &unpacked.Normals[v * 3], sizeof(float) * 3) == 0
+                && std::memcmp(&scalarUnpacked.Tangents[8], &unpacked.Tangents[v * 4], sizeof(float) * 4) == 0
+                && std::memcmp(&scalarUnpacked.TexCoords[4], &unpacked.TexCoords[v * 2], sizeof(float) * 2) == 0;
+        }
+        passed &= Check("vector pack matches scalar", samePacked);
+        passed &= Check("vector unpack matches scalar", sameUnpacked);
+
+        // Every half, through the vector kernels and the scalar functions: NaNs stay NaN, the rest round trip exactly
+        TestVertices halves = MakeTestVertices(32768);
+        for (uint32_t h = 0; h < 65536; ++h)
+        {
+            halves.TexCoords[h] = HalfToFloat(static_cast<uint16_t>(h));
+        }
+        UnpackedVertices halvesUnpacked = UnpackVertices(PackVertices(halves.GetStreams()));
+        bool halvesExact = true;
+        for (uint32_t h = 0; h < 65536; ++h)
+        {
+            bool isNaN = (h & 0x7C00) == 0x7C00 && (h & 0x3FF) != 0;
+            float value = halvesUnpacked.TexCoords[h];
+            halvesExact &= isNaN ? std::isnan(value) : FloatToHalf(value) == h && std::memcmp(&value, &halves.TexCoords[h], sizeof(float)) == 0;
+        }
+        passed &= Check("every half round trips", halvesExact);
+
+        // A flat mesh keeps its flat axis exactly, and there's nothing to pack without positions
+        TestVertices flat = MakeTestVertices(64);
+        for (uint32_t v = 0; v < 64; ++v)
+        {
+            flat.Positions[v * 3 + 1] = 2.5f;
+        }
+        UnpackedVertices flatUnpacked = UnpackVertices(PackVertices(flat.GetStreams()));
+        bool flatExact = true;
+        for (uint32_t v = 0; v < 64; ++v)
+        {
+            flatExact &= flatUnpacked.Positions[v * 3 + 1] == 2.5f;
+        }
+        passed &= Check("flat axis exact", flatExact);
+
+        bool refused = false;
+        try
+        {
+            PackVertices(VertexStreams());
+        }
+        catch (const std::exception&)
+        {
+            refused = true;
+        }
+        passed &= Check("no positions refused", refused);
+
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    // Area weighted box reference of one mip step, worked out independently of MipChain.cpp: destination texel x
+    // covers [x * S / D, (x + 1) * S / D) of the source row, each source texel weighted by how much of it is covered.
+    // That's the 2 texel box for even sizes and the (n - x, n, x + 1) / (2n + 1) polyphase box for odd ones.
+    std::vector<double> ReferenceAxisWeights(uint32_t x, uint32_t sourceSize, uint32_t destinationSize)
+    {
+        std::vector<double> weights(sourceSize, 0.0);
+        double begin = double(x) * sourceSize / destinationSize;
+        double end = double(x + 1) * sourceSize / destinationSize;
+        for (uint32_t s = 0; s < sourceSize; ++s)
+        {
+            double covered = std::min(end, s + 1.0) - std::max(begin, double(s));
+            weights[s] = std::max(covered, 0.0) / (end - begin);
+        }
+        return weights;
+    }
+
+    double ReferenceToLinear(uint8_t value, bool isSRGB)
+    {
+        double c = value / 255.0;
+        return !isSRGB ? c : c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+    }
+
+    double ReferenceToEncoded(double c, bool isSRGB)
+    {
+        return !isSRGB ? c : c <= 0.0031308 ? c * 12.92 : 1.055 * std::pow(c, 1.0 / 2.4) - 0.055;
+    }
+
+    int MipCheck(int argc, char** argv)
+    {
+        ThreadPool pool(GetOption(argc, argv, 2, "--threads", 0));
+
+        // Odd and non power of two sizes, where the polyphase filter and the 1 texel wide axes come in
+        const uint32_t sizes[][2] = { { 5, 3 }, { 7, 1 }, { 1, 7 }, { 6, 10 }, { 9, 9 }, { 13, 5 }, { 1, 1 }, { 64, 33 } };
+
+        bool passed = true;
+        std::mt19937 random(7);
+        for (const auto& size : sizes)
+        {
+            uint32_t width = size[0];
+            uint32_t height = size[1];
+
+            // A padded row pitch, the chain has to skip the padding
+            uint32_t rowPitch = width * 4 + 12;
+            std::vector<uint8_t> image(size_t(rowPitch) * height, 0xCD);
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                for (uint32_t i = 0; i < width * 4; ++i)
+                {
+                    image[size_t(y) * rowPitch + i] = static_cast<uint8_t>(random());
+                }
+            }
+
+            for (bool isSRGB : { false, true })
+            {
+                std::string name = std::to_string(width) + "x" + std::to_string(height) + (isSRGB ? " sRGB" : " UNORM");
+                std::printf("%s\n", name.c_str());
+
+                std::vector<MipLevel> chain = GenerateMipChain(image.data(), width, height, rowPitch, isSRGB, &pool);
+                std::vector<MipLevel> serial = GenerateMipChain(image.data(), width, height, rowPitch, isSRGB);
+
+                uint32_t expectedLevels = 1;
+                for (uint32_t w = width, h = height; w > 1 || h > 1; w = std::max(1u, w >> 1), h = std::max(1u, h >> 1))
+                {
+                    ++expectedLevels;
+                }
+                bool levelsOk = chain.size() == expectedLevels && GetNumMipLevels(width, height) == expectedLevels;
+                passed &= Check("level count", levelsOk, std::to_string(chain.size()) + " levels");
+                if (!levelsOk)
+                {
+                    continue;
+                }
+
+                bool sizesOk = chain.back().Width == 1 && chain.back().Height == 1;
+                for (size_t level = 1; level < chain.size(); ++level)
+                {
+                    sizesOk &= chain[level].Width == std::max(1u, chain[level - 1].Width >> 1);
+                    sizesOk &= chain[level].Height == std::max(1u, chain[level - 1].Height >> 1);
+                    sizesOk &= chain[level].Pixels.size() == size_t(chain[level].Width) * chain[level].Height * 4;
+                }
+                passed &= Check("level sizes halve down to 1x1", sizesOk);
+
+                passed &= Check("level 0 is the source", CompareMipLevel(chain[0], image.data(), rowPitch) == 0);
+
+                bool sameSerial = true;
+                for (size_t level = 0; level < chain.size(); ++level)
+                {
+                    sameSerial &= chain[level].Pixels == serial[level].Pixels;
+                }
+                passed &= Check("threaded chain matches the serial one", sameSerial);
+
+                // The reference filters level to level in linear double, like the chain does in linear float
+                std::vector<double> current(size_t(width) * height * 4);
+                for (uint32_t y = 0; y < height; ++y)
+                {
+                    for (uint32_t i = 0; i < width * 4; ++i)
+                    {
+                        current[size_t(y) * width * 4 + i] = ReferenceToLinear(image[size_t(y) * rowPitch + i], isSRGB && (i & 3) != 3);
+                    }
+                }
+                uint32_t worst = 0;
+                for (size_t level = 1; level < chain.size(); ++level)
+                {
+                    uint32_t sourceWidth = chain[level - 1].Width;
+                    uint32_t sourceHeight = chain[level - 1].Height;
+                    const MipLevel& out = chain[level];
+
+                    std::vector<double> next(size_t(out.Width) * out.Height * 4, 0.0);
+                    std::vector<uint8_t> expected(next.size());
+                    for (uint32_t y = 0; y < out.Height; ++y)
+                    {
+                        std::vector<double> weightsY = ReferenceAxisWeights(y, sourceHeight, out.Height);
+                        for (uint32_t x = 0; x < out.Width; ++x)
+                        {
+                            std::vector<double> weightsX = ReferenceAxisWeights(x, sourceWidth, out.Width);
+                            for (uint32_t c = 0; c < 4; ++c)
+                            {
+                                double sum = 0.0;
+                                for (uint32_t sy = 0; sy < sourceHeight; ++sy)
+                                {
+                                    for (uint32_t sx = 0; sx < sourceWidth; ++sx)
+                                    {
+                                        sum += weightsX[sx] * weightsY[sy] * current[(size_t(sy) * sourceWidth + sx) * 4 + c];
+                                    }
+                                }
+                                size_t index = (size_t(y) * out.Width + x) * 4 + c;
+                                next[index] = sum;
+                                double encoded = ReferenceToEncoded(sum, isSRGB && c != 3);
+                                expected[index] = static_cast<uint8_t>(std::min(std::max(encoded, 0.0), 1.0) * 255.0 + 0.5);
+                            }
+                        }
+                    }
+
+                    MipLevel reference = { out.Width, out.Height, expected };
+                    worst = std::max(worst, CompareMipLevel(reference, out.Pixels.data(), out.Width * 4));
+                    current = std::move(next);
+                }
+                // Float against double rounding can land one step apart, anything more is the filter
+                passed &= Check("levels match the area box reference", worst <= 1, "worst difference " + std::to_string(worst));
+            }
+        }
+
+        // CompareMipLevel reads rows at the pitch it's given and never looks at the padding
+        std::printf("CompareMipLevel\n");
+        MipLevel level = { 3, 2, std::vector<uint8_t>(3 * 2 * 4) };
+        for (size_t i = 0; i < level.Pixels.size(); ++i)
+        {
+            level.Pixels[i] = static_cast<uint8_t>(i * 11);
+        }
+        uint32_t rowPitch = 256; // what a readback footprint would use
+        std::vector<uint8_t> readback(size_t(rowPitch) * 2, 0xFF);
+        for (uint32_t y = 0; y < 2; ++y)
+        {
+            std::memcpy(&readback[size_t(y) * rowPitch], &level.Pixels[size_t(y) * 3 * 4], 3 * 4);
+        }
+        passed &= Check("padded readback matches", CompareMipLevel(level, readback.data(), rowPitch) == 0);
+        readback[rowPitch + 2 * 4 + 1] += 5; // the last texel's green
+        uint32_t difference = CompareMipLevel(level, readback.data(), rowPitch);
+        passed &= Check("changed byte found", difference == 5, "difference " + std::to_string(difference));
+
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        if (argc >= 4 && std::strcmp(argv[1], "pack") == 0)
+        {
+            return Pack(argc, argv);
+        }
+        if (argc >= 3 && std::strcmp(argv[1], "list") == 0)
+        {
+            return List(argv);
+        }
+        if (argc >= 3 && std::strcmp(argv[1], "bench") == 0)
+        {
+            return Bench(argc, argv);
+        }
+        if (argc >= 3 && std::strcmp(argv[1], "readbench") == 0)
+        {
+            return ReadBench(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "bcbench") == 0)
+        {
+            return BCBench(argc, argv);
+        }
+        if (argc >= 4 && std::strcmp(argv[1], "meshlets") == 0)
+        {
+            return Meshlets(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "meshletbench") == 0)
+        {
+            return MeshletBench(argc, argv);
+        }
+        if (argc >= 3 && std::strcmp(argv[1], "meshopt") == 0)
+        {
+            return MeshOpt(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "meshoptbench") == 0)
+        {
+            return MeshOptBench(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "vertexbench") == 0)
+        {
+            return VertexBench(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "mipcheck") == 0)
+        {
+            return MipCheck(argc, argv);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+    }
+
+    PrintUsage();
+    return 1;
+}
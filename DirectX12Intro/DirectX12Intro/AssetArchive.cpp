@@ -0,0 +1,435 @@
+#include "AssetArchive.h"
+
+#include "LZ.h"
+#include "ThreadPool.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h> // For memory mapping the archive
+
+#if defined(min)
+#undef min
+#endif
+
+#if defined(max)
+#undef max
+#endif
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    bool IsPowerOfTwo(uint32_t value)
+    {
+        return value != 0 && (value & (value - 1)) == 0;
+    }
+
+    // offset + size <= total without the sum wrapping, offset and size come straight from the file
+    bool FitsIn(uint64_t offset, uint64_t size, uint64_t total)
+    {
+        return offset <= total && size <= total - offset;
+    }
+
+    struct CompressedChunk
+    {
+        std::vector<uint8_t> Data; // empty when stored raw
+        uint32_t Size;
+    };
+}
+
+uint64_t HashAssetName(const std::string& name)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : name)
+    {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// PackBuilder
+
+PackBuilder::PackBuilder(uint32_t chunkSize, uint32_t alignment)
+    : m_ChunkSize(chunkSize)
+    , m_Alignment(alignment)
+{
+    if (!IsPowerOfTwo(alignment) || chunkSize % alignment != 0 ||
+        chunkSize < PACK_MIN_CHUNK_SIZE || chunkSize > PACK_MAX_CHUNK_SIZE)
+    {
+        throw std::runtime_error("Chunk size must be a multiple of the alignment between 64KB and 256KB");
+    }
+}
+
+void PackBuilder::AddFile(const std::string& name, std::vector<uint8_t> data)
+{
+    m_Files.push_back({ name, std::move(data) });
+}
+
+void PackBuilder::Write(const std::string& path, ThreadPool* pool) const
+{
+    // Sort the table of contents by hash so the reader can binary search it
+    std::vector<const File*> files;
+    files.reserve(m_Files.size());
+    for (const File& file : m_Files)
+    {
+        files.push_back(&file);
+    }
+    std::sort(files.begin(), files.end(), [](const File* a, const File* b)
+    {
+        uint64_t hashA = HashAssetName(a->Name);
+        uint64_t hashB = HashAssetName(b->Name);
+        return hashA != hashB ? hashA < hashB : a->Name < b->Name;
+    });
+
+    std::vector<PackEntry> entries(files.size());
+    std::vector<const uint8_t*> chunkSources;
+    std::vector<uint32_t> chunkSizes;
+    std::string names;
+
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        const File& file = *files[i];
+        if (i > 0 && file.Name == files[i - 1]->Name)
+        {
+            throw std::runtime_error("Duplicate file in archive: " + file.Name);
+        }
+
+        PackEntry& entry = entries[i];
+        entry.NameHash = HashAssetName(file.Name);
+        entry.Size = file.Data.size();
+        entry.FirstChunk = static_cast<uint32_t>(chunkSources.size());
+        entry.NumChunks = static_cast<uint32_t>((file.Data.size() + m_ChunkSize - 1) / m_ChunkSize);
+        entry.NameOffset = static_cast<uint32_t>(names.size());
+        entry.NameLength = static_cast<uint32_t>(file.Name.size());
+        names += file.Name;
+
+        for (uint64_t offset = 0; offset < file.Data.size(); offset += m_ChunkSize)
+        {
+            chunkSources.push_back(file.Data.data() + offset);
+            chunkSizes.push_back(static_cast<uint32_t>(std::min<uint64_t>(m_ChunkSize, file.Data.size() - offset)));
+        }
+    }
+
+    // Compress all chunks. Anything that doesn't get smaller is stored raw.
+    std::vector<CompressedChunk> compressed(chunkSources.size());
+    auto compressChunk = [&](uint32_t i)
+    {
+        CompressedChunk& chunk = compressed[i];
+        chunk.Size = chunkSizes[i];
+        chunk.Data.resize(LZ::CompressBound(chunk.Size));
+        size_t compressedSize = LZ::Compress(chunkSources[i], chunk.Size, chunk.Data.data(), chunk.Size - 1);
+        chunk.Data.resize(compressedSize);
+        chunk.Data.shrink_to_fit();
+    };
+
+    if (pool)
+    {
+        pool->ParallelFor(static_cast<uint32_t>(compressed.size()), compressChunk);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < compressed.size(); ++i)
+        {
+            compressChunk(i);
+        }
+    }
+
+    // Lay out the chunk data, then the tables at the end
+    std::vector<PackChunk> chunks(compressed.size());
+    uint64_t offset = AlignUp(sizeof(PackHeader), m_Alignment);
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        chunks[i].Offset = offset;
+        chunks[i].Size = compressed[i].Size;
+        chunks[i].CompressedSize = compressed[i].Data.empty() ? compressed[i].Size : static_cast<uint32_t>(compressed[i].Data.size());
+        offset = AlignUp(offset + chunks[i].CompressedSize, m_Alignment);
+    }
+
+    PackHeader header = {};
+    header.Magic = PACK_MAGIC;
+    header.Version = PACK_VERSION;
+    header.ChunkSize = m_ChunkSize;
+    header.Alignment = m_Alignment;
+    header.NumEntries = static_cast<uint32_t>(entries.size());
+    header.NumChunks = static_cast<uint32_t>(chunks.size());
+    header.EntriesOffset = offset;
+    header.ChunksOffset = header.EntriesOffset + entries.size() * sizeof(PackEntry);
+    header.NamesOffset = header.ChunksOffset + chunks.size() * sizeof(PackChunk);
+    header.NamesSize = names.size();
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        throw std::runtime_error("Failed to open " + path + " for writing");
+    }
+
+    const std::vector<char> padding(m_Alignment, 0);
+    auto pad = [&](uint64_t to)
+    {
+        out.write(padding.data(), static_cast<std::streamsize>(to - static_cast<uint64_t>(out.tellp())));
+    };
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        pad(chunks[i].Offset);
+        const uint8_t* data = compressed[i].Data.empty() ? chunkSources[i] : compressed[i].Data.data();
+        out.write(reinterpret_cast<const char*>(data), chunks[i].CompressedSize);
+    }
+    pad(header.EntriesOffset);
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(PackEntry));
+    out.write(reinterpret_cast<const char*>(chunks.data()), chunks.size() * sizeof(PackChunk));
+    out.write(names.data(), names.size());
+
+    if (!out)
+    {
+        throw std::runtime_error("Failed to write " + path);
+    }
+}
+
+// AssetArchive
+
+AssetArchive::~AssetArchive()
+{
+    Close();
+}
+
+void AssetArchive::Open(const std::string& path)
+{
+    Close();
+
+#if defined(_WIN32)
+    m_File = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (m_File == INVALID_HANDLE_VALUE)
+    {
+        m_File = nullptr;
+        throw std::runtime_error("Failed to open " + path);
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!::GetFileSizeEx(m_File, &fileSize))
+    {
+        Close();
+        throw std::runtime_error("Failed to get the size of " + path);
+    }
+    m_Size = static_cast<uint64_t>(fileSize.QuadPart);
+
+    m_Mapping = ::CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_Mapping)
+    {
+        m_Data = static_cast<const uint8_t*>(::MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+#else
+    m_File = ::open(path.c_str(), O_RDONLY);
+    if (m_File < 0)
+    {
+        throw std::runtime_error("Failed to open " + path);
+    }
+
+    struct stat fileStat;
+    if (::fstat(m_File, &fileStat) != 0)
+    {
+        Close();
+        throw std::runtime_error("Failed to get the size of " + path);
+    }
+    m_Size = static_cast<uint64_t>(fileStat.st_size);
+
+    void* data = m_Size > 0 ? ::mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, m_File, 0) : MAP_FAILED;
+    m_Data = data != MAP_FAILED ? static_cast<const uint8_t*>(data) : nullptr;
+#endif
+
+    if (!m_Data || m_Size < sizeof(PackHeader))
+    {
+        Close();
+        throw std::runtime_error("Failed to map " + path);
+    }
+
+    // Validate everything up front so lookups and decompression don't need to
+    const PackHeader* header = reinterpret_cast<const PackHeader*>(m_Data);
+    bool valid = header->Magic == PACK_MAGIC && header->Version == PACK_VERSION &&
+        IsPowerOfTwo(header->Alignment) && header->ChunkSize % header->Alignment == 0 &&
+        header->ChunkSize >= PACK_MIN_CHUNK_SIZE && header->ChunkSize <= PACK_MAX_CHUNK_SIZE &&
+        FitsIn(header->EntriesOffset, uint64_t(header->NumEntries) * sizeof(PackEntry), m_Size) &&
+        FitsIn(header->ChunksOffset, uint64_t(header->NumChunks) * sizeof(PackChunk), m_Size) &&
+        FitsIn(header->NamesOffset, header->NamesSize, m_Size) &&
+        header->EntriesOffset % alignof(PackEntry) == 0 && header->ChunksOffset % alignof(PackChunk) == 0;
+
+    if (valid)
+    {
+        m_Header = header;
+        m_Entries = reinterpret_cast<const PackEntry*>(m_Data + header->EntriesOffset);
+        m_Chunks = reinterpret_cast<const PackChunk*>(m_Data + header->ChunksOffset);
+        m_Names = reinterpret_cast<const char*>(m_Data + header->NamesOffset);
+
+        for (uint32_t i = 0; valid && i < header->NumEntries; ++i)
+        {
+            const PackEntry& entry = m_Entries[i];
+
+            // The chunk sizes below are worked out from Size, so a count that doesn't match it would underflow them
+            uint64_t expectedChunks = entry.Size / header->ChunkSize + (entry.Size % header->ChunkSize != 0 ? 1 : 0);
+            valid = entry.NumChunks == expectedChunks &&
+                uint64_t(entry.FirstChunk) + entry.NumChunks <= header->NumChunks &&
+                uint64_t(entry.NameOffset) + entry.NameLength <= header->NamesSize &&
+                (i == 0 || m_Entries[i - 1].NameHash <= entry.NameHash);
+
+            for (uint32_t c = 0; valid && c < entry.NumChunks; ++c)
+            {
+                const PackChunk& chunk = m_Chunks[entry.FirstChunk + c];
+                uint64_t expectedSize = std::min<uint64_t>(header->ChunkSize, entry.Size - uint64_t(c) * header->ChunkSize);
+                valid = chunk.Size == expectedSize && chunk.CompressedSize <= chunk.Size &&
+                    FitsIn(chunk.Offset, chunk.CompressedSize, m_Size);
+            }
+        }
+    }
+
+    if (!valid)
+    {
+        Close();
+        throw std::runtime_error(path + " is not a valid archive");
+    }
+}
+
+void AssetArchive::Close()
+{
+#if defined(_WIN32)
+    if (m_Data)
+    {
+        ::UnmapViewOfFile(m_Data);
+    }
+    if (m_Mapping)
+    {
+        ::CloseHandle(m_Mapping);
+    }
+    if (m_File)
+    {
+        ::CloseHandle(m_File);
+    }
+    m_Mapping = nullptr;
+    m_File = nullptr;
+#else
+    if (m_Data)
+    {
+        ::munmap(const_cast<uint8_t*>(m_Data), m_Size);
+    }
+    if (m_File >= 0)
+    {
+        ::close(m_File);
+    }
+    m_File = -1;
+#endif
+
+    m_Data = nullptr;
+    m_Size = 0;
+    m_Header = nullptr;
+    m_Entries = nullptr;
+    m_Chunks = nullptr;
+    m_Names = nullptr;
+}
+
+const PackEntry* AssetArchive::Find(const std::string& name) const
+{
+    if (!m_Header)
+    {
+        return nullptr;
+    }
+
+    uint64_t hash = HashAssetName(name);
+    const PackEntry* end = m_Entries + m_Header->NumEntries;
+    const PackEntry* it = std::lower_bound(m_Entries, end, hash,
+        [](const PackEntry& entry, uint64_t h) { return entry.NameHash < h; });
+
+    // Walk past hash collisions
+    for (; it != end && it->NameHash == hash; ++it)
+    {
+        if (it->NameLength == name.size() && std::memcmp(m_Names + it->NameOffset, name.data(), name.size()) == 0)
+        {
+            return it;
+        }
+    }
+    return nullptr;
+}
+
+std::string AssetArchive::GetName(const PackEntry& entry) const
+{
+    return std::string(m_Names + entry.NameOffset, entry.NameLength);
+}
+
+uint64_t AssetArchive::GetStagingSize(const PackEntry& entry) const
+{
+    return AlignUp(entry.Size, m_Header->Alignment);
+}
+
+void AssetArchive::Decompress(const std::vector<PackRead>& reads, ThreadPool* pool) const
+{
+    // Flatten to one job per chunk so small and large files balance across the workers
+    struct Job
+    {
+        const PackChunk* Chunk;
+        uint8_t* Destination;
+    };
+
+    std::vector<Job> jobs;
+    for (const PackRead& read : reads)
+    {
+        uint8_t* destination = static_cast<uint8_t*>(read.Destination);
+        for (uint32_t c = 0; c < read.Entry->NumChunks; ++c)
+        {
+            jobs.push_back({ &m_Chunks[read.Entry->FirstChunk + c], destination + uint64_t(c) * m_Header->ChunkSize });
+        }
+    }
+
+    // Can't throw from a worker thread, so remember the failure and throw afterwards
+    std::atomic<bool> failed{ false };
+    auto decompressChunk = [&](uint32_t i)
+    {
+        const PackChunk& chunk = *jobs[i].Chunk;
+        const uint8_t* source = m_Data + chunk.Offset;
+        if (chunk.CompressedSize == chunk.Size)
+        {
+            std::memcpy(jobs[i].Destination, source, chunk.Size);
+        }
+        else if (LZ::Decompress(source, chunk.CompressedSize, jobs[i].Destination, chunk.Size) != chunk.Size)
+        {
+            failed = true;
+        }
+    };
+
+    if (pool)
+    {
+        pool->ParallelFor(static_cast<uint32_t>(jobs.size()), decompressChunk);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < jobs.size(); ++i)
+        {
+            decompressChunk(i);
+        }
+    }
+
+    if (failed)
+    {
+        throw std::runtime_error("Corrupt chunk in archive");
+    }
+}
+
+void AssetArchive::Decompress(const PackEntry& entry, void* destination, ThreadPool* pool) const
+{
+    Decompress({ { &entry, destination } }, pool);
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+// Packed asset archive (.pak)
+// Loading hundreds of loose files at startup thrashes the file system, so assets get cooked
+// into one archive instead:
+//
+//   PackHeader
+//   chunk data    : every file is cut into ChunkSize pieces that are LZ compressed independently,
+//                   each piece starts on an Alignment boundary in the file
+//   PackEntry[]   : table of contents, sorted by name hash so lookups are a binary search
+//   PackChunk[]   : where each chunk lives and how big it is
+//   names         : the original file names, not null terminated
+//
+// Chunks are independent so they can be decompressed in parallel, and ChunkSize is a multiple of
+// Alignment so chunk N of a file always lands on an aligned offset of the destination.
+// The default alignment is D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, which means a file can be
+// decompressed straight into upload heap memory and copied with CopyTextureRegion/CopyBufferRegion.
+//
+// Nothing in here depends on D3D12 or Windows.h, the archive tools run on any platform.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+const uint32_t PACK_MAGIC = 0x4B505844; // "DXPK"
+const uint32_t PACK_VERSION = 1;
+
+const uint32_t PACK_MIN_CHUNK_SIZE = 64 * 1024;
+const uint32_t PACK_MAX_CHUNK_SIZE = 256 * 1024;
+const uint32_t PACK_DEFAULT_CHUNK_SIZE = 128 * 1024;
+const uint32_t PACK_DEFAULT_ALIGNMENT = 512; // D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT
+
+struct PackHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t ChunkSize;   // uncompressed size of every chunk except the last one of a file
+    uint32_t Alignment;   // alignment of chunk data in the file and of a file's destination
+    uint32_t NumEntries;
+    uint32_t NumChunks;
+    uint64_t EntriesOffset;
+    uint64_t ChunksOffset;
+    uint64_t NamesOffset;
+    uint64_t NamesSize;
+};
+
+struct PackEntry
+{
+    uint64_t NameHash;    // see HashAssetName
+    uint64_t Size;        // uncompressed size of the file
+    uint32_t FirstChunk;
+    uint32_t NumChunks;
+    uint32_t NameOffset;  // into the names block
+    uint32_t NameLength;
+};
+
+struct PackChunk
+{
+    uint64_t Offset;         // from the start of the archive
+    uint32_t CompressedSize; // == Size when the chunk didn't compress and is stored raw
+    uint32_t Size;
+};
+
+// FNV-1a. Names are hashed exactly as given, so cook them with forward slashes.
+uint64_t HashAssetName(const std::string& name);
+
+// Collects files and writes them out as an archive
+class PackBuilder
+{
+public:
+    explicit PackBuilder(uint32_t chunkSize = PACK_DEFAULT_CHUNK_SIZE, uint32_t alignment = PACK_DEFAULT_ALIGNMENT);
+
+    void AddFile(const std::string& name, std::vector<uint8_t> data);
+
+    // Compresses every chunk (in parallel if a pool is given) and writes the archive.
+    // Throws std::runtime_error on failure.
+    void Write(const std::string& path, ThreadPool* pool = nullptr) const;
+
+private:
+    struct File
+    {
+        std::string Name;
+        std::vector<uint8_t> Data;
+    };
+
+    uint32_t m_ChunkSize;
+    uint32_t m_Alignment;
+    std::vector<File> m_Files;
+};
+
+// One file to decompress and where to put it
+struct PackRead
+{
+    const PackEntry* Entry;
+    void* Destination; // needs AssetArchive::GetStagingSize(*Entry) bytes
+};
+
+// Read side. The archive is memory mapped, so opening it is cheap and the OS pages in
+// only the chunks we actually touch.
+class AssetArchive
+{
+public:
+    AssetArchive() = default;
+    ~AssetArchive();
+
+    AssetArchive(const AssetArchive&) = delete;
+    AssetArchive& operator=(const AssetArchive&) = delete;
+
+    // Maps the file and validates the tables. Throws std::runtime_error on failure.
+    void Open(const std::string& path);
+    void Close();
+
+    // nullptr if the archive doesn't contain the file
+    const PackEntry* Find(const std::string& name) const;
+
+    uint32_t GetNumEntries() const { return m_Header ? m_Header->NumEntries : 0; }
+    const PackEntry& GetEntry(uint32_t index) const { return m_Entries[index]; }
+    std::string GetName(const PackEntry& entry) const;
+
+    uint32_t GetAlignment() const { return m_Header->Alignment; }
+
+    // Size rounded up to the archive alignment, so consecutive files in a staging buffer stay aligned
+    uint64_t GetStagingSize(const PackEntry& entry) const;
+
+    // Decompresses the files chunk by chunk straight into their destinations.
+    // All chunks of all reads are spread across the pool as one batch (serially without a pool).
+    // Throws std::runtime_error if a chunk is corrupt.
+    void Decompress(const std::vector<PackRead>& reads, ThreadPool* pool = nullptr) const;
+    void Decompress(const PackEntry& entry, void* destination, ThreadPool* pool = nullptr) const;
+
+private:
+    const uint8_t* m_Data = nullptr;
+    uint64_t m_Size = 0;
+
+    const PackHeader* m_Header = nullptr;
+    const PackEntry* m_Entries = nullptr;
+    const PackChunk* m_Chunks = nullptr;
+    const char* m_Names = nullptr;
+
+#if defined(_WIN32)
+    void* m_File = nullptr;    // HANDLE
+    void* m_Mapping = nullptr; // HANDLE
+#else
+    int m_File = -1;
+#endif
+};
@@ -0,0 +1,361 @@
+#include "AsyncFileQueue.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h> // Overlapped I/O and completion ports
+
+#if defined(min)
+#undef min
+#endif
+
+#if defined(max)
+#undef max
+#endif
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(_WIN32)
+namespace
+{
+    // Completion key of the packets Submit posts to wake the I/O thread, files are associated with key 0
+    const ULONG_PTR WAKE_UP_KEY = 1;
+}
+#endif
+
+AsyncFileQueue::AsyncFileQueue(uint32_t queueDepth)
+    : m_QueueDepth(std::max(1u, queueDepth))
+{
+#if defined(_WIN32)
+    // A single I/O thread can keep any number of overlapped reads in flight
+    m_CompletionPort = ::CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+    if (!m_CompletionPort)
+    {
+        throw std::runtime_error("Failed to create I/O completion port");
+    }
+    m_Threads.emplace_back(&AsyncFileQueue::IOThread, this);
+#else
+    // Blocking reads, so one thread per read in flight
+    for (uint32_t i = 0; i < m_QueueDepth; ++i)
+    {
+        m_Threads.emplace_back(&AsyncFileQueue::IOThread, this);
+    }
+#endif
+}
+
+AsyncFileQueue::~AsyncFileQueue()
+{
+    {
+        // Reads that haven't been issued yet are dropped, the in-flight ones have to finish
+        // since they're writing into memory we don't own
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+        m_Queued.clear();
+    }
+    m_WorkAvailable.notify_all();
+
+    for (std::thread& thread : m_Threads)
+    {
+        thread.join();
+    }
+
+#if defined(_WIN32)
+    for (void* file : m_Files)
+    {
+        ::CloseHandle(file);
+    }
+    ::CloseHandle(m_CompletionPort);
+#else
+    for (int file : m_Files)
+    {
+        ::close(file);
+    }
+#endif
+}
+
+uint32_t AsyncFileQueue::OpenFile(const std::string& path)
+{
+#if defined(_WIN32)
+    HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("Failed to open " + path);
+    }
+
+    // Completions of every read on this file get posted to our port
+    ::CreateIoCompletionPort(file, m_CompletionPort, 0, 0);
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        throw std::runtime_error("Failed to open " + path);
+    }
+#endif
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Files.push_back(file);
+    return static_cast<uint32_t>(m_Files.size() - 1);
+}
+
+uint64_t AsyncFileQueue::GetFileSize(uint32_t file) const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+#if defined(_WIN32)
+    LARGE_INTEGER size;
+    ::GetFileSizeEx(m_Files[file], &size);
+    return static_cast<uint64_t>(size.QuadPart);
+#else
+    struct stat fileStat;
+    ::fstat(m_Files[file], &fileStat);
+    return static_cast<uint64_t>(fileStat.st_size);
+#endif
+}
+
+void AsyncFileQueue::Read(uint32_t file, uint64_t offset, uint64_t size, void* destination, std::function<void(bool)> onComplete)
+{
+    auto read = std::make_shared<PendingRead>();
+    read->OnComplete = std::move(onComplete);
+    read->RemainingPieces = static_cast<uint32_t>((size + MAX_PIECE_SIZE - 1) / MAX_PIECE_SIZE);
+    read->Failed = false;
+
+    if (read->RemainingPieces == 0)
+    {
+        // Nothing to read, just report it done on the next ProcessCompletions
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Completed.push_back(read);
+        return;
+    }
+
+    uint8_t* bytes = static_cast<uint8_t*>(destination);
+    for (uint64_t pieceOffset = 0; pieceOffset < size; pieceOffset += MAX_PIECE_SIZE)
+    {
+        uint64_t pieceSize = std::min(MAX_PIECE_SIZE, size - pieceOffset);
+        m_Batch.push_back({ file, offset + pieceOffset, pieceSize, bytes + pieceOffset, read });
+    }
+}
+
+void AsyncFileQueue::Submit()
+{
+    if (m_Batch.empty())
+    {
+        return;
+    }
+
+    // Within a batch, issue in on-disk order
+    std::sort(m_Batch.begin(), m_Batch.end(), [](const Piece& a, const Piece& b)
+    {
+        return a.File != b.File ? a.File < b.File : a.Offset < b.Offset;
+    });
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Queued.insert(m_Queued.end(), std::make_move_iterator(m_Batch.begin()), std::make_move_iterator(m_Batch.end()));
+
+#if defined(_WIN32)
+        // With reads in flight the I/O thread is blocked on the port rather than the condition variable,
+        // without a packet of our own the new batch would wait for the next read to complete
+        if (m_InFlight > 0)
+        {
+            ::PostQueuedCompletionStatus(m_CompletionPort, 0, WAKE_UP_KEY, nullptr);
+        }
+#endif
+    }
+    m_Batch.clear();
+    m_WorkAvailable.notify_all();
+}
+
+uint32_t AsyncFileQueue::ProcessCompletions()
+{
+    std::vector<std::shared_ptr<PendingRead>> completed;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        completed.swap(m_Completed);
+    }
+
+    // Outside the lock, callbacks are allowed to queue more reads
+    for (const std::shared_ptr<PendingRead>& read : completed)
+    {
+        if (read->OnComplete)
+        {
+            read->OnComplete(!read->Failed);
+        }
+    }
+    return static_cast<uint32_t>(completed.size());
+}
+
+void AsyncFileQueue::WaitIdle()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Idle.wait(lock, [this]() { return m_Queued.empty() && m_InFlight == 0; });
+    }
+    ProcessCompletions();
+}
+
+AsyncIOStats AsyncFileQueue::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    AsyncIOStats stats = {};
+    stats.BytesRead = m_BytesRead;
+    stats.NumReads = m_NumReads;
+    stats.BusySeconds = m_BusySeconds;
+    if (m_InFlight > 0)
+    {
+        stats.BusySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - m_BusyStart).count();
+    }
+    stats.BandwidthMBps = stats.BusySeconds > 0.0 ? m_BytesRead / (1024.0 * 1024.0) / stats.BusySeconds : 0.0;
+    stats.AverageQueueDepth = m_NumReads > 0 ? double(m_DepthSamples) / m_NumReads : 0.0;
+    stats.MaxQueueDepth = m_MaxDepth;
+    return stats;
+}
+
+void AsyncFileQueue::ResetStats()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_BytesRead = 0;
+    m_NumReads = 0;
+    m_DepthSamples = 0;
+    m_MaxDepth = 0;
+    m_BusySeconds = 0.0;
+    m_BusyStart = std::chrono::steady_clock::now();
+}
+
+AsyncFileQueue::Piece AsyncFileQueue::BeginNextPiece()
+{
+    Piece piece = std::move(m_Queued.front());
+    m_Queued.pop_front();
+
+    if (m_InFlight++ == 0)
+    {
+        m_BusyStart = std::chrono::steady_clock::now();
+    }
+    ++m_NumReads;
+    m_DepthSamples += m_InFlight;
+    m_MaxDepth = std::max(m_MaxDepth, m_InFlight);
+    return piece;
+}
+
+void AsyncFileQueue::FinishPiece(const Piece& piece, bool success)
+{
+    if (success)
+    {
+        m_BytesRead += piece.Size;
+    }
+
+    piece.Read->Failed |= !success;
+    if (--piece.Read->RemainingPieces == 0)
+    {
+        m_Completed.push_back(piece.Read);
+    }
+
+    if (--m_InFlight == 0)
+    {
+        m_BusySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - m_BusyStart).count();
+        if (m_Queued.empty())
+        {
+            m_Idle.notify_all();
+        }
+    }
+}
+
+#if defined(_WIN32)
+
+void AsyncFileQueue::IOThread()
+{
+    // The OVERLAPPED has to stay alive until the read completes, and we need
+    // to get back to the piece from the pointer the completion port hands us
+    struct OverlappedRead
+    {
+        OVERLAPPED Overlapped; // first member, so the pointers are interchangeable
+        Piece Item;
+    };
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    for (;;)
+    {
+        // Top the queue back up
+        while (m_InFlight < m_QueueDepth && !m_Queued.empty())
+        {
+            auto* read = new OverlappedRead{};
+            read->Item = BeginNextPiece();
+            read->Overlapped.Offset = static_cast<DWORD>(read->Item.Offset);
+            read->Overlapped.OffsetHigh = static_cast<DWORD>(read->Item.Offset >> 32);
+
+            // Even if this completes right away, the completion is still posted to the port
+            if (!::ReadFile(m_Files[read->Item.File], read->Item.Destination, static_cast<DWORD>(read->Item.Size),
+                nullptr, &read->Overlapped) && ::GetLastError() != ERROR_IO_PENDING)
+            {
+                FinishPiece(read->Item, false);
+                delete read;
+            }
+        }
+
+        if (m_InFlight == 0)
+        {
+            if (m_Stopping)
+            {
+                return;
+            }
+            m_WorkAvailable.wait(lock, [this]() { return m_Stopping || !m_Queued.empty(); });
+            continue;
+        }
+
+        lock.unlock();
+        DWORD bytesTransferred = 0;
+        ULONG_PTR key = 0;
+        OVERLAPPED* overlapped = nullptr;
+        BOOL success = ::GetQueuedCompletionStatus(m_CompletionPort, &bytesTransferred, &key, &overlapped, INFINITE);
+        lock.lock();
+
+        // No OVERLAPPED is a wake up from Submit, the loop goes round and issues the new reads
+        if (overlapped)
+        {
+            auto* read = reinterpret_cast<OverlappedRead*>(overlapped);
+            FinishPiece(read->Item, success && bytesTransferred == read->Item.Size);
+            delete read;
+        }
+    }
+}
+
+#else
+
+void AsyncFileQueue::IOThread()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    for (;;)
+    {
+        m_WorkAvailable.wait(lock, [this]() { return m_Stopping || !m_Queued.empty(); });
+        if (m_Queued.empty())
+        {
+            return;
+        }
+
+        Piece piece = BeginNextPiece();
+        int file = m_Files[piece.File];
+        lock.unlock();
+
+        // pread can return less than asked for, keep going until it's all in or we hit the end
+        uint64_t done = 0;
+        while (done < piece.Size)
+        {
+            ssize_t result = ::pread(file, piece.Destination + done, piece.Size - done, static_cast<off_t>(piece.Offset + done));
+            if (result <= 0)
+            {
+                break;
+            }
+            done += static_cast<uint64_t>(result);
+        }
+
+        lock.lock();
+        FinishPiece(piece, done == piece.Size);
+    }
+}
+
+#endif
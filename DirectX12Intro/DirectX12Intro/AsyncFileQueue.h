@@ -0,0 +1,126 @@
+#pragma once
+
+// Asynchronous file read queue
+// A blocking ReadFile per asset means the disk sits idle while we copy to the GPU and vice versa.
+// Instead reads are queued up, sorted by file and offset within each batch so the drive sees
+// mostly sequential access, and kept QueueDepth deep in flight.
+//
+// Backends:
+//   Windows : overlapped ReadFile on an I/O completion port, driven by one I/O thread
+//   Others  : QueueDepth threads doing blocking pread (simple, and good enough for tests and tools)
+//
+// Completion callbacks never run on the I/O threads. They're handed back through ProcessCompletions,
+// which the render thread calls once per frame. Pointing Destination at an UploadRing allocation
+// means the callback can record the CopyBufferRegion/CopyTextureRegion straight away,
+// without any extra copies.
+//
+//   queue.Read(file, offset, size, allocation.CPU, [&](bool success) { commandList->CopyBufferRegion(...); });
+//   queue.Submit();
+//   ...
+//   queue.ProcessCompletions(); // every frame
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct AsyncIOStats
+{
+    uint64_t BytesRead;
+    uint64_t NumReads;         // pieces actually issued to the OS
+    double BusySeconds;        // time with at least one read in flight
+    double BandwidthMBps;      // BytesRead / BusySeconds
+    double AverageQueueDepth;  // reads in flight, sampled every time one is issued
+    uint32_t MaxQueueDepth;
+};
+
+class AsyncFileQueue
+{
+public:
+    explicit AsyncFileQueue(uint32_t queueDepth = 8);
+    ~AsyncFileQueue();
+
+    AsyncFileQueue(const AsyncFileQueue&) = delete;
+    AsyncFileQueue& operator=(const AsyncFileQueue&) = delete;
+
+    // Returns an id to pass to Read. Files stay open until the queue is destroyed.
+    // Throws std::runtime_error if the file can't be opened.
+    uint32_t OpenFile(const std::string& path);
+    uint64_t GetFileSize(uint32_t file) const;
+
+    // Adds a read to the current batch. Nothing is issued until Submit.
+    // onComplete gets false if the read failed or hit the end of the file.
+    void Read(uint32_t file, uint64_t offset, uint64_t size, void* destination, std::function<void(bool)> onComplete);
+
+    // Sorts the current batch by file and offset and hands it to the I/O backend
+    void Submit();
+
+    // Runs the callbacks of every finished read on the calling thread, returns how many ran
+    uint32_t ProcessCompletions();
+
+    // Blocks until everything submitted has finished, then processes the completions
+    void WaitIdle();
+
+    AsyncIOStats GetStats() const;
+    void ResetStats();
+
+private:
+    // Big reads are split up so one large file doesn't monopolize the queue
+    static constexpr uint64_t MAX_PIECE_SIZE = 1024 * 1024;
+
+    struct PendingRead
+    {
+        std::function<void(bool)> OnComplete;
+        uint32_t RemainingPieces;
+        bool Failed;
+    };
+
+    struct Piece
+    {
+        uint32_t File;
+        uint64_t Offset;
+        uint64_t Size;
+        uint8_t* Destination;
+        std::shared_ptr<PendingRead> Read;
+    };
+
+    void IOThread();
+
+    // Both called with m_Mutex held, they keep the in-flight count and the stats up to date
+    Piece BeginNextPiece();
+    void FinishPiece(const Piece& piece, bool success);
+
+    uint32_t m_QueueDepth;
+
+    std::vector<Piece> m_Batch; // not yet submitted, only touched by the owning thread
+    std::deque<Piece> m_Queued; // submitted, waiting for a free slot
+    std::vector<std::shared_ptr<PendingRead>> m_Completed;
+    uint32_t m_InFlight = 0;
+    bool m_Stopping = false;
+
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_WorkAvailable;
+    std::condition_variable m_Idle;
+    std::vector<std::thread> m_Threads;
+
+    // Stats, guarded by m_Mutex
+    uint64_t m_BytesRead = 0;
+    uint64_t m_NumReads = 0;
+    uint64_t m_DepthSamples = 0;
+    uint32_t m_MaxDepth = 0;
+    double m_BusySeconds = 0.0;
+    std::chrono::steady_clock::time_point m_BusyStart;
+
+#if defined(_WIN32)
+    std::vector<void*> m_Files; // HANDLE
+    void* m_CompletionPort = nullptr; // HANDLE
+#else
+    std::vector<int> m_Files;
+#endif
+};
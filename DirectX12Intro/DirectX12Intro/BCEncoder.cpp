@@ -0,0 +1,978 @@
+#include "BCEncoder.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define BC_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // 16 texels stored one array per channel, so 4 texels fit in an SSE register
+    struct Block
+    {
+        alignas(16) float C[4][16];
+    };
+
+    void LoadBlock(const uint8_t pixels[64], Block& block)
+    {
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                block.C[c][i] = pixels[i * 4 + c];
+            }
+        }
+    }
+
+    int Clamp(int value, int low, int high)
+    {
+        return std::min(std::max(value, low), high);
+    }
+
+    // Picks the closest palette entry for every texel over channels [first, first + count).
+    // Returns the total squared error.
+    float SelectIndices(const Block& block, uint32_t first, uint32_t count,
+        const float palette[][4], uint32_t paletteSize, uint8_t indices[16])
+    {
+        float totalError = 0.0f;
+
+#if defined(BC_USE_SSE2)
+        for (uint32_t i = 0; i < 16; i += 4)
+        {
+            __m128 bestError = _mm_set1_ps(FLT_MAX);
+            __m128 bestIndex = _mm_setzero_ps();
+
+            for (uint32_t p = 0; p < paletteSize; ++p)
+            {
+                __m128 error = _mm_setzero_ps();
+                for (uint32_t c = first; c < first + count; ++c)
+                {
+                    __m128 d = _mm_sub_ps(_mm_load_ps(&block.C[c][i]), _mm_set1_ps(palette[p][c]));
+                    error = _mm_add_ps(error, _mm_mul_ps(d, d));
+                }
+
+                // Branchless select of the new index where it's closer
+                __m128 closer = _mm_cmplt_ps(error, bestError);
+                bestError = _mm_min_ps(error, bestError);
+                bestIndex = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps(static_cast<float>(p))), _mm_andnot_ps(closer, bestIndex));
+            }
+
+            alignas(16) float errors[4];
+            alignas(16) float best[4];
+            _mm_store_ps(errors, bestError);
+            _mm_store_ps(best, bestIndex);
+            for (uint32_t j = 0; j < 4; ++j)
+            {
+                indices[i + j] = static_cast<uint8_t>(best[j]);
+                totalError += errors[j];
+            }
+        }
+#else
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            float bestError = FLT_MAX;
+            for (uint32_t p = 0; p < paletteSize; ++p)
+            {
+                float error = 0.0f;
+                for (uint32_t c = first; c < first + count; ++c)
+                {
+                    float d = block.C[c][i] - palette[p][c];
+                    error += d * d;
+                }
+                if (error < bestError)
+                {
+                    bestError = error;
+                    indices[i] = static_cast<uint8_t>(p);
+                }
+            }
+            totalError += bestError;
+        }
+#endif
+
+        return totalError;
+    }
+
+    // Min and max of the texels projected onto axis (relative to mean)
+    void ProjectExtents(const Block& block, uint32_t first, uint32_t count,
+        const float mean[4], const float axis[4], float& minT, float& maxT)
+    {
+#if defined(BC_USE_SSE2)
+        __m128 low = _mm_set1_ps(FLT_MAX);
+        __m128 high = _mm_set1_ps(-FLT_MAX);
+        for (uint32_t i = 0; i < 16; i += 4)
+        {
+            __m128 t = _mm_setzero_ps();
+            for (uint32_t c = first; c < first + count; ++c)
+            {
+                __m128 d = _mm_sub_ps(_mm_load_ps(&block.C[c][i]), _mm_set1_ps(mean[c]));
+                t = _mm_add_ps(t, _mm_mul_ps(d, _mm_set1_ps(axis[c])));
+            }
+            low = _mm_min_ps(low, t);
+            high = _mm_max_ps(high, t);
+        }
+
+        alignas(16) float lows[4];
+        alignas(16) float highs[4];
+        _mm_store_ps(lows, low);
+        _mm_store_ps(highs, high);
+        minT = std::min(std::min(lows[0], lows[1]), std::min(lows[2], lows[3]));
+        maxT = std::max(std::max(highs[0], highs[1]), std::max(highs[2], highs[3]));
+#else
+        minT = FLT_MAX;
+        maxT = -FLT_MAX;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            float t = 0.0f;
+            for (uint32_t c = first; c < first + count; ++c)
+            {
+                t += (block.C[c][i] - mean[c]) * axis[c];
+            }
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+#endif
+    }
+
+    // Initial endpoints a and b for channels [first, first + count)
+    void FindEndpoints(const Block& block, uint32_t first, uint32_t count, BCQuality quality, float a[4], float b[4])
+    {
+        if (quality == BCQuality::Fast)
+        {
+            // Corners of the bounding box, picking the diagonal that follows the channel with the largest range
+            uint32_t widest = first;
+            for (uint32_t c = first; c < first + count; ++c)
+            {
+                a[c] = *std::min_element(block.C[c], block.C[c] + 16);
+                b[c] = *std::max_element(block.C[c], block.C[c] + 16);
+                if (b[c] - a[c] > b[widest] - a[widest])
+                {
+                    widest = c;
+                }
+            }
+
+            auto mean = [&](uint32_t c)
+            {
+                float sum = 0.0f;
+                for (uint32_t i = 0; i < 16; ++i)
+                {
+                    sum += block.C[c][i];
+                }
+                return sum / 16.0f;
+            };
+
+            float widestMean = mean(widest);
+            for (uint32_t c = first; c < first + count; ++c)
+            {
+                float channelMean = mean(c);
+                float covariance = 0.0f;
+                for (uint32_t i = 0; i < 16; ++i)
+                {
+                    covariance += (block.C[c][i] - channelMean) * (block.C[widest][i] - widestMean);
+                }
+                if (covariance < 0.0f)
+                {
+                    std::swap(a[c], b[c]);
+                }
+            }
+            return;
+        }
+
+        // Principal axis of the colors through their mean
+        float mean[4] = {};
+        for (uint32_t c = first; c < first + count; ++c)
+        {
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                mean[c] += block.C[c][i];
+            }
+            mean[c] /= 16.0f;
+        }
+
+        float covariance[4][4] = {};
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            for (uint32_t c0 = first; c0 < first + count; ++c0)
+            {
+                for (uint32_t c1 = first; c1 < first + count; ++c1)
+                {
+                    covariance[c0][c1] += (block.C[c0][i] - mean[c0]) * (block.C[c1][i] - mean[c1]);
+                }
+            }
+        }
+
+        // Power iteration converges on the largest eigenvector
+        float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        for (uint32_t iteration = 0; iteration < 8; ++iteration)
+        {
+            float next[4] = {};
+            float length = 0.0f;
+            for (uint32_t c0 = first; c0 < first + count; ++c0)
+            {
+                for (uint32_t c1 = first; c1 < first + count; ++c1)
+                {
+                    next[c0] += covariance[c0][c1] * axis[c1];
+                }
+                length = std::max(length, std::fabs(next[c0]));
+            }
+
+            if (length < 1e-6f)
+            {
+                break; // flat block, any axis will do
+            }
+            for (uint32_t c = first; c < first + count; ++c)
+            {
+                axis[c] = next[c] / length;
+            }
+        }
+
+        float length = 0.0f;
+        for (uint32_t c = first; c < first + count; ++c)
+        {
+            length += axis[c] * axis[c];
+        }
+        length = std::sqrt(length);
+        for (uint32_t c = first; c < first + count; ++c)
+        {
+            axis[c] /= length;
+        }
+
+        float minT, maxT;
+        ProjectExtents(block, first, count, mean, axis, minT, maxT);
+        for (uint32_t c = first; c < first + count; ++c)
+        {
+            a[c] = mean[c] + axis[c] * minT;
+            b[c] = mean[c] + axis[c] * maxT;
+        }
+    }
+
+    // Least squares endpoints for fixed indices. weights[index] is how far towards b that palette entry is.
+    // Returns false if the indices don't constrain both endpoints (e.g. every texel on one entry).
+    bool FitEndpoints(const Block& block, uint32_t first, uint32_t count,
+        const uint8_t indices[16], const float* weights, float a[4], float b[4])
+    {
+        float alpha2 = 0.0f, beta2 = 0.0f, alphaBeta = 0.0f;
+        float alphaX[4] = {}, betaX[4] = {};
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            float beta = weights[indices[i]];
+            float alpha = 1.0f - beta;
+            alpha2 += alpha * alpha;
+            beta2 += beta * beta;
+            alphaBeta += alpha * beta;
+            for (uint32_t c = first; c < first + count; ++c)
+            {
+                alphaX[c] += alpha * block.C[c][i];
+                betaX[c] += beta * block.C[c][i];
+            }
+        }
+
+        float determinant = alpha2 * beta2 - alphaBeta * alphaBeta;
+        if (std::fabs(determinant) < 1e-6f)
+        {
+            return false;
+        }
+
+        for (uint32_t c = first; c < first + count; ++c)
+        {
+            a[c] = std::min(std::max((alphaX[c] * beta2 - betaX[c] * alphaBeta) / determinant, 0.0f), 255.0f);
+            b[c] = std::min(std::max((betaX[c] * alpha2 - alphaX[c] * alphaBeta) / determinant, 0.0f), 255.0f);
+        }
+        return true;
+    }
+
+    uint32_t GetRefinementPasses(BCQuality quality)
+    {
+        switch (quality)
+        {
+        case BCQuality::Fast:
+            return 0;
+        case BCQuality::Normal:
+            return 1;
+        default:
+            return 4;
+        }
+    }
+
+    // Writes value into a block bit by bit, least significant bit first
+    struct BitWriter
+    {
+        uint8_t* Data;
+        uint32_t Position;
+
+        void Write(uint32_t value, uint32_t numBits)
+        {
+            for (uint32_t i = 0; i < numBits; ++i, ++Position)
+            {
+                if (value & (1u << i))
+                {
+                    Data[Position / 8] |= static_cast<uint8_t>(1u << (Position % 8));
+                }
+            }
+        }
+    };
+
+    struct BitReader
+    {
+        const uint8_t* Data;
+        uint32_t Position;
+
+        uint32_t Read(uint32_t numBits)
+        {
+            uint32_t value = 0;
+            for (uint32_t i = 0; i < numBits; ++i, ++Position)
+            {
+                value |= ((Data[Position / 8] >> (Position % 8)) & 1u) << i;
+            }
+            return value;
+        }
+    };
+
+    // BC1 color block
+
+    uint16_t To565(const float color[4])
+    {
+        int r = Clamp(static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+        int g = Clamp(static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+        int b = Clamp(static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    void From565(uint16_t value, int color[3])
+    {
+        int r = (value >> 11) & 31;
+        int g = (value >> 5) & 63;
+        int b = value & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // Returns the number of opaque entries (3 in the c0 <= c1 mode, where entry 3 is transparent black)
+    uint32_t BuildColorPalette(uint16_t c0, uint16_t c1, bool alwaysFourColors, int palette[4][4])
+    {
+        From565(c0, palette[0]);
+        From565(c1, palette[1]);
+        palette[0][3] = palette[1][3] = palette[2][3] = 255;
+
+        if (c0 > c1 || alwaysFourColors)
+        {
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            palette[3][3] = 255;
+            return 4;
+        }
+
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+        palette[3][3] = 0;
+        return 3;
+    }
+
+    void EncodeColorBlock(const Block& block, BCQuality quality, uint8_t* out)
+    {
+        // How far towards c1 each palette entry is, in the 4 color mode
+        const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+        float a[4], b[4];
+        FindEndpoints(block, 0, 3, quality, a, b);
+
+        uint16_t bestC0 = 0, bestC1 = 0;
+        uint8_t bestIndices[16] = {};
+        float bestError = FLT_MAX;
+
+        for (uint32_t pass = 0; pass <= GetRefinementPasses(quality); ++pass)
+        {
+            uint16_t c0 = To565(a);
+            uint16_t c1 = To565(b);
+            if (c0 < c1)
+            {
+                // Keep c0 > c1 so the block decodes in the 4 color mode
+                std::swap(c0, c1);
+                std::swap(a, b);
+            }
+
+            int palette[4][4];
+            BuildColorPalette(c0, c1, true, palette);
+
+            float paletteF[4][4];
+            for (uint32_t p = 0; p < 4; ++p)
+            {
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    paletteF[p][c] = static_cast<float>(palette[p][c]);
+                }
+            }
+
+            // c0 == c1 would decode in the 3 color mode, so only the first entry can be used
+            uint8_t indices[16];
+            float error = SelectIndices(block, 0, 3, paletteF, c0 == c1 ? 1 : 4, indices);
+            if (error < bestError)
+            {
+                bestError = error;
+                bestC0 = c0;
+                bestC1 = c1;
+                std::memcpy(bestIndices, indices, sizeof(indices));
+            }
+
+            if (error == 0.0f || !FitEndpoints(block, 0, 3, indices, weights, a, b))
+            {
+                break;
+            }
+        }
+
+        out[0] = static_cast<uint8_t>(bestC0);
+        out[1] = static_cast<uint8_t>(bestC0 >> 8);
+        out[2] = static_cast<uint8_t>(bestC1);
+        out[3] = static_cast<uint8_t>(bestC1 >> 8);
+
+        uint32_t packed = 0;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            packed |= static_cast<uint32_t>(bestIndices[i]) << (2 * i);
+        }
+        std::memcpy(out + 4, &packed, sizeof(packed));
+    }
+
+    void DecodeColorBlock(const uint8_t* in, bool alwaysFourColors, uint8_t pixels[64])
+    {
+        uint16_t c0 = static_cast<uint16_t>(in[0] | (in[1] << 8));
+        uint16_t c1 = static_cast<uint16_t>(in[2] | (in[3] << 8));
+
+        int palette[4][4];
+        BuildColorPalette(c0, c1, alwaysFourColors, palette);
+
+        uint32_t packed;
+        std::memcpy(&packed, in + 4, sizeof(packed));
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            uint32_t index = (packed >> (2 * i)) & 3;
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                pixels[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+            }
+        }
+    }
+
+    // BC4 single channel block (also BC3 alpha and the two halves of BC5)
+
+    void BuildChannelPalette(int r0, int r1, int palette[8])
+    {
+        palette[0] = r0;
+        palette[1] = r1;
+        if (r0 > r1)
+        {
+            // 8 value mode
+            for (int i = 1; i < 7; ++i)
+            {
+                palette[i + 1] = ((7 - i) * r0 + i * r1 + 3) / 7;
+            }
+        }
+        else
+        {
+            // 6 value mode, plus exact 0 and 255
+            for (int i = 1; i < 5; ++i)
+            {
+                palette[i + 1] = ((5 - i) * r0 + i * r1 + 2) / 5;
+            }
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    float EvaluateChannelBlock(const Block& block, uint32_t channel, int r0, int r1, uint8_t indices[16])
+    {
+        int palette[8];
+        BuildChannelPalette(r0, r1, palette);
+
+        float paletteF[8][4] = {};
+        for (uint32_t p = 0; p < 8; ++p)
+        {
+            paletteF[p][channel] = static_cast<float>(palette[p]);
+        }
+        return SelectIndices(block, channel, 1, paletteF, 8, indices);
+    }
+
+    void EncodeChannelBlock(const Block& block, uint32_t channel, BCQuality quality, uint8_t* out)
+    {
+        // How far towards r1 each palette entry is, in the 8 value mode
+        const float weights[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+
+        const float* values = block.C[channel];
+        float minValue = *std::min_element(values, values + 16);
+        float maxValue = *std::max_element(values, values + 16);
+
+        int bestR0 = static_cast<int>(maxValue);
+        int bestR1 = static_cast<int>(minValue);
+        uint8_t bestIndices[16];
+        float bestError = EvaluateChannelBlock(block, channel, bestR0, bestR1, bestIndices);
+
+        float a[4] = {}, b[4] = {};
+        a[channel] = maxValue;
+        b[channel] = minValue;
+        uint8_t indices[16];
+        std::memcpy(indices, bestIndices, sizeof(indices));
+
+        for (uint32_t pass = 0; pass < GetRefinementPasses(quality) && bestError > 0.0f; ++pass)
+        {
+            if (!FitEndpoints(block, channel, 1, indices, weights, a, b))
+            {
+                break;
+            }
+
+            int r0 = static_cast<int>(a[channel] + 0.5f);
+            int r1 = static_cast<int>(b[channel] + 0.5f);
+            if (r0 <= r1)
+            {
+                break; // would flip into the 6 value mode
+            }
+
+            float error = EvaluateChannelBlock(block, channel, r0, r1, indices);
+            if (error < bestError)
+            {
+                bestError = error;
+                bestR0 = r0;
+                bestR1 = r1;
+                std::memcpy(bestIndices, indices, sizeof(indices));
+            }
+        }
+
+        if (quality == BCQuality::High && bestError > 0.0f)
+        {
+            // The 6 value mode has exact 0 and 255, which helps blocks with a few extreme texels
+            float low = 255.0f, high = 0.0f;
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                if (values[i] > 0.0f && values[i] < 255.0f)
+                {
+                    low = std::min(low, values[i]);
+                    high = std::max(high, values[i]);
+                }
+            }
+
+            if (low <= high)
+            {
+                int r0 = static_cast<int>(low);
+                int r1 = static_cast<int>(high);
+                float error = EvaluateChannelBlock(block, channel, r0, r1, indices);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    bestR0 = r0;
+                    bestR1 = r1;
+                    std::memcpy(bestIndices, indices, sizeof(indices));
+                }
+            }
+        }
+
+        out[0] = static_cast<uint8_t>(bestR0);
+        out[1] = static_cast<uint8_t>(bestR1);
+
+        uint64_t packed = 0;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            packed |= static_cast<uint64_t>(bestIndices[i]) << (3 * i);
+        }
+        for (uint32_t i = 0; i < 6; ++i)
+        {
+            out[2 + i] = static_cast<uint8_t>(packed >> (8 * i));
+        }
+    }
+
+    void DecodeChannelBlock(const uint8_t* in, uint32_t channel, uint8_t pixels[64])
+    {
+        int palette[8];
+        BuildChannelPalette(in[0], in[1], palette);
+
+        uint64_t packed = 0;
+        for (uint32_t i = 0; i < 6; ++i)
+        {
+            packed |= static_cast<uint64_t>(in[2 + i]) << (8 * i);
+        }
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            pixels[i * 4 + channel] = static_cast<uint8_t>(palette[(packed >> (3 * i)) & 7]);
+        }
+    }
+
+    // BC7 mode 6: one subset, RGBA 7 bit endpoints + a shared p-bit each, 4 bit indices
+
+    const int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    struct BC7Endpoint
+    {
+        int Value[4]; // 7 bits
+        int PBit;
+    };
+
+    BC7Endpoint QuantizeBC7(const float color[4], int pBit)
+    {
+        BC7Endpoint endpoint;
+        endpoint.PBit = pBit;
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            endpoint.Value[c] = Clamp(static_cast<int>((color[c] - pBit) / 2.0f + 0.5f), 0, 127);
+        }
+        return endpoint;
+    }
+
+    int ExpandBC7(const BC7Endpoint& endpoint, uint32_t channel)
+    {
+        return (endpoint.Value[channel] << 1) | endpoint.PBit;
+    }
+
+    // The p-bit that reproduces color best on its own
+    int ChooseBC7PBit(const float color[4])
+    {
+        float errors[2] = {};
+        for (int pBit = 0; pBit < 2; ++pBit)
+        {
+            BC7Endpoint endpoint = QuantizeBC7(color, pBit);
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                float d = ExpandBC7(endpoint, c) - color[c];
+                errors[pBit] += d * d;
+            }
+        }
+        return errors[1] < errors[0] ? 1 : 0;
+    }
+
+    float EvaluateBC7(const Block& block, const BC7Endpoint& e0, const BC7Endpoint& e1, uint8_t indices[16])
+    {
+        float palette[16][4];
+        for (uint32_t p = 0; p < 16; ++p)
+        {
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                palette[p][c] = static_cast<float>(((64 - BC7_WEIGHTS4[p]) * ExpandBC7(e0, c) + BC7_WEIGHTS4[p] * ExpandBC7(e1, c) + 32) >> 6);
+            }
+        }
+        return SelectIndices(block, 0, 4, palette, 16, indices);
+    }
+
+    void EncodeBC7Block(const Block& block, BCQuality quality, uint8_t* out)
+    {
+        float weights[16];
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            weights[i] = BC7_WEIGHTS4[i] / 64.0f;
+        }
+
+        float a[4], b[4];
+        FindEndpoints(block, 0, 4, quality, a, b);
+
+        BC7Endpoint best0 = {}, best1 = {};
+        uint8_t bestIndices[16] = {};
+        float bestError = FLT_MAX;
+
+        for (uint32_t pass = 0; pass <= GetRefinementPasses(quality); ++pass)
+        {
+            uint8_t indices[16];
+
+            if (quality == BCQuality::High)
+            {
+                // Try every p-bit combination
+                for (int p = 0; p < 4; ++p)
+                {
+                    BC7Endpoint e0 = QuantizeBC7(a, p & 1);
+                    BC7Endpoint e1 = QuantizeBC7(b, p >> 1);
+                    float error = EvaluateBC7(block, e0, e1, indices);
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        best0 = e0;
+                        best1 = e1;
+                        std::memcpy(bestIndices, indices, sizeof(indices));
+                    }
+                }
+            }
+            else
+            {
+                BC7Endpoint e0 = QuantizeBC7(a, ChooseBC7PBit(a));
+                BC7Endpoint e1 = QuantizeBC7(b, ChooseBC7PBit(b));
+                float error = EvaluateBC7(block, e0, e1, indices);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best0 = e0;
+                    best1 = e1;
+                    std::memcpy(bestIndices, indices, sizeof(indices));
+                }
+            }
+
+            if (bestError == 0.0f || !FitEndpoints(block, 0, 4, bestIndices, weights, a, b))
+            {
+                break;
+            }
+        }
+
+        // The first index is stored with its top bit implied to be 0, flip the endpoints if it isn't
+        if (bestIndices[0] >= 8)
+        {
+            std::swap(best0, best1);
+            for (uint8_t& index : bestIndices)
+            {
+                index = static_cast<uint8_t>(15 - index);
+            }
+        }
+
+        std::memset(out, 0, 16);
+        BitWriter writer = { out, 0 };
+        writer.Write(1u << 6, 7); // mode 6
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            writer.Write(best0.Value[c], 7);
+            writer.Write(best1.Value[c], 7);
+        }
+        writer.Write(best0.PBit, 1);
+        writer.Write(best1.PBit, 1);
+        writer.Write(bestIndices[0], 3);
+        for (uint32_t i = 1; i < 16; ++i)
+        {
+            writer.Write(bestIndices[i], 4);
+        }
+    }
+
+    void DecodeBC7Block(const uint8_t* in, uint8_t pixels[64])
+    {
+        // Only mode 6 is supported (it's all the encoder writes), anything else decodes to black
+        if ((in[0] & 0x7F) != 0x40)
+        {
+            std::memset(pixels, 0, 64);
+            return;
+        }
+
+        BitReader reader = { in, 7 };
+        BC7Endpoint e0, e1;
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            e0.Value[c] = static_cast<int>(reader.Read(7));
+            e1.Value[c] = static_cast<int>(reader.Read(7));
+        }
+        e0.PBit = static_cast<int>(reader.Read(1));
+        e1.PBit = static_cast<int>(reader.Read(1));
+
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            uint32_t index = reader.Read(i == 0 ? 3 : 4);
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                pixels[i * 4 + c] = static_cast<uint8_t>(((64 - BC7_WEIGHTS4[index]) * ExpandBC7(e0, c) + BC7_WEIGHTS4[index] * ExpandBC7(e1, c) + 32) >> 6);
+            }
+        }
+    }
+
+    // Copies the 4x4 block at (blockX, blockY), repeating the edge texels past the end of the surface
+    void GatherBlock(const BCSurface& surface, uint32_t blockX, uint32_t blockY, uint8_t pixels[64])
+    {
+        for (uint32_t y = 0; y < 4; ++y)
+        {
+            uint32_t sourceY = std::min(blockY * 4 + y, surface.Height - 1);
+            const uint8_t* row = surface.Pixels + sourceY * surface.RowPitch;
+            for (uint32_t x = 0; x < 4; ++x)
+            {
+                uint32_t sourceX = std::min(blockX * 4 + x, surface.Width - 1);
+                std::memcpy(pixels + (y * 4 + x) * 4, row + sourceX * 4, 4);
+            }
+        }
+    }
+}
+
+uint32_t GetBCBlockSize(BCFormat format)
+{
+    return format == BCFormat::BC1 || format == BCFormat::BC4 ? 8 : 16;
+}
+
+uint32_t GetBCNumBlocks(uint32_t size)
+{
+    return std::max(1u, (size + 3) / 4);
+}
+
+void EncodeBCBlock(BCFormat format, BCQuality quality, const uint8_t pixels[64], uint8_t* block)
+{
+    Block texels;
+    LoadBlock(pixels, texels);
+
+    switch (format)
+    {
+    case BCFormat::BC1:
+        EncodeColorBlock(texels, quality, block);
+        break;
+    case BCFormat::BC3:
+        EncodeChannelBlock(texels, 3, quality, block);
+        EncodeColorBlock(texels, quality, block + 8);
+        break;
+    case BCFormat::BC4:
+        EncodeChannelBlock(texels, 0, quality, block);
+        break;
+    case BCFormat::BC5:
+        EncodeChannelBlock(texels, 0, quality, block);
+        EncodeChannelBlock(texels, 1, quality, block + 8);
+        break;
+    case BCFormat::BC7:
+        EncodeBC7Block(texels, quality, block);
+        break;
+    }
+}
+
+void DecodeBCBlock(BCFormat format, const uint8_t* block, uint8_t pixels[64])
+{
+    // Channels a format doesn't store read back as 0 (alpha as 255), same as the GPU
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        pixels[i * 4 + 0] = pixels[i * 4 + 1] = pixels[i * 4 + 2] = 0;
+        pixels[i * 4 + 3] = 255;
+    }
+
+    switch (format)
+    {
+    case BCFormat::BC1:
+        DecodeColorBlock(block, false, pixels);
+        break;
+    case BCFormat::BC3:
+        DecodeColorBlock(block + 8, true, pixels);
+        DecodeChannelBlock(block, 3, pixels);
+        break;
+    case BCFormat::BC4:
+        DecodeChannelBlock(block, 0, pixels);
+        break;
+    case BCFormat::BC5:
+        DecodeChannelBlock(block, 0, pixels);
+        DecodeChannelBlock(block + 8, 1, pixels);
+        break;
+    case BCFormat::BC7:
+        DecodeBC7Block(block, pixels);
+        break;
+    }
+}
+
+std::vector<std::vector<uint8_t>> EncodeBC(BCFormat format, BCQuality quality,
+    const std::vector<BCSurface>& mips, ThreadPool* pool)
+{
+    uint32_t blockSize = GetBCBlockSize(format);
+
+    // One job per row of blocks across all mips, so small mips don't leave threads idle
+    struct Job
+    {
+        uint32_t Mip;
+        uint32_t BlockY;
+    };
+
+    std::vector<std::vector<uint8_t>> output(mips.size());
+    std::vector<Job> jobs;
+    for (uint32_t mip = 0; mip < mips.size(); ++mip)
+    {
+        uint32_t blocksHigh = GetBCNumBlocks(mips[mip].Height);
+        output[mip].resize(size_t(GetBCNumBlocks(mips[mip].Width)) * blocksHigh * blockSize);
+        for (uint32_t y = 0; y < blocksHigh; ++y)
+        {
+            jobs.push_back({ mip, y });
+        }
+    }
+
+    auto encodeRow = [&](uint32_t i)
+    {
+        const BCSurface& surface = mips[jobs[i].Mip];
+        uint32_t blocksWide = GetBCNumBlocks(surface.Width);
+        uint8_t* row = output[jobs[i].Mip].data() + size_t(jobs[i].BlockY) * blocksWide * blockSize;
+
+        uint8_t pixels[64];
+        for (uint32_t x = 0; x < blocksWide; ++x)
+        {
+            GatherBlock(surface, x, jobs[i].BlockY, pixels);
+            EncodeBCBlock(format, quality, pixels, row + x * blockSize);
+        }
+    };
+
+    if (pool)
+    {
+        pool->ParallelFor(static_cast<uint32_t>(jobs.size()), encodeRow);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < jobs.size(); ++i)
+        {
+            encodeRow(i);
+        }
+    }
+
+    return output;
+}
+
+std::vector<uint8_t> DecodeBC(BCFormat format, const uint8_t* blocks, uint32_t width, uint32_t height)
+{
+    std::vector<uint8_t> decoded(size_t(width) * height * 4);
+    uint32_t blockSize = GetBCBlockSize(format);
+    uint32_t blocksWide = GetBCNumBlocks(width);
+
+    uint8_t pixels[64];
+    for (uint32_t by = 0; by < GetBCNumBlocks(height); ++by)
+    {
+        for (uint32_t bx = 0; bx < blocksWide; ++bx)
+        {
+            DecodeBCBlock(format, blocks + (size_t(by) * blocksWide + bx) * blockSize, pixels);
+            for (uint32_t y = 0; y < 4 && by * 4 + y < height; ++y)
+            {
+                for (uint32_t x = 0; x < 4 && bx * 4 + x < width; ++x)
+                {
+                    std::memcpy(&decoded[((size_t(by) * 4 + y) * width + bx * 4 + x) * 4], pixels + (y * 4 + x) * 4, 4);
+                }
+            }
+        }
+    }
+    return decoded;
+}
+
+double ComputeBCPSNR(BCFormat format, const BCSurface& reference, const uint8_t* decoded)
+{
+    uint32_t numChannels = 4;
+    switch (format)
+    {
+    case BCFormat::BC1:
+        numChannels = 3;
+        break;
+    case BCFormat::BC4:
+        numChannels = 1;
+        break;
+    case BCFormat::BC5:
+        numChannels = 2;
+        break;
+    default:
+        break;
+    }
+
+    double squaredError = 0.0;
+    for (uint32_t y = 0; y < reference.Height; ++y)
+    {
+        const uint8_t* referenceRow = reference.Pixels + size_t(y) * reference.RowPitch;
+        const uint8_t* decodedRow = decoded + size_t(y) * reference.Width * 4;
+        for (uint32_t x = 0; x < reference.Width; ++x)
+        {
+            for (uint32_t c = 0; c < numChannels; ++c)
+            {
+                double d = double(referenceRow[x * 4 + c]) - double(decodedRow[x * 4 + c]);
+                squaredError += d * d;
+            }
+        }
+    }
+
+    double meanSquaredError = squaredError / (double(reference.Width) * reference.Height * numChannels);
+    if (meanSquaredError == 0.0)
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// Block compressed (BCn) texture encoder
+// Uncompressed RGBA8 textures cost 4-8x the memory and upload bandwidth of block compressed ones.
+// Every format works on independent 4x4 blocks, so blocks (and mips) are spread across a ThreadPool.
+//
+//   BC1 : RGB, 8 bytes per block       (DXGI_FORMAT_BC1_UNORM)
+//   BC3 : RGBA, 16 bytes, BC4 alpha    (DXGI_FORMAT_BC3_UNORM)
+//   BC4 : R only, 8 bytes              (DXGI_FORMAT_BC4_UNORM)
+//   BC5 : RG, 16 bytes, two BC4 blocks (DXGI_FORMAT_BC5_UNORM, normal maps)
+//   BC7 : RGBA, 16 bytes               (DXGI_FORMAT_BC7_UNORM, mode 6 only for now)
+//
+// Endpoints come from the principal axis of the block's colors and are then refined with a
+// least squares fit against the chosen indices. Index selection and the axis projection are
+// vectorized with SSE2 when available.
+//
+// Input is always RGBA8, channels a format doesn't store are ignored.
+// Output rows are tightly packed (row pitch = blocks wide * block size), the uploader pads them to
+// D3D12_TEXTURE_DATA_PITCH_ALIGNMENT.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+enum class BCFormat
+{
+    BC1,
+    BC3,
+    BC4,
+    BC5,
+    BC7,
+};
+
+// Speed vs quality
+//   Fast   : bounding box endpoints, no refinement
+//   Normal : principal axis endpoints, one refinement pass
+//   High   : principal axis endpoints, several refinement passes, tries every BC4 mode and BC7 p-bit combination
+enum class BCQuality
+{
+    Fast,
+    Normal,
+    High,
+};
+
+// One RGBA8 mip level
+struct BCSurface
+{
+    const uint8_t* Pixels;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t RowPitch; // in bytes
+};
+
+uint32_t GetBCBlockSize(BCFormat format);
+uint32_t GetBCNumBlocks(uint32_t size); // blocks needed to cover size pixels
+
+// Single 4x4 block, pixels are 16 RGBA8 texels in row order
+void EncodeBCBlock(BCFormat format, BCQuality quality, const uint8_t pixels[64], uint8_t* block);
+void DecodeBCBlock(BCFormat format, const uint8_t* block, uint8_t pixels[64]);
+
+// Encodes every mip, spreading rows of blocks across the pool (serially without one).
+// Returns one tightly packed buffer per mip.
+std::vector<std::vector<uint8_t>> EncodeBC(BCFormat format, BCQuality quality,
+    const std::vector<BCSurface>& mips, ThreadPool* pool = nullptr);
+
+// Decodes a whole surface back to RGBA8 (used to measure quality)
+std::vector<uint8_t> DecodeBC(BCFormat format, const uint8_t* blocks, uint32_t width, uint32_t height);
+
+// Peak signal to noise ratio in dB over the channels the format stores
+double ComputeBCPSNR(BCFormat format, const BCSurface& reference, const uint8_t* decoded);
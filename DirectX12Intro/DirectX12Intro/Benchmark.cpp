@@ -0,0 +1,294 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+namespace
+{
+    // Absolute slack on top of the relative tolerance, so metrics near 0 (e.g. a 0.01 ms CPU time) don't flag on noise
+    const double MIN_ABSOLUTE_TOLERANCE = 0.01;
+
+    // Relative tolerance SaveBenchmarkBaseline gives the *_max metrics
+    const double MAX_METRIC_TOLERANCE = 1.0;
+
+    // Triangle wave between 0 and 1 with the given period
+    float Triangle(uint32_t frameIndex, uint32_t period)
+    {
+        float t = static_cast<float>(frameIndex % period) / period;
+        return t < 0.5f ? t * 2.0f : 2.0f - t * 2.0f;
+    }
+
+    BenchmarkFrame ClearFrame(uint32_t)
+    {
+        return { 1280, 720, 1.0f };
+    }
+
+    BenchmarkFrame UpscaleFrame(uint32_t frameIndex)
+    {
+        // Sweeps the whole dynamic resolution range every 4 seconds at 60 Hz
+        return { 1920, 1080, 1.0f - 0.5f * Triangle(frameIndex, 240) };
+    }
+
+    BenchmarkFrame ResizeFrame(uint32_t frameIndex)
+    {
+        static const uint32_t sizes[][2] = { { 1280, 720 }, { 1600, 900 }, { 1920, 1080 }, { 960, 540 } };
+        const uint32_t* size = sizes[(frameIndex / 30) % 4];
+        return { size[0], size[1], 1.0f };
+    }
+
+    std::string Trim(const std::string& text)
+    {
+        size_t first = text.find_first_not_of(" \t\r");
+        size_t last = text.find_last_not_of(" \t\r");
+        return first == std::string::npos ? std::string() : text.substr(first, last - first + 1);
+    }
+
+    // Nearest rank, values must be sorted
+    double Percentile(const std::vector<double>& values, double percentile)
+    {
+        if (values.empty())
+        {
+            return 0.0;
+        }
+        size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0 * values.size()));
+        return values[std::min(values.size() - 1, rank > 0 ? rank - 1 : 0)];
+    }
+
+    void AddStatistics(std::vector<BenchmarkMetric>& summary, const std::string& name, std::vector<double> values)
+    {
+        if (values.empty())
+        {
+            return;
+        }
+
+        std::sort(values.begin(), values.end());
+        double total = 0.0;
+        for (double value : values)
+        {
+            total += value;
+        }
+        summary.push_back({ name + "_avg", total / values.size() });
+        summary.push_back({ name + "_p50", Percentile(values, 50.0) });
+        summary.push_back({ name + "_p95", Percentile(values, 95.0) });
+        summary.push_back({ name + "_p99", Percentile(values, 99.0) });
+        summary.push_back({ name + "_max", values.back() });
+    }
+}
+
+const std::vector<BenchmarkScenario>& GetBenchmarkScenarios()
+{
+    static const std::vector<BenchmarkScenario> scenarios = {
+        { "clear", "Back buffer clear at 1280x720, the fixed cost of a frame", false, &ClearFrame },
+        { "upscale", "Scaled scene target at 1920x1080, render scale sweeping 1.0 -> 0.5 -> 1.0 every 240 frames", true, &UpscaleFrame },
+        { "resize", "Swap chain resized every 30 frames through four sizes", false, &ResizeFrame },
+    };
+    return scenarios;
+}
+
+const BenchmarkScenario* FindBenchmarkScenario(const std::string& name)
+{
+    for (const BenchmarkScenario& scenario : GetBenchmarkScenarios())
+    {
+        if (name == scenario.Name)
+        {
+            return &scenario;
+        }
+    }
+    return nullptr;
+}
+
+BenchmarkRun::BenchmarkRun(const BenchmarkScenario& scenario, uint32_t numWarmupFrames, uint32_t numMeasuredFrames)
+    : m_Scenario(scenario)
+    , m_NumWarmupFrames(numWarmupFrames)
+    , m_NumMeasuredFrames(numMeasuredFrames)
+{
+    m_Samples.reserve(numMeasuredFrames);
+}
+
+void BenchmarkRun::EndFrame(double cpuTimeMs, double memoryMB, uint32_t numDraws, uint32_t numBarriers)
+{
+    if (IsDone())
+    {
+        return;
+    }
+
+    if (!IsWarmup())
+    {
+        m_Samples.push_back({ m_FrameIndex - m_NumWarmupFrames, cpuTimeMs, -1.0, memoryMB, numDraws, numBarriers });
+    }
+    ++m_FrameIndex;
+}
+
+void BenchmarkRun::SetGPUTime(uint32_t frameIndex, double gpuTimeMs)
+{
+    if (frameIndex >= m_NumWarmupFrames && frameIndex - m_NumWarmupFrames < m_Samples.size())
+    {
+        m_Samples[frameIndex - m_NumWarmupFrames].GPUTimeMs = gpuTimeMs;
+    }
+}
+
+std::vector<BenchmarkMetric> BenchmarkRun::GetSummary() const
+{
+    std::vector<double> cpuTimes;
+    std::vector<double> gpuTimes;
+    double peakMemory = 0.0;
+    double totalDraws = 0.0;
+    double totalBarriers = 0.0;
+    for (const BenchmarkSample& sample : m_Samples)
+    {
+        cpuTimes.push_back(sample.CPUTimeMs);
+        if (sample.GPUTimeMs >= 0.0)
+        {
+            gpuTimes.push_back(sample.GPUTimeMs);
+        }
+        peakMemory = std::max(peakMemory, sample.MemoryMB);
+        totalDraws += sample.NumDraws;
+        totalBarriers += sample.NumBarriers;
+    }
+
+    std::vector<BenchmarkMetric> summary;
+    AddStatistics(summary, "cpu_ms", cpuTimes);
+    AddStatistics(summary, "gpu_ms", gpuTimes);
+    if (!m_Samples.empty())
+    {
+        summary.push_back({ "memory_mb_peak", peakMemory });
+        summary.push_back({ "draws_avg", totalDraws / m_Samples.size() });
+        summary.push_back({ "barriers_avg", totalBarriers / m_Samples.size() });
+    }
+    return summary;
+}
+
+void BenchmarkRun::WriteCSV(const std::string& path) const
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        throw std::runtime_error("Failed to open " + path);
+    }
+
+    out << "frame,cpu_ms,gpu_ms,memory_mb,draws,barriers\n";
+    char line[256];
+    for (const BenchmarkSample& sample : m_Samples)
+    {
+        char gpuTime[32] = "";
+        if (sample.GPUTimeMs >= 0.0)
+        {
+            std::snprintf(gpuTime, sizeof(gpuTime), "%.4f", sample.GPUTimeMs);
+        }
+        std::snprintf(line, sizeof(line), "%u,%.4f,%s,%.2f,%u,%u\n", sample.Frame, sample.CPUTimeMs, gpuTime,
+            sample.MemoryMB, sample.NumDraws, sample.NumBarriers);
+        out << line;
+    }
+}
+
+std::string FormatBenchmarkSummary(const std::string& scenario, const std::vector<BenchmarkMetric>& summary)
+{
+    std::string text = "Benchmark " + scenario + ":\n";
+    char line[128];
+    for (const BenchmarkMetric& metric : summary)
+    {
+        std::snprintf(line, sizeof(line), "  %-16s %10.4f\n", metric.Name.c_str(), metric.Value);
+        text += line;
+    }
+    return text;
+}
+
+void SaveBenchmarkBaseline(const std::string& path, const std::vector<BenchmarkMetric>& summary, double tolerance)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        throw std::runtime_error("Failed to open " + path);
+    }
+
+    out << "# Benchmark baseline, a run fails if a metric is worse than this by more than the tolerance\n";
+    char line[128];
+    std::snprintf(line, sizeof(line), "tolerance = %g\n", tolerance);
+    out << line;
+    for (const BenchmarkMetric& metric : summary)
+    {
+        std::snprintf(line, sizeof(line), "%s = %.4f\n", metric.Name.c_str(), metric.Value);
+        out << line;
+
+        // A max is one frame, a single hitch moves it, so it only catches gross regressions
+        if (metric.Name.size() > 4 && metric.Name.compare(metric.Name.size() - 4, 4, "_max") == 0)
+        {
+            std::snprintf(line, sizeof(line), "tolerance.%s = %g\n", metric.Name.c_str(), MAX_METRIC_TOLERANCE);
+            out << line;
+        }
+    }
+}
+
+std::vector<std::string> CheckBenchmarkBaseline(const std::string& path, const std::vector<BenchmarkMetric>& summary)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        throw std::runtime_error("Failed to open " + path);
+    }
+
+    double tolerance = 0.1;
+    std::map<std::string, double> baseline;
+    std::map<std::string, double> tolerances;
+    std::string line;
+    uint32_t lineNumber = 0;
+    while (std::getline(in, line))
+    {
+        ++lineNumber;
+        line = Trim(line.substr(0, line.find('#')));
+        if (line.empty())
+        {
+            continue;
+        }
+
+        size_t equals = line.find('=');
+        char* end = nullptr;
+        std::string value = equals == std::string::npos ? std::string() : Trim(line.substr(equals + 1));
+        double number = std::strtod(value.c_str(), &end);
+        if (equals == std::string::npos || value.empty() || *end != '\0')
+        {
+            throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": expected metric = number");
+        }
+
+        std::string name = Trim(line.substr(0, equals));
+        if (name == "tolerance")
+        {
+            tolerance = number;
+        }
+        else if (name.compare(0, 10, "tolerance.") == 0)
+        {
+            tolerances[name.substr(10)] = number;
+        }
+        else
+        {
+            baseline[name] = number;
+        }
+    }
+
+    std::vector<std::string> regressions;
+    for (const BenchmarkMetric& metric : summary)
+    {
+        auto it = baseline.find(metric.Name);
+        if (it == baseline.end())
+        {
+            continue;
+        }
+
+        auto metricTolerance = tolerances.find(metric.Name);
+        double relative = metricTolerance != tolerances.end() ? metricTolerance->second : tolerance;
+        double limit = it->second * (1.0 + relative) + MIN_ABSOLUTE_TOLERANCE;
+        if (metric.Value > limit)
+        {
+            char message[256];
+            std::snprintf(message, sizeof(message), "%s: %.4f, baseline %.4f (+%.0f%% allowed), %+.1f%%", metric.Name.c_str(),
+                metric.Value, it->second, relative * 100.0, it->second > 0.0 ? (metric.Value / it->second - 1.0) * 100.0 : 0.0);
+            regressions.push_back(message);
+        }
+    }
+    return regressions;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+// Benchmark mode (--benchmark <scenario>)
+// Runs a scripted scene for a fixed number of warm up frames, then a fixed number of measured frames,
+// with vsync and the frame cap off, so two builds can be compared frame for frame.
+// Everything a scenario does is a function of the frame index alone (never of time), so every run
+// renders exactly the same frames.
+//
+// Per measured frame: CPU time, GPU time, memory and draw/barrier counts, written out as CSV.
+// The summary (averages, percentiles, peaks) can be saved as a baseline file and later runs checked
+// against it: any metric worse than the baseline by more than its tolerance is a regression.
+//
+// Baseline file: "metric = value" per line, # comments, plus "tolerance = 0.1" (relative, for all metrics)
+// and optionally "tolerance.<metric> = 0.25" for noisier ones (a saved baseline does that for the *_max metrics).
+// All metrics are lower-is-better.
+//
+// Only uses the STL, the app fills in the numbers from D3D12 and RuntimeBench from a null backend.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What the script wants for one frame
+struct BenchmarkFrame
+{
+    uint32_t Width;    // back buffer size, a change resizes the swap chain
+    uint32_t Height;
+    float RenderScale; // only with ScaledRendering
+};
+
+struct BenchmarkScenario
+{
+    const char* Name;
+    const char* Description;
+    bool ScaledRendering; // render through the ScaledRenderTarget and upscale, like dynamic resolution
+    BenchmarkFrame (*GetFrame)(uint32_t frameIndex);
+};
+
+const std::vector<BenchmarkScenario>& GetBenchmarkScenarios();
+const BenchmarkScenario* FindBenchmarkScenario(const std::string& name);
+
+struct BenchmarkSample
+{
+    uint32_t Frame;    // measured frame, 0 is the first after the warm up
+    double CPUTimeMs;
+    double GPUTimeMs;  // < 0 if it never came back
+    double MemoryMB;
+    uint32_t NumDraws;
+    uint32_t NumBarriers;
+};
+
+struct BenchmarkMetric
+{
+    std::string Name; // e.g. cpu_ms_p95
+    double Value;
+};
+
+class BenchmarkRun
+{
+public:
+    BenchmarkRun(const BenchmarkScenario& scenario, uint32_t numWarmupFrames, uint32_t numMeasuredFrames);
+
+    const BenchmarkScenario& GetScenario() const { return m_Scenario; }
+
+    // Index of the frame being recorded, warm up frames included
+    uint32_t GetFrameIndex() const { return m_FrameIndex; }
+    bool IsWarmup() const { return m_FrameIndex < m_NumWarmupFrames; }
+    bool IsDone() const { return m_FrameIndex >= m_NumWarmupFrames + m_NumMeasuredFrames; }
+
+    BenchmarkFrame GetFrame() const { return m_Scenario.GetFrame(m_FrameIndex); }
+
+    // The current frame was submitted. Its GPU time usually isn't known yet, it comes later through
+    // SetGPUTime with the index GetFrameIndex returned for it.
+    void EndFrame(double cpuTimeMs, double memoryMB, uint32_t numDraws, uint32_t numBarriers);
+    void SetGPUTime(uint32_t frameIndex, double gpuTimeMs);
+
+    // Measured frames only
+    const std::vector<BenchmarkSample>& GetSamples() const { return m_Samples; }
+
+    std::vector<BenchmarkMetric> GetSummary() const;
+
+    // Throws std::runtime_error if the file can't be written
+    void WriteCSV(const std::string& path) const;
+
+private:
+    const BenchmarkScenario& m_Scenario;
+    uint32_t m_NumWarmupFrames;
+    uint32_t m_NumMeasuredFrames;
+    uint32_t m_FrameIndex = 0;
+    std::vector<BenchmarkSample> m_Samples;
+};
+
+std::string FormatBenchmarkSummary(const std::string& scenario, const std::vector<BenchmarkMetric>& summary);
+
+// Throw std::runtime_error if the file can't be written / read or parsed
+void SaveBenchmarkBaseline(const std::string& path, const std::vector<BenchmarkMetric>& summary, double tolerance = 0.1);
+
+// One line per metric that regressed, empty if none did. Metrics missing on either side are skipped.
+std::vector<std::string> CheckBenchmarkBaseline(const std::string& path, const std::vector<BenchmarkMetric>& summary);
@@ -0,0 +1,269 @@
+#include "CaptureQueue.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+bool WriteCaptureTGA(const CapturedFrame& frame)
+{
+    const CaptureDesc& desc = *frame.Desc;
+    if (desc.Width > 0xFFFF || desc.Height > 0xFFFF)
+    {
+        return false;
+    }
+
+    std::ofstream file(desc.Path, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    // Uncompressed true color, 8 bits of alpha, top left origin
+    uint8_t header[18] = {};
+    header[2] = 2;
+    header[12] = static_cast<uint8_t>(desc.Width);
+    header[13] = static_cast<uint8_t>(desc.Width >> 8);
+    header[14] = static_cast<uint8_t>(desc.Height);
+    header[15] = static_cast<uint8_t>(desc.Height >> 8);
+    header[16] = 32;
+    header[17] = 0x28;
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    // TGA stores BGRA
+    std::vector<uint8_t> row(desc.Width * 4);
+    for (uint32_t y = 0; y < desc.Height; ++y)
+    {
+        const uint8_t* source = frame.Pixels + uint64_t(y) * desc.RowPitch;
+        if (desc.Format == CaptureFormat::BGRA8)
+        {
+            file.write(reinterpret_cast<const char*>(source), row.size());
+            continue;
+        }
+        for (uint32_t x = 0; x < desc.Width; ++x)
+        {
+            row[x * 4 + 0] = source[x * 4 + 2];
+            row[x * 4 + 1] = source[x * 4 + 1];
+            row[x * 4 + 2] = source[x * 4 + 0];
+            row[x * 4 + 3] = source[x * 4 + 3];
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+    return static_cast<bool>(file);
+}
+
+CaptureQueue::CaptureQueue(ICaptureBackend& backend, uint32_t maxBuffers, CaptureEncoder encoder)
+    : m_Backend(backend)
+    , m_MaxBuffers(std::max(1u, maxBuffers))
+    , m_Encoder(std::move(encoder))
+{
+    // The worker holds on to buffers while Request adds more, they can't move
+    m_Buffers.reserve(m_MaxBuffers);
+    m_Thread = std::thread(&CaptureQueue::WorkerThread, this);
+}
+
+CaptureQueue::~CaptureQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_WorkAvailable.notify_all();
+    m_Thread.join();
+
+    for (uint32_t i = 0; i < m_Buffers.size(); ++i)
+    {
+        if (m_Buffers[i].State == BufferState::Encoding)
+        {
+            m_Backend.UnmapBuffer(i);
+        }
+    }
+}
+
+bool CaptureQueue::Request(const CaptureDesc& desc, uint32_t& buffer)
+{
+    if (desc.RowPitch < desc.Width * 4)
+    {
+        throw std::runtime_error("Capture row pitch " + std::to_string(desc.RowPitch) + " is smaller than a row of " +
+            std::to_string(desc.Width) + " pixels");
+    }
+    ++m_Requested;
+    uint64_t size = uint64_t(desc.RowPitch) * desc.Height;
+
+    // The smallest free buffer that fits, else a free one to grow, else a new one
+    uint32_t found = UINT32_MAX;
+    uint32_t tooSmall = UINT32_MAX;
+    for (uint32_t i = 0; i < m_Buffers.size(); ++i)
+    {
+        const Buffer& candidate = m_Buffers[i];
+        if (candidate.State != BufferState::Free)
+        {
+            continue;
+        }
+        if (candidate.Size >= size)
+        {
+            if (found == UINT32_MAX || candidate.Size < m_Buffers[found].Size)
+            {
+                found = i;
+            }
+        }
+        else
+        {
+            tooSmall = i;
+        }
+    }
+
+    if (found == UINT32_MAX)
+    {
+        if (tooSmall != UINT32_MAX)
+        {
+            found = tooSmall;
+        }
+        else if (m_Buffers.size() < m_MaxBuffers)
+        {
+            found = static_cast<uint32_t>(m_Buffers.size());
+            m_Buffers.emplace_back();
+        }
+        else
+        {
+            ++m_Dropped;
+            return false;
+        }
+        m_Backend.CreateBuffer(found, size);
+        m_Buffers[found].Size = size;
+    }
+
+    Buffer& chosen = m_Buffers[found];
+    chosen.State = BufferState::Copying;
+    chosen.FenceValue = 0;
+    chosen.Desc = desc;
+    chosen.Number = m_Requested - 1;
+    m_Copying.push_back(found);
+
+    buffer = found;
+    return true;
+}
+
+void CaptureQueue::FinishFrame(uint64_t fenceValue)
+{
+    for (uint32_t index : m_Copying)
+    {
+        Buffer& buffer = m_Buffers[index];
+        if (buffer.FenceValue == 0)
+        {
+            buffer.FenceValue = fenceValue;
+            buffer.FinishedAtUpdate = m_NumUpdates;
+        }
+    }
+}
+
+void CaptureQueue::Update(uint64_t completedFenceValue)
+{
+    ++m_NumUpdates;
+
+    // What the worker finished goes back to the pool
+    std::vector<uint32_t> done;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        done.swap(m_Done);
+    }
+    for (uint32_t index : done)
+    {
+        m_Backend.UnmapBuffer(index);
+        m_Buffers[index].State = BufferState::Free;
+        m_Buffers[index].Pixels = nullptr;
+    }
+
+    // Copies complete in request order, fence values only go up
+    uint32_t numQueued = 0;
+    while (!m_Copying.empty())
+    {
+        uint32_t index = m_Copying.front();
+        Buffer& buffer = m_Buffers[index];
+        if (buffer.FenceValue == 0 || buffer.FenceValue > completedFenceValue)
+        {
+            break;
+        }
+        m_Copying.pop_front();
+
+        buffer.Pixels = m_Backend.MapBuffer(index);
+        buffer.State = BufferState::Encoding;
+
+        uint32_t latency = m_NumUpdates - buffer.FinishedAtUpdate;
+        m_LatencyFrames += latency;
+        m_MaxLatencyFrames = std::max(m_MaxLatencyFrames, latency);
+        ++m_NumMapped;
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Queued.push_back(index);
+        ++m_Busy;
+        ++numQueued;
+    }
+
+    if (numQueued > 0)
+    {
+        m_WorkAvailable.notify_one();
+    }
+}
+
+void CaptureQueue::Flush(uint64_t completedFenceValue)
+{
+    Update(completedFenceValue);
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Idle.wait(lock, [this]() { return m_Busy == 0; });
+    }
+    Update(completedFenceValue);
+}
+
+CaptureStats CaptureQueue::GetStats() const
+{
+    CaptureStats stats = {};
+    stats.Requested = m_Requested;
+    stats.Dropped = m_Dropped;
+    stats.NumBuffers = static_cast<uint32_t>(m_Buffers.size());
+    for (const Buffer& buffer : m_Buffers)
+    {
+        stats.BufferBytes += buffer.Size;
+    }
+    stats.MaxLatencyFrames = m_MaxLatencyFrames;
+    stats.AverageLatencyFrames = m_NumMapped ? double(m_LatencyFrames) / m_NumMapped : 0.0;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    stats.Encoded = m_Encoded;
+    stats.Failed = m_Failed;
+    stats.AverageEncodeMs = m_Encoded + m_Failed ? m_EncodeSeconds * 1000.0 / double(m_Encoded + m_Failed) : 0.0;
+    return stats;
+}
+
+void CaptureQueue::WorkerThread()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    for (;;)
+    {
+        m_WorkAvailable.wait(lock, [this]() { return m_Stopping || !m_Queued.empty(); });
+        if (m_Queued.empty())
+        {
+            return; // stopping, and everything handed over is encoded
+        }
+
+        uint32_t index = m_Queued.front();
+        m_Queued.pop_front();
+        const Buffer& buffer = m_Buffers[index];
+        CapturedFrame frame = { &buffer.Desc, buffer.Pixels, buffer.Number };
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        bool encoded = m_Encoder(frame);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        lock.lock();
+        m_Done.push_back(index);
+        --m_Busy;
+        ++(encoded ? m_Encoded : m_Failed);
+        m_EncodeSeconds += seconds;
+        if (m_Busy == 0)
+        {
+            m_Idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+// Frame capture without stalls (screenshots, recording)
+// Reading a texture back the simple way means a copy, a full GPU flush and then the map. Instead each capture copies
+// into one of a pool of readback buffers and the render thread moves on. Once the fence of the frame that recorded
+// the copy has completed, a few frames later, the buffer is mapped and handed to a worker thread that encodes it
+// (to a .tga file unless told otherwise). The buffer goes back to the pool when the worker is done:
+//
+//   Request     : a free buffer big enough for the capture, the caller records the copy into it. When every buffer is
+//                 still busy the capture is dropped rather than waited for.
+//   FinishFrame : the copies requested since the last call are done when the GPU reaches fenceValue
+//   Update      : every frame, maps the buffers whose fence has completed and queues them for the worker, returns
+//                 the ones it's done with. Never waits for either.
+//
+// The buffers themselves come from an ICaptureBackend: FrameCapture records the copies with CopyTextureRegion into
+// READBACK heap buffers, RuntimeBench capture runs this against a fake GPU and fence.
+// Only uses the STL.
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class CaptureFormat
+{
+    RGBA8,
+    BGRA8,
+};
+
+struct CaptureDesc
+{
+    uint32_t Width;
+    uint32_t Height;
+    CaptureFormat Format;
+    uint32_t RowPitch; // bytes from one row to the next in the buffer, D3D12 pads rows to 256 bytes
+    std::string Path;  // for the encoder
+};
+
+// What the encoder gets, Pixels stays valid until it returns
+struct CapturedFrame
+{
+    const CaptureDesc* Desc;
+    const uint8_t* Pixels;
+    uint64_t Number; // captures requested before this one
+};
+
+// Returns false if it failed, counted in CaptureStats::Failed
+using CaptureEncoder = std::function<bool(const CapturedFrame& frame)>;
+
+// 32 bit uncompressed TGA, top row first, the default encoder
+bool WriteCaptureTGA(const CapturedFrame& frame);
+
+class ICaptureBackend
+{
+public:
+    virtual ~ICaptureBackend() = default;
+
+    // (Re)creates buffer index with room for size bytes
+    virtual void CreateBuffer(uint32_t index, uint64_t size) = 0;
+
+    // Only called once the copy into the buffer has completed, the pointer is used on the worker thread until Unmap
+    virtual const uint8_t* MapBuffer(uint32_t index) = 0;
+    virtual void UnmapBuffer(uint32_t index) = 0;
+};
+
+struct CaptureStats
+{
+    uint64_t Requested;
+    uint64_t Dropped;        // no free buffer
+    uint64_t Encoded;
+    uint64_t Failed;         // the encoder returned false
+    uint32_t NumBuffers;
+    uint64_t BufferBytes;
+    uint32_t MaxLatencyFrames;   // from FinishFrame to the map, in Update calls
+    double AverageLatencyFrames;
+    double AverageEncodeMs;      // on the worker
+};
+
+class CaptureQueue
+{
+public:
+    // Starts the worker thread. backend outlives the queue.
+    CaptureQueue(ICaptureBackend& backend, uint32_t maxBuffers, CaptureEncoder encoder = WriteCaptureTGA);
+    ~CaptureQueue(); // waits for the worker to finish what Update already handed it, drops what wasn't mapped yet
+
+    CaptureQueue(const CaptureQueue&) = delete;
+    CaptureQueue& operator=(const CaptureQueue&) = delete;
+
+    // Returns false if the capture is dropped, otherwise the buffer to copy into (at offset 0, desc.RowPitch apart).
+    // Throws std::runtime_error if desc.RowPitch can't hold a row.
+    bool Request(const CaptureDesc& desc, uint32_t& buffer);
+    void FinishFrame(uint64_t fenceValue);
+    void Update(uint64_t completedFenceValue);
+
+    // Blocks until every capture whose fence has completed is encoded. For shutdown and tests, not per frame.
+    void Flush(uint64_t completedFenceValue);
+
+    CaptureStats GetStats() const;
+
+private:
+    enum class BufferState
+    {
+        Free,
+        Copying,  // the GPU may still be writing it
+        Encoding, // mapped, the worker has it
+    };
+
+    struct Buffer
+    {
+        BufferState State = BufferState::Free;
+        uint64_t Size = 0;
+        uint64_t FenceValue = 0; // 0 until FinishFrame
+        uint32_t FinishedAtUpdate = 0;
+        CaptureDesc Desc;
+        uint64_t Number = 0;
+        const uint8_t* Pixels = nullptr;
+    };
+
+    void WorkerThread();
+
+    ICaptureBackend& m_Backend;
+    uint32_t m_MaxBuffers;
+    CaptureEncoder m_Encoder;
+
+    // Render thread only
+    std::vector<Buffer> m_Buffers;
+    std::deque<uint32_t> m_Copying; // in request order
+    uint32_t m_NumUpdates = 0;
+    uint64_t m_Requested = 0;
+    uint64_t m_Dropped = 0;
+    uint64_t m_LatencyFrames = 0;
+    uint64_t m_NumMapped = 0;
+    uint32_t m_MaxLatencyFrames = 0;
+
+    // Shared with the worker
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_WorkAvailable;
+    std::condition_variable m_Idle;
+    std::deque<uint32_t> m_Queued;  // mapped, waiting for the worker
+    std::vector<uint32_t> m_Done;   // encoded, waiting for Update to unmap them
+    uint32_t m_Busy = 0;            // queued or being encoded
+    bool m_Stopping = false;
+    uint64_t m_Encoded = 0;
+    uint64_t m_Failed = 0;
+    double m_EncodeSeconds = 0.0;
+
+    std::thread m_Thread;
+};
@@ -0,0 +1,195 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+DynamicResolutionController::DynamicResolutionController(const DynamicResolutionSettings& settings)
+{
+    SetSettings(settings);
+    Reset();
+}
+
+void DynamicResolutionController::SetSettings(const DynamicResolutionSettings& settings)
+{
+    m_Settings = settings;
+    m_Settings.MinScale = std::min(std::max(m_Settings.MinScale, 0.01f), 1.0f);
+    m_Settings.MaxScale = std::max(m_Settings.MaxScale, m_Settings.MinScale);
+
+    m_Scale = std::min(std::max(m_Scale, m_Settings.MinScale), m_Settings.MaxScale);
+    m_PixelFraction = double(m_Scale) * m_Scale;
+}
+
+void DynamicResolutionController::Reset()
+{
+    m_Scale = m_Settings.MaxScale;
+    m_PixelFraction = double(m_Scale) * m_Scale;
+    m_PreviousError = 0.0;
+    m_PreviousError2 = 0.0;
+    m_FramesWithHeadroom = 0;
+}
+
+float DynamicResolutionController::Update(double gpuFrameTimeMs)
+{
+    const DynamicResolutionSettings& settings = m_Settings;
+    double minFraction = double(settings.MinScale) * settings.MinScale;
+    double maxFraction = double(settings.MaxScale) * settings.MaxScale;
+
+    double frameTime = std::max(gpuFrameTimeMs, 0.001);
+    double budget = settings.TargetFrameTimeMs;
+
+    if (frameTime > budget * settings.PanicThreshold)
+    {
+        // Way over, assume time is proportional to pixels and cut straight to what should fit.
+        // The PID history is from a different load, drop it.
+        m_PixelFraction *= budget / frameTime;
+        m_PreviousError = 0.0;
+        m_PreviousError2 = 0.0;
+    }
+    else
+    {
+        double error = (budget - frameTime) / budget; // > 0 when there is headroom
+        if (std::abs(error) < settings.Deadband)
+        {
+            error = 0.0;
+        }
+
+        // Velocity form: computes the change rather than the value, so clamping the value below
+        // is all the anti-windup needed
+        double change = settings.Kp * (error - m_PreviousError)
+            + settings.Ki * error
+            + settings.Kd * (error - 2.0 * m_PreviousError + m_PreviousError2);
+        m_PreviousError2 = m_PreviousError;
+        m_PreviousError = error;
+
+        // Relative, a step means the same at 50% scale as at 100%
+        m_PixelFraction *= std::min(std::max(1.0 + change, 0.5), 2.0);
+    }
+    m_PixelFraction = std::min(std::max(m_PixelFraction, minFraction), maxFraction);
+
+    // Hysteresis between what the controller wants and what gets used
+    float wanted = static_cast<float>(std::sqrt(m_PixelFraction));
+    if (m_PixelFraction <= minFraction)
+    {
+        wanted = settings.MinScale; // exactly, so the limit checks below hold
+    }
+    else if (m_PixelFraction >= maxFraction)
+    {
+        wanted = settings.MaxScale;
+    }
+
+    if (wanted <= m_Scale - settings.MinScaleChange || (wanted < m_Scale && wanted == settings.MinScale))
+    {
+        m_Scale = wanted;
+        m_FramesWithHeadroom = 0;
+    }
+    else if (wanted >= m_Scale + settings.MinScaleChange || (wanted > m_Scale && wanted == settings.MaxScale))
+    {
+        if (++m_FramesWithHeadroom >= settings.UpscaleDelayFrames)
+        {
+            m_Scale = wanted;
+            m_FramesWithHeadroom = 0;
+        }
+    }
+    else
+    {
+        m_FramesWithHeadroom = 0;
+    }
+
+    return m_Scale;
+}
+
+void SaveDynamicResolutionTrace(const std::string& path, const std::vector<DynamicResolutionTraceFrame>& frames)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        throw std::runtime_error("Failed to open " + path);
+    }
+
+    out << "# scale,gpu_ms\n";
+    char line[64];
+    for (const DynamicResolutionTraceFrame& frame : frames)
+    {
+        std::snprintf(line, sizeof(line), "%.9g,%.17g\n", frame.Scale, frame.GPUTimeMs);
+        out << line;
+    }
+}
+
+std::vector<DynamicResolutionTraceFrame> LoadDynamicResolutionTrace(const std::string& path)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        throw std::runtime_error("Failed to open " + path);
+    }
+
+    std::vector<DynamicResolutionTraceFrame> frames;
+    std::string line;
+    uint32_t lineNumber = 0;
+    while (std::getline(in, line))
+    {
+        ++lineNumber;
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        DynamicResolutionTraceFrame frame = {};
+        if (std::sscanf(line.c_str(), "%f,%lf", &frame.Scale, &frame.GPUTimeMs) != 2 || frame.Scale <= 0.0f || frame.GPUTimeMs < 0.0)
+        {
+            throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": expected scale,gpu_ms");
+        }
+        frames.push_back(frame);
+    }
+    return frames;
+}
+
+DynamicResolutionReplayResult ReplayDynamicResolutionTrace(const std::vector<DynamicResolutionTraceFrame>& trace,
+    const DynamicResolutionSettings& settings, double fixedFraction)
+{
+    auto costAtScale = [fixedFraction](float scale)
+    {
+        return fixedFraction + (1.0 - fixedFraction) * scale * scale;
+    };
+
+    DynamicResolutionController controller(settings);
+    DynamicResolutionReplayResult result = {};
+    result.Frames.reserve(trace.size());
+    result.MinScale = controller.GetScale();
+
+    double totalScale = 0.0;
+    double totalTime = 0.0;
+    float scale = controller.GetScale();
+    for (const DynamicResolutionTraceFrame& recorded : trace)
+    {
+        double fullResolutionMs = recorded.GPUTimeMs / costAtScale(recorded.Scale);
+        double frameTime = fullResolutionMs * costAtScale(scale);
+        result.Frames.push_back({ scale, frameTime });
+
+        totalScale += scale;
+        totalTime += frameTime;
+        result.MaxGPUTimeMs = std::max(result.MaxGPUTimeMs, frameTime);
+        result.MinScale = std::min(result.MinScale, scale);
+        if (frameTime > settings.TargetFrameTimeMs)
+        {
+            ++result.NumOverBudget;
+        }
+
+        float next = controller.Update(frameTime);
+        if (next != scale)
+        {
+            ++result.NumScaleChanges;
+        }
+        scale = next;
+    }
+
+    if (!trace.empty())
+    {
+        result.AverageScale = totalScale / trace.size();
+        result.AverageGPUTimeMs = totalTime / trace.size();
+    }
+    return result;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+// Dynamic resolution scaling
+// When the GPU can't make its frame budget we'd rather render fewer pixels than drop a frame.
+// The controller looks at each frame's measured GPU time and picks the render scale (per axis)
+// for the next one. ScaledRenderTarget does the rendering side: a target allocated once at the
+// maximum scale, drawn into through a smaller viewport and upscaled to the back buffer.
+//
+// Control loop:
+//   the controlled value is the fraction of pixels rendered (scale^2), which GPU time is roughly proportional to
+//   a velocity form PID on the relative error (budget - time) / budget nudges it every frame,
+//     errors inside the deadband count as 0 so noise around the budget doesn't move anything
+//   frames far over budget skip the PID and cut the pixel count in proportion straight away
+//   the scale actually used only follows the controller once it has moved by MinScaleChange,
+//     immediately when going down, after UpscaleDelayFrames frames of headroom when going up
+//
+// Traces of (scale, GPU time) per frame can be recorded from the app and replayed offline against
+// any settings, closed loop, so the tuning can be iterated on without a GPU.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct DynamicResolutionSettings
+{
+    double TargetFrameTimeMs = 15.0; // GPU budget, leave some room under the refresh period
+    float MinScale = 0.5f;
+    float MaxScale = 1.0f;
+
+    // Gains of the velocity form PID
+    double Kp = 0.15;
+    double Ki = 0.1;
+    double Kd = 0.05;
+
+    double Deadband = 0.05;          // relative error ignored around the budget
+    float MinScaleChange = 0.025f;   // smaller changes of the scale aren't applied
+    uint32_t UpscaleDelayFrames = 10; // frames of continuous headroom before the scale goes up
+    double PanicThreshold = 1.5;     // frame time / budget above which the PID is bypassed
+};
+
+class DynamicResolutionController
+{
+public:
+    explicit DynamicResolutionController(const DynamicResolutionSettings& settings = DynamicResolutionSettings());
+
+    // Feed the GPU time of the last completed frame, returns the scale to render the next one at
+    float Update(double gpuFrameTimeMs);
+
+    float GetScale() const { return m_Scale; }
+    const DynamicResolutionSettings& GetSettings() const { return m_Settings; }
+
+    // Takes effect from the next Update, the current scale is kept (within the new limits)
+    void SetSettings(const DynamicResolutionSettings& settings);
+
+    // Back to MaxScale with no history
+    void Reset();
+
+private:
+    DynamicResolutionSettings m_Settings;
+
+    double m_PixelFraction = 1.0; // what the controller wants, continuous
+    float m_Scale = 1.0f;         // what is actually used
+    double m_PreviousError = 0.0;
+    double m_PreviousError2 = 0.0;
+    uint32_t m_FramesWithHeadroom = 0;
+};
+
+// Traces
+
+struct DynamicResolutionTraceFrame
+{
+    float Scale;      // scale the frame was rendered at
+    double GPUTimeMs; // GPU time it took
+};
+
+// One "scale,gpu_ms" line per frame, lines starting with # are comments.
+// Throw std::runtime_error if the file can't be opened or parsed.
+void SaveDynamicResolutionTrace(const std::string& path, const std::vector<DynamicResolutionTraceFrame>& frames);
+std::vector<DynamicResolutionTraceFrame> LoadDynamicResolutionTrace(const std::string& path);
+
+struct DynamicResolutionReplayResult
+{
+    std::vector<DynamicResolutionTraceFrame> Frames; // what the replayed controller did
+    uint32_t NumOverBudget;
+    uint32_t NumScaleChanges;
+    double AverageScale;
+    float MinScale;
+    double AverageGPUTimeMs;
+    double MaxGPUTimeMs;
+};
+
+// Replays a recorded trace against new settings.
+// GPU time is modelled as fixedFraction of the full resolution cost that doesn't scale with the pixel count,
+// plus the rest which does. Each recorded frame is first converted back to its full resolution cost with that
+// model, then re-timed at whatever scale the replayed controller picks, so its decisions feed back into later frames.
+DynamicResolutionReplayResult ReplayDynamicResolutionTrace(const std::vector<DynamicResolutionTraceFrame>& trace,
+    const DynamicResolutionSettings& settings, double fixedFraction = 0.2);
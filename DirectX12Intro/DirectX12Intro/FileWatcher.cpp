@@ -0,0 +1,231 @@
+#include "FileWatcher.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h> // ReadDirectoryChangesW
+#else
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <set>
+#include <stdexcept>
+
+namespace
+{
+    std::string TrimDirectory(const std::string& directory)
+    {
+        std::string path = directory;
+        std::replace(path.begin(), path.end(), '\\', '/');
+        while (path.size() > 1 && path.back() == '/')
+        {
+            path.pop_back();
+        }
+        return path.empty() ? "." : path;
+    }
+}
+
+#if defined(_WIN32)
+
+struct FileWatcher::Directory
+{
+    std::string Path;
+    HANDLE Handle = INVALID_HANDLE_VALUE;
+    OVERLAPPED Overlapped = {};
+    bool Failed = false;
+    DWORD Buffer[16384]; // FILE_NOTIFY_INFORMATION needs DWORD alignment, and 64KB is the most a network share takes
+
+    ~Directory()
+    {
+        if (Handle != INVALID_HANDLE_VALUE)
+        {
+            // The read still in flight writes into Buffer, it must be gone before Buffer is
+            DWORD bytes = 0;
+            ::CancelIoEx(Handle, &Overlapped);
+            ::GetOverlappedResult(Handle, &Overlapped, &bytes, TRUE);
+            ::CloseHandle(Handle);
+        }
+        if (Overlapped.hEvent)
+        {
+            ::CloseHandle(Overlapped.hEvent);
+        }
+    }
+
+    bool Issue()
+    {
+        return ::ReadDirectoryChangesW(Handle, Buffer, sizeof(Buffer), FALSE,
+            FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE, nullptr, &Overlapped, nullptr) != FALSE;
+    }
+};
+
+FileWatcher::FileWatcher()
+{
+}
+
+FileWatcher::~FileWatcher()
+{
+}
+
+void FileWatcher::AddDirectory(const std::string& directory)
+{
+    std::string path = TrimDirectory(directory);
+    for (const std::unique_ptr<Directory>& watched : m_Directories)
+    {
+        if (watched->Path == path)
+        {
+            return;
+        }
+    }
+
+    wchar_t pathW[MAX_PATH];
+    if (::MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, pathW, MAX_PATH) == 0)
+    {
+        throw std::runtime_error("Can't watch " + path + ": path too long");
+    }
+
+    auto watched = std::make_unique<Directory>();
+    watched->Path = path;
+    watched->Handle = ::CreateFileW(pathW, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (watched->Handle == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("Can't watch " + path + ": error " + std::to_string(::GetLastError()));
+    }
+    watched->Overlapped.hEvent = ::CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!watched->Overlapped.hEvent || !watched->Issue())
+    {
+        throw std::runtime_error("Can't watch " + path + ": error " + std::to_string(::GetLastError()));
+    }
+    m_Directories.push_back(std::move(watched));
+}
+
+std::vector<std::string> FileWatcher::Poll()
+{
+    std::set<std::string> changed;
+    for (const std::unique_ptr<Directory>& directory : m_Directories)
+    {
+        if (directory->Failed)
+        {
+            continue;
+        }
+
+        DWORD bytes = 0;
+        if (!::GetOverlappedResult(directory->Handle, &directory->Overlapped, &bytes, FALSE))
+        {
+            if (::GetLastError() != ERROR_IO_INCOMPLETE)
+            {
+                directory->Failed = true; // deleted, most likely: say so once
+                changed.insert(directory->Path);
+            }
+            continue;
+        }
+
+        if (bytes == 0)
+        {
+            changed.insert(directory->Path); // more changes than the buffer holds, they're lost
+        }
+        else
+        {
+            const uint8_t* entry = reinterpret_cast<const uint8_t*>(directory->Buffer);
+            for (;;)
+            {
+                const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(entry);
+                if (info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_MODIFIED ||
+                    info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+                {
+                    char name[MAX_PATH * 3];
+                    int length = ::WideCharToMultiByte(CP_UTF8, 0, info->FileName, info->FileNameLength / sizeof(WCHAR),
+                        name, sizeof(name), nullptr, nullptr);
+                    if (length > 0)
+                    {
+                        changed.insert(directory->Path + "/" + std::string(name, length));
+                    }
+                }
+                if (info->NextEntryOffset == 0)
+                {
+                    break;
+                }
+                entry += info->NextEntryOffset;
+            }
+        }
+
+        if (!directory->Issue())
+        {
+            directory->Failed = true;
+            changed.insert(directory->Path);
+        }
+    }
+    return std::vector<std::string>(changed.begin(), changed.end());
+}
+
+#else
+
+FileWatcher::FileWatcher()
+{
+    m_Inotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_Inotify < 0)
+    {
+        throw std::runtime_error(std::string("inotify_init1 failed: ") + std::strerror(errno));
+    }
+}
+
+FileWatcher::~FileWatcher()
+{
+    ::close(m_Inotify);
+}
+
+void FileWatcher::AddDirectory(const std::string& directory)
+{
+    std::string path = TrimDirectory(directory);
+
+    // The same directory gets the same watch descriptor back
+    int watch = ::inotify_add_watch(m_Inotify, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR);
+    if (watch < 0)
+    {
+        throw std::runtime_error("Can't watch " + path + ": " + std::strerror(errno));
+    }
+    m_Directories.emplace(watch, path);
+}
+
+std::vector<std::string> FileWatcher::Poll()
+{
+    std::set<std::string> changed;
+    alignas(inotify_event) char buffer[16384];
+    for (;;)
+    {
+        ssize_t size = ::read(m_Inotify, buffer, sizeof(buffer));
+        if (size <= 0)
+        {
+            break; // EAGAIN: nothing more for now
+        }
+
+        for (const char* entry = buffer; entry < buffer + size;)
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(entry);
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                for (const auto& directory : m_Directories)
+                {
+                    changed.insert(directory.second);
+                }
+            }
+            else if (event->len > 0 && !(event->mask & IN_ISDIR))
+            {
+                auto directory = m_Directories.find(event->wd);
+                if (directory != m_Directories.end())
+                {
+                    changed.insert(directory->second + "/" + event->name);
+                }
+            }
+            entry += sizeof(inotify_event) + event->len;
+        }
+    }
+    return std::vector<std::string>(changed.begin(), changed.end());
+}
+
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+
+// Tells which files in a set of directories were written, without blocking (polled once a frame)
+//
+//   FileWatcher watcher;
+//   watcher.AddDirectory("Shaders");
+//   ...
+//   for (const std::string& path : watcher.Poll()) // "Shaders/Upscale_PS.hlsl"
+//
+// Backends:
+//   Windows : an overlapped ReadDirectoryChangesW per directory, checked with GetOverlappedResult
+//   Linux   : one non-blocking inotify descriptor, IN_CLOSE_WRITE and IN_MOVED_TO (editors that save through a
+//             temporary file and rename it over the original show up as the latter)
+//
+// Directories aren't watched recursively. Windows reports a write as soon as it starts, so a file may be reported
+// while it's still being written, followed by another report once it's done.
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class FileWatcher
+{
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // Throws std::runtime_error if it can't be watched. Adding one that's already watched does nothing.
+    void AddDirectory(const std::string& directory);
+
+    // Paths (directory/name) written or moved in since the last call, each once, sorted. If the OS dropped changes
+    // (too many at once) the directory's own path is in there too: anything in it may have changed.
+    std::vector<std::string> Poll();
+
+private:
+#if defined(_WIN32)
+    struct Directory;
+    std::vector<std::unique_ptr<Directory>> m_Directories;
+#else
+    int m_Inotify = -1;
+    std::map<int, std::string> m_Directories; // by watch descriptor
+#endif
+};
@@ -0,0 +1,99 @@
+#include "FrameCapture.h"
+
+#include "d3dx12.h"
+#include "GPUMemoryTagging.h"
+#include "Helpers.h"
+
+#include <stdexcept>
+
+using namespace Microsoft::WRL;
+
+FrameCapture::FrameCapture(ComPtr<ID3D12Device2> device, uint32_t maxBuffers, CaptureEncoder encoder)
+    : m_Device(device)
+    , m_Queue(*this, maxBuffers, std::move(encoder))
+{
+}
+
+bool FrameCapture::Capture(ID3D12GraphicsCommandList* commandList, ID3D12Resource* texture, D3D12_RESOURCE_STATES state,
+    const std::string& path)
+{
+    D3D12_RESOURCE_DESC textureDesc = texture->GetDesc();
+
+    CaptureDesc desc = {};
+    switch (textureDesc.Format)
+    {
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        desc.Format = CaptureFormat::RGBA8;
+        break;
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        desc.Format = CaptureFormat::BGRA8;
+        break;
+    default:
+        throw std::runtime_error("Can't capture a texture of format " + std::to_string(textureDesc.Format));
+    }
+    if (textureDesc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D || textureDesc.SampleDesc.Count > 1)
+    {
+        throw std::runtime_error("Can only capture 2D textures without MSAA");
+    }
+
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+    m_Device->GetCopyableFootprints(&textureDesc, 0, 1, 0, &footprint, nullptr, nullptr, nullptr);
+    desc.Width = footprint.Footprint.Width;
+    desc.Height = footprint.Footprint.Height;
+    desc.RowPitch = footprint.Footprint.RowPitch;
+    desc.Path = path;
+
+    uint32_t buffer;
+    if (!m_Queue.Request(desc, buffer))
+    {
+        return false;
+    }
+
+    if (state != D3D12_RESOURCE_STATE_COPY_SOURCE)
+    {
+        CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(texture, state, D3D12_RESOURCE_STATE_COPY_SOURCE);
+        commandList->ResourceBarrier(1, &barrier);
+    }
+
+    CD3DX12_TEXTURE_COPY_LOCATION destination(m_Buffers[buffer].Get(), footprint);
+    CD3DX12_TEXTURE_COPY_LOCATION source(texture, 0);
+    commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+
+    if (state != D3D12_RESOURCE_STATE_COPY_SOURCE)
+    {
+        CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(texture, D3D12_RESOURCE_STATE_COPY_SOURCE, state);
+        commandList->ResourceBarrier(1, &barrier);
+    }
+    return true;
+}
+
+void FrameCapture::CreateBuffer(uint32_t index, uint64_t size)
+{
+    if (index >= m_Buffers.size())
+    {
+        m_Buffers.resize(index + 1);
+    }
+
+    // A free buffer being replaced was unmapped and its copy completed long ago
+    CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_READBACK);
+    CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+    ThrowIfFailed(m_Device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_Buffers[index])));
+    m_Buffers[index]->SetName(L"Capture readback");
+    GPU_MEMORY_TAG(m_Buffers[index].Get(), "FrameCapture");
+}
+
+const uint8_t* FrameCapture::MapBuffer(uint32_t index)
+{
+    void* data = nullptr;
+    ThrowIfFailed(m_Buffers[index]->Map(0, nullptr, &data));
+    return static_cast<const uint8_t*>(data);
+}
+
+void FrameCapture::UnmapBuffer(uint32_t index)
+{
+    D3D12_RANGE writtenRange = { 0, 0 };
+    m_Buffers[index]->Unmap(0, &writtenRange);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+// Screenshots and recording of any texture, without waiting on the GPU (see CaptureQueue.h for the bookkeeping)
+// Capture records a CopyTextureRegion of the texture's first subresource into a READBACK heap buffer laid out with
+// the footprint GetCopyableFootprints gives (rows padded to 256 bytes). The pixels reach the encoder on the worker
+// thread a few frames later, once the frame's fence has completed:
+//
+//   capture.Update(fence->GetCompletedValue());     // start of the frame
+//   capture.Capture(commandList, backBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE, "screenshot.tga");
+//   ... execute, signal fenceValue ...
+//   capture.FinishFrame(fenceValue);
+//
+// Only 8 bit RGBA/BGRA textures without MSAA.
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <wrl.h>
+#include <d3d12.h>
+
+#include "CaptureQueue.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class FrameCapture : public ICaptureBackend
+{
+public:
+    // maxBuffers bounds the readback memory: one frame's worth each. When they're all copying or encoding, captures
+    // are dropped.
+    FrameCapture(Microsoft::WRL::ComPtr<ID3D12Device2> device, uint32_t maxBuffers, CaptureEncoder encoder = WriteCaptureTGA);
+
+    // texture is in state, and back in it after the copy. Returns false if the capture was dropped.
+    // Throws std::runtime_error if the format isn't one CaptureQueue can encode.
+    bool Capture(ID3D12GraphicsCommandList* commandList, ID3D12Resource* texture, D3D12_RESOURCE_STATES state,
+        const std::string& path);
+
+    void FinishFrame(uint64_t fenceValue) { m_Queue.FinishFrame(fenceValue); }
+    void Update(uint64_t completedFenceValue) { m_Queue.Update(completedFenceValue); }
+
+    // Once the GPU is idle, before shutting down
+    void Flush(uint64_t completedFenceValue) { m_Queue.Flush(completedFenceValue); }
+
+    CaptureStats GetStats() const { return m_Queue.GetStats(); }
+
+private:
+    void CreateBuffer(uint32_t index, uint64_t size) override;
+    const uint8_t* MapBuffer(uint32_t index) override;
+    void UnmapBuffer(uint32_t index) override;
+
+    Microsoft::WRL::ComPtr<ID3D12Device2> m_Device;
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> m_Buffers;
+    CaptureQueue m_Queue; // after m_Buffers, its destructor unmaps them
+};
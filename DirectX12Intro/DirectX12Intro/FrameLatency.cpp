@@ -0,0 +1,89 @@
+#include "FrameLatency.h"
+
+#include <algorithm>
+
+const char* GetLatencyModeName(LatencyMode mode)
+{
+    switch (mode)
+    {
+    case LatencyMode::Default:
+        return "Default";
+    case LatencyMode::LowLatency:
+        return "LowLatency";
+    }
+    return "Unknown";
+}
+
+FrameSequencer::FrameSequencer(IFrameWaits& waits, LatencyMode mode)
+    : m_Waits(waits)
+    , m_Mode(mode)
+{
+}
+
+void FrameSequencer::BeginFrame(uint32_t backBufferIndex)
+{
+    if (m_Mode == LatencyMode::LowLatency)
+    {
+        // Swap chain first: once it has room, the back buffer it hands out next is (almost always) retired too,
+        // so the fence wait is normally free
+        m_Waits.WaitForSwapChain();
+        m_Waits.WaitForFrameFence(backBufferIndex);
+    }
+}
+
+void FrameSequencer::EndFrame(uint32_t nextBackBufferIndex)
+{
+    if (m_Mode == LatencyMode::Default)
+    {
+        m_Waits.WaitForFrameFence(nextBackBufferIndex);
+    }
+}
+
+void InputLatencyTracker::OnInput(Clock::time_point timestamp)
+{
+    if (!m_HasPendingInput || timestamp < m_OldestPendingInput)
+    {
+        m_OldestPendingInput = timestamp;
+    }
+    m_HasPendingInput = true;
+}
+
+void InputLatencyTracker::OnFrameStart()
+{
+    m_FrameHasInput = m_HasPendingInput;
+    m_FrameInput = m_OldestPendingInput;
+    m_HasPendingInput = false;
+}
+
+void InputLatencyTracker::OnPresent(Clock::time_point time)
+{
+    if (!m_FrameHasInput)
+    {
+        return;
+    }
+    m_FrameHasInput = false;
+
+    double latencyMs = std::chrono::duration<double, std::milli>(time - m_FrameInput).count();
+    m_MinMs = m_NumSamples == 0 ? latencyMs : std::min(m_MinMs, latencyMs);
+    m_MaxMs = std::max(m_MaxMs, latencyMs);
+    m_TotalMs += latencyMs;
+    ++m_NumSamples;
+}
+
+InputLatencyStats InputLatencyTracker::GetStats() const
+{
+    InputLatencyStats stats = {};
+    stats.NumSamples = m_NumSamples;
+    stats.AverageMs = m_NumSamples > 0 ? m_TotalMs / m_NumSamples : 0.0;
+    stats.MinMs = m_MinMs;
+    stats.MaxMs = m_MaxMs;
+    return stats;
+}
+
+void InputLatencyTracker::ResetStats()
+{
+    m_NumSamples = 0;
+    m_TotalMs = 0.0;
+    m_MinMs = 0.0;
+    m_MaxMs = 0.0;
+}
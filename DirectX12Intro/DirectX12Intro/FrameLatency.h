@@ -0,0 +1,95 @@
+#pragma once
+
+// Frame latency control and input-to-present latency measurement
+//
+// A frame waits on two things before it can be built:
+//   the swap chain  : has room for another queued frame (the frame latency waitable object)
+//   the frame fence : the GPU is done with this back buffer and its command allocator
+// Where those waits happen decides how stale the input a frame reads is:
+//   Default    : wait on the frame fence at the end of the frame, Present blocks once DXGI's queue
+//                (3 frames by default) is full. Input is read first and then sits through both waits.
+//   LowLatency : the swap chain is created with DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT and
+//                SetMaximumFrameLatency. Both waits happen at the start of the frame, before any input is read,
+//                so Present never blocks and input goes into the next frame the display can actually take.
+//
+// The waits go through IFrameWaits so the ordering can be checked against a mock (or a simulated swap chain)
+// without a GPU. InputLatencyTracker measures how long the oldest input a frame consumed waited until that frame's Present.
+
+#include <chrono>
+#include <cstdint>
+
+enum class LatencyMode
+{
+    Default,
+    LowLatency,
+};
+
+const char* GetLatencyModeName(LatencyMode mode);
+
+class IFrameWaits
+{
+public:
+    virtual ~IFrameWaits() = default;
+
+    // Blocks until the swap chain can take another frame (frame latency waitable object)
+    virtual void WaitForSwapChain() = 0;
+
+    // Blocks until the GPU has finished the last frame that used this back buffer
+    virtual void WaitForFrameFence(uint32_t backBufferIndex) = 0;
+};
+
+class FrameSequencer
+{
+public:
+    FrameSequencer(IFrameWaits& waits, LatencyMode mode);
+
+    LatencyMode GetMode() const { return m_Mode; }
+
+    // Before reading input or touching the back buffer
+    void BeginFrame(uint32_t backBufferIndex);
+
+    // After Present, with the back buffer the next frame will use
+    void EndFrame(uint32_t nextBackBufferIndex);
+
+private:
+    IFrameWaits& m_Waits;
+    LatencyMode m_Mode;
+};
+
+struct InputLatencyStats
+{
+    uint64_t NumSamples; // frames that consumed at least one input
+    double AverageMs;
+    double MinMs;
+    double MaxMs;
+};
+
+class InputLatencyTracker
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Whenever an input event is handled, with the time the window thread received it
+    void OnInput(Clock::time_point timestamp);
+
+    // Once the frame has read its input. Everything received so far belongs to this frame.
+    void OnFrameStart();
+
+    // Right after Present returns
+    void OnPresent(Clock::time_point time = Clock::now());
+
+    InputLatencyStats GetStats() const;
+    void ResetStats();
+
+private:
+    bool m_HasPendingInput = false;
+    Clock::time_point m_OldestPendingInput;
+
+    bool m_FrameHasInput = false;
+    Clock::time_point m_FrameInput;
+
+    uint64_t m_NumSamples = 0;
+    double m_TotalMs = 0.0;
+    double m_MinMs = 0.0;
+    double m_MaxMs = 0.0;
+};
@@ -0,0 +1,203 @@
+#include "FrameLimiter.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h> // Waitable timers
+
+#if defined(min)
+#undef min
+#endif
+
+#if defined(max)
+#undef max
+#endif
+
+// Windows 10 1803+, older SDKs don't have the define
+#if !defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#else
+#include <thread>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h> // _mm_pause
+#endif
+
+#include <algorithm>
+
+namespace
+{
+    // Never spin for less than this, even the best sleeps have some jitter
+    const std::chrono::microseconds MIN_SPIN_MARGIN(50);
+    const std::chrono::microseconds MAX_SPIN_MARGIN(4000);
+    const std::chrono::microseconds INITIAL_SPIN_MARGIN(1000);
+
+    // Added on top of the overshoot we actually saw
+    const std::chrono::microseconds SPIN_SLACK(50);
+
+    double ToMilliseconds(std::chrono::steady_clock::duration duration)
+    {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    void Pause()
+    {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+        _mm_pause(); // be nice to the other hyper thread while we spin
+#endif
+    }
+}
+
+FrameLimiter::FrameLimiter(double targetFrameRate)
+    : m_SpinMargin(INITIAL_SPIN_MARGIN)
+{
+#if defined(_WIN32)
+    // The high resolution timer wakes up within ~0.5 ms instead of the ~1-15 ms of the regular one
+    m_Timer = ::CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (!m_Timer)
+    {
+        m_Timer = ::CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+    }
+#endif
+
+    SetTargetFrameRate(targetFrameRate);
+}
+
+FrameLimiter::~FrameLimiter()
+{
+#if defined(_WIN32)
+    if (m_Timer)
+    {
+        ::CloseHandle(m_Timer);
+    }
+#endif
+}
+
+void FrameLimiter::SetTargetFrameRate(double targetFrameRate)
+{
+    m_TargetFrameRate = std::max(0.0, targetFrameRate);
+    m_Period = m_TargetFrameRate > 0.0
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_TargetFrameRate))
+        : Clock::duration::zero();
+    m_Started = false;
+}
+
+void FrameLimiter::Wait()
+{
+    if (m_Period == Clock::duration::zero())
+    {
+        return;
+    }
+
+    Clock::time_point now = Clock::now();
+    if (!m_Started)
+    {
+        m_NextDeadline = now + m_Period;
+        m_Started = true;
+    }
+
+    ++m_NumFrames;
+
+    if (now >= m_NextDeadline)
+    {
+        // Late already. Within a period we keep the schedule (the next frame gets a little less time),
+        // beyond that we start over rather than rushing out a burst of frames.
+        ++m_NumMissed;
+        m_NextDeadline = now - m_NextDeadline > m_Period ? now + m_Period : m_NextDeadline + m_Period;
+        return;
+    }
+
+    // Coarse part, let the OS have the core
+    Clock::time_point sleepUntil = m_NextDeadline - m_SpinMargin;
+    if (sleepUntil > now)
+    {
+        SleepUntil(sleepUntil);
+
+        // Grow the margin right away when a sleep wakes up later than it covers, shrink it slowly otherwise,
+        // so one lucky sleep doesn't make the next frame miss
+        Clock::duration wanted = (Clock::now() - sleepUntil) + SPIN_SLACK;
+        if (wanted > m_SpinMargin)
+        {
+            m_SpinMargin = wanted;
+        }
+        else
+        {
+            m_SpinMargin -= (m_SpinMargin - wanted) / 16;
+        }
+        m_SpinMargin = std::min<Clock::duration>(std::max<Clock::duration>(m_SpinMargin, MIN_SPIN_MARGIN), MAX_SPIN_MARGIN);
+    }
+
+    // Fine part
+    Clock::time_point spinStart = Clock::now();
+    Clock::time_point woke = spinStart;
+    while (woke < m_NextDeadline)
+    {
+        Pause();
+        woke = Clock::now();
+    }
+
+    double errorMs = ToMilliseconds(woke - m_NextDeadline);
+    m_TotalErrorMs += errorMs;
+    m_MaxErrorMs = std::max(m_MaxErrorMs, errorMs);
+    m_TotalSpinMs += ToMilliseconds(woke - spinStart);
+    if (errorMs <= 0.1)
+    {
+        ++m_NumWithin100us;
+    }
+
+    m_NextDeadline += m_Period;
+}
+
+FramePacingStats FrameLimiter::GetStats() const
+{
+    FramePacingStats stats = {};
+    stats.NumFrames = m_NumFrames;
+    stats.NumMissed = m_NumMissed;
+    stats.NumWithin100us = m_NumWithin100us;
+
+    uint64_t numWaited = m_NumFrames - m_NumMissed;
+    if (numWaited > 0)
+    {
+        stats.AverageErrorMs = m_TotalErrorMs / numWaited;
+        stats.AverageSpinMs = m_TotalSpinMs / numWaited;
+    }
+    stats.MaxErrorMs = m_MaxErrorMs;
+    stats.SpinMarginMs = ToMilliseconds(m_SpinMargin);
+    return stats;
+}
+
+void FrameLimiter::ResetStats()
+{
+    m_NumFrames = 0;
+    m_NumMissed = 0;
+    m_NumWithin100us = 0;
+    m_TotalErrorMs = 0.0;
+    m_MaxErrorMs = 0.0;
+    m_TotalSpinMs = 0.0;
+}
+
+void FrameLimiter::SleepUntil(Clock::time_point time)
+{
+#if defined(_WIN32)
+    Clock::duration duration = time - Clock::now();
+    if (duration <= Clock::duration::zero())
+    {
+        return;
+    }
+
+    // Negative = relative, in 100 ns units
+    LARGE_INTEGER dueTime;
+    dueTime.QuadPart = -static_cast<LONGLONG>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / 100);
+    if (m_Timer && ::SetWaitableTimer(m_Timer, &dueTime, 0, nullptr, nullptr, FALSE))
+    {
+        ::WaitForSingleObject(m_Timer, INFINITE);
+    }
+    else
+    {
+        ::Sleep(static_cast<DWORD>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count()));
+    }
+#else
+    std::this_thread::sleep_until(time);
+#endif
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+// Frame rate limiter for when vsync is off
+// Without it we render as fast as the GPU allows, burning power for frames nobody sees and
+// getting whatever frame times that happens to produce.
+//
+// Waiting is a hybrid: the OS sleep (a high resolution waitable timer on Windows) gets us close,
+// the last stretch is a spin on the clock. The spin margin adapts to how late the sleeps have been
+// waking up, so it stays as short as the OS allows while still hitting the deadline to ~0.1 ms.
+//
+// Deadlines are spaced exactly one period apart rather than measured from whenever the last wait
+// ended, so small errors don't accumulate into drift. If a frame runs long by more than a whole
+// period the schedule restarts from now instead of trying to catch up with a burst of short frames.
+//
+// Only uses the STL apart from the Windows timer, so the timing can be benchmarked on any platform.
+
+#include <chrono>
+#include <cstdint>
+
+struct FramePacingStats
+{
+    uint64_t NumFrames;
+    uint64_t NumMissed;       // frames that were already past their deadline (no wait, schedule restarted)
+    uint64_t NumWithin100us;  // frames that woke up within 0.1 ms of the deadline
+    double AverageErrorMs;    // mean of |wake time - deadline|, missed frames excluded
+    double MaxErrorMs;
+    double AverageSpinMs;     // time spent spinning per frame, i.e. the CPU cost of the accuracy
+    double SpinMarginMs;      // current adaptive margin
+};
+
+class FrameLimiter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // 0 = unlimited
+    explicit FrameLimiter(double targetFrameRate = 0.0);
+    ~FrameLimiter();
+
+    FrameLimiter(const FrameLimiter&) = delete;
+    FrameLimiter& operator=(const FrameLimiter&) = delete;
+
+    void SetTargetFrameRate(double targetFrameRate);
+    double GetTargetFrameRate() const { return m_TargetFrameRate; }
+
+    // Blocks until the next frame is due (right before Present)
+    void Wait();
+
+    FramePacingStats GetStats() const;
+    void ResetStats();
+
+private:
+    void SleepUntil(Clock::time_point time);
+
+    double m_TargetFrameRate = 0.0;
+    Clock::duration m_Period{};
+    Clock::time_point m_NextDeadline{};
+    bool m_Started = false;
+
+    // Estimate of how late the OS sleep wakes up, the spin covers this much before each deadline
+    Clock::duration m_SpinMargin;
+
+    void* m_Timer = nullptr; // waitable timer HANDLE on Windows
+
+    uint64_t m_NumFrames = 0;
+    uint64_t m_NumMissed = 0;
+    uint64_t m_NumWithin100us = 0;
+    double m_TotalErrorMs = 0.0;
+    double m_MaxErrorMs = 0.0;
+    double m_TotalSpinMs = 0.0;
+};
@@ -0,0 +1,219 @@
+#include "GPUBreadcrumbs.h"
+
+#include "d3dx12.h"
+#include "GPUMemoryTagging.h"
+#include "Helpers.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+using namespace Microsoft::WRL;
+
+namespace
+{
+    // Commands shown on either side of where a command list stopped
+    const uint32_t DRED_CONTEXT_OPS = 4;
+
+    std::string DebugName(const char* nameA, const wchar_t* nameW)
+    {
+        if (nameA)
+        {
+            return nameA;
+        }
+        if (nameW)
+        {
+            char buffer[256];
+            if (::WideCharToMultiByte(CP_UTF8, 0, nameW, -1, buffer, sizeof(buffer), nullptr, nullptr) > 0)
+            {
+                return buffer;
+            }
+        }
+        return "(unnamed)";
+    }
+
+    const char* GetOpName(D3D12_AUTO_BREADCRUMB_OP op)
+    {
+        switch (op)
+        {
+        case D3D12_AUTO_BREADCRUMB_OP_SETMARKER: return "SetMarker";
+        case D3D12_AUTO_BREADCRUMB_OP_BEGINEVENT: return "BeginEvent";
+        case D3D12_AUTO_BREADCRUMB_OP_ENDEVENT: return "EndEvent";
+        case D3D12_AUTO_BREADCRUMB_OP_DRAWINSTANCED: return "DrawInstanced";
+        case D3D12_AUTO_BREADCRUMB_OP_DRAWINDEXEDINSTANCED: return "DrawIndexedInstanced";
+        case D3D12_AUTO_BREADCRUMB_OP_EXECUTEINDIRECT: return "ExecuteIndirect";
+        case D3D12_AUTO_BREADCRUMB_OP_DISPATCH: return "Dispatch";
+        case D3D12_AUTO_BREADCRUMB_OP_COPYBUFFERREGION: return "CopyBufferRegion";
+        case D3D12_AUTO_BREADCRUMB_OP_COPYTEXTUREREGION: return "CopyTextureRegion";
+        case D3D12_AUTO_BREADCRUMB_OP_COPYRESOURCE: return "CopyResource";
+        case D3D12_AUTO_BREADCRUMB_OP_RESOLVESUBRESOURCE: return "ResolveSubresource";
+        case D3D12_AUTO_BREADCRUMB_OP_CLEARRENDERTARGETVIEW: return "ClearRenderTargetView";
+        case D3D12_AUTO_BREADCRUMB_OP_CLEARUNORDEREDACCESSVIEW: return "ClearUnorderedAccessView";
+        case D3D12_AUTO_BREADCRUMB_OP_CLEARDEPTHSTENCILVIEW: return "ClearDepthStencilView";
+        case D3D12_AUTO_BREADCRUMB_OP_RESOURCEBARRIER: return "ResourceBarrier";
+        case D3D12_AUTO_BREADCRUMB_OP_EXECUTEBUNDLE: return "ExecuteBundle";
+        case D3D12_AUTO_BREADCRUMB_OP_PRESENT: return "Present";
+        case D3D12_AUTO_BREADCRUMB_OP_RESOLVEQUERYDATA: return "ResolveQueryData";
+        case D3D12_AUTO_BREADCRUMB_OP_WRITEBUFFERIMMEDIATE: return "WriteBufferImmediate";
+        case D3D12_AUTO_BREADCRUMB_OP_DISPATCHMESH: return "DispatchMesh";
+        default: return nullptr; // the rest are printed as numbers, see D3D12_AUTO_BREADCRUMB_OP
+        }
+    }
+
+    void AppendAllocations(std::string& report, const char* title, const D3D12_DRED_ALLOCATION_NODE* node)
+    {
+        char buffer[512];
+        for (; node; node = node->pNext)
+        {
+            std::snprintf(buffer, sizeof(buffer), "  %s: %s (allocation type %d)\n", title,
+                DebugName(node->ObjectNameA, node->ObjectNameW).c_str(), static_cast<int>(node->AllocationType));
+            report += buffer;
+        }
+    }
+}
+
+GPUBreadcrumbs::GPUBreadcrumbs(ComPtr<ID3D12Device2> device)
+{
+    // READBACK memory is CPU memory the GPU writes through to, it stays readable when the device is removed
+    CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_READBACK);
+    CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(sizeof(uint32_t) * MAX_MARKERS * 2);
+    ThrowIfFailed(device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_Buffer)));
+    m_Buffer->SetName(L"GPU Breadcrumbs");
+    GPU_MEMORY_TAG(m_Buffer.Get(), "GPUBreadcrumbs");
+    m_BufferAddress = m_Buffer->GetGPUVirtualAddress();
+
+    void* data = nullptr;
+    ThrowIfFailed(m_Buffer->Map(0, nullptr, &data));
+    std::memset(data, 0, sizeof(uint32_t) * MAX_MARKERS * 2);
+    m_Values = static_cast<const volatile uint32_t*>(data);
+}
+
+GPUBreadcrumbs::~GPUBreadcrumbs()
+{
+    D3D12_RANGE writtenRange = { 0, 0 };
+    m_Buffer->Unmap(0, &writtenRange);
+}
+
+uint32_t GPUBreadcrumbs::BeginPass(ID3D12GraphicsCommandList2* commandList, const char* name)
+{
+    uint32_t marker = m_NextMarker++;
+    if (m_NextMarker == 0)
+    {
+        m_NextMarker = 1;
+    }
+
+    uint32_t slot = marker % MAX_MARKERS;
+    m_Names[slot] = name;
+
+    // MARKER_IN: written as soon as the GPU gets to it, before the commands that follow have started
+    D3D12_WRITEBUFFERIMMEDIATE_PARAMETER parameter = { m_BufferAddress + sizeof(uint32_t) * slot * 2, marker };
+    D3D12_WRITEBUFFERIMMEDIATE_MODE mode = D3D12_WRITEBUFFERIMMEDIATE_MODE_MARKER_IN;
+    commandList->WriteBufferImmediate(1, &parameter, &mode);
+    return marker;
+}
+
+void GPUBreadcrumbs::EndPass(ID3D12GraphicsCommandList2* commandList, uint32_t marker)
+{
+    uint32_t slot = marker % MAX_MARKERS;
+
+    // MARKER_OUT: written once every command before it has finished
+    D3D12_WRITEBUFFERIMMEDIATE_PARAMETER parameter = { m_BufferAddress + sizeof(uint32_t) * (slot * 2 + 1), marker };
+    D3D12_WRITEBUFFERIMMEDIATE_MODE mode = D3D12_WRITEBUFFERIMMEDIATE_MODE_MARKER_OUT;
+    commandList->WriteBufferImmediate(1, &parameter, &mode);
+}
+
+std::string GPUBreadcrumbs::GetReport() const
+{
+    std::string report = "GPU breadcrumbs (oldest first):\n";
+
+    uint32_t last = m_NextMarker - 1;
+    uint32_t count = std::min(last, MAX_MARKERS);
+    char buffer[256];
+    for (uint32_t marker = last - count + 1; count > 0; ++marker, --count)
+    {
+        uint32_t slot = marker % MAX_MARKERS;
+        bool began = m_Values[slot * 2] == marker;
+        bool ended = m_Values[slot * 2 + 1] == marker;
+
+        const char* status = ended ? "completed" : began ? "IN PROGRESS" : "not started";
+        std::snprintf(buffer, sizeof(buffer), "  #%u %s: %s\n", marker, m_Names[slot] ? m_Names[slot] : "?", status);
+        report += buffer;
+    }
+    return report;
+}
+
+void EnableDRED()
+{
+    // Not available before Windows 10 1903, just carry on without it
+    ComPtr<ID3D12DeviceRemovedExtendedDataSettings> settings;
+    if (SUCCEEDED(D3D12GetDebugInterface(IID_PPV_ARGS(&settings))))
+    {
+        settings->SetAutoBreadcrumbsEnablement(D3D12_DRED_ENABLEMENT_FORCED_ON);
+        settings->SetPageFaultEnablement(D3D12_DRED_ENABLEMENT_FORCED_ON);
+    }
+}
+
+std::string GetDREDReport(ID3D12Device* device)
+{
+    ComPtr<ID3D12DeviceRemovedExtendedData> dred;
+    if (FAILED(device->QueryInterface(IID_PPV_ARGS(&dred))))
+    {
+        return "DRED: not available\n";
+    }
+
+    std::string report;
+    char buffer[512];
+
+    D3D12_DRED_AUTO_BREADCRUMBS_OUTPUT breadcrumbs = {};
+    if (SUCCEEDED(dred->GetAutoBreadcrumbsOutput(&breadcrumbs)))
+    {
+        report += "DRED command lists that didn't finish:\n";
+        for (const D3D12_AUTO_BREADCRUMB_NODE* node = breadcrumbs.pHeadAutoBreadcrumbNode; node; node = node->pNext)
+        {
+            uint32_t completed = node->pLastBreadcrumbValue ? *node->pLastBreadcrumbValue : 0;
+            if (completed >= node->BreadcrumbCount)
+            {
+                continue;
+            }
+
+            std::snprintf(buffer, sizeof(buffer), "  %s on %s: %u of %u operations completed\n",
+                DebugName(node->pCommandListDebugNameA, node->pCommandListDebugNameW).c_str(),
+                DebugName(node->pCommandQueueDebugNameA, node->pCommandQueueDebugNameW).c_str(),
+                completed, node->BreadcrumbCount);
+            report += buffer;
+
+            uint32_t first = completed > DRED_CONTEXT_OPS ? completed - DRED_CONTEXT_OPS : 0;
+            uint32_t end = std::min(node->BreadcrumbCount, completed + DRED_CONTEXT_OPS + 1);
+            for (uint32_t i = first; i < end; ++i)
+            {
+                D3D12_AUTO_BREADCRUMB_OP op = node->pCommandHistory[i];
+                const char* name = GetOpName(op);
+                if (name)
+                {
+                    std::snprintf(buffer, sizeof(buffer), "    [%u] %s%s\n", i, name, i == completed ? "  <-- here" : "");
+                }
+                else
+                {
+                    std::snprintf(buffer, sizeof(buffer), "    [%u] op %d%s\n", i, static_cast<int>(op), i == completed ? "  <-- here" : "");
+                }
+                report += buffer;
+            }
+        }
+    }
+    else
+    {
+        report += "DRED: no auto breadcrumbs (not enabled before the device was created?)\n";
+    }
+
+    D3D12_DRED_PAGE_FAULT_OUTPUT pageFault = {};
+    if (SUCCEEDED(dred->GetPageFaultAllocationOutput(&pageFault)) && pageFault.PageFaultVA != 0)
+    {
+        std::snprintf(buffer, sizeof(buffer), "DRED page fault at GPU VA 0x%016llX\n",
+            static_cast<unsigned long long>(pageFault.PageFaultVA));
+        report += buffer;
+        AppendAllocations(report, "existing", pageFault.pHeadExistingAllocationNode);
+        AppendAllocations(report, "recently freed", pageFault.pHeadRecentFreedAllocationNode);
+    }
+    return report;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+// Finding out what the GPU was doing when the device got removed
+//
+// GPUBreadcrumbs: our own markers. Each pass writes its sequence number into a begin slot when the GPU
+// reaches it and into an end slot once everything before has finished (WriteBufferImmediate with the
+// MARKER_IN / MARKER_OUT modes), into a persistently mapped READBACK buffer. That memory lives on the
+// CPU side, so it can still be read after the device is gone: passes with both slots written completed,
+// the one with only the begin slot written is where the GPU was. Costs two tiny commands per pass.
+//
+// DRED (Device Removed Extended Data): the runtime's own breadcrumbs for every command it recorded, and
+// the allocations around the faulting address on a page fault. Has to be switched on before the device is
+// created, and is slower than ours (a few % GPU time), so only when asked for.
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <wrl.h>
+#include <d3d12.h>
+
+#include <cstdint>
+#include <string>
+
+class GPUBreadcrumbs
+{
+public:
+    // Size of the ring, the report covers the last this many passes
+    static const uint32_t MAX_MARKERS = 256;
+
+    explicit GPUBreadcrumbs(Microsoft::WRL::ComPtr<ID3D12Device2> device);
+    ~GPUBreadcrumbs();
+
+    // Brackets a pass. name must outlive the GPUBreadcrumbs (string literals), it's only read for the report.
+    // Returns the marker to hand to EndPass.
+    uint32_t BeginPass(ID3D12GraphicsCommandList2* commandList, const char* name);
+    void EndPass(ID3D12GraphicsCommandList2* commandList, uint32_t marker);
+
+    // One line per recorded pass, oldest first: completed, in progress or not started.
+    // Only meaningful once the GPU has stopped (device removed, or idle).
+    std::string GetReport() const;
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_Buffer;
+    D3D12_GPU_VIRTUAL_ADDRESS m_BufferAddress;
+    const volatile uint32_t* m_Values = nullptr; // mapped, begin and end slot per marker
+    const char* m_Names[MAX_MARKERS] = {};
+    uint32_t m_NextMarker = 1; // 0 means not written
+};
+
+// Call before creating the device, the settings are picked up by D3D12CreateDevice
+void EnableDRED();
+
+// Auto breadcrumbs of the command lists that didn't finish and the page fault info, if DRED was enabled
+std::string GetDREDReport(ID3D12Device* device);
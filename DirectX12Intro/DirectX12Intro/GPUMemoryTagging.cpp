@@ -0,0 +1,198 @@
+// For WKPDID_D3DDebugObjectNameW, without linking dxguid.lib
+#include <initguid.h>
+
+#include "GPUMemoryTagging.h"
+
+#include "Helpers.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <wrl.h>
+
+using namespace Microsoft::WRL;
+
+namespace
+{
+    // {6C1B5E0A-3F52-4D8B-9E0C-2A7F41D3B6E9}
+    const GUID GPU_MEMORY_TAG_GUID = { 0x6c1b5e0a, 0x3f52, 0x4d8b, { 0x9e, 0x0c, 0x2a, 0x7f, 0x41, 0xd3, 0xb6, 0xe9 } };
+
+    // Private data of a tagged object. The runtime releases it when the object is destroyed, which removes the
+    // allocation from the tracker.
+    class ReleaseNotifier : public IUnknown
+    {
+    public:
+        explicit ReleaseNotifier(uint64_t id)
+            : m_Id(id)
+        {
+        }
+
+        HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override
+        {
+            if (!object)
+            {
+                return E_POINTER;
+            }
+            if (riid != __uuidof(IUnknown))
+            {
+                *object = nullptr;
+                return E_NOINTERFACE;
+            }
+            *object = this;
+            AddRef();
+            return S_OK;
+        }
+
+        ULONG STDMETHODCALLTYPE AddRef() override
+        {
+            return ++m_RefCount;
+        }
+
+        ULONG STDMETHODCALLTYPE Release() override
+        {
+            ULONG refCount = --m_RefCount;
+            if (refCount == 0)
+            {
+                // Called from inside the runtime, nothing may be thrown through it. Only this removes the id.
+                try
+                {
+                    GetGPUMemoryTracker().Remove(m_Id);
+                }
+                catch (const std::exception& e)
+                {
+                    ::OutputDebugStringA(e.what());
+                }
+                delete this;
+            }
+            return refCount;
+        }
+
+    private:
+        std::atomic<ULONG> m_RefCount{ 1 };
+        uint64_t m_Id;
+    };
+
+    std::string GetDebugName(ID3D12Object* object)
+    {
+        UINT size = 0;
+        if (FAILED(object->GetPrivateData(WKPDID_D3DDebugObjectNameW, &size, nullptr)) || size < sizeof(wchar_t))
+        {
+            return {};
+        }
+
+        std::vector<wchar_t> nameW(size / sizeof(wchar_t) + 1, L'\0');
+        ThrowIfFailed(object->GetPrivateData(WKPDID_D3DDebugObjectNameW, &size, nameW.data()));
+
+        char buffer[256];
+        if (::WideCharToMultiByte(CP_UTF8, 0, nameW.data(), -1, buffer, sizeof(buffer), nullptr, nullptr) > 0)
+        {
+            return buffer;
+        }
+        return {};
+    }
+}
+
+GPUMemoryTracker& GetGPUMemoryTracker()
+{
+    // Never destroyed: objects held by globals are released after function statics are gone
+    static GPUMemoryTracker* tracker = new GPUMemoryTracker();
+    return *tracker;
+}
+
+void TagGPUMemory(ID3D12Object* object, const char* owner, GPUMemoryCategory category, uint64_t bytes)
+{
+    uint64_t id = GetGPUMemoryTracker().Add(bytes, { category, owner, GetDebugName(object) });
+
+    // SetPrivateDataInterface takes its own reference, replacing (and releasing) a previous tag's notifier
+    ComPtr<ReleaseNotifier> notifier;
+    notifier.Attach(new ReleaseNotifier(id));
+    HRESULT hr = object->SetPrivateDataInterface(GPU_MEMORY_TAG_GUID, notifier.Get());
+    if (FAILED(hr))
+    {
+        GetGPUMemoryTracker().Remove(id);
+        ThrowIfFailed(hr);
+    }
+}
+
+void TagGPUMemory(ID3D12Resource* resource, const char* owner)
+{
+    TagGPUMemory(resource, owner, GetGPUMemoryCategory(resource));
+}
+
+void TagGPUMemory(ID3D12Resource* resource, const char* owner, GPUMemoryCategory category)
+{
+    ComPtr<ID3D12Device> device;
+    ThrowIfFailed(resource->GetDevice(IID_PPV_ARGS(&device)));
+
+    // Reserved resources have no heap (their tiles are in heaps tagged on their own) and take nothing themselves
+    D3D12_HEAP_PROPERTIES heapProperties = {};
+    D3D12_HEAP_FLAGS heapFlags = D3D12_HEAP_FLAG_NONE;
+    uint64_t bytes = 0;
+    if (SUCCEEDED(resource->GetHeapProperties(&heapProperties, &heapFlags)))
+    {
+        D3D12_RESOURCE_DESC desc = resource->GetDesc();
+        bytes = device->GetResourceAllocationInfo(heapProperties.VisibleNodeMask, 1, &desc).SizeInBytes;
+    }
+    TagGPUMemory(static_cast<ID3D12Object*>(resource), owner, category, bytes);
+}
+
+void TagGPUMemory(ID3D12Heap* heap, const char* owner)
+{
+    TagGPUMemory(heap, owner, GPUMemoryCategory::Heap, heap->GetDesc().SizeInBytes);
+}
+
+void TagGPUMemory(ID3D12DescriptorHeap* descriptorHeap, const char* owner)
+{
+    ComPtr<ID3D12Device> device;
+    ThrowIfFailed(descriptorHeap->GetDevice(IID_PPV_ARGS(&device)));
+
+    D3D12_DESCRIPTOR_HEAP_DESC desc = descriptorHeap->GetDesc();
+    uint64_t bytes = uint64_t(desc.NumDescriptors) * device->GetDescriptorHandleIncrementSize(desc.Type);
+    TagGPUMemory(descriptorHeap, owner, GPUMemoryCategory::DescriptorHeap, bytes);
+}
+
+void TagGPUMemory(ID3D12VideoDecoderHeap* decoderHeap, const char* owner)
+{
+    ComPtr<ID3D12VideoDevice> videoDevice;
+    ThrowIfFailed(decoderHeap->GetDevice(IID_PPV_ARGS(&videoDevice)));
+
+    // The driver's own memory for the heap, in video memory (L1) and system memory (L0)
+    D3D12_FEATURE_DATA_VIDEO_DECODER_HEAP_SIZE heapSize = {};
+    heapSize.VideoDecoderHeapDesc = decoderHeap->GetDesc();
+    uint64_t bytes = 0;
+    if (SUCCEEDED(videoDevice->CheckFeatureSupport(D3D12_FEATURE_VIDEO_DECODER_HEAP_SIZE, &heapSize, sizeof(heapSize))))
+    {
+        bytes = heapSize.MemoryPoolL0Size + heapSize.MemoryPoolL1Size;
+    }
+    TagGPUMemory(decoderHeap, owner, GPUMemoryCategory::Video, bytes);
+}
+
+GPUMemoryCategory GetGPUMemoryCategory(ID3D12Resource* resource)
+{
+    D3D12_HEAP_PROPERTIES heapProperties = {};
+    D3D12_HEAP_FLAGS heapFlags = D3D12_HEAP_FLAG_NONE;
+    if (SUCCEEDED(resource->GetHeapProperties(&heapProperties, &heapFlags)))
+    {
+        if (heapProperties.Type == D3D12_HEAP_TYPE_UPLOAD)
+        {
+            return GPUMemoryCategory::Upload;
+        }
+        if (heapProperties.Type == D3D12_HEAP_TYPE_READBACK)
+        {
+            return GPUMemoryCategory::Readback;
+        }
+    }
+
+    D3D12_RESOURCE_DESC desc = resource->GetDesc();
+    if (desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET)
+    {
+        return GPUMemoryCategory::RenderTarget;
+    }
+    if (desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)
+    {
+        return GPUMemoryCategory::DepthStencil;
+    }
+    return desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER ? GPUMemoryCategory::Buffer : GPUMemoryCategory::Texture;
+}
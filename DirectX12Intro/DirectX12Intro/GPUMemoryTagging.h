@@ -0,0 +1,46 @@
+#pragma once
+
+// Adds D3D12 objects to the GPUMemoryTracker, and removes them again when they're destroyed
+//
+//   ThrowIfFailed(device->CreateCommittedResource(..., IID_PPV_ARGS(&m_Buffer)));
+//   m_Buffer->SetName(L"Vertices");
+//   GPU_MEMORY_TAG(m_Buffer.Get(), "MeshletRenderer");
+//
+// The name in the tag is the object's debug name, so tag after SetName. Sizes are what the object really takes:
+// GetResourceAllocationInfo for resources (committed buffers are at least 64KB), the heap size for heaps, the
+// number of descriptors times their size for descriptor heaps. Resources are put in a category by their heap type
+// and flags unless one is given.
+//
+// Removal needs no call: the tag holds a small COM object as the object's private data, and the runtime releases
+// it when the object is destroyed, on whatever thread that happens. Tagging an object again replaces its tag.
+// With GPU_MEMORY_TRACKING 0, GPU_MEMORY_TAG doesn't even evaluate its arguments.
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <d3d12.h>
+#include <d3d12video.h>
+
+#include "GPUMemoryTracker.h"
+
+#include <cstdint>
+
+// The application's one tracker
+GPUMemoryTracker& GetGPUMemoryTracker();
+
+#if GPU_MEMORY_TRACKING
+#define GPU_MEMORY_TAG(...) TagGPUMemory(__VA_ARGS__)
+#else
+#define GPU_MEMORY_TAG(...) ((void)0)
+#endif
+
+void TagGPUMemory(ID3D12Resource* resource, const char* owner);
+void TagGPUMemory(ID3D12Resource* resource, const char* owner, GPUMemoryCategory category);
+void TagGPUMemory(ID3D12Heap* heap, const char* owner);
+void TagGPUMemory(ID3D12DescriptorHeap* descriptorHeap, const char* owner);
+void TagGPUMemory(ID3D12VideoDecoderHeap* decoderHeap, const char* owner);
+
+// Anything else, with a size the caller knows (query heaps: the number of queries times 8 bytes)
+void TagGPUMemory(ID3D12Object* object, const char* owner, GPUMemoryCategory category, uint64_t bytes);
+
+GPUMemoryCategory GetGPUMemoryCategory(ID3D12Resource* resource);
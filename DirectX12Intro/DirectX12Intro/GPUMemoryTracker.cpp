@@ -0,0 +1,310 @@
+#include "GPUMemoryTracker.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+namespace
+{
+    void AppendJSONString(std::string& json, const std::string& text)
+    {
+        json += '"';
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                json += '\\';
+                json += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                json += escaped;
+            }
+            else
+            {
+                json += c;
+            }
+        }
+        json += '"';
+    }
+
+    void AppendJSONTotal(std::string& json, const GPUMemoryTotal& total)
+    {
+        json += "{\"bytes\":" + std::to_string(total.Bytes) + ",\"high_water\":" + std::to_string(total.HighWater) +
+            ",\"count\":" + std::to_string(total.Count) + "}";
+    }
+
+    void AppendJSONAllocations(std::string& json, const std::vector<GPUMemoryAllocation>& allocations)
+    {
+        json += '[';
+        for (size_t i = 0; i < allocations.size(); ++i)
+        {
+            const GPUMemoryAllocation& allocation = allocations[i];
+            json += i ? ",{\"id\":" : "{\"id\":";
+            json += std::to_string(allocation.Id) + ",\"bytes\":" + std::to_string(allocation.Bytes) + ",\"category\":\"";
+            json += GetGPUMemoryCategoryName(allocation.Tag.Category);
+            json += "\",\"owner\":";
+            AppendJSONString(json, allocation.Tag.Owner);
+            json += ",\"name\":";
+            AppendJSONString(json, allocation.Tag.Name);
+            json += '}';
+        }
+        json += ']';
+    }
+}
+
+const char* GetGPUMemoryCategoryName(GPUMemoryCategory category)
+{
+    switch (category)
+    {
+    case GPUMemoryCategory::RenderTarget:
+        return "render_target";
+    case GPUMemoryCategory::DepthStencil:
+        return "depth_stencil";
+    case GPUMemoryCategory::Texture:
+        return "texture";
+    case GPUMemoryCategory::Buffer:
+        return "buffer";
+    case GPUMemoryCategory::Upload:
+        return "upload";
+    case GPUMemoryCategory::Readback:
+        return "readback";
+    case GPUMemoryCategory::DescriptorHeap:
+        return "descriptor_heap";
+    case GPUMemoryCategory::QueryHeap:
+        return "query_heap";
+    case GPUMemoryCategory::Heap:
+        return "heap";
+    case GPUMemoryCategory::Video:
+        return "video";
+    case GPUMemoryCategory::Other:
+    case GPUMemoryCategory::Count:
+        break;
+    }
+    return "other";
+}
+
+uint64_t GPUMemoryTracker::Add(uint64_t bytes, const GPUMemoryTag& tag)
+{
+    uint32_t category = static_cast<uint32_t>(tag.Category);
+    if (category >= GPU_MEMORY_CATEGORY_COUNT)
+    {
+        throw std::runtime_error("Invalid GPU memory category " + std::to_string(category));
+    }
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    uint64_t id = m_NextId++;
+    m_Allocations.emplace(id, GPUMemoryAllocation{ id, bytes, tag });
+    AddToTotal(m_Total, bytes);
+    AddToTotal(m_Categories[category], bytes);
+    AddToTotal(m_Owners[tag.Owner], bytes);
+    return id;
+}
+
+void GPUMemoryTracker::Remove(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto it = m_Allocations.find(id);
+    if (it == m_Allocations.end())
+    {
+        throw std::runtime_error("GPU memory allocation " + std::to_string(id) + " isn't tracked");
+    }
+
+    const GPUMemoryAllocation& allocation = it->second;
+    GPUMemoryTotal* totals[] = { &m_Total, &m_Categories[static_cast<uint32_t>(allocation.Tag.Category)], &m_Owners[allocation.Tag.Owner] };
+    for (GPUMemoryTotal* total : totals)
+    {
+        total->Bytes -= allocation.Bytes;
+        --total->Count;
+    }
+    m_Allocations.erase(it);
+}
+
+GPUMemoryTotal GPUMemoryTracker::GetTotal() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Total;
+}
+
+GPUMemoryTotal GPUMemoryTracker::GetCategoryTotal(GPUMemoryCategory category) const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Categories[static_cast<uint32_t>(category)];
+}
+
+GPUMemoryTotal GPUMemoryTracker::GetOwnerTotal(const std::string& owner) const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto it = m_Owners.find(owner);
+    return it != m_Owners.end() ? it->second : GPUMemoryTotal{};
+}
+
+void GPUMemoryTracker::ResetHighWater()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Total.HighWater = m_Total.Bytes;
+    for (GPUMemoryTotal& total : m_Categories)
+    {
+        total.HighWater = total.Bytes;
+    }
+    for (auto& owner : m_Owners)
+    {
+        owner.second.HighWater = owner.second.Bytes;
+    }
+}
+
+GPUMemorySnapshot GPUMemoryTracker::TakeSnapshot(uint64_t frame) const
+{
+    GPUMemorySnapshot snapshot;
+    snapshot.Frame = frame;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        snapshot.Total = m_Total;
+        std::copy(m_Categories, m_Categories + GPU_MEMORY_CATEGORY_COUNT, snapshot.Categories);
+        snapshot.Owners = m_Owners;
+        snapshot.Allocations.reserve(m_Allocations.size());
+        for (const auto& allocation : m_Allocations)
+        {
+            snapshot.Allocations.push_back(allocation.second);
+        }
+    }
+
+    std::sort(snapshot.Allocations.begin(), snapshot.Allocations.end(),
+        [](const GPUMemoryAllocation& a, const GPUMemoryAllocation& b) { return a.Id < b.Id; });
+    return snapshot;
+}
+
+void GPUMemoryTracker::AddToTotal(GPUMemoryTotal& total, uint64_t bytes)
+{
+    total.Bytes += bytes;
+    total.HighWater = std::max(total.HighWater, total.Bytes);
+    ++total.Count;
+}
+
+GPUMemoryDiff DiffGPUMemory(const GPUMemorySnapshot& from, const GPUMemorySnapshot& to)
+{
+    GPUMemoryDiff diff = {};
+    diff.FromFrame = from.Frame;
+    diff.ToFrame = to.Frame;
+    diff.TotalBytes = int64_t(to.Total.Bytes) - int64_t(from.Total.Bytes);
+    for (uint32_t i = 0; i < GPU_MEMORY_CATEGORY_COUNT; ++i)
+    {
+        diff.Categories[i] = int64_t(to.Categories[i].Bytes) - int64_t(from.Categories[i].Bytes);
+    }
+
+    for (const auto& owner : to.Owners)
+    {
+        auto it = from.Owners.find(owner.first);
+        int64_t change = int64_t(owner.second.Bytes) - (it != from.Owners.end() ? int64_t(it->second.Bytes) : 0);
+        if (change != 0)
+        {
+            diff.Owners[owner.first] = change;
+        }
+    }
+    for (const auto& owner : from.Owners)
+    {
+        if (to.Owners.find(owner.first) == to.Owners.end() && owner.second.Bytes != 0)
+        {
+            diff.Owners[owner.first] = -int64_t(owner.second.Bytes);
+        }
+    }
+
+    // Both are sorted by id, walk them together
+    size_t i = 0;
+    size_t j = 0;
+    while (i < from.Allocations.size() || j < to.Allocations.size())
+    {
+        if (j == to.Allocations.size() || (i < from.Allocations.size() && from.Allocations[i].Id < to.Allocations[j].Id))
+        {
+            diff.Removed.push_back(from.Allocations[i++]);
+        }
+        else if (i == from.Allocations.size() || to.Allocations[j].Id < from.Allocations[i].Id)
+        {
+            diff.Added.push_back(to.Allocations[j++]);
+        }
+        else
+        {
+            ++i;
+            ++j;
+        }
+    }
+    return diff;
+}
+
+std::string GPUMemorySnapshotToJSON(const GPUMemorySnapshot& snapshot, bool allocations)
+{
+    std::string json = "{\"frame\":" + std::to_string(snapshot.Frame) + ",\"total\":";
+    AppendJSONTotal(json, snapshot.Total);
+
+    json += ",\"categories\":{";
+    bool first = true;
+    for (uint32_t i = 0; i < GPU_MEMORY_CATEGORY_COUNT; ++i)
+    {
+        if (snapshot.Categories[i].HighWater == 0)
+        {
+            continue; // never used
+        }
+        json += first ? "\"" : ",\"";
+        json += GetGPUMemoryCategoryName(static_cast<GPUMemoryCategory>(i));
+        json += "\":";
+        AppendJSONTotal(json, snapshot.Categories[i]);
+        first = false;
+    }
+
+    json += "},\"owners\":{";
+    first = true;
+    for (const auto& owner : snapshot.Owners)
+    {
+        json += first ? "" : ",";
+        AppendJSONString(json, owner.first);
+        json += ':';
+        AppendJSONTotal(json, owner.second);
+        first = false;
+    }
+    json += '}';
+
+    if (allocations)
+    {
+        json += ",\"allocations\":";
+        AppendJSONAllocations(json, snapshot.Allocations);
+    }
+    json += '}';
+    return json;
+}
+
+std::string GPUMemoryDiffToJSON(const GPUMemoryDiff& diff)
+{
+    std::string json = "{\"from_frame\":" + std::to_string(diff.FromFrame) + ",\"to_frame\":" + std::to_string(diff.ToFrame) +
+        ",\"total_bytes\":" + std::to_string(diff.TotalBytes) + ",\"categories\":{";
+    bool first = true;
+    for (uint32_t i = 0; i < GPU_MEMORY_CATEGORY_COUNT; ++i)
+    {
+        if (diff.Categories[i] == 0)
+        {
+            continue;
+        }
+        json += first ? "\"" : ",\"";
+        json += GetGPUMemoryCategoryName(static_cast<GPUMemoryCategory>(i));
+        json += "\":" + std::to_string(diff.Categories[i]);
+        first = false;
+    }
+
+    json += "},\"owners\":{";
+    first = true;
+    for (const auto& owner : diff.Owners)
+    {
+        json += first ? "" : ",";
+        AppendJSONString(json, owner.first);
+        json += ':' + std::to_string(owner.second);
+        first = false;
+    }
+
+    json += "},\"added\":";
+    AppendJSONAllocations(json, diff.Added);
+    json += ",\"removed\":";
+    AppendJSONAllocations(json, diff.Removed);
+    json += '}';
+    return json;
+}
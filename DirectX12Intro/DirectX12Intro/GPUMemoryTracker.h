@@ -0,0 +1,123 @@
+#pragma once
+
+// Where the video memory went
+// Every heap, committed resource and descriptor heap is added with a tag (category, owner, debug name) and its size,
+// and removed when it's destroyed. The tracker keeps current and high water totals overall, per category and per
+// owner, and snapshots of it can be diffed between frames and written out as JSON:
+//
+//   GPUMemorySnapshot before = tracker.TakeSnapshot(frame);
+//   ... frames later ...
+//   GPUMemorySnapshot after = tracker.TakeSnapshot(frame);
+//   std::string json = GPUMemoryDiffToJSON(DiffGPUMemory(before, after)); // what was added and removed in between
+//
+// Add and Remove may come from any thread (resources are destroyed wherever their last reference goes).
+// GPUMemoryTagging.h hooks this up to D3D12 objects, behind GPU_MEMORY_TRACKING: built with GPU_MEMORY_TRACKING=0 the
+// tagging compiles to nothing and the tracker stays empty. RuntimeBench gpumemory checks the accounting.
+// Only uses the STL.
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if !defined(GPU_MEMORY_TRACKING)
+#define GPU_MEMORY_TRACKING 1
+#endif
+
+enum class GPUMemoryCategory : uint8_t
+{
+    RenderTarget,   // including the swap chain's back buffers
+    DepthStencil,
+    Texture,
+    Buffer,
+    Upload,         // UPLOAD heap
+    Readback,       // READBACK heap
+    DescriptorHeap,
+    QueryHeap,
+    Heap,           // ID3D12Heap, for placed resources
+    Video,
+    Other,
+    Count,
+};
+
+const char* GetGPUMemoryCategoryName(GPUMemoryCategory category);
+
+const uint32_t GPU_MEMORY_CATEGORY_COUNT = static_cast<uint32_t>(GPUMemoryCategory::Count);
+
+struct GPUMemoryTag
+{
+    GPUMemoryCategory Category;
+    std::string Owner; // the subsystem that created it, e.g. "UploadRing"
+    std::string Name;  // what it is, usually its debug name
+};
+
+struct GPUMemoryTotal
+{
+    uint64_t Bytes;
+    uint64_t HighWater; // most Bytes has been since the tracker was created (or ResetHighWater)
+    uint32_t Count;
+};
+
+struct GPUMemoryAllocation
+{
+    uint64_t Id; // in the order they were added
+    uint64_t Bytes;
+    GPUMemoryTag Tag;
+};
+
+struct GPUMemorySnapshot
+{
+    uint64_t Frame;
+    GPUMemoryTotal Total;
+    GPUMemoryTotal Categories[GPU_MEMORY_CATEGORY_COUNT];
+    std::map<std::string, GPUMemoryTotal> Owners;
+    std::vector<GPUMemoryAllocation> Allocations; // by Id
+};
+
+struct GPUMemoryDiff
+{
+    uint64_t FromFrame;
+    uint64_t ToFrame;
+    int64_t TotalBytes;
+    int64_t Categories[GPU_MEMORY_CATEGORY_COUNT];
+    std::map<std::string, int64_t> Owners; // only the owners whose total changed
+    std::vector<GPUMemoryAllocation> Added;
+    std::vector<GPUMemoryAllocation> Removed;
+};
+
+class GPUMemoryTracker
+{
+public:
+    // Returns the id to remove it with
+    uint64_t Add(uint64_t bytes, const GPUMemoryTag& tag);
+
+    // Throws std::runtime_error for an id that isn't there
+    void Remove(uint64_t id);
+
+    GPUMemoryTotal GetTotal() const;
+    GPUMemoryTotal GetCategoryTotal(GPUMemoryCategory category) const;
+    GPUMemoryTotal GetOwnerTotal(const std::string& owner) const; // all zero for an unknown owner
+
+    // The high water marks start over from the current totals
+    void ResetHighWater();
+
+    GPUMemorySnapshot TakeSnapshot(uint64_t frame) const;
+
+private:
+    void AddToTotal(GPUMemoryTotal& total, uint64_t bytes);
+
+    mutable std::mutex m_Mutex;
+    std::unordered_map<uint64_t, GPUMemoryAllocation> m_Allocations;
+    uint64_t m_NextId = 1;
+    GPUMemoryTotal m_Total = {};
+    GPUMemoryTotal m_Categories[GPU_MEMORY_CATEGORY_COUNT] = {};
+    std::map<std::string, GPUMemoryTotal> m_Owners; // kept once they're empty, for their high water mark
+};
+
+GPUMemoryDiff DiffGPUMemory(const GPUMemorySnapshot& from, const GPUMemorySnapshot& to);
+
+// One line each. Without allocations the snapshot only has the totals.
+std::string GPUMemorySnapshotToJSON(const GPUMemorySnapshot& snapshot, bool allocations = true);
+std::string GPUMemoryDiffToJSON(const GPUMemoryDiff& diff);
@@ -0,0 +1,71 @@
+#include "GPUTimer.h"
+
+#include "d3dx12.h"
+#include "GPUMemoryTagging.h"
+#include "Helpers.h"
+
+#include <cassert>
+
+using namespace Microsoft::WRL;
+
+GPUTimer::GPUTimer(ComPtr<ID3D12Device2> device, ComPtr<ID3D12CommandQueue> commandQueue, uint32_t numFrames, uint32_t nodeMask)
+    : m_Recorded(numFrames, false)
+{
+    D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+    queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    queryHeapDesc.Count = numFrames * 2;
+    queryHeapDesc.NodeMask = nodeMask;
+    ThrowIfFailed(device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_QueryHeap)));
+    m_QueryHeap->SetName(L"GPU timer queries");
+    GPU_MEMORY_TAG(m_QueryHeap.Get(), "GPUTimer", GPUMemoryCategory::QueryHeap, sizeof(uint64_t) * queryHeapDesc.Count);
+
+    CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_READBACK, nodeMask, nodeMask);
+    CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(sizeof(uint64_t) * numFrames * 2);
+    ThrowIfFailed(device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_ReadbackBuffer)));
+    m_ReadbackBuffer->SetName(L"GPU timer readback");
+    GPU_MEMORY_TAG(m_ReadbackBuffer.Get(), "GPUTimer");
+
+    // Readback buffers may stay mapped, we only ever read slots the GPU is done with
+    void* data = nullptr;
+    ThrowIfFailed(m_ReadbackBuffer->Map(0, nullptr, &data));
+    m_Timestamps = static_cast<const uint64_t*>(data);
+
+    uint64_t frequency = 0;
+    ThrowIfFailed(commandQueue->GetTimestampFrequency(&frequency));
+    m_TicksToMilliseconds = 1000.0 / frequency;
+}
+
+GPUTimer::~GPUTimer()
+{
+    D3D12_RANGE writtenRange = { 0, 0 };
+    m_ReadbackBuffer->Unmap(0, &writtenRange);
+}
+
+void GPUTimer::Begin(ID3D12GraphicsCommandList* commandList, uint32_t frameIndex)
+{
+    assert(frameIndex < m_Recorded.size());
+    commandList->EndQuery(m_QueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, frameIndex * 2);
+}
+
+void GPUTimer::End(ID3D12GraphicsCommandList* commandList, uint32_t frameIndex)
+{
+    assert(frameIndex < m_Recorded.size());
+    commandList->EndQuery(m_QueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, frameIndex * 2 + 1);
+    commandList->ResolveQueryData(m_QueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, frameIndex * 2, 2,
+        m_ReadbackBuffer.Get(), sizeof(uint64_t) * frameIndex * 2);
+    m_Recorded[frameIndex] = true;
+}
+
+bool GPUTimer::GetFrameTime(uint32_t frameIndex, double& milliseconds) const
+{
+    if (!m_Recorded[frameIndex])
+    {
+        return false;
+    }
+
+    uint64_t begin = m_Timestamps[frameIndex * 2];
+    uint64_t end = m_Timestamps[frameIndex * 2 + 1];
+    milliseconds = end > begin ? (end - begin) * m_TicksToMilliseconds : 0.0;
+    return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+// GPU frame timing with timestamp queries
+// Begin/End bracket a frame's command list with two timestamps, resolved into a persistently
+// mapped READBACK buffer. Every frame in flight has its own slots, so the result of a frame can
+// be read without any extra sync once the fence of that frame has been waited on anyway.
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <wrl.h>
+#include <d3d12.h>
+
+#include <cstdint>
+#include <vector>
+
+class GPUTimer
+{
+public:
+    // commandQueue is the queue the timed command lists run on (timestamp frequency is per queue),
+    // nodeMask the node it's on with a linked adapter (0 = node 0)
+    GPUTimer(Microsoft::WRL::ComPtr<ID3D12Device2> device, Microsoft::WRL::ComPtr<ID3D12CommandQueue> commandQueue,
+        uint32_t numFrames, uint32_t nodeMask = 0);
+    ~GPUTimer();
+
+    void Begin(ID3D12GraphicsCommandList* commandList, uint32_t frameIndex);
+    void End(ID3D12GraphicsCommandList* commandList, uint32_t frameIndex);
+
+    // Only once the fence of the frame last recorded with frameIndex has completed.
+    // Returns false if nothing has been recorded for that slot yet.
+    bool GetFrameTime(uint32_t frameIndex, double& milliseconds) const;
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12QueryHeap> m_QueryHeap;
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_ReadbackBuffer;
+    const uint64_t* m_Timestamps = nullptr; // mapped, 2 per frame
+    double m_TicksToMilliseconds;
+    std::vector<bool> m_Recorded;
+};
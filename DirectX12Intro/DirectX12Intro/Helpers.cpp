@@ -0,0 +1,87 @@
+#include "Helpers.h"
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+namespace
+{
+    // Both together under the mutex, a thread that finds the callback gone must also find the reason it left
+    std::mutex g_DeviceRemovedMutex;
+    DeviceRemovedCallback g_DeviceRemovedCallback = nullptr;
+    HRESULT g_DeviceRemovedReason = S_OK;
+
+    bool IsDeviceLost(HRESULT hr)
+    {
+        return hr == DXGI_ERROR_DEVICE_REMOVED || hr == DXGI_ERROR_DEVICE_RESET || hr == DXGI_ERROR_DEVICE_HUNG
+            || hr == DXGI_ERROR_DRIVER_INTERNAL_ERROR;
+    }
+
+    std::string FormatError(HRESULT result, HRESULT removedReason, const char* file, int line)
+    {
+        char buffer[512];
+        int length = std::snprintf(buffer, sizeof(buffer), "%s(%d): HRESULT 0x%08X", file, line, static_cast<unsigned>(result));
+
+        // Append the system's description if it has one (it ends with a line break already)
+        char description[256] = {};
+        if (::FormatMessageA(FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, nullptr, result, 0,
+            description, sizeof(description), nullptr) > 0 && length > 0 && length < static_cast<int>(sizeof(buffer)))
+        {
+            length += std::snprintf(buffer + length, sizeof(buffer) - length, " %s", description);
+            while (length > 0 && (buffer[length - 1] == '\n' || buffer[length - 1] == '\r'))
+            {
+                buffer[--length] = '\0';
+            }
+        }
+
+        std::string message = buffer;
+        if (removedReason != S_OK)
+        {
+            std::snprintf(buffer, sizeof(buffer), " (device removed reason 0x%08X)", static_cast<unsigned>(removedReason));
+            message += buffer;
+        }
+        return message;
+    }
+}
+
+HResultException::HResultException(HRESULT result, HRESULT removedReason, const char* file, int line)
+    : std::runtime_error(FormatError(result, removedReason, file, line))
+    , m_Result(result)
+    , m_RemovedReason(removedReason)
+    , m_File(file)
+    , m_Line(line)
+{}
+
+void SetDeviceRemovedCallback(DeviceRemovedCallback callback)
+{
+    std::lock_guard<std::mutex> lock(g_DeviceRemovedMutex);
+    g_DeviceRemovedCallback = callback;
+    g_DeviceRemovedReason = S_OK;
+}
+
+void ThrowHResult(HRESULT hr, const char* file, int line)
+{
+    HRESULT removedReason = S_OK;
+    if (IsDeviceLost(hr))
+    {
+        // Once the device is gone every call after the first one fails the same way,
+        // only the first gets to collect the report, the others wait for it and reuse its reason
+        std::lock_guard<std::mutex> lock(g_DeviceRemovedMutex);
+        if (g_DeviceRemovedCallback)
+        {
+            g_DeviceRemovedReason = g_DeviceRemovedCallback();
+            g_DeviceRemovedCallback = nullptr;
+        }
+        removedReason = g_DeviceRemovedReason;
+        if (removedReason == S_OK)
+        {
+            // No callback set, still tell the catch site the device is lost
+            removedReason = hr;
+        }
+    }
+
+    HResultException exception(hr, removedReason, file, line);
+    ::OutputDebugStringA(exception.what());
+    ::OutputDebugStringA("\n");
+    throw exception;
+}
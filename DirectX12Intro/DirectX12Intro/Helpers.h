@@ -1,16 +1,60 @@
 #pragma once
 
+#if defined(_WIN32)
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h> // For HRESULT
-#include <exception>
+#define HELPERS_NOINLINE __declspec(noinline)
+#else
+// Just enough of Windows.h for RuntimeBench to time ThrowIfFailed on other platforms (Helpers.cpp stays Windows only)
+#include <cstdint>
+using HRESULT = int32_t;
+#define S_OK HRESULT(0)
+#define FAILED(hr) (HRESULT(hr) < 0)
+#define HELPERS_NOINLINE __attribute__((noinline))
+#endif
 
-// From DXSampleHelper.h 
+#include <stdexcept>
+
+// What ThrowIfFailed throws: the failed HRESULT, the file/line of the call and,
+// if the call failed because the device went away, the device removed reason.
+class HResultException : public std::runtime_error
+{
+public:
+    HResultException(HRESULT result, HRESULT removedReason, const char* file, int line);
+
+    HRESULT GetResult() const { return m_Result; }
+    HRESULT GetRemovedReason() const { return m_RemovedReason; } // S_OK unless the device was lost
+    const char* GetFile() const { return m_File; }
+    int GetLine() const { return m_Line; }
+
+private:
+    HRESULT m_Result;
+    HRESULT m_RemovedReason;
+    const char* m_File;
+    int m_Line;
+};
+
+// Called from the error path the first time a call fails with DXGI_ERROR_DEVICE_REMOVED (or RESET/HUNG),
+// before anything is thrown. Should return ID3D12Device::GetDeviceRemovedReason() and is the place to
+// dump whatever tells us what the GPU was doing (breadcrumbs, DRED). Must not throw.
+using DeviceRemovedCallback = HRESULT(*)();
+void SetDeviceRemovedCallback(DeviceRemovedCallback callback);
+
+// The error path of ThrowIfFailed. Out of line and never inlined so each call site only carries
+// the compare, a branch that is never taken and a call, instead of a whole throw expression.
+[[noreturn]] HELPERS_NOINLINE void ThrowHResult(HRESULT hr, const char* file, int line);
+
+// From DXSampleHelper.h
 // Source: https://github.com/Microsoft/DirectX-Graphics-Samples
-// Checks the return value of DirectX API Functions
-inline void ThrowIfFailed(HRESULT hr)
+// Checks the return value of DirectX API Functions.
+// The fall through is the success path, which is what the branch predictor assumes for a forward branch it hasn't seen.
+inline void ThrowIfFailedAt(HRESULT hr, const char* file, int line)
 {
     if (FAILED(hr))
     {
-        throw std::exception();
+        ThrowHResult(hr, file, line);
     }
-}
\ No newline at end of file
+}
+
+// A macro so failures say where they happened
+#define ThrowIfFailed(hr) ThrowIfFailedAt((hr), __FILE__, __LINE__)
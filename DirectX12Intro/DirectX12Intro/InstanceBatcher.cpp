@@ -0,0 +1,262 @@
+#include "InstanceBatcher.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    const uint32_t NONE = 0xFFFFFFFF;
+}
+
+InstanceHandle InstanceBatcher::Add(const InstanceKey& key, const InstanceData& data, bool visible)
+{
+    InstanceHandle handle;
+    if (!m_FreeHandles.empty())
+    {
+        handle = m_FreeHandles.back();
+        m_FreeHandles.pop_back();
+    }
+    else
+    {
+        handle = static_cast<InstanceHandle>(m_Objects.size());
+        m_Objects.emplace_back();
+    }
+
+    Object& object = m_Objects[handle];
+    object.Key = key;
+    object.Group = NONE;
+    object.Slot = 0;
+    object.Alive = true;
+    object.Visible = visible;
+    object.Data = data;
+    ++m_NumObjects;
+
+    if (visible)
+    {
+        Join(handle);
+    }
+    return handle;
+}
+
+void InstanceBatcher::Remove(InstanceHandle handle)
+{
+    Object& object = FindObject(handle);
+    if (object.Visible)
+    {
+        Leave(handle);
+    }
+    object.Alive = false;
+    m_FreeHandles.push_back(handle);
+    --m_NumObjects;
+}
+
+void InstanceBatcher::SetKey(InstanceHandle handle, const InstanceKey& key)
+{
+    Object& object = FindObject(handle);
+    if (object.Key == key)
+    {
+        return;
+    }
+
+    if (object.Visible)
+    {
+        Leave(handle);
+        object.Key = key;
+        Join(handle);
+    }
+    else
+    {
+        object.Key = key;
+    }
+}
+
+void InstanceBatcher::SetData(InstanceHandle handle, const InstanceData& data)
+{
+    Object& object = FindObject(handle);
+    if (object.Visible)
+    {
+        m_Groups[object.Group].Instances[object.Slot] = data;
+    }
+    else
+    {
+        object.Data = data;
+    }
+}
+
+void InstanceBatcher::SetVisible(InstanceHandle handle, bool visible)
+{
+    Object& object = FindObject(handle);
+    if (object.Visible == visible)
+    {
+        return;
+    }
+
+    if (visible)
+    {
+        object.Visible = true;
+        Join(handle);
+    }
+    else
+    {
+        Leave(handle);
+        object.Visible = false;
+    }
+}
+
+const InstanceKey& InstanceBatcher::GetKey(InstanceHandle handle) const
+{
+    return FindObject(handle).Key;
+}
+
+const InstanceData& InstanceBatcher::GetData(InstanceHandle handle) const
+{
+    const Object& object = FindObject(handle);
+    return object.Visible ? m_Groups[object.Group].Instances[object.Slot] : object.Data;
+}
+
+bool InstanceBatcher::IsVisible(InstanceHandle handle) const
+{
+    return FindObject(handle).Visible;
+}
+
+bool InstanceBatcher::Submit(IInstanceBackend& backend)
+{
+    if (m_OrderDirty)
+    {
+        RebuildOrder();
+    }
+
+    m_Batches.clear();
+    if (m_NumVisible == 0)
+    {
+        return true;
+    }
+
+    InstanceData* instances = backend.AllocateInstances(m_NumVisible);
+    if (!instances)
+    {
+        return false;
+    }
+
+    // One straight copy per group, the destination is write combined upload memory
+    uint32_t firstInstance = 0;
+    for (uint32_t groupIndex : m_Order)
+    {
+        const Group& group = m_Groups[groupIndex];
+        uint32_t numInstances = static_cast<uint32_t>(group.Instances.size());
+        std::memcpy(instances + firstInstance, group.Instances.data(), numInstances * sizeof(InstanceData));
+        m_Batches.push_back({ group.Key, firstInstance, numInstances });
+        firstInstance += numInstances;
+    }
+
+    for (const InstanceBatch& batch : m_Batches)
+    {
+        backend.DrawInstances(batch.Key, batch.FirstInstance, batch.NumInstances);
+    }
+    return true;
+}
+
+InstanceBatcher::Object& InstanceBatcher::FindObject(InstanceHandle handle)
+{
+    return const_cast<Object&>(static_cast<const InstanceBatcher*>(this)->FindObject(handle));
+}
+
+const InstanceBatcher::Object& InstanceBatcher::FindObject(InstanceHandle handle) const
+{
+    if (handle >= m_Objects.size() || !m_Objects[handle].Alive)
+    {
+        throw std::runtime_error("Invalid instance handle " + std::to_string(handle));
+    }
+    return m_Objects[handle];
+}
+
+void InstanceBatcher::Join(InstanceHandle handle)
+{
+    Object& object = m_Objects[handle];
+
+    auto found = m_GroupIndices.find(object.Key);
+    uint32_t groupIndex;
+    if (found != m_GroupIndices.end())
+    {
+        groupIndex = found->second;
+    }
+    else
+    {
+        if (!m_FreeGroups.empty())
+        {
+            groupIndex = m_FreeGroups.back();
+            m_FreeGroups.pop_back();
+        }
+        else
+        {
+            groupIndex = static_cast<uint32_t>(m_Groups.size());
+            m_Groups.emplace_back();
+        }
+        m_Groups[groupIndex].Key = object.Key;
+        m_GroupIndices.emplace(object.Key, groupIndex);
+        m_OrderDirty = true;
+    }
+
+    Group& group = m_Groups[groupIndex];
+    object.Group = groupIndex;
+    object.Slot = static_cast<uint32_t>(group.Instances.size());
+    group.Instances.push_back(object.Data);
+    group.Members.push_back(handle);
+    ++m_NumVisible;
+    ++m_Stats.MembershipChanges;
+}
+
+void InstanceBatcher::Leave(InstanceHandle handle)
+{
+    Object& object = m_Objects[handle];
+    Group& group = m_Groups[object.Group];
+    object.Data = group.Instances[object.Slot];
+
+    // The group's last instance takes the slot
+    InstanceHandle last = group.Members.back();
+    group.Instances[object.Slot] = group.Instances.back();
+    group.Members[object.Slot] = last;
+    m_Objects[last].Slot = object.Slot;
+    group.Instances.pop_back();
+    group.Members.pop_back();
+
+    if (group.Members.empty())
+    {
+        m_GroupIndices.erase(group.Key);
+        m_FreeGroups.push_back(object.Group);
+        m_OrderDirty = true;
+    }
+
+    object.Group = NONE;
+    --m_NumVisible;
+    ++m_Stats.MembershipChanges;
+}
+
+void InstanceBatcher::RebuildOrder()
+{
+    // Pipeline state changes cost the most, then the material's constants, then the vertex and index buffers
+    m_Order.clear();
+    for (const auto& entry : m_GroupIndices)
+    {
+        m_Order.push_back(entry.second);
+    }
+    std::sort(m_Order.begin(), m_Order.end(), [this](uint32_t a, uint32_t b)
+    {
+        const InstanceKey& keyA = m_Groups[a].Key;
+        const InstanceKey& keyB = m_Groups[b].Key;
+        if (keyA.PipelineState != keyB.PipelineState)
+        {
+            return keyA.PipelineState < keyB.PipelineState;
+        }
+        if (keyA.Material != keyB.Material)
+        {
+            return keyA.Material < keyB.Material;
+        }
+        return keyA.Mesh < keyB.Mesh;
+    });
+
+    m_OrderDirty = false;
+    ++m_Stats.Rebuilds;
+}
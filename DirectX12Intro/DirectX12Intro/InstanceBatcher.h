@@ -0,0 +1,141 @@
+#pragma once
+
+// Automatic instancing
+// Objects sharing a mesh, a material and a pipeline state (an InstanceKey) get drawn with one instanced draw instead
+// of one draw each. Every object's per instance data (InstanceData) lives in its group's packed array, so a frame
+// only has to copy each group's array into the upload ring and issue its draw:
+//
+//   Add / Remove / SetVisible / SetKey : membership changes, O(1) each (swap with the group's last instance)
+//   SetData                            : overwrites the instance in place, the groups stay as they are
+//   Submit                             : re-sorts the groups only if one was created or emptied since the last frame,
+//                                        then one copy and one draw per group, in PSO, material, mesh order
+//
+// The draws go through IInstanceBackend: InstanceRenderer records them into a command list with the UploadRing,
+// RuntimeBench instancing runs a 100k object scene against a null one.
+// Only uses the STL.
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Indices into whatever tables the backend keeps
+struct InstanceKey
+{
+    uint32_t Mesh;
+    uint32_t Material;
+    uint32_t PipelineState;
+
+    bool operator==(const InstanceKey& other) const
+    {
+        return Mesh == other.Mesh && Material == other.Material && PipelineState == other.PipelineState;
+    }
+};
+
+// What Instance_VS.hlsl reads per instance, 64 bytes
+struct InstanceData
+{
+    float World[3][4];    // the world matrix's first three columns, each a float4 dot with (position, 1)
+    uint32_t UserData[4]; // whatever the material wants per object, a tint, an object id...
+};
+
+struct InstanceBatch
+{
+    InstanceKey Key;
+    uint32_t FirstInstance; // into the frame's instance data
+    uint32_t NumInstances;
+};
+
+class IInstanceBackend
+{
+public:
+    virtual ~IInstanceBackend() = default;
+
+    // Room for the frame's instance data, nullptr if there isn't any
+    virtual InstanceData* AllocateInstances(uint32_t numInstances) = 0;
+
+    // One instanced draw of key's mesh, with the instances [firstInstance, firstInstance + numInstances) of the
+    // frame's allocation
+    virtual void DrawInstances(const InstanceKey& key, uint32_t firstInstance, uint32_t numInstances) = 0;
+};
+
+using InstanceHandle = uint32_t;
+
+struct InstanceBatcherStats
+{
+    uint64_t MembershipChanges; // objects that joined or left a group
+    uint64_t Rebuilds;          // times the draw order was sorted again
+};
+
+class InstanceBatcher
+{
+public:
+    // The handle stays valid until Remove, then gets reused. Methods throw std::runtime_error on a handle that isn't.
+    InstanceHandle Add(const InstanceKey& key, const InstanceData& data, bool visible = true);
+    void Remove(InstanceHandle handle);
+
+    void SetKey(InstanceHandle handle, const InstanceKey& key);
+    void SetData(InstanceHandle handle, const InstanceData& data);
+    void SetVisible(InstanceHandle handle, bool visible);
+
+    const InstanceKey& GetKey(InstanceHandle handle) const;
+    const InstanceData& GetData(InstanceHandle handle) const;
+    bool IsVisible(InstanceHandle handle) const;
+
+    // Copies every visible instance through the backend and draws each group once. Returns false without drawing
+    // anything if the backend had no room.
+    bool Submit(IInstanceBackend& backend);
+
+    // The draws the last Submit made, in order
+    const std::vector<InstanceBatch>& GetBatches() const { return m_Batches; }
+
+    uint32_t GetNumObjects() const { return m_NumObjects; }
+    uint32_t GetNumVisible() const { return m_NumVisible; }
+    const InstanceBatcherStats& GetStats() const { return m_Stats; }
+
+private:
+    struct InstanceKeyHash
+    {
+        size_t operator()(const InstanceKey& key) const
+        {
+            return (size_t(key.PipelineState) * 0x9E3779B1u ^ key.Material) * 0x85EBCA77u ^ key.Mesh;
+        }
+    };
+
+    struct Group
+    {
+        InstanceKey Key;
+        std::vector<InstanceData> Instances; // packed, what gets copied to the GPU
+        std::vector<InstanceHandle> Members; // who each instance belongs to
+    };
+
+    struct Object
+    {
+        InstanceKey Key;
+        uint32_t Group; // NONE unless visible
+        uint32_t Slot;  // in the group
+        bool Alive;
+        bool Visible;
+        InstanceData Data; // kept while hidden
+    };
+
+    Object& FindObject(InstanceHandle handle);
+    const Object& FindObject(InstanceHandle handle) const;
+    void Join(InstanceHandle handle);
+    void Leave(InstanceHandle handle);
+    void RebuildOrder();
+
+    std::vector<Object> m_Objects;
+    std::vector<InstanceHandle> m_FreeHandles;
+    uint32_t m_NumObjects = 0;
+    uint32_t m_NumVisible = 0;
+
+    std::vector<Group> m_Groups;
+    std::vector<uint32_t> m_FreeGroups;
+    std::unordered_map<InstanceKey, uint32_t, InstanceKeyHash> m_GroupIndices;
+    std::vector<uint32_t> m_Order; // groups in draw order
+    bool m_OrderDirty = false;
+
+    std::vector<InstanceBatch> m_Batches;
+    InstanceBatcherStats m_Stats = {};
+};
@@ -0,0 +1,126 @@
+#include "InstanceRenderer.h"
+
+#include <d3dcompiler.h>
+
+#include "d3dx12.h"
+#include "Helpers.h"
+#include "UploadRing.h"
+
+#include <cassert>
+
+using namespace Microsoft::WRL;
+using namespace DirectX;
+
+InstanceRenderer::InstanceRenderer(ComPtr<ID3D12Device2> device)
+    : m_Device(device)
+{
+    CD3DX12_ROOT_PARAMETER rootParameters[NUM_ROOT_PARAMETERS];
+    rootParameters[ROOT_VIEW].InitAsConstants(sizeof(XMFLOAT4X4) / 4, 0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+    rootParameters[ROOT_MATERIAL].InitAsConstants(sizeof(XMFLOAT4) / 4, 1, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+    rootParameters[ROOT_INSTANCES].InitAsShaderResourceView(0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+
+    CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc(_countof(rootParameters), rootParameters, 0, nullptr,
+        D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+
+    ComPtr<ID3DBlob> rootSignatureBlob;
+    ComPtr<ID3DBlob> errorBlob;
+    ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &rootSignatureBlob, &errorBlob));
+    ThrowIfFailed(m_Device->CreateRootSignature(0, rootSignatureBlob->GetBufferPointer(),
+        rootSignatureBlob->GetBufferSize(), IID_PPV_ARGS(&m_RootSignature)));
+
+    // Compiled by the FxCompile step of the project, lands next to the executable
+    ThrowIfFailed(D3DReadFileToBlob(L"Instance_VS.cso", &m_VertexShader));
+    ThrowIfFailed(D3DReadFileToBlob(L"Instance_PS.cso", &m_PixelShader));
+}
+
+uint32_t InstanceRenderer::AddMesh(const InstanceMesh& mesh)
+{
+    m_Meshes.push_back(mesh);
+    return static_cast<uint32_t>(m_Meshes.size() - 1);
+}
+
+uint32_t InstanceRenderer::AddMaterial(const XMFLOAT4& color)
+{
+    m_Materials.push_back(color);
+    return static_cast<uint32_t>(m_Materials.size() - 1);
+}
+
+uint32_t InstanceRenderer::AddPipelineState(DXGI_FORMAT renderTargetFormat, DXGI_FORMAT depthStencilFormat, D3D12_FILL_MODE fillMode)
+{
+    const D3D12_INPUT_ELEMENT_DESC inputLayout[] = {
+        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    };
+
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC pipelineStateDesc = {};
+    pipelineStateDesc.pRootSignature = m_RootSignature.Get();
+    pipelineStateDesc.VS = CD3DX12_SHADER_BYTECODE(m_VertexShader.Get());
+    pipelineStateDesc.PS = CD3DX12_SHADER_BYTECODE(m_PixelShader.Get());
+    pipelineStateDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+    pipelineStateDesc.SampleMask = UINT_MAX;
+    pipelineStateDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+    pipelineStateDesc.RasterizerState.FillMode = fillMode;
+    pipelineStateDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+    pipelineStateDesc.DepthStencilState.DepthEnable = depthStencilFormat != DXGI_FORMAT_UNKNOWN;
+    pipelineStateDesc.InputLayout = { inputLayout, _countof(inputLayout) };
+    pipelineStateDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+    pipelineStateDesc.NumRenderTargets = 1;
+    pipelineStateDesc.RTVFormats[0] = renderTargetFormat;
+    pipelineStateDesc.DSVFormat = depthStencilFormat;
+    pipelineStateDesc.SampleDesc = { 1, 0 };
+
+    ComPtr<ID3D12PipelineState> pipelineState;
+    ThrowIfFailed(m_Device->CreateGraphicsPipelineState(&pipelineStateDesc, IID_PPV_ARGS(&pipelineState)));
+    m_PipelineStates.push_back(pipelineState);
+    return static_cast<uint32_t>(m_PipelineStates.size() - 1);
+}
+
+void InstanceRenderer::Begin(ID3D12GraphicsCommandList* commandList, UploadRing& uploadRing, FXMMATRIX viewProjection)
+{
+    m_CommandList = commandList;
+    m_UploadRing = &uploadRing;
+    m_Instances = 0;
+    m_Bound = { NONE, NONE, NONE };
+
+    XMFLOAT4X4 view;
+    XMStoreFloat4x4(&view, viewProjection); // row major, like the shader declares it
+    m_CommandList->SetGraphicsRootSignature(m_RootSignature.Get());
+    m_CommandList->SetGraphicsRoot32BitConstants(ROOT_VIEW, sizeof(view) / 4, &view, 0);
+    m_CommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+InstanceData* InstanceRenderer::AllocateInstances(uint32_t numInstances)
+{
+    assert(m_UploadRing && "AllocateInstances before Begin");
+
+    UploadAllocation allocation;
+    if (!m_UploadRing->TryAllocate(uint64_t(numInstances) * sizeof(InstanceData), sizeof(InstanceData), allocation))
+    {
+        return nullptr;
+    }
+    m_Instances = allocation.GPU;
+    return static_cast<InstanceData*>(allocation.CPU);
+}
+
+void InstanceRenderer::DrawInstances(const InstanceKey& key, uint32_t firstInstance, uint32_t numInstances)
+{
+    if (key.PipelineState != m_Bound.PipelineState)
+    {
+        m_CommandList->SetPipelineState(m_PipelineStates.at(key.PipelineState).Get());
+    }
+    if (key.Material != m_Bound.Material)
+    {
+        m_CommandList->SetGraphicsRoot32BitConstants(ROOT_MATERIAL, sizeof(XMFLOAT4) / 4, &m_Materials.at(key.Material), 0);
+    }
+    const InstanceMesh& mesh = m_Meshes.at(key.Mesh);
+    if (key.Mesh != m_Bound.Mesh)
+    {
+        m_CommandList->IASetVertexBuffers(0, 1, &mesh.VertexBuffer);
+        m_CommandList->IASetIndexBuffer(&mesh.IndexBuffer);
+    }
+    m_Bound = key;
+
+    // SV_InstanceID starts at 0 whatever StartInstanceLocation is, so the SRV starts at the batch instead
+    m_CommandList->SetGraphicsRootShaderResourceView(ROOT_INSTANCES, m_Instances + uint64_t(firstInstance) * sizeof(InstanceData));
+    m_CommandList->DrawIndexedInstanced(mesh.NumIndices, numInstances, 0, 0, 0);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+// The D3D12 backend of InstanceBatcher: each batch is one DrawIndexedInstanced, the instance data is read by
+// Instance_VS.hlsl from a root SRV into the frame's UploadRing allocation.
+// Keys index the tables filled with AddMesh, AddMaterial and AddPipelineState. The batcher sorts its draws by
+// pipeline state, material and mesh, and only what changed from the previous draw gets set again.
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <wrl.h>
+#include <d3d12.h>
+#include <DirectXMath.h>
+
+#include "InstanceBatcher.h"
+
+#include <cstdint>
+#include <vector>
+
+class UploadRing;
+
+// Float3 POSITION and NORMAL (Instance_VS.hlsl), 32 bit indices
+struct InstanceMesh
+{
+    D3D12_VERTEX_BUFFER_VIEW VertexBuffer;
+    D3D12_INDEX_BUFFER_VIEW IndexBuffer;
+    uint32_t NumIndices;
+};
+
+class InstanceRenderer : public IInstanceBackend
+{
+public:
+    explicit InstanceRenderer(Microsoft::WRL::ComPtr<ID3D12Device2> device);
+
+    uint32_t AddMesh(const InstanceMesh& mesh);
+    uint32_t AddMaterial(const DirectX::XMFLOAT4& color);
+
+    // Instance_VS/PS with the renderer's root signature, triangles, back faces culled
+    uint32_t AddPipelineState(DXGI_FORMAT renderTargetFormat, DXGI_FORMAT depthStencilFormat,
+        D3D12_FILL_MODE fillMode = D3D12_FILL_MODE_SOLID);
+
+    // Before InstanceBatcher::Submit, with the render targets bound. The command list and the ring are used until
+    // the next Begin.
+    void Begin(ID3D12GraphicsCommandList* commandList, UploadRing& uploadRing, DirectX::FXMMATRIX viewProjection);
+
+    InstanceData* AllocateInstances(uint32_t numInstances) override;
+    void DrawInstances(const InstanceKey& key, uint32_t firstInstance, uint32_t numInstances) override;
+
+private:
+    // Root parameters, matching Instance_VS.hlsl and Instance_PS.hlsl
+    enum RootParameter
+    {
+        ROOT_VIEW,      // b0, the view projection matrix
+        ROOT_MATERIAL,  // b1, the material's color
+        ROOT_INSTANCES, // t0, the frame's instance data
+        NUM_ROOT_PARAMETERS
+    };
+
+    static const uint32_t NONE = 0xFFFFFFFF;
+
+    Microsoft::WRL::ComPtr<ID3D12Device2> m_Device;
+    Microsoft::WRL::ComPtr<ID3D12RootSignature> m_RootSignature;
+    Microsoft::WRL::ComPtr<ID3DBlob> m_VertexShader;
+    Microsoft::WRL::ComPtr<ID3DBlob> m_PixelShader;
+
+    std::vector<InstanceMesh> m_Meshes;
+    std::vector<DirectX::XMFLOAT4> m_Materials;
+    std::vector<Microsoft::WRL::ComPtr<ID3D12PipelineState>> m_PipelineStates;
+
+    // This frame's
+    ID3D12GraphicsCommandList* m_CommandList = nullptr;
+    UploadRing* m_UploadRing = nullptr;
+    D3D12_GPU_VIRTUAL_ADDRESS m_Instances = 0;
+    InstanceKey m_Bound = { NONE, NONE, NONE }; // what the last draw left set
+};
@@ -0,0 +1,191 @@
+#include "LZ.h"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    const size_t MIN_MATCH = 4;
+    const size_t LAST_LITERALS = 5; // the tail of a block is always stored as literals
+    const size_t MAX_OFFSET = 65535;
+    const uint32_t HASH_BITS = 16;
+
+    uint32_t Read32(const uint8_t* p)
+    {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v)); // memcpy so unaligned reads are fine
+        return v;
+    }
+
+    uint32_t Hash(uint32_t sequence)
+    {
+        // Knuth's multiplicative hash, keep the top bits
+        return (sequence * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    // Writes the 255, 255, ..., remainder tail of a length. Returns false if out of space.
+    bool WriteLength(size_t length, uint8_t*& op, const uint8_t* oend)
+    {
+        for (; length >= 255; length -= 255)
+        {
+            if (op >= oend) return false;
+            *op++ = 255;
+        }
+        if (op >= oend) return false;
+        *op++ = static_cast<uint8_t>(length);
+        return true;
+    }
+
+    bool ReadLength(size_t& length, const uint8_t*& ip, const uint8_t* iend)
+    {
+        uint8_t b;
+        do
+        {
+            if (ip >= iend) return false;
+            b = *ip++;
+            length += b;
+        } while (b == 255);
+        return true;
+    }
+
+    bool WriteSequence(const uint8_t* literals, size_t numLiterals, size_t offset, size_t matchLength,
+        uint8_t*& op, const uint8_t* oend)
+    {
+        if (op >= oend) return false;
+        uint8_t* token = op++;
+
+        size_t literalCode = numLiterals < 15 ? numLiterals : 15;
+        if (literalCode == 15 && !WriteLength(numLiterals - 15, op, oend)) return false;
+
+        if (static_cast<size_t>(oend - op) < numLiterals) return false;
+        std::memcpy(op, literals, numLiterals);
+        op += numLiterals;
+
+        size_t matchCode = 0;
+        if (matchLength > 0)
+        {
+            if (oend - op < 2) return false;
+            *op++ = static_cast<uint8_t>(offset);
+            *op++ = static_cast<uint8_t>(offset >> 8);
+
+            matchCode = matchLength - MIN_MATCH < 15 ? matchLength - MIN_MATCH : 15;
+            if (matchCode == 15 && !WriteLength(matchLength - MIN_MATCH - 15, op, oend)) return false;
+        }
+
+        *token = static_cast<uint8_t>((literalCode << 4) | matchCode);
+        return true;
+    }
+}
+
+size_t LZ::CompressBound(size_t srcSize)
+{
+    // Every byte a literal: one token plus a length byte per 255 literals
+    return srcSize + srcSize / 255 + 16;
+}
+
+size_t LZ::Compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity)
+{
+    uint8_t* op = dst;
+    const uint8_t* oend = dst + dstCapacity;
+
+    // Last position each hashed 4 byte sequence was seen at
+    std::vector<int64_t> table(size_t(1) << HASH_BITS, -1);
+
+    size_t anchor = 0; // start of the literals not yet emitted
+    size_t ip = 0;
+
+    if (srcSize > MIN_MATCH + LAST_LITERALS)
+    {
+        const size_t matchLimit = srcSize - LAST_LITERALS;
+
+        while (ip + MIN_MATCH <= matchLimit)
+        {
+            uint32_t sequence = Read32(src + ip);
+            uint32_t h = Hash(sequence);
+            int64_t ref = table[h];
+            table[h] = static_cast<int64_t>(ip);
+
+            if (ref < 0 || ip - ref > MAX_OFFSET || Read32(src + ref) != sequence)
+            {
+                ++ip;
+                continue;
+            }
+
+            size_t matchLength = MIN_MATCH;
+            while (ip + matchLength < matchLimit && src[ref + matchLength] == src[ip + matchLength])
+            {
+                ++matchLength;
+            }
+
+            if (!WriteSequence(src + anchor, ip - anchor, ip - ref, matchLength, op, oend))
+            {
+                return 0;
+            }
+
+            ip += matchLength;
+            anchor = ip;
+        }
+    }
+
+    // Whatever is left goes out as literals
+    if (!WriteSequence(src + anchor, srcSize - anchor, 0, 0, op, oend))
+    {
+        return 0;
+    }
+
+    return static_cast<size_t>(op - dst);
+}
+
+size_t LZ::Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity)
+{
+    const uint8_t* ip = src;
+    const uint8_t* iend = src + srcSize;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + dstCapacity;
+
+    while (ip < iend)
+    {
+        uint8_t token = *ip++;
+
+        size_t numLiterals = token >> 4;
+        if (numLiterals == 15 && !ReadLength(numLiterals, ip, iend)) return 0;
+        if (static_cast<size_t>(iend - ip) < numLiterals || static_cast<size_t>(oend - op) < numLiterals) return 0;
+
+        std::memcpy(op, ip, numLiterals);
+        ip += numLiterals;
+        op += numLiterals;
+
+        // The last sequence has no match
+        if (ip >= iend)
+        {
+            break;
+        }
+
+        if (iend - ip < 2) return 0;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > static_cast<size_t>(op - dst)) return 0;
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !ReadLength(matchLength, ip, iend)) return 0;
+        matchLength += MIN_MATCH;
+        if (static_cast<size_t>(oend - op) < matchLength) return 0;
+
+        const uint8_t* match = op - offset;
+        if (offset >= matchLength)
+        {
+            std::memcpy(op, match, matchLength);
+            op += matchLength;
+        }
+        else
+        {
+            // Overlapping copy (e.g. a run of the same byte), has to go byte by byte
+            for (size_t i = 0; i < matchLength; ++i)
+            {
+                *op++ = *match++;
+            }
+        }
+    }
+
+    return static_cast<size_t>(op - dst);
+}
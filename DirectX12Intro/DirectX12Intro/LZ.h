@@ -0,0 +1,29 @@
+#pragma once
+
+// A tiny self contained LZ77 block codec (LZ4-style byte format).
+// Fast to decode, which is what matters at load time. Compression ratio is not its strong suit.
+//
+// A block is a list of sequences:
+//   token      : high nibble = literal count, low nibble = match length - 4 (15 = more bytes follow)
+//   [length]   : extra literal count bytes, each 255 means keep reading
+//   literals
+//   offset     : 2 bytes little endian, distance back into the output (not present on the last sequence)
+//   [length]   : extra match length bytes
+// The last sequence of a block is literals only.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace LZ
+{
+    // Worst case output size for srcSize bytes of incompressible input
+    size_t CompressBound(size_t srcSize);
+
+    // Returns the compressed size, or 0 if the result doesn't fit in dstCapacity
+    // (callers just store the data raw in that case).
+    size_t Compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity);
+
+    // Returns the decompressed size, or 0 if the block is malformed or doesn't fit in dstCapacity.
+    // Never reads or writes out of bounds, so it is safe to run on untrusted data.
+    size_t Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity);
+}
@@ -0,0 +1,365 @@
+#include "LinkedDevice.h"
+
+#include "d3dx12.h"
+#include "GPUMemoryTagging.h"
+#include "GPUTimer.h"
+#include "Helpers.h"
+
+#include <cassert>
+
+using namespace Microsoft::WRL;
+
+namespace
+{
+    // The nodes we can use in the given mode: copying between them needs cross-node sharing
+    uint32_t GetUsableNodeCount(ID3D12Device2* device, MultiGPUMode mode)
+    {
+        uint32_t numNodes = device->GetNodeCount();
+        if (mode == MultiGPUMode::Single || numNodes < 2)
+        {
+            return 1;
+        }
+
+        D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+        ThrowIfFailed(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options)));
+        if (options.CrossNodeSharingTier == D3D12_CROSS_NODE_SHARING_TIER_NOT_SUPPORTED)
+        {
+            ::OutputDebugStringA("Linked adapter without cross-node sharing, using node 0 only\n");
+            return 1;
+        }
+        return numNodes;
+    }
+
+    void ExecuteCommandList(ID3D12CommandQueue* queue, ID3D12CommandList* commandList)
+    {
+        ID3D12CommandList* const commandLists[] = { commandList };
+        queue->ExecuteCommandLists(_countof(commandLists), commandLists);
+    }
+}
+
+LinkedDevice::LinkedDevice(ComPtr<ID3D12Device2> device, ComPtr<ID3D12CommandQueue> directQueue, MultiGPUMode mode,
+    uint32_t numFrames)
+    : m_Device(device)
+    , m_Scheduler(GetUsableNodeCount(device.Get(), mode), mode)
+    , m_Nodes(m_Scheduler.GetNumNodes())
+{
+    for (uint32_t node = 0; node < GetNumNodes(); ++node)
+    {
+        Node& n = m_Nodes[node];
+        UINT nodeMask = GetNodeMask(node);
+
+        D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+        queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+        queueDesc.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL;
+        queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+        queueDesc.NodeMask = nodeMask;
+        if (node == 0)
+        {
+            n.DirectQueue = directQueue;
+        }
+        else
+        {
+            ThrowIfFailed(m_Device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&n.DirectQueue)));
+        }
+        queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+        ThrowIfFailed(m_Device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&n.CopyQueue)));
+
+        // Allocators aren't tied to a node, the command lists recorded with them are
+        for (uint32_t list = 0; list < 2; ++list)
+        {
+            n.Allocators[list].resize(numFrames);
+            for (ComPtr<ID3D12CommandAllocator>& allocator : n.Allocators[list])
+            {
+                ThrowIfFailed(m_Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&allocator)));
+            }
+            ThrowIfFailed(m_Device->CreateCommandList(nodeMask, D3D12_COMMAND_LIST_TYPE_DIRECT, n.Allocators[list][0].Get(),
+                nullptr, IID_PPV_ARGS(&n.CommandLists[list])));
+            ThrowIfFailed(n.CommandLists[list]->Close());
+        }
+
+        n.CopyAllocators.resize(numFrames);
+        for (ComPtr<ID3D12CommandAllocator>& allocator : n.CopyAllocators)
+        {
+            ThrowIfFailed(m_Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&allocator)));
+        }
+        ThrowIfFailed(m_Device->CreateCommandList(nodeMask, D3D12_COMMAND_LIST_TYPE_COPY, n.CopyAllocators[0].Get(),
+            nullptr, IID_PPV_ARGS(&n.CopyCommandList)));
+        ThrowIfFailed(n.CopyCommandList->Close());
+
+        // Fences aren't tied to a node either, any node's queues can wait on them
+        ThrowIfFailed(m_Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&n.Fence)));
+        ThrowIfFailed(m_Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&n.CopyFence)));
+        n.FrameFenceValues.assign(numFrames, 0);
+        n.FrameCopyFenceValues.assign(numFrames, 0);
+
+        if (GetMode() == MultiGPUMode::SplitFrame)
+        {
+            n.Timer = std::make_unique<GPUTimer>(m_Device, n.DirectQueue, numFrames, nodeMask);
+        }
+    }
+
+    m_FenceEvent = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+    assert(m_FenceEvent && "Failed to create fence event.");
+}
+
+LinkedDevice::~LinkedDevice()
+{
+    Flush();
+    ::CloseHandle(m_FenceEvent);
+}
+
+void LinkedDevice::ResizeSwapChain(IDXGISwapChain3* swapChain, uint32_t width, uint32_t height)
+{
+    DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
+    ThrowIfFailed(swapChain->GetDesc1(&swapChainDesc));
+
+    std::vector<UINT> nodeMasks(swapChainDesc.BufferCount);
+    std::vector<IUnknown*> presentQueues(swapChainDesc.BufferCount);
+    for (uint32_t i = 0; i < swapChainDesc.BufferCount; ++i)
+    {
+        uint32_t node = m_Scheduler.GetBackBufferNode(i);
+        nodeMasks[i] = GetNodeMask(node);
+        presentQueues[i] = m_Nodes[node].DirectQueue.Get();
+    }
+
+    ThrowIfFailed(swapChain->ResizeBuffers1(swapChainDesc.BufferCount, width, height, swapChainDesc.Format,
+        swapChainDesc.Flags, nodeMasks.data(), presentQueues.data()));
+}
+
+std::vector<ComPtr<ID3D12Resource>> LinkedDevice::CreateNodeResources(NodeSharing sharing, const D3D12_RESOURCE_DESC& desc,
+    D3D12_RESOURCE_STATES initialState, const wchar_t* name)
+{
+    std::vector<ComPtr<ID3D12Resource>> resources(GetNumNodeInstances(sharing, GetNumNodes()));
+    for (uint32_t i = 0; i < resources.size(); ++i)
+    {
+        NodeMasks masks = GetNodeMasks(sharing, i, GetNumNodes());
+        CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT, masks.CreationNodeMask, masks.VisibleNodeMask);
+        ThrowIfFailed(m_Device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &desc, initialState,
+            nullptr, IID_PPV_ARGS(&resources[i])));
+        if (name)
+        {
+            resources[i]->SetName(name);
+        }
+        GPU_MEMORY_TAG(resources[i].Get(), "LinkedDevice");
+    }
+    return resources;
+}
+
+uint32_t LinkedDevice::AddHistoryBuffer(const D3D12_RESOURCE_DESC& desc, const wchar_t* name)
+{
+    m_HistoryBuffers.push_back(CreateNodeResources(NodeSharing::PerNodeVisible, desc, D3D12_RESOURCE_STATE_COMMON, name));
+    return static_cast<uint32_t>(m_HistoryBuffers.size() - 1);
+}
+
+void LinkedDevice::SetSplitFrameTarget(const D3D12_RESOURCE_DESC& desc, const wchar_t* name)
+{
+    m_SplitFrameTargets = CreateNodeResources(NodeSharing::PerNodeVisible, desc, D3D12_RESOURCE_STATE_COMMON, name);
+}
+
+void LinkedDevice::WaitForFrame(uint32_t backBufferIndex)
+{
+    for (Node& n : m_Nodes)
+    {
+        WaitForFence(n.Fence.Get(), n.FrameFenceValues[backBufferIndex]);
+        WaitForFence(n.CopyFence.Get(), n.FrameCopyFenceValues[backBufferIndex]);
+    }
+}
+
+const MultiGPUFrame& LinkedDevice::BeginFrame(uint32_t backBufferIndex)
+{
+    WaitForFrame(backBufferIndex);
+    m_BackBufferIndex = backBufferIndex;
+
+    // The band times of the last frame in this slot are in now
+    UpdateSplit();
+
+    m_Frame = m_Scheduler.BeginFrame(backBufferIndex);
+    for (uint32_t node = 0; node < GetNumNodes(); ++node)
+    {
+        if ((m_Frame.NodeMask & GetNodeMask(node)) == 0)
+        {
+            continue;
+        }
+
+        Node& n = m_Nodes[node];
+        n.CurrentList = 0;
+        n.CopyQueued = false;
+        ThrowIfFailed(n.Allocators[0][backBufferIndex]->Reset());
+        ThrowIfFailed(n.Allocators[1][backBufferIndex]->Reset());
+        ThrowIfFailed(n.CommandLists[0]->Reset(n.Allocators[0][backBufferIndex].Get(), nullptr));
+
+        if (n.Timer)
+        {
+            n.Timer->Begin(n.CommandLists[0].Get(), backBufferIndex);
+        }
+    }
+
+    // Queued right away: it only waits for the previous frame, not for anything recorded in this one
+    if (m_Frame.CopyHistory && !m_HistoryBuffers.empty())
+    {
+        QueueHistoryCopy(m_Frame.PresentNode, m_Frame.HistorySourceNode);
+    }
+
+    return m_Frame;
+}
+
+ID3D12GraphicsCommandList2* LinkedDevice::GetCommandList(uint32_t node) const
+{
+    assert(m_Frame.NodeMask & GetNodeMask(node));
+    const Node& n = m_Nodes[node];
+    return n.CommandLists[n.CurrentList].Get();
+}
+
+void LinkedDevice::BeginDependentWork()
+{
+    Node& n = m_Nodes[m_Frame.PresentNode];
+    if (n.CurrentList == 1)
+    {
+        return;
+    }
+
+    // The first list stays open until EndFrame, it's executed before the wait
+    ThrowIfFailed(n.CommandLists[1]->Reset(n.Allocators[1][m_BackBufferIndex].Get(), nullptr));
+    n.CurrentList = 1;
+}
+
+void LinkedDevice::EndFrame()
+{
+    // The present node last, in SFR it waits for the others
+    for (uint32_t i = 1; i <= GetNumNodes(); ++i)
+    {
+        uint32_t node = (m_Frame.PresentNode + i) % GetNumNodes();
+        if ((m_Frame.NodeMask & GetNodeMask(node)) == 0)
+        {
+            continue;
+        }
+
+        Node& n = m_Nodes[node];
+        if (n.Timer)
+        {
+            n.Timer->End(n.CommandLists[0].Get(), m_BackBufferIndex);
+        }
+        ThrowIfFailed(n.CommandLists[0]->Close());
+        ExecuteCommandList(n.DirectQueue.Get(), n.CommandLists[0].Get());
+
+        if (node == m_Frame.PresentNode)
+        {
+            if (GetMode() == MultiGPUMode::SplitFrame && !m_SplitFrameTargets.empty())
+            {
+                // Our band is rendered too, the copy queue can start composing
+                Signal(n.DirectQueue.Get(), n.Fence.Get(), n.FenceValue);
+                QueueBandComposition();
+            }
+
+            if (n.CurrentList == 1)
+            {
+                if (n.CopyQueued)
+                {
+                    ThrowIfFailed(n.DirectQueue->Wait(n.CopyFence.Get(), n.CopyFenceValue));
+                }
+                ThrowIfFailed(n.CommandLists[1]->Close());
+                ExecuteCommandList(n.DirectQueue.Get(), n.CommandLists[1].Get());
+            }
+        }
+
+        n.FrameFenceValues[m_BackBufferIndex] = Signal(n.DirectQueue.Get(), n.Fence.Get(), n.FenceValue);
+    }
+}
+
+void LinkedDevice::Flush()
+{
+    for (Node& n : m_Nodes)
+    {
+        WaitForFence(n.Fence.Get(), Signal(n.DirectQueue.Get(), n.Fence.Get(), n.FenceValue));
+        WaitForFence(n.CopyFence.Get(), Signal(n.CopyQueue.Get(), n.CopyFence.Get(), n.CopyFenceValue));
+    }
+}
+
+uint64_t LinkedDevice::Signal(ID3D12CommandQueue* queue, ID3D12Fence* fence, uint64_t& fenceValue)
+{
+    ThrowIfFailed(queue->Signal(fence, ++fenceValue));
+    return fenceValue;
+}
+
+void LinkedDevice::WaitForFence(ID3D12Fence* fence, uint64_t value)
+{
+    if (fence->GetCompletedValue() < value)
+    {
+        ThrowIfFailed(fence->SetEventOnCompletion(value, m_FenceEvent));
+        ::WaitForSingleObject(m_FenceEvent, INFINITE);
+    }
+}
+
+void LinkedDevice::QueueHistoryCopy(uint32_t node, uint32_t sourceNode)
+{
+    Node& n = m_Nodes[node];
+    Node& source = m_Nodes[sourceNode];
+
+    ID3D12CommandAllocator* allocator = n.CopyAllocators[m_BackBufferIndex].Get();
+    ThrowIfFailed(allocator->Reset());
+    ThrowIfFailed(n.CopyCommandList->Reset(allocator, nullptr));
+    for (const std::vector<ComPtr<ID3D12Resource>>& buffer : m_HistoryBuffers)
+    {
+        n.CopyCommandList->CopyResource(buffer[node].Get(), buffer[sourceNode].Get());
+    }
+    ThrowIfFailed(n.CopyCommandList->Close());
+
+    // The source node's last frame wrote the history, and this node's last frame may still be reading its copy
+    ThrowIfFailed(n.CopyQueue->Wait(source.Fence.Get(), source.FenceValue));
+    ThrowIfFailed(n.CopyQueue->Wait(n.Fence.Get(), n.FenceValue));
+    ExecuteCommandList(n.CopyQueue.Get(), n.CopyCommandList.Get());
+    n.FrameCopyFenceValues[m_BackBufferIndex] = Signal(n.CopyQueue.Get(), n.CopyFence.Get(), n.CopyFenceValue);
+    n.CopyQueued = true;
+}
+
+void LinkedDevice::QueueBandComposition()
+{
+    Node& n = m_Nodes[0];
+    ID3D12Resource* target = m_SplitFrameTargets[0].Get();
+    D3D12_RESOURCE_DESC targetDesc = target->GetDesc();
+
+    ID3D12CommandAllocator* allocator = n.CopyAllocators[m_BackBufferIndex].Get();
+    ThrowIfFailed(allocator->Reset());
+    ThrowIfFailed(n.CopyCommandList->Reset(allocator, nullptr));
+    for (uint32_t node = 1; node < GetNumNodes(); ++node)
+    {
+        NodeBand band = m_Scheduler.GetBand(node, targetDesc.Height);
+        if (band.Bottom <= band.Top)
+        {
+            continue;
+        }
+
+        CD3DX12_TEXTURE_COPY_LOCATION destination(target, 0);
+        CD3DX12_TEXTURE_COPY_LOCATION source(m_SplitFrameTargets[node].Get(), 0);
+        CD3DX12_BOX box(0, band.Top, static_cast<LONG>(targetDesc.Width), band.Bottom);
+        n.CopyCommandList->CopyTextureRegion(&destination, 0, band.Top, 0, &source, &box);
+    }
+    ThrowIfFailed(n.CopyCommandList->Close());
+
+    // Every node has signaled its band by now
+    for (Node& other : m_Nodes)
+    {
+        ThrowIfFailed(n.CopyQueue->Wait(other.Fence.Get(), other.FenceValue));
+    }
+    ExecuteCommandList(n.CopyQueue.Get(), n.CopyCommandList.Get());
+    n.FrameCopyFenceValues[m_BackBufferIndex] = Signal(n.CopyQueue.Get(), n.CopyFence.Get(), n.CopyFenceValue);
+    n.CopyQueued = true;
+}
+
+void LinkedDevice::UpdateSplit()
+{
+    if (GetMode() != MultiGPUMode::SplitFrame)
+    {
+        return;
+    }
+
+    double nodeTimesMs[MAX_NODES];
+    for (uint32_t node = 0; node < GetNumNodes(); ++node)
+    {
+        if (!m_Nodes[node].Timer->GetFrameTime(m_BackBufferIndex, nodeTimesMs[node]))
+        {
+            return;
+        }
+    }
+    m_Scheduler.UpdateSplit(nodeTimesMs);
+}
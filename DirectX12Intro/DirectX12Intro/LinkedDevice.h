@@ -0,0 +1,126 @@
+#pragma once
+
+// The D3D12 side of multi-GPU on a linked adapter (see MultiGPU.h for the scheduling)
+// Every node gets its own direct and copy queue, command lists, allocators (per back buffer) and fence.
+// A frame is recorded into the command lists of the nodes the scheduler picked for it:
+//
+//   const MultiGPUFrame& frame = linkedDevice.BeginFrame(backBufferIndex);
+//   ... record into GetCommandList(node) for every node in frame.NodeMask ...
+//   linkedDevice.BeginDependentWork();  // optional, where the frame starts reading history (AFR) or the composed frame (SFR)
+//   ... record into GetCommandList(frame.PresentNode) ...
+//   linkedDevice.EndFrame();
+//   swapChain->Present(...);
+//
+// AFR: BeginFrame queues the copy of every history buffer from the previous frame's node on this node's copy queue.
+// What's recorded before BeginDependentWork runs without waiting for that copy, what's recorded after runs once it's done.
+// SFR: each node renders its band (GetScheduler().GetBand) into its instance of the split frame target. In EndFrame
+// node 0's copy queue waits for all the nodes and copies their bands into node 0's instance, what node 0 recorded after
+// BeginDependentWork runs after that (and would copy or upscale it to the back buffer).
+//
+// History buffers and split frame targets stay in the COMMON state between command lists, the copies rely on the
+// copy queue promoting them implicitly. Needs cross-node sharing (D3D12_CROSS_NODE_SHARING_TIER_1 or better),
+// without it the constructor falls back to Single.
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <wrl.h>
+#include <d3d12.h>
+#include <dxgi1_4.h>
+
+#include "MultiGPU.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class GPUTimer;
+
+class LinkedDevice
+{
+public:
+    // directQueue is the app's direct queue (on node 0, the one the swap chain was created with), it becomes node 0's
+    LinkedDevice(Microsoft::WRL::ComPtr<ID3D12Device2> device, Microsoft::WRL::ComPtr<ID3D12CommandQueue> directQueue,
+        MultiGPUMode mode, uint32_t numFrames);
+    ~LinkedDevice(); // waits for every node
+
+    uint32_t GetNumNodes() const { return m_Scheduler.GetNumNodes(); }
+    MultiGPUMode GetMode() const { return m_Scheduler.GetMode(); }
+    const MultiGPUScheduler& GetScheduler() const { return m_Scheduler; }
+
+    Microsoft::WRL::ComPtr<ID3D12CommandQueue> GetDirectQueue(uint32_t node) const { return m_Nodes[node].DirectQueue; }
+
+    // Use instead of ResizeBuffers: puts each back buffer on its node and presents it from that node's direct queue
+    void ResizeSwapChain(IDXGISwapChain3* swapChain, uint32_t width, uint32_t height);
+
+    // Committed resources in DEFAULT heaps, one per instance of the given sharing (see GetNodeInstance)
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> CreateNodeResources(NodeSharing sharing,
+        const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState, const wchar_t* name);
+
+    // A resource a frame reads the previous frame's contents of (e.g. a TAA history), copied across nodes in AFR.
+    // Returns its index for GetHistoryBuffer.
+    uint32_t AddHistoryBuffer(const D3D12_RESOURCE_DESC& desc, const wchar_t* name);
+    ID3D12Resource* GetHistoryBuffer(uint32_t index, uint32_t node) const { return m_HistoryBuffers[index][node].Get(); }
+
+    // SFR: the full frame size target the bands are rendered into and composed in (a 2D texture). Again after a resize,
+    // once the GPU is done with the old one.
+    void SetSplitFrameTarget(const D3D12_RESOURCE_DESC& desc, const wchar_t* name);
+    ID3D12Resource* GetSplitFrameTarget(uint32_t node) const { return m_SplitFrameTargets[node].Get(); }
+
+    // Blocks until every node is done with the frame that last used backBufferIndex
+    void WaitForFrame(uint32_t backBufferIndex);
+
+    // Waits for the frame's slot, resets the command lists of its nodes and queues the AFR history copy
+    const MultiGPUFrame& BeginFrame(uint32_t backBufferIndex);
+    ID3D12GraphicsCommandList2* GetCommandList(uint32_t node) const;
+
+    // Everything the present node records from here on waits for the history copy (AFR) or the band composition (SFR)
+    void BeginDependentWork();
+
+    // Executes every node's command lists with the waits in between and signals the nodes' fences
+    void EndFrame();
+
+    // Waits for everything queued on every node
+    void Flush();
+
+private:
+    struct Node
+    {
+        Microsoft::WRL::ComPtr<ID3D12CommandQueue> DirectQueue;
+        Microsoft::WRL::ComPtr<ID3D12CommandQueue> CopyQueue;
+
+        // [0] before the dependency, [1] after it
+        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> CommandLists[2];
+        std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> Allocators[2]; // per back buffer
+        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> CopyCommandList;
+        std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> CopyAllocators;
+
+        Microsoft::WRL::ComPtr<ID3D12Fence> Fence;     // direct queue
+        Microsoft::WRL::ComPtr<ID3D12Fence> CopyFence; // copy queue
+        uint64_t FenceValue = 0;
+        uint64_t CopyFenceValue = 0;
+        std::vector<uint64_t> FrameFenceValues;     // direct and copy work of the frame last recorded per back buffer
+        std::vector<uint64_t> FrameCopyFenceValues;
+
+        std::unique_ptr<GPUTimer> Timer; // SFR band times
+        uint32_t CurrentList = 0;
+        bool CopyQueued = false;        // this frame's copy, the dependent work waits for it
+    };
+
+    uint64_t Signal(ID3D12CommandQueue* queue, ID3D12Fence* fence, uint64_t& fenceValue);
+    void WaitForFence(ID3D12Fence* fence, uint64_t value);
+    void QueueHistoryCopy(uint32_t node, uint32_t sourceNode);
+    void QueueBandComposition();
+    void UpdateSplit();
+
+    Microsoft::WRL::ComPtr<ID3D12Device2> m_Device;
+    MultiGPUScheduler m_Scheduler;
+    std::vector<Node> m_Nodes;
+    HANDLE m_FenceEvent;
+
+    std::vector<std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>>> m_HistoryBuffers; // [buffer][node]
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> m_SplitFrameTargets;         // [node]
+
+    MultiGPUFrame m_Frame = {};
+    uint32_t m_BackBufferIndex = 0;
+};
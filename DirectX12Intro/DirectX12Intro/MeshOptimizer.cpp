@@ -0,0 +1,553 @@
+#include "MeshOptimizer.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    const uint32_t NONE = 0xFFFFFFFF;
+
+    // Forsyth's scoring: the cache it models and how much each position in it, and each count of triangles
+    // left on a vertex, are worth
+    const uint32_t FORSYTH_CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f; // the 3 most recent vertices, a bit less so the same triangle isn't favoured
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+    const uint32_t MAX_VALENCE = 32; // scores above this are all the same
+
+    // Overdraw clusters smaller than this aren't worth sorting separately
+    const uint32_t MIN_CLUSTER_TRIANGLES = 8;
+
+    // Resolution of AnalyzeOverdraw's views
+    const uint32_t OVERDRAW_GRID_SIZE = 256;
+
+    void ValidateIndices(const uint32_t* indices, uint32_t numIndices, uint32_t numVertices)
+    {
+        if (numIndices % 3 != 0)
+        {
+            throw std::runtime_error("Index count " + std::to_string(numIndices) + " isn't a multiple of 3");
+        }
+        for (uint32_t i = 0; i < numIndices; ++i)
+        {
+            if (indices[i] >= numVertices)
+            {
+                throw std::runtime_error("Index " + std::to_string(indices[i]) + " out of range, there are "
+                    + std::to_string(numVertices) + " vertices");
+            }
+        }
+    }
+
+    struct ForsythScores
+    {
+        float Cache[FORSYTH_CACHE_SIZE];
+        float Valence[MAX_VALENCE + 1];
+
+        ForsythScores()
+        {
+            for (uint32_t i = 0; i < FORSYTH_CACHE_SIZE; ++i)
+            {
+                Cache[i] = i < 3 ? LAST_TRIANGLE_SCORE
+                    : std::pow(1.0f - float(i - 3) / (FORSYTH_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+            }
+            Valence[0] = 0.0f;
+            for (uint32_t i = 1; i <= MAX_VALENCE; ++i)
+            {
+                Valence[i] = VALENCE_BOOST_SCALE * std::pow(float(i), -VALENCE_BOOST_POWER);
+            }
+        }
+
+        float GetVertexScore(uint32_t cachePosition, uint32_t remaining) const
+        {
+            if (remaining == 0)
+            {
+                return -1.0f; // nothing left to draw with it
+            }
+            float score = cachePosition < FORSYTH_CACHE_SIZE ? Cache[cachePosition] : 0.0f;
+            return score + Valence[std::min(remaining, MAX_VALENCE)];
+        }
+    };
+
+    // FIFO post-transform cache: a vertex is a hit if it missed less than cacheSize misses ago
+    class FIFOCache
+    {
+    public:
+        FIFOCache(uint32_t numVertices, uint32_t cacheSize)
+            : m_Timestamps(numVertices, 0)
+            , m_CacheSize(cacheSize)
+            , m_Time(cacheSize + 1)
+        {
+        }
+
+        // Returns 1 for a miss
+        uint32_t Access(uint32_t vertex)
+        {
+            if (m_Time - m_Timestamps[vertex] > m_CacheSize)
+            {
+                m_Timestamps[vertex] = m_Time++;
+                return 1;
+            }
+            return 0;
+        }
+
+        void Reset()
+        {
+            m_Time += m_CacheSize + 1;
+        }
+
+    private:
+        std::vector<uint32_t> m_Timestamps;
+        uint32_t m_CacheSize;
+        uint32_t m_Time;
+    };
+
+    void GetPosition(const IndexedMesh& mesh, uint32_t vertex, float* position)
+    {
+        std::memcpy(position, &mesh.Vertices[size_t(vertex) * mesh.VertexStride], sizeof(float) * 3);
+    }
+
+    // Area weighted, pointing out of the front (clockwise) face
+    void FaceNormal(const float* p0, const float* p1, const float* p2, float* normal)
+    {
+        float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        normal[0] = e0[1] * e1[2] - e0[2] * e1[1];
+        normal[1] = e0[2] * e1[0] - e0[0] * e1[2];
+        normal[2] = e0[0] * e1[1] - e0[1] * e1[0];
+    }
+
+    void ValidateMesh(const IndexedMesh& mesh)
+    {
+        if (mesh.VertexStride < sizeof(float) * 3 || mesh.Vertices.size() % mesh.VertexStride != 0)
+        {
+            throw std::runtime_error("Vertex stride " + std::to_string(mesh.VertexStride) + " doesn't fit a float3 position");
+        }
+        ValidateIndices(mesh.Indices.data(), static_cast<uint32_t>(mesh.Indices.size()), mesh.GetNumVertices());
+    }
+}
+
+std::vector<uint32_t> OptimizeVertexCache(const uint32_t* indices, uint32_t numIndices, uint32_t numVertices)
+{
+    ValidateIndices(indices, numIndices, numVertices);
+    static const ForsythScores scores;
+
+    // Triangles of each vertex. The first remaining[v] of them are the ones not drawn yet.
+    uint32_t numTriangles = numIndices / 3;
+    std::vector<uint32_t> remaining(numVertices, 0);
+    for (uint32_t i = 0; i < numIndices; ++i)
+    {
+        ++remaining[indices[i]];
+    }
+    std::vector<uint32_t> offsets(size_t(numVertices) + 1, 0);
+    for (uint32_t v = 0; v < numVertices; ++v)
+    {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+    std::vector<uint32_t> adjacency(numIndices);
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (uint32_t i = 0; i < numIndices; ++i)
+        {
+            adjacency[fill[indices[i]]++] = i / 3;
+        }
+    }
+
+    std::vector<uint32_t> cachePosition(numVertices, NONE);
+    std::vector<float> vertexScore(numVertices);
+    for (uint32_t v = 0; v < numVertices; ++v)
+    {
+        vertexScore[v] = scores.GetVertexScore(NONE, remaining[v]);
+    }
+    std::vector<bool> emitted(numTriangles, false);
+
+    auto triangleScore = [&](uint32_t t)
+    {
+        return vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+    };
+
+    uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+    uint32_t cacheSize = 0;
+    uint32_t nextUnused = 0; // nothing before this is left
+
+    std::vector<uint32_t> result;
+    result.reserve(numIndices);
+    uint32_t best = NONE;
+    while (result.size() < numIndices)
+    {
+        if (best == NONE)
+        {
+            // Nothing in the cache has triangles left, start somewhere new
+            while (emitted[nextUnused])
+            {
+                ++nextUnused;
+            }
+            best = nextUnused;
+        }
+
+        const uint32_t* triangle = &indices[best * 3];
+        result.insert(result.end(), triangle, triangle + 3);
+        emitted[best] = true;
+
+        // Off the vertices' lists of what's left
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            uint32_t v = triangle[k];
+            uint32_t* live = &adjacency[offsets[v]];
+            for (uint32_t i = 0; i < remaining[v]; ++i)
+            {
+                if (live[i] == best)
+                {
+                    std::swap(live[i], live[remaining[v] - 1]);
+                    --remaining[v];
+                    break;
+                }
+            }
+        }
+
+        // The triangle's vertices go to the front of the LRU cache, the rest shift back
+        uint32_t newCache[FORSYTH_CACHE_SIZE + 3];
+        uint32_t newCacheSize = 0;
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            if (std::find(newCache, newCache + newCacheSize, triangle[k]) == newCache + newCacheSize)
+            {
+                newCache[newCacheSize++] = triangle[k];
+            }
+        }
+        uint32_t numTriangleVertices = newCacheSize;
+        for (uint32_t i = 0; i < cacheSize; ++i)
+        {
+            if (std::find(newCache, newCache + numTriangleVertices, cache[i]) == newCache + numTriangleVertices)
+            {
+                newCache[newCacheSize++] = cache[i];
+            }
+        }
+
+        // Rescore everything that moved, including what fell out
+        for (uint32_t i = 0; i < newCacheSize; ++i)
+        {
+            uint32_t v = newCache[i];
+            cachePosition[v] = i < FORSYTH_CACHE_SIZE ? i : NONE;
+            vertexScore[v] = scores.GetVertexScore(cachePosition[v], remaining[v]);
+        }
+        cacheSize = std::min(newCacheSize, FORSYTH_CACHE_SIZE);
+        std::copy(newCache, newCache + cacheSize, cache);
+
+        // Next is the best triangle around the cache
+        best = NONE;
+        float bestScore = -std::numeric_limits<float>::max();
+        for (uint32_t i = 0; i < cacheSize; ++i)
+        {
+            uint32_t v = cache[i];
+            for (uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; ++a)
+            {
+                float score = triangleScore(adjacency[a]);
+                if (score > bestScore)
+                {
+                    best = adjacency[a];
+                    bestScore = score;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<uint32_t> OptimizeOverdraw(const uint32_t* indices, uint32_t numIndices, const IndexedMesh& mesh, float threshold)
+{
+    uint32_t numVertices = mesh.GetNumVertices();
+    ValidateIndices(indices, numIndices, numVertices);
+    uint32_t numTriangles = numIndices / 3;
+
+    // Hard boundaries: where all of a triangle's vertices miss, the order starts over anyway
+    std::vector<uint32_t> hardClusters;
+    FIFOCache fifo(numVertices, DEFAULT_VERTEX_CACHE_SIZE);
+    for (uint32_t t = 0; t < numTriangles; ++t)
+    {
+        uint32_t misses = fifo.Access(indices[t * 3]) + fifo.Access(indices[t * 3 + 1]) + fifo.Access(indices[t * 3 + 2]);
+        if (t == 0 || misses == 3)
+        {
+            hardClusters.push_back(t);
+        }
+    }
+    hardClusters.push_back(numTriangles);
+
+    // Soft boundaries: within a hard cluster, wherever the part so far is already within threshold of the whole
+    // cluster's ACMR (restarting the cache there costs about that much)
+    std::vector<uint32_t> clusters;
+    for (size_t c = 0; c + 1 < hardClusters.size(); ++c)
+    {
+        uint32_t start = hardClusters[c];
+        uint32_t end = hardClusters[c + 1];
+
+        fifo.Reset();
+        uint32_t clusterMisses = 0;
+        for (uint32_t i = start * 3; i < end * 3; ++i)
+        {
+            clusterMisses += fifo.Access(indices[i]);
+        }
+        double clusterACMR = double(clusterMisses) / (end - start);
+
+        fifo.Reset();
+        clusters.push_back(start);
+        uint32_t misses = 0;
+        uint32_t subStart = start;
+        for (uint32_t t = start; t < end; ++t)
+        {
+            misses += fifo.Access(indices[t * 3]) + fifo.Access(indices[t * 3 + 1]) + fifo.Access(indices[t * 3 + 2]);
+            uint32_t size = t + 1 - subStart;
+            if (t + 1 < end && size >= MIN_CLUSTER_TRIANGLES && double(misses) / size <= threshold * clusterACMR)
+            {
+                clusters.push_back(t + 1);
+                subStart = t + 1;
+                misses = 0;
+                fifo.Reset();
+            }
+        }
+    }
+    clusters.push_back(numTriangles);
+
+    // Each cluster's area weighted centroid and normal
+    uint32_t numClusters = static_cast<uint32_t>(clusters.size() - 1);
+    std::vector<float> centroids(size_t(numClusters) * 3, 0.0f);
+    std::vector<float> normals(size_t(numClusters) * 3, 0.0f);
+    float meshCentroid[3] = {};
+    double meshArea = 0.0;
+    for (uint32_t c = 0; c < numClusters; ++c)
+    {
+        float* centroid = &centroids[c * 3];
+        float* normal = &normals[c * 3];
+        double area = 0.0;
+        for (uint32_t t = clusters[c]; t < clusters[c + 1]; ++t)
+        {
+            float p[3][3];
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                GetPosition(mesh, indices[t * 3 + k], p[k]);
+            }
+            float faceNormal[3];
+            FaceNormal(p[0], p[1], p[2], faceNormal);
+            float faceArea = std::sqrt(faceNormal[0] * faceNormal[0] + faceNormal[1] * faceNormal[1] + faceNormal[2] * faceNormal[2]);
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                centroid[i] += (p[0][i] + p[1][i] + p[2][i]) / 3.0f * faceArea;
+                normal[i] += faceNormal[i];
+            }
+            area += faceArea;
+        }
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            meshCentroid[i] += centroid[i];
+            centroid[i] = area > 0.0 ? float(centroid[i] / area) : 0.0f;
+        }
+        meshArea += area;
+    }
+    for (float& coordinate : meshCentroid)
+    {
+        coordinate = meshArea > 0.0 ? float(coordinate / meshArea) : 0.0f;
+    }
+
+    // Clusters further out along their own normal occlude more of the rest, so they go first
+    std::vector<float> sortKeys(numClusters);
+    for (uint32_t c = 0; c < numClusters; ++c)
+    {
+        const float* centroid = &centroids[c * 3];
+        const float* normal = &normals[c * 3];
+        float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        float dot = (centroid[0] - meshCentroid[0]) * normal[0] + (centroid[1] - meshCentroid[1]) * normal[1]
+            + (centroid[2] - meshCentroid[2]) * normal[2];
+        sortKeys[c] = length > 0.0f ? dot / length : 0.0f;
+    }
+    std::vector<uint32_t> order(numClusters);
+    for (uint32_t c = 0; c < numClusters; ++c)
+    {
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<uint32_t> result;
+    result.reserve(numIndices);
+    for (uint32_t c : order)
+    {
+        result.insert(result.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+    }
+    return result;
+}
+
+void OptimizeVertexFetch(IndexedMesh& mesh)
+{
+    ValidateMesh(mesh);
+
+    std::vector<uint32_t> remap(mesh.GetNumVertices(), NONE);
+    uint32_t numUsed = 0;
+    for (uint32_t& index : mesh.Indices)
+    {
+        if (remap[index] == NONE)
+        {
+            remap[index] = numUsed++;
+        }
+        index = remap[index];
+    }
+
+    std::vector<uint8_t> vertices(size_t(numUsed) * mesh.VertexStride);
+    for (uint32_t v = 0; v < remap.size(); ++v)
+    {
+        if (remap[v] != NONE)
+        {
+            std::memcpy(&vertices[size_t(remap[v]) * mesh.VertexStride], &mesh.Vertices[size_t(v) * mesh.VertexStride], mesh.VertexStride);
+        }
+    }
+    mesh.Vertices = std::move(vertices);
+}
+
+void OptimizeMesh(IndexedMesh& mesh, float overdrawThreshold)
+{
+    ValidateMesh(mesh);
+    uint32_t numIndices = static_cast<uint32_t>(mesh.Indices.size());
+    std::vector<uint32_t> cacheOrder = OptimizeVertexCache(mesh.Indices.data(), numIndices, mesh.GetNumVertices());
+    mesh.Indices = OptimizeOverdraw(cacheOrder.data(), numIndices, mesh, overdrawThreshold);
+    OptimizeVertexFetch(mesh);
+}
+
+void OptimizeMeshes(std::vector<IndexedMesh>& meshes, ThreadPool* pool, float overdrawThreshold)
+{
+    // Can't throw from a worker thread, so anything wrong is caught up front
+    for (const IndexedMesh& mesh : meshes)
+    {
+        ValidateMesh(mesh);
+    }
+
+    if (!pool)
+    {
+        for (IndexedMesh& mesh : meshes)
+        {
+            OptimizeMesh(mesh, overdrawThreshold);
+        }
+        return;
+    }
+    pool->ParallelFor(static_cast<uint32_t>(meshes.size()), [&](uint32_t i)
+    {
+        OptimizeMesh(meshes[i], overdrawThreshold);
+    });
+}
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, uint32_t numIndices, uint32_t numVertices, uint32_t cacheSize)
+{
+    ValidateIndices(indices, numIndices, numVertices);
+
+    FIFOCache fifo(numVertices, cacheSize);
+    std::vector<bool> referenced(numVertices, false);
+    uint32_t numReferenced = 0;
+    VertexCacheStats stats = {};
+    for (uint32_t i = 0; i < numIndices; ++i)
+    {
+        stats.NumMisses += fifo.Access(indices[i]);
+        if (!referenced[indices[i]])
+        {
+            referenced[indices[i]] = true;
+            ++numReferenced;
+        }
+    }
+    stats.ACMR = numIndices > 0 ? double(stats.NumMisses) / (numIndices / 3) : 0.0;
+    stats.ATVR = numReferenced > 0 ? double(stats.NumMisses) / numReferenced : 0.0;
+    return stats;
+}
+
+OverdrawStats AnalyzeOverdraw(const IndexedMesh& mesh)
+{
+    ValidateMesh(mesh);
+
+    uint32_t numVertices = mesh.GetNumVertices();
+    std::vector<float> positions(size_t(numVertices) * 3);
+    float minimum[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+    float maximum[3] = { -minimum[0], -minimum[1], -minimum[2] };
+    for (uint32_t v = 0; v < numVertices; ++v)
+    {
+        GetPosition(mesh, v, &positions[v * 3]);
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            minimum[i] = std::min(minimum[i], positions[v * 3 + i]);
+            maximum[i] = std::max(maximum[i], positions[v * 3 + i]);
+        }
+    }
+    float extent = std::max({ maximum[0] - minimum[0], maximum[1] - minimum[1], maximum[2] - minimum[2], 1e-6f });
+    float scale = (OVERDRAW_GRID_SIZE - 1) / extent;
+
+    OverdrawStats stats = {};
+    std::vector<float> depth(OVERDRAW_GRID_SIZE * OVERDRAW_GRID_SIZE);
+
+    // Orthographic views down +-x, +-y and +-z
+    for (uint32_t view = 0; view < 6; ++view)
+    {
+        uint32_t axis = view / 2;
+        float direction = view % 2 == 0 ? 1.0f : -1.0f;
+        uint32_t uAxis = (axis + 1) % 3;
+        uint32_t vAxis = (axis + 2) % 3;
+        std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::max());
+
+        for (size_t t = 0; t + 2 < mesh.Indices.size(); t += 3)
+        {
+            const float* p[3] = { &positions[mesh.Indices[t] * 3], &positions[mesh.Indices[t + 1] * 3], &positions[mesh.Indices[t + 2] * 3] };
+
+            // Back face culling: the front face's normal has to point back at the viewer
+            float normal[3];
+            FaceNormal(p[0], p[1], p[2], normal);
+            if (normal[axis] * direction >= 0.0f)
+            {
+                continue;
+            }
+
+            float x[3], y[3], z[3];
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                x[k] = (p[k][uAxis] - minimum[uAxis]) * scale;
+                y[k] = (p[k][vAxis] - minimum[vAxis]) * scale;
+                z[k] = p[k][axis] * direction;
+            }
+            float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+            if (area == 0.0f)
+            {
+                continue;
+            }
+
+            // Pixel centers inside the triangle, whichever way it winds on screen
+            int x0 = std::max(0, static_cast<int>(std::ceil(std::min({ x[0], x[1], x[2] }))));
+            int x1 = std::min(int(OVERDRAW_GRID_SIZE) - 1, static_cast<int>(std::floor(std::max({ x[0], x[1], x[2] }))));
+            int y0 = std::max(0, static_cast<int>(std::ceil(std::min({ y[0], y[1], y[2] }))));
+            int y1 = std::min(int(OVERDRAW_GRID_SIZE) - 1, static_cast<int>(std::floor(std::max({ y[0], y[1], y[2] }))));
+            for (int py = y0; py <= y1; ++py)
+            {
+                for (int px = x0; px <= x1; ++px)
+                {
+                    float w0 = ((x[2] - x[1]) * (py - y[1]) - (y[2] - y[1]) * (px - x[1])) / area;
+                    float w1 = ((x[0] - x[2]) * (py - y[2]) - (y[0] - y[2]) * (px - x[2])) / area;
+                    float w2 = 1.0f - w0 - w1;
+                    if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                    {
+                        continue;
+                    }
+                    float pixelDepth = w0 * z[0] + w1 * z[1] + w2 * z[2];
+                    float& stored = depth[py * OVERDRAW_GRID_SIZE + px];
+                    if (pixelDepth < stored)
+                    {
+                        stored = pixelDepth;
+                        ++stats.PixelsShaded;
+                    }
+                }
+            }
+        }
+
+        for (float d : depth)
+        {
+            stats.PixelsCovered += d != std::numeric_limits<float>::max() ? 1 : 0;
+        }
+    }
+    stats.Overdraw = stats.PixelsCovered > 0 ? double(stats.PixelsShaded) / stats.PixelsCovered : 0.0;
+    return stats;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// Index and vertex order optimization for indexed triangle meshes
+// The order triangles come out of a modelling tool in wastes the post-transform vertex cache (the same vertex gets
+// shaded again and again) and draws far surfaces before near ones. OptimizeMesh runs three passes:
+//
+//   1. vertex cache : Forsyth's linear-speed algorithm, each next triangle is the one whose vertices score best:
+//                     recently used vertices, and vertices with few triangles left (so none are left stranded)
+//   2. overdraw     : the cache friendly order is cut into clusters where the cache starts over anyway (or where
+//                     a cut costs less than overdrawThreshold of the ACMR), and the clusters facing outwards go first
+//   3. vertex fetch : vertices are renumbered in the order the indices first use them, unused ones dropped
+//
+// Quality is measured with a FIFO cache model (AnalyzeVertexCache):
+//   ACMR : average cache miss ratio, vertices shaded per triangle (0.5 is the ideal on a big grid, 3 the worst)
+//   ATVR : average transformed vertex ratio, vertices shaded per vertex (1 is the ideal)
+// and overdraw with a small software rasterizer looking at the mesh from 6 directions (AnalyzeOverdraw).
+//
+// Meshes are independent, OptimizeMeshes spreads them across a ThreadPool.
+// Nothing in here depends on D3D12 or Windows.h, the asset tools run on any platform.
+
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Vertices are VertexStride bytes each and start with a float3 position
+struct IndexedMesh
+{
+    std::vector<uint8_t> Vertices;
+    uint32_t VertexStride = sizeof(float) * 3;
+    std::vector<uint32_t> Indices;
+
+    uint32_t GetNumVertices() const { return VertexStride > 0 ? static_cast<uint32_t>(Vertices.size() / VertexStride) : 0; }
+};
+
+const uint32_t DEFAULT_VERTEX_CACHE_SIZE = 16; // what the analysis models, roughly a current GPU's reuse window
+const float DEFAULT_OVERDRAW_THRESHOLD = 1.05f;
+
+// Pass 1, returns the reordered indices. Throws std::runtime_error on an index count that isn't a multiple of 3 or
+// an out of range index (as do the other passes).
+std::vector<uint32_t> OptimizeVertexCache(const uint32_t* indices, uint32_t numIndices, uint32_t numVertices);
+
+// Pass 2, on indices already in cache order. threshold is how much worse the ACMR may get for a finer clustering.
+std::vector<uint32_t> OptimizeOverdraw(const uint32_t* indices, uint32_t numIndices, const IndexedMesh& mesh,
+    float threshold = DEFAULT_OVERDRAW_THRESHOLD);
+
+// Pass 3, renumbers mesh's vertices and indices in place
+void OptimizeVertexFetch(IndexedMesh& mesh);
+
+// All three
+void OptimizeMesh(IndexedMesh& mesh, float overdrawThreshold = DEFAULT_OVERDRAW_THRESHOLD);
+void OptimizeMeshes(std::vector<IndexedMesh>& meshes, ThreadPool* pool = nullptr, float overdrawThreshold = DEFAULT_OVERDRAW_THRESHOLD);
+
+struct VertexCacheStats
+{
+    uint32_t NumMisses;
+    double ACMR;
+    double ATVR;
+};
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, uint32_t numIndices, uint32_t numVertices,
+    uint32_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE);
+
+struct OverdrawStats
+{
+    uint64_t PixelsCovered;
+    uint64_t PixelsShaded;
+    double Overdraw; // shaded / covered, 1 is the ideal
+};
+
+// Back faces (counter-clockwise, as D3D culls them) aren't drawn
+OverdrawStats AnalyzeOverdraw(const IndexedMesh& mesh);
@@ -0,0 +1,457 @@
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+    const uint32_t NONE = 0xFFFFFFFF;
+    const uint16_t NOT_IN_MESHLET = 0xFFFF;
+
+    // Normals spread wider than this (cos of ~84 degrees) leave nothing to cull
+    const float MIN_CONE_DOT = 0.1f;
+
+    struct MeshletFileHeader
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t NumVertices;
+        uint32_t NumMeshlets;
+        uint32_t NumVertexIndices;
+        uint32_t NumPrimitiveIndices;
+    };
+
+    void Subtract(const float* a, const float* b, float* result)
+    {
+        result[0] = a[0] - b[0];
+        result[1] = a[1] - b[1];
+        result[2] = a[2] - b[2];
+    }
+
+    float Dot(const float* a, const float* b)
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    // Front faces are clockwise (D3D's default), so this points out of the front face
+    void FaceNormal(const float* p0, const float* p1, const float* p2, float* normal)
+    {
+        float e0[3];
+        float e1[3];
+        Subtract(p1, p0, e0);
+        Subtract(p2, p0, e1);
+        normal[0] = e0[1] * e1[2] - e0[2] * e1[1];
+        normal[1] = e0[2] * e1[0] - e0[0] * e1[2];
+        normal[2] = e0[0] * e1[1] - e0[1] * e1[0];
+    }
+
+    bool Normalize(float* v)
+    {
+        float length = std::sqrt(Dot(v, v));
+        if (length <= 0.0f)
+        {
+            return false;
+        }
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+        return true;
+    }
+
+    MeshletBounds ComputeBounds(const MeshletMesh& mesh, const Meshlet& meshlet)
+    {
+        MeshletBounds bounds = {};
+
+        // Sphere around the bounding box, not the tightest but cheap and good enough for culling
+        float minimum[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+        float maximum[3] = { -minimum[0], -minimum[1], -minimum[2] };
+        for (uint32_t i = 0; i < meshlet.VertexCount; ++i)
+        {
+            const float* position = &mesh.Positions[mesh.VertexIndices[meshlet.VertexOffset + i] * 3];
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                minimum[c] = std::min(minimum[c], position[c]);
+                maximum[c] = std::max(maximum[c], position[c]);
+            }
+        }
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            bounds.Center[c] = (minimum[c] + maximum[c]) * 0.5f;
+        }
+        for (uint32_t i = 0; i < meshlet.VertexCount; ++i)
+        {
+            float offset[3];
+            Subtract(&mesh.Positions[mesh.VertexIndices[meshlet.VertexOffset + i] * 3], bounds.Center, offset);
+            bounds.Radius = std::max(bounds.Radius, std::sqrt(Dot(offset, offset)));
+        }
+
+        // Normal cone: the average face normal, and how far the normals stray from it
+        float normals[MESHLET_MAX_OUTPUTS][3];
+        uint32_t numNormals = 0;
+        float axis[3] = {};
+        for (uint32_t i = 0; i < meshlet.PrimitiveCount; ++i)
+        {
+            uint32_t i0, i1, i2;
+            UnpackMeshletPrimitive(mesh.PrimitiveIndices[meshlet.PrimitiveOffset + i], i0, i1, i2);
+            const uint32_t* vertices = &mesh.VertexIndices[meshlet.VertexOffset];
+            float* normal = normals[numNormals];
+            FaceNormal(&mesh.Positions[vertices[i0] * 3], &mesh.Positions[vertices[i1] * 3], &mesh.Positions[vertices[i2] * 3], normal);
+            if (Normalize(normal)) // zero area triangles face nowhere
+            {
+                axis[0] += normal[0];
+                axis[1] += normal[1];
+                axis[2] += normal[2];
+                ++numNormals;
+            }
+        }
+
+        bounds.ConeCutoff = 1.0f;
+        if (!Normalize(axis))
+        {
+            return bounds;
+        }
+        std::copy(axis, axis + 3, bounds.ConeAxis);
+
+        float minDot = 1.0f;
+        for (uint32_t i = 0; i < numNormals; ++i)
+        {
+            minDot = std::min(minDot, Dot(normals[i], axis));
+        }
+        if (minDot > MIN_CONE_DOT)
+        {
+            // Every normal is within acos(minDot) of the axis, so a view direction within 90 - acos(minDot)
+            // degrees of it sees all of them from behind: cos(90 - a) = sin(a)
+            bounds.ConeCutoff = std::sqrt(1.0f - minDot * minDot);
+        }
+        return bounds;
+    }
+}
+
+MeshletMesh BuildMeshlets(const float* positions, uint32_t numVertices, uint32_t positionStride,
+    const uint32_t* indices, uint32_t numIndices, const MeshletSettings& settings)
+{
+    if (settings.MaxVertices < 3 || settings.MaxVertices > MESHLET_MAX_OUTPUTS
+        || settings.MaxPrimitives < 1 || settings.MaxPrimitives > MESHLET_MAX_OUTPUTS)
+    {
+        throw std::runtime_error("Meshlets need 3 to 256 vertices and 1 to 256 primitives");
+    }
+    if (numIndices % 3 != 0)
+    {
+        throw std::runtime_error("Index count " + std::to_string(numIndices) + " isn't a multiple of 3");
+    }
+    for (uint32_t i = 0; i < numIndices; ++i)
+    {
+        if (indices[i] >= numVertices)
+        {
+            throw std::runtime_error("Index " + std::to_string(indices[i]) + " out of range, there are "
+                + std::to_string(numVertices) + " vertices");
+        }
+    }
+
+    MeshletMesh mesh;
+    mesh.Positions.resize(size_t(numVertices) * 3);
+    for (uint32_t i = 0; i < numVertices; ++i)
+    {
+        std::memcpy(&mesh.Positions[size_t(i) * 3], reinterpret_cast<const uint8_t*>(positions) + size_t(i) * positionStride, sizeof(float) * 3);
+    }
+
+    // Triangles using each vertex, and how many of them aren't in a meshlet yet
+    uint32_t numTriangles = numIndices / 3;
+    std::vector<uint32_t> liveTriangles(numVertices, 0);
+    for (uint32_t i = 0; i < numIndices; ++i)
+    {
+        ++liveTriangles[indices[i]];
+    }
+    std::vector<uint32_t> adjacencyOffsets(size_t(numVertices) + 1, 0);
+    for (uint32_t v = 0; v < numVertices; ++v)
+    {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    }
+    std::vector<uint32_t> adjacency(numIndices);
+    {
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (uint32_t i = 0; i < numIndices; ++i)
+        {
+            adjacency[fill[indices[i]]++] = i / 3;
+        }
+    }
+
+    std::vector<bool> emitted(numTriangles, false);
+    std::vector<uint16_t> localIndex(numVertices, NOT_IN_MESHLET);
+    uint32_t numEmitted = 0;
+    uint32_t lastTriangle = NONE;
+    uint32_t nextUnused = 0; // nothing before this is left
+
+    // Triangles with a repeated vertex draw nothing, they're dropped
+    for (uint32_t t = 0; t < numTriangles; ++t)
+    {
+        const uint32_t* triangle = &indices[t * 3];
+        if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2])
+        {
+            emitted[t] = true;
+            ++numEmitted;
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                --liveTriangles[triangle[k]];
+            }
+        }
+    }
+
+    Meshlet current = {};
+
+    auto countNewVertices = [&](uint32_t t)
+    {
+        const uint32_t* triangle = &indices[t * 3];
+        return uint32_t(localIndex[triangle[0]] == NOT_IN_MESHLET) + uint32_t(localIndex[triangle[1]] == NOT_IN_MESHLET)
+            + uint32_t(localIndex[triangle[2]] == NOT_IN_MESHLET);
+    };
+
+    // The unused triangle around these vertices that fits and adds the fewest vertices to the meshlet,
+    // then whose vertices have the fewest triangles left (so the edges get used up rather than stranded)
+    auto findCandidate = [&](const uint32_t* vertices, uint32_t numCandidateVertices)
+    {
+        uint32_t best = NONE;
+        uint32_t bestNew = 4;
+        uint32_t bestLive = NONE;
+        for (uint32_t i = 0; i < numCandidateVertices; ++i)
+        {
+            uint32_t v = vertices[i];
+            for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; ++a)
+            {
+                uint32_t t = adjacency[a];
+                if (emitted[t])
+                {
+                    continue;
+                }
+                uint32_t numNew = countNewVertices(t);
+                if (current.VertexCount + numNew > settings.MaxVertices)
+                {
+                    continue;
+                }
+                const uint32_t* triangle = &indices[t * 3];
+                uint32_t live = liveTriangles[triangle[0]] + liveTriangles[triangle[1]] + liveTriangles[triangle[2]];
+                if (numNew < bestNew || (numNew == bestNew && live < bestLive))
+                {
+                    best = t;
+                    bestNew = numNew;
+                    bestLive = live;
+                }
+            }
+        }
+        return best;
+    };
+
+    auto addTriangle = [&](uint32_t t)
+    {
+        const uint32_t* triangle = &indices[t * 3];
+        uint32_t local[3];
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            uint32_t v = triangle[k];
+            if (localIndex[v] == NOT_IN_MESHLET)
+            {
+                localIndex[v] = static_cast<uint16_t>(current.VertexCount++);
+                mesh.VertexIndices.push_back(v);
+            }
+            local[k] = localIndex[v];
+            --liveTriangles[v];
+        }
+        mesh.PrimitiveIndices.push_back(PackMeshletPrimitive(local[0], local[1], local[2]));
+        ++current.PrimitiveCount;
+        emitted[t] = true;
+        ++numEmitted;
+        lastTriangle = t;
+    };
+
+    auto finishMeshlet = [&]()
+    {
+        if (current.PrimitiveCount == 0)
+        {
+            return;
+        }
+        for (uint32_t i = 0; i < current.VertexCount; ++i)
+        {
+            localIndex[mesh.VertexIndices[current.VertexOffset + i]] = NOT_IN_MESHLET;
+        }
+        mesh.Meshlets.push_back(current);
+        mesh.Bounds.push_back(ComputeBounds(mesh, current));
+        current = { static_cast<uint32_t>(mesh.VertexIndices.size()), 0, static_cast<uint32_t>(mesh.PrimitiveIndices.size()), 0 };
+    };
+
+    while (numEmitted < numTriangles)
+    {
+        uint32_t candidate = NONE;
+        if (current.PrimitiveCount > 0)
+        {
+            // Around the triangle just added, then around the whole meshlet
+            candidate = findCandidate(&indices[lastTriangle * 3], 3);
+            if (candidate == NONE)
+            {
+                candidate = findCandidate(&mesh.VertexIndices[current.VertexOffset], current.VertexCount);
+            }
+            if (candidate == NONE)
+            {
+                finishMeshlet(); // nothing connected fits
+            }
+        }
+        if (candidate == NONE)
+        {
+            // Start the next meshlet along the edge of the last one, or at the first triangle left if it's surrounded
+            if (!mesh.Meshlets.empty())
+            {
+                const Meshlet& previous = mesh.Meshlets.back();
+                candidate = findCandidate(&mesh.VertexIndices[previous.VertexOffset], previous.VertexCount);
+            }
+            if (candidate == NONE)
+            {
+                while (emitted[nextUnused])
+                {
+                    ++nextUnused;
+                }
+                candidate = nextUnused;
+            }
+        }
+
+        addTriangle(candidate);
+        if (current.PrimitiveCount == settings.MaxPrimitives)
+        {
+            finishMeshlet();
+        }
+    }
+    finishMeshlet();
+
+    return mesh;
+}
+
+bool IsMeshletVisible(const MeshletBounds& bounds, const MeshletCullView& view)
+{
+    for (const float* plane : view.FrustumPlanes)
+    {
+        if (Dot(plane, bounds.Center) + plane[3] < -bounds.Radius)
+        {
+            return false;
+        }
+    }
+
+    // Back facing if every direction from the camera to the sphere is within the cone around the axis, i.e. the camera
+    // is looking down all the normals. For a point p of the sphere, dot(p - camera, axis) >= dot(center - camera, axis) - radius
+    // and |p - camera| <= distance + radius, which gives a test that holds for the whole sphere.
+    float toCenter[3];
+    Subtract(bounds.Center, view.CameraPosition, toCenter);
+    float distance = std::sqrt(Dot(toCenter, toCenter));
+    return Dot(toCenter, bounds.ConeAxis) - bounds.Radius < bounds.ConeCutoff * (distance + bounds.Radius);
+}
+
+uint32_t CullMeshlets(const MeshletMesh& mesh, const MeshletCullView& view, std::vector<uint32_t>& visible)
+{
+    visible.clear();
+    uint32_t numFrustumCulled = 0;
+    for (uint32_t i = 0; i < mesh.Bounds.size(); ++i)
+    {
+        const MeshletBounds& bounds = mesh.Bounds[i];
+        if (IsMeshletVisible(bounds, view))
+        {
+            visible.push_back(i);
+            continue;
+        }
+
+        // Tell the frustum apart from the cone for the stats
+        MeshletBounds sphereOnly = bounds;
+        sphereOnly.ConeCutoff = 1.0f;
+        std::fill(sphereOnly.ConeAxis, sphereOnly.ConeAxis + 3, 0.0f);
+        numFrustumCulled += IsMeshletVisible(sphereOnly, view) ? 0 : 1;
+    }
+    return numFrustumCulled;
+}
+
+void SaveMeshlets(const std::string& path, const MeshletMesh& mesh)
+{
+    MeshletFileHeader header = {};
+    header.Magic = MESHLET_MAGIC;
+    header.Version = MESHLET_VERSION;
+    header.NumVertices = static_cast<uint32_t>(mesh.Positions.size() / 3);
+    header.NumMeshlets = static_cast<uint32_t>(mesh.Meshlets.size());
+    header.NumVertexIndices = static_cast<uint32_t>(mesh.VertexIndices.size());
+    header.NumPrimitiveIndices = static_cast<uint32_t>(mesh.PrimitiveIndices.size());
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+    {
+        throw std::runtime_error("Failed to open " + path + " for writing");
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(mesh.Positions.data()), mesh.Positions.size() * sizeof(float));
+    out.write(reinterpret_cast<const char*>(mesh.Meshlets.data()), mesh.Meshlets.size() * sizeof(Meshlet));
+    out.write(reinterpret_cast<const char*>(mesh.VertexIndices.data()), mesh.VertexIndices.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(mesh.PrimitiveIndices.data()), mesh.PrimitiveIndices.size() * sizeof(uint32_t));
+    out.write(reinterpret_cast<const char*>(mesh.Bounds.data()), mesh.Bounds.size() * sizeof(MeshletBounds));
+    if (!out)
+    {
+        throw std::runtime_error("Failed to write " + path);
+    }
+}
+
+MeshletMesh LoadMeshlets(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in)
+    {
+        throw std::runtime_error("Failed to open " + path);
+    }
+    uint64_t fileSize = static_cast<uint64_t>(in.tellg());
+    in.seekg(0);
+
+    MeshletFileHeader header = {};
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    uint64_t expectedSize = sizeof(header) + uint64_t(header.NumVertices) * 3 * sizeof(float)
+        + uint64_t(header.NumMeshlets) * (sizeof(Meshlet) + sizeof(MeshletBounds))
+        + (uint64_t(header.NumVertexIndices) + header.NumPrimitiveIndices) * sizeof(uint32_t);
+    if (!in || header.Magic != MESHLET_MAGIC || header.Version != MESHLET_VERSION || fileSize != expectedSize)
+    {
+        throw std::runtime_error(path + " is not a valid meshlet file");
+    }
+
+    MeshletMesh mesh;
+    mesh.Positions.resize(size_t(header.NumVertices) * 3);
+    mesh.Meshlets.resize(header.NumMeshlets);
+    mesh.VertexIndices.resize(header.NumVertexIndices);
+    mesh.PrimitiveIndices.resize(header.NumPrimitiveIndices);
+    mesh.Bounds.resize(header.NumMeshlets);
+    in.read(reinterpret_cast<char*>(mesh.Positions.data()), mesh.Positions.size() * sizeof(float));
+    in.read(reinterpret_cast<char*>(mesh.Meshlets.data()), mesh.Meshlets.size() * sizeof(Meshlet));
+    in.read(reinterpret_cast<char*>(mesh.VertexIndices.data()), mesh.VertexIndices.size() * sizeof(uint32_t));
+    in.read(reinterpret_cast<char*>(mesh.PrimitiveIndices.data()), mesh.PrimitiveIndices.size() * sizeof(uint32_t));
+    in.read(reinterpret_cast<char*>(mesh.Bounds.data()), mesh.Bounds.size() * sizeof(MeshletBounds));
+    if (!in)
+    {
+        throw std::runtime_error("Failed to read " + path);
+    }
+
+    // The shader trusts these, so a bad file is caught here rather than on the GPU
+    bool valid = true;
+    for (const Meshlet& meshlet : mesh.Meshlets)
+    {
+        valid &= meshlet.VertexCount <= MESHLET_MAX_OUTPUTS && meshlet.PrimitiveCount <= MESHLET_MAX_OUTPUTS
+            && uint64_t(meshlet.VertexOffset) + meshlet.VertexCount <= mesh.VertexIndices.size()
+            && uint64_t(meshlet.PrimitiveOffset) + meshlet.PrimitiveCount <= mesh.PrimitiveIndices.size();
+        for (uint32_t i = 0; valid && i < meshlet.PrimitiveCount; ++i)
+        {
+            uint32_t i0, i1, i2;
+            UnpackMeshletPrimitive(mesh.PrimitiveIndices[meshlet.PrimitiveOffset + i], i0, i1, i2);
+            valid &= i0 < meshlet.VertexCount && i1 < meshlet.VertexCount && i2 < meshlet.VertexCount;
+        }
+    }
+    for (uint32_t index : mesh.VertexIndices)
+    {
+        valid &= index < header.NumVertices;
+    }
+    if (!valid)
+    {
+        throw std::runtime_error(path + " is not a valid meshlet file");
+    }
+    return mesh;
+}
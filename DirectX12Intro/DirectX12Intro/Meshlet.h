@@ -0,0 +1,96 @@
+#pragma once
+
+// Meshlets: an indexed triangle mesh cut into small clusters for the mesh shader pipeline
+// Each meshlet has at most MaxVertices unique vertices and MaxPrimitives triangles, one mesh shader group draws one.
+// The buffers are what Meshlet_MS.hlsl reads (see MeshletRenderer.h):
+//
+//   Positions        : float3 per vertex of the source mesh, tightly packed
+//   Meshlets         : where each meshlet's vertices and primitives start and how many there are
+//   VertexIndices    : per meshlet, its unique vertices as indices into Positions
+//   PrimitiveIndices : per meshlet, its triangles as three 10 bit indices into its VertexIndices
+//   Bounds           : per meshlet, a bounding sphere (frustum culling) and a normal cone (back face culling)
+//
+// Triangles are added greedily to the current meshlet, preferring the ones that add the fewest new vertices and then
+// the ones whose vertices have the fewest triangles left, so meshlets come out compact and few triangles get
+// stranded. Built offline by AssetPacker meshlets (a .meshlets file, see SaveMeshlets) or at load with BuildMeshlets.
+//
+// Nothing in here depends on D3D12 or Windows.h, the asset tools run on any platform.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const uint32_t MESHLET_MAGIC = 0x4C534D44; // "DMSL"
+const uint32_t MESHLET_VERSION = 1;
+
+// What Meshlet_MS.hlsl is compiled for (64/126 is the usual recommendation, 126 leaves room for 128 thread groups)
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_PRIMITIVES = 126;
+const uint32_t MESHLET_MAX_OUTPUTS = 256; // D3D12 limit on either
+
+struct Meshlet
+{
+    uint32_t VertexOffset;    // into VertexIndices
+    uint32_t VertexCount;
+    uint32_t PrimitiveOffset; // into PrimitiveIndices
+    uint32_t PrimitiveCount;
+};
+
+// Two float4s in HLSL
+struct MeshletBounds
+{
+    float Center[3];
+    float Radius;
+    float ConeAxis[3]; // average face normal
+    float ConeCutoff;  // sin of the cone's half angle, 1 = the normals are too spread out to ever cull
+};
+
+struct MeshletMesh
+{
+    std::vector<float> Positions;
+    std::vector<Meshlet> Meshlets;
+    std::vector<uint32_t> VertexIndices;
+    std::vector<uint32_t> PrimitiveIndices;
+    std::vector<MeshletBounds> Bounds;
+};
+
+struct MeshletSettings
+{
+    uint32_t MaxVertices = MESHLET_MAX_VERTICES;
+    uint32_t MaxPrimitives = MESHLET_MAX_PRIMITIVES;
+};
+
+inline uint32_t PackMeshletPrimitive(uint32_t i0, uint32_t i1, uint32_t i2)
+{
+    return i0 | (i1 << 10) | (i2 << 20);
+}
+
+inline void UnpackMeshletPrimitive(uint32_t primitive, uint32_t& i0, uint32_t& i1, uint32_t& i2)
+{
+    i0 = primitive & 0x3FF;
+    i1 = (primitive >> 10) & 0x3FF;
+    i2 = (primitive >> 20) & 0x3FF;
+}
+
+// positions are numVertices float3s, positionStride bytes apart (so they can be read straight from interleaved vertices).
+// Throws std::runtime_error on limits over MESHLET_MAX_OUTPUTS, an index count that isn't a multiple of 3 or an
+// out of range index.
+MeshletMesh BuildMeshlets(const float* positions, uint32_t numVertices, uint32_t positionStride,
+    const uint32_t* indices, uint32_t numIndices, const MeshletSettings& settings = MeshletSettings());
+
+// CPU reference for what the amplification shader would do: the camera and the frustum planes in the mesh's space,
+// planes as (a, b, c, d) with ax + by + cz + d >= 0 inside and (a, b, c) normalized.
+struct MeshletCullView
+{
+    float CameraPosition[3];
+    float FrustumPlanes[6][4];
+};
+
+bool IsMeshletVisible(const MeshletBounds& bounds, const MeshletCullView& view);
+
+// Indices of the meshlets that survive, returns how many were culled by the frustum (the rest by their cone)
+uint32_t CullMeshlets(const MeshletMesh& mesh, const MeshletCullView& view, std::vector<uint32_t>& visible);
+
+// .meshlets file: a header with the counts followed by each buffer. Throws std::runtime_error if it can't be written or read.
+void SaveMeshlets(const std::string& path, const MeshletMesh& mesh);
+MeshletMesh LoadMeshlets(const std::string& path);
@@ -0,0 +1,198 @@
+#include "MeshletRenderer.h"
+
+#include <d3dcompiler.h>
+
+#include "d3dx12.h"
+#include "GPUMemoryTagging.h"
+#include "Helpers.h"
+#include "UploadRing.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+using namespace Microsoft::WRL;
+using namespace DirectX;
+
+namespace
+{
+    // Root SRVs only need 4 byte alignment, this keeps each buffer on its own cache lines
+    const uint64_t BUFFER_ALIGNMENT = 256;
+
+    // D3D12_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION, bigger lists take several DispatchMesh
+    const uint32_t MAX_GROUPS_PER_DISPATCH = 65535;
+
+    // Matches MeshletCB in Meshlet_MS.hlsl
+    struct MeshletCB
+    {
+        XMFLOAT4X4 ViewProjection;
+        uint32_t FirstMeshlet; // into the visible list, for the dispatch
+    };
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+bool MeshletRenderer::IsSupported(ID3D12Device* device)
+{
+    CD3DX12FeatureSupport features;
+    return SUCCEEDED(features.Init(device)) && features.MeshShaderTier() >= D3D12_MESH_SHADER_TIER_1;
+}
+
+MeshletRenderer::MeshletRenderer(ComPtr<ID3D12Device2> device, const MeshletMesh& mesh, DXGI_FORMAT renderTargetFormat,
+    DXGI_FORMAT depthStencilFormat)
+    : m_Device(device)
+    , m_NumMeshlets(static_cast<uint32_t>(mesh.Meshlets.size()))
+{
+    if (mesh.Meshlets.empty())
+    {
+        throw std::runtime_error("No meshlets to draw");
+    }
+    for (const Meshlet& meshlet : mesh.Meshlets)
+    {
+        if (meshlet.VertexCount > MESHLET_MAX_VERTICES || meshlet.PrimitiveCount > MESHLET_MAX_PRIMITIVES)
+        {
+            throw std::runtime_error("Meshlet too big for Meshlet_MS.hlsl, build it with the default MeshletSettings");
+        }
+    }
+
+    // Root signature: the view projection matrix and a root SRV per buffer, all for the mesh shader
+    CD3DX12_ROOT_PARAMETER rootParameters[NUM_ROOT_PARAMETERS];
+    rootParameters[ROOT_CONSTANTS].InitAsConstants(sizeof(MeshletCB) / 4, 0, 0, D3D12_SHADER_VISIBILITY_MESH);
+    for (uint32_t i = ROOT_POSITIONS; i < NUM_ROOT_PARAMETERS; ++i)
+    {
+        rootParameters[i].InitAsShaderResourceView(i - ROOT_POSITIONS, 0, D3D12_SHADER_VISIBILITY_MESH);
+    }
+
+    CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc(_countof(rootParameters), rootParameters, 0, nullptr,
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_VERTEX_SHADER_ROOT_ACCESS | D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS
+        | D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS | D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS
+        | D3D12_ROOT_SIGNATURE_FLAG_DENY_AMPLIFICATION_SHADER_ROOT_ACCESS);
+
+    ComPtr<ID3DBlob> rootSignatureBlob;
+    ComPtr<ID3DBlob> errorBlob;
+    ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &rootSignatureBlob, &errorBlob));
+    ThrowIfFailed(m_Device->CreateRootSignature(0, rootSignatureBlob->GetBufferPointer(),
+        rootSignatureBlob->GetBufferSize(), IID_PPV_ARGS(&m_RootSignature)));
+
+    // Compiled by the FxCompile step of the project, lands next to the executable
+    ComPtr<ID3DBlob> meshShader;
+    ComPtr<ID3DBlob> pixelShader;
+    ThrowIfFailed(D3DReadFileToBlob(L"Meshlet_MS.cso", &meshShader));
+    ThrowIfFailed(D3DReadFileToBlob(L"Meshlet_PS.cso", &pixelShader));
+
+    D3DX12_MESH_SHADER_PIPELINE_STATE_DESC pipelineStateDesc = {};
+    pipelineStateDesc.pRootSignature = m_RootSignature.Get();
+    pipelineStateDesc.MS = CD3DX12_SHADER_BYTECODE(meshShader.Get());
+    pipelineStateDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader.Get());
+    pipelineStateDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+    pipelineStateDesc.SampleMask = UINT_MAX;
+    pipelineStateDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT); // back faces culled, clockwise is front like Meshlet.h
+    pipelineStateDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+    pipelineStateDesc.DepthStencilState.DepthEnable = depthStencilFormat != DXGI_FORMAT_UNKNOWN;
+    pipelineStateDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+    pipelineStateDesc.NumRenderTargets = 1;
+    pipelineStateDesc.RTVFormats[0] = renderTargetFormat;
+    pipelineStateDesc.DSVFormat = depthStencilFormat;
+    pipelineStateDesc.SampleDesc = { 1, 0 };
+
+    CD3DX12_PIPELINE_MESH_STATE_STREAM pipelineStateStream(pipelineStateDesc);
+    D3D12_PIPELINE_STATE_STREAM_DESC streamDesc = { sizeof(pipelineStateStream), &pipelineStateStream };
+    ThrowIfFailed(m_Device->CreatePipelineState(&streamDesc, IID_PPV_ARGS(&m_PipelineState)));
+
+    // Every buffer back to back in one resource, staged here until Upload
+    const void* data[NUM_BUFFERS] = { mesh.Positions.data(), mesh.Meshlets.data(), mesh.VertexIndices.data(), mesh.PrimitiveIndices.data() };
+    uint64_t sizes[NUM_BUFFERS] = { mesh.Positions.size() * sizeof(float), mesh.Meshlets.size() * sizeof(Meshlet),
+        mesh.VertexIndices.size() * sizeof(uint32_t), mesh.PrimitiveIndices.size() * sizeof(uint32_t) };
+    uint64_t totalSize = 0;
+    for (uint32_t i = 0; i < NUM_BUFFERS; ++i)
+    {
+        m_Offsets[i] = totalSize;
+        totalSize = AlignUp(totalSize + sizes[i], BUFFER_ALIGNMENT);
+    }
+    m_Staging.resize(static_cast<size_t>(totalSize));
+    for (uint32_t i = 0; i < NUM_BUFFERS; ++i)
+    {
+        std::memcpy(m_Staging.data() + m_Offsets[i], data[i], static_cast<size_t>(sizes[i]));
+    }
+
+    CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+    CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(totalSize);
+    ThrowIfFailed(m_Device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_Buffer)));
+    m_Buffer->SetName(L"Meshlet buffers");
+    GPU_MEMORY_TAG(m_Buffer.Get(), "MeshletRenderer");
+}
+
+bool MeshletRenderer::Upload(ID3D12GraphicsCommandList* commandList, UploadRing& uploadRing)
+{
+    if (m_Staging.empty())
+    {
+        return true;
+    }
+
+    UploadAllocation allocation;
+    if (!uploadRing.TryAllocate(m_Staging.size(), BUFFER_ALIGNMENT, allocation))
+    {
+        return false;
+    }
+    std::memcpy(allocation.CPU, m_Staging.data(), m_Staging.size());
+    commandList->CopyBufferRegion(m_Buffer.Get(), 0, allocation.Resource, allocation.Offset, m_Staging.size());
+
+    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_Buffer.Get(),
+        D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    commandList->ResourceBarrier(1, &barrier);
+
+    m_Staging.clear();
+    m_Staging.shrink_to_fit();
+    return true;
+}
+
+bool MeshletRenderer::Draw(ID3D12GraphicsCommandList* commandList, UploadRing& uploadRing, FXMMATRIX viewProjection,
+    const std::vector<uint32_t>& meshlets)
+{
+    assert(m_Staging.empty() && "Draw before Upload");
+    if (meshlets.empty())
+    {
+        return true;
+    }
+
+    UploadAllocation allocation;
+    if (!uploadRing.TryAllocate(meshlets.size() * sizeof(uint32_t), sizeof(uint32_t), allocation))
+    {
+        return false;
+    }
+    std::memcpy(allocation.CPU, meshlets.data(), meshlets.size() * sizeof(uint32_t));
+
+    // DispatchMesh needs the newer command list interface
+    ComPtr<ID3D12GraphicsCommandList6> meshCommandList;
+    ThrowIfFailed(commandList->QueryInterface(IID_PPV_ARGS(&meshCommandList)));
+
+    MeshletCB constants = {};
+    XMStoreFloat4x4(&constants.ViewProjection, viewProjection); // row major, like the shader declares it
+
+    D3D12_GPU_VIRTUAL_ADDRESS buffer = m_Buffer->GetGPUVirtualAddress();
+    meshCommandList->SetPipelineState(m_PipelineState.Get());
+    meshCommandList->SetGraphicsRootSignature(m_RootSignature.Get());
+    meshCommandList->SetGraphicsRoot32BitConstants(ROOT_CONSTANTS, sizeof(constants) / 4, &constants, 0);
+    meshCommandList->SetGraphicsRootShaderResourceView(ROOT_POSITIONS, buffer + m_Offsets[BUFFER_POSITIONS]);
+    meshCommandList->SetGraphicsRootShaderResourceView(ROOT_MESHLETS, buffer + m_Offsets[BUFFER_MESHLETS]);
+    meshCommandList->SetGraphicsRootShaderResourceView(ROOT_VERTEX_INDICES, buffer + m_Offsets[BUFFER_VERTEX_INDICES]);
+    meshCommandList->SetGraphicsRootShaderResourceView(ROOT_PRIMITIVES, buffer + m_Offsets[BUFFER_PRIMITIVES]);
+    meshCommandList->SetGraphicsRootShaderResourceView(ROOT_VISIBLE_MESHLETS, allocation.GPU);
+
+    uint32_t numMeshlets = static_cast<uint32_t>(meshlets.size());
+    for (uint32_t first = 0; first < numMeshlets; first += MAX_GROUPS_PER_DISPATCH)
+    {
+        if (first > 0)
+        {
+            meshCommandList->SetGraphicsRoot32BitConstant(ROOT_CONSTANTS, first, offsetof(MeshletCB, FirstMeshlet) / 4);
+        }
+        meshCommandList->DispatchMesh(std::min(numMeshlets - first, MAX_GROUPS_PER_DISPATCH), 1, 1);
+    }
+    return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+// Draws a MeshletMesh (see Meshlet.h) with the mesh shader pipeline: one Meshlet_MS.hlsl group per meshlet,
+// no input assembler and no index buffer.
+// The meshlet buffers live in one DEFAULT heap buffer, read by the shader through root SRVs. Which meshlets to draw
+// comes from CullMeshlets each frame, through the UploadRing.
+//
+// Needs D3D12_MESH_SHADER_TIER_1 (IsSupported) and a mesh built with the default MeshletSettings, which is what
+// the shader's outputs are sized for.
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <wrl.h>
+#include <d3d12.h>
+#include <DirectXMath.h>
+
+#include "Meshlet.h"
+
+#include <cstdint>
+#include <vector>
+
+class UploadRing;
+
+class MeshletRenderer
+{
+public:
+    static bool IsSupported(ID3D12Device* device);
+
+    MeshletRenderer(Microsoft::WRL::ComPtr<ID3D12Device2> device, const MeshletMesh& mesh, DXGI_FORMAT renderTargetFormat,
+        DXGI_FORMAT depthStencilFormat);
+
+    // Records the copy of the meshlet buffers, once before the first Draw. Returns false if the ring is out of space
+    // (call again once older frames have retired).
+    bool Upload(ID3D12GraphicsCommandList* commandList, UploadRing& uploadRing);
+
+    // Draws the given meshlets (indices into the mesh's, e.g. from CullMeshlets) with the render targets already bound.
+    // Returns false if the ring is out of space for the list.
+    bool Draw(ID3D12GraphicsCommandList* commandList, UploadRing& uploadRing, DirectX::FXMMATRIX viewProjection,
+        const std::vector<uint32_t>& meshlets);
+
+    uint32_t GetNumMeshlets() const { return m_NumMeshlets; }
+
+private:
+    // Root parameters, matching Meshlet_MS.hlsl
+    enum RootParameter
+    {
+        ROOT_CONSTANTS,        // b0
+        ROOT_POSITIONS,        // t0
+        ROOT_MESHLETS,         // t1
+        ROOT_VERTEX_INDICES,   // t2
+        ROOT_PRIMITIVES,       // t3
+        ROOT_VISIBLE_MESHLETS, // t4
+        NUM_ROOT_PARAMETERS
+    };
+
+    // Where each of the mesh's buffers is in m_Buffer
+    enum MeshBuffer
+    {
+        BUFFER_POSITIONS,
+        BUFFER_MESHLETS,
+        BUFFER_VERTEX_INDICES,
+        BUFFER_PRIMITIVES,
+        NUM_BUFFERS
+    };
+
+    Microsoft::WRL::ComPtr<ID3D12Device2> m_Device;
+    Microsoft::WRL::ComPtr<ID3D12RootSignature> m_RootSignature;
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> m_PipelineState;
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_Buffer;
+
+    std::vector<uint8_t> m_Staging; // the buffer's contents until Upload
+    uint64_t m_Offsets[NUM_BUFFERS];
+    uint32_t m_NumMeshlets;
+};
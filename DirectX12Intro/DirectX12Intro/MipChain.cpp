@@ -0,0 +1,222 @@
+#include "MipChain.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MIP_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // Up to 3 source texels and their weights along one axis, see AxisTaps in GenerateMips_CS.hlsl
+    struct Taps
+    {
+        uint32_t Position[3];
+        float Weight[3];
+        uint32_t Count;
+    };
+
+    Taps GetTaps(uint32_t x, uint32_t sourceSize)
+    {
+        Taps taps = {};
+        if (sourceSize == 1)
+        {
+            taps.Position[0] = 0;
+            taps.Weight[0] = 1.0f;
+            taps.Count = 1;
+        }
+        else if (sourceSize & 1)
+        {
+            float n = static_cast<float>(sourceSize >> 1);
+            taps.Position[0] = 2 * x;
+            taps.Position[1] = 2 * x + 1;
+            taps.Position[2] = 2 * x + 2;
+            taps.Weight[0] = (n - x) / sourceSize;
+            taps.Weight[1] = n / sourceSize;
+            taps.Weight[2] = (x + 1.0f) / sourceSize;
+            taps.Count = 3;
+        }
+        else
+        {
+            taps.Position[0] = 2 * x;
+            taps.Position[1] = 2 * x + 1;
+            taps.Weight[0] = taps.Weight[1] = 0.5f;
+            taps.Count = 2;
+        }
+        return taps;
+    }
+
+    float SRGBToLinear(float c)
+    {
+        return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    float LinearToSRGB(float c)
+    {
+        return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+    }
+
+    // Level being filtered, kept in linear float so quantization doesn't accumulate down the chain
+    struct FloatLevel
+    {
+        uint32_t Width;
+        uint32_t Height;
+        std::vector<float> Texels; // RGBA
+    };
+
+    void FilterRow(const FloatLevel& source, FloatLevel& destination, uint32_t y)
+    {
+        Taps tapsY = GetTaps(y, source.Height);
+        float* out = &destination.Texels[size_t(y) * destination.Width * 4];
+
+        for (uint32_t x = 0; x < destination.Width; ++x)
+        {
+            Taps tapsX = GetTaps(x, source.Width);
+
+#if defined(MIP_USE_SSE2)
+            __m128 sum = _mm_setzero_ps();
+            for (uint32_t j = 0; j < tapsY.Count; ++j)
+            {
+                const float* row = &source.Texels[size_t(tapsY.Position[j]) * source.Width * 4];
+                for (uint32_t i = 0; i < tapsX.Count; ++i)
+                {
+                    __m128 texel = _mm_loadu_ps(row + tapsX.Position[i] * 4);
+                    sum = _mm_add_ps(sum, _mm_mul_ps(texel, _mm_set1_ps(tapsX.Weight[i] * tapsY.Weight[j])));
+                }
+            }
+            _mm_storeu_ps(out + x * 4, sum);
+#else
+            float sum[4] = {};
+            for (uint32_t j = 0; j < tapsY.Count; ++j)
+            {
+                const float* row = &source.Texels[size_t(tapsY.Position[j]) * source.Width * 4];
+                for (uint32_t i = 0; i < tapsX.Count; ++i)
+                {
+                    float weight = tapsX.Weight[i] * tapsY.Weight[j];
+                    for (uint32_t c = 0; c < 4; ++c)
+                    {
+                        sum[c] += row[tapsX.Position[i] * 4 + c] * weight;
+                    }
+                }
+            }
+            std::memcpy(out + x * 4, sum, sizeof(sum));
+#endif
+        }
+    }
+
+    uint8_t ToUNorm8(float value)
+    {
+        return static_cast<uint8_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+
+    void ParallelRows(ThreadPool* pool, uint32_t height, const std::function<void(uint32_t)>& func)
+    {
+        if (pool)
+        {
+            pool->ParallelFor(height, func);
+        }
+        else
+        {
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                func(y);
+            }
+        }
+    }
+}
+
+uint32_t GetNumMipLevels(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+    {
+        ++levels;
+    }
+    return levels;
+}
+
+std::vector<MipLevel> GenerateMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch,
+    bool isSRGB, ThreadPool* pool)
+{
+    uint32_t numLevels = GetNumMipLevels(width, height);
+    std::vector<MipLevel> levels(numLevels);
+
+    // sRGB decode through a table, there are only 256 inputs
+    float toFloat[256];
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        toFloat[i] = i / 255.0f;
+    }
+    float toLinear[256];
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        toLinear[i] = isSRGB ? SRGBToLinear(toFloat[i]) : toFloat[i];
+    }
+
+    levels[0].Width = width;
+    levels[0].Height = height;
+    levels[0].Pixels.resize(size_t(width) * height * 4);
+
+    FloatLevel current = { width, height, std::vector<float>(size_t(width) * height * 4) };
+    ParallelRows(pool, height, [&](uint32_t y)
+    {
+        const uint8_t* row = pixels + size_t(y) * rowPitch;
+        std::memcpy(&levels[0].Pixels[size_t(y) * width * 4], row, size_t(width) * 4);
+        for (uint32_t i = 0; i < width * 4; ++i)
+        {
+            // Alpha is never sRGB encoded
+            current.Texels[size_t(y) * width * 4 + i] = (i & 3) == 3 ? toFloat[row[i]] : toLinear[row[i]];
+        }
+    });
+
+    for (uint32_t level = 1; level < numLevels; ++level)
+    {
+        FloatLevel next;
+        next.Width = std::max(1u, current.Width >> 1);
+        next.Height = std::max(1u, current.Height >> 1);
+        next.Texels.resize(size_t(next.Width) * next.Height * 4);
+
+        MipLevel& out = levels[level];
+        out.Width = next.Width;
+        out.Height = next.Height;
+        out.Pixels.resize(size_t(next.Width) * next.Height * 4);
+
+        ParallelRows(pool, next.Height, [&](uint32_t y)
+        {
+            FilterRow(current, next, y);
+
+            size_t first = size_t(y) * next.Width * 4;
+            for (size_t i = first; i < first + next.Width * 4; ++i)
+            {
+                float value = next.Texels[i];
+                out.Pixels[i] = ToUNorm8(isSRGB && (i & 3) != 3 ? LinearToSRGB(value) : value);
+            }
+        });
+
+        current = std::move(next);
+    }
+
+    return levels;
+}
+
+uint32_t CompareMipLevel(const MipLevel& level, const uint8_t* pixels, uint32_t rowPitch)
+{
+    uint32_t maxDifference = 0;
+    for (uint32_t y = 0; y < level.Height; ++y)
+    {
+        const uint8_t* expected = &level.Pixels[size_t(y) * level.Width * 4];
+        const uint8_t* actual = pixels + size_t(y) * rowPitch;
+        for (uint32_t i = 0; i < level.Width * 4; ++i)
+        {
+            maxDifference = std::max(maxDifference, static_cast<uint32_t>(std::abs(int(expected[i]) - int(actual[i]))));
+        }
+    }
+    return maxDifference;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+// CPU mip chain generation
+// Used for offline cooking (the output feeds straight into EncodeBC) and as the reference that
+// MipGenerator's compute shader output gets validated against.
+//
+// Taps and weights are the same as GenerateMips_CS.hlsl's:
+//   even source size : 2 texel box filter
+//   odd source size  : 3 texel polyphase box filter, so a 5 wide mip shrinks to 2 without dropping a column
+//   sRGB             : texels are converted to linear before filtering and back to sRGB afterwards
+// The results aren't bit exact though. The chain is kept in linear float here and only rounded to 8 bits on output,
+// while the shader reads each level back from the RGBA8 level above it, so its rounding compounds by up to a step
+// per level. Compare GPU readbacks with CompareMipLevel against a tolerance, not for 0.
+// Each texel is one 4 wide SSE register, with a plain scalar fallback.
+
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+struct MipLevel
+{
+    uint32_t Width;
+    uint32_t Height;
+    std::vector<uint8_t> Pixels; // RGBA8, tightly packed
+};
+
+// Number of levels in a full chain down to 1x1
+uint32_t GetNumMipLevels(uint32_t width, uint32_t height);
+
+// Returns the full chain, level 0 being a copy of the source. Rows of each level are spread across the pool.
+std::vector<MipLevel> GenerateMipChain(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t rowPitch,
+    bool isSRGB, ThreadPool* pool = nullptr);
+
+// Largest per channel difference between a level and (e.g.) GPU readback data with the given row pitch
+uint32_t CompareMipLevel(const MipLevel& level, const uint8_t* pixels, uint32_t rowPitch);
@@ -0,0 +1,170 @@
+#include "MipGenerator.h"
+
+#include <d3dcompiler.h>
+
+#include "d3dx12.h"
+#include "GPUMemoryTagging.h"
+#include "Helpers.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace Microsoft::WRL;
+
+namespace
+{
+    uint32_t CountTrailingZeros(uint32_t value)
+    {
+        uint32_t count = 0;
+        while (value != 0 && (value & 1) == 0)
+        {
+            value >>= 1;
+            ++count;
+        }
+        return count;
+    }
+}
+
+MipGenerator::MipGenerator(ComPtr<ID3D12Device2> device, uint32_t maxDispatches)
+    : m_Device(device)
+    , m_NumDescriptors(maxDispatches * DESCRIPTORS_PER_DISPATCH)
+{
+    // Root signature: the constants, then the source SRV and the 4 output UAVs as tables
+    CD3DX12_DESCRIPTOR_RANGE srcMip(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+    CD3DX12_DESCRIPTOR_RANGE outMips(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 4, 0);
+
+    CD3DX12_ROOT_PARAMETER rootParameters[3];
+    rootParameters[0].InitAsConstants(sizeof(GenerateMipsCB) / 4, 0);
+    rootParameters[1].InitAsDescriptorTable(1, &srcMip);
+    rootParameters[2].InitAsDescriptorTable(1, &outMips);
+
+    CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc(_countof(rootParameters), rootParameters);
+
+    ComPtr<ID3DBlob> rootSignatureBlob;
+    ComPtr<ID3DBlob> errorBlob;
+    ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &rootSignatureBlob, &errorBlob));
+    ThrowIfFailed(m_Device->CreateRootSignature(0, rootSignatureBlob->GetBufferPointer(),
+        rootSignatureBlob->GetBufferSize(), IID_PPV_ARGS(&m_RootSignature)));
+
+    // Compiled by the FxCompile step of the project, lands next to the executable
+    ComPtr<ID3DBlob> computeShader;
+    ThrowIfFailed(D3DReadFileToBlob(L"GenerateMips_CS.cso", &computeShader));
+
+    D3D12_COMPUTE_PIPELINE_STATE_DESC pipelineStateDesc = {};
+    pipelineStateDesc.pRootSignature = m_RootSignature.Get();
+    pipelineStateDesc.CS = CD3DX12_SHADER_BYTECODE(computeShader.Get());
+    ThrowIfFailed(m_Device->CreateComputePipelineState(&pipelineStateDesc, IID_PPV_ARGS(&m_PipelineState)));
+
+    D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+    heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+    heapDesc.NumDescriptors = m_NumDescriptors;
+    heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+    ThrowIfFailed(m_Device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&m_DescriptorHeap)));
+    m_DescriptorHeap->SetName(L"Mip generator descriptors");
+    GPU_MEMORY_TAG(m_DescriptorHeap.Get(), "MipGenerator");
+
+    m_DescriptorSize = m_Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+}
+
+void MipGenerator::Generate(ID3D12GraphicsCommandList* commandList, ID3D12Resource* texture, bool isSRGB,
+    D3D12_RESOURCE_STATES stateBefore, D3D12_RESOURCE_STATES stateAfter)
+{
+    D3D12_RESOURCE_DESC desc = texture->GetDesc();
+    assert(desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE2D && desc.DepthOrArraySize == 1);
+    assert(desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+    assert(desc.Format == DXGI_FORMAT_R8G8B8A8_TYPELESS || (desc.Format == DXGI_FORMAT_R8G8B8A8_UNORM && !isSRGB));
+
+    if (desc.MipLevels <= 1)
+    {
+        return;
+    }
+
+    commandList->SetComputeRootSignature(m_RootSignature.Get());
+    commandList->SetPipelineState(m_PipelineState.Get());
+    ID3D12DescriptorHeap* heaps[] = { m_DescriptorHeap.Get() };
+    commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+
+    if (stateBefore != D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+    {
+        CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(texture, stateBefore, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        commandList->ResourceBarrier(1, &barrier);
+    }
+
+    for (uint32_t srcMip = 0; srcMip < desc.MipLevels - 1u;)
+    {
+        uint32_t srcWidth = std::max(1u, static_cast<uint32_t>(desc.Width >> srcMip));
+        uint32_t srcHeight = std::max(1u, desc.Height >> srcMip);
+        uint32_t dstWidth = std::max(1u, srcWidth >> 1);
+        uint32_t dstHeight = std::max(1u, srcHeight >> 1);
+
+        // Only the first mip of a dispatch can come from an odd size, the groupshared
+        // reduction after it needs every further level to be an exact halving
+        uint32_t mipCount = 1 + std::min(CountTrailingZeros(dstWidth), CountTrailingZeros(dstHeight));
+        mipCount = std::min(mipCount, 4u);
+        mipCount = std::min(mipCount, desc.MipLevels - 1u - srcMip);
+
+        assert(m_NumUsedDescriptors + DESCRIPTORS_PER_DISPATCH <= m_NumDescriptors && "Out of mip generator descriptors, call Reset");
+        CD3DX12_CPU_DESCRIPTOR_HANDLE cpuHandle(m_DescriptorHeap->GetCPUDescriptorHandleForHeapStart(), m_NumUsedDescriptors, m_DescriptorSize);
+        CD3DX12_GPU_DESCRIPTOR_HANDLE gpuHandle(m_DescriptorHeap->GetGPUDescriptorHandleForHeapStart(), m_NumUsedDescriptors, m_DescriptorSize);
+        m_NumUsedDescriptors += DESCRIPTORS_PER_DISPATCH;
+
+        // The _SRGB view makes the loads return linear values
+        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Format = isSRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        srvDesc.Texture2D.MostDetailedMip = srcMip;
+        srvDesc.Texture2D.MipLevels = 1;
+        m_Device->CreateShaderResourceView(texture, &srvDesc, cpuHandle);
+
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+            uavDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+            uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+            uavDesc.Texture2D.MipSlice = srcMip + 1 + i;
+
+            // Every slot of the table has to be valid, unused ones get null views
+            cpuHandle.Offset(1, m_DescriptorSize);
+            if (i < mipCount)
+            {
+                m_Device->CreateUnorderedAccessView(texture, nullptr, &uavDesc, cpuHandle);
+            }
+            else
+            {
+                uavDesc.Texture2D.MipSlice = 0;
+                m_Device->CreateUnorderedAccessView(nullptr, nullptr, &uavDesc, cpuHandle);
+            }
+        }
+
+        // The source mip is read while the others are written
+        CD3DX12_RESOURCE_BARRIER toSource = CD3DX12_RESOURCE_BARRIER::Transition(texture,
+            D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, srcMip);
+        commandList->ResourceBarrier(1, &toSource);
+
+        GenerateMipsCB constants = { srcMip, mipCount, srcWidth, srcHeight, isSRGB ? 1u : 0u };
+        commandList->SetComputeRoot32BitConstants(0, sizeof(constants) / 4, &constants, 0);
+        commandList->SetComputeRootDescriptorTable(1, gpuHandle);
+        commandList->SetComputeRootDescriptorTable(2, CD3DX12_GPU_DESCRIPTOR_HANDLE(gpuHandle, 1, m_DescriptorSize));
+
+        // 8x8 threads per group, one thread per texel of the first output mip
+        commandList->Dispatch((dstWidth + 7) / 8, (dstHeight + 7) / 8, 1);
+
+        // Next dispatch reads what this one wrote
+        CD3DX12_RESOURCE_BARRIER barriers[] =
+        {
+            CD3DX12_RESOURCE_BARRIER::UAV(texture),
+            CD3DX12_RESOURCE_BARRIER::Transition(texture, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                D3D12_RESOURCE_STATE_UNORDERED_ACCESS, srcMip),
+        };
+        commandList->ResourceBarrier(_countof(barriers), barriers);
+
+        srcMip += mipCount;
+    }
+
+    if (stateAfter != D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+    {
+        CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(texture, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, stateAfter);
+        commandList->ResourceBarrier(1, &barrier);
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+// GPU mip chain generation with GenerateMips_CS.hlsl
+// Generating mips on the CPU at load time is slow, so textures that arrive without mips get
+// them on the GPU instead, up to 4 levels per dispatch.
+//
+// The texture must be a 2D RGBA8 texture with its full mip chain allocated and
+// D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS. sRGB textures must be created as
+// DXGI_FORMAT_R8G8B8A8_TYPELESS so the shader can read them through an _SRGB view
+// and write through a UNORM one.
+//
+// GenerateMipChain (MipChain.h) filters the same way on the CPU, use it to validate readbacks (to within rounding,
+// see there).
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <wrl.h>
+#include <d3d12.h>
+
+#include <cstdint>
+
+class MipGenerator
+{
+public:
+    // maxDispatches bounds how many dispatches can be recorded between calls to Reset
+    MipGenerator(Microsoft::WRL::ComPtr<ID3D12Device2> device, uint32_t maxDispatches = 256);
+
+    // Records the dispatches into commandList. The texture goes from stateBefore to stateAfter.
+    // Binds its own descriptor heap, so re-bind yours afterwards.
+    void Generate(ID3D12GraphicsCommandList* commandList, ID3D12Resource* texture, bool isSRGB,
+        D3D12_RESOURCE_STATES stateBefore, D3D12_RESOURCE_STATES stateAfter);
+
+    // Descriptors are handed out linearly. Call this once the GPU has finished
+    // every command list Generate was recorded into.
+    void Reset() { m_NumUsedDescriptors = 0; }
+
+private:
+    // Matches GenerateMipsCB in the shader
+    struct GenerateMipsCB
+    {
+        uint32_t SrcMipLevel;
+        uint32_t NumMipLevels;
+        uint32_t SrcWidth;
+        uint32_t SrcHeight;
+        uint32_t IsSRGB;
+    };
+
+    // One SRV + 4 UAVs per dispatch
+    static const uint32_t DESCRIPTORS_PER_DISPATCH = 5;
+
+    Microsoft::WRL::ComPtr<ID3D12Device2> m_Device;
+    Microsoft::WRL::ComPtr<ID3D12RootSignature> m_RootSignature;
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> m_PipelineState;
+    Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_DescriptorHeap;
+    UINT m_DescriptorSize;
+    uint32_t m_NumDescriptors;
+    uint32_t m_NumUsedDescriptors = 0;
+};
@@ -0,0 +1,150 @@
+#include "MultiGPU.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+    // A node never gets less than this fraction of the frame in SFR, so it keeps being measured
+    const float MIN_SPLIT = 0.05f;
+
+    // Fraction of the way to the balanced split taken per update, so one noisy frame doesn't swing the bands
+    const float SPLIT_SMOOTHING = 0.5f;
+}
+
+const char* GetMultiGPUModeName(MultiGPUMode mode)
+{
+    switch (mode)
+    {
+    case MultiGPUMode::Single:
+        return "single";
+    case MultiGPUMode::AlternateFrame:
+        return "afr";
+    case MultiGPUMode::SplitFrame:
+        return "sfr";
+    }
+    return "unknown";
+}
+
+bool ParseMultiGPUMode(const std::string& name, MultiGPUMode& mode)
+{
+    for (MultiGPUMode candidate : { MultiGPUMode::Single, MultiGPUMode::AlternateFrame, MultiGPUMode::SplitFrame })
+    {
+        if (name == GetMultiGPUModeName(candidate))
+        {
+            mode = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t GetNumNodeInstances(NodeSharing sharing, uint32_t numNodes)
+{
+    return sharing == NodeSharing::Shared ? 1 : numNodes;
+}
+
+NodeMasks GetNodeMasks(NodeSharing sharing, uint32_t instance, uint32_t numNodes)
+{
+    assert(instance < GetNumNodeInstances(sharing, numNodes));
+
+    switch (sharing)
+    {
+    case NodeSharing::PerNode:
+        return { GetNodeMask(instance), GetNodeMask(instance) };
+    case NodeSharing::PerNodeVisible:
+        return { GetNodeMask(instance), GetAllNodesMask(numNodes) };
+    case NodeSharing::Shared:
+    default:
+        return { GetNodeMask(0), GetAllNodesMask(numNodes) };
+    }
+}
+
+MultiGPUScheduler::MultiGPUScheduler(uint32_t numNodes, MultiGPUMode mode)
+    : m_NumNodes(mode == MultiGPUMode::Single ? 1 : std::min(std::max(numNodes, 1u), MAX_NODES))
+    , m_Mode(m_NumNodes > 1 ? mode : MultiGPUMode::Single)
+{
+    // Even split to start with, UpdateSplit moves it from there
+    for (uint32_t i = 0; i < m_NumNodes; ++i)
+    {
+        m_Split[i] = 1.0f / m_NumNodes;
+    }
+}
+
+uint32_t MultiGPUScheduler::GetBackBufferNode(uint32_t backBufferIndex) const
+{
+    return m_Mode == MultiGPUMode::AlternateFrame ? backBufferIndex % m_NumNodes : 0;
+}
+
+MultiGPUFrame MultiGPUScheduler::BeginFrame(uint32_t backBufferIndex)
+{
+    MultiGPUFrame frame = {};
+    frame.FrameNumber = m_FrameNumber;
+    frame.PresentNode = GetBackBufferNode(backBufferIndex);
+    frame.NodeMask = m_Mode == MultiGPUMode::SplitFrame ? GetAllNodesMask(m_NumNodes) : GetNodeMask(frame.PresentNode);
+
+    // In SFR every node keeps rendering the same part of the frame, its own history is the one it needs
+    // (apart from the rows at the edges when the split moves, which only matters for a frame)
+    if (m_Mode == MultiGPUMode::AlternateFrame && m_FrameNumber > 0 && m_LastNode != frame.PresentNode)
+    {
+        frame.CopyHistory = true;
+        frame.HistorySourceNode = m_LastNode;
+    }
+
+    m_LastNode = frame.PresentNode;
+    ++m_FrameNumber;
+    return frame;
+}
+
+NodeBand MultiGPUScheduler::GetBand(uint32_t node, uint32_t height) const
+{
+    assert(node < m_NumNodes);
+
+    float top = 0.0f;
+    for (uint32_t i = 0; i < node; ++i)
+    {
+        top += m_Split[i];
+    }
+    float bottom = top + m_Split[node];
+
+    // Rounding the running sum (rather than each band's size) keeps the bands touching
+    NodeBand band;
+    band.Top = node == 0 ? 0 : std::min(height, static_cast<uint32_t>(std::lround(top * height)));
+    band.Bottom = node == m_NumNodes - 1 ? height : std::min(height, static_cast<uint32_t>(std::lround(bottom * height)));
+    return band;
+}
+
+void MultiGPUScheduler::UpdateSplit(const double* nodeTimesMs)
+{
+    if (m_Mode != MultiGPUMode::SplitFrame)
+    {
+        return;
+    }
+
+    // Each node's speed in frame fractions per ms. The balanced split gives every node a share of the frame
+    // proportional to its speed, so they all take total / sum(speed).
+    double speeds[MAX_NODES];
+    double totalSpeed = 0.0;
+    for (uint32_t i = 0; i < m_NumNodes; ++i)
+    {
+        if (nodeTimesMs[i] <= 0.0)
+        {
+            return; // no timing for a node, keep what we have
+        }
+        speeds[i] = m_Split[i] / nodeTimesMs[i];
+        totalSpeed += speeds[i];
+    }
+
+    float total = 0.0f;
+    for (uint32_t i = 0; i < m_NumNodes; ++i)
+    {
+        float balanced = static_cast<float>(speeds[i] / totalSpeed);
+        m_Split[i] = std::max(MIN_SPLIT, m_Split[i] + (balanced - m_Split[i]) * SPLIT_SMOOTHING);
+        total += m_Split[i];
+    }
+    for (uint32_t i = 0; i < m_NumNodes; ++i)
+    {
+        m_Split[i] /= total;
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+// Linked adapter (multi-GPU) scheduling
+// A linked adapter is one ID3D12Device with several nodes (ID3D12Device::GetNodeCount), e.g. two GPUs in SLI/CrossFire.
+// Queues, command lists, query heaps and heaps each say which node they live on (the creation node mask, one bit)
+// and which other nodes may access them (the visible node mask). Everything so far passed 0, meaning node 0.
+//
+// Alternate frame rendering (AFR): whole frames go round robin across the nodes. Back buffer i is created on node
+// GetBackBufferNode(i) (ResizeBuffers1), so a frame renders and presents on the node owning its back buffer.
+// Whatever a frame reads from the previous one (history buffers, e.g. TAA) was written on the other node and is
+// copied over first. The frame only waits for that copy where it starts reading history, the work before that
+// point overlaps with the previous frame on the other node.
+//
+// Split frame rendering (SFR): every node renders a horizontal band of every frame and node 0 copies the other
+// bands into its target before presenting. The bands are resized from the measured per node GPU times so the
+// nodes finish together.
+//
+// Cross-node copies always run on the node that needs the data, pulling from a resource the producing node made
+// visible to it, after waiting on the producing node's fence.
+//
+// Only uses the STL: LinkedDevice does the D3D12 side, RuntimeBench multigpu runs this against a simulated two node device.
+
+#include <cstdint>
+#include <string>
+
+const uint32_t MAX_NODES = 4;
+
+enum class MultiGPUMode
+{
+    Single,         // node 0 only, whatever the device has
+    AlternateFrame,
+    SplitFrame,
+};
+
+const char* GetMultiGPUModeName(MultiGPUMode mode);
+
+// "single", "afr" or "sfr", returns false for anything else
+bool ParseMultiGPUMode(const std::string& name, MultiGPUMode& mode);
+
+inline uint32_t GetNodeMask(uint32_t node) { return 1u << node; }
+inline uint32_t GetAllNodesMask(uint32_t numNodes) { return (1u << numNodes) - 1u; }
+
+// How a resource is duplicated across the nodes
+enum class NodeSharing
+{
+    PerNode,        // an instance per node, only visible to its own node (render targets, depth buffers)
+    PerNodeVisible, // an instance per node, visible to all so another node can copy from it (history, SFR bands)
+    Shared,         // one instance on node 0 every node can read (static data)
+};
+
+struct NodeMasks
+{
+    uint32_t CreationNodeMask;
+    uint32_t VisibleNodeMask; // always includes the creation node
+};
+
+uint32_t GetNumNodeInstances(NodeSharing sharing, uint32_t numNodes);
+NodeMasks GetNodeMasks(NodeSharing sharing, uint32_t instance, uint32_t numNodes);
+
+// The instance a node uses
+inline uint32_t GetNodeInstance(NodeSharing sharing, uint32_t node) { return sharing == NodeSharing::Shared ? 0 : node; }
+
+struct MultiGPUFrame
+{
+    uint64_t FrameNumber;
+    uint32_t NodeMask;          // nodes rendering this frame: one in AFR (and single), all of them in SFR
+    uint32_t PresentNode;       // node the back buffer is on
+    bool CopyHistory;           // the previous frame rendered on another node, pull its history over first
+    uint32_t HistorySourceNode; // only with CopyHistory
+};
+
+// Rows [Top, Bottom) of the frame a node renders in SFR
+struct NodeBand
+{
+    uint32_t Top;
+    uint32_t Bottom;
+};
+
+class MultiGPUScheduler
+{
+public:
+    // numNodes from GetNodeCount, 1 to MAX_NODES (more are ignored). With one node every mode acts like Single.
+    MultiGPUScheduler(uint32_t numNodes, MultiGPUMode mode);
+
+    // The nodes actually used, 1 in Single mode
+    uint32_t GetNumNodes() const { return m_NumNodes; }
+    MultiGPUMode GetMode() const { return m_Mode; }
+
+    // Node back buffer i is created on and presented from. Only AFR spreads them, so with a back buffer count that
+    // isn't a multiple of the node count some consecutive frames land on the same node.
+    uint32_t GetBackBufferNode(uint32_t backBufferIndex) const;
+
+    // The next frame, rendering into backBufferIndex
+    MultiGPUFrame BeginFrame(uint32_t backBufferIndex);
+
+    // SFR: the band of a height rows high frame node renders. The bands cover the frame without overlapping.
+    NodeBand GetBand(uint32_t node, uint32_t height) const;
+    float GetSplit(uint32_t node) const { return m_Split[node]; }
+
+    // SFR: moves the split towards all nodes taking the same time, from each node's GPU time (ms) for the frame
+    // rendered with the current split. nodeTimesMs has GetNumNodes entries.
+    void UpdateSplit(const double* nodeTimesMs);
+
+private:
+    uint32_t m_NumNodes;
+    MultiGPUMode m_Mode;
+    uint64_t m_FrameNumber = 0;
+    uint32_t m_LastNode = 0;
+    float m_Split[MAX_NODES] = {}; // fraction of the height per node, sums to 1
+};
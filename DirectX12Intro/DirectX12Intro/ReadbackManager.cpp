@@ -0,0 +1,42 @@
+#include "ReadbackManager.h"
+
+#include "d3dx12.h"
+#include "GPUMemoryTagging.h"
+#include "Helpers.h"
+
+using namespace Microsoft::WRL;
+
+ReadbackManager::ReadbackManager(ComPtr<ID3D12Device2> device, uint64_t size)
+{
+    CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_READBACK);
+    CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+
+    // Readback heap resources have to start (and stay) in the COPY_DEST state
+    ThrowIfFailed(device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_Resource)));
+    m_Resource->SetName(L"Readback ring");
+    GPU_MEMORY_TAG(m_Resource.Get(), "ReadbackManager");
+
+    // Readback buffers may stay mapped, the queue only reads ranges the GPU is done with
+    void* data = nullptr;
+    ThrowIfFailed(m_Resource->Map(0, nullptr, &data));
+    m_Queue = std::make_unique<ReadbackQueue>(static_cast<const uint8_t*>(data), size);
+}
+
+ReadbackManager::~ReadbackManager()
+{
+    m_Queue.reset();
+
+    D3D12_RANGE writtenRange = { 0, 0 };
+    m_Resource->Unmap(0, &writtenRange);
+}
+
+void ReadbackManager::RecordCopies(ID3D12GraphicsCommandList* commandList)
+{
+    for (const ReadbackCopy& copy : m_Queue->GetCopies())
+    {
+        // Only ever an ID3D12Resource, RequestReadback put it there
+        ID3D12Resource* source = static_cast<ID3D12Resource*>(const_cast<void*>(copy.Resource));
+        commandList->CopyBufferRegion(m_Resource.Get(), copy.RingOffset, source, copy.SourceOffset, copy.Size);
+    }
+}
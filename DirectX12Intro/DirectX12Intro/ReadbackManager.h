@@ -0,0 +1,51 @@
+#pragma once
+
+// Readbacks of buffer ranges through one persistently mapped READBACK heap ring (see ReadbackQueue.h for how)
+//
+//   std::future<ReadbackResult> result = readback.RequestReadback(buffer, offset, size);
+//   ...
+//   readback.RecordCopies(commandList); // once, after everything read back this frame was written
+//   ... execute, signal fenceValue ...
+//   readback.FinishFrame(fenceValue);
+//   ...
+//   readback.Update(fence->GetCompletedValue()); // start of every frame, resolves the futures
+//
+// The buffers read from must be in COPY_SOURCE when the copies run, or in COMMON: buffers are promoted to it
+// implicitly. Textures need a footprint, copy them into a buffer first (or see FrameCapture).
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <wrl.h>
+#include <d3d12.h>
+
+#include "ReadbackQueue.h"
+
+#include <cstdint>
+#include <future>
+#include <memory>
+
+class ReadbackManager
+{
+public:
+    ReadbackManager(Microsoft::WRL::ComPtr<ID3D12Device2> device, uint64_t size);
+    ~ReadbackManager(); // futures still pending are broken (std::future_error)
+
+    // Until RecordCopies, buffer must stay alive
+    std::future<ReadbackResult> RequestReadback(ID3D12Resource* buffer, uint64_t offset, uint64_t size)
+    {
+        return m_Queue->Request(buffer, offset, size);
+    }
+
+    // The frame's copies, batched, before FinishFrame
+    void RecordCopies(ID3D12GraphicsCommandList* commandList);
+
+    void FinishFrame(uint64_t fenceValue) { m_Queue->FinishFrame(fenceValue); }
+    void Update(uint64_t completedFenceValue) { m_Queue->Update(completedFenceValue); }
+
+    ReadbackStats GetStats() const { return m_Queue->GetStats(); }
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_Resource;
+    std::unique_ptr<ReadbackQueue> m_Queue; // over the mapped m_Resource
+};
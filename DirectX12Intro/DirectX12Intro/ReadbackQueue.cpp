@@ -0,0 +1,119 @@
+#include "ReadbackQueue.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+ReadbackQueue::ReadbackQueue(const uint8_t* ring, uint64_t size, uint64_t alignment)
+    : m_Ring(ring)
+    , m_Size(size)
+    , m_Alignment(alignment)
+{
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+    {
+        throw std::runtime_error("Readback alignment " + std::to_string(alignment) + " isn't a power of 2");
+    }
+}
+
+std::future<ReadbackResult> ReadbackQueue::Request(const void* resource, uint64_t offset, uint64_t size)
+{
+    if (size == 0 || size > m_Size)
+    {
+        throw std::runtime_error("Readback of " + std::to_string(size) + " bytes doesn't fit a ring of " + std::to_string(m_Size));
+    }
+    if (m_Stats.Requested++ == 0)
+    {
+        m_FirstRequest = std::chrono::steady_clock::now();
+    }
+
+    PendingReadback readback;
+    std::future<ReadbackResult> future = readback.Promise.get_future();
+
+    uint64_t ringOffset = (m_Head + m_Alignment - 1) & ~(m_Alignment - 1);
+    uint64_t padding = ringOffset - m_Head;
+
+    // Readbacks are contiguous, so if it doesn't fit before the end skip the tail and start over at 0
+    if (ringOffset + size > m_Size)
+    {
+        padding = m_Size - m_Head;
+        ringOffset = 0;
+    }
+
+    if (m_Used + padding + size > m_Size)
+    {
+        ++m_Stats.Dropped;
+        readback.Promise.set_exception(std::make_exception_ptr(std::runtime_error("Readback ring full")));
+        return future;
+    }
+
+    m_Head = ringOffset + size == m_Size ? 0 : ringOffset + size;
+    m_Used += padding + size;
+    m_Frame.Bytes += padding + size;
+    m_Stats.MaxRingUsed = std::max(m_Stats.MaxRingUsed, m_Used);
+
+    // Right after the previous copy from the same resource, in the source and in the ring: one copy for both
+    ReadbackCopy* last = m_Copies.empty() ? nullptr : &m_Copies.back();
+    if (last && last->Resource == resource && last->SourceOffset + last->Size == offset && last->RingOffset + last->Size == ringOffset)
+    {
+        last->Size += size;
+    }
+    else
+    {
+        m_Copies.push_back({ resource, offset, ringOffset, size });
+        ++m_Stats.NumCopies;
+    }
+
+    readback.RingOffset = ringOffset;
+    readback.Size = size;
+    m_Frame.Readbacks.push_back(std::move(readback));
+    return future;
+}
+
+void ReadbackQueue::FinishFrame(uint64_t fenceValue)
+{
+    m_Copies.clear();
+    if (m_Frame.Bytes > 0)
+    {
+        m_Frame.FenceValue = fenceValue;
+        m_Frame.FinishedAtUpdate = m_NumUpdates;
+        m_InFlight.push_back(std::move(m_Frame));
+        m_Frame = {};
+    }
+}
+
+void ReadbackQueue::Update(uint64_t completedFenceValue)
+{
+    ++m_NumUpdates;
+
+    // Frames complete in order, so the oldest readbacks (the ring's tail) are always freed first
+    while (!m_InFlight.empty() && m_InFlight.front().FenceValue <= completedFenceValue)
+    {
+        Frame& frame = m_InFlight.front();
+        uint32_t latency = m_NumUpdates - frame.FinishedAtUpdate;
+        for (PendingReadback& readback : frame.Readbacks)
+        {
+            ReadbackResult result;
+            result.Bytes.assign(m_Ring + readback.RingOffset, m_Ring + readback.RingOffset + readback.Size);
+            result.LatencyFrames = latency;
+            readback.Promise.set_value(std::move(result));
+
+            ++m_Stats.Resolved;
+            m_Stats.BytesRead += readback.Size;
+            m_Stats.MaxLatencyFrames = std::max(m_Stats.MaxLatencyFrames, latency);
+            m_LatencyFrames += latency;
+        }
+
+        m_Used -= frame.Bytes;
+        m_InFlight.pop_front();
+    }
+}
+
+ReadbackStats ReadbackQueue::GetStats() const
+{
+    ReadbackStats stats = m_Stats;
+    stats.AverageLatencyFrames = stats.Resolved ? double(m_LatencyFrames) / stats.Resolved : 0.0;
+    double seconds = stats.Requested ? std::chrono::duration<double>(std::chrono::steady_clock::now() - m_FirstRequest).count() : 0.0;
+    stats.BytesPerSecond = seconds > 0.0 ? stats.BytesRead / seconds : 0.0;
+    return stats;
+}
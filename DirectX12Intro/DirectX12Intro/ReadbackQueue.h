@@ -0,0 +1,110 @@
+#pragma once
+
+// GPU to CPU readback without stalls (picking, GPU generated statistics, occlusion results, ...)
+// Request sub-allocates a slice of a persistently mapped readback ring and returns a future. The copies requested
+// during a frame are batched (adjacent ranges of a resource become one copy) and recorded together by the caller,
+// then FinishFrame ties them to the frame's fence. Update, on the fence completion path once per frame, resolves the
+// futures of every frame whose fence has completed and hands their ring space back:
+//
+//   std::future<ReadbackResult> picked = readback.Request(idBuffer, pixelOffset, 4);
+//   ... record GetCopies() into the command list, execute, signal fenceValue ...
+//   readback.FinishFrame(fenceValue);
+//   ... later frames ...
+//   readback.Update(fence->GetCompletedValue());
+//   if (picked.wait_for(std::chrono::seconds(0)) == std::future_status::ready) { ... picked.get() ... }
+//
+// The bytes are copied out of the ring into the result when the future is resolved, so the ring only has to hold
+// what's in flight and the result stays valid as long as the caller wants. Readbacks are small, the copy is cheap.
+// ReadbackManager records the copies with CopyBufferRegion into a READBACK heap buffer, RuntimeBench readback runs this
+// against a simulated queue.
+// Only uses the STL.
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <vector>
+
+struct ReadbackResult
+{
+    std::vector<uint8_t> Bytes;
+    uint32_t LatencyFrames; // Update calls from FinishFrame to this one resolving
+};
+
+// One copy to record: Size bytes from Resource at SourceOffset to the ring at RingOffset
+struct ReadbackCopy
+{
+    const void* Resource;
+    uint64_t SourceOffset;
+    uint64_t RingOffset;
+    uint64_t Size;
+};
+
+struct ReadbackStats
+{
+    uint64_t Requested;
+    uint64_t Resolved;
+    uint64_t Dropped;     // the ring was full
+    uint64_t NumCopies;   // after batching
+    uint64_t BytesRead;
+    uint64_t MaxRingUsed; // bytes, including wrap padding
+    uint32_t MaxLatencyFrames;
+    double AverageLatencyFrames;
+    double BytesPerSecond; // since the first request
+};
+
+class ReadbackQueue
+{
+public:
+    // ring is the mapped readback memory, size bytes. alignment (a power of 2) is where each readback starts in it.
+    ReadbackQueue(const uint8_t* ring, uint64_t size, uint64_t alignment = 16);
+
+    // Throws std::runtime_error if size is 0 or more than the ring holds. If the ring is full the future gets a
+    // std::runtime_error instead of the bytes (try again next frame).
+    std::future<ReadbackResult> Request(const void* resource, uint64_t offset, uint64_t size);
+
+    // What was requested since the last FinishFrame, to be recorded in the frame's command list before it
+    const std::vector<ReadbackCopy>& GetCopies() const { return m_Copies; }
+
+    // Everything requested since the last call lands in the ring when the GPU reaches fenceValue
+    void FinishFrame(uint64_t fenceValue);
+
+    // Resolves the futures of every frame whose fence value is <= completedFenceValue and frees their ring space.
+    // Call once per frame, it counts the frames of latency.
+    void Update(uint64_t completedFenceValue);
+
+    ReadbackStats GetStats() const;
+    uint64_t GetUsed() const { return m_Used; }
+
+private:
+    struct PendingReadback
+    {
+        std::promise<ReadbackResult> Promise;
+        uint64_t RingOffset;
+        uint64_t Size;
+    };
+
+    struct Frame
+    {
+        uint64_t FenceValue;
+        uint64_t Bytes; // ring space, including padding
+        uint32_t FinishedAtUpdate;
+        std::vector<PendingReadback> Readbacks;
+    };
+
+    const uint8_t* m_Ring;
+    uint64_t m_Size;
+    uint64_t m_Alignment;
+
+    // The ring, the same way as UploadRing
+    uint64_t m_Head = 0; // next free byte
+    uint64_t m_Used = 0; // bytes between the oldest in-flight readback and m_Head (including wrap padding)
+    Frame m_Frame = {};  // requested since the last FinishFrame
+    std::deque<Frame> m_InFlight;
+    std::vector<ReadbackCopy> m_Copies;
+    uint32_t m_NumUpdates = 0;
+
+    ReadbackStats m_Stats = {};
+    uint64_t m_LatencyFrames = 0;
+    std::chrono::steady_clock::time_point m_FirstRequest;
+};
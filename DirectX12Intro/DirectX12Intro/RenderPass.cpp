@@ -0,0 +1,167 @@
+#include "RenderPass.h"
+
+#include <stdexcept>
+
+namespace
+{
+    enum class UseType
+    {
+        None,
+        Sampled,
+        Attachment,
+    };
+
+    // How a pass uses a resource, and the attachment usage if it's bound as one
+    UseType FindUse(const RenderPassUsage& pass, uint32_t resource, const AttachmentUsage*& attachment)
+    {
+        for (const AttachmentUsage& renderTarget : pass.RenderTargets)
+        {
+            if (renderTarget.Resource == resource)
+            {
+                attachment = &renderTarget;
+                return UseType::Attachment;
+            }
+        }
+        if (pass.HasDepthStencil && pass.DepthStencil.Resource == resource)
+        {
+            attachment = &pass.DepthStencil;
+            return UseType::Attachment;
+        }
+        for (uint32_t read : pass.ShaderReads)
+        {
+            if (read == resource)
+            {
+                return UseType::Sampled;
+            }
+        }
+        return UseType::None;
+    }
+
+    // Whether the pass depends on what the attachment held before it
+    bool NeedsContents(const AttachmentUsage& usage)
+    {
+        return !usage.Clear && (usage.ReadsContents || !usage.FullyOverwritten);
+    }
+
+    AttachmentActions InferActions(const std::vector<RenderPassResource>& resources, const std::vector<RenderPassUsage>& passes,
+        size_t passIndex, const AttachmentUsage& usage)
+    {
+        AttachmentActions actions;
+
+        if (usage.Clear)
+        {
+            actions.Load = LoadAction::Clear;
+        }
+        else if (NeedsContents(usage))
+        {
+            // Only worth loading if there's something there
+            bool hasContents = resources[usage.Resource].External;
+            for (size_t i = 0; i < passIndex && !hasContents; ++i)
+            {
+                const AttachmentUsage* earlier = nullptr;
+                hasContents = FindUse(passes[i], usage.Resource, earlier) == UseType::Attachment;
+            }
+            actions.Load = hasContents ? LoadAction::Preserve : LoadAction::Discard;
+        }
+        else
+        {
+            actions.Load = LoadAction::Discard;
+        }
+
+        // The next use decides whether anyone sees what this pass leaves behind
+        actions.Store = resources[usage.Resource].External ? StoreAction::Preserve : StoreAction::Discard;
+        for (size_t i = passIndex + 1; i < passes.size(); ++i)
+        {
+            const AttachmentUsage* later = nullptr;
+            UseType use = FindUse(passes[i], usage.Resource, later);
+            if (use == UseType::Sampled || (use == UseType::Attachment && NeedsContents(*later)))
+            {
+                actions.Store = StoreAction::Preserve;
+                break;
+            }
+            if (use == UseType::Attachment)
+            {
+                actions.Store = StoreAction::Discard; // overwritten before anything read it
+                break;
+            }
+        }
+        return actions;
+    }
+
+    void ValidatePass(const std::vector<RenderPassResource>& resources, const RenderPassUsage& pass)
+    {
+        std::vector<uint32_t> bound;
+        for (const AttachmentUsage& renderTarget : pass.RenderTargets)
+        {
+            bound.push_back(renderTarget.Resource);
+        }
+        if (pass.HasDepthStencil)
+        {
+            bound.push_back(pass.DepthStencil.Resource);
+        }
+        bound.insert(bound.end(), pass.ShaderReads.begin(), pass.ShaderReads.end());
+
+        for (size_t i = 0; i < bound.size(); ++i)
+        {
+            if (bound[i] >= resources.size())
+            {
+                throw std::runtime_error("Render pass " + pass.Name + " uses resource " + std::to_string(bound[i])
+                    + ", there are " + std::to_string(resources.size()));
+            }
+            for (size_t j = 0; j < i; ++j)
+            {
+                if (bound[i] == bound[j])
+                {
+                    throw std::runtime_error("Render pass " + pass.Name + " binds " + resources[bound[i]].Name + " twice");
+                }
+            }
+        }
+    }
+}
+
+const char* GetLoadActionName(LoadAction action)
+{
+    switch (action)
+    {
+    case LoadAction::Preserve:
+        return "preserve";
+    case LoadAction::Clear:
+        return "clear";
+    case LoadAction::Discard:
+        return "discard";
+    }
+    return "unknown";
+}
+
+const char* GetStoreActionName(StoreAction action)
+{
+    switch (action)
+    {
+    case StoreAction::Preserve:
+        return "preserve";
+    case StoreAction::Discard:
+        return "discard";
+    }
+    return "unknown";
+}
+
+std::vector<RenderPassActions> InferRenderPassActions(const std::vector<RenderPassResource>& resources,
+    const std::vector<RenderPassUsage>& passes)
+{
+    std::vector<RenderPassActions> actions(passes.size());
+    for (size_t i = 0; i < passes.size(); ++i)
+    {
+        const RenderPassUsage& pass = passes[i];
+        ValidatePass(resources, pass);
+
+        for (const AttachmentUsage& renderTarget : pass.RenderTargets)
+        {
+            actions[i].RenderTargets.push_back(InferActions(resources, passes, i, renderTarget));
+        }
+        if (pass.HasDepthStencil)
+        {
+            actions[i].DepthStencil = InferActions(resources, passes, i, pass.DepthStencil);
+        }
+    }
+    return actions;
+}
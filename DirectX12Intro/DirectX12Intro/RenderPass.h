@@ -0,0 +1,78 @@
+#pragma once
+
+// Render pass load/store actions inferred from how the passes of a frame use their attachments
+// A render pass says up front what happens to each attachment's contents at its start (load) and end (store).
+// On tile based GPUs that decides whether the attachment is copied from memory into tile memory before the
+// pass and back out after it, which is most of the bandwidth a pass costs. Picking them by hand is error prone,
+// so they're derived from the usage of the whole frame:
+//
+//   load  : Clear if the pass clears it. Preserve if the pass needs what's there (blending, depth testing, or
+//           not writing every pixel) and something is there: an earlier pass wrote it, or it's external.
+//           Discard otherwise, e.g. a full screen pass without blending, or a transient target's first use.
+//   store : Preserve if a later pass samples it or loads it, or nothing later uses it and it's external
+//           (back buffer, history). Discard if it's overwritten before anything reads it, or never used again.
+//
+// RenderPassEncoder turns the actions into BeginRenderPass/EndRenderPass (tile based renderers) or
+// OMSetRenderTargets and clears (everything else). Only uses the STL, RuntimeBench renderpass checks the inference.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Same meaning as D3D12_RENDER_PASS_BEGINNING_ACCESS_TYPE_*
+enum class LoadAction
+{
+    Preserve,
+    Clear,
+    Discard,
+};
+
+// Same meaning as D3D12_RENDER_PASS_ENDING_ACCESS_TYPE_*
+enum class StoreAction
+{
+    Preserve,
+    Discard,
+};
+
+const char* GetLoadActionName(LoadAction action);
+const char* GetStoreActionName(StoreAction action);
+
+struct RenderPassResource
+{
+    std::string Name;
+    bool External; // the contents outlive the frame: valid before the first pass, needed after the last (back buffer, history)
+};
+
+struct AttachmentUsage
+{
+    uint32_t Resource;             // index into the resources
+    bool Clear = false;            // cleared at the start of the pass
+    bool ReadsContents = false;    // blending, depth testing against earlier passes
+    bool FullyOverwritten = false; // every pixel written (full viewport, no blending, no discards)
+};
+
+struct RenderPassUsage
+{
+    std::string Name;
+    std::vector<AttachmentUsage> RenderTargets;
+    bool HasDepthStencil = false;
+    AttachmentUsage DepthStencil;
+    std::vector<uint32_t> ShaderReads; // resources sampled in the pass
+};
+
+struct AttachmentActions
+{
+    LoadAction Load;
+    StoreAction Store;
+};
+
+struct RenderPassActions
+{
+    std::vector<AttachmentActions> RenderTargets; // same order as the usage
+    AttachmentActions DepthStencil = { LoadAction::Discard, StoreAction::Discard }; // only with HasDepthStencil
+};
+
+// One RenderPassActions per pass, in order. Throws std::runtime_error on an out of range resource or a resource
+// bound twice in a pass (as two attachments, or as an attachment it also samples).
+std::vector<RenderPassActions> InferRenderPassActions(const std::vector<RenderPassResource>& resources,
+    const std::vector<RenderPassUsage>& passes);
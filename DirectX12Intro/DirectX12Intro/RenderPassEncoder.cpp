@@ -0,0 +1,135 @@
+#include "RenderPassEncoder.h"
+
+#include "d3dx12.h"
+#include "Helpers.h"
+
+#include <cassert>
+#include <cstdio>
+
+using namespace Microsoft::WRL;
+
+namespace
+{
+    D3D12_RENDER_PASS_BEGINNING_ACCESS_TYPE GetBeginningAccessType(LoadAction action)
+    {
+        switch (action)
+        {
+        case LoadAction::Clear:
+            return D3D12_RENDER_PASS_BEGINNING_ACCESS_TYPE_CLEAR;
+        case LoadAction::Discard:
+            return D3D12_RENDER_PASS_BEGINNING_ACCESS_TYPE_DISCARD;
+        case LoadAction::Preserve:
+        default:
+            return D3D12_RENDER_PASS_BEGINNING_ACCESS_TYPE_PRESERVE;
+        }
+    }
+
+    D3D12_RENDER_PASS_ENDING_ACCESS_TYPE GetEndingAccessType(StoreAction action)
+    {
+        return action == StoreAction::Discard ? D3D12_RENDER_PASS_ENDING_ACCESS_TYPE_DISCARD
+            : D3D12_RENDER_PASS_ENDING_ACCESS_TYPE_PRESERVE;
+    }
+}
+
+RenderPassEncoder::RenderPassEncoder(ID3D12Device* device, bool forceRenderPasses)
+{
+    CD3DX12FeatureSupport features;
+    ThrowIfFailed(features.Init(device));
+    m_UseRenderPasses = forceRenderPasses || features.TileBasedRenderer();
+
+    char buffer[128];
+    sprintf_s(buffer, "Render passes: %s (tile based renderer: %s, render passes tier %d)\n",
+        m_UseRenderPasses ? "BeginRenderPass" : "OMSetRenderTargets", features.TileBasedRenderer() ? "yes" : "no",
+        static_cast<int>(features.RenderPassesTier()));
+    ::OutputDebugStringA(buffer);
+}
+
+void RenderPassEncoder::Begin(ID3D12GraphicsCommandList* commandList, const RenderPassActions& actions,
+    const RenderPassTarget* renderTargets, uint32_t numRenderTargets, const RenderPassDepthStencil* depthStencil)
+{
+    assert(!m_PassCommandList && m_NumDiscardResources == 0 && "Begin without End");
+    assert(actions.RenderTargets.size() == numRenderTargets && numRenderTargets <= D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT);
+
+    // Needs a runtime with ID3D12GraphicsCommandList4, without one the legacy path does the same work
+    if (m_UseRenderPasses && SUCCEEDED(commandList->QueryInterface(IID_PPV_ARGS(&m_PassCommandList))))
+    {
+        D3D12_RENDER_PASS_RENDER_TARGET_DESC renderTargetDescs[D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT] = {};
+        for (uint32_t i = 0; i < numRenderTargets; ++i)
+        {
+            D3D12_RENDER_PASS_RENDER_TARGET_DESC& desc = renderTargetDescs[i];
+            desc.cpuDescriptor = renderTargets[i].RTV;
+            desc.BeginningAccess.Type = GetBeginningAccessType(actions.RenderTargets[i].Load);
+            desc.BeginningAccess.Clear.ClearValue = CD3DX12_CLEAR_VALUE(renderTargets[i].Format, renderTargets[i].ClearColor);
+            desc.EndingAccess.Type = GetEndingAccessType(actions.RenderTargets[i].Store);
+        }
+
+        D3D12_RENDER_PASS_DEPTH_STENCIL_DESC depthStencilDesc = {};
+        if (depthStencil)
+        {
+            CD3DX12_CLEAR_VALUE clearValue(depthStencil->Format, depthStencil->ClearDepth, depthStencil->ClearStencil);
+            depthStencilDesc.cpuDescriptor = depthStencil->DSV;
+            depthStencilDesc.DepthBeginningAccess.Type = GetBeginningAccessType(actions.DepthStencil.Load);
+            depthStencilDesc.DepthBeginningAccess.Clear.ClearValue = clearValue;
+            depthStencilDesc.DepthEndingAccess.Type = GetEndingAccessType(actions.DepthStencil.Store);
+
+            // Stencil follows depth, formats without one don't touch it at all
+            depthStencilDesc.StencilBeginningAccess = depthStencilDesc.DepthBeginningAccess;
+            depthStencilDesc.StencilEndingAccess = depthStencilDesc.DepthEndingAccess;
+            if (!depthStencil->HasStencil)
+            {
+                depthStencilDesc.StencilBeginningAccess.Type = D3D12_RENDER_PASS_BEGINNING_ACCESS_TYPE_NO_ACCESS;
+                depthStencilDesc.StencilEndingAccess.Type = D3D12_RENDER_PASS_ENDING_ACCESS_TYPE_NO_ACCESS;
+            }
+        }
+
+        m_PassCommandList->BeginRenderPass(numRenderTargets, renderTargetDescs, depthStencil ? &depthStencilDesc : nullptr,
+            D3D12_RENDER_PASS_FLAG_NONE);
+        return;
+    }
+
+    // Legacy: clear what's cleared, bind, and remember what to discard at the end
+    D3D12_CPU_DESCRIPTOR_HANDLE rtvs[D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT];
+    for (uint32_t i = 0; i < numRenderTargets; ++i)
+    {
+        rtvs[i] = renderTargets[i].RTV;
+        if (actions.RenderTargets[i].Load == LoadAction::Clear)
+        {
+            commandList->ClearRenderTargetView(renderTargets[i].RTV, renderTargets[i].ClearColor, 0, nullptr);
+        }
+        if (actions.RenderTargets[i].Store == StoreAction::Discard)
+        {
+            m_DiscardResources[m_NumDiscardResources++] = renderTargets[i].Resource;
+        }
+    }
+
+    if (depthStencil)
+    {
+        if (actions.DepthStencil.Load == LoadAction::Clear)
+        {
+            D3D12_CLEAR_FLAGS flags = depthStencil->HasStencil ? D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL : D3D12_CLEAR_FLAG_DEPTH;
+            commandList->ClearDepthStencilView(depthStencil->DSV, flags, depthStencil->ClearDepth, depthStencil->ClearStencil, 0, nullptr);
+        }
+        if (actions.DepthStencil.Store == StoreAction::Discard)
+        {
+            m_DiscardResources[m_NumDiscardResources++] = depthStencil->Resource;
+        }
+    }
+
+    commandList->OMSetRenderTargets(numRenderTargets, rtvs, FALSE, depthStencil ? &depthStencil->DSV : nullptr);
+}
+
+void RenderPassEncoder::End(ID3D12GraphicsCommandList* commandList)
+{
+    if (m_PassCommandList)
+    {
+        m_PassCommandList->EndRenderPass();
+        m_PassCommandList.Reset();
+        return;
+    }
+
+    for (uint32_t i = 0; i < m_NumDiscardResources; ++i)
+    {
+        commandList->DiscardResource(m_DiscardResources[i], nullptr);
+    }
+    m_NumDiscardResources = 0;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+// Records the passes RenderPass.h inferred the actions of
+// Tile based renderers (CD3DX12FeatureSupport::TileBasedRenderer) get BeginRenderPass/EndRenderPass, where the
+// load/store actions save the trips between tile memory and main memory. Everything else gets the same
+// thing the old way: the clears, OMSetRenderTargets, and DiscardResource for the attachments stored as discarded
+// (which still lets some GPUs skip decompressing them).
+// Between Begin and End only draws and state that's allowed in a render pass: no barriers, no copies.
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <wrl.h>
+#include <d3d12.h>
+
+#include "RenderPass.h"
+
+#include <cstdint>
+
+struct RenderPassTarget
+{
+    D3D12_CPU_DESCRIPTOR_HANDLE RTV;
+    ID3D12Resource* Resource;
+    DXGI_FORMAT Format;
+    FLOAT ClearColor[4]; // with LoadAction::Clear
+};
+
+struct RenderPassDepthStencil
+{
+    D3D12_CPU_DESCRIPTOR_HANDLE DSV;
+    ID3D12Resource* Resource;
+    DXGI_FORMAT Format;
+    bool HasStencil;
+    FLOAT ClearDepth;    // with LoadAction::Clear
+    UINT8 ClearStencil;
+};
+
+class RenderPassEncoder
+{
+public:
+    // forceRenderPasses uses them on any GPU (they're valid everywhere, just not faster)
+    RenderPassEncoder(ID3D12Device* device, bool forceRenderPasses = false);
+
+    bool UsesRenderPasses() const { return m_UseRenderPasses; }
+
+    void Begin(ID3D12GraphicsCommandList* commandList, const RenderPassActions& actions,
+        const RenderPassTarget* renderTargets, uint32_t numRenderTargets, const RenderPassDepthStencil* depthStencil = nullptr);
+    void End(ID3D12GraphicsCommandList* commandList);
+
+private:
+    bool m_UseRenderPasses;
+
+    // What End needs to know about the pass Begin started
+    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> m_PassCommandList; // set while a render pass is open
+    ID3D12Resource* m_DiscardResources[D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT + 1] = {};
+    uint32_t m_NumDiscardResources = 0;
+};
@@ -0,0 +1,141 @@
+#include "RenderThread.h"
+
+#include <utility>
+
+RenderThread::RenderThread(EventHandler eventHandler, FrameFunction frameFunction, ExitFunction exitFunction)
+    : m_EventHandler(std::move(eventHandler))
+    , m_FrameFunction(std::move(frameFunction))
+    , m_ExitFunction(std::move(exitFunction))
+{
+}
+
+RenderThread::~RenderThread()
+{
+    RequestStop();
+    if (m_Thread.joinable())
+    {
+        m_Thread.join();
+    }
+}
+
+void RenderThread::Start()
+{
+    m_Thread = std::thread(&RenderThread::Run, this);
+}
+
+bool RenderThread::PostEvent(WindowEventType type, uint32_t param0, uint32_t param1, std::chrono::steady_clock::time_point timestamp)
+{
+    m_EventsPosted.fetch_add(1, std::memory_order_relaxed);
+
+    // A newer resize supersedes a parked one. Cleared before the push so the render thread can never
+    // see the new size in the queue and then the stale one in the slot.
+    if (type == WindowEventType::Resize)
+    {
+        m_OverflowResize.store(0, std::memory_order_release);
+    }
+
+    if (!m_Events.TryPush({ type, param0, param1, timestamp }))
+    {
+        m_EventsDropped.fetch_add(1, std::memory_order_relaxed);
+
+        // Losing a key press is bad enough, but losing the last resize would leave the swap chain at the wrong size
+        // for good. Park it in a side slot the render thread checks after draining the queue.
+        if (type == WindowEventType::Resize)
+        {
+            // Client sizes are 16 bit in WM_SIZE, the top bit of the width is the valid bit
+            m_OverflowResize.store(OVERFLOW_RESIZE_VALID | (uint64_t(param0 & 0x7FFFFFFF) << 32) | param1, std::memory_order_release);
+        }
+        return false;
+    }
+    return true;
+}
+
+void RenderThread::RequestStop()
+{
+    m_StopRequested.store(true, std::memory_order_release);
+}
+
+void RenderThread::Join()
+{
+    if (m_Thread.joinable())
+    {
+        m_Thread.join();
+    }
+
+    if (m_Exception)
+    {
+        std::exception_ptr exception = m_Exception;
+        m_Exception = nullptr;
+        std::rethrow_exception(exception);
+    }
+}
+
+RenderThreadStats RenderThread::GetStats() const
+{
+    RenderThreadStats stats = {};
+    stats.NumFrames = m_NumFrames.load(std::memory_order_relaxed);
+    stats.EventsPosted = m_EventsPosted.load(std::memory_order_relaxed);
+    stats.EventsDropped = m_EventsDropped.load(std::memory_order_relaxed);
+    stats.EventsProcessed = m_EventsProcessed.load(std::memory_order_relaxed);
+    if (stats.EventsProcessed > 0)
+    {
+        stats.AverageEventLatencyMs = m_TotalLatencyMicroseconds.load(std::memory_order_relaxed) / 1000.0 / stats.EventsProcessed;
+    }
+    stats.MaxEventLatencyMs = m_MaxLatencyMicroseconds.load(std::memory_order_relaxed) / 1000.0;
+    return stats;
+}
+
+void RenderThread::Run()
+{
+    try
+    {
+        while (!IsStopRequested())
+        {
+            ProcessEvents();
+            m_FrameFunction();
+            m_NumFrames.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    catch (...)
+    {
+        // Still fall through to the exit function, the window thread is waiting to hear we're done
+        m_Exception = std::current_exception();
+    }
+
+    if (m_ExitFunction)
+    {
+        m_ExitFunction();
+    }
+    m_Exited.store(true, std::memory_order_release);
+}
+
+void RenderThread::ProcessEvents()
+{
+    WindowEvent event;
+    while (m_Events.TryPop(event))
+    {
+        // Only the render thread writes these, the atomics are just so GetStats can be called from anywhere
+        auto now = std::chrono::steady_clock::now();
+        uint64_t latency = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(now - event.Timestamp).count());
+        m_TotalLatencyMicroseconds.fetch_add(latency, std::memory_order_relaxed);
+        if (latency > m_MaxLatencyMicroseconds.load(std::memory_order_relaxed))
+        {
+            m_MaxLatencyMicroseconds.store(latency, std::memory_order_relaxed);
+        }
+        m_EventsProcessed.fetch_add(1, std::memory_order_relaxed);
+
+        if (m_EventHandler)
+        {
+            m_EventHandler(event);
+        }
+    }
+
+    // Newer than anything that was in the queue when it got parked
+    uint64_t overflowResize = m_OverflowResize.exchange(0, std::memory_order_acquire);
+    if ((overflowResize & OVERFLOW_RESIZE_VALID) && m_EventHandler)
+    {
+        m_EventHandler({ WindowEventType::Resize, static_cast<uint32_t>(overflowResize >> 32) & 0x7FFFFFFF,
+            static_cast<uint32_t>(overflowResize), std::chrono::steady_clock::now() });
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+// Runs frames on a dedicated thread so the Win32 message pump can never stall them
+// (modal move/size loops, message floods, ...).
+//
+// The window thread only ever posts: events go through a lock-free SPSC queue and a stop is a flag.
+// It never waits on the render thread, so it keeps pumping messages while the render thread is inside
+// Present or ResizeBuffers (both can send messages to the window and wait for them to be handled).
+// That's what keeps resize and shutdown from deadlocking:
+//   resize   : WM_SIZE posts a Resize event, the render thread resizes the swap chain at its next frame
+//   shutdown : WM_CLOSE calls RequestStop, the render thread finishes its frame and calls the exit function
+//              (which posts a message back), only then does the window thread Join and destroy the window
+//
+// Only uses the STL, the platform specifics live in the handler, frame and exit functions.
+
+#include "SPSCQueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <thread>
+
+enum class WindowEventType : uint8_t
+{
+    Resize,      // Param0 = client width, Param1 = client height
+    KeyDown,     // Param0 = virtual key code
+    KeyUp,       // Param0 = virtual key code
+    MouseMove,   // Param0 = x, Param1 = y
+    MouseButton, // Param0 = button, Param1 = 1 down / 0 up
+};
+
+struct WindowEvent
+{
+    WindowEventType Type;
+    uint32_t Param0;
+    uint32_t Param1;
+    std::chrono::steady_clock::time_point Timestamp; // when the window thread received it, for latency measurements
+};
+
+struct RenderThreadStats
+{
+    uint64_t NumFrames;
+    uint64_t EventsPosted;
+    uint64_t EventsDropped; // queue was full, only happens if the render thread is stuck (the latest resize is kept regardless)
+    uint64_t EventsProcessed;
+    double AverageEventLatencyMs; // from Timestamp until the render thread picked the event up
+    double MaxEventLatencyMs;
+};
+
+class RenderThread
+{
+public:
+    static const size_t EVENT_QUEUE_SIZE = 1024;
+
+    using EventHandler = std::function<void(const WindowEvent&)>; // on the render thread, before the frame
+    using FrameFunction = std::function<void()>; // one frame, called until a stop is requested
+    using ExitFunction = std::function<void()>; // on the render thread after the last frame (or an exception)
+
+    RenderThread(EventHandler eventHandler, FrameFunction frameFunction, ExitFunction exitFunction = nullptr);
+    ~RenderThread(); // requests a stop and joins
+
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    void Start();
+
+    // Window thread only, never blocks. Returns false if the event had to be dropped.
+    bool PostEvent(WindowEventType type, uint32_t param0 = 0, uint32_t param1 = 0,
+        std::chrono::steady_clock::time_point timestamp = std::chrono::steady_clock::now());
+
+    // Any thread, never blocks. The current frame finishes first.
+    void RequestStop();
+    bool IsStopRequested() const { return m_StopRequested.load(std::memory_order_acquire); }
+
+    // True once the exit function has run, Join won't block after that
+    bool HasExited() const { return m_Exited.load(std::memory_order_acquire); }
+
+    // Waits for the thread and rethrows whatever ended it, if it was an exception
+    void Join();
+
+    RenderThreadStats GetStats() const;
+
+    // Render thread only. Runs automatically before every frame, a frame that blocks (e.g. on the swap chain)
+    // calls it again afterwards so input that came in meanwhile makes it into this frame.
+    void ProcessEvents();
+
+private:
+    void Run();
+
+    EventHandler m_EventHandler;
+    FrameFunction m_FrameFunction;
+    ExitFunction m_ExitFunction;
+
+    SPSCQueue<WindowEvent, EVENT_QUEUE_SIZE> m_Events;
+    std::thread m_Thread;
+    std::atomic<bool> m_StopRequested{ false };
+    std::atomic<bool> m_Exited{ false };
+    std::exception_ptr m_Exception;
+    // A resize that didn't fit in the queue: OVERFLOW_RESIZE_VALID | width << 32 | height, 0 = none.
+    // The valid bit is separate so a parked 0x0 (minimized) isn't mistaken for none.
+    static const uint64_t OVERFLOW_RESIZE_VALID = 1ull << 63;
+    std::atomic<uint64_t> m_OverflowResize{ 0 };
+
+    std::atomic<uint64_t> m_NumFrames{ 0 };
+    std::atomic<uint64_t> m_EventsPosted{ 0 };
+    std::atomic<uint64_t> m_EventsDropped{ 0 };
+    std::atomic<uint64_t> m_EventsProcessed{ 0 };
+    std::atomic<uint64_t> m_TotalLatencyMicroseconds{ 0 };
+    std::atomic<uint64_t> m_MaxLatencyMicroseconds{ 0 };
+};
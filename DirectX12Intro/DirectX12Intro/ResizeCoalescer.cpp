@@ -0,0 +1,62 @@
+#include "ResizeCoalescer.h"
+
+#include <algorithm>
+
+void ResizeCoalescer::OnSize(uint32_t width, uint32_t height, Clock::time_point time)
+{
+    ++m_NumEvents;
+
+    // Minimizing sends a 0x0 size, there's nothing to render into so keep the old buffers
+    if (width == 0 || height == 0)
+    {
+        return;
+    }
+
+    // Latency counts from the first event that hasn't been applied yet
+    if (!m_HasPending)
+    {
+        m_FirstEventTime = time;
+    }
+
+    m_PendingWidth = width;
+    m_PendingHeight = height;
+    m_HasPending = true;
+}
+
+bool ResizeCoalescer::ConsumePending(uint32_t currentWidth, uint32_t currentHeight, uint32_t& width, uint32_t& height)
+{
+    if (!m_HasPending)
+    {
+        return false;
+    }
+    m_HasPending = false;
+
+    // Dragged back to where it started, no need to touch the swap chain
+    if (m_PendingWidth == currentWidth && m_PendingHeight == currentHeight)
+    {
+        return false;
+    }
+
+    width = m_PendingWidth;
+    height = m_PendingHeight;
+    return true;
+}
+
+void ResizeCoalescer::OnResized(Clock::time_point time)
+{
+    m_LastLatencyMs = std::chrono::duration<double, std::milli>(time - m_FirstEventTime).count();
+    m_MaxLatencyMs = std::max(m_MaxLatencyMs, m_LastLatencyMs);
+    m_TotalLatencyMs += m_LastLatencyMs;
+    ++m_NumResizes;
+}
+
+ResizeCoalescer::Stats ResizeCoalescer::GetStats() const
+{
+    Stats stats = {};
+    stats.NumEvents = m_NumEvents;
+    stats.NumResizes = m_NumResizes;
+    stats.LastLatencyMs = m_LastLatencyMs;
+    stats.MaxLatencyMs = m_MaxLatencyMs;
+    stats.AverageLatencyMs = m_NumResizes > 0 ? m_TotalLatencyMs / m_NumResizes : 0.0;
+    return stats;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+// Coalesces window size events into at most one swap chain resize per frame.
+// Dragging a window border sends a stream of WM_SIZE messages. Resizing the swap chain for
+// every one of them would mean waiting on the GPU over and over, so WndProc only records the
+// latest size here and the frame applies it once before it touches the back buffers.
+//
+// Also measures resize latency: the time from the first size event of a resize to the point
+// the new back buffers are ready.
+//
+// No Windows dependencies, all the logic can be driven by a synthetic event source.
+
+#include <chrono>
+#include <cstdint>
+
+class ResizeCoalescer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats
+    {
+        uint32_t NumEvents;  // size events received
+        uint32_t NumResizes; // resizes actually applied
+        double LastLatencyMs;
+        double MaxLatencyMs;
+        double AverageLatencyMs;
+    };
+
+    // From WM_SIZE, any number of times per frame. A 0 size (minimized) is ignored.
+    void OnSize(uint32_t width, uint32_t height, Clock::time_point time = Clock::now());
+
+    // Once per frame. Returns true with the size to resize to if the latest size differs from the current one.
+    bool ConsumePending(uint32_t currentWidth, uint32_t currentHeight, uint32_t& width, uint32_t& height);
+
+    // Once the swap chain has been resized, closes the latency measurement
+    void OnResized(Clock::time_point time = Clock::now());
+
+    Stats GetStats() const;
+
+private:
+    uint32_t m_PendingWidth = 0;
+    uint32_t m_PendingHeight = 0;
+    bool m_HasPending = false;
+    Clock::time_point m_FirstEventTime;
+
+    uint32_t m_NumEvents = 0;
+    uint32_t m_NumResizes = 0;
+    double m_LastLatencyMs = 0.0;
+    double m_MaxLatencyMs = 0.0;
+    double m_TotalLatencyMs = 0.0;
+};
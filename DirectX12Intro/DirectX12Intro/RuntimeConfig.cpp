@@ -0,0 +1,434 @@
+#include "RuntimeConfig.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#define CONFIG_OPTION(member, type, name, shortName, hotReload, min, max, description) \
+    { name, shortName, ConfigType::type, hotReload, min, max, description, \
+      [](RuntimeConfig& config) -> void* { return &config.member; } }
+
+namespace
+{
+    std::string Trim(const std::string& text)
+    {
+        size_t first = 0;
+        size_t last = text.size();
+        while (first < last && std::isspace(static_cast<unsigned char>(text[first])))
+        {
+            ++first;
+        }
+        while (last > first && std::isspace(static_cast<unsigned char>(text[last - 1])))
+        {
+            --last;
+        }
+        return text.substr(first, last - first);
+    }
+
+    const ConfigOption* FindOption(const std::string& name)
+    {
+        for (const ConfigOption& option : GetConfigOptions())
+        {
+            if (name == option.Name || (option.ShortName && name == option.ShortName))
+            {
+                return &option;
+            }
+        }
+        return nullptr;
+    }
+
+    bool ParseBool(const std::string& text, bool& value)
+    {
+        std::string lower = text;
+        std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (lower == "true" || lower == "1" || lower == "on" || lower == "yes")
+        {
+            value = true;
+            return true;
+        }
+        if (lower == "false" || lower == "0" || lower == "off" || lower == "no")
+        {
+            value = false;
+            return true;
+        }
+        return false;
+    }
+
+    bool IsEqual(const RuntimeConfig& a, const RuntimeConfig& b, const ConfigOption& option)
+    {
+        const void* valueA = option.GetValue(const_cast<RuntimeConfig&>(a));
+        const void* valueB = option.GetValue(const_cast<RuntimeConfig&>(b));
+        switch (option.Type)
+        {
+        case ConfigType::Bool: return *static_cast<const bool*>(valueA) == *static_cast<const bool*>(valueB);
+        case ConfigType::UInt: return *static_cast<const uint32_t*>(valueA) == *static_cast<const uint32_t*>(valueB);
+        case ConfigType::Double: return *static_cast<const double*>(valueA) == *static_cast<const double*>(valueB);
+        case ConfigType::String: return *static_cast<const std::string*>(valueA) == *static_cast<const std::string*>(valueB);
+        }
+        return true;
+    }
+
+    void CopyValue(RuntimeConfig& to, const RuntimeConfig& from, const ConfigOption& option)
+    {
+        void* destination = option.GetValue(to);
+        const void* source = option.GetValue(const_cast<RuntimeConfig&>(from));
+        switch (option.Type)
+        {
+        case ConfigType::Bool: *static_cast<bool*>(destination) = *static_cast<const bool*>(source); break;
+        case ConfigType::UInt: *static_cast<uint32_t*>(destination) = *static_cast<const uint32_t*>(source); break;
+        case ConfigType::Double: *static_cast<double*>(destination) = *static_cast<const double*>(source); break;
+        case ConfigType::String: *static_cast<std::string*>(destination) = *static_cast<const std::string*>(source); break;
+        }
+    }
+
+    // Throws with a message that doesn't say where, the callers add that
+    void SetValue(RuntimeConfig& config, const ConfigOption& option, const std::string& text)
+    {
+        void* value = option.GetValue(config);
+        switch (option.Type)
+        {
+        case ConfigType::Bool:
+            if (!ParseBool(text, *static_cast<bool*>(value)))
+            {
+                throw std::runtime_error(std::string(option.Name) + ": expected true or false, got \"" + text + "\"");
+            }
+            break;
+        case ConfigType::UInt:
+        case ConfigType::Double:
+        {
+            char* end = nullptr;
+            double number = std::strtod(text.c_str(), &end);
+
+            // strtod takes "nan" and "inf", NaN would sail through the range check (every compare is false)
+            if (text.empty() || *end != '\0' || !std::isfinite(number) || (option.Type == ConfigType::UInt && number != static_cast<double>(static_cast<int64_t>(number))))
+            {
+                throw std::runtime_error(std::string(option.Name) + ": expected a " + (option.Type == ConfigType::UInt ? "whole " : "")
+                    + "number, got \"" + text + "\"");
+            }
+            if (number < option.Min || number > option.Max)
+            {
+                char buffer[256];
+                std::snprintf(buffer, sizeof(buffer), "%s: %s is out of range [%g, %g]", option.Name, text.c_str(), option.Min, option.Max);
+                throw std::runtime_error(buffer);
+            }
+            if (option.Type == ConfigType::UInt)
+            {
+                *static_cast<uint32_t*>(value) = static_cast<uint32_t>(number);
+            }
+            else
+            {
+                *static_cast<double*>(value) = number;
+            }
+            break;
+        }
+        case ConfigType::String:
+        {
+            std::string unquoted = text;
+            if (unquoted.size() >= 2 && unquoted.front() == '"' && unquoted.back() == '"')
+            {
+                unquoted = unquoted.substr(1, unquoted.size() - 2);
+            }
+            *static_cast<std::string*>(value) = unquoted;
+            break;
+        }
+        }
+    }
+}
+
+const std::vector<ConfigOption>& GetConfigOptions()
+{
+    static const std::vector<ConfigOption> options = {
+        CONFIG_OPTION(Width, UInt, "width", "w", false, 64, 16384, "Initial client area width"),
+        CONFIG_OPTION(Height, UInt, "height", "h", false, 64, 16384, "Initial client area height"),
+        CONFIG_OPTION(UseWarp, Bool, "warp", nullptr, false, 0, 0, "Use WARP, the software rasterizer"),
+
+        CONFIG_OPTION(FramesInFlight, UInt, "frames-in-flight", nullptr, false, 2, MAX_FRAMES_IN_FLIGHT, "Swap chain back buffers / frames the CPU may be ahead"),
+        CONFIG_OPTION(Vsync, Bool, "vsync", nullptr, true, 0, 0, "Wait for the vertical refresh (V toggles it)"),
+        CONFIG_OPTION(AllowTearing, Bool, "tearing", nullptr, false, 0, 0, "Allow tearing with vsync off, if the display supports it"),
+        CONFIG_OPTION(TargetFrameRate, Double, "fps", nullptr, true, 0, 1000, "Frame rate cap with vsync off, 0 = unlimited"),
+        CONFIG_OPTION(LowLatency, Bool, "low-latency", nullptr, false, 0, 0, "Wait on the swap chain's frame latency object at the start of a frame"),
+        CONFIG_OPTION(MaxFrameLatency, UInt, "max-frame-latency", nullptr, true, 1, 16, "Frames DXGI may queue in low latency mode"),
+
+        CONFIG_OPTION(ReadbackRingSizeKB, UInt, "readback-ring-kb", nullptr, false, 4, 1048576, "Size of the readback ring buffer in KB"),
+
+        CONFIG_OPTION(WorkerThreads, UInt, "worker-threads", nullptr, false, 0, 256, "Worker threads, 0 = one per hardware thread"),
+
+        CONFIG_OPTION(MultiGPU, String, "multi-gpu", nullptr, false, 0, 0, "Linked adapter mode: single, afr (alternate frames) or sfr (split frames)"),
+
+        CONFIG_OPTION(ForceRenderPasses, Bool, "force-render-passes", nullptr, false, 0, 0, "Record render passes even when the GPU isn't a tile based renderer"),
+
+        CONFIG_OPTION(DynamicResolution, Bool, "dynamic-resolution", nullptr, false, 0, 0, "Scale the render resolution to keep within the GPU budget"),
+        CONFIG_OPTION(GPUBudgetMs, Double, "gpu-budget", nullptr, true, 1, 1000, "GPU budget per frame for dynamic resolution, ms"),
+        CONFIG_OPTION(DynamicResolutionTrace, String, "drs-trace", nullptr, false, 0, 0, "Write a (scale, GPU time) per frame trace here on exit"),
+
+        CONFIG_OPTION(Validate, Bool, "validate", nullptr, false, 0, 0, "Runtime validation of barriers, descriptors, fences and allocators"),
+        CONFIG_OPTION(DRED, Bool, "dred", nullptr, false, 0, 0, "Device Removed Extended Data (always on in debug builds)"),
+        CONFIG_OPTION(MemorySnapshots, String, "memory-snapshots", nullptr, false, 0, 0, "Write GPU memory snapshots here, a line of JSON each"),
+        CONFIG_OPTION(MemorySnapshotFrames, UInt, "memory-snapshot-frames", nullptr, false, 1, 1000000, "Frames between GPU memory snapshots"),
+        CONFIG_OPTION(HotReloadShaders, Bool, "shader-hot-reload", nullptr, false, 0, 0, "Recompile the shaders when their source changes (upscale only, needs dynamic resolution)"),
+        CONFIG_OPTION(ShaderDirectory, String, "shader-dir", nullptr, false, 0, 0, "Shader source directory for hot reload"),
+
+        CONFIG_OPTION(Benchmark, String, "benchmark", nullptr, false, 0, 0, "Run this benchmark scenario (clear, upscale, resize) instead of the interactive loop"),
+        CONFIG_OPTION(BenchmarkWarmupFrames, UInt, "benchmark-warmup", nullptr, false, 0, 100000, "Benchmark frames rendered before measuring"),
+        CONFIG_OPTION(BenchmarkFrames, UInt, "benchmark-frames", nullptr, false, 1, 1000000, "Benchmark frames measured"),
+        CONFIG_OPTION(BenchmarkCSV, String, "benchmark-csv", nullptr, false, 0, 0, "Per frame benchmark results are written here"),
+        CONFIG_OPTION(BenchmarkBaseline, String, "benchmark-baseline", nullptr, false, 0, 0, "Baseline to check the benchmark against, exit code 1 on a regression"),
+        CONFIG_OPTION(BenchmarkSaveBaseline, String, "benchmark-save-baseline", nullptr, false, 0, 0, "Write the benchmark summary here as a new baseline"),
+    };
+    return options;
+}
+
+void SetConfigValue(RuntimeConfig& config, const std::string& name, const std::string& value)
+{
+    const ConfigOption* option = FindOption(name);
+    if (!option)
+    {
+        throw std::runtime_error("unknown option \"" + name + "\"");
+    }
+    SetValue(config, *option, value);
+}
+
+void ParseConfigText(const std::string& text, const std::string& source, RuntimeConfig& config)
+{
+    std::istringstream in(text);
+    std::string line;
+    uint32_t lineNumber = 0;
+    while (std::getline(in, line))
+    {
+        ++lineNumber;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+        {
+            line.resize(comment);
+        }
+        line = Trim(line);
+        if (line.empty())
+        {
+            continue;
+        }
+
+        try
+        {
+            size_t equals = line.find('=');
+            if (equals == std::string::npos)
+            {
+                throw std::runtime_error("expected name = value");
+            }
+            SetConfigValue(config, Trim(line.substr(0, equals)), Trim(line.substr(equals + 1)));
+        }
+        catch (const std::runtime_error& e)
+        {
+            throw std::runtime_error(source + ":" + std::to_string(lineNumber) + ": " + e.what());
+        }
+    }
+}
+
+void LoadConfigFile(const std::string& path, RuntimeConfig& config)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        throw std::runtime_error("Failed to open " + path);
+    }
+
+    std::stringstream text;
+    text << in.rdbuf();
+    ParseConfigText(text.str(), path, config);
+}
+
+std::string GetConfigValue(const RuntimeConfig& config, const ConfigOption& option)
+{
+    const void* value = option.GetValue(const_cast<RuntimeConfig&>(config));
+    char buffer[64];
+    switch (option.Type)
+    {
+    case ConfigType::Bool:
+        return *static_cast<const bool*>(value) ? "true" : "false";
+    case ConfigType::UInt:
+        return std::to_string(*static_cast<const uint32_t*>(value));
+    case ConfigType::Double:
+        std::snprintf(buffer, sizeof(buffer), "%g", *static_cast<const double*>(value));
+        return buffer;
+    case ConfigType::String:
+        return *static_cast<const std::string*>(value);
+    }
+    return std::string();
+}
+
+std::string FormatConfig(const RuntimeConfig& config)
+{
+    std::string text;
+    for (const ConfigOption& option : GetConfigOptions())
+    {
+        text += std::string("# ") + option.Description + (option.HotReload ? " (hot reloadable)" : "") + "\n";
+        std::string value = GetConfigValue(config, option);
+        text += std::string(option.Name) + (value.empty() ? " =" : " = " + value) + "\n\n";
+    }
+    return text;
+}
+
+// ConfigSource
+
+ConfigSource::ConfigSource(const std::vector<std::string>& args, const std::string& defaultPath)
+    : m_Path(defaultPath)
+{
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        const std::string& arg = args[i];
+        if (arg.size() < 2 || arg[0] != '-')
+        {
+            throw std::runtime_error("unexpected argument \"" + arg + "\"");
+        }
+
+        std::string name = arg.substr(arg[1] == '-' ? 2 : 1);
+        std::string value;
+        bool hasValue = false;
+        size_t equals = name.find('=');
+        if (equals != std::string::npos)
+        {
+            value = name.substr(equals + 1);
+            name.resize(equals);
+            hasValue = true;
+        }
+
+        if (name == "config")
+        {
+            if (!hasValue && i + 1 >= args.size())
+            {
+                throw std::runtime_error("--config needs a path");
+            }
+            m_Path = hasValue ? value : args[++i];
+            m_PathRequired = true;
+            continue;
+        }
+
+        const ConfigOption* option = FindOption(name);
+        if (!option && name.compare(0, 3, "no-") == 0)
+        {
+            option = FindOption(name.substr(3));
+            if (option && option->Type == ConfigType::Bool && !hasValue)
+            {
+                m_Overrides.emplace_back(option->Name, "false");
+                continue;
+            }
+            option = nullptr;
+        }
+        if (!option)
+        {
+            throw std::runtime_error("unknown option \"" + arg + "\"");
+        }
+
+        if (!hasValue)
+        {
+            if (option->Type == ConfigType::Bool)
+            {
+                value = "true"; // bare flag, a separate value would be ambiguous with the next option
+            }
+            else if (i + 1 < args.size())
+            {
+                value = args[++i];
+            }
+            else
+            {
+                throw std::runtime_error(arg + " needs a value");
+            }
+        }
+
+        // Check now rather than on every reload
+        RuntimeConfig scratch;
+        SetValue(scratch, *option, value);
+        m_Overrides.emplace_back(option->Name, value);
+    }
+}
+
+RuntimeConfig ConfigSource::Load() const
+{
+    RuntimeConfig config;
+    m_HasWriteTime = false;
+    if (!m_Path.empty())
+    {
+        bool exists = GetWriteTime(m_LastWriteTime);
+        if (exists || m_PathRequired)
+        {
+            LoadConfigFile(m_Path, config);
+        }
+        m_HasWriteTime = exists;
+    }
+
+    for (const auto& entry : m_Overrides)
+    {
+        SetConfigValue(config, entry.first, entry.second);
+    }
+    return config;
+}
+
+bool ConfigSource::Poll(RuntimeConfig& config, std::vector<std::string>& messages, std::chrono::milliseconds pollInterval)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (m_Path.empty() || now < m_NextPoll)
+    {
+        return false;
+    }
+    m_NextPoll = now + pollInterval;
+
+    int64_t writeTime = 0;
+    if (!GetWriteTime(writeTime) || (m_HasWriteTime && writeTime == m_LastWriteTime))
+    {
+        return false;
+    }
+
+    RuntimeConfig loaded;
+    try
+    {
+        loaded = Load();
+    }
+    catch (const std::exception& e)
+    {
+        // Most likely saved halfway through an edit, keep running with what we have
+        m_LastWriteTime = writeTime;
+        m_HasWriteTime = true;
+        messages.push_back(std::string("Config not reloaded: ") + e.what());
+        return false;
+    }
+
+    bool applied = false;
+    for (const ConfigOption& option : GetConfigOptions())
+    {
+        std::string oldValue = GetConfigValue(config, option);
+        std::string newValue = GetConfigValue(loaded, option);
+        if (IsEqual(config, loaded, option))
+        {
+            continue;
+        }
+
+        if (option.HotReload)
+        {
+            CopyValue(config, loaded, option);
+            messages.push_back(std::string(option.Name) + ": " + oldValue + " -> " + newValue);
+            applied = true;
+        }
+        else
+        {
+            messages.push_back(std::string(option.Name) + ": " + oldValue + " -> " + newValue + " takes effect after a restart");
+        }
+    }
+    return applied;
+}
+
+bool ConfigSource::GetWriteTime(int64_t& time) const
+{
+    std::error_code error;
+    auto writeTime = std::filesystem::last_write_time(m_Path, error);
+    if (error)
+    {
+        return false;
+    }
+    time = static_cast<int64_t>(writeTime.time_since_epoch().count());
+    return true;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+// Runtime configuration
+// Every performance knob in one typed struct, so tuning doesn't mean recompiling.
+// Values come from, in increasing priority: the defaults below, a config file, the command line.
+//
+// Config file: one "name = value" per line, # starts a comment, e.g.
+//   frames-in-flight = 2
+//   vsync = false
+//   fps = 144
+// Command line: the same names as "--name value" or "--name=value". Bools can also be given bare
+// ("--vsync") or negated ("--no-vsync"), "--config <path>" picks the file. The old short forms
+// (-w, -h, -warp, -fps) still work.
+//
+// Hot reload: ConfigSource::Poll notices when the file is saved and reloads it. Options marked hot
+// reloadable are applied right away. The rest (anything a device, swap chain or pool was created with)
+// are reported and keep their value until the next start. Command line values keep overriding the file.
+//
+// Only uses the STL, so the parsing can be checked on any platform (RuntimeBench config).
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+
+struct RuntimeConfig
+{
+    // Window
+    uint32_t Width = 1280;
+    uint32_t Height = 720;
+    bool UseWarp = false;
+
+    // Swap chain and frame pacing
+    uint32_t FramesInFlight = 3;  // swap chain back buffers, 2 to MAX_FRAMES_IN_FLIGHT
+    bool Vsync = true;
+    bool AllowTearing = true;     // if the display supports it, only used with vsync off
+    double TargetFrameRate = 0.0; // cap with vsync off, 0 = unlimited
+    bool LowLatency = false;
+    uint32_t MaxFrameLatency = 1; // frames DXGI may queue in low latency mode
+
+    // Memory
+    uint32_t ReadbackRingSizeKB = 1024;
+
+    // CPU
+    uint32_t WorkerThreads = 0; // 0 = one per hardware thread
+
+    // Linked adapters: single, afr or sfr (see MultiGPU.h)
+    std::string MultiGPU = "single";
+
+    // Render passes (see RenderPassEncoder.h): BeginRenderPass even on GPUs that aren't tile based
+    bool ForceRenderPasses = false;
+
+    // Dynamic resolution
+    bool DynamicResolution = false;
+    double GPUBudgetMs = 15.0;
+    std::string DynamicResolutionTrace; // written on exit if set
+
+    // Diagnostics
+    bool Validate = false;
+    bool DRED = false;
+    std::string MemorySnapshots;       // JSON lines of the GPU memory totals (see GPUMemoryTracker.h), empty = off
+    uint32_t MemorySnapshotFrames = 60; // a line every this many frames
+    bool HotReloadShaders = false;       // recompile shaders edited while running (see ShaderHotReload.h)
+    std::string ShaderDirectory = "Shaders"; // where the .hlsl files are, from the working directory
+
+    // Benchmark mode (see Benchmark.h): runs the named scenario instead of the interactive loop, empty = interactive
+    std::string Benchmark;
+    uint32_t BenchmarkWarmupFrames = 120;
+    uint32_t BenchmarkFrames = 1000;
+    std::string BenchmarkCSV = "benchmark.csv";
+    std::string BenchmarkBaseline;     // checked after the run, regressions make the exit code 1
+    std::string BenchmarkSaveBaseline; // the run's summary is written here as a new baseline
+};
+
+enum class ConfigType
+{
+    Bool,
+    UInt,
+    Double,
+    String
+};
+
+struct ConfigOption
+{
+    const char* Name;
+    const char* ShortName; // old single dash form, or nullptr
+    ConfigType Type;
+    bool HotReload;        // safe to change while running
+    double Min;            // numbers only
+    double Max;
+    const char* Description;
+    void* (*GetValue)(RuntimeConfig& config);
+};
+
+const std::vector<ConfigOption>& GetConfigOptions();
+
+// Throw std::runtime_error saying where (source:line) and what on unknown names and bad values
+void ParseConfigText(const std::string& text, const std::string& source, RuntimeConfig& config);
+void LoadConfigFile(const std::string& path, RuntimeConfig& config);
+void SetConfigValue(RuntimeConfig& config, const std::string& name, const std::string& value);
+
+std::string GetConfigValue(const RuntimeConfig& config, const ConfigOption& option);
+
+// All options with their descriptions, in the file format
+std::string FormatConfig(const RuntimeConfig& config);
+
+class ConfigSource
+{
+public:
+    // Command line without the program name. The overrides are parsed (and checked) right away.
+    // Without --config, defaultPath is used if it exists.
+    ConfigSource(const std::vector<std::string>& args, const std::string& defaultPath = std::string());
+
+    // Defaults + file + command line
+    RuntimeConfig Load() const;
+
+    const std::string& GetPath() const { return m_Path; }
+
+    // Reloads the file if it changed since the last Load/Poll, checking at most every pollInterval.
+    // Hot reloadable changes are applied to config, the others are left alone. Returns true if anything
+    // was applied. messages gets a line per change (and per error, the old values are kept then).
+    bool Poll(RuntimeConfig& config, std::vector<std::string>& messages,
+        std::chrono::milliseconds pollInterval = std::chrono::milliseconds(500));
+
+private:
+    bool GetWriteTime(int64_t& time) const;
+
+    std::string m_Path;
+    bool m_PathRequired = false;
+    std::vector<std::pair<std::string, std::string>> m_Overrides;
+
+    mutable int64_t m_LastWriteTime = 0;
+    mutable bool m_HasWriteTime = false;
+    std::chrono::steady_clock::time_point m_NextPoll{};
+};
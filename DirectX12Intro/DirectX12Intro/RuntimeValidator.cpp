@@ -0,0 +1,229 @@
+#include "RuntimeValidator.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h> // OutputDebugStringA
+#endif
+
+#include <cstdarg>
+#include <cstdio>
+
+namespace
+{
+    void DefaultErrorHandler(const ValidationError& error)
+    {
+        std::string line = std::string("Validation error (") + GetValidationErrorName(error.Type) + "): " + error.Message + "\n";
+#if defined(_WIN32)
+        ::OutputDebugStringA(line.c_str());
+#else
+        std::fputs(line.c_str(), stderr);
+#endif
+    }
+}
+
+const char* GetValidationErrorName(ValidationErrorType type)
+{
+    switch (type)
+    {
+    case ValidationErrorType::BarrierStateMismatch: return "barrier state mismatch";
+    case ValidationErrorType::ReleasedResourceUse: return "released resource use";
+    case ValidationErrorType::FenceValueNotIncreasing: return "fence value not increasing";
+    case ValidationErrorType::AllocatorResetInFlight: return "allocator reset in flight";
+    default: return "unknown";
+    }
+}
+
+RuntimeValidator::RuntimeValidator(bool enabled)
+    : m_Enabled(enabled)
+    , m_ErrorHandler(&DefaultErrorHandler)
+{}
+
+uint64_t RuntimeValidator::GetErrorCount() const
+{
+    uint64_t count = 0;
+    for (uint64_t typeCount : m_ErrorCounts)
+    {
+        count += typeCount;
+    }
+    return count;
+}
+
+void RuntimeValidator::ClearErrors()
+{
+    for (uint64_t& count : m_ErrorCounts)
+    {
+        count = 0;
+    }
+    m_Errors.clear();
+}
+
+void RuntimeValidator::Reset()
+{
+    m_Resources.clear();
+    m_Descriptors.clear();
+    m_CommandLists.clear();
+    m_Fences.clear();
+    m_Allocators.clear();
+}
+
+void RuntimeValidator::TrackResource(const void* resource, uint32_t state, const char* name)
+{
+    m_Resources[resource] = { m_NextResourceId++, state, name };
+}
+
+void RuntimeValidator::UntrackResource(const void* resource)
+{
+    m_Resources.erase(resource);
+}
+
+void RuntimeValidator::TrackDescriptor(uint64_t descriptor, const void* resource)
+{
+    auto it = m_Resources.find(resource);
+    if (it == m_Resources.end())
+    {
+        Report(ValidationErrorType::ReleasedResourceUse, "descriptor 0x%llx created for untracked or released resource %p",
+            static_cast<unsigned long long>(descriptor), resource);
+        m_Descriptors.erase(descriptor);
+        return;
+    }
+    m_Descriptors[descriptor] = { resource, it->second.Id };
+}
+
+void RuntimeValidator::ValidateDescriptor(uint64_t descriptor)
+{
+    auto it = m_Descriptors.find(descriptor);
+    if (it == m_Descriptors.end())
+    {
+        return; // not one we were told about
+    }
+
+    // The pointer may belong to a new resource by now, only the id tells
+    auto resource = m_Resources.find(it->second.Resource);
+    if (resource == m_Resources.end() || resource->second.Id != it->second.ResourceId)
+    {
+        Report(ValidationErrorType::ReleasedResourceUse, "descriptor 0x%llx used after its resource %p was released",
+            static_cast<unsigned long long>(descriptor), it->second.Resource);
+    }
+}
+
+void RuntimeValidator::ValidateBarrier(const void* commandList, const void* resource, uint32_t before, uint32_t after)
+{
+    auto it = m_Resources.find(resource);
+    if (it == m_Resources.end())
+    {
+        Report(ValidationErrorType::ReleasedResourceUse, "barrier on untracked or released resource %p", resource);
+        return;
+    }
+
+    std::vector<ListTransition>& transitions = m_CommandLists[commandList];
+    for (ListTransition& transition : transitions)
+    {
+        if (transition.Resource == resource && transition.ResourceId == it->second.Id)
+        {
+            if (transition.Current != before)
+            {
+                Report(ValidationErrorType::BarrierStateMismatch,
+                    "%s: barrier from state 0x%x, but this command list left it in 0x%x",
+                    GetName(it->second), before, transition.Current);
+            }
+            transition.Current = after;
+            return;
+        }
+    }
+
+    // First use in this list, checked against the global state on execute
+    transitions.push_back({ resource, it->second.Id, before, after });
+}
+
+void RuntimeValidator::ValidateExecute(const void* commandList)
+{
+    auto list = m_CommandLists.find(commandList);
+    if (list == m_CommandLists.end())
+    {
+        return;
+    }
+
+    for (const ListTransition& transition : list->second)
+    {
+        auto it = m_Resources.find(transition.Resource);
+        if (it == m_Resources.end() || it->second.Id != transition.ResourceId)
+        {
+            Report(ValidationErrorType::ReleasedResourceUse, "resource %p released between recording and execute",
+                transition.Resource);
+            continue;
+        }
+
+        if (it->second.State != transition.FirstBefore)
+        {
+            Report(ValidationErrorType::BarrierStateMismatch, "%s: barrier from state 0x%x, but it is in 0x%x when the list executes",
+                GetName(it->second), transition.FirstBefore, it->second.State);
+        }
+        it->second.State = transition.Current;
+    }
+    list->second.clear();
+}
+
+void RuntimeValidator::ValidateSignal(const void* fence, uint64_t value)
+{
+    FenceInfo& info = m_Fences[fence];
+    if (value <= info.LastSignaled)
+    {
+        Report(ValidationErrorType::FenceValueNotIncreasing, "fence %p signaled with %llu after %llu", fence,
+            static_cast<unsigned long long>(value), static_cast<unsigned long long>(info.LastSignaled));
+    }
+    info.LastSignaled = value;
+}
+
+void RuntimeValidator::ValidateFenceCompleted(const void* fence, uint64_t completedValue)
+{
+    FenceInfo& info = m_Fences[fence];
+    if (completedValue < info.LastCompleted)
+    {
+        Report(ValidationErrorType::FenceValueNotIncreasing, "fence %p completed value went from %llu back to %llu", fence,
+            static_cast<unsigned long long>(info.LastCompleted), static_cast<unsigned long long>(completedValue));
+    }
+    info.LastCompleted = completedValue;
+}
+
+void RuntimeValidator::ValidateAllocatorReset(const void* allocator, uint64_t completedValue)
+{
+    auto it = m_Allocators.find(allocator);
+    if (it == m_Allocators.end())
+    {
+        return; // never submitted
+    }
+
+    ValidateFenceCompleted(it->second.Fence, completedValue);
+    if (completedValue < it->second.Value)
+    {
+        Report(ValidationErrorType::AllocatorResetInFlight,
+            "allocator %p reset while its commands may still be executing (fence %p at %llu, needs %llu)",
+            allocator, it->second.Fence, static_cast<unsigned long long>(completedValue),
+            static_cast<unsigned long long>(it->second.Value));
+    }
+}
+
+void RuntimeValidator::Report(ValidationErrorType type, const char* format, ...)
+{
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    std::vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    ValidationError error = { type, buffer };
+    ++m_ErrorCounts[static_cast<size_t>(type)];
+    if (m_ErrorHandler)
+    {
+        m_ErrorHandler(error);
+    }
+    if (m_Errors.size() < MAX_STORED_ERRORS)
+    {
+        m_Errors.push_back(std::move(error));
+    }
+}
+
+const char* RuntimeValidator::GetName(const ResourceInfo& info)
+{
+    return info.Name ? info.Name : "(unnamed resource)";
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+// In-process validation of the mistakes we actually make, for when the SDK debug layer is too slow
+// to profile with. It only knows what the renderer tells it through the On* hooks, nothing is intercepted.
+//
+// Checks:
+//   barrier state mismatches: a barrier's StateBefore has to be the state the resource is in by then.
+//     Each command list tracks the states it expects on its own (the first StateBefore per resource and
+//     where it left it), they're checked against the global state and applied to it on execute,
+//     which is when the order of the lists is known. Whole resources only, no per subresource tracking.
+//   use of released resources: barriers on, and descriptors of, resources released since
+//   fence values going backwards: every Signal must be higher than the last one on that fence,
+//     and a fence's completed value never goes down
+//   allocator reuse before retirement: resetting an allocator before the fence value of the last
+//     submission that used it has completed
+//
+// Objects are identified by their pointers (and descriptors by their CPU handle), so it doesn't depend
+// on D3D12 and can be run against a null backend anywhere. Not thread safe, call it from the thread
+// that records and submits.
+// Disabled, each hook is an inlined flag test.
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class ValidationErrorType
+{
+    BarrierStateMismatch,
+    ReleasedResourceUse,
+    FenceValueNotIncreasing,
+    AllocatorResetInFlight,
+    Count
+};
+
+const char* GetValidationErrorName(ValidationErrorType type);
+
+struct ValidationError
+{
+    ValidationErrorType Type;
+    std::string Message;
+};
+
+class RuntimeValidator
+{
+public:
+    using ErrorHandler = std::function<void(const ValidationError&)>;
+
+    // Errors that are kept for GetErrors, the counts keep going
+    static const size_t MAX_STORED_ERRORS = 256;
+
+    explicit RuntimeValidator(bool enabled = false);
+
+    void SetEnabled(bool enabled) { m_Enabled = enabled; }
+    bool IsEnabled() const { return m_Enabled; }
+
+    // Called on every error. The default writes it to the debugger output (stderr off Windows).
+    void SetErrorHandler(ErrorHandler handler) { m_ErrorHandler = std::move(handler); }
+
+    // Resources. state is a D3D12_RESOURCE_STATES value, name is only for messages.
+    void OnResourceCreated(const void* resource, uint32_t state, const char* name = nullptr)
+    {
+        if (m_Enabled)
+        {
+            TrackResource(resource, state, name);
+        }
+    }
+    void OnResourceReleased(const void* resource)
+    {
+        if (m_Enabled)
+        {
+            UntrackResource(resource);
+        }
+    }
+
+    // Descriptors, by their CPU handle
+    void OnDescriptorCreated(uint64_t descriptor, const void* resource)
+    {
+        if (m_Enabled)
+        {
+            TrackDescriptor(descriptor, resource);
+        }
+    }
+    void OnDescriptorUsed(uint64_t descriptor)
+    {
+        if (m_Enabled)
+        {
+            ValidateDescriptor(descriptor);
+        }
+    }
+
+    // Command lists
+    void OnCommandListReset(const void* commandList)
+    {
+        if (m_Enabled)
+        {
+            m_CommandLists[commandList].clear();
+        }
+    }
+    void OnBarrier(const void* commandList, const void* resource, uint32_t before, uint32_t after)
+    {
+        if (m_Enabled)
+        {
+            ValidateBarrier(commandList, resource, before, after);
+        }
+    }
+    void OnExecute(const void* commandList)
+    {
+        if (m_Enabled)
+        {
+            ValidateExecute(commandList);
+        }
+    }
+
+    // Fences
+    void OnSignal(const void* fence, uint64_t value)
+    {
+        if (m_Enabled)
+        {
+            ValidateSignal(fence, value);
+        }
+    }
+    void OnFenceCompleted(const void* fence, uint64_t completedValue)
+    {
+        if (m_Enabled)
+        {
+            ValidateFenceCompleted(fence, completedValue);
+        }
+    }
+
+    // Allocators. Submitted: the last list recorded with it finishes once fence reaches value.
+    // Reset: completedValue is the current completed value of the fence it was submitted with.
+    void OnAllocatorSubmitted(const void* allocator, const void* fence, uint64_t value)
+    {
+        if (m_Enabled)
+        {
+            m_Allocators[allocator] = { fence, value };
+        }
+    }
+    void OnAllocatorReset(const void* allocator, uint64_t completedValue)
+    {
+        if (m_Enabled)
+        {
+            ValidateAllocatorReset(allocator, completedValue);
+        }
+    }
+
+    uint64_t GetErrorCount() const;
+    uint64_t GetErrorCount(ValidationErrorType type) const { return m_ErrorCounts[static_cast<size_t>(type)]; }
+    const std::vector<ValidationError>& GetErrors() const { return m_Errors; }
+    void ClearErrors();
+
+    // Forget every tracked object (e.g. after a device reset)
+    void Reset();
+
+private:
+    struct ResourceInfo
+    {
+        uint64_t Id; // pointers get reused, ids don't
+        uint32_t State;
+        const char* Name;
+    };
+
+    struct DescriptorInfo
+    {
+        const void* Resource;
+        uint64_t ResourceId;
+    };
+
+    // A resource used by a command list: what it expects the state to be when it starts, and where it leaves it
+    struct ListTransition
+    {
+        const void* Resource;
+        uint64_t ResourceId;
+        uint32_t FirstBefore;
+        uint32_t Current;
+    };
+
+    struct FenceInfo
+    {
+        uint64_t LastSignaled;
+        uint64_t LastCompleted;
+    };
+
+    struct AllocatorInfo
+    {
+        const void* Fence;
+        uint64_t Value;
+    };
+
+    void TrackResource(const void* resource, uint32_t state, const char* name);
+    void UntrackResource(const void* resource);
+    void TrackDescriptor(uint64_t descriptor, const void* resource);
+    void ValidateDescriptor(uint64_t descriptor);
+    void ValidateBarrier(const void* commandList, const void* resource, uint32_t before, uint32_t after);
+    void ValidateExecute(const void* commandList);
+    void ValidateSignal(const void* fence, uint64_t value);
+    void ValidateFenceCompleted(const void* fence, uint64_t completedValue);
+    void ValidateAllocatorReset(const void* allocator, uint64_t completedValue);
+
+    void Report(ValidationErrorType type, const char* format, ...);
+    static const char* GetName(const ResourceInfo& info);
+
+    bool m_Enabled;
+    ErrorHandler m_ErrorHandler;
+
+    uint64_t m_NextResourceId = 1;
+    std::unordered_map<const void*, ResourceInfo> m_Resources;
+    std::unordered_map<uint64_t, DescriptorInfo> m_Descriptors;
+    std::unordered_map<const void*, std::vector<ListTransition>> m_CommandLists; // a handful of resources per list, searched linearly
+    std::unordered_map<const void*, FenceInfo> m_Fences;
+    std::unordered_map<const void*, AllocatorInfo> m_Allocators;
+
+    uint64_t m_ErrorCounts[static_cast<size_t>(ValidationErrorType::Count)] = {};
+    std::vector<ValidationError> m_Errors;
+};
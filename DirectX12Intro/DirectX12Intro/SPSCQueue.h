@@ -0,0 +1,73 @@
+#pragma once
+
+// Lock-free single producer / single consumer ring buffer.
+// One thread pushes, one other thread pops, neither ever blocks or takes a lock.
+// Used to hand window events from the message pump to the render thread.
+//
+// Head and tail live on their own cache lines, and each side keeps a cached copy of the other
+// side's index so it only touches the shared one when the queue looks full (or empty).
+
+#include <atomic>
+#include <cstddef>
+
+template<typename T, size_t Capacity>
+class SPSCQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+
+public:
+    // Producer only. Returns false if the queue is full.
+    bool TryPush(const T& item)
+    {
+        size_t tail = m_Tail.load(std::memory_order_relaxed);
+        if (tail - m_HeadCache == Capacity)
+        {
+            m_HeadCache = m_Head.load(std::memory_order_acquire);
+            if (tail - m_HeadCache == Capacity)
+            {
+                return false;
+            }
+        }
+
+        m_Items[tail & (Capacity - 1)] = item;
+        m_Tail.store(tail + 1, std::memory_order_release); // publishes the item
+        return true;
+    }
+
+    // Consumer only. Returns false if the queue is empty.
+    bool TryPop(T& item)
+    {
+        size_t head = m_Head.load(std::memory_order_relaxed);
+        if (head == m_TailCache)
+        {
+            m_TailCache = m_Tail.load(std::memory_order_acquire);
+            if (head == m_TailCache)
+            {
+                return false;
+            }
+        }
+
+        item = m_Items[head & (Capacity - 1)];
+        m_Head.store(head + 1, std::memory_order_release); // hands the slot back to the producer
+        return true;
+    }
+
+    // Only a snapshot when called while the other thread is active
+    size_t Size() const
+    {
+        return m_Tail.load(std::memory_order_acquire) - m_Head.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t GetCapacity() { return Capacity; }
+
+private:
+    // Consumer side
+    alignas(64) std::atomic<size_t> m_Head{ 0 };
+    size_t m_TailCache = 0;
+
+    // Producer side
+    alignas(64) std::atomic<size_t> m_Tail{ 0 };
+    size_t m_HeadCache = 0;
+
+    alignas(64) T m_Items[Capacity];
+};
@@ -0,0 +1,185 @@
+#include "ScaledRenderTarget.h"
+
+#include <d3dcompiler.h>
+
+#include "d3dx12.h"
+#include "GPUMemoryTagging.h"
+#include "Helpers.h"
+#include "ShaderHotReload.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace Microsoft::WRL;
+
+ScaledRenderTarget::ScaledRenderTarget(ComPtr<ID3D12Device2> device, DXGI_FORMAT format, DXGI_FORMAT outputFormat, float maxScale)
+    : m_Device(device)
+    , m_Format(format)
+    , m_OutputFormat(outputFormat)
+    , m_MaxScale(maxScale)
+{
+    // Root signature: the UV constants and the source SRV, with a bilinear clamp sampler baked in
+    CD3DX12_DESCRIPTOR_RANGE source(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+
+    CD3DX12_ROOT_PARAMETER rootParameters[2];
+    rootParameters[0].InitAsConstants(sizeof(UpscaleCB) / 4, 0, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+    rootParameters[1].InitAsDescriptorTable(1, &source, D3D12_SHADER_VISIBILITY_PIXEL);
+
+    CD3DX12_STATIC_SAMPLER_DESC linearClamp(0, D3D12_FILTER_MIN_MAG_MIP_LINEAR,
+        D3D12_TEXTURE_ADDRESS_MODE_CLAMP, D3D12_TEXTURE_ADDRESS_MODE_CLAMP, D3D12_TEXTURE_ADDRESS_MODE_CLAMP);
+
+    CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc(_countof(rootParameters), rootParameters, 1, &linearClamp);
+
+    ComPtr<ID3DBlob> rootSignatureBlob;
+    ComPtr<ID3DBlob> errorBlob;
+    ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &rootSignatureBlob, &errorBlob));
+    ThrowIfFailed(m_Device->CreateRootSignature(0, rootSignatureBlob->GetBufferPointer(),
+        rootSignatureBlob->GetBufferSize(), IID_PPV_ARGS(&m_RootSignature)));
+
+    // Compiled by the FxCompile step of the project, lands next to the executable
+    ComPtr<ID3DBlob> vertexShader;
+    ComPtr<ID3DBlob> pixelShader;
+    ThrowIfFailed(D3DReadFileToBlob(L"Upscale_VS.cso", &vertexShader));
+    ThrowIfFailed(D3DReadFileToBlob(L"Upscale_PS.cso", &pixelShader));
+
+    m_PipelineState = CreatePipelineState(vertexShader.Get(), pixelShader.Get());
+
+    D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
+    rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+    rtvHeapDesc.NumDescriptors = 1;
+    ThrowIfFailed(m_Device->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(&m_RTVHeap)));
+    m_RTVHeap->SetName(L"Scaled render target RTV");
+    GPU_MEMORY_TAG(m_RTVHeap.Get(), "ScaledRenderTarget");
+
+    D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
+    srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+    srvHeapDesc.NumDescriptors = 1;
+    srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+    ThrowIfFailed(m_Device->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&m_SRVHeap)));
+    m_SRVHeap->SetName(L"Scaled render target SRV");
+    GPU_MEMORY_TAG(m_SRVHeap.Get(), "ScaledRenderTarget");
+}
+
+void ScaledRenderTarget::EnableHotReload(ShaderHotReload& hotReload, const std::string& shaderDirectory)
+{
+    // The same entry points and targets as the FxCompile step
+    std::vector<ShaderSource> stages =
+    {
+        { shaderDirectory + "/Upscale_VS.hlsl", "main", "vs_5_1", {} },
+        { shaderDirectory + "/Upscale_PS.hlsl", "main", "ps_5_1", {} },
+    };
+
+    hotReload.AddProgram("Upscale", stages,
+        [this](const std::vector<ComPtr<ID3DBlob>>& blobs)
+        {
+            return CreatePipelineState(blobs[0].Get(), blobs[1].Get());
+        },
+        [this](ComPtr<ID3D12PipelineState> pipelineState)
+        {
+            m_PipelineState.Swap(pipelineState);
+            return pipelineState;
+        });
+}
+
+ComPtr<ID3D12PipelineState> ScaledRenderTarget::CreatePipelineState(ID3DBlob* vertexShader, ID3DBlob* pixelShader) const
+{
+    // No vertex buffer, no depth, no blending
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC pipelineStateDesc = {};
+    pipelineStateDesc.pRootSignature = m_RootSignature.Get();
+    pipelineStateDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader);
+    pipelineStateDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader);
+    pipelineStateDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+    pipelineStateDesc.SampleMask = UINT_MAX;
+    pipelineStateDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+    pipelineStateDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+    pipelineStateDesc.DepthStencilState.DepthEnable = FALSE;
+    pipelineStateDesc.DepthStencilState.StencilEnable = FALSE;
+    pipelineStateDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+    pipelineStateDesc.NumRenderTargets = 1;
+    pipelineStateDesc.RTVFormats[0] = m_OutputFormat;
+    pipelineStateDesc.SampleDesc = { 1, 0 };
+
+    ComPtr<ID3D12PipelineState> pipelineState;
+    ThrowIfFailed(m_Device->CreateGraphicsPipelineState(&pipelineStateDesc, IID_PPV_ARGS(&pipelineState)));
+    pipelineState->SetName(L"Upscale");
+    return pipelineState;
+}
+
+void ScaledRenderTarget::SetOutputSize(uint32_t width, uint32_t height)
+{
+    m_OutputWidth = width;
+    m_OutputHeight = height;
+
+    uint32_t neededWidth = static_cast<uint32_t>(std::ceil(width * m_MaxScale));
+    uint32_t neededHeight = static_cast<uint32_t>(std::ceil(height * m_MaxScale));
+    if (m_Texture && neededWidth <= m_AllocatedWidth && neededHeight <= m_AllocatedHeight)
+    {
+        return;
+    }
+
+    // Grow only, and with some slack
+    m_AllocatedWidth = std::max(m_AllocatedWidth, (neededWidth + SIZE_GRANULARITY - 1) / SIZE_GRANULARITY * SIZE_GRANULARITY);
+    m_AllocatedHeight = std::max(m_AllocatedHeight, (neededHeight + SIZE_GRANULARITY - 1) / SIZE_GRANULARITY * SIZE_GRANULARITY);
+
+    CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+    CD3DX12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(m_Format, m_AllocatedWidth, m_AllocatedHeight,
+        1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
+    m_Texture.Reset();
+    ThrowIfFailed(m_Device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &textureDesc,
+        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, nullptr, IID_PPV_ARGS(&m_Texture)));
+    m_Texture->SetName(L"Scaled render target");
+    GPU_MEMORY_TAG(m_Texture.Get(), "ScaledRenderTarget");
+    ++m_NumAllocations;
+
+    m_Device->CreateRenderTargetView(m_Texture.Get(), nullptr, m_RTVHeap->GetCPUDescriptorHandleForHeapStart());
+    m_Device->CreateShaderResourceView(m_Texture.Get(), nullptr, m_SRVHeap->GetCPUDescriptorHandleForHeapStart());
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE ScaledRenderTarget::Begin(ID3D12GraphicsCommandList* commandList, float scale)
+{
+    assert(m_Texture && "SetOutputSize first");
+
+    scale = std::min(scale, m_MaxScale);
+    m_RenderWidth = std::min(m_AllocatedWidth, std::max(1u, static_cast<uint32_t>(m_OutputWidth * scale + 0.5f)));
+    m_RenderHeight = std::min(m_AllocatedHeight, std::max(1u, static_cast<uint32_t>(m_OutputHeight * scale + 0.5f)));
+
+    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_Texture.Get(),
+        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    commandList->ResourceBarrier(1, &barrier);
+
+    CD3DX12_VIEWPORT viewport(0.0f, 0.0f, static_cast<float>(m_RenderWidth), static_cast<float>(m_RenderHeight));
+    D3D12_RECT scissorRect = GetRenderRect();
+    commandList->RSSetViewports(1, &viewport);
+    commandList->RSSetScissorRects(1, &scissorRect);
+
+    return m_RTVHeap->GetCPUDescriptorHandleForHeapStart();
+}
+
+void ScaledRenderTarget::Upscale(ID3D12GraphicsCommandList* commandList, D3D12_CPU_DESCRIPTOR_HANDLE outputRTV)
+{
+    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_Texture.Get(),
+        D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    commandList->ResourceBarrier(1, &barrier);
+
+    UpscaleCB constants;
+    constants.UVScale[0] = static_cast<float>(m_RenderWidth) / m_AllocatedWidth;
+    constants.UVScale[1] = static_cast<float>(m_RenderHeight) / m_AllocatedHeight;
+    constants.UVMax[0] = (m_RenderWidth - 0.5f) / m_AllocatedWidth;
+    constants.UVMax[1] = (m_RenderHeight - 0.5f) / m_AllocatedHeight;
+
+    commandList->SetGraphicsRootSignature(m_RootSignature.Get());
+    commandList->SetPipelineState(m_PipelineState.Get());
+    ID3D12DescriptorHeap* heaps[] = { m_SRVHeap.Get() };
+    commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+    commandList->SetGraphicsRoot32BitConstants(0, sizeof(UpscaleCB) / 4, &constants, 0);
+    commandList->SetGraphicsRootDescriptorTable(1, m_SRVHeap->GetGPUDescriptorHandleForHeapStart());
+
+    CD3DX12_VIEWPORT viewport(0.0f, 0.0f, static_cast<float>(m_OutputWidth), static_cast<float>(m_OutputHeight));
+    D3D12_RECT scissorRect = { 0, 0, static_cast<LONG>(m_OutputWidth), static_cast<LONG>(m_OutputHeight) };
+    commandList->RSSetViewports(1, &viewport);
+    commandList->RSSetScissorRects(1, &scissorRect);
+    commandList->OMSetRenderTargets(1, &outputRTV, FALSE, nullptr);
+    commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    commandList->DrawInstanced(3, 1, 0, 0);
+}
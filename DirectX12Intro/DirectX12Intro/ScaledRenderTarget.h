@@ -0,0 +1,83 @@
+#pragma once
+
+// Render target for dynamic resolution
+// Allocated once for the output size at the maximum scale, then rendered into through a viewport of
+// whatever size the DynamicResolutionController picked, so changing the scale never creates a resource.
+// Upscale stretches the rendered region over the back buffer with Upscale_VS/PS.hlsl.
+//
+// The allocation is rounded up to SIZE_GRANULARITY, so it only grows when the window does (by a fair bit)
+// and is never shrunk.
+//
+// With EnableHotReload, editing Upscale_VS/PS.hlsl swaps in a new pipeline while running (see ShaderHotReload.h).
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <wrl.h>
+#include <d3d12.h>
+
+#include <cstdint>
+#include <string>
+
+class ShaderHotReload;
+
+class ScaledRenderTarget
+{
+public:
+    // outputFormat is the format of the RTVs Upscale draws into
+    ScaledRenderTarget(Microsoft::WRL::ComPtr<ID3D12Device2> device, DXGI_FORMAT format, DXGI_FORMAT outputFormat,
+        float maxScale = 1.0f);
+
+    // Whenever the output size changes. Only reallocates if the output at maximum scale no longer fits,
+    // in which case the GPU must be done with the target (call it after the resize's fence wait).
+    void SetOutputSize(uint32_t width, uint32_t height);
+
+    // Transitions the target to RENDER_TARGET, sets the viewport and scissor to the scaled size and returns the RTV
+    D3D12_CPU_DESCRIPTOR_HANDLE Begin(ID3D12GraphicsCommandList* commandList, float scale);
+
+    // Transitions the target back to PIXEL_SHADER_RESOURCE and stretches what was rendered over outputRTV
+    // (which must be in RENDER_TARGET state). Binds its own root signature and descriptor heap.
+    void Upscale(ID3D12GraphicsCommandList* commandList, D3D12_CPU_DESCRIPTOR_HANDLE outputRTV);
+
+    // The region of the target the current frame renders to
+    D3D12_RECT GetRenderRect() const { return { 0, 0, static_cast<LONG>(m_RenderWidth), static_cast<LONG>(m_RenderHeight) }; }
+
+    uint32_t GetRenderWidth() const { return m_RenderWidth; }
+    uint32_t GetRenderHeight() const { return m_RenderHeight; }
+    uint32_t GetNumAllocations() const { return m_NumAllocations; }
+
+    // Recompiles the upscale shaders from shaderDirectory when they change. hotReload must be destroyed first.
+    void EnableHotReload(ShaderHotReload& hotReload, const std::string& shaderDirectory);
+
+private:
+    static const uint32_t SIZE_GRANULARITY = 128;
+
+    // Matches UpscaleCB in the pixel shader
+    struct UpscaleCB
+    {
+        float UVScale[2];
+        float UVMax[2];
+    };
+
+    // Called from the hot reload workers too
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> CreatePipelineState(ID3DBlob* vertexShader, ID3DBlob* pixelShader) const;
+
+    Microsoft::WRL::ComPtr<ID3D12Device2> m_Device;
+    Microsoft::WRL::ComPtr<ID3D12RootSignature> m_RootSignature;
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> m_PipelineState;
+    Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_RTVHeap;
+    Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_SRVHeap;
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_Texture;
+
+    DXGI_FORMAT m_Format;
+    DXGI_FORMAT m_OutputFormat;
+    float m_MaxScale;
+
+    uint32_t m_AllocatedWidth = 0;
+    uint32_t m_AllocatedHeight = 0;
+    uint32_t m_OutputWidth = 0;
+    uint32_t m_OutputHeight = 0;
+    uint32_t m_RenderWidth = 0;
+    uint32_t m_RenderHeight = 0;
+    uint32_t m_NumAllocations = 0;
+};
@@ -0,0 +1,116 @@
+#include "ShaderHotReload.h"
+
+#include <stdexcept>
+
+using namespace Microsoft::WRL;
+
+namespace
+{
+    std::wstring ToWide(const std::string& text)
+    {
+        int length = ::MultiByteToWideChar(CP_UTF8, 0, text.c_str(), static_cast<int>(text.size()), nullptr, 0);
+        std::wstring wide(length, L'\0');
+        ::MultiByteToWideChar(CP_UTF8, 0, text.c_str(), static_cast<int>(text.size()), &wide[0], length);
+        return wide;
+    }
+}
+
+ShaderHotReload::ShaderHotReload(uint32_t numThreads, std::vector<std::string> includeDirectories)
+    : m_Pool(numThreads)
+    , m_Reloader(m_Pool, std::move(includeDirectories))
+{
+}
+
+void ShaderHotReload::AddProgram(const std::string& name, const std::vector<ShaderSource>& stages, CreatePipeline create, SwapPipeline swap)
+{
+    std::vector<std::string> files;
+    for (const ShaderSource& stage : stages)
+    {
+        files.push_back(stage.File);
+    }
+
+    m_Reloader.AddProgram(name, files, [this, stages, create, swap]() -> ShaderReloadApply
+    {
+        std::vector<ComPtr<ID3DBlob>> blobs;
+        for (const ShaderSource& stage : stages)
+        {
+            blobs.push_back(Compile(stage));
+        }
+
+        ComPtr<ID3D12PipelineState> pipelineState = create(blobs);
+        if (!pipelineState)
+        {
+            throw std::runtime_error("creating the pipeline state failed");
+        }
+
+        return [this, swap, pipelineState]()
+        {
+            m_Swapped.push_back(swap(pipelineState));
+        };
+    });
+}
+
+void ShaderHotReload::Update(uint64_t completedFenceValue)
+{
+    while (!m_Retired.empty() && m_Retired.front().first <= completedFenceValue)
+    {
+        m_Retired.pop_front();
+    }
+
+    for (const ShaderReloadEvent& event : m_Reloader.Update())
+    {
+        char buffer[512];
+        if (event.Succeeded)
+        {
+            sprintf_s(buffer, "Shader reload: %s in %.1f ms (compile %.1f ms)\n",
+                event.Program.c_str(), event.LatencyMs, event.CompileMs);
+            ::OutputDebugStringA(buffer);
+        }
+        else
+        {
+            // The compiler's messages can be long, they go out separately
+            sprintf_s(buffer, "Shader reload: %s failed, keeping the old one\n", event.Program.c_str());
+            ::OutputDebugStringA(buffer);
+            ::OutputDebugStringA((event.Error + "\n").c_str());
+        }
+    }
+}
+
+void ShaderHotReload::FinishFrame(uint64_t fenceValue)
+{
+    // The frames before this one may have recorded the old pipelines, this frame's fence covers them all
+    for (ComPtr<ID3D12PipelineState>& pipelineState : m_Swapped)
+    {
+        m_Retired.emplace_back(fenceValue, std::move(pipelineState));
+    }
+    m_Swapped.clear();
+}
+
+ComPtr<ID3DBlob> ShaderHotReload::Compile(const ShaderSource& source)
+{
+    std::vector<D3D_SHADER_MACRO> macros;
+    for (const auto& define : source.Defines)
+    {
+        macros.push_back({ define.first.c_str(), define.second.c_str() });
+    }
+    macros.push_back({ nullptr, nullptr });
+
+    UINT flags = D3DCOMPILE_ENABLE_STRICTNESS;
+#if defined(_DEBUG)
+    flags |= D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#endif
+
+    ComPtr<ID3DBlob> shader;
+    ComPtr<ID3DBlob> errors;
+    HRESULT hr = ::D3DCompileFromFile(ToWide(source.File).c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE,
+        source.EntryPoint.c_str(), source.Target.c_str(), flags, 0, &shader, &errors);
+    if (FAILED(hr))
+    {
+        // A file that's still being written (or locked by the editor) fails here too, the write that finishes it
+        // triggers another compile
+        std::string message = errors ? std::string(static_cast<const char*>(errors->GetBufferPointer()), errors->GetBufferSize())
+            : source.File + ": D3DCompileFromFile failed with " + std::to_string(hr);
+        throw std::runtime_error(message);
+    }
+    return shader;
+}
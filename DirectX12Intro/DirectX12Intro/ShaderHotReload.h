@@ -0,0 +1,76 @@
+#pragma once
+
+// Shader hot reload for D3D12 pipelines (see ShaderReloader.h for how changes are found and compiles scheduled)
+//
+//   hotReload.AddProgram("Upscale", { vs, ps },
+//       [](const std::vector<ComPtr<ID3DBlob>>& stages) { return CreatePipelineState(stages[0], stages[1]); }, // worker
+//       [](ComPtr<ID3D12PipelineState> pso) { std::swap(m_PipelineState, pso); return pso; });           // frame start
+//   hotReload.Watch();
+//   ...
+//   hotReload.Update(fence->GetCompletedValue()); // start of every frame, before anything is recorded
+//   ... record, execute, signal fenceValue ...
+//   hotReload.FinishFrame(fenceValue);
+//
+// Both the compile and the pipeline creation run on the workers, so the frame only pays for the swap. The pipeline
+// swapped out may still be used by the frames in flight: it's kept until the fence of the frame that swapped it
+// completes. A compile error keeps the old pipeline, the error goes to the debug output.
+//
+// Compiles with D3DCompileFromFile, which is FXC: shader model 5.1 at most. The mesh shaders (6.5) need DXC and
+// aren't reloadable.
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <wrl.h>
+#include <d3d12.h>
+#include <d3dcompiler.h>
+
+#include "ShaderReloader.h"
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct ShaderSource
+{
+    std::string File;       // as the working directory sees it, "Shaders/Upscale_PS.hlsl"
+    std::string EntryPoint;
+    std::string Target;     // vs_5_1, ps_5_1, cs_5_1
+    std::vector<std::pair<std::string, std::string>> Defines; // the permutation
+};
+
+class ShaderHotReload
+{
+public:
+    using CreatePipeline = std::function<Microsoft::WRL::ComPtr<ID3D12PipelineState>(
+        const std::vector<Microsoft::WRL::ComPtr<ID3DBlob>>& stages)>;
+    using SwapPipeline = std::function<Microsoft::WRL::ComPtr<ID3D12PipelineState>(
+        Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState)>; // returns the old one
+
+    // 0 threads = one per hardware thread
+    explicit ShaderHotReload(uint32_t numThreads, std::vector<std::string> includeDirectories = {});
+
+    // create gets the stages compiled in the order given, on a worker thread. swap runs in Update.
+    void AddProgram(const std::string& name, const std::vector<ShaderSource>& stages, CreatePipeline create, SwapPipeline swap);
+
+    void Watch() { m_Reloader.Watch(); }
+
+    void Update(uint64_t completedFenceValue);
+    void FinishFrame(uint64_t fenceValue);
+
+    ShaderReloadStats GetStats() const { return m_Reloader.GetStats(); }
+
+    // Throws std::runtime_error with the compiler's messages
+    static Microsoft::WRL::ComPtr<ID3DBlob> Compile(const ShaderSource& source);
+
+private:
+    ThreadPool m_Pool;
+    ShaderReloader m_Reloader; // after m_Pool, so it's gone (and its compiles done) first
+
+    std::vector<Microsoft::WRL::ComPtr<ID3D12PipelineState>> m_Swapped; // swapped out this frame
+    std::deque<std::pair<uint64_t, Microsoft::WRL::ComPtr<ID3D12PipelineState>>> m_Retired; // by fence value
+};
@@ -0,0 +1,245 @@
+#include "ShaderIncludeGraph.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+namespace
+{
+    std::string GetDirectory(const std::string& file)
+    {
+        std::string directory = std::filesystem::path(file).parent_path().generic_string();
+        return directory.empty() ? "." : directory;
+    }
+
+    bool FileExists(const std::string& path)
+    {
+        std::error_code error;
+        return std::filesystem::is_regular_file(path, error);
+    }
+}
+
+ShaderIncludeGraph::ShaderIncludeGraph(std::vector<std::string> includeDirectories)
+    : m_IncludeDirectories(std::move(includeDirectories))
+{
+}
+
+void ShaderIncludeGraph::Scan(const std::string& file)
+{
+    std::string path = Normalize(file);
+
+    std::string source;
+    std::ifstream in(path, std::ios::binary);
+    if (in)
+    {
+        source.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    std::vector<std::string> includes;
+    for (const std::string& include : ParseIncludes(source))
+    {
+        std::string resolved = Resolve(include, path);
+        if (std::find(includes.begin(), includes.end(), resolved) == includes.end())
+        {
+            includes.push_back(resolved);
+        }
+    }
+
+    // std::map nodes don't move, node stays valid while others are added
+    Node& node = m_Files[path];
+    for (const std::string& include : node.Includes)
+    {
+        m_Files[include].IncludedBy.erase(path);
+    }
+    node.Includes = includes;
+
+    // Added to the graph before they're scanned, so include cycles end here
+    std::vector<std::string> unseen;
+    for (const std::string& include : includes)
+    {
+        if (!Contains(include))
+        {
+            unseen.push_back(include);
+        }
+        m_Files[include].IncludedBy.insert(path);
+    }
+    for (const std::string& include : unseen)
+    {
+        Scan(include);
+    }
+}
+
+std::vector<std::string> ShaderIncludeGraph::OnFileChanged(const std::string& file)
+{
+    std::string path = Normalize(file);
+    if (!Contains(path))
+    {
+        return {};
+    }
+    Scan(path);
+    return GetDependents(path);
+}
+
+bool ShaderIncludeGraph::Contains(const std::string& file) const
+{
+    return m_Files.find(Normalize(file)) != m_Files.end();
+}
+
+std::vector<std::string> ShaderIncludeGraph::GetIncludes(const std::string& file) const
+{
+    auto it = m_Files.find(Normalize(file));
+    return it != m_Files.end() ? it->second.Includes : std::vector<std::string>();
+}
+
+std::vector<std::string> ShaderIncludeGraph::GetDependents(const std::string& file) const
+{
+    std::string path = Normalize(file);
+    if (!Contains(path))
+    {
+        return {};
+    }
+
+    std::set<std::string> dependents = { path };
+    std::vector<std::string> stack = { path };
+    while (!stack.empty())
+    {
+        std::string current = stack.back();
+        stack.pop_back();
+        for (const std::string& includer : m_Files.at(current).IncludedBy)
+        {
+            if (dependents.insert(includer).second)
+            {
+                stack.push_back(includer);
+            }
+        }
+    }
+    return std::vector<std::string>(dependents.begin(), dependents.end());
+}
+
+std::vector<std::string> ShaderIncludeGraph::GetFiles() const
+{
+    std::vector<std::string> files;
+    for (const auto& file : m_Files)
+    {
+        files.push_back(file.first);
+    }
+    return files;
+}
+
+std::vector<std::string> ShaderIncludeGraph::GetDirectories() const
+{
+    std::set<std::string> directories;
+    for (const auto& file : m_Files)
+    {
+        directories.insert(GetDirectory(file.first));
+    }
+    return std::vector<std::string>(directories.begin(), directories.end());
+}
+
+std::vector<std::string> ShaderIncludeGraph::GetFilesIn(const std::string& directory) const
+{
+    std::string path = Normalize(directory);
+    std::vector<std::string> files;
+    for (const auto& file : m_Files)
+    {
+        if (GetDirectory(file.first) == path)
+        {
+            files.push_back(file.first);
+        }
+    }
+    return files;
+}
+
+std::string ShaderIncludeGraph::Normalize(const std::string& path)
+{
+    std::string slashes = path;
+    std::replace(slashes.begin(), slashes.end(), '\\', '/');
+    return std::filesystem::path(slashes).lexically_normal().generic_string();
+}
+
+std::vector<std::string> ShaderIncludeGraph::ParseIncludes(const std::string& source)
+{
+    // Comments out first, keeping the newlines so every directive is still at the start of its line
+    std::string code;
+    code.reserve(source.size());
+    size_t i = 0;
+    while (i < source.size())
+    {
+        if (source.compare(i, 2, "//") == 0)
+        {
+            i = std::min(source.find('\n', i), source.size());
+        }
+        else if (source.compare(i, 2, "/*") == 0)
+        {
+            size_t end = source.find("*/", i + 2);
+            end = end == std::string::npos ? source.size() : end + 2;
+            code.append(std::count(source.begin() + i, source.begin() + end, '\n'), '\n');
+            code += ' ';
+            i = end;
+        }
+        else
+        {
+            code += source[i++];
+        }
+    }
+
+    std::vector<std::string> includes;
+    std::istringstream lines(code);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        // # include "file" and #include <file>, spaces allowed around the #
+        size_t position = line.find_first_not_of(" \t");
+        if (position == std::string::npos || line[position] != '#')
+        {
+            continue;
+        }
+        position = line.find_first_not_of(" \t", position + 1);
+        if (position == std::string::npos || line.compare(position, 7, "include") != 0)
+        {
+            continue;
+        }
+        position = line.find_first_not_of(" \t", position + 7);
+        if (position == std::string::npos || (line[position] != '"' && line[position] != '<'))
+        {
+            continue;
+        }
+
+        bool angled = line[position] == '<';
+        size_t end = line.find(angled ? '>' : '"', position + 1);
+        if (end != std::string::npos && end > position + 1)
+        {
+            includes.push_back((angled ? "<" : "") + line.substr(position + 1, end - position - 1));
+        }
+    }
+    return includes;
+}
+
+std::string ShaderIncludeGraph::Resolve(const std::string& include, const std::string& from) const
+{
+    bool angled = include[0] == '<';
+    std::string name = angled ? include.substr(1) : include;
+
+    std::vector<std::string> candidates;
+    if (!angled)
+    {
+        candidates.push_back(GetDirectory(from) + "/" + name);
+    }
+    for (const std::string& directory : m_IncludeDirectories)
+    {
+        candidates.push_back(directory + "/" + name);
+    }
+
+    for (const std::string& candidate : candidates)
+    {
+        if (FileExists(candidate))
+        {
+            return Normalize(candidate);
+        }
+    }
+
+    // Not there (yet): where it would be found first
+    return Normalize(candidates.empty() ? name : candidates[0]);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+// Which shader files include which, for hot reload: when a file changes, every shader including it (directly or
+// through other includes) has to be recompiled, and nothing else.
+//
+//   ShaderIncludeGraph graph({ "Shaders/Common" });
+//   graph.Scan("Shaders/Upscale_PS.hlsl");                       // and everything it includes
+//   ...
+//   for (const std::string& file : graph.OnFileChanged(changed)) // changed itself and whatever includes it
+//
+// Includes are found the way the compilers look for them: "quoted" ones next to the including file first, then in
+// the include directories, <angled> ones only in the include directories. Every #include counts, whether the
+// preprocessor would take its branch or not (better a compile too many than a stale shader), but commented out ones
+// don't. An include that isn't there is still an edge, so creating the file later triggers a reload.
+// Paths are compared after lexical normalization (see Normalize), so the same file reached two ways is one node.
+// Only uses the STL.
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class ShaderIncludeGraph
+{
+public:
+    explicit ShaderIncludeGraph(std::vector<std::string> includeDirectories = {});
+
+    // Reads file and, the first time they're seen, everything it includes. Scanning a file that's already in the graph
+    // again picks up includes added or removed since. A file that can't be read is kept, with no includes.
+    void Scan(const std::string& file);
+
+    // For a file in the graph: rescans it and returns it and every file including it, sorted. Empty for other files.
+    std::vector<std::string> OnFileChanged(const std::string& file);
+
+    bool Contains(const std::string& file) const;
+    std::vector<std::string> GetIncludes(const std::string& file) const;   // direct ones
+    std::vector<std::string> GetDependents(const std::string& file) const; // the file and everything including it
+    std::vector<std::string> GetFiles() const;
+    std::vector<std::string> GetDirectories() const; // of every file in the graph, what to watch
+    std::vector<std::string> GetFilesIn(const std::string& directory) const;
+
+    // "Shaders\Common/../Upscale_PS.hlsl" -> "Shaders/Upscale_PS.hlsl"
+    static std::string Normalize(const std::string& path);
+
+    // The targets of the #include directives in HLSL source, with '<' in front of the angled ones
+    static std::vector<std::string> ParseIncludes(const std::string& source);
+
+private:
+    struct Node
+    {
+        std::vector<std::string> Includes;
+        std::set<std::string> IncludedBy;
+    };
+
+    std::string Resolve(const std::string& include, const std::string& from) const;
+
+    std::vector<std::string> m_IncludeDirectories;
+    std::map<std::string, Node> m_Files;
+};
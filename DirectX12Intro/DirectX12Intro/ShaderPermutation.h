@@ -0,0 +1,311 @@
+#pragma once
+
+// Shader permutations described at compile time, instead of strings of defines looked up at runtime
+//
+//   enum class UpscaleFilter : uint32_t { Bilinear, Bicubic, Lanczos, Count };
+//   struct Filter : ShaderFeatureEnum<UpscaleFilter> { static constexpr const char* DEFINE = "UPSCALE_FILTER"; };
+//   struct Sharpen : ShaderFeatureBit { static constexpr const char* DEFINE = "UPSCALE_SHARPEN"; };
+//
+//   struct UpscaleShader : ShaderPermutationSpace<UpscaleShader, Filter, Sharpen>
+//   {
+//       // Optional, every combination is valid if it's left out
+//       static constexpr bool IsValid(Key key) { return !key.Get<Sharpen>() || key.Get<Filter>() == UpscaleFilter::Lanczos; }
+//   };
+//
+//   constexpr auto key = MakeShaderKey<UpscaleShader, UpscaleFilter::Lanczos, true>(); // doesn't compile if ruled out
+//   auto key = UpscaleShader::MakeKey(filter, sharpen);                                // at runtime
+//   ShaderPermutationTable<UpscaleShader, ComPtr<ID3D12PipelineState>> pipelines;     // a slot per key
+//   for (const ShaderPermutation& permutation : GetShaderPermutations<UpscaleShader>()) // the valid ones, to compile
+//
+// A key is the features' values as one mixed radix number: each value times the product of the value counts of the
+// features before it. The keys of a space are exactly 0..COUNT-1, so the table is an array indexed by the key, no
+// hashing or string compares. Keys are typed by their program, a key of one program doesn't fit another's table.
+// Features are defined as NAME=value: bools as 0/1, enums as their integer value (the HLSL compares against numbers),
+// in the form ShaderSource::Defines takes, so a permutation can be hot reloaded too (see ShaderHotReload.h).
+// Only uses the STL. RuntimeBench permutations checks it.
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// More than this many permutations of one program is a build nobody wants to wait for
+const uint32_t MAX_SHADER_PERMUTATIONS = 1 << 16;
+
+// An on/off feature
+struct ShaderFeatureBit
+{
+    using Type = bool;
+    static constexpr uint32_t COUNT = 2;
+};
+
+// A feature with one of several values, Enum's last enumerator must be Count
+template<typename Enum>
+struct ShaderFeatureEnum
+{
+    static_assert(std::is_enum<Enum>::value, "ShaderFeatureEnum takes an enum");
+
+    using Type = Enum;
+    static constexpr uint32_t COUNT = static_cast<uint32_t>(Enum::Count);
+
+    static_assert(COUNT >= 2, "An enum feature needs at least two values before Count");
+};
+
+namespace ShaderPermutationDetail
+{
+    // Position of Feature in Features, or the number of features if it isn't there
+    template<typename Feature, typename... Features>
+    constexpr uint32_t IndexOf()
+    {
+        constexpr bool matches[] = { std::is_same<Feature, Features>::value..., false };
+        for (uint32_t i = 0; i < sizeof...(Features); ++i)
+        {
+            if (matches[i])
+            {
+                return i;
+            }
+        }
+        return sizeof...(Features);
+    }
+
+    template<typename Feature, typename... Features>
+    constexpr uint32_t CountOf()
+    {
+        return (static_cast<uint32_t>(std::is_same<Feature, Features>::value) + ... + 0u);
+    }
+}
+
+// Program derives from this with itself as the first argument (so its keys are its own type), and may hide IsValid
+template<typename Program, typename... Features>
+class ShaderPermutationSpace
+{
+    static constexpr uint64_t COUNT64 = (static_cast<uint64_t>(Features::COUNT) * ... * 1ull);
+
+    static_assert(sizeof...(Features) > 0, "A permutation space needs at least one feature");
+    static_assert(((ShaderPermutationDetail::CountOf<Features, Features...>() == 1) && ...), "A feature is listed twice");
+    static_assert(COUNT64 <= MAX_SHADER_PERMUTATIONS, "Too many permutations, split the program or drop a feature");
+
+public:
+    static constexpr uint32_t NUM_FEATURES = sizeof...(Features);
+    static constexpr uint32_t COUNT = static_cast<uint32_t>(COUNT64);
+
+    // What multiplies Feature's value in a key
+    template<typename Feature>
+    static constexpr uint32_t GetStride()
+    {
+        constexpr uint32_t index = ShaderPermutationDetail::IndexOf<Feature, Features...>();
+        static_assert(index < NUM_FEATURES, "The feature isn't part of this program");
+
+        constexpr uint32_t counts[] = { Features::COUNT... };
+        uint32_t stride = 1;
+        for (uint32_t i = 0; i < index; ++i)
+        {
+            stride *= counts[i];
+        }
+        return stride;
+    }
+
+    class Key
+    {
+    public:
+        constexpr Key() = default; // every feature at its first value (off)
+
+        template<typename Feature>
+        constexpr typename Feature::Type Get() const
+        {
+            uint32_t value = m_Index / GetStride<Feature>() % Feature::COUNT;
+            return static_cast<typename Feature::Type>(value);
+        }
+
+        // A copy with Feature set to value. Throws std::out_of_range for enum values past the last.
+        template<typename Feature>
+        constexpr Key With(typename Feature::Type value) const
+        {
+            uint32_t number = static_cast<uint32_t>(value);
+            if (number >= Feature::COUNT)
+            {
+                throw std::out_of_range("Shader feature value out of range");
+            }
+            Key key;
+            key.m_Index = m_Index - static_cast<uint32_t>(Get<Feature>()) * GetStride<Feature>() + number * GetStride<Feature>();
+            return key;
+        }
+
+        constexpr uint32_t GetIndex() const { return m_Index; }
+
+        // Throws std::out_of_range if index isn't below COUNT
+        static constexpr Key FromIndex(uint32_t index)
+        {
+            if (index >= COUNT)
+            {
+                throw std::out_of_range("Shader permutation index out of range");
+            }
+            Key key;
+            key.m_Index = index;
+            return key;
+        }
+
+        constexpr bool operator==(Key other) const { return m_Index == other.m_Index; }
+        constexpr bool operator!=(Key other) const { return m_Index != other.m_Index; }
+
+    private:
+        uint32_t m_Index = 0;
+    };
+
+    // One value per feature, in the order they're listed. Throws std::out_of_range for enum values past the last
+    // (a compile error in a constant expression). Doesn't check IsValid, MakeShaderKey does that at compile time.
+    static constexpr Key MakeKey(typename Features::Type... values)
+    {
+        Key key;
+        ((key = key.template With<Features>(values)), ...);
+        return key;
+    }
+
+    // Every combination is possible unless Program says otherwise
+    static constexpr bool IsValid(Key)
+    {
+        return true;
+    }
+
+    // Whether values are one per feature, of their types
+    template<typename... Types>
+    static constexpr bool HasTypes()
+    {
+        return std::is_same<std::tuple<Types...>, std::tuple<typename Features::Type...>>::value;
+    }
+
+    static constexpr bool IsInRange(typename Features::Type... values)
+    {
+        return ((static_cast<uint32_t>(values) < Features::COUNT) && ...);
+    }
+
+    static constexpr uint32_t CountValid()
+    {
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < COUNT; ++i)
+        {
+            count += Program::IsValid(Key::FromIndex(i)) ? 1 : 0;
+        }
+        return count;
+    }
+
+    // NAME=value of every feature, for the compiler
+    static std::vector<std::pair<std::string, std::string>> GetDefines(Key key)
+    {
+        return { { Features::DEFINE, std::to_string(static_cast<uint32_t>(key.template Get<Features>())) }... };
+    }
+};
+
+// Whether MakeShaderKey<Program, Values...> compiles
+template<typename Program, auto... Values>
+constexpr bool IsValidShaderKey()
+{
+    if constexpr (!Program::template HasTypes<decltype(Values)...>())
+    {
+        return false;
+    }
+    else
+    {
+        return Program::IsInRange(Values...) && Program::IsValid(Program::MakeKey(Values...));
+    }
+}
+
+// The key of a permutation known at compile time, rejected at compile time if it can't exist
+template<typename Program, auto... Values>
+constexpr typename Program::Key MakeShaderKey()
+{
+    static_assert(Program::template HasTypes<decltype(Values)...>(), "One value per feature, in order, of the feature's type");
+    static_assert(IsValidShaderKey<Program, Values...>(), "Value out of range, or a combination the program's IsValid rules out");
+    return Program::MakeKey(Values...);
+}
+
+// What the offline compile needs for one permutation
+struct ShaderPermutation
+{
+    uint32_t Index; // the key's
+    std::vector<std::pair<std::string, std::string>> Defines;
+};
+
+// The valid permutations, by index
+template<typename Program>
+std::vector<ShaderPermutation> GetShaderPermutations()
+{
+    static_assert(Program::CountValid() > 0, "IsValid rules out every permutation");
+
+    std::vector<ShaderPermutation> permutations;
+    permutations.reserve(Program::CountValid());
+    for (uint32_t i = 0; i < Program::COUNT; ++i)
+    {
+        typename Program::Key key = Program::Key::FromIndex(i);
+        if (Program::IsValid(key))
+        {
+            permutations.push_back({ i, Program::GetDefines(key) });
+        }
+    }
+    return permutations;
+}
+
+// Where the offline compile writes a permutation and the runtime loads it from: "Upscale_PS" -> "Upscale_PS_5.cso"
+inline std::string GetShaderPermutationFile(const std::string& shader, uint32_t index)
+{
+    return shader + "_" + std::to_string(index) + ".cso";
+}
+
+// Something (bytecode, a pipeline state) for each permutation of Program, found by key in O(1)
+template<typename Program, typename T>
+class ShaderPermutationTable
+{
+public:
+    using Key = typename Program::Key;
+
+    ShaderPermutationTable()
+        : m_Entries(Program::COUNT)
+        , m_Present(Program::COUNT, 0)
+    {
+    }
+
+    // Throws std::invalid_argument for a key the program rules out
+    void Set(Key key, T value)
+    {
+        if (!Program::IsValid(key))
+        {
+            throw std::invalid_argument("Shader permutation " + std::to_string(key.GetIndex()) + " is ruled out");
+        }
+        m_Entries[key.GetIndex()] = std::move(value);
+        m_Size += m_Present[key.GetIndex()] ? 0 : 1;
+        m_Present[key.GetIndex()] = 1;
+    }
+
+    // nullptr if it wasn't set
+    const T* Find(Key key) const
+    {
+        return m_Present[key.GetIndex()] ? &m_Entries[key.GetIndex()] : nullptr;
+    }
+
+    T* Find(Key key)
+    {
+        return m_Present[key.GetIndex()] ? &m_Entries[key.GetIndex()] : nullptr;
+    }
+
+    // Throws std::out_of_range if it wasn't set
+    const T& Get(Key key) const
+    {
+        const T* entry = Find(key);
+        if (!entry)
+        {
+            throw std::out_of_range("Shader permutation " + std::to_string(key.GetIndex()) + " isn't loaded");
+        }
+        return *entry;
+    }
+
+    bool Contains(Key key) const { return m_Present[key.GetIndex()] != 0; }
+    uint32_t GetSize() const { return m_Size; } // how many are set
+
+private:
+    std::vector<T> m_Entries;
+    std::vector<uint8_t> m_Present;
+    uint32_t m_Size = 0;
+};
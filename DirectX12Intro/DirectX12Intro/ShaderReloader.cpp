@@ -0,0 +1,226 @@
+#include "ShaderReloader.h"
+
+#include <algorithm>
+#include <exception>
+#include <set>
+#include <stdexcept>
+
+ShaderReloader::ShaderReloader(ThreadPool& pool, std::vector<std::string> includeDirectories)
+    : m_Pool(pool)
+    , m_Graph(std::move(includeDirectories))
+{
+}
+
+ShaderReloader::~ShaderReloader()
+{
+    // The workers still running reference us
+    WaitForCompiles();
+}
+
+uint32_t ShaderReloader::AddProgram(const std::string& name, const std::vector<std::string>& sources, ShaderReloadCompile compile)
+{
+    Program program;
+    program.Name = name;
+    program.Compile = std::move(compile);
+    for (const std::string& source : sources)
+    {
+        program.Sources.push_back(ShaderIncludeGraph::Normalize(source));
+        m_Graph.Scan(source);
+    }
+    m_Programs.push_back(std::move(program));
+    return static_cast<uint32_t>(m_Programs.size() - 1);
+}
+
+void ShaderReloader::Watch()
+{
+    m_Watcher = std::make_unique<FileWatcher>();
+    WatchNewDirectories();
+}
+
+void ShaderReloader::OnFilesChanged(const std::vector<std::string>& files)
+{
+    Clock::time_point now = Clock::now();
+
+    std::set<std::string> affected;
+    for (const std::string& file : files)
+    {
+        std::string path = ShaderIncludeGraph::Normalize(file);
+
+        // The watcher lost this directory's changes, any file of ours in it may have changed
+        std::vector<std::string> changed = { path };
+        if (std::find(m_WatchedDirectories.begin(), m_WatchedDirectories.end(), path) != m_WatchedDirectories.end())
+        {
+            changed = m_Graph.GetFilesIn(path);
+        }
+
+        for (const std::string& changedFile : changed)
+        {
+            for (const std::string& dependent : m_Graph.OnFileChanged(changedFile))
+            {
+                affected.insert(dependent);
+            }
+        }
+    }
+
+    for (Program& program : m_Programs)
+    {
+        bool changed = std::any_of(program.Sources.begin(), program.Sources.end(),
+            [&](const std::string& source) { return affected.count(source) != 0; });
+        if (changed)
+        {
+            if (program.Requested == program.Handled)
+            {
+                program.ChangedAt = now;
+            }
+            ++program.Requested;
+        }
+    }
+}
+
+std::vector<ShaderReloadEvent> ShaderReloader::Update()
+{
+    if (m_Watcher)
+    {
+        std::vector<std::string> changed = m_Watcher->Poll();
+        if (!changed.empty())
+        {
+            OnFilesChanged(changed);
+            WatchNewDirectories(); // a rescan may have found includes somewhere new
+        }
+    }
+
+    std::vector<Finished> finished;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        finished.swap(m_Finished);
+    }
+
+    std::vector<ShaderReloadEvent> events;
+    for (Finished& result : finished)
+    {
+        Program& program = m_Programs[result.Program];
+        program.Compiling = false;
+        if (result.Generation != program.Requested)
+        {
+            ++m_Stats.Discarded; // stale, compiled again below
+            continue;
+        }
+
+        ShaderReloadEvent event = { program.Name, result.Apply != nullptr, result.Error, 0.0, result.CompileMs };
+        if (event.Succeeded)
+        {
+            try
+            {
+                result.Apply();
+            }
+            catch (const std::exception& e)
+            {
+                event.Succeeded = false;
+                event.Error = e.what();
+            }
+        }
+        event.LatencyMs = std::chrono::duration<double, std::milli>(Clock::now() - program.ChangedAt).count();
+        program.Handled = result.Generation;
+
+        ++(event.Succeeded ? m_Stats.Reloads : m_Stats.Failed);
+        m_Stats.MaxLatencyMs = std::max(m_Stats.MaxLatencyMs, event.LatencyMs);
+        m_TotalLatencyMs += event.LatencyMs;
+        m_TotalCompileMs += event.CompileMs;
+        events.push_back(std::move(event));
+    }
+
+    for (uint32_t id = 0; id < m_Programs.size(); ++id)
+    {
+        if (!m_Programs[id].Compiling && m_Programs[id].Requested != m_Programs[id].Handled)
+        {
+            StartCompile(id);
+        }
+    }
+    return events;
+}
+
+void ShaderReloader::WaitForCompiles()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Idle.wait(lock, [this]() { return m_InFlight == 0; });
+}
+
+bool ShaderReloader::IsIdle() const
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_InFlight > 0 || !m_Finished.empty())
+        {
+            return false;
+        }
+    }
+    return std::all_of(m_Programs.begin(), m_Programs.end(),
+        [](const Program& program) { return program.Requested == program.Handled; });
+}
+
+ShaderReloadStats ShaderReloader::GetStats() const
+{
+    ShaderReloadStats stats = m_Stats;
+    uint64_t handled = stats.Reloads + stats.Failed;
+    stats.AverageLatencyMs = handled ? m_TotalLatencyMs / handled : 0.0;
+    stats.AverageCompileMs = handled ? m_TotalCompileMs / handled : 0.0;
+    return stats;
+}
+
+void ShaderReloader::StartCompile(uint32_t id)
+{
+    Program& program = m_Programs[id];
+    program.Compiling = true;
+    uint64_t generation = program.Requested;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        ++m_InFlight;
+    }
+
+    // The function is copied, m_Programs may grow while this runs
+    m_Pool.Enqueue([this, id, generation, compile = program.Compile]()
+    {
+        Finished result = { id, generation, nullptr, std::string(), 0.0 };
+        Clock::time_point start = Clock::now();
+        try
+        {
+            result.Apply = compile();
+            if (!result.Apply)
+            {
+                result.Error = "the compile returned nothing to swap in";
+            }
+        }
+        catch (const std::exception& e)
+        {
+            result.Apply = nullptr;
+            result.Error = e.what();
+        }
+        result.CompileMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Finished.push_back(std::move(result));
+        --m_InFlight;
+        m_Idle.notify_all();
+    });
+}
+
+void ShaderReloader::WatchNewDirectories()
+{
+    for (const std::string& directory : m_Graph.GetDirectories())
+    {
+        if (std::find(m_WatchedDirectories.begin(), m_WatchedDirectories.end(), directory) != m_WatchedDirectories.end())
+        {
+            continue;
+        }
+
+        // Remembered either way: an include directory that doesn't exist isn't retried on every change
+        m_WatchedDirectories.push_back(directory);
+        try
+        {
+            m_Watcher->AddDirectory(directory);
+        }
+        catch (const std::runtime_error&)
+        {
+        }
+    }
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+// Shader hot reload: recompiles the programs whose sources (or anything they include) changed on disk, on worker
+// threads, and swaps them in at a frame boundary
+//
+//   ShaderReloader reloader(pool);
+//   reloader.AddProgram("Upscale", { "Shaders/Upscale_VS.hlsl", "Shaders/Upscale_PS.hlsl" }, []()
+//   {
+//       PipelineState pso = CompileAndCreate(...); // on a worker, throw to keep the old one
+//       return [pso]() { Swap(pso); };             // at the frame boundary
+//   });
+//   reloader.Watch();
+//   ...
+//   for (const ShaderReloadEvent& event : reloader.Update()) // start of every frame, never waits on a compile
+//
+// A program is one permutation: the same file compiled with other defines is another program, and only the ones
+// whose files changed are rebuilt. A program changing again while it compiles is compiled once more afterwards, and
+// the result in flight is thrown away rather than swapped in. Latency is measured from the first change noticed to
+// the swap, so it includes the compile and the wait for the next frame.
+// ShaderHotReload.h does the D3D12 side. RuntimeBench shaderreload checks it.
+// Only uses the STL.
+
+#include "FileWatcher.h"
+#include "ShaderIncludeGraph.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using ShaderReloadApply = std::function<void()>;
+using ShaderReloadCompile = std::function<ShaderReloadApply()>;
+
+struct ShaderReloadEvent
+{
+    std::string Program;
+    bool Succeeded;
+    std::string Error;  // what the compile threw
+    double LatencyMs;   // first change noticed to swapped in (or failed)
+    double CompileMs;
+};
+
+struct ShaderReloadStats
+{
+    uint64_t Reloads;
+    uint64_t Failed;
+    uint64_t Discarded; // compiles whose sources changed again while they ran
+    double AverageLatencyMs;
+    double MaxLatencyMs;
+    double AverageCompileMs;
+};
+
+class ShaderReloader
+{
+public:
+    // Compiles run on pool, which must outlive the reloader
+    explicit ShaderReloader(ThreadPool& pool, std::vector<std::string> includeDirectories = {});
+    ~ShaderReloader(); // waits for the compiles in flight, their results are dropped
+
+    ShaderReloader(const ShaderReloader&) = delete;
+    ShaderReloader& operator=(const ShaderReloader&) = delete;
+
+    // Nothing is compiled now, the program is already built from these sources
+    uint32_t AddProgram(const std::string& name, const std::vector<std::string>& sources, ShaderReloadCompile compile);
+
+    // Starts watching the directories of every file in the include graph (Update adds new ones as they turn up)
+    void Watch();
+
+    // What Update does with the watcher's changes, for changes found some other way
+    void OnFilesChanged(const std::vector<std::string>& files);
+
+    // Picks up changes, starts the compiles they need and swaps in the finished ones (on the calling thread)
+    std::vector<ShaderReloadEvent> Update();
+
+    // Blocks until no compile is running, for shutdown and tests. Their results are swapped in by the next Update.
+    void WaitForCompiles();
+
+    bool IsIdle() const; // nothing changed that isn't swapped in (or failed) yet
+    ShaderReloadStats GetStats() const;
+    const ShaderIncludeGraph& GetIncludeGraph() const { return m_Graph; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Program
+    {
+        std::string Name;
+        std::vector<std::string> Sources;
+        ShaderReloadCompile Compile;
+        uint64_t Requested = 0; // bumped on every change
+        uint64_t Handled = 0;   // the last one swapped in or failed
+        bool Compiling = false;
+        Clock::time_point ChangedAt; // first change since Handled
+    };
+
+    struct Finished
+    {
+        uint32_t Program;
+        uint64_t Generation;
+        ShaderReloadApply Apply; // empty if the compile threw
+        std::string Error;
+        double CompileMs;
+    };
+
+    void StartCompile(uint32_t id);
+    void WatchNewDirectories();
+
+    ThreadPool& m_Pool;
+    ShaderIncludeGraph m_Graph;
+    std::vector<Program> m_Programs; // render thread only
+    std::unique_ptr<FileWatcher> m_Watcher;
+    std::vector<std::string> m_WatchedDirectories;
+
+    // Shared with the workers
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_Idle;
+    std::vector<Finished> m_Finished;
+    uint32_t m_InFlight = 0;
+
+    ShaderReloadStats m_Stats = {};
+    double m_TotalLatencyMs = 0.0;
+    double m_TotalCompileMs = 0.0;
+};
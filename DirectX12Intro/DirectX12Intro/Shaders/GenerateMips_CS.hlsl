@@ -0,0 +1,167 @@
+// Generates up to 4 mips of a RGBA8 texture per dispatch.
+// Each thread of an 8x8 group filters one texel of the first output mip from the source mip,
+// then the group keeps reducing its tile in groupshared memory for the next three mips.
+//
+// The first output mip handles odd source sizes with a 3 tap polyphase box filter (AxisTaps).
+// Every further mip in the same dispatch is an exact halving, MipGenerator makes sure of that
+// by splitting the chain into dispatches at odd sizes.
+//
+// UAVs can't be sRGB, so for sRGB textures the source is read through an _SRGB view (returns linear)
+// and the outputs are encoded back to sRGB by hand before being written through a UNORM view.
+// MipChain.cpp does exactly the same on the CPU.
+
+#define BLOCK_SIZE 8
+
+struct ComputeShaderInput
+{
+    uint3 GroupID           : SV_GroupID;
+    uint3 GroupThreadID     : SV_GroupThreadID;
+    uint3 DispatchThreadID  : SV_DispatchThreadID;
+    uint  GroupIndex        : SV_GroupIndex;
+};
+
+cbuffer GenerateMipsCB : register(b0)
+{
+    uint SrcMipLevel;   // mip the SrcMip view starts at, Load counts mips from there
+    uint NumMipLevels;  // mips to write, 1 to 4
+    uint2 SrcSize;      // size of the source mip
+    uint IsSRGB;
+};
+
+Texture2D<float4> SrcMip : register(t0);
+
+RWTexture2D<float4> OutMip1 : register(u0);
+RWTexture2D<float4> OutMip2 : register(u1);
+RWTexture2D<float4> OutMip3 : register(u2);
+RWTexture2D<float4> OutMip4 : register(u3);
+
+// One array per channel avoids bank conflicts
+groupshared float gs_R[64];
+groupshared float gs_G[64];
+groupshared float gs_B[64];
+groupshared float gs_A[64];
+
+void StoreColor(uint index, float4 color)
+{
+    gs_R[index] = color.r;
+    gs_G[index] = color.g;
+    gs_B[index] = color.b;
+    gs_A[index] = color.a;
+}
+
+float4 LoadColor(uint index)
+{
+    return float4(gs_R[index], gs_G[index], gs_B[index], gs_A[index]);
+}
+
+float3 LinearToSRGB(float3 x)
+{
+    return x <= 0.0031308 ? x * 12.92 : 1.055 * pow(abs(x), 1.0 / 2.4) - 0.055;
+}
+
+float4 PackColor(float4 x)
+{
+    return IsSRGB ? float4(LinearToSRGB(x.rgb), x.a) : x;
+}
+
+// Source texels and weights for output texel x along an axis with sourceSize texels
+//   1    : the single texel
+//   even : 2 texel box
+//   odd  : 3 texel polyphase box, (n - x, n, x + 1) / (2n + 1)
+void AxisTaps(uint x, uint sourceSize, out uint3 position, out float3 weight)
+{
+    if (sourceSize == 1)
+    {
+        position = uint3(0, 0, 0);
+        weight = float3(1.0, 0.0, 0.0);
+    }
+    else if (sourceSize & 1)
+    {
+        float n = sourceSize >> 1;
+        position = uint3(2 * x, 2 * x + 1, 2 * x + 2);
+        weight = float3(n - x, n, x + 1.0) / sourceSize;
+    }
+    else
+    {
+        position = uint3(2 * x, 2 * x + 1, 2 * x + 1);
+        weight = float3(0.5, 0.5, 0.0);
+    }
+}
+
+[numthreads(BLOCK_SIZE, BLOCK_SIZE, 1)]
+void main(ComputeShaderInput IN)
+{
+    uint3 tapsX, tapsY;
+    float3 weightsX, weightsY;
+    AxisTaps(IN.DispatchThreadID.x, SrcSize.x, tapsX, weightsX);
+    AxisTaps(IN.DispatchThreadID.y, SrcSize.y, tapsY, weightsY);
+
+    float4 src1 = 0;
+    [unroll]
+    for (uint j = 0; j < 3; ++j)
+    {
+        [unroll]
+        for (uint i = 0; i < 3; ++i)
+        {
+            float weight = weightsX[i] * weightsY[j];
+            if (weight > 0.0)
+            {
+                src1 += weight * SrcMip.Load(int3(tapsX[i], tapsY[j], 0));
+            }
+        }
+    }
+
+    // Writes outside the mip are dropped by the hardware, so the edge groups need no special casing
+    OutMip1[IN.DispatchThreadID.xy] = PackColor(src1);
+
+    if (NumMipLevels == 1)
+        return;
+
+    StoreColor(IN.GroupIndex, src1);
+    GroupMemoryBarrierWithGroupSync();
+
+    // Threads with even x and y average their 2x2 quad (GroupIndex bits 0 and 3)
+    if ((IN.GroupIndex & 0x9) == 0)
+    {
+        float4 src2 = LoadColor(IN.GroupIndex + 0x01);
+        float4 src3 = LoadColor(IN.GroupIndex + 0x08);
+        float4 src4 = LoadColor(IN.GroupIndex + 0x09);
+        src1 = 0.25 * (src1 + src2 + src3 + src4);
+
+        OutMip2[IN.DispatchThreadID.xy / 2] = PackColor(src1);
+        StoreColor(IN.GroupIndex, src1);
+    }
+
+    if (NumMipLevels == 2)
+        return;
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // Multiples of 4 in x and y (GroupIndex bits 0, 1, 3 and 4)
+    if ((IN.GroupIndex & 0x1B) == 0)
+    {
+        float4 src2 = LoadColor(IN.GroupIndex + 0x02);
+        float4 src3 = LoadColor(IN.GroupIndex + 0x10);
+        float4 src4 = LoadColor(IN.GroupIndex + 0x12);
+        src1 = 0.25 * (src1 + src2 + src3 + src4);
+
+        OutMip3[IN.DispatchThreadID.xy / 4] = PackColor(src1);
+        StoreColor(IN.GroupIndex, src1);
+    }
+
+    if (NumMipLevels == 3)
+        return;
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // Only the first thread is left
+    if (IN.GroupIndex == 0)
+    {
+        float4 src2 = LoadColor(IN.GroupIndex + 0x04);
+        float4 src3 = LoadColor(IN.GroupIndex + 0x20);
+        float4 src4 = LoadColor(IN.GroupIndex + 0x24);
+        src1 = 0.25 * (src1 + src2 + src3 + src4);
+
+        OutMip4[IN.DispatchThreadID.xy / 8] = PackColor(src1);
+    }
+}
@@ -0,0 +1,20 @@
+// Pixel shader for InstanceRenderer, the material's color lit from above
+
+struct MaterialCB
+{
+    float4 Color;
+};
+
+ConstantBuffer<MaterialCB> MaterialCB : register(b1);
+
+struct PixelShaderInput
+{
+    float3 Normal : NORMAL;
+    float4 Position : SV_Position;
+};
+
+float4 main(PixelShaderInput IN) : SV_Target
+{
+    float light = saturate(dot(normalize(IN.Normal), float3(0.0f, 1.0f, 0.0f))) * 0.75f + 0.25f;
+    return float4(MaterialCB.Color.rgb * light, MaterialCB.Color.a);
+}
@@ -0,0 +1,40 @@
+// Vertex shader for InstanceRenderer: one instanced draw per InstanceBatcher group, the per instance data comes
+// from a StructuredBuffer the batch's SRV starts at (InstanceData in InstanceBatcher.h).
+
+struct InstanceData
+{
+    float4 World[3]; // the world matrix's first three columns
+    uint4 UserData;
+};
+
+struct ViewCB
+{
+    row_major float4x4 ViewProjection;
+};
+
+ConstantBuffer<ViewCB> ViewCB : register(b0);
+StructuredBuffer<InstanceData> Instances : register(t0);
+
+struct VertexIn
+{
+    float3 Position : POSITION;
+    float3 Normal : NORMAL;
+};
+
+struct VertexOut
+{
+    float3 Normal : NORMAL;
+    float4 Position : SV_Position;
+};
+
+VertexOut main(VertexIn IN, uint InstanceID : SV_InstanceID)
+{
+    InstanceData instance = Instances[InstanceID];
+    float4 position = float4(IN.Position, 1.0f);
+    float3 world = float3(dot(instance.World[0], position), dot(instance.World[1], position), dot(instance.World[2], position));
+
+    VertexOut OUT;
+    OUT.Normal = float3(dot(instance.World[0].xyz, IN.Normal), dot(instance.World[1].xyz, IN.Normal), dot(instance.World[2].xyz, IN.Normal));
+    OUT.Position = mul(float4(world, 1.0f), ViewCB.ViewProjection);
+    return OUT;
+}
@@ -0,0 +1,64 @@
+// Mesh shader for MeshletRenderer: one group per visible meshlet, a thread per output vertex and primitive.
+// Buffer layouts are the ones in Meshlet.h. The outputs are sized for MESHLET_MAX_VERTICES/MESHLET_MAX_PRIMITIVES.
+
+#define MAX_VERTICES 64
+#define MAX_PRIMITIVES 126
+
+struct Meshlet
+{
+    uint VertexOffset;
+    uint VertexCount;
+    uint PrimitiveOffset;
+    uint PrimitiveCount;
+};
+
+struct MeshletCB
+{
+    row_major float4x4 ViewProjection;
+    uint FirstMeshlet;
+};
+
+ConstantBuffer<MeshletCB> MeshletCB : register(b0);
+
+StructuredBuffer<float3> Positions : register(t0);
+StructuredBuffer<Meshlet> Meshlets : register(t1);
+StructuredBuffer<uint> VertexIndices : register(t2);
+StructuredBuffer<uint> PrimitiveIndices : register(t3); // three 10 bit indices into the meshlet's vertices
+StructuredBuffer<uint> VisibleMeshlets : register(t4);
+
+struct VertexOut
+{
+    float4 Position : SV_Position;
+    float3 Color : COLOR;
+};
+
+// A color per meshlet, so they can be told apart
+float3 MeshletColor(uint index)
+{
+    uint hash = index * 2654435761u;
+    return float3(hash & 0xFF, (hash >> 8) & 0xFF, (hash >> 16) & 0xFF) / 255.0f * 0.75f + 0.25f;
+}
+
+[outputtopology("triangle")]
+[numthreads(128, 1, 1)]
+void main(uint groupThreadID : SV_GroupThreadID, uint groupID : SV_GroupID,
+    out vertices VertexOut verts[MAX_VERTICES], out indices uint3 triangles[MAX_PRIMITIVES])
+{
+    uint meshletIndex = VisibleMeshlets[MeshletCB.FirstMeshlet + groupID];
+    Meshlet meshlet = Meshlets[meshletIndex];
+
+    SetMeshOutputCounts(meshlet.VertexCount, meshlet.PrimitiveCount);
+
+    if (groupThreadID < meshlet.PrimitiveCount)
+    {
+        uint primitive = PrimitiveIndices[meshlet.PrimitiveOffset + groupThreadID];
+        triangles[groupThreadID] = uint3(primitive & 0x3FF, (primitive >> 10) & 0x3FF, (primitive >> 20) & 0x3FF);
+    }
+
+    if (groupThreadID < meshlet.VertexCount)
+    {
+        float3 position = Positions[VertexIndices[meshlet.VertexOffset + groupThreadID]];
+        verts[groupThreadID].Position = mul(float4(position, 1.0f), MeshletCB.ViewProjection);
+        verts[groupThreadID].Color = MeshletColor(meshletIndex);
+    }
+}
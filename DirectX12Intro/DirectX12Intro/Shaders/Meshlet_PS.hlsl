@@ -0,0 +1,12 @@
+// Pixel shader for MeshletRenderer, flat color per meshlet
+
+struct PixelShaderInput
+{
+    float4 Position : SV_Position;
+    float3 Color : COLOR;
+};
+
+float4 main(PixelShaderInput IN) : SV_Target
+{
+    return float4(IN.Color, 1.0f);
+}
@@ -0,0 +1,26 @@
+// Decoding the packed vertices of VertexPacker.h
+// The input layout (VertexInputLayout.h) already turns the formats into floats, what's left is the octahedral
+// normals and tangents. Positions come out in [0, 1] of the mesh's bounds, GetDequantizeMatrix folds the rest into
+// the world matrix.
+
+struct PackedVertex
+{
+    float4 Position : POSITION; // w is the bitangent sign, 0 or 1
+    float2 Normal : NORMAL;
+    float2 Tangent : TANGENT;
+    float2 TexCoord : TEXCOORD;
+};
+
+float3 DecodeOctahedral(float2 encoded)
+{
+    float3 direction = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float t = saturate(-direction.z);
+    direction.xy += t * (1.0f - 2.0f * step(0.0f, direction.xy)); // towards 0, unfolds the lower half
+    return normalize(direction);
+}
+
+// xyz and the bitangent sign, like an unpacked TANGENT
+float4 DecodeTangent(PackedVertex vertex)
+{
+    return float4(DecodeOctahedral(vertex.Tangent), vertex.Position.w * 2.0f - 1.0f);
+}
@@ -0,0 +1,17 @@
+// Stretches the rendered part of an over-allocated render target over the whole output (bilinear).
+// The target is bigger than what was rendered into it, so the output UVs get scaled down to the rendered
+// region and clamped half a texel inside it, filtering must never pull in texels outside the viewport.
+
+cbuffer UpscaleCB : register(b0)
+{
+    float2 UVScale; // rendered size / allocated size
+    float2 UVMax;   // (rendered size - 0.5) / allocated size
+};
+
+Texture2D<float4> Source : register(t0);
+SamplerState LinearClamp : register(s0);
+
+float4 main(float2 TexCoord : TEXCOORD) : SV_Target
+{
+    return Source.SampleLevel(LinearClamp, min(TexCoord * UVScale, UVMax), 0);
+}
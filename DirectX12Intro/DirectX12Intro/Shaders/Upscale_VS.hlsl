@@ -0,0 +1,20 @@
+// Fullscreen triangle for ScaledRenderTarget's upscale pass.
+// No vertex buffer, the 3 vertices come from SV_VertexID: (0,0) (2,0) (0,2) in UV space,
+// a triangle big enough to cover the whole viewport.
+
+struct VertexShaderOutput
+{
+    float2 TexCoord : TEXCOORD;
+    float4 Position : SV_Position;
+};
+
+VertexShaderOutput main(uint VertexID : SV_VertexID)
+{
+    VertexShaderOutput OUT;
+
+    float2 uv = float2((VertexID << 1) & 2, VertexID & 2);
+    OUT.TexCoord = uv;
+    OUT.Position = float4(uv * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 0.0f, 1.0f);
+
+    return OUT;
+}
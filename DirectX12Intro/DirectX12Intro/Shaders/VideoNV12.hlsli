@@ -0,0 +1,26 @@
+// Sampling the NV12 frames of VideoDecoder.h
+// The two SRVs of VideoStream::CreateShaderResourceViews cover every slot of the stream, the slot to show comes
+// from VideoStream::Present (a root constant is enough). The chroma plane is half the size, the same uv samples both.
+
+Texture2DArray<float> VideoLuma : register(t0, space1);
+Texture2DArray<float2> VideoChroma : register(t1, space1);
+
+// BT.709, limited range, what decoders output unless the stream says otherwise
+float3 NV12ToRGB(float y, float2 cbcr)
+{
+    y = (y - 16.0f / 255.0f) * (255.0f / 219.0f);
+    cbcr = (cbcr - 128.0f / 255.0f) * (255.0f / 224.0f);
+
+    float3 rgb;
+    rgb.r = y + 1.5748f * cbcr.y;
+    rgb.g = y - 0.1873f * cbcr.x - 0.4681f * cbcr.y;
+    rgb.b = y + 1.8556f * cbcr.x;
+    return saturate(rgb);
+}
+
+float3 SampleVideo(SamplerState linearClamp, float2 uv, uint slot)
+{
+    float y = VideoLuma.SampleLevel(linearClamp, float3(uv, slot), 0.0f);
+    float2 cbcr = VideoChroma.SampleLevel(linearClamp, float3(uv, slot), 0.0f);
+    return NV12ToRGB(y, cbcr);
+}
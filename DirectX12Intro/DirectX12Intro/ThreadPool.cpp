@@ -0,0 +1,111 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <memory>
+
+ThreadPool::ThreadPool(uint32_t numThreads)
+{
+    if (numThreads == 0)
+    {
+        // hardware_concurrency is allowed to return 0 if it can't tell
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    m_Threads.reserve(numThreads);
+    for (uint32_t i = 0; i < numThreads; ++i)
+    {
+        m_Threads.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_Condition.notify_all();
+
+    for (std::thread& thread : m_Threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::Enqueue(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Tasks.push_back(std::move(task));
+    }
+    m_Condition.notify_one();
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& func)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // Shared with the helper tasks. Helpers that only get scheduled after all the work
+    // is done will find nothing left to claim, so the state has to outlive this call.
+    struct State
+    {
+        std::atomic<uint32_t> next{ 0 };
+        std::atomic<uint32_t> done{ 0 };
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto state = std::make_shared<State>();
+
+    // Pulls indices until there are none left
+    auto work = [state, count, &func]()
+    {
+        for (uint32_t i = state->next++; i < count; i = state->next++)
+        {
+            func(i);
+            if (++state->done == count)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    // Don't bother waking more helpers than there is work for (the caller counts as one)
+    uint32_t numHelpers = std::min(GetThreadCount(), count - 1);
+    for (uint32_t i = 0; i < numHelpers; ++i)
+    {
+        Enqueue(work);
+    }
+
+    work();
+
+    // Wait on the work being done, not on the helpers, since a helper may never get scheduled
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&]() { return state->done == count; });
+}
+
+void ThreadPool::WorkerLoop()
+{
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Condition.wait(lock, [this]() { return m_Stopping || !m_Tasks.empty(); });
+
+            // Drain whatever is left before shutting down
+            if (m_Tasks.empty())
+            {
+                return;
+            }
+
+            task = std::move(m_Tasks.front());
+            m_Tasks.pop_front();
+        }
+
+        task();
+    }
+}
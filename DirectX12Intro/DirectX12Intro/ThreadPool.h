@@ -0,0 +1,45 @@
+#pragma once
+
+// A small fixed size worker pool.
+// Used by the asset pipeline (archive decompression, texture encoding, etc.)
+// so we don't spin up and tear down std::threads for every batch of work.
+// Only uses the STL so it builds on any platform.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    // 0 threads = one per hardware thread
+    explicit ThreadPool(uint32_t numThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Fire and forget. The task runs on one of the worker threads.
+    void Enqueue(std::function<void()> task);
+
+    // Calls func(i) for every i in [0, count) spread across the workers and blocks until all are done.
+    // The calling thread also pulls work, so this is safe to call from inside a worker task
+    // (it just degrades to running serially if every worker is busy).
+    void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& func);
+
+    uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Threads.size()); }
+
+private:
+    void WorkerLoop();
+
+    std::vector<std::thread> m_Threads;
+    std::deque<std::function<void()>> m_Tasks;
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    bool m_Stopping = false;
+};
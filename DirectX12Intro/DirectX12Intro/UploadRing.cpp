@@ -0,0 +1,83 @@
+#include "UploadRing.h"
+
+#include "d3dx12.h"
+#include "GPUMemoryTagging.h"
+#include "Helpers.h"
+
+using namespace Microsoft::WRL;
+
+UploadRing::UploadRing(ComPtr<ID3D12Device2> device, uint64_t size)
+    : m_Size(size)
+{
+    CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_UPLOAD);
+    CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+
+    // Upload heap resources have to start (and stay) in the GENERIC_READ state
+    ThrowIfFailed(device->CreateCommittedResource(
+        &heapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&m_Resource)));
+    m_Resource->SetName(L"Upload ring");
+    GPU_MEMORY_TAG(m_Resource.Get(), "UploadRing");
+
+    // Upload heaps can stay mapped for their whole lifetime.
+    // Empty read range = the CPU won't read from it (it's write combined memory, reading would be very slow)
+    CD3DX12_RANGE readRange(0, 0);
+    ThrowIfFailed(m_Resource->Map(0, &readRange, reinterpret_cast<void**>(&m_CPU)));
+    m_GPU = m_Resource->GetGPUVirtualAddress();
+}
+
+UploadRing::~UploadRing()
+{
+    m_Resource->Unmap(0, nullptr);
+}
+
+bool UploadRing::TryAllocate(uint64_t size, uint64_t alignment, UploadAllocation& allocation)
+{
+    uint64_t offset = (m_Head + alignment - 1) & ~(alignment - 1);
+    uint64_t padding = offset - m_Head;
+
+    // Allocations are contiguous, so if it doesn't fit before the end skip the tail and start over at 0
+    if (offset + size > m_Size)
+    {
+        padding = m_Size - m_Head;
+        offset = 0;
+    }
+
+    if (m_Used + padding + size > m_Size)
+    {
+        return false;
+    }
+
+    m_Head = offset + size == m_Size ? 0 : offset + size;
+    m_Used += padding + size;
+    m_FrameBytes += padding + size;
+
+    allocation.CPU = m_CPU + offset;
+    allocation.GPU = m_GPU + offset;
+    allocation.Resource = m_Resource.Get();
+    allocation.Offset = offset;
+    return true;
+}
+
+void UploadRing::FinishFrame(uint64_t fenceValue)
+{
+    if (m_FrameBytes > 0)
+    {
+        m_InFlight.push_back({ fenceValue, m_FrameBytes });
+        m_FrameBytes = 0;
+    }
+}
+
+void UploadRing::Retire(uint64_t completedFenceValue)
+{
+    // Frames retire in order, so the oldest allocations (the ring's tail) are always freed first
+    while (!m_InFlight.empty() && m_InFlight.front().FenceValue <= completedFenceValue)
+    {
+        m_Used -= m_InFlight.front().Bytes;
+        m_InFlight.pop_front();
+    }
+}
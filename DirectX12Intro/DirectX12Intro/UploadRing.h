@@ -0,0 +1,62 @@
+#pragma once
+
+// A ring buffer of persistently mapped UPLOAD heap memory.
+// Anything that needs to get data to the GPU (asset loads, per frame constants, ...) grabs a slice,
+// writes into it through the CPU pointer and records a copy from it.
+// Slices are handed back in bulk once the fence value of the frame that used them has completed,
+// so there is never a wait on the GPU unless the ring is actually full.
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <wrl.h>
+#include <d3d12.h>
+
+#include <cstdint>
+#include <deque>
+
+struct UploadAllocation
+{
+    void* CPU; // write here
+    D3D12_GPU_VIRTUAL_ADDRESS GPU;
+    ID3D12Resource* Resource; // copy source
+    uint64_t Offset; // offset of the allocation in Resource
+};
+
+class UploadRing
+{
+public:
+    UploadRing(Microsoft::WRL::ComPtr<ID3D12Device2> device, uint64_t size);
+    ~UploadRing();
+
+    // Returns false if there isn't enough retired space, the caller can Retire with a newer fence value and try again.
+    // alignment must be a power of 2 (D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT for textures,
+    // D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT for constants).
+    bool TryAllocate(uint64_t size, uint64_t alignment, UploadAllocation& allocation);
+
+    // Everything allocated since the last call is in use until the GPU reaches fenceValue
+    void FinishFrame(uint64_t fenceValue);
+
+    // Frees the memory of every frame whose fence value is <= completedFenceValue
+    void Retire(uint64_t completedFenceValue);
+
+    uint64_t GetSize() const { return m_Size; }
+    uint64_t GetUsed() const { return m_Used; }
+
+private:
+    struct Frame
+    {
+        uint64_t FenceValue;
+        uint64_t Bytes;
+    };
+
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_Resource;
+    uint8_t* m_CPU = nullptr;
+    D3D12_GPU_VIRTUAL_ADDRESS m_GPU = 0;
+
+    uint64_t m_Size;
+    uint64_t m_Head = 0; // next free byte
+    uint64_t m_Used = 0; // bytes between the oldest in-flight allocation and m_Head (including wrap padding)
+    uint64_t m_FrameBytes = 0; // bytes allocated since the last FinishFrame
+    std::deque<Frame> m_InFlight;
+};
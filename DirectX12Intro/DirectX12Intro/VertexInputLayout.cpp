@@ -0,0 +1,33 @@
+#include "VertexInputLayout.h"
+
+DXGI_FORMAT GetDXGIFormat(VertexElementFormat format)
+{
+    switch (format)
+    {
+    case VertexElementFormat::Float2:
+        return DXGI_FORMAT_R32G32_FLOAT;
+    case VertexElementFormat::Float3:
+        return DXGI_FORMAT_R32G32B32_FLOAT;
+    case VertexElementFormat::Float4:
+        return DXGI_FORMAT_R32G32B32A32_FLOAT;
+    case VertexElementFormat::Unorm16x4:
+        return DXGI_FORMAT_R16G16B16A16_UNORM;
+    case VertexElementFormat::Snorm16x2:
+        return DXGI_FORMAT_R16G16_SNORM;
+    case VertexElementFormat::Half2:
+        return DXGI_FORMAT_R16G16_FLOAT;
+    default:
+        return DXGI_FORMAT_UNKNOWN;
+    }
+}
+
+std::vector<D3D12_INPUT_ELEMENT_DESC> GetInputLayout(const std::vector<VertexElement>& layout, UINT inputSlot)
+{
+    std::vector<D3D12_INPUT_ELEMENT_DESC> inputLayout;
+    for (const VertexElement& element : layout)
+    {
+        inputLayout.push_back({ element.SemanticName, 0, GetDXGIFormat(element.Format), inputSlot, element.Offset,
+            D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+    }
+    return inputLayout;
+}
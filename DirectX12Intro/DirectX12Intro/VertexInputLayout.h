@@ -0,0 +1,17 @@
+#pragma once
+
+// D3D12 input layouts for the vertex layouts of VertexPacker.h, packed or not
+// The descs point at the VertexElements' semantic names, which are static strings, so they can be kept around.
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <d3d12.h>
+
+#include "VertexPacker.h"
+
+#include <vector>
+
+DXGI_FORMAT GetDXGIFormat(VertexElementFormat format);
+
+std::vector<D3D12_INPUT_ELEMENT_DESC> GetInputLayout(const std::vector<VertexElement>& layout, UINT inputSlot = 0);
@@ -0,0 +1,605 @@
+#include "VertexPacker.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define VERTEX_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    const float UNORM16_MAX = 65535.0f;
+    const float SNORM16_MAX = 32767.0f;
+    const float UNORM16_STEP = 1.0f / UNORM16_MAX; // decoding multiplies, the GPU's divide isn't exact either
+    const float SNORM16_STEP = 1.0f / SNORM16_MAX;
+
+    uint32_t FloatBits(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    float BitsFloat(uint32_t bits)
+    {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    uint16_t QuantizeUnorm16(float value, float min, float scale)
+    {
+        float scaled = std::min(std::max((value - min) * scale, 0.0f), UNORM16_MAX);
+        return static_cast<uint16_t>(scaled + 0.5f);
+    }
+
+    int16_t QuantizeSnorm16(float value)
+    {
+        return static_cast<int16_t>(std::lrint(std::min(std::max(value, -1.0f), 1.0f) * SNORM16_MAX));
+    }
+
+    float DequantizeSnorm16(int16_t value)
+    {
+        return std::max(value * SNORM16_STEP, -1.0f); // -32768 and -32767 are both -1, like D3D
+    }
+
+    uint16_t GetTangentSign(const float* tangents, uint32_t v)
+    {
+        return !tangents || tangents[v * 4 + 3] >= 0.0f ? 0xFFFF : 0;
+    }
+
+    // Each kernel does blocks of 4 vertices with SSE2 and the rest (or everything, without SSE2) one at a time.
+    // The vectorized paths do the same float operations in the same order as the scalar ones, so both round alike.
+
+    void PackPositions(const VertexStreams& streams, const float min[3], const float scale[3], uint8_t* out, uint32_t stride)
+    {
+        const float* positions = streams.Positions;
+        uint32_t v = 0;
+#if defined(VERTEX_USE_SSE2)
+        // 4 float3s are 3 registers, x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3, so the bounds get rotated to match
+        const __m128 mins[3] = { _mm_setr_ps(min[0], min[1], min[2], min[0]), _mm_setr_ps(min[1], min[2], min[0], min[1]),
+            _mm_setr_ps(min[2], min[0], min[1], min[2]) };
+        const __m128 scales[3] = { _mm_setr_ps(scale[0], scale[1], scale[2], scale[0]), _mm_setr_ps(scale[1], scale[2], scale[0], scale[1]),
+            _mm_setr_ps(scale[2], scale[0], scale[1], scale[2]) };
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 unormMax = _mm_set1_ps(UNORM16_MAX);
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128i bias = _mm_set1_epi32(32768);
+        const __m128i flip = _mm_set1_epi16(static_cast<short>(0x8000));
+        for (; v + 4 <= streams.NumVertices; v += 4)
+        {
+            __m128i quantized[3];
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                __m128 scaled = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(positions + v * 3 + i * 4), mins[i]), scales[i]);
+                scaled = _mm_min_ps(_mm_max_ps(scaled, zero), unormMax);
+                quantized[i] = _mm_sub_epi32(_mm_cvttps_epi32(_mm_add_ps(scaled, half)), bias);
+            }
+
+            // SSE2 only packs with signed saturation, so pack them biased to signed and flip the top bit back
+            alignas(16) uint16_t packed[16];
+            _mm_store_si128(reinterpret_cast<__m128i*>(packed), _mm_xor_si128(_mm_packs_epi32(quantized[0], quantized[1]), flip));
+            _mm_store_si128(reinterpret_cast<__m128i*>(packed + 8), _mm_xor_si128(_mm_packs_epi32(quantized[2], quantized[2]), flip));
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                uint16_t position[4] = { packed[i * 3], packed[i * 3 + 1], packed[i * 3 + 2], GetTangentSign(streams.Tangents, v + i) };
+                std::memcpy(out + size_t(v + i) * stride, position, sizeof(position));
+            }
+        }
+#endif
+        for (; v < streams.NumVertices; ++v)
+        {
+            uint16_t position[4];
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                position[c] = QuantizeUnorm16(positions[v * 3 + c], min[c], scale[c]);
+            }
+            position[3] = GetTangentSign(streams.Tangents, v);
+            std::memcpy(out + size_t(v) * stride, position, sizeof(position));
+        }
+    }
+
+#if defined(VERTEX_USE_SSE2)
+    // 4 directions (float3 or the xyz of float4) into one register per component
+    void LoadDirections(const float* directions, uint32_t components, __m128& x, __m128& y, __m128& z)
+    {
+        if (components == 4)
+        {
+            __m128 w = _mm_loadu_ps(directions + 12);
+            x = _mm_loadu_ps(directions);
+            y = _mm_loadu_ps(directions + 4);
+            z = _mm_loadu_ps(directions + 8);
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+        }
+        else
+        {
+            __m128 a = _mm_loadu_ps(directions);     // x0 y0 z0 x1
+            __m128 b = _mm_loadu_ps(directions + 4); // y1 z1 x2 y2
+            __m128 c = _mm_loadu_ps(directions + 8); // z2 x3 y3 z3
+            x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+            y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)),
+                _MM_SHUFFLE(2, 0, 2, 0));
+            z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), c, _MM_SHUFFLE(3, 0, 2, 0));
+        }
+    }
+
+    __m128 Select(__m128 mask, __m128 a, __m128 b)
+    {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+#endif
+
+    void PackOctahedral(const float* directions, uint32_t components, uint32_t numVertices, uint8_t* out, uint32_t stride)
+    {
+        uint32_t v = 0;
+#if defined(VERTEX_USE_SSE2)
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 minusOne = _mm_set1_ps(-1.0f);
+        const __m128 minLength = _mm_set1_ps(FLT_MIN);
+        const __m128 snormMax = _mm_set1_ps(SNORM16_MAX);
+        for (; v + 4 <= numVertices; v += 4)
+        {
+            __m128 x, y, z;
+            LoadDirections(directions + v * components, components, x, y, z);
+
+            // Onto the octahedron |x| + |y| + |z| = 1, the lower half folded out over the upper one's corners
+            __m128 length = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, x), _mm_andnot_ps(signMask, y)), _mm_andnot_ps(signMask, z));
+            __m128 scale = _mm_div_ps(one, _mm_max_ps(length, minLength));
+            __m128 px = _mm_mul_ps(x, scale);
+            __m128 py = _mm_mul_ps(y, scale);
+            __m128 foldedX = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, py)), _mm_or_ps(_mm_and_ps(px, signMask), one));
+            __m128 foldedY = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, px)), _mm_or_ps(_mm_and_ps(py, signMask), one));
+            __m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+            px = Select(lower, foldedX, px);
+            py = Select(lower, foldedY, py);
+
+            __m128i qx = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(px, minusOne), one), snormMax));
+            __m128i qy = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(py, minusOne), one), snormMax));
+            __m128i packed = _mm_packs_epi32(qx, qy); // x0 x1 x2 x3 y0 y1 y2 y3
+
+            alignas(16) int16_t encoded[8];
+            _mm_store_si128(reinterpret_cast<__m128i*>(encoded), _mm_unpacklo_epi16(packed, _mm_srli_si128(packed, 8)));
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                std::memcpy(out + size_t(v + i) * stride, encoded + i * 2, sizeof(int16_t) * 2);
+            }
+        }
+#endif
+        for (; v < numVertices; ++v)
+        {
+            int16_t encoded[2];
+            EncodeOctahedral(directions + v * components, encoded);
+            std::memcpy(out + size_t(v) * stride, encoded, sizeof(encoded));
+        }
+    }
+
+#if defined(VERTEX_USE_SSE2)
+    // Fabian Giesen's float to half, round to nearest even. The halves come out sign extended to 32 bits so they pack
+    // to 16 with signed saturation unchanged.
+    __m128i FloatToHalf4(__m128 value)
+    {
+        const __m128i infinityOrNaN = _mm_set1_epi32(0x7C00);
+        const __m128i nanBit = _mm_set1_epi32(0x200);
+        const __m128i halfMax = _mm_set1_epi32((127 + 16) << 23);   // and up round to infinity
+        const __m128i minNormal = _mm_set1_epi32((127 - 14) << 23); // below comes out subnormal
+        const __m128i subnormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+        const __m128i normalBias = _mm_set1_epi32(0xFFF - ((127 - 15) << 23));
+
+        __m128 sign = _mm_and_ps(value, _mm_set1_ps(-0.0f));
+        __m128 absolute = _mm_xor_ps(value, sign);
+        __m128i bits = _mm_castps_si128(absolute);
+
+        // Subnormals: adding the magic number lines the 10 mantissa bits up at the bottom, rounded by the add
+        __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absolute, _mm_castsi128_ps(subnormalMagic))), subnormalMagic);
+
+        // Normals: rebias the exponent and round the mantissa, ties towards even
+        __m128i odd = _mm_srai_epi32(_mm_slli_epi32(bits, 31 - 13), 31);
+        __m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(bits, normalBias), odd), 13);
+
+        __m128i isSubnormal = _mm_cmpgt_epi32(minNormal, bits);
+        __m128i finite = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+        __m128i special = _mm_or_si128(_mm_and_si128(_mm_castps_si128(_mm_cmpunord_ps(absolute, absolute)), nanBit), infinityOrNaN);
+        __m128i isFinite = _mm_cmpgt_epi32(halfMax, bits);
+        __m128i result = _mm_or_si128(_mm_and_si128(isFinite, finite), _mm_andnot_si128(isFinite, special));
+        return _mm_or_si128(result, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+    }
+
+    // Halves in the low 16 bits of each lane
+    __m128 HalfToFloat4(__m128i value)
+    {
+        const __m128i noSign = _mm_set1_epi32(0x7FFF);
+        const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)); // 2^112, the exponent rebias
+        const __m128i maxFinite = _mm_set1_epi32(0x7BFF);
+        const __m128 infinityExponent = _mm_castsi128_ps(_mm_set1_epi32(255 << 23));
+
+        __m128i exponentMantissa = _mm_and_si128(value, noSign);
+        __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(exponentMantissa, 13)), magic);
+        __m128 isSpecial = _mm_castsi128_ps(_mm_cmpgt_epi32(exponentMantissa, maxFinite));
+        __m128 sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_xor_si128(value, exponentMantissa), 16));
+        return _mm_or_ps(scaled, _mm_or_ps(sign, _mm_and_ps(isSpecial, infinityExponent)));
+    }
+#endif
+
+    void PackTexCoords(const float* texCoords, uint32_t numVertices, uint8_t* out, uint32_t stride)
+    {
+        uint32_t v = 0;
+#if defined(VERTEX_USE_SSE2)
+        for (; v + 4 <= numVertices; v += 4)
+        {
+            __m128i low = FloatToHalf4(_mm_loadu_ps(texCoords + v * 2));
+            __m128i high = FloatToHalf4(_mm_loadu_ps(texCoords + v * 2 + 4));
+
+            alignas(16) uint16_t halves[8];
+            _mm_store_si128(reinterpret_cast<__m128i*>(halves), _mm_packs_epi32(low, high));
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                std::memcpy(out + size_t(v + i) * stride, halves + i * 2, sizeof(uint16_t) * 2);
+            }
+        }
+#endif
+        for (; v < numVertices; ++v)
+        {
+            uint16_t halves[2] = { FloatToHalf(texCoords[v * 2]), FloatToHalf(texCoords[v * 2 + 1]) };
+            std::memcpy(out + size_t(v) * stride, halves, sizeof(halves));
+        }
+    }
+
+    void UnpackPositions(const PackedVertices& vertices, float* positions)
+    {
+        const uint8_t* data = vertices.Data.data();
+        uint32_t v = 0;
+#if defined(VERTEX_USE_SSE2)
+        const __m128 unormStep = _mm_set1_ps(UNORM16_STEP);
+        const __m128 min = _mm_setr_ps(vertices.BoundsMin[0], vertices.BoundsMin[1], vertices.BoundsMin[2], 0.0f);
+        const __m128 extent = _mm_setr_ps(vertices.BoundsExtent[0], vertices.BoundsExtent[1], vertices.BoundsExtent[2], 0.0f);
+        for (; v + 4 <= vertices.NumVertices; v += 4)
+        {
+            alignas(16) float unpacked[4][4];
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                __m128i quantized = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data + size_t(v + i) * vertices.Stride));
+                __m128 unorm = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(quantized, _mm_setzero_si128())), unormStep);
+                _mm_store_ps(unpacked[i], _mm_add_ps(min, _mm_mul_ps(unorm, extent)));
+            }
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                std::memcpy(positions + (v + i) * 3, unpacked[i], sizeof(float) * 3);
+            }
+        }
+#endif
+        for (; v < vertices.NumVertices; ++v)
+        {
+            uint16_t quantized[3];
+            std::memcpy(quantized, data + size_t(v) * vertices.Stride, sizeof(quantized));
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                positions[v * 3 + c] = vertices.BoundsMin[c] + quantized[c] * UNORM16_STEP * vertices.BoundsExtent[c];
+            }
+        }
+    }
+
+    void UnpackOctahedral(const PackedVertices& vertices, uint32_t offset, float* directions, uint32_t components)
+    {
+        const uint8_t* data = vertices.Data.data() + offset;
+        uint32_t v = 0;
+#if defined(VERTEX_USE_SSE2)
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 minusOne = _mm_set1_ps(-1.0f);
+        const __m128 snormStep = _mm_set1_ps(SNORM16_STEP);
+        for (; v + 4 <= vertices.NumVertices; v += 4)
+        {
+            alignas(16) int32_t encoded[4];
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                std::memcpy(&encoded[i], data + size_t(v + i) * vertices.Stride, sizeof(int32_t));
+            }
+            __m128i xy = _mm_load_si128(reinterpret_cast<const __m128i*>(encoded));
+            __m128 x = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(xy, 16), 16)), snormStep), minusOne);
+            __m128 y = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(xy, 16)), snormStep), minusOne);
+
+            // Unfold the lower half, then back to unit length
+            __m128 z = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, x)), _mm_andnot_ps(signMask, y));
+            __m128 t = _mm_max_ps(_mm_xor_ps(z, signMask), zero);
+            x = _mm_add_ps(x, Select(_mm_cmpge_ps(x, zero), _mm_xor_ps(t, signMask), t));
+            y = _mm_add_ps(y, Select(_mm_cmpge_ps(y, zero), _mm_xor_ps(t, signMask), t));
+            __m128 scale = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z))));
+            x = _mm_mul_ps(x, scale);
+            y = _mm_mul_ps(y, scale);
+            z = _mm_mul_ps(z, scale);
+
+            __m128 w = zero;
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            const __m128 rows[4] = { x, y, z, w };
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                alignas(16) float direction[4];
+                _mm_store_ps(direction, rows[i]);
+                std::memcpy(directions + (v + i) * components, direction, sizeof(float) * 3);
+            }
+        }
+#endif
+        for (; v < vertices.NumVertices; ++v)
+        {
+            int16_t encoded[2];
+            std::memcpy(encoded, data + size_t(v) * vertices.Stride, sizeof(encoded));
+            DecodeOctahedral(encoded, directions + v * components);
+        }
+    }
+
+    void UnpackTexCoords(const PackedVertices& vertices, uint32_t offset, float* texCoords)
+    {
+        const uint8_t* data = vertices.Data.data() + offset;
+        uint32_t v = 0;
+#if defined(VERTEX_USE_SSE2)
+        const __m128i lowMask = _mm_set1_epi32(0xFFFF);
+        for (; v + 4 <= vertices.NumVertices; v += 4)
+        {
+            alignas(16) uint32_t halves[4];
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                std::memcpy(&halves[i], data + size_t(v + i) * vertices.Stride, sizeof(uint32_t));
+            }
+            __m128i uv = _mm_load_si128(reinterpret_cast<const __m128i*>(halves));
+            __m128 u = HalfToFloat4(_mm_and_si128(uv, lowMask));
+            __m128 w = HalfToFloat4(_mm_srli_epi32(uv, 16));
+            _mm_storeu_ps(texCoords + v * 2, _mm_unpacklo_ps(u, w));
+            _mm_storeu_ps(texCoords + v * 2 + 4, _mm_unpackhi_ps(u, w));
+        }
+#endif
+        for (; v < vertices.NumVertices; ++v)
+        {
+            uint16_t halves[2];
+            std::memcpy(halves, data + size_t(v) * vertices.Stride, sizeof(halves));
+            texCoords[v * 2] = HalfToFloat(halves[0]);
+            texCoords[v * 2 + 1] = HalfToFloat(halves[1]);
+        }
+    }
+
+    const VertexElement* FindElement(const std::vector<VertexElement>& layout, const char* semanticName)
+    {
+        for (const VertexElement& element : layout)
+        {
+            if (std::strcmp(element.SemanticName, semanticName) == 0)
+            {
+                return &element;
+            }
+        }
+        return nullptr;
+    }
+}
+
+uint32_t GetVertexElementSize(VertexElementFormat format)
+{
+    switch (format)
+    {
+    case VertexElementFormat::Float2:
+        return 8;
+    case VertexElementFormat::Float3:
+        return 12;
+    case VertexElementFormat::Float4:
+        return 16;
+    case VertexElementFormat::Unorm16x4:
+        return 8;
+    case VertexElementFormat::Snorm16x2:
+    case VertexElementFormat::Half2:
+    default:
+        return 4;
+    }
+}
+
+std::vector<VertexElement> GetUnpackedLayout(const VertexStreams& streams, uint32_t* stride)
+{
+    std::vector<VertexElement> layout;
+    uint32_t offset = 0;
+    auto add = [&](const char* semanticName, VertexElementFormat format)
+    {
+        layout.push_back({ semanticName, format, offset });
+        offset += GetVertexElementSize(format);
+    };
+
+    add("POSITION", VertexElementFormat::Float3);
+    if (streams.Normals)
+    {
+        add("NORMAL", VertexElementFormat::Float3);
+    }
+    if (streams.Tangents)
+    {
+        add("TANGENT", VertexElementFormat::Float4);
+    }
+    if (streams.TexCoords)
+    {
+        add("TEXCOORD", VertexElementFormat::Float2);
+    }
+
+    if (stride)
+    {
+        *stride = offset;
+    }
+    return layout;
+}
+
+PackedVertices PackVertices(const VertexStreams& streams)
+{
+    if (!streams.Positions)
+    {
+        throw std::runtime_error("Vertices need positions to be packed");
+    }
+
+    PackedVertices vertices;
+    vertices.NumVertices = streams.NumVertices;
+    auto add = [&](const char* semanticName, VertexElementFormat format)
+    {
+        vertices.Layout.push_back({ semanticName, format, vertices.Stride });
+        vertices.Stride += GetVertexElementSize(format);
+    };
+
+    add("POSITION", VertexElementFormat::Unorm16x4);
+    if (streams.Normals)
+    {
+        add("NORMAL", VertexElementFormat::Snorm16x2);
+    }
+    if (streams.Tangents)
+    {
+        add("TANGENT", VertexElementFormat::Snorm16x2);
+    }
+    if (streams.TexCoords)
+    {
+        add("TEXCOORD", VertexElementFormat::Half2);
+    }
+    vertices.Data.resize(size_t(vertices.Stride) * streams.NumVertices);
+
+    float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (uint32_t v = 0; v < streams.NumVertices; ++v)
+    {
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            min[c] = std::min(min[c], streams.Positions[v * 3 + c]);
+            max[c] = std::max(max[c], streams.Positions[v * 3 + c]);
+        }
+    }
+
+    float scale[3] = {};
+    for (uint32_t c = 0; c < 3 && streams.NumVertices > 0; ++c)
+    {
+        vertices.BoundsMin[c] = min[c];
+        vertices.BoundsExtent[c] = max[c] - min[c];
+        scale[c] = vertices.BoundsExtent[c] > 0.0f ? UNORM16_MAX / vertices.BoundsExtent[c] : 0.0f; // flat along this axis
+    }
+
+    uint8_t* data = vertices.Data.data();
+    PackPositions(streams, vertices.BoundsMin, scale, data, vertices.Stride);
+    if (streams.Normals)
+    {
+        PackOctahedral(streams.Normals, 3, streams.NumVertices, data + FindElement(vertices.Layout, "NORMAL")->Offset, vertices.Stride);
+    }
+    if (streams.Tangents)
+    {
+        PackOctahedral(streams.Tangents, 4, streams.NumVertices, data + FindElement(vertices.Layout, "TANGENT")->Offset, vertices.Stride);
+    }
+    if (streams.TexCoords)
+    {
+        PackTexCoords(streams.TexCoords, streams.NumVertices, data + FindElement(vertices.Layout, "TEXCOORD")->Offset, vertices.Stride);
+    }
+    return vertices;
+}
+
+UnpackedVertices UnpackVertices(const PackedVertices& vertices)
+{
+    UnpackedVertices unpacked;
+    unpacked.Positions.resize(size_t(vertices.NumVertices) * 3);
+    UnpackPositions(vertices, unpacked.Positions.data());
+
+    if (const VertexElement* normal = FindElement(vertices.Layout, "NORMAL"))
+    {
+        unpacked.Normals.resize(size_t(vertices.NumVertices) * 3);
+        UnpackOctahedral(vertices, normal->Offset, unpacked.Normals.data(), 3);
+    }
+    if (const VertexElement* tangent = FindElement(vertices.Layout, "TANGENT"))
+    {
+        unpacked.Tangents.resize(size_t(vertices.NumVertices) * 4);
+        UnpackOctahedral(vertices, tangent->Offset, unpacked.Tangents.data(), 4);
+        for (uint32_t v = 0; v < vertices.NumVertices; ++v)
+        {
+            uint16_t sign;
+            std::memcpy(&sign, vertices.Data.data() + size_t(v) * vertices.Stride + sizeof(uint16_t) * 3, sizeof(sign));
+            unpacked.Tangents[v * 4 + 3] = sign == 0 ? -1.0f : 1.0f;
+        }
+    }
+    if (const VertexElement* texCoord = FindElement(vertices.Layout, "TEXCOORD"))
+    {
+        unpacked.TexCoords.resize(size_t(vertices.NumVertices) * 2);
+        UnpackTexCoords(vertices, texCoord->Offset, unpacked.TexCoords.data());
+    }
+    return unpacked;
+}
+
+void GetDequantizeMatrix(const PackedVertices& vertices, float matrix[4][4])
+{
+    std::memset(matrix, 0, sizeof(float) * 16);
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+        matrix[c][c] = vertices.BoundsExtent[c];
+        matrix[3][c] = vertices.BoundsMin[c];
+    }
+    matrix[3][3] = 1.0f;
+}
+
+uint16_t FloatToHalf(float value)
+{
+    uint32_t bits = FloatBits(value);
+    uint32_t sign = bits & 0x80000000;
+    bits ^= sign;
+
+    uint32_t half;
+    if (bits >= (127 + 16) << 23)
+    {
+        half = bits > 0x7F800000 ? 0x7E00 : 0x7C00; // NaN stays NaN, the rest is infinity
+    }
+    else if (bits < (127 - 14) << 23)
+    {
+        const uint32_t magic = ((127 - 15) + (23 - 10) + 1) << 23;
+        half = FloatBits(BitsFloat(bits) + BitsFloat(magic)) - magic;
+    }
+    else
+    {
+        uint32_t odd = (bits >> 13) & 1;
+        half = (bits + 0xFFF - ((127 - 15) << 23) + odd) >> 13;
+    }
+    return static_cast<uint16_t>(half | (sign >> 16));
+}
+
+float HalfToFloat(uint16_t value)
+{
+    const uint32_t exponentMask = 0x7C00 << 13;
+    uint32_t bits = (value & 0x7FFF) << 13;
+    uint32_t exponent = bits & exponentMask;
+    bits += (127 - 15) << 23;
+    if (exponent == exponentMask)
+    {
+        bits += (128 - 16) << 23; // infinity or NaN
+    }
+    else if (exponent == 0)
+    {
+        bits = FloatBits(BitsFloat(bits + (1 << 23)) - BitsFloat(113 << 23)); // subnormal, renormalize
+    }
+    return BitsFloat(bits | (uint32_t(value & 0x8000) << 16));
+}
+
+void EncodeOctahedral(const float direction[3], int16_t encoded[2])
+{
+    float scale = 1.0f / std::max(std::fabs(direction[0]) + std::fabs(direction[1]) + std::fabs(direction[2]), FLT_MIN);
+    float x = direction[0] * scale;
+    float y = direction[1] * scale;
+    if (direction[2] < 0.0f)
+    {
+        float foldedX = (1.0f - std::fabs(y)) * std::copysign(1.0f, x);
+        float foldedY = (1.0f - std::fabs(x)) * std::copysign(1.0f, y);
+        x = foldedX;
+        y = foldedY;
+    }
+    encoded[0] = QuantizeSnorm16(x);
+    encoded[1] = QuantizeSnorm16(y);
+}
+
+void DecodeOctahedral(const int16_t encoded[2], float direction[3])
+{
+    float x = DequantizeSnorm16(encoded[0]);
+    float y = DequantizeSnorm16(encoded[1]);
+    float z = 1.0f - std::fabs(x) - std::fabs(y);
+    float t = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+    float scale = 1.0f / std::sqrt(x * x + y * y + z * z);
+    direction[0] = x * scale;
+    direction[1] = y * scale;
+    direction[2] = z * scale;
+}
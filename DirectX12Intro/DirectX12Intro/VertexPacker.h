@@ -0,0 +1,94 @@
+#pragma once
+
+// Vertex stream packer
+// Full float vertices spend 48 bytes on what 20 bytes hold just as well, and vertex fetch bandwidth goes with it.
+// PackVertices interleaves the streams of a mesh into:
+//
+//   POSITION : R16G16B16A16_UNORM, xyz relative to the mesh's bounds (see GetDequantizeMatrix), w the tangent's
+//              bitangent sign (0 = -1, 1 = +1, and 1 without tangents)                               12 -> 8 bytes
+//   NORMAL   : R16G16_SNORM, octahedral                                                              12 -> 4 bytes
+//   TANGENT  : R16G16_SNORM, octahedral, the sign is in POSITION.w                                   16 -> 4 bytes
+//   TEXCOORD : R16G16_FLOAT                                                                           8 -> 4 bytes
+//
+// A vertex shader decodes them with the functions in Shaders/PackedVertex.hlsli, the input layout comes from
+// GetInputLayout in VertexInputLayout.h. The encode and decode kernels work on 4 vertices at a time with SSE2
+// when available and give bit for bit the same results as the scalar functions below.
+//
+// Worst case errors:
+//   positions : half a step, extent / 131070 per axis (plus the float rounding around the bounds)
+//   normals   : OCTAHEDRAL_MAX_ERROR radians
+//   texcoords : half a half float ulp, |uv| / 2048 (1 / 2^25 near 0)
+//
+// Nothing in here depends on D3D12 or Windows.h, the asset tools run on any platform.
+
+#include <cstdint>
+#include <vector>
+
+const float OCTAHEDRAL_MAX_ERROR = 0.0001f; // about 0.006 degrees at 16 bits per component
+
+// Tightly packed float streams, only Positions is required
+struct VertexStreams
+{
+    uint32_t NumVertices = 0;
+    const float* Positions = nullptr; // float3
+    const float* Normals = nullptr;   // float3, unit length
+    const float* Tangents = nullptr;  // float4, xyz unit length, w = +-1
+    const float* TexCoords = nullptr; // float2
+};
+
+enum class VertexElementFormat
+{
+    Float2,
+    Float3,
+    Float4,
+    Unorm16x4,
+    Snorm16x2,
+    Half2,
+};
+
+struct VertexElement
+{
+    const char* SemanticName; // static strings, they outlive any input layout made from them
+    VertexElementFormat Format;
+    uint32_t Offset;
+};
+
+uint32_t GetVertexElementSize(VertexElementFormat format);
+
+// What the streams take as interleaved floats, to compare against
+std::vector<VertexElement> GetUnpackedLayout(const VertexStreams& streams, uint32_t* stride = nullptr);
+
+struct PackedVertices
+{
+    std::vector<uint8_t> Data;
+    uint32_t NumVertices = 0;
+    uint32_t Stride = 0;
+    std::vector<VertexElement> Layout;
+
+    // position = BoundsMin + POSITION.xyz * BoundsExtent
+    float BoundsMin[3] = {};
+    float BoundsExtent[3] = {};
+};
+
+// Throws std::runtime_error without positions
+PackedVertices PackVertices(const VertexStreams& streams);
+
+struct UnpackedVertices
+{
+    std::vector<float> Positions;
+    std::vector<float> Normals;
+    std::vector<float> Tangents;
+    std::vector<float> TexCoords;
+};
+
+// Back to floats, what the GPU would see (streams that weren't packed stay empty)
+UnpackedVertices UnpackVertices(const PackedVertices& vertices);
+
+// Folds the dequantization into the world matrix (row vectors, like DirectXMath): world = dequantize * world
+void GetDequantizeMatrix(const PackedVertices& vertices, float matrix[4][4]);
+
+// Scalar reference for each attribute
+uint16_t FloatToHalf(float value); // round to nearest even, like the GPU
+float HalfToFloat(uint16_t value);
+void EncodeOctahedral(const float direction[3], int16_t encoded[2]);
+void DecodeOctahedral(const int16_t encoded[2], float direction[3]);
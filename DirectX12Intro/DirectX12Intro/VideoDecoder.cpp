@@ -0,0 +1,336 @@
+// The decode profile GUIDs of d3d12video.h are only declared, this is the one place they get defined
+#include <initguid.h>
+
+#include "VideoDecoder.h"
+
+#include "d3dx12.h"
+#include "GPUMemoryTagging.h"
+#include "Helpers.h"
+
+#include <cassert>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace Microsoft::WRL;
+
+namespace
+{
+    const GUID& GetDecodeProfile(VideoCodec codec)
+    {
+        switch (codec)
+        {
+        case VideoCodec::H264:
+            return D3D12_VIDEO_DECODE_PROFILE_H264;
+        case VideoCodec::HEVC:
+            return D3D12_VIDEO_DECODE_PROFILE_HEVC_MAIN;
+        case VideoCodec::VP9:
+            return D3D12_VIDEO_DECODE_PROFILE_VP9;
+        case VideoCodec::AV1:
+            return D3D12_VIDEO_DECODE_PROFILE_AV1_PROFILE0;
+        }
+        return D3D12_VIDEO_DECODE_PROFILE_H264;
+    }
+
+    D3D12_VIDEO_DECODE_CONFIGURATION GetConfiguration(VideoCodec codec)
+    {
+        return { GetDecodeProfile(codec), D3D12_BITSTREAM_ENCRYPTION_TYPE_NONE, D3D12_VIDEO_FRAME_CODED_INTERLACE_TYPE_NONE };
+    }
+}
+
+VideoDecoder::VideoDecoder(ComPtr<ID3D12Device2> device, ComPtr<ID3D12Fence> graphicsFence, uint32_t maxIdleHeaps)
+    : m_Device(device)
+    , m_GraphicsFence(graphicsFence)
+    , m_HeapCache(maxIdleHeaps)
+{
+    // Fails on devices without any video support
+    ThrowIfFailed(m_Device.As(&m_VideoDevice));
+
+    D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+    queueDesc.Type = D3D12_COMMAND_LIST_TYPE_VIDEO_DECODE;
+    ThrowIfFailed(m_Device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_DecodeQueue)));
+    m_DecodeQueue->SetName(L"Video decode queue");
+
+    for (Allocator& allocator : m_Allocators)
+    {
+        ThrowIfFailed(m_Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_VIDEO_DECODE, IID_PPV_ARGS(&allocator.CommandAllocator)));
+    }
+    ThrowIfFailed(m_Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_VIDEO_DECODE, m_Allocators[0].CommandAllocator.Get(),
+        nullptr, IID_PPV_ARGS(&m_CommandList)));
+    ThrowIfFailed(m_CommandList->Close());
+
+    ThrowIfFailed(m_Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_DecodeFence)));
+    m_FenceEvent = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+    assert(m_FenceEvent && "Failed to create fence event.");
+}
+
+VideoDecoder::~VideoDecoder()
+{
+    WaitForFence(m_DecodeFenceValue);
+    ::CloseHandle(m_FenceEvent);
+}
+
+bool VideoDecoder::IsSupported(const VideoStreamDesc& desc) const
+{
+    D3D12_FEATURE_DATA_VIDEO_DECODE_SUPPORT support = CheckSupport(desc);
+    return (support.SupportFlags & D3D12_VIDEO_DECODE_SUPPORT_FLAG_SUPPORTED) &&
+        !(support.ConfigurationFlags & D3D12_VIDEO_DECODE_CONFIGURATION_FLAG_REFERENCE_ONLY_ALLOCATIONS_REQUIRED);
+}
+
+D3D12_FEATURE_DATA_VIDEO_DECODE_SUPPORT VideoDecoder::CheckSupport(const VideoStreamDesc& desc) const
+{
+    D3D12_FEATURE_DATA_VIDEO_DECODE_SUPPORT support = {};
+    support.Configuration = GetConfiguration(desc.Codec);
+    support.Width = desc.Width;
+    support.Height = desc.Height;
+    support.DecodeFormat = DXGI_FORMAT_NV12;
+    if (FAILED(m_VideoDevice->CheckFeatureSupport(D3D12_FEATURE_VIDEO_DECODE_SUPPORT, &support, sizeof(support))))
+    {
+        support.SupportFlags = D3D12_VIDEO_DECODE_SUPPORT_FLAG_NONE;
+    }
+    return support;
+}
+
+ID3D12VideoDecoder* VideoDecoder::GetDecoder(VideoCodec codec)
+{
+    // The decoder only holds the configuration, every stream of the codec shares it
+    ComPtr<ID3D12VideoDecoder>& decoder = m_Decoders[static_cast<uint32_t>(codec)];
+    if (!decoder)
+    {
+        D3D12_VIDEO_DECODER_DESC decoderDesc = {};
+        decoderDesc.Configuration = GetConfiguration(codec);
+        ThrowIfFailed(m_VideoDevice->CreateVideoDecoder(&decoderDesc, IID_PPV_ARGS(&decoder)));
+    }
+    return decoder.Get();
+}
+
+VideoDecoderHeapId VideoDecoder::AcquireHeap(const VideoStreamDesc& desc)
+{
+    VideoDecoderHeapId id = m_HeapCache.Acquire(desc);
+    if (id != VIDEO_NO_HEAP)
+    {
+        return id;
+    }
+
+    D3D12_VIDEO_DECODER_HEAP_DESC heapDesc = {};
+    heapDesc.Configuration = GetConfiguration(desc.Codec);
+    heapDesc.DecodeWidth = desc.Width;
+    heapDesc.DecodeHeight = desc.Height;
+    heapDesc.Format = DXGI_FORMAT_NV12;
+    heapDesc.MaxDecodePictureBufferCount = desc.MaxReferences;
+
+    ComPtr<ID3D12VideoDecoderHeap> heap;
+    ThrowIfFailed(m_VideoDevice->CreateVideoDecoderHeap(&heapDesc, IID_PPV_ARGS(&heap)));
+    heap->SetName(L"Video decoder heap");
+    GPU_MEMORY_TAG(heap.Get(), "VideoDecoder");
+
+    id = m_HeapCache.Add(desc);
+    if (id >= m_Heaps.size())
+    {
+        m_Heaps.resize(id + 1);
+    }
+    m_Heaps[id] = heap;
+    return id;
+}
+
+void VideoDecoder::ReleaseHeap(VideoDecoderHeapId id)
+{
+    for (VideoDecoderHeapId destroy : m_HeapCache.Release(id))
+    {
+        Retire(m_Heaps[destroy]);
+        m_Heaps[destroy].Reset();
+    }
+}
+
+void VideoDecoder::Retire(ComPtr<ID3D12Pageable> object)
+{
+    m_Retired.push_back({ object, m_DecodeFenceValue });
+}
+
+ID3D12VideoDecodeCommandList* VideoDecoder::BeginCommandList()
+{
+    // Only waits if 4 decodes are still queued
+    Allocator& allocator = m_Allocators[m_AllocatorIndex];
+    WaitForFence(allocator.FenceValue);
+    ThrowIfFailed(allocator.CommandAllocator->Reset());
+    ThrowIfFailed(m_CommandList->Reset(allocator.CommandAllocator.Get()));
+    return m_CommandList.Get();
+}
+
+uint64_t VideoDecoder::Submit()
+{
+    ThrowIfFailed(m_CommandList->Close());
+    ID3D12CommandList* const commandLists[] = { m_CommandList.Get() };
+    m_DecodeQueue->ExecuteCommandLists(_countof(commandLists), commandLists);
+    ThrowIfFailed(m_DecodeQueue->Signal(m_DecodeFence.Get(), ++m_DecodeFenceValue));
+
+    m_Allocators[m_AllocatorIndex].FenceValue = m_DecodeFenceValue;
+    m_AllocatorIndex = (m_AllocatorIndex + 1) % NUM_ALLOCATORS;
+
+    uint64_t completed = m_DecodeFence->GetCompletedValue();
+    while (!m_Retired.empty() && m_Retired.front().FenceValue <= completed)
+    {
+        m_Retired.erase(m_Retired.begin());
+    }
+    return m_DecodeFenceValue;
+}
+
+void VideoDecoder::WaitForFence(uint64_t value)
+{
+    if (m_DecodeFence->GetCompletedValue() < value)
+    {
+        ThrowIfFailed(m_DecodeFence->SetEventOnCompletion(value, m_FenceEvent));
+        ::WaitForSingleObject(m_FenceEvent, INFINITE);
+    }
+}
+
+VideoStream::VideoStream(VideoDecoder& decoder, const VideoStreamDesc& desc, const wchar_t* name)
+    : m_Decoder(decoder)
+    , m_Desc(desc)
+    , m_Pool(GetVideoFramePoolSize(desc))
+{
+    D3D12_FEATURE_DATA_VIDEO_DECODE_SUPPORT support = decoder.CheckSupport(desc);
+    if (!(support.SupportFlags & D3D12_VIDEO_DECODE_SUPPORT_FLAG_SUPPORTED) ||
+        (support.ConfigurationFlags & D3D12_VIDEO_DECODE_CONFIGURATION_FLAG_REFERENCE_ONLY_ALLOCATIONS_REQUIRED))
+    {
+        throw std::runtime_error(std::string("No usable ") + GetVideoCodecName(desc.Codec) + " decode at " +
+            std::to_string(desc.Width) + "x" + std::to_string(desc.Height));
+    }
+
+    // NV12 needs even sizes, some decoders write whole 32 row macroblock rows
+    uint32_t width = (desc.Width + 1) & ~1u;
+    uint32_t height = (desc.Height + 1) & ~1u;
+    if (support.ConfigurationFlags & D3D12_VIDEO_DECODE_CONFIGURATION_FLAG_HEIGHT_ALIGNMENT_MULTIPLE_32_REQUIRED)
+    {
+        height = (height + 31) & ~31u;
+    }
+
+    uint32_t numSlots = m_Pool.GetNumSlots();
+    CD3DX12_RESOURCE_DESC framesDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_NV12, width, height,
+        static_cast<UINT16>(numSlots), 1);
+    CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+    ThrowIfFailed(decoder.m_Device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &framesDesc,
+        D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&m_Frames)));
+    m_Frames->SetName(name);
+    GPU_MEMORY_TAG(m_Frames.Get(), "VideoDecoder", GPUMemoryCategory::Video);
+
+    // The picture parameters index this list, slot i is entry i
+    for (uint32_t slot = 0; slot < numSlots; ++slot)
+    {
+        m_ReferenceTextures.push_back(m_Frames.Get());
+        m_ReferenceSubresources.push_back(D3D12CalcSubresource(0, slot, 0, 1, numSlots));
+    }
+
+    m_Heap = decoder.AcquireHeap(desc);
+}
+
+VideoStream::~VideoStream()
+{
+    m_Decoder.Retire(m_Frames);
+    m_Decoder.ReleaseHeap(m_Heap);
+}
+
+bool VideoStream::BeginFrame(const VideoFrameInfo& frame, VideoDecodeTarget& target)
+{
+    if (!m_Pool.BeginDecode(frame, target))
+    {
+        return false;
+    }
+    m_Target = target;
+    m_Begun = true;
+    return true;
+}
+
+void VideoStream::DecodeFrame(const D3D12_VIDEO_DECODE_FRAME_ARGUMENT* arguments, uint32_t numArguments,
+    ID3D12Resource* bitstream, uint64_t bitstreamOffset, uint64_t bitstreamSize)
+{
+    assert(m_Begun && "DecodeFrame without BeginFrame");
+    assert(numArguments <= D3D12_VIDEO_DECODE_MAX_ARGUMENTS);
+
+    // The last frame that sampled the slot has to be done with it
+    if (m_Target.GraphicsFenceValue)
+    {
+        ThrowIfFailed(m_Decoder.m_DecodeQueue->Wait(m_Decoder.m_GraphicsFence.Get(), m_Target.GraphicsFenceValue));
+    }
+
+    ID3D12VideoDecodeCommandList* commandList = m_Decoder.BeginCommandList();
+
+    std::vector<D3D12_RESOURCE_BARRIER> barriers;
+    AddSlotBarriers(barriers, m_Target.OutputSlot, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_VIDEO_DECODE_WRITE);
+    for (uint32_t slot : m_Target.ReferenceSlots)
+    {
+        AddSlotBarriers(barriers, slot, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_VIDEO_DECODE_READ);
+    }
+    commandList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+
+    D3D12_VIDEO_DECODE_OUTPUT_STREAM_ARGUMENTS output = {};
+    output.pOutputTexture2D = m_Frames.Get();
+    output.OutputSubresource = m_ReferenceSubresources[m_Target.OutputSlot];
+
+    D3D12_VIDEO_DECODE_INPUT_STREAM_ARGUMENTS input = {};
+    input.NumFrameArguments = numArguments;
+    for (uint32_t i = 0; i < numArguments; ++i)
+    {
+        input.FrameArguments[i] = arguments[i];
+    }
+    input.ReferenceFrames.NumTexture2Ds = static_cast<UINT>(m_ReferenceTextures.size());
+    input.ReferenceFrames.ppTexture2Ds = m_ReferenceTextures.data();
+    input.ReferenceFrames.pSubresources = m_ReferenceSubresources.data();
+    input.CompressedBitstream = { bitstream, bitstreamOffset, bitstreamSize };
+    input.pHeap = m_Decoder.m_Heaps[m_Heap].Get();
+
+    commandList->DecodeFrame(m_Decoder.GetDecoder(m_Desc.Codec), &output, &input);
+
+    // Back to COMMON, where the graphics queue can pick them up
+    for (D3D12_RESOURCE_BARRIER& barrier : barriers)
+    {
+        std::swap(barrier.Transition.StateBefore, barrier.Transition.StateAfter);
+    }
+    commandList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+
+    m_Pool.EndDecode(m_Decoder.Submit());
+    m_Begun = false;
+}
+
+VideoPresentFrame VideoStream::Present(ID3D12CommandQueue* graphicsQueue, uint64_t presentationTime, uint64_t graphicsFenceValue)
+{
+    // Only frames the decode queue is done with, the graphics queue's wait below never stalls it
+    uint64_t completed = m_Decoder.m_DecodeFence->GetCompletedValue();
+    VideoPresentFrame present = m_Pool.Present(presentationTime, completed, graphicsFenceValue);
+    if (present.Slot != VIDEO_NO_SLOT)
+    {
+        ThrowIfFailed(graphicsQueue->Wait(m_Decoder.m_DecodeFence.Get(), present.DecodeFenceValue));
+    }
+    return present;
+}
+
+void VideoStream::CreateShaderResourceViews(D3D12_CPU_DESCRIPTOR_HANDLE destination) const
+{
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+    srvDesc.Texture2DArray.MipLevels = 1;
+    srvDesc.Texture2DArray.ArraySize = m_Pool.GetNumSlots();
+
+    UINT descriptorSize = m_Decoder.m_Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+    srvDesc.Format = DXGI_FORMAT_R8_UNORM;
+    srvDesc.Texture2DArray.PlaneSlice = 0;
+    m_Decoder.m_Device->CreateShaderResourceView(m_Frames.Get(), &srvDesc, destination);
+
+    srvDesc.Format = DXGI_FORMAT_R8G8_UNORM;
+    srvDesc.Texture2DArray.PlaneSlice = 1;
+    m_Decoder.m_Device->CreateShaderResourceView(m_Frames.Get(), &srvDesc, CD3DX12_CPU_DESCRIPTOR_HANDLE(destination, 1, descriptorSize));
+}
+
+void VideoStream::AddSlotBarriers(std::vector<D3D12_RESOURCE_BARRIER>& barriers, uint32_t slot, D3D12_RESOURCE_STATES before,
+    D3D12_RESOURCE_STATES after) const
+{
+    // Both planes of the slice
+    uint32_t numSlots = m_Pool.GetNumSlots();
+    for (uint32_t plane = 0; plane < 2; ++plane)
+    {
+        barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(m_Frames.Get(), before, after,
+            D3D12CalcSubresource(0, slot, plane, 1, numSlots)));
+    }
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+// Hardware video decode into textures the graphics queue samples directly (see VideoFramePool.h for the bookkeeping)
+// VideoDecoder owns what streams share: the video device, the decode queue, its command list and fence, the decoders
+// (one per codec) and the decoder heap cache. A VideoStream is one video playing: its NV12 texture array, one slot per
+// pool frame, and the heap it decodes with.
+//
+//   VideoDecodeTarget target;
+//   if (stream.BeginFrame(frame, target))
+//   {
+//       ... write target's slots into the picture parameters (the reference list is every slot, in order) ...
+//       stream.DecodeFrame(arguments, numArguments, bitstream, offset, size);
+//   }
+//   ...
+//   VideoPresentFrame present = stream.Present(graphicsQueue, presentationTime, nextGraphicsFenceValue);
+//   ... sample present.Slot with the SRVs of CreateShaderResourceViews and Shaders/VideoNV12.hlsli ...
+//
+// Turning the bitstream into picture parameters, slice control and the compressed buffer is up to the caller's parser.
+// The texture array stays in COMMON between command lists: the decode command list moves the slots it touches to the
+// decode states and back, the graphics queue promotes a slot to PIXEL_SHADER_RESOURCE implicitly when sampling it.
+// The queues only wait on each other's fences, the CPU never waits for a frame.
+// Needs a driver with decode support for the codec at the size (IsSupported) that doesn't need reference only
+// allocations, those can't be sampled.
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <wrl.h>
+#include <d3d12.h>
+#include <d3d12video.h>
+
+#include "VideoFramePool.h"
+
+#include <cstdint>
+#include <vector>
+
+class VideoDecoder
+{
+public:
+    // graphicsFence is the one the app's graphics queue signals, the decode queue waits on it before reusing a slot
+    VideoDecoder(Microsoft::WRL::ComPtr<ID3D12Device2> device, Microsoft::WRL::ComPtr<ID3D12Fence> graphicsFence,
+        uint32_t maxIdleHeaps = 2);
+    ~VideoDecoder(); // waits for the decode queue, after every VideoStream is gone
+
+    bool IsSupported(const VideoStreamDesc& desc) const;
+
+    Microsoft::WRL::ComPtr<ID3D12CommandQueue> GetDecodeQueue() const { return m_DecodeQueue; }
+    Microsoft::WRL::ComPtr<ID3D12Fence> GetDecodeFence() const { return m_DecodeFence; }
+    const VideoDecoderHeapCacheStats& GetHeapStats() const { return m_HeapCache.GetStats(); }
+
+private:
+    friend class VideoStream;
+
+    struct Allocator
+    {
+        Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CommandAllocator;
+        uint64_t FenceValue;
+    };
+
+    // Destroyed once the decode queue is past FenceValue
+    struct Retired
+    {
+        Microsoft::WRL::ComPtr<ID3D12Pageable> Object;
+        uint64_t FenceValue;
+    };
+
+    D3D12_FEATURE_DATA_VIDEO_DECODE_SUPPORT CheckSupport(const VideoStreamDesc& desc) const;
+    ID3D12VideoDecoder* GetDecoder(VideoCodec codec);
+    VideoDecoderHeapId AcquireHeap(const VideoStreamDesc& desc);
+    void ReleaseHeap(VideoDecoderHeapId id);
+    void Retire(Microsoft::WRL::ComPtr<ID3D12Pageable> object);
+    ID3D12VideoDecodeCommandList* BeginCommandList();
+    uint64_t Submit();
+    void WaitForFence(uint64_t value);
+
+    static const uint32_t NUM_ALLOCATORS = 4;
+
+    Microsoft::WRL::ComPtr<ID3D12Device2> m_Device;
+    Microsoft::WRL::ComPtr<ID3D12VideoDevice> m_VideoDevice;
+    Microsoft::WRL::ComPtr<ID3D12Fence> m_GraphicsFence;
+
+    Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_DecodeQueue;
+    Microsoft::WRL::ComPtr<ID3D12VideoDecodeCommandList> m_CommandList;
+    Allocator m_Allocators[NUM_ALLOCATORS] = {};
+    uint32_t m_AllocatorIndex = 0;
+    Microsoft::WRL::ComPtr<ID3D12Fence> m_DecodeFence;
+    uint64_t m_DecodeFenceValue = 0;
+    HANDLE m_FenceEvent;
+
+    Microsoft::WRL::ComPtr<ID3D12VideoDecoder> m_Decoders[4]; // by VideoCodec
+    VideoDecoderHeapCache m_HeapCache;
+    std::vector<Microsoft::WRL::ComPtr<ID3D12VideoDecoderHeap>> m_Heaps; // by VideoDecoderHeapId
+    std::vector<Retired> m_Retired;
+};
+
+class VideoStream
+{
+public:
+    // Throws std::runtime_error if the decoder can't decode it (see VideoDecoder::IsSupported)
+    VideoStream(VideoDecoder& decoder, const VideoStreamDesc& desc, const wchar_t* name = L"Video frames");
+    ~VideoStream(); // only once the graphics queue is done with the frames it presented
+
+    // VideoFramePool::BeginDecode, then DecodeFrame records and submits the decode into target.OutputSlot
+    bool BeginFrame(const VideoFrameInfo& frame, VideoDecodeTarget& target);
+    void DecodeFrame(const D3D12_VIDEO_DECODE_FRAME_ARGUMENT* arguments, uint32_t numArguments,
+        ID3D12Resource* bitstream, uint64_t bitstreamOffset, uint64_t bitstreamSize);
+
+    // Before graphicsQueue executes the command lists sampling the returned slot, graphicsFenceValue is what it
+    // signals after them
+    VideoPresentFrame Present(ID3D12CommandQueue* graphicsQueue, uint64_t presentationTime, uint64_t graphicsFenceValue);
+
+    // Seeking, the next frame must be a key frame
+    void Flush() { m_Pool.Flush(); }
+
+    // Two Texture2DArray SRVs over every slot, at destination and the descriptor after it: the luma plane (R8_UNORM)
+    // and the chroma plane (R8G8_UNORM, half the size). The shader picks the slice.
+    void CreateShaderResourceViews(D3D12_CPU_DESCRIPTOR_HANDLE destination) const;
+
+    const VideoStreamDesc& GetDesc() const { return m_Desc; }
+    const VideoFramePool& GetPool() const { return m_Pool; }
+    Microsoft::WRL::ComPtr<ID3D12Resource> GetFrames() const { return m_Frames; }
+
+private:
+    void AddSlotBarriers(std::vector<D3D12_RESOURCE_BARRIER>& barriers, uint32_t slot, D3D12_RESOURCE_STATES before,
+        D3D12_RESOURCE_STATES after) const;
+
+    VideoDecoder& m_Decoder;
+    VideoStreamDesc m_Desc;
+    VideoFramePool m_Pool;
+    VideoDecoderHeapId m_Heap;
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_Frames; // NV12 texture array, GetNumSlots slices
+
+    VideoDecodeTarget m_Target = {};
+    bool m_Begun = false;
+    std::vector<ID3D12Resource*> m_ReferenceTextures; // every slot, the reference list of every decode
+    std::vector<UINT> m_ReferenceSubresources;
+};
@@ -0,0 +1,313 @@
+#include "VideoFramePool.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+const char* GetVideoCodecName(VideoCodec codec)
+{
+    switch (codec)
+    {
+    case VideoCodec::H264:
+        return "H.264";
+    case VideoCodec::HEVC:
+        return "HEVC";
+    case VideoCodec::VP9:
+        return "VP9";
+    case VideoCodec::AV1:
+        return "AV1";
+    }
+    return "?";
+}
+
+uint32_t GetVideoFramePoolSize(const VideoStreamDesc& desc)
+{
+    return desc.MaxReferences + 1 + desc.ReorderDepth + 1;
+}
+
+VideoFramePool::VideoFramePool(uint32_t numSlots)
+    : m_Slots(numSlots)
+{
+    if (numSlots < 2)
+    {
+        throw std::runtime_error("A video frame pool needs at least 2 slots");
+    }
+}
+
+bool VideoFramePool::BeginDecode(const VideoFrameInfo& frame, VideoDecodeTarget& target)
+{
+    if (m_Decoding != VIDEO_NO_SLOT)
+    {
+        throw std::runtime_error("BeginDecode of frame " + std::to_string(frame.FrameId) + " before EndDecode");
+    }
+    if (m_AnyDecoded && frame.FrameId <= m_LastFrameId)
+    {
+        throw std::runtime_error("Frame id " + std::to_string(frame.FrameId) + " doesn't follow " + std::to_string(m_LastFrameId));
+    }
+
+    target.ReferenceSlots.clear();
+    for (uint64_t reference : frame.References)
+    {
+        uint32_t slot = FindReference(reference);
+        if (slot == VIDEO_NO_SLOT)
+        {
+            throw std::runtime_error("Frame " + std::to_string(frame.FrameId) + " references frame " + std::to_string(reference) + " which isn't held");
+        }
+        target.ReferenceSlots.push_back(slot);
+    }
+    for (uint64_t reference : frame.Unreference)
+    {
+        if (FindReference(reference) == VIDEO_NO_SLOT)
+        {
+            throw std::runtime_error("Frame " + std::to_string(frame.FrameId) + " drops frame " + std::to_string(reference) + " which isn't held");
+        }
+    }
+
+    // Of the free slots, the one sampled longest ago, the least likely to make the decode queue wait
+    uint32_t output = VIDEO_NO_SLOT;
+    for (uint32_t i = 0; i < m_Slots.size(); ++i)
+    {
+        if (IsFree(i) && (output == VIDEO_NO_SLOT || m_Slots[i].GraphicsFenceValue < m_Slots[output].GraphicsFenceValue))
+        {
+            output = i;
+        }
+    }
+
+    if (output == VIDEO_NO_SLOT)
+    {
+        // Presenting can only free a slot that isn't also a reference
+        bool waitingOnDisplay = false;
+        for (uint32_t i = 0; i < m_Slots.size(); ++i)
+        {
+            waitingOnDisplay |= !m_Slots[i].Reference && (m_Slots[i].Pending || i == m_Current);
+        }
+        if (!waitingOnDisplay)
+        {
+            throw std::runtime_error("All " + std::to_string(m_Slots.size()) + " slots hold references, the pool is too small for the stream");
+        }
+        ++m_Stats.Stalls;
+        return false;
+    }
+
+    Slot& slot = m_Slots[output];
+    slot.FrameId = frame.FrameId;
+    slot.PresentationTime = frame.PresentationTime;
+    slot.DecodeFenceValue = 0;
+    slot.Decoding = true;
+    slot.Reference = frame.IsReference;
+    slot.Pending = true;
+
+    m_Decoding = output;
+    m_Unreference = frame.Unreference;
+    m_AnyDecoded = true;
+    m_LastFrameId = frame.FrameId;
+
+    target.OutputSlot = output;
+    target.GraphicsFenceValue = slot.GraphicsFenceValue;
+    return true;
+}
+
+void VideoFramePool::EndDecode(uint64_t decodeFenceValue)
+{
+    if (m_Decoding == VIDEO_NO_SLOT)
+    {
+        throw std::runtime_error("EndDecode without BeginDecode");
+    }
+
+    Slot& slot = m_Slots[m_Decoding];
+    slot.Decoding = false;
+    slot.DecodeFenceValue = decodeFenceValue;
+    m_Decoding = VIDEO_NO_SLOT;
+
+    for (uint64_t reference : m_Unreference)
+    {
+        m_Slots[FindReference(reference)].Reference = false;
+    }
+    m_Unreference.clear();
+    ++m_Stats.Decoded;
+}
+
+VideoPresentFrame VideoFramePool::Present(uint64_t presentationTime, uint64_t completedDecodeFenceValue, uint64_t graphicsFenceValue)
+{
+    bool haveCurrent = m_Current != VIDEO_NO_SLOT && m_HaveShown;
+    uint64_t shownTime = haveCurrent ? m_Slots[m_Current].PresentationTime : 0;
+
+    uint32_t next = VIDEO_NO_SLOT;
+    for (uint32_t i = 0; i < m_Slots.size(); ++i)
+    {
+        Slot& slot = m_Slots[i];
+        if (!slot.Pending || slot.Decoding)
+        {
+            continue;
+        }
+
+        // Came out of the decoder after a frame that's shown later, too late now
+        if (haveCurrent && slot.PresentationTime <= shownTime)
+        {
+            slot.Pending = false;
+            ++m_Stats.Skipped;
+            continue;
+        }
+
+        if (slot.DecodeFenceValue <= completedDecodeFenceValue && slot.PresentationTime <= presentationTime &&
+            (next == VIDEO_NO_SLOT || slot.PresentationTime > m_Slots[next].PresentationTime))
+        {
+            next = i;
+        }
+    }
+
+    if (next != VIDEO_NO_SLOT)
+    {
+        // What the new frame overtook won't be shown either
+        for (Slot& slot : m_Slots)
+        {
+            if (slot.Pending && !slot.Decoding && &slot != &m_Slots[next] && slot.PresentationTime < m_Slots[next].PresentationTime)
+            {
+                slot.Pending = false;
+                ++m_Stats.Skipped;
+            }
+        }
+
+        m_Slots[next].Pending = false;
+        m_Current = next;
+        m_HaveShown = true;
+        ++m_Stats.Presented;
+    }
+
+    VideoPresentFrame present = { VIDEO_NO_SLOT, 0, 0, 0 };
+    if (m_Current != VIDEO_NO_SLOT)
+    {
+        Slot& slot = m_Slots[m_Current];
+        slot.GraphicsFenceValue = std::max(slot.GraphicsFenceValue, graphicsFenceValue);
+        present = { m_Current, slot.FrameId, slot.PresentationTime, slot.DecodeFenceValue };
+    }
+    return present;
+}
+
+void VideoFramePool::Flush()
+{
+    if (m_Decoding != VIDEO_NO_SLOT)
+    {
+        throw std::runtime_error("Flush between BeginDecode and EndDecode");
+    }
+
+    for (Slot& slot : m_Slots)
+    {
+        slot.Reference = false;
+        slot.Pending = false;
+    }
+    m_AnyDecoded = false;
+    m_HaveShown = false; // the first frame after the seek replaces the current one, whatever its time
+}
+
+uint32_t VideoFramePool::GetNumReferences() const
+{
+    return static_cast<uint32_t>(std::count_if(m_Slots.begin(), m_Slots.end(), [](const Slot& slot) { return slot.Reference; }));
+}
+
+uint32_t VideoFramePool::GetNumFree() const
+{
+    uint32_t numFree = 0;
+    for (uint32_t i = 0; i < m_Slots.size(); ++i)
+    {
+        numFree += IsFree(i) ? 1 : 0;
+    }
+    return numFree;
+}
+
+bool VideoFramePool::IsFree(uint32_t index) const
+{
+    const Slot& slot = m_Slots[index];
+    return !slot.Decoding && !slot.Reference && !slot.Pending && index != m_Current;
+}
+
+uint32_t VideoFramePool::FindReference(uint64_t frameId) const
+{
+    for (uint32_t i = 0; i < m_Slots.size(); ++i)
+    {
+        if (m_Slots[i].Reference && m_Slots[i].FrameId == frameId)
+        {
+            return i;
+        }
+    }
+    return VIDEO_NO_SLOT;
+}
+
+VideoDecoderHeapCache::VideoDecoderHeapCache(uint32_t maxIdle)
+    : m_MaxIdle(maxIdle)
+{
+}
+
+VideoDecoderHeapId VideoDecoderHeapCache::Acquire(const VideoStreamDesc& desc)
+{
+    // The most recently released heap that fits
+    for (size_t i = m_Idle.size(); i-- > 0;)
+    {
+        Heap& heap = m_Heaps[m_Idle[i]];
+        if (heap.Desc.Codec == desc.Codec && heap.Desc.Width == desc.Width && heap.Desc.Height == desc.Height &&
+            heap.Desc.MaxReferences >= desc.MaxReferences)
+        {
+            VideoDecoderHeapId id = m_Idle[i];
+            m_Idle.erase(m_Idle.begin() + i);
+            heap.InUse = true;
+            ++m_Stats.Reused;
+            return id;
+        }
+    }
+    return VIDEO_NO_HEAP;
+}
+
+VideoDecoderHeapId VideoDecoderHeapCache::Add(const VideoStreamDesc& desc)
+{
+    VideoDecoderHeapId id;
+    if (!m_FreeIds.empty())
+    {
+        id = m_FreeIds.back();
+        m_FreeIds.pop_back();
+    }
+    else
+    {
+        id = static_cast<VideoDecoderHeapId>(m_Heaps.size());
+        m_Heaps.emplace_back();
+    }
+
+    m_Heaps[id] = { desc, true, true };
+    ++m_Stats.Created;
+    return id;
+}
+
+std::vector<VideoDecoderHeapId> VideoDecoderHeapCache::Release(VideoDecoderHeapId id)
+{
+    if (!FindHeap(id).InUse)
+    {
+        throw std::runtime_error("Decoder heap " + std::to_string(id) + " released twice");
+    }
+    m_Heaps[id].InUse = false;
+    m_Idle.push_back(id);
+
+    std::vector<VideoDecoderHeapId> destroy;
+    while (m_Idle.size() > m_MaxIdle)
+    {
+        VideoDecoderHeapId oldest = m_Idle.front();
+        m_Idle.erase(m_Idle.begin());
+        m_Heaps[oldest].Alive = false;
+        m_FreeIds.push_back(oldest);
+        destroy.push_back(oldest);
+        ++m_Stats.Destroyed;
+    }
+    return destroy;
+}
+
+const VideoStreamDesc& VideoDecoderHeapCache::GetDesc(VideoDecoderHeapId id) const
+{
+    return FindHeap(id).Desc;
+}
+
+const VideoDecoderHeapCache::Heap& VideoDecoderHeapCache::FindHeap(VideoDecoderHeapId id) const
+{
+    if (id >= m_Heaps.size() || !m_Heaps[id].Alive)
+    {
+        throw std::runtime_error("Invalid decoder heap " + std::to_string(id));
+    }
+    return m_Heaps[id];
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+// Video decode bookkeeping: which texture array slot each decoded frame lives in and when a slot may be written again
+// A stream decodes into one NV12 texture array, every slot holding one frame. A slot is busy while the frame in it is
+//
+//   - a reference later frames predict from (the decoded picture buffer, DPB)
+//   - waiting to be shown (frames come out of the decoder in decode order, B frames make that differ from display order)
+//   - the frame on screen, or one the graphics queue may still be sampling
+//
+// and free otherwise. Nothing is copied: the decode queue writes a slot, the graphics queue waits on the decode fence
+// and samples the same slot (VideoDecoder.h does the D3D12 side).
+//
+//   BeginDecode : picks the frame's output slot and maps its references to slots. The decode queue has to wait for
+//                 the graphics fence value it returns first, the last frame that sampled the slot.
+//   EndDecode   : the decode was submitted and signals the given decode fence value. Drops the references the frame
+//                 says are no longer needed.
+//   Present     : the frame to show at a presentation time, the latest decoded one at or before it, and the decode
+//                 fence value the graphics queue waits on before sampling it.
+//
+// VideoDecoderHeapCache keeps decoder heaps around once a stream is done with them, so the next stream with a
+// compatible configuration doesn't create one again.
+//
+// Only uses the STL, RuntimeBench videodecode runs both against a fake decoder.
+
+#include <cstdint>
+#include <vector>
+
+const uint32_t VIDEO_NO_SLOT = 0xFFFFFFFF;
+
+enum class VideoCodec
+{
+    H264,
+    HEVC,
+    VP9,
+    AV1,
+};
+
+const char* GetVideoCodecName(VideoCodec codec);
+
+// Always decoded to NV12
+struct VideoStreamDesc
+{
+    VideoCodec Codec;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t MaxReferences; // the stream's DPB size, from its sequence header
+    uint32_t ReorderDepth;  // frames decoded ahead of the one to show next, 0 without B frames
+};
+
+// Slots a stream's pool needs so the display never waits on the decoder: the references, the frame being decoded,
+// the frames decoded ahead of display order and the frame on screen (when it's a B frame, not one of the references)
+uint32_t GetVideoFramePoolSize(const VideoStreamDesc& desc);
+
+// What the bitstream parser says about a frame, in decode order
+struct VideoFrameInfo
+{
+    uint64_t FrameId;                 // increases by at least one per frame
+    uint64_t PresentationTime;        // display order, any unit
+    bool IsReference;                 // later frames may predict from it
+    std::vector<uint64_t> References; // frames this one predicts from, references still held
+    std::vector<uint64_t> Unreference; // frames no longer needed as references once this one is decoded
+};
+
+struct VideoDecodeTarget
+{
+    uint32_t OutputSlot;
+    std::vector<uint32_t> ReferenceSlots; // one per VideoFrameInfo::References, in order
+    uint64_t GraphicsFenceValue;          // the decode queue waits for this before writing OutputSlot, 0 = no wait
+};
+
+struct VideoPresentFrame
+{
+    uint32_t Slot;               // VIDEO_NO_SLOT until the first frame is decoded
+    uint64_t FrameId;
+    uint64_t PresentationTime;
+    uint64_t DecodeFenceValue;   // the graphics queue waits for this before sampling Slot
+};
+
+struct VideoFramePoolStats
+{
+    uint64_t Decoded;
+    uint64_t Presented; // distinct frames shown
+    uint64_t Skipped;   // decoded but never shown, the presentation time moved past them
+    uint64_t Stalls;    // BeginDecode calls that found no free slot
+};
+
+class VideoFramePool
+{
+public:
+    explicit VideoFramePool(uint32_t numSlots);
+
+    uint32_t GetNumSlots() const { return static_cast<uint32_t>(m_Slots.size()); }
+
+    // Returns false if no slot is free yet (the caller presents and tries again later). Throws std::runtime_error if
+    // a reference isn't held, the frame id doesn't increase, or the previous BeginDecode wasn't ended.
+    bool BeginDecode(const VideoFrameInfo& frame, VideoDecodeTarget& target);
+    void EndDecode(uint64_t decodeFenceValue);
+
+    // graphicsFenceValue is what the graphics queue signals once the frame sampling the returned slot is done.
+    // Frames whose decode fence hasn't reached completedDecodeFenceValue aren't shown yet, the previous one stays.
+    VideoPresentFrame Present(uint64_t presentationTime, uint64_t completedDecodeFenceValue, uint64_t graphicsFenceValue);
+
+    // Seeking: drops every reference and every frame waiting to be shown, keeps the one on screen
+    void Flush();
+
+    uint32_t GetNumReferences() const;
+    uint32_t GetNumFree() const;
+    const VideoFramePoolStats& GetStats() const { return m_Stats; }
+
+private:
+    struct Slot
+    {
+        uint64_t FrameId = 0;
+        uint64_t PresentationTime = 0;
+        uint64_t DecodeFenceValue = 0;
+        uint64_t GraphicsFenceValue = 0; // the last frame that sampled it
+        bool Decoding = false;
+        bool Reference = false;
+        bool Pending = false; // waiting to be shown
+    };
+
+    bool IsFree(uint32_t index) const;
+    uint32_t FindReference(uint64_t frameId) const;
+
+    std::vector<Slot> m_Slots;
+    uint32_t m_Decoding = VIDEO_NO_SLOT;
+    std::vector<uint64_t> m_Unreference; // the decoding frame's
+    bool m_AnyDecoded = false;
+    uint64_t m_LastFrameId = 0;
+    uint32_t m_Current = VIDEO_NO_SLOT; // on screen
+    bool m_HaveShown = false;           // cleared by Flush
+    VideoFramePoolStats m_Stats = {};
+};
+
+// A decoder heap fits a stream with the same codec and size needing no more references than it was created for
+using VideoDecoderHeapId = uint32_t;
+
+const VideoDecoderHeapId VIDEO_NO_HEAP = 0xFFFFFFFF;
+
+struct VideoDecoderHeapCacheStats
+{
+    uint64_t Created;
+    uint64_t Reused;
+    uint64_t Destroyed;
+};
+
+class VideoDecoderHeapCache
+{
+public:
+    // Keeps up to maxIdle heaps no stream uses
+    explicit VideoDecoderHeapCache(uint32_t maxIdle);
+
+    // An idle heap that fits, or VIDEO_NO_HEAP: then the caller creates one and calls Add
+    VideoDecoderHeapId Acquire(const VideoStreamDesc& desc);
+    VideoDecoderHeapId Add(const VideoStreamDesc& desc);
+
+    // The stream is done with it. Returns the heaps to destroy, the least recently released ones past maxIdle, once the
+    // decode commands already submitted with them are done. Reusing one right away is fine, the next stream's decodes
+    // run after those on the same decode queue.
+    std::vector<VideoDecoderHeapId> Release(VideoDecoderHeapId id);
+
+    const VideoStreamDesc& GetDesc(VideoDecoderHeapId id) const;
+    uint32_t GetNumIdle() const { return static_cast<uint32_t>(m_Idle.size()); }
+    const VideoDecoderHeapCacheStats& GetStats() const { return m_Stats; }
+
+private:
+    struct Heap
+    {
+        VideoStreamDesc Desc;
+        bool Alive;
+        bool InUse;
+    };
+
+    const Heap& FindHeap(VideoDecoderHeapId id) const;
+
+    uint32_t m_MaxIdle;
+    std::vector<Heap> m_Heaps;
+    std::vector<VideoDecoderHeapId> m_FreeIds;
+    std::vector<VideoDecoderHeapId> m_Idle; // least recently released first
+    VideoDecoderHeapCacheStats m_Stats = {};
+};
@@ -1,6 +1,7 @@
 #define WIN32_LEAN_AND_MEAN // Reduces the number of headers included with Windows.h
 #include <Windows.h> // We're gonna be doing some windows stuff (Like creating windows!)
 #include <shellapi.h> // For parsing command line arguments
+#include <Psapi.h> // GetProcessMemoryInfo, for the benchmark
 
 // If min/max C library functions are defined, undefine them
 // We want to use std::min/max and having both will cause conflicts
@@ -40,12 +41,40 @@ using namespace Microsoft::WRL;
 #include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 // Helper functions
 #include "Helpers.h"
+#include "LinkedDevice.h"
+#include "Benchmark.h"
+#include "DynamicResolution.h"
+#include "FrameCapture.h"
+#include "FrameLatency.h"
+#include "FrameLimiter.h"
+#include "GPUBreadcrumbs.h"
+#include "GPUMemoryTagging.h"
+#include "GPUTimer.h"
+#include "ReadbackManager.h"
+#include "RenderPassEncoder.h"
+#include "RenderThread.h"
+#include "ResizeCoalescer.h"
+#include "RuntimeConfig.h"
+#include "RuntimeValidator.h"
+#include "ScaledRenderTarget.h"
+#include "ShaderHotReload.h"
 
-// The number of swap chain back buffers
-const uint8_t g_NumFrames = 3; 
+// Everything tunable, from DirectX12Intro.cfg and the command line (see RuntimeConfig.h).
+// Written before the render thread starts, after that only by the render thread (hot reload).
+RuntimeConfig g_Config;
+std::unique_ptr<ConfigSource> g_ConfigSource;
+
+// The number of swap chain back buffers (frames-in-flight), the per frame arrays are sized for the most it can be
+uint8_t g_NumFrames = 3;
 
 // Use WARP (Software rasterizer) instead of the GPU
 bool g_UseWarp = false;
@@ -68,9 +97,9 @@ RECT g_WindowRect;
 ComPtr<ID3D12Device2> g_Device;
 ComPtr<ID3D12CommandQueue> g_CommandQueue;
 ComPtr<IDXGISwapChain4> g_SwapChain;
-ComPtr<ID3D12Resource> g_BackBuffers[g_NumFrames]; // Buffer and Texture resources are referenced using ID3D12Resource
-ComPtr<ID3D12GraphicsCommandList> g_CommandList; // One for each thread. GPU Commands go in here!
-ComPtr<ID3D12CommandAllocator> g_CommandAllocators[g_NumFrames]; // Memory for GPU commands in the Cmd List. 
+ComPtr<ID3D12Resource> g_BackBuffers[MAX_FRAMES_IN_FLIGHT]; // Buffer and Texture resources are referenced using ID3D12Resource
+ComPtr<ID3D12GraphicsCommandList2> g_CommandList; // One for each thread. GPU Commands go in here!
+ComPtr<ID3D12CommandAllocator> g_CommandAllocators[MAX_FRAMES_IN_FLIGHT]; // Memory for GPU commands in the Cmd List. 
 // Cannot re-use until all its commands are finished executing on the GPU. So we need 1 per render frame/back buffer
 ComPtr<ID3D12DescriptorHeap> g_RTVDescriptorHeap; // Will holds all the descriptors/views, one for each back buffer
 UINT g_RTVDescriptorSize; // Size of a discriptor in heap is vendor specific, so we need to find it at initialization and store it here
@@ -79,15 +108,95 @@ UINT g_CurrentBackBufferIndex; // Stores index of current back buffer on the swa
 // Synchronization objects
 ComPtr<ID3D12Fence> g_Fence; // The Fence Object!
 uint64_t g_FenceValue = 0; //  64 bit unsigned is gigantic, and even if we signal 100 times a frame at 300 FPS, it'll take 20million years before we overflow
-uint64_t g_FrameFenceValues[g_NumFrames] = {}; // a tracking fence value for each rendered frame that's "in-flight" on the Cmd Queue
+uint64_t g_FrameFenceValues[MAX_FRAMES_IN_FLIGHT] = {}; // a tracking fence value for each rendered frame that's "in-flight" on the Cmd Queue
 HANDLE g_FenceEvent; // Will be called when a fence has reached a specific value
 
 // Swap chain control variables
 bool g_Vsync = true; // Wait for next vertical refresh? (caps frame rate to refresh rate of screen)
 bool g_TearingSupported = false;
+double g_TargetFrameRate = 0.0; // Frame rate cap when vsync is off, 0 = unlimited
+FrameLimiter g_FrameLimiter; // Render thread only
+
+// Low latency mode waits on the swap chain's frame latency waitable object at the start of each frame (see FrameLatency.h)
+LatencyMode g_LatencyMode = LatencyMode::Default;
+uint32_t g_MaxFrameLatency = 1; // Frames DXGI may queue in low latency mode
+HANDLE g_FrameLatencyWaitableObject = NULL;
+InputLatencyTracker g_InputLatency; // Render thread only
+
+// Dynamic resolution: the scene is rendered at a scale picked from the measured GPU time, then upscaled to the back buffer
+bool g_DynamicResolution = false;
+DynamicResolutionSettings g_DynamicResolutionSettings;
+std::string g_DynamicResolutionTracePath; // if set, a (scale, GPU time) per frame trace is written here on exit
+std::unique_ptr<DynamicResolutionController> g_DynamicResolutionController;
+std::unique_ptr<ScaledRenderTarget> g_SceneTarget;
+std::unique_ptr<GPUTimer> g_GPUTimer;
+std::vector<DynamicResolutionTraceFrame> g_DynamicResolutionTrace;
+float g_FrameScale[MAX_FRAMES_IN_FLIGHT] = {}; // scale each in-flight frame was rendered at
+
+// Device removed diagnostics: our markers around each pass are always on, DRED only with --dred (or in debug builds)
+bool g_EnableDRED = false;
+std::unique_ptr<GPUBreadcrumbs> g_Breadcrumbs;
+
+// Our own validation of barriers, descriptors, fences and allocators (--validate), a lot cheaper than the debug layer.
+// Render thread only.
+RuntimeValidator g_Validator;
+
+// Linked adapter rendering (--multi-gpu afr/sfr, see MultiGPU.h). Null when only node 0 renders. Render thread only.
+MultiGPUMode g_MultiGPUMode = MultiGPUMode::Single;
+std::unique_ptr<LinkedDevice> g_LinkedDevice;
+ComPtr<ID3D12DescriptorHeap> g_SplitFrameRTVHeap; // an RTV per node's split frame target
+
+// Load/store actions inferred once from the frame's passes (see RenderPass.h), recorded as render passes on tile
+// based renderers. Render thread only.
+std::unique_ptr<RenderPassEncoder> g_RenderPassEncoder;
+RenderPassActions g_ClearPassActions;
+
+// Screenshots (P) and recording (R) of the back buffer, encoded on a worker thread a few frames later (see
+// FrameCapture.h). Not with a linked adapter. Render thread only.
+std::unique_ptr<FrameCapture> g_FrameCapture;
+bool g_ScreenshotRequested = false;
+bool g_Recording = false;
+uint32_t g_NumScreenshots = 0;
+uint32_t g_NumRecordedFrames = 0;
+
+// GPU to CPU readbacks of buffer ranges, resolved a few frames later (see ReadbackManager.h). Not with a linked
+// adapter. Render thread only.
+std::unique_ptr<ReadbackManager> g_ReadbackManager;
+
+// Recompiles the upscale shaders when they're edited (--shader-hot-reload, see ShaderHotReload.h). Only with dynamic
+// resolution, which is what draws with them, and not with a linked adapter. Render thread only.
+std::unique_ptr<ShaderHotReload> g_ShaderHotReload;
+
+// GPU memory snapshots (--memory-snapshots, see GPUMemoryTracker.h), a line of JSON every --memory-snapshot-frames
+// frames: the first with every allocation, the rest with the totals and what changed since the one before.
+// Render thread only.
+std::ofstream g_MemorySnapshotFile;
+GPUMemorySnapshot g_LastMemorySnapshot = {};
+uint64_t g_NumRenderedFrames = 0;
+
+// Benchmark mode (--benchmark <scenario>, see Benchmark.h). Render thread only.
+std::unique_ptr<BenchmarkRun> g_Benchmark;
+uint32_t g_FrameBenchmarkIndex[MAX_FRAMES_IN_FLIGHT] = {}; // benchmark frame each in-flight frame was
+ComPtr<IDXGIAdapter3> g_BenchmarkAdapter; // for the video memory usage
+int g_ExitCode = 0;
+
+// What the frame being recorded did, for the benchmark
+struct FrameCounters
+{
+    uint32_t NumDraws;
+    uint32_t NumBarriers;
+};
+FrameCounters g_FrameCounters = {};
 
 bool g_FullScreen;
 
+// Rendering and presenting happen on their own thread, WndProc just forwards events to it
+std::unique_ptr<RenderThread> g_RenderThread;
+const UINT WM_APP_RENDER_THREAD_EXITED = WM_APP + 1; // posted by the render thread once it's done with the window
+
+// Render thread only. Resize events are collected here, the swap chain is resized once at the start of the next frame
+ResizeCoalescer g_ResizeCoalescer;
+
 // Forward Decleration
 LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM); // Windows message callback procedure
 
@@ -96,26 +205,74 @@ LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM); // Windows message callbac
 void ParseCommandLineArguments()
 {
 	int argc;
-	wchar_t** argv = ::CommandLineToArgvW(::GetCommandLine(), &argc);
+	wchar_t** argv = ::CommandLineToArgvW(::GetCommandLineW(), &argc);
     // :: is for system functions that are defined in global scope
 
-	for (size_t i = 0; i < argc; ++i)
+    // Everything after the program name, as UTF-8 for the config parser
+    std::vector<std::string> args;
+	for (int i = 1; i < argc; ++i)
 	{
-        if (::wcscmp(argv[i], L"-w") == 0 || ::wcscmp(argv[i], L"--width") == 0)
-        {
-            g_ClientWidth = ::wcstol(argv[++i], nullptr, 10);
-        }
-        if (::wcscmp(argv[i], L"-h") == 0 || ::wcscmp(argv[i], L"--height") == 0)
+        // The first call sizes the buffer (with the null terminator, since the length is -1), 0 means it failed
+        int size = ::WideCharToMultiByte(CP_UTF8, 0, argv[i], -1, nullptr, 0, nullptr, nullptr);
+        std::string arg(std::max(size, 1), '\0');
+        if (size == 0 || ::WideCharToMultiByte(CP_UTF8, 0, argv[i], -1, &arg[0], size, nullptr, nullptr) == 0)
         {
-            g_ClientHeight = ::wcstol(argv[++i], nullptr, 10);
+            ::LocalFree(argv);
+            throw std::runtime_error("Command line argument " + std::to_string(i) + " can't be converted to UTF-8");
         }
-        if (::wcscmp(argv[i], L"-warp") == 0 || ::wcscmp(argv[i], L"--warp") == 0)
+        arg.resize(size - 1);
+        args.push_back(std::move(arg));
+    }
+
+    // Free memory allocated by CommandLineToArgvW, once, after we're done with all of it
+    ::LocalFree(argv);
+
+    // DirectX12Intro.cfg in the working directory is used if it's there, --config <path> picks another one
+    g_ConfigSource = std::make_unique<ConfigSource>(args, "DirectX12Intro.cfg");
+    g_Config = g_ConfigSource->Load();
+
+    g_ClientWidth = g_Config.Width;
+    g_ClientHeight = g_Config.Height;
+    g_UseWarp = g_Config.UseWarp;
+    g_NumFrames = static_cast<uint8_t>(g_Config.FramesInFlight);
+    g_Vsync = g_Config.Vsync;
+    g_TargetFrameRate = g_Config.TargetFrameRate;
+    g_LatencyMode = g_Config.LowLatency ? LatencyMode::LowLatency : LatencyMode::Default;
+    g_MaxFrameLatency = g_Config.MaxFrameLatency;
+    g_DynamicResolution = g_Config.DynamicResolution;
+    g_DynamicResolutionSettings.TargetFrameTimeMs = g_Config.GPUBudgetMs;
+    g_DynamicResolutionTracePath = g_Config.DynamicResolutionTrace;
+    g_EnableDRED = g_Config.DRED;
+    g_Validator.SetEnabled(g_Config.Validate);
+
+    if (!ParseMultiGPUMode(g_Config.MultiGPU, g_MultiGPUMode))
+    {
+        throw std::runtime_error("Unknown multi-gpu mode " + g_Config.MultiGPU + " (single, afr or sfr)");
+    }
+
+    if (!g_Config.Benchmark.empty())
+    {
+        const BenchmarkScenario* scenario = FindBenchmarkScenario(g_Config.Benchmark);
+        if (!scenario)
         {
-            g_UseWarp = true;
+            throw std::runtime_error("Unknown benchmark scenario " + g_Config.Benchmark);
         }
 
-        // Free memory allocated by CommandLineToArgvW
-        ::LocalFree(argv);
+        // Nothing may pace the frames but the frames themselves, and the scene comes from the script
+        BenchmarkFrame firstFrame = scenario->GetFrame(0);
+        g_ClientWidth = firstFrame.Width;
+        g_ClientHeight = firstFrame.Height;
+        g_Vsync = false;
+        g_TargetFrameRate = 0.0;
+        g_DynamicResolution = scenario->ScaledRendering;
+    }
+
+    // The linked adapter path is a plain clear per node, without the scaled scene target, and our validation
+    // only follows the single GPU path
+    if (g_MultiGPUMode != MultiGPUMode::Single)
+    {
+        g_DynamicResolution = false;
+        g_Validator.SetEnabled(false);
     }
 }
 
@@ -131,6 +288,38 @@ void EnableDebugLayer()
     // IID_PPV_ARGS retrieves an interface pointer based on the type of interface pointer used
     debugInterface->EnableDebugLayer();
 #endif
+
+#if defined(_DEBUG)
+    g_EnableDRED = true;
+#endif
+    // Same deal, DRED has to be on before the device is created to record anything
+    if (g_EnableDRED)
+    {
+        EnableDRED();
+    }
+}
+
+// Called from ThrowIfFailed the first time a call fails because the device was removed (see Helpers.h).
+// Writes out where the GPU got to, to the debugger output and to DeviceRemoved.txt next to the exe.
+HRESULT OnDeviceRemoved()
+{
+    HRESULT reason = g_Device->GetDeviceRemovedReason();
+
+    char buffer[128];
+    sprintf_s(buffer, "Device removed, reason 0x%08X\n", static_cast<unsigned>(reason));
+    std::string report = buffer;
+    if (g_Breadcrumbs)
+    {
+        report += g_Breadcrumbs->GetReport();
+    }
+    if (g_EnableDRED)
+    {
+        report += GetDREDReport(g_Device.Get());
+    }
+
+    ::OutputDebugStringA(report.c_str());
+    std::ofstream("DeviceRemoved.txt") << report;
+    return reason;
 }
 
 // Register and Creating the Window
@@ -147,7 +336,7 @@ void RegisterWindowClass(HINSTANCE hInst, const wchar_t* windowClassName)
     windowClass.cbWndExtra = 0; // Extra bytes to allocate following the window instance
     windowClass.hInstance = hInst; // Handle to instance that contains window procedure for this class
     windowClass.hIcon = ::LoadIcon(hInst, NULL); // A handle to the class icon (seen in taskbar), null for default application icon
-    windowClass.hCursor = ::LoadCursor(hInst, IDC_ARROW); // A handle to the class cursor. IDC_ARROW is default
+    windowClass.hCursor = ::LoadCursor(NULL, IDC_ARROW); // A handle to the class cursor. IDC_ARROW is a system one, so no instance
     windowClass.hbrBackground = (HBRUSH)(COLOR_WINDOW + 1); // A handle to background brush. Can be a system color + 1 cast to an HBRUSH
     windowClass.lpszMenuName = NULL; // char string to resource name of class menu. NULL = no default menu.
     windowClass.lpszClassName = windowClassName; // name of this window
@@ -191,8 +380,11 @@ HWND CreateWindow(const wchar_t* windowClassName, HINSTANCE hInst,
         nullptr // pointer to a value to be passed to the window through a bunch of other shit
     );
 
+    assert(hWnd && "Failed to create window");
+
     // Window is created, but it's not being shown yet
     // Still needs to the device and cmd q to be created and initialized
+    return hWnd;
 }
 
 // Query DirectX 12 Adapter
@@ -216,7 +408,1180 @@ ComPtr<IDXGIAdapter4> GetAdapter(bool useWarp)
     }
     else
     {
+        // Pick the hardware adapter with the most dedicated video memory that can actually create a D3D12 device
+        SIZE_T maxDedicatedVideoMemory = 0;
+        for (UINT i = 0; dxgiFactory->EnumAdapters1(i, &dxgiAdapter1) != DXGI_ERROR_NOT_FOUND; ++i)
+        {
+            DXGI_ADAPTER_DESC1 dxgiAdapterDesc1;
+            dxgiAdapter1->GetDesc1(&dxgiAdapterDesc1);
+
+            // Passing nullptr for the device only checks that creating one would succeed
+            if ((dxgiAdapterDesc1.Flags & DXGI_ADAPTER_FLAG_SOFTWARE) == 0 &&
+                SUCCEEDED(D3D12CreateDevice(dxgiAdapter1.Get(), D3D_FEATURE_LEVEL_11_0, __uuidof(ID3D12Device), nullptr)) &&
+                dxgiAdapterDesc1.DedicatedVideoMemory > maxDedicatedVideoMemory)
+            {
+                maxDedicatedVideoMemory = dxgiAdapterDesc1.DedicatedVideoMemory;
+                ThrowIfFailed(dxgiAdapter1.As(&dxgiAdapter4));
+            }
+        }
+
+        if (!dxgiAdapter4)
+        {
+            throw std::runtime_error("No adapter supports Direct3D 12, try --warp");
+        }
+    }
+
+    return dxgiAdapter4;
+}
+
+// Create the DirectX 12 Device, the memory context that tracks allocations in GPU memory.
+// Destroying it frees everything allocated with it.
+ComPtr<ID3D12Device2> CreateDevice(ComPtr<IDXGIAdapter4> adapter)
+{
+    ComPtr<ID3D12Device2> d3d12Device2;
+    ThrowIfFailed(D3D12CreateDevice(adapter.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&d3d12Device2)));
+
+#if defined(_DEBUG)
+    // Break on the debug layer's errors, so they show up where they happen
+    ComPtr<ID3D12InfoQueue> infoQueue;
+    if (SUCCEEDED(d3d12Device2.As(&infoQueue)))
+    {
+        infoQueue->SetBreakOnSeverity(D3D12_MESSAGE_SEVERITY_CORRUPTION, TRUE);
+        infoQueue->SetBreakOnSeverity(D3D12_MESSAGE_SEVERITY_ERROR, TRUE);
+        infoQueue->SetBreakOnSeverity(D3D12_MESSAGE_SEVERITY_WARNING, TRUE);
+
+        // Info messages are just noise
+        D3D12_MESSAGE_SEVERITY severities[] = { D3D12_MESSAGE_SEVERITY_INFO };
+
+        // Clearing with a color other than the one the resource was created with is only a performance hint,
+        // and the two map/unmap ones are known to fire with graphics debuggers attached
+        D3D12_MESSAGE_ID denyIds[] = {
+            D3D12_MESSAGE_ID_CLEARRENDERTARGETVIEW_MISMATCHINGCLEARVALUE,
+            D3D12_MESSAGE_ID_MAP_INVALID_NULLRANGE,
+            D3D12_MESSAGE_ID_UNMAP_INVALID_NULLRANGE,
+        };
+
+        D3D12_INFO_QUEUE_FILTER newFilter = {};
+        newFilter.DenyList.NumSeverities = _countof(severities);
+        newFilter.DenyList.pSeverityList = severities;
+        newFilter.DenyList.NumIDs = _countof(denyIds);
+        newFilter.DenyList.pIDList = denyIds;
+
+        ThrowIfFailed(infoQueue->PushStorageFilter(&newFilter));
+    }
+#endif
+
+    return d3d12Device2;
+}
+
+// Create a command queue. DIRECT takes draw, compute and copy commands, COMPUTE and COPY only their own.
+ComPtr<ID3D12CommandQueue> CreateCommandQueue(ComPtr<ID3D12Device2> device, D3D12_COMMAND_LIST_TYPE type)
+{
+    ComPtr<ID3D12CommandQueue> d3d12CommandQueue;
+
+    D3D12_COMMAND_QUEUE_DESC desc = {};
+    desc.Type = type;
+    desc.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL;
+    desc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+    desc.NodeMask = 0; // single GPU, LinkedDevice makes its own queues for the other nodes
+
+    ThrowIfFailed(device->CreateCommandQueue(&desc, IID_PPV_ARGS(&d3d12CommandQueue)));
+
+    return d3d12CommandQueue;
+}
+
+// Variable refresh rate displays need tearing to be allowed to show frames as soon as they're presented with vsync off
+bool CheckTearingSupport()
+{
+    BOOL allowTearing = FALSE;
+
+    // Rather than create the DXGI 1.5 factory interface directly, we create the
+    // DXGI 1.4 interface and query for the 1.5 interface. This is to enable the
+    // graphics debugging tools which will not support the 1.5 factory interface
+    // until a future update.
+    ComPtr<IDXGIFactory4> factory4;
+    if (SUCCEEDED(CreateDXGIFactory1(IID_PPV_ARGS(&factory4))))
+    {
+        ComPtr<IDXGIFactory5> factory5;
+        if (SUCCEEDED(factory4.As(&factory5)))
+        {
+            if (FAILED(factory5->CheckFeatureSupport(DXGI_FEATURE_PRESENT_ALLOW_TEARING, &allowTearing, sizeof(allowTearing))))
+            {
+                allowTearing = FALSE;
+            }
+        }
+    }
+
+    return allowTearing == TRUE;
+}
+
+// Create the swap chain
+ComPtr<IDXGISwapChain4> CreateSwapChain(HWND hWnd, ComPtr<ID3D12CommandQueue> commandQueue,
+    uint32_t width, uint32_t height, uint32_t bufferCount)
+{
+    ComPtr<IDXGISwapChain4> dxgiSwapChain4;
+    ComPtr<IDXGIFactory4> dxgiFactory4;
+    UINT createFactoryFlags = 0;
+#if defined(_DEBUG)
+    createFactoryFlags = DXGI_CREATE_FACTORY_DEBUG;
+#endif
+    ThrowIfFailed(CreateDXGIFactory2(createFactoryFlags, IID_PPV_ARGS(&dxgiFactory4)));
+
+    DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
+    swapChainDesc.Width = width;
+    swapChainDesc.Height = height;
+    swapChainDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    swapChainDesc.Stereo = FALSE;
+    swapChainDesc.SampleDesc = { 1, 0 }; // flip model swap chains can't be multisampled
+    swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+    swapChainDesc.BufferCount = bufferCount;
+    swapChainDesc.Scaling = DXGI_SCALING_STRETCH;
+    swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+    swapChainDesc.AlphaMode = DXGI_ALPHA_MODE_UNSPECIFIED;
+    // It is recommended to always allow tearing if tearing support is available
+    // (it's only actually used when presenting with DXGI_PRESENT_ALLOW_TEARING)
+    g_TearingSupported = g_Config.AllowTearing && CheckTearingSupport();
+    swapChainDesc.Flags = g_TearingSupported ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0;
+    // Lets us wait for the swap chain to have room for a frame before starting it, instead of blocking in Present
+    if (g_LatencyMode == LatencyMode::LowLatency)
+    {
+        swapChainDesc.Flags |= DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+    }
+
+    ComPtr<IDXGISwapChain1> swapChain1;
+    ThrowIfFailed(dxgiFactory4->CreateSwapChainForHwnd(commandQueue.Get(), hWnd, &swapChainDesc, nullptr, nullptr, &swapChain1));
+
+    // Disable the Alt+Enter fullscreen toggle feature. Switching to fullscreen will be handled manually
+    ThrowIfFailed(dxgiFactory4->MakeWindowAssociation(hWnd, DXGI_MWA_NO_ALT_ENTER));
+
+    ThrowIfFailed(swapChain1.As(&dxgiSwapChain4));
+
+    if (g_LatencyMode == LatencyMode::LowLatency)
+    {
+        // Has to be set on the swap chain itself when it's waitable (IDXGIDevice1::SetMaximumFrameLatency is ignored)
+        ThrowIfFailed(dxgiSwapChain4->SetMaximumFrameLatency(g_MaxFrameLatency));
+        g_FrameLatencyWaitableObject = dxgiSwapChain4->GetFrameLatencyWaitableObject();
+    }
+
+    return dxgiSwapChain4;
+}
+
+// A descriptor heap is an array of views (RTV, SRV, UAV or CBV), RTVs need one per back buffer
+ComPtr<ID3D12DescriptorHeap> CreateDescriptorHeap(ComPtr<ID3D12Device2> device, D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t numDescriptors)
+{
+    ComPtr<ID3D12DescriptorHeap> descriptorHeap;
+
+    D3D12_DESCRIPTOR_HEAP_DESC desc = {};
+    desc.NumDescriptors = numDescriptors;
+    desc.Type = type;
+
+    ThrowIfFailed(device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&descriptorHeap)));
+
+    return descriptorHeap;
+}
+
+// Backing memory for the commands recorded into a command list. Can only be reset once the GPU is done with them.
+ComPtr<ID3D12CommandAllocator> CreateCommandAllocator(ComPtr<ID3D12Device2> device, D3D12_COMMAND_LIST_TYPE type)
+{
+    ComPtr<ID3D12CommandAllocator> commandAllocator;
+    ThrowIfFailed(device->CreateCommandAllocator(type, IID_PPV_ARGS(&commandAllocator)));
+
+    return commandAllocator;
+}
+
+// Command lists are created in the recording state, closed here so the first frame can Reset it like every other
+ComPtr<ID3D12GraphicsCommandList2> CreateCommandList(ComPtr<ID3D12Device2> device,
+    ComPtr<ID3D12CommandAllocator> commandAllocator, D3D12_COMMAND_LIST_TYPE type)
+{
+    ComPtr<ID3D12GraphicsCommandList2> commandList;
+    ThrowIfFailed(device->CreateCommandList(0, type, commandAllocator.Get(), nullptr, IID_PPV_ARGS(&commandList)));
+
+    ThrowIfFailed(commandList->Close());
+
+    return commandList;
+}
+
+// Synchronization
+
+ComPtr<ID3D12Fence> CreateFence(ComPtr<ID3D12Device2> device)
+{
+    ComPtr<ID3D12Fence> fence;
+    ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence)));
+
+    return fence;
+}
+
+// OS event the CPU blocks on while waiting for a fence value
+HANDLE CreateEventHandle()
+{
+    HANDLE fenceEvent = ::CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (!fenceEvent)
+    {
+        throw std::runtime_error("Failed to create fence event");
+    }
+
+    return fenceEvent;
+}
+
+// Stall the CPU until the fence has reached the given value
+void WaitForFenceValue(ComPtr<ID3D12Fence> fence, uint64_t fenceValue, HANDLE fenceEvent,
+    std::chrono::milliseconds duration = std::chrono::milliseconds::max())
+{
+    if (fence->GetCompletedValue() < fenceValue)
+    {
+        ThrowIfFailed(fence->SetEventOnCompletion(fenceValue, fenceEvent));
+        ::WaitForSingleObject(fenceEvent, static_cast<DWORD>(duration.count()));
+    }
+}
+
+// The two waits a frame needs, in whichever order the FrameSequencer asks for them
+class SwapChainFrameWaits : public IFrameWaits
+{
+public:
+    void WaitForSwapChain() override
+    {
+        // Timeout so a swap chain that's stuck (e.g. the window being torn down) can't hang the render thread
+        ::WaitForSingleObjectEx(g_FrameLatencyWaitableObject, 1000, TRUE);
+    }
+
+    void WaitForFrameFence(uint32_t backBufferIndex) override
+    {
+        if (g_LinkedDevice)
+        {
+            g_LinkedDevice->WaitForFrame(backBufferIndex);
+            return;
+        }
+        WaitForFenceValue(g_Fence, g_FrameFenceValues[backBufferIndex], g_FenceEvent);
+    }
+};
+
+SwapChainFrameWaits g_FrameWaits;
+std::unique_ptr<FrameSequencer> g_FrameSequencer;
+
+// Signal the fence from the GPU side, returns the value to wait for
+uint64_t Signal(ComPtr<ID3D12CommandQueue> commandQueue, ComPtr<ID3D12Fence> fence, uint64_t& fenceValue)
+{
+    uint64_t fenceValueForSignal = ++fenceValue;
+    ThrowIfFailed(commandQueue->Signal(fence.Get(), fenceValueForSignal));
+    g_Validator.OnSignal(fence.Get(), fenceValueForSignal);
+
+    return fenceValueForSignal;
+}
+
+// Wait for everything queued so far to finish on the GPU
+void Flush(ComPtr<ID3D12CommandQueue> commandQueue, ComPtr<ID3D12Fence> fence, uint64_t& fenceValue, HANDLE fenceEvent)
+{
+    uint64_t fenceValueForSignal = Signal(commandQueue, fence, fenceValue);
+    WaitForFenceValue(fence, fenceValueForSignal, fenceEvent);
+}
+
+// Resizing
+
+// (Re)creates one RTV per back buffer, in the same slots of the descriptor heap
+// Nothing else (heaps, allocators, command list) depends on the swap chain size, so nothing else is recreated
+void UpdateRenderTargetViews(ComPtr<ID3D12Device2> device, ComPtr<IDXGISwapChain4> swapChain, ComPtr<ID3D12DescriptorHeap> descriptorHeap)
+{
+    auto rtvDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+
+    CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(descriptorHeap->GetCPUDescriptorHandleForHeapStart());
+
+    for (int i = 0; i < g_NumFrames; ++i)
+    {
+        ComPtr<ID3D12Resource> backBuffer;
+        ThrowIfFailed(swapChain->GetBuffer(i, IID_PPV_ARGS(&backBuffer)));
+
+        device->CreateRenderTargetView(backBuffer.Get(), nullptr, rtvHandle);
+        g_Validator.OnResourceCreated(backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT, "Back buffer");
+        g_Validator.OnDescriptorCreated(rtvHandle.ptr, backBuffer.Get());
+        backBuffer->SetName(L"Back buffer");
+        GPU_MEMORY_TAG(backBuffer.Get(), "SwapChain");
+
+        g_BackBuffers[i] = backBuffer;
+
+        rtvHandle.Offset(rtvDescriptorSize);
+    }
+}
+
+// SFR: a back buffer sized target per node for the bands, with an RTV each
+void CreateSplitFrameTargets(uint32_t width, uint32_t height)
+{
+    CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, width, height, 1, 1, 1, 0,
+        D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
+    g_LinkedDevice->SetSplitFrameTarget(desc, L"Split frame target");
+
+    if (!g_SplitFrameRTVHeap)
+    {
+        D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+        heapDesc.NumDescriptors = MAX_NODES;
+        heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+        ThrowIfFailed(g_Device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&g_SplitFrameRTVHeap)));
+        g_SplitFrameRTVHeap->SetName(L"Split frame RTV");
+        GPU_MEMORY_TAG(g_SplitFrameRTVHeap.Get(), "SplitFrame");
+    }
+
+    CD3DX12_CPU_DESCRIPTOR_HANDLE rtv(g_SplitFrameRTVHeap->GetCPUDescriptorHandleForHeapStart());
+    for (uint32_t node = 0; node < g_LinkedDevice->GetNumNodes(); ++node)
+    {
+        g_Device->CreateRenderTargetView(g_LinkedDevice->GetSplitFrameTarget(node), nullptr, rtv);
+        rtv.Offset(g_RTVDescriptorSize);
+    }
+}
+
+// Applies the latest size from the Resize events, if any. Call at the start of a frame, before touching the back buffers.
+// However many WM_SIZE messages came in since the last frame, this resizes at most once.
+void Resize()
+{
+    uint32_t width, height;
+    if (!g_ResizeCoalescer.ConsumePending(g_ClientWidth, g_ClientHeight, width, height))
+    {
+        return;
+    }
+
+    // ResizeBuffers needs every reference to the old back buffers gone, GPU side included.
+    // The only GPU work that references them is the frames still in flight, so wait for the last of those
+    // rather than flushing the whole queue. If they're already done (usually the case while dragging) this doesn't wait at all.
+    uint64_t lastFrameFenceValue = *std::max_element(g_FrameFenceValues, g_FrameFenceValues + g_NumFrames);
+    auto waitStart = std::chrono::steady_clock::now();
+    if (g_LinkedDevice)
+    {
+        g_LinkedDevice->Flush(); // the frames in flight are spread over the nodes
+    }
+    else
+    {
+        WaitForFenceValue(g_Fence, lastFrameFenceValue, g_FenceEvent);
+    }
+    auto waitEnd = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < g_NumFrames; ++i)
+    {
+        g_Validator.OnResourceReleased(g_BackBuffers[i].Get());
+        g_BackBuffers[i].Reset();
+        // Every frame is retired now, so all back buffers are free to use
+        g_FrameFenceValues[i] = g_FrameFenceValues[g_CurrentBackBufferIndex];
+    }
+
+    // Keep the format and flags (e.g. DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING) the swap chain was created with
+    if (g_LinkedDevice)
+    {
+        g_LinkedDevice->ResizeSwapChain(g_SwapChain.Get(), width, height);
+        if (g_LinkedDevice->GetMode() == MultiGPUMode::SplitFrame)
+        {
+            CreateSplitFrameTargets(width, height);
+        }
+    }
+    else
+    {
+        DXGI_SWAP_CHAIN_DESC swapChainDesc = {};
+        ThrowIfFailed(g_SwapChain->GetDesc(&swapChainDesc));
+        ThrowIfFailed(g_SwapChain->ResizeBuffers(g_NumFrames, width, height,
+            swapChainDesc.BufferDesc.Format, swapChainDesc.Flags));
+    }
+
+    g_CurrentBackBufferIndex = g_SwapChain->GetCurrentBackBufferIndex();
+
+    UpdateRenderTargetViews(g_Device, g_SwapChain, g_RTVDescriptorHeap);
+
+    // Usually fits already, scale changes never get here
+    if (g_SceneTarget)
+    {
+        g_SceneTarget->SetOutputSize(width, height);
+    }
+
+    g_ClientWidth = width;
+    g_ClientHeight = height;
+
+    g_ResizeCoalescer.OnResized();
+
+    // Latency is from the first WM_SIZE of this resize until the new back buffers are ready
+    ResizeCoalescer::Stats stats = g_ResizeCoalescer.GetStats();
+    char buffer[256];
+    sprintf_s(buffer, "Resize to %ux%u: %.2f ms (%.2f ms waiting on the GPU), %u size events for %u resizes\n",
+        width, height, stats.LastLatencyMs,
+        std::chrono::duration<double, std::milli>(waitEnd - waitStart).count(),
+        stats.NumEvents, stats.NumResizes);
+    ::OutputDebugStringA(buffer);
+}
+
+// Rendering (everything from here down to the window messages runs on the render thread)
+
+void TransitionResource(ID3D12GraphicsCommandList2* commandList, ID3D12Resource* resource,
+    D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after)
+{
+    g_Validator.OnBarrier(commandList, resource, before, after);
+    ++g_FrameCounters.NumBarriers;
+
+    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(resource, before, after);
+    commandList->ResourceBarrier(1, &barrier);
+}
+
+// Render with a linked adapter. AFR clears the back buffer on whichever node owns it. In SFR every node clears
+// its band of its split frame target (in its own shade, so the split shows), node 0 gets the others' bands copied in
+// and copies the whole frame to the back buffer.
+void RenderLinked()
+{
+    auto backBuffer = g_BackBuffers[g_CurrentBackBufferIndex];
+    const MultiGPUFrame& frame = g_LinkedDevice->BeginFrame(g_CurrentBackBufferIndex);
+
+    if (g_LinkedDevice->GetMode() == MultiGPUMode::SplitFrame)
+    {
+        CD3DX12_CPU_DESCRIPTOR_HANDLE rtv(g_SplitFrameRTVHeap->GetCPUDescriptorHandleForHeapStart());
+        for (uint32_t node = 0; node < g_LinkedDevice->GetNumNodes(); ++node)
+        {
+            ID3D12GraphicsCommandList2* commandList = g_LinkedDevice->GetCommandList(node);
+            ID3D12Resource* target = g_LinkedDevice->GetSplitFrameTarget(node);
+            NodeBand band = g_LinkedDevice->GetScheduler().GetBand(node, g_ClientHeight);
+
+            FLOAT clearColor[] = { 0.4f, 0.6f - 0.2f * node, 0.9f, 1.0f };
+            D3D12_RECT bandRect = { 0, static_cast<LONG>(band.Top), static_cast<LONG>(g_ClientWidth), static_cast<LONG>(band.Bottom) };
+            TransitionResource(commandList, target, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_RENDER_TARGET);
+            commandList->ClearRenderTargetView(rtv, clearColor, 1, &bandRect);
+            TransitionResource(commandList, target, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_COMMON);
+            rtv.Offset(g_RTVDescriptorSize);
+        }
+
+        g_LinkedDevice->BeginDependentWork();
+        ID3D12GraphicsCommandList2* commandList = g_LinkedDevice->GetCommandList(0);
+        ID3D12Resource* target = g_LinkedDevice->GetSplitFrameTarget(0);
+        TransitionResource(commandList, target, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_SOURCE);
+        TransitionResource(commandList, backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_COPY_DEST);
+        commandList->CopyResource(backBuffer.Get(), target);
+        TransitionResource(commandList, backBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PRESENT);
+        TransitionResource(commandList, target, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_COMMON);
+    }
+    else
+    {
+        ID3D12GraphicsCommandList2* commandList = g_LinkedDevice->GetCommandList(frame.PresentNode);
+        FLOAT clearColor[] = { 0.4f, 0.6f, 0.9f, 1.0f };
+        CD3DX12_CPU_DESCRIPTOR_HANDLE rtv(g_RTVDescriptorHeap->GetCPUDescriptorHandleForHeapStart(),
+            g_CurrentBackBufferIndex, g_RTVDescriptorSize);
+
+        TransitionResource(commandList, backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
+        commandList->ClearRenderTargetView(rtv, clearColor, 0, nullptr);
+        TransitionResource(commandList, backBuffer.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+    }
+
+    g_LinkedDevice->EndFrame();
+
+    if (!g_Vsync)
+    {
+        g_FrameLimiter.Wait();
+    }
+
+    UINT syncInterval = g_Vsync ? 1 : 0;
+    UINT presentFlags = g_TearingSupported && !g_Vsync ? DXGI_PRESENT_ALLOW_TEARING : 0;
+    ThrowIfFailed(g_SwapChain->Present(syncInterval, presentFlags));
+    g_InputLatency.OnPresent();
+
+    g_CurrentBackBufferIndex = g_SwapChain->GetCurrentBackBufferIndex();
+}
+
+void Render()
+{
+    if (g_LinkedDevice)
+    {
+        RenderLinked();
+        return;
+    }
+
+    auto commandAllocator = g_CommandAllocators[g_CurrentBackBufferIndex];
+    auto backBuffer = g_BackBuffers[g_CurrentBackBufferIndex];
+
+    if (g_Validator.IsEnabled())
+    {
+        g_Validator.OnAllocatorReset(commandAllocator.Get(), g_Fence->GetCompletedValue());
+        g_Validator.OnCommandListReset(g_CommandList.Get());
+    }
+    commandAllocator->Reset();
+    g_CommandList->Reset(commandAllocator.Get(), nullptr);
+
+    if (g_GPUTimer)
+    {
+        g_GPUTimer->Begin(g_CommandList.Get(), g_CurrentBackBufferIndex);
+    }
+
+    FLOAT clearColor[] = { 0.4f, 0.6f, 0.9f, 1.0f };
+    CD3DX12_CPU_DESCRIPTOR_HANDLE rtv(g_RTVDescriptorHeap->GetCPUDescriptorHandleForHeapStart(),
+        g_CurrentBackBufferIndex, g_RTVDescriptorSize);
+
+    if (g_DynamicResolution)
+    {
+        // Render the scene at the scaled size...
+        float scale = g_Benchmark ? g_Benchmark->GetFrame().RenderScale : g_DynamicResolutionController->GetScale();
+        g_FrameScale[g_CurrentBackBufferIndex] = scale;
+
+        uint32_t marker = g_Breadcrumbs->BeginPass(g_CommandList.Get(), "Scene");
+        D3D12_CPU_DESCRIPTOR_HANDLE sceneRTV = g_SceneTarget->Begin(g_CommandList.Get(), scale);
+        D3D12_RECT renderRect = g_SceneTarget->GetRenderRect();
+        g_CommandList->ClearRenderTargetView(sceneRTV, clearColor, 1, &renderRect);
+        g_Breadcrumbs->EndPass(g_CommandList.Get(), marker);
+
+        // ...and stretch it over the back buffer, which is entirely overwritten so it doesn't need a clear
+        TransitionResource(g_CommandList.Get(), backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
+
+        marker = g_Breadcrumbs->BeginPass(g_CommandList.Get(), "Upscale");
+        g_Validator.OnDescriptorUsed(rtv.ptr);
+        g_SceneTarget->Upscale(g_CommandList.Get(), rtv);
+        g_FrameCounters.NumBarriers += 2; // the scene target, in Begin and Upscale
+        ++g_FrameCounters.NumDraws;
+        g_Breadcrumbs->EndPass(g_CommandList.Get(), marker);
+    }
+    else
+    {
+        // Clear the render target (barriers can't go inside a render pass)
+        TransitionResource(g_CommandList.Get(), backBuffer.Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
+
+        uint32_t marker = g_Breadcrumbs->BeginPass(g_CommandList.Get(), "Clear");
+        g_Validator.OnDescriptorUsed(rtv.ptr);
+        RenderPassTarget target = { rtv, backBuffer.Get(), DXGI_FORMAT_R8G8B8A8_UNORM };
+        std::copy(clearColor, clearColor + 4, target.ClearColor);
+        g_RenderPassEncoder->Begin(g_CommandList.Get(), g_ClearPassActions, &target, 1);
+        g_RenderPassEncoder->End(g_CommandList.Get());
+        g_Breadcrumbs->EndPass(g_CommandList.Get(), marker);
+    }
+
+    // Capture
+    if (g_ScreenshotRequested || g_Recording)
+    {
+        char path[64];
+        if (g_ScreenshotRequested)
+        {
+            sprintf_s(path, "screenshot_%04u.tga", g_NumScreenshots++);
+        }
+        else
+        {
+            sprintf_s(path, "recording_%06u.tga", g_NumRecordedFrames++);
+        }
+        g_ScreenshotRequested = false;
+
+        // Straight from render target to present would be one barrier, this is two
+        TransitionResource(g_CommandList.Get(), backBuffer.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_COPY_SOURCE);
+        g_FrameCapture->Capture(g_CommandList.Get(), backBuffer.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE, path);
+        TransitionResource(g_CommandList.Get(), backBuffer.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_PRESENT);
+    }
+    else
+    {
+        TransitionResource(g_CommandList.Get(), backBuffer.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+    }
+
+    // Everything read back this frame, in one go at the end
+    g_ReadbackManager->RecordCopies(g_CommandList.Get());
+
+    // Present
+    {
+        if (g_GPUTimer)
+        {
+            g_GPUTimer->End(g_CommandList.Get(), g_CurrentBackBufferIndex);
+        }
+
+        ThrowIfFailed(g_CommandList->Close());
+
+        ID3D12CommandList* const commandLists[] = { g_CommandList.Get() };
+        g_Validator.OnExecute(g_CommandList.Get());
+        g_CommandQueue->ExecuteCommandLists(_countof(commandLists), commandLists);
+
+        // With vsync off nothing else paces us, so hold the present back until the next frame is due
+        if (!g_Vsync)
+        {
+            g_FrameLimiter.Wait();
+        }
+
+        // Tearing has to be allowed for the frame to go out right away on variable refresh rate displays
+        // (not valid with vsync, or in exclusive fullscreen which we don't use)
+        UINT syncInterval = g_Vsync ? 1 : 0;
+        UINT presentFlags = g_TearingSupported && !g_Vsync ? DXGI_PRESENT_ALLOW_TEARING : 0;
+        ThrowIfFailed(g_SwapChain->Present(syncInterval, presentFlags));
+        g_InputLatency.OnPresent();
+
+        g_FrameFenceValues[g_CurrentBackBufferIndex] = Signal(g_CommandQueue, g_Fence, g_FenceValue);
+        g_Validator.OnAllocatorSubmitted(commandAllocator.Get(), g_Fence.Get(), g_FrameFenceValues[g_CurrentBackBufferIndex]);
+        g_FrameCapture->FinishFrame(g_FrameFenceValues[g_CurrentBackBufferIndex]);
+        g_ReadbackManager->FinishFrame(g_FrameFenceValues[g_CurrentBackBufferIndex]);
+        if (g_ShaderHotReload)
+        {
+            g_ShaderHotReload->FinishFrame(g_FrameFenceValues[g_CurrentBackBufferIndex]);
+        }
+
+        g_CurrentBackBufferIndex = g_SwapChain->GetCurrentBackBufferIndex();
+    }
+}
+
+void OnWindowEvent(const WindowEvent& event)
+{
+    if (event.Type != WindowEventType::Resize)
+    {
+        g_InputLatency.OnInput(event.Timestamp);
+    }
+
+    switch (event.Type)
+    {
+    case WindowEventType::Resize:
+        g_ResizeCoalescer.OnSize(event.Param0, event.Param1, event.Timestamp);
+        break;
+    case WindowEventType::KeyDown:
+        switch (event.Param0)
+        {
+        case 'V':
+            g_Vsync = !g_Vsync;
+            break;
+        case 'P':
+            g_ScreenshotRequested = !g_LinkedDevice;
+            break;
+        case 'R':
+            g_Recording = !g_Recording && !g_LinkedDevice;
+            break;
+        case VK_ESCAPE:
+            // Can't destroy the window from here, ask the window thread to close it
+            ::PostMessageW(g_hWnd, WM_CLOSE, 0, 0);
+            break;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Picks up changes to the config file. Only the options that are safe to change between frames are applied,
+// see the hot reloadable ones in RuntimeConfig.cpp.
+void ReloadConfig()
+{
+    RuntimeConfig previous = g_Config;
+    std::vector<std::string> messages;
+    if (g_ConfigSource->Poll(g_Config, messages))
+    {
+        if (g_Config.Vsync != previous.Vsync)
+        {
+            g_Vsync = g_Config.Vsync;
+        }
+        if (g_Config.TargetFrameRate != previous.TargetFrameRate)
+        {
+            g_TargetFrameRate = g_Config.TargetFrameRate;
+            g_FrameLimiter.SetTargetFrameRate(g_TargetFrameRate);
+        }
+        if (g_Config.MaxFrameLatency != previous.MaxFrameLatency)
+        {
+            g_MaxFrameLatency = g_Config.MaxFrameLatency;
+            if (g_LatencyMode == LatencyMode::LowLatency)
+            {
+                ThrowIfFailed(g_SwapChain->SetMaximumFrameLatency(g_MaxFrameLatency));
+            }
+        }
+        if (g_Config.GPUBudgetMs != previous.GPUBudgetMs)
+        {
+            g_DynamicResolutionSettings.TargetFrameTimeMs = g_Config.GPUBudgetMs;
+            if (g_DynamicResolutionController)
+            {
+                g_DynamicResolutionController->SetSettings(g_DynamicResolutionSettings);
+            }
+        }
+    }
+
+    for (const std::string& message : messages)
+    {
+        ::OutputDebugStringA(("Config: " + message + "\n").c_str());
+    }
+}
 
+// Process (CPU) plus video memory in use, for the benchmark
+double GetMemoryUsageMB()
+{
+    uint64_t bytes = 0;
+
+    PROCESS_MEMORY_COUNTERS counters = {};
+    if (::GetProcessMemoryInfo(::GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        bytes += counters.PagefileUsage; // private bytes
+    }
+
+    DXGI_QUERY_VIDEO_MEMORY_INFO videoMemory = {};
+    if (g_BenchmarkAdapter && SUCCEEDED(g_BenchmarkAdapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &videoMemory)))
+    {
+        bytes += videoMemory.CurrentUsage;
+    }
+    return bytes / (1024.0 * 1024.0);
+}
+
+// After the last measured frame: collect the GPU times still in flight, write the results and close the window
+void FinishBenchmark()
+{
+    Flush(g_CommandQueue, g_Fence, g_FenceValue, g_FenceEvent);
+    for (uint32_t i = 0; i < g_NumFrames; ++i)
+    {
+        double gpuTimeMs;
+        if (g_GPUTimer->GetFrameTime(i, gpuTimeMs))
+        {
+            g_Benchmark->SetGPUTime(g_FrameBenchmarkIndex[i], gpuTimeMs);
+        }
+    }
+
+    std::vector<BenchmarkMetric> summary = g_Benchmark->GetSummary();
+    std::string report = FormatBenchmarkSummary(g_Benchmark->GetScenario().Name, summary);
+
+    if (!g_Config.BenchmarkCSV.empty())
+    {
+        g_Benchmark->WriteCSV(g_Config.BenchmarkCSV);
+    }
+    if (!g_Config.BenchmarkSaveBaseline.empty())
+    {
+        SaveBenchmarkBaseline(g_Config.BenchmarkSaveBaseline, summary);
+    }
+    if (!g_Config.BenchmarkBaseline.empty())
+    {
+        std::vector<std::string> regressions = CheckBenchmarkBaseline(g_Config.BenchmarkBaseline, summary);
+        for (const std::string& regression : regressions)
+        {
+            report += "REGRESSION " + regression + "\n";
+        }
+        report += regressions.empty() ? "No regressions against " : "Regressed against ";
+        report += g_Config.BenchmarkBaseline + "\n";
+        g_ExitCode = regressions.empty() ? 0 : 1;
+    }
+
+    // stdout too, for scripts (it goes nowhere when started from Explorer)
+    ::OutputDebugStringA(report.c_str());
+    std::fputs(report.c_str(), stdout);
+    std::fflush(stdout);
+
+    g_Benchmark.reset();
+    ::PostMessageW(g_hWnd, WM_CLOSE, 0, 0);
+}
+
+// Every --memory-snapshot-frames frames, a line in the snapshot file
+void WriteMemorySnapshot()
+{
+    ++g_NumRenderedFrames;
+    if (!g_MemorySnapshotFile.is_open() || g_NumRenderedFrames % g_Config.MemorySnapshotFrames != 0)
+    {
+        return;
+    }
+
+    GPUMemorySnapshot snapshot = GetGPUMemoryTracker().TakeSnapshot(g_NumRenderedFrames);
+    if (g_LastMemorySnapshot.Frame == 0)
+    {
+        g_MemorySnapshotFile << "{\"snapshot\":" << GPUMemorySnapshotToJSON(snapshot) << "}\n";
+    }
+    else
+    {
+        g_MemorySnapshotFile << "{\"snapshot\":" << GPUMemorySnapshotToJSON(snapshot, false)
+            << ",\"diff\":" << GPUMemoryDiffToJSON(DiffGPUMemory(g_LastMemorySnapshot, snapshot)) << "}\n";
+    }
+    g_LastMemorySnapshot = std::move(snapshot);
+}
+
+void RenderFrame()
+{
+    if (!g_Benchmark)
+    {
+        ReloadConfig();
+    }
+
+    // In low latency mode this is where the frame blocks, so pick up whatever input arrived while it did
+    g_FrameSequencer->BeginFrame(g_CurrentBackBufferIndex);
+    g_RenderThread->ProcessEvents();
+    g_InputLatency.OnFrameStart();
+    auto frameStart = std::chrono::steady_clock::now();
+
+    // Hands the captures whose copies are done to the encoder and resolves the readbacks, never waits for the GPU
+    uint64_t completedFenceValue = g_Fence->GetCompletedValue();
+    g_FrameCapture->Update(completedFenceValue);
+    if (g_ReadbackManager)
+    {
+        g_ReadbackManager->Update(completedFenceValue);
+    }
+    if (g_ShaderHotReload)
+    {
+        g_ShaderHotReload->Update(completedFenceValue); // before anything records the pipelines it swaps
+    }
+
+    // The last frame that used this back buffer has retired (both latency modes wait for that before getting here),
+    // so its GPU time is in. Pick the scale for this frame from it.
+    double gpuTimeMs;
+    if (g_GPUTimer && g_GPUTimer->GetFrameTime(g_CurrentBackBufferIndex, gpuTimeMs))
+    {
+        if (g_Benchmark)
+        {
+            // The scale comes from the script, the time is only recorded
+            g_Benchmark->SetGPUTime(g_FrameBenchmarkIndex[g_CurrentBackBufferIndex], gpuTimeMs);
+        }
+        else if (g_DynamicResolution)
+        {
+            if (!g_DynamicResolutionTracePath.empty())
+            {
+                g_DynamicResolutionTrace.push_back({ g_FrameScale[g_CurrentBackBufferIndex], gpuTimeMs });
+            }
+            g_DynamicResolutionController->Update(gpuTimeMs);
+        }
+    }
+
+    if (g_Benchmark)
+    {
+        // Scripted resizes go through the same path as the window's
+        BenchmarkFrame frame = g_Benchmark->GetFrame();
+        if (frame.Width != g_ClientWidth || frame.Height != g_ClientHeight)
+        {
+            g_ResizeCoalescer.OnSize(frame.Width, frame.Height);
+        }
     }
 
-}
\ No newline at end of file
+    Resize();
+
+    g_FrameCounters = {};
+    UINT backBufferIndex = g_CurrentBackBufferIndex; // Render moves on to the next one
+    Render();
+    WriteMemorySnapshot();
+
+    if (g_Benchmark)
+    {
+        double cpuTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+        g_FrameBenchmarkIndex[backBufferIndex] = g_Benchmark->GetFrameIndex();
+        g_Benchmark->EndFrame(cpuTimeMs, GetMemoryUsageMB(), g_FrameCounters.NumDraws, g_FrameCounters.NumBarriers);
+        if (g_Benchmark->IsDone())
+        {
+            FinishBenchmark();
+        }
+    }
+
+    // In default mode the wait is here instead: don't reuse the next back buffer (and its allocator) until the GPU is done with it
+    g_FrameSequencer->EndFrame(g_CurrentBackBufferIndex);
+}
+
+void OnRenderThreadExit()
+{
+    // The GPU may still be using the back buffers, make sure it's idle before the window goes away
+    if (g_CommandQueue)
+    {
+        Flush(g_CommandQueue, g_Fence, g_FenceValue, g_FenceEvent);
+    }
+    g_LinkedDevice.reset(); // waits for the other nodes
+
+    // Every copy is done now, wait for the encoder to write them out
+    if (g_FrameCapture)
+    {
+        g_FrameCapture->Flush(g_Fence->GetCompletedValue());
+        CaptureStats stats = g_FrameCapture->GetStats();
+        char buffer[256];
+        sprintf_s(buffer, "Capture: %llu requested, %llu dropped, %llu written (%llu failed), %.1f frames latency, %.2f ms encode\n",
+            stats.Requested, stats.Dropped, stats.Encoded, stats.Failed, stats.AverageLatencyFrames, stats.AverageEncodeMs);
+        ::OutputDebugStringA(buffer);
+        g_FrameCapture.reset();
+    }
+    if (g_ReadbackManager)
+    {
+        ReadbackStats stats = g_ReadbackManager->GetStats();
+        char buffer[256];
+        sprintf_s(buffer, "Readback: %llu requested, %llu dropped, %llu copies, %.1f frames latency, %.0f bytes/s\n",
+            stats.Requested, stats.Dropped, stats.NumCopies, stats.AverageLatencyFrames, stats.BytesPerSecond);
+        ::OutputDebugStringA(buffer);
+        g_ReadbackManager.reset();
+    }
+    if (g_ShaderHotReload)
+    {
+        ShaderReloadStats stats = g_ShaderHotReload->GetStats();
+        char buffer[256];
+        sprintf_s(buffer, "Shader reload: %llu reloaded, %llu failed, %llu discarded, %.1f ms latency (max %.1f), %.1f ms compile\n",
+            stats.Reloads, stats.Failed, stats.Discarded, stats.AverageLatencyMs, stats.MaxLatencyMs, stats.AverageCompileMs);
+        ::OutputDebugStringA(buffer);
+        g_ShaderHotReload.reset(); // waits for the compiles in flight, they use the scene target
+    }
+    g_MemorySnapshotFile.close();
+
+    // Posted, never sent: the window thread must not have to wait on us (and we mustn't wait on it)
+    ::PostMessageW(g_hWnd, WM_APP_RENDER_THREAD_EXITED, 0, 0);
+}
+
+// Hands rendering off to the render thread and pumps window messages until the window is closed.
+// Call once the device, swap chain and window are initialized.
+int RunMessageLoop()
+{
+    g_FrameLimiter.SetTargetFrameRate(g_TargetFrameRate);
+    g_FrameSequencer = std::make_unique<FrameSequencer>(g_FrameWaits, g_LatencyMode);
+
+    g_Breadcrumbs = std::make_unique<GPUBreadcrumbs>(g_Device);
+    SetDeviceRemovedCallback(&OnDeviceRemoved);
+
+    // The frame is one pass that clears the back buffer, which is presented
+    g_RenderPassEncoder = std::make_unique<RenderPassEncoder>(g_Device.Get(), g_Config.ForceRenderPasses);
+    RenderPassUsage clearPass;
+    clearPass.Name = "Clear";
+    clearPass.RenderTargets.push_back({ 0, true });
+    g_ClearPassActions = InferRenderPassActions({ { "BackBuffer", true } }, { clearPass })[0];
+
+    if (g_MultiGPUMode != MultiGPUMode::Single)
+    {
+        g_LinkedDevice = std::make_unique<LinkedDevice>(g_Device, g_CommandQueue, g_MultiGPUMode, g_NumFrames);
+        char buffer[128];
+        sprintf_s(buffer, "Multi-GPU: %s on %u of %u nodes\n", GetMultiGPUModeName(g_LinkedDevice->GetMode()),
+            g_LinkedDevice->GetNumNodes(), g_Device->GetNodeCount());
+        ::OutputDebugStringA(buffer);
+
+        if (g_LinkedDevice->GetNumNodes() < 2)
+        {
+            g_LinkedDevice.reset(); // nothing to spread, the usual path is the same thing with less overhead
+        }
+        else
+        {
+            // Nothing is in flight yet, so the back buffers can be moved to their nodes right away
+            for (uint32_t i = 0; i < g_NumFrames; ++i)
+            {
+                g_Validator.OnResourceReleased(g_BackBuffers[i].Get());
+                g_BackBuffers[i].Reset();
+            }
+            g_LinkedDevice->ResizeSwapChain(g_SwapChain.Get(), g_ClientWidth, g_ClientHeight);
+            g_CurrentBackBufferIndex = g_SwapChain->GetCurrentBackBufferIndex();
+            UpdateRenderTargetViews(g_Device, g_SwapChain, g_RTVDescriptorHeap);
+            if (g_LinkedDevice->GetMode() == MultiGPUMode::SplitFrame)
+            {
+                CreateSplitFrameTargets(g_ClientWidth, g_ClientHeight);
+            }
+        }
+    }
+
+    if (g_DynamicResolution)
+    {
+        g_DynamicResolutionController = std::make_unique<DynamicResolutionController>(g_DynamicResolutionSettings);
+        g_SceneTarget = std::make_unique<ScaledRenderTarget>(g_Device, DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_R8G8B8A8_UNORM,
+            g_DynamicResolutionSettings.MaxScale);
+        g_SceneTarget->SetOutputSize(g_ClientWidth, g_ClientHeight);
+    }
+
+    if (!g_Config.Benchmark.empty())
+    {
+        g_Benchmark = std::make_unique<BenchmarkRun>(*FindBenchmarkScenario(g_Config.Benchmark),
+            g_Config.BenchmarkWarmupFrames, g_Config.BenchmarkFrames);
+
+        ComPtr<IDXGIFactory4> factory;
+        ThrowIfFailed(CreateDXGIFactory1(IID_PPV_ARGS(&factory)));
+        ThrowIfFailed(factory->EnumAdapterByLuid(g_Device->GetAdapterLuid(), IID_PPV_ARGS(&g_BenchmarkAdapter)));
+    }
+
+    if (g_DynamicResolution || g_Benchmark)
+    {
+        g_GPUTimer = std::make_unique<GPUTimer>(g_Device, g_CommandQueue, g_NumFrames);
+    }
+
+    // Enough readback buffers to record every frame: the frames in flight, the one encoding, the one waiting to be
+    // returned and a spare. A back buffer's worth each, only allocated on the first capture.
+    g_FrameCapture = std::make_unique<FrameCapture>(g_Device, g_NumFrames + 3);
+    if (!g_LinkedDevice)
+    {
+        g_ReadbackManager = std::make_unique<ReadbackManager>(g_Device, uint64_t(g_Config.ReadbackRingSizeKB) * 1024);
+    }
+
+    if (g_Config.HotReloadShaders && g_SceneTarget && !g_LinkedDevice)
+    {
+        g_ShaderHotReload = std::make_unique<ShaderHotReload>(g_Config.WorkerThreads);
+        g_SceneTarget->EnableHotReload(*g_ShaderHotReload, g_Config.ShaderDirectory);
+        g_ShaderHotReload->Watch();
+    }
+
+    if (!g_Config.MemorySnapshots.empty())
+    {
+        g_MemorySnapshotFile.open(g_Config.MemorySnapshots);
+        if (!g_MemorySnapshotFile)
+        {
+            throw std::runtime_error("Can't write memory snapshots to " + g_Config.MemorySnapshots);
+        }
+    }
+
+    g_RenderThread = std::make_unique<RenderThread>(&OnWindowEvent, &RenderFrame, &OnRenderThreadExit);
+    g_RenderThread->Start();
+
+    ::ShowWindow(g_hWnd, SW_SHOW);
+
+    MSG msg = {};
+    while (::GetMessageW(&msg, NULL, 0, 0) > 0)
+    {
+        ::TranslateMessage(&msg);
+        ::DispatchMessageW(&msg);
+    }
+
+    // The render thread posted WM_APP_RENDER_THREAD_EXITED as its very last step, so this doesn't wait on anything.
+    // Joining here rather than in WndProc so an exception that ended the render thread is rethrown outside of a window callback.
+    g_RenderThread->Join();
+
+    RenderThreadStats stats = g_RenderThread->GetStats();
+    char buffer[256];
+    sprintf_s(buffer, "Render thread: %llu frames, %llu events (%llu dropped), event latency %.3f ms average / %.3f ms max\n",
+        stats.NumFrames, stats.EventsPosted, stats.EventsDropped, stats.AverageEventLatencyMs, stats.MaxEventLatencyMs);
+    ::OutputDebugStringA(buffer);
+
+    InputLatencyStats latency = g_InputLatency.GetStats();
+    sprintf_s(buffer, "%s mode (max frame latency %u): input to present %.2f ms average, %.2f ms min, %.2f ms max over %llu frames\n",
+        GetLatencyModeName(g_LatencyMode), g_LatencyMode == LatencyMode::LowLatency ? g_MaxFrameLatency : 3,
+        latency.AverageMs, latency.MinMs, latency.MaxMs, latency.NumSamples);
+    ::OutputDebugStringA(buffer);
+
+    if (g_DynamicResolution)
+    {
+        sprintf_s(buffer, "Dynamic resolution: final scale %.3f, %u render target allocations\n",
+            g_DynamicResolutionController->GetScale(), g_SceneTarget->GetNumAllocations());
+        ::OutputDebugStringA(buffer);
+
+        if (!g_DynamicResolutionTracePath.empty())
+        {
+            SaveDynamicResolutionTrace(g_DynamicResolutionTracePath, g_DynamicResolutionTrace);
+        }
+    }
+
+    if (g_Validator.IsEnabled())
+    {
+        sprintf_s(buffer, "Validation: %llu errors\n", g_Validator.GetErrorCount());
+        ::OutputDebugStringA(buffer);
+    }
+
+#if GPU_MEMORY_TRACKING
+    // Most of it is released by now, the high water marks are what's interesting
+    GPUMemoryTotal memory = GetGPUMemoryTracker().GetTotal();
+    sprintf_s(buffer, "GPU memory: %.1f MB high water, %.1f MB in %u allocations still alive\n",
+        memory.HighWater / (1024.0 * 1024.0), memory.Bytes / (1024.0 * 1024.0), memory.Count);
+    ::OutputDebugStringA(buffer);
+    for (uint32_t i = 0; i < GPU_MEMORY_CATEGORY_COUNT; ++i)
+    {
+        GPUMemoryTotal category = GetGPUMemoryTracker().GetCategoryTotal(static_cast<GPUMemoryCategory>(i));
+        if (category.HighWater > 0)
+        {
+            sprintf_s(buffer, "  %s: %.1f MB high water\n", GetGPUMemoryCategoryName(static_cast<GPUMemoryCategory>(i)),
+                category.HighWater / (1024.0 * 1024.0));
+            ::OutputDebugStringA(buffer);
+        }
+    }
+#endif
+
+    if (g_TargetFrameRate > 0.0)
+    {
+        FramePacingStats pacing = g_FrameLimiter.GetStats();
+        sprintf_s(buffer, "Frame limiter at %.1f Hz: error %.4f ms average / %.4f ms max, %.1f%% within 0.1 ms, %llu missed, %.3f ms spin per frame\n",
+            g_TargetFrameRate, pacing.AverageErrorMs, pacing.MaxErrorMs,
+            pacing.NumFrames > 0 ? 100.0 * pacing.NumWithin100us / pacing.NumFrames : 0.0,
+            pacing.NumMissed, pacing.AverageSpinMs);
+        ::OutputDebugStringA(buffer);
+    }
+
+    g_RenderThread.reset();
+
+    SetDeviceRemovedCallback(nullptr);
+    g_Breadcrumbs.reset();
+
+    // Non-zero when a benchmark regressed against its baseline
+    return g_ExitCode != 0 ? g_ExitCode : static_cast<int>(msg.wParam);
+}
+
+// Window messages
+
+LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
+{
+    if (g_IsInitialized && g_RenderThread)
+    {
+        switch (message)
+        {
+        // Nothing in here may wait on the render thread. It can be inside Present or ResizeBuffers,
+        // which send messages to this window and wait for them to be handled.
+        case WM_SIZE:
+            // Just pass it on, a drag sends dozens of these per frame and they get coalesced over there
+            g_RenderThread->PostEvent(WindowEventType::Resize, LOWORD(lParam), HIWORD(lParam));
+            break;
+        case WM_KEYDOWN:
+        case WM_SYSKEYDOWN:
+            g_RenderThread->PostEvent(WindowEventType::KeyDown, static_cast<uint32_t>(wParam));
+            if (message == WM_SYSKEYDOWN)
+            {
+                return ::DefWindowProcW(hwnd, message, wParam, lParam); // keep Alt+F4 etc.
+            }
+            break;
+        case WM_KEYUP:
+        case WM_SYSKEYUP:
+            g_RenderThread->PostEvent(WindowEventType::KeyUp, static_cast<uint32_t>(wParam));
+            if (message == WM_SYSKEYUP)
+            {
+                return ::DefWindowProcW(hwnd, message, wParam, lParam);
+            }
+            break;
+        case WM_MOUSEMOVE:
+            g_RenderThread->PostEvent(WindowEventType::MouseMove,
+                static_cast<uint32_t>(LOWORD(lParam)), static_cast<uint32_t>(HIWORD(lParam)));
+            break;
+        case WM_PAINT:
+            // The render thread draws continuously, just validate so Windows stops sending these
+            ::ValidateRect(hwnd, nullptr);
+            break;
+        case WM_CLOSE:
+            // Shutdown handshake, step 1: ask the render thread to stop and keep pumping messages
+            g_RenderThread->RequestStop();
+            break;
+        case WM_APP_RENDER_THREAD_EXITED:
+            // Step 2: it's done with the window (and the GPU is idle), RunMessageLoop joins it once the loop ends
+            ::DestroyWindow(hwnd);
+            break;
+        case WM_DESTROY:
+            ::PostQuitMessage(0);
+            break;
+        default:
+            return ::DefWindowProcW(hwnd, message, wParam, lParam);
+        }
+    }
+    else
+    {
+        return ::DefWindowProcW(hwnd, message, wParam, lParam);
+    }
+
+    return 0;
+}
+
+// Entry point
+
+int CALLBACK wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR lpCmdLine, int nCmdShow)
+{
+    // Client area sizes are in real pixels, not ones scaled by the display's DPI setting
+    ::SetThreadDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
+
+    const wchar_t* windowClassName = L"DX12WindowClass";
+
+    try
+    {
+        ParseCommandLineArguments();
+        EnableDebugLayer();
+
+        RegisterWindowClass(hInstance, windowClassName);
+        g_hWnd = CreateWindow(windowClassName, hInstance, L"Learning DirectX 12", g_ClientWidth, g_ClientHeight);
+
+        // Initialize the global window rect variable, for going back from fullscreen
+        ::GetWindowRect(g_hWnd, &g_WindowRect);
+
+        ComPtr<IDXGIAdapter4> dxgiAdapter4 = GetAdapter(g_UseWarp);
+        g_Device = CreateDevice(dxgiAdapter4);
+        g_CommandQueue = CreateCommandQueue(g_Device, D3D12_COMMAND_LIST_TYPE_DIRECT);
+
+        g_SwapChain = CreateSwapChain(g_hWnd, g_CommandQueue, g_ClientWidth, g_ClientHeight, g_NumFrames);
+        g_CurrentBackBufferIndex = g_SwapChain->GetCurrentBackBufferIndex();
+
+        g_RTVDescriptorHeap = CreateDescriptorHeap(g_Device, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, g_NumFrames);
+        g_RTVDescriptorHeap->SetName(L"Back buffer RTV");
+        GPU_MEMORY_TAG(g_RTVDescriptorHeap.Get(), "SwapChain");
+        g_RTVDescriptorSize = g_Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+        UpdateRenderTargetViews(g_Device, g_SwapChain, g_RTVDescriptorHeap);
+
+        for (int i = 0; i < g_NumFrames; ++i)
+        {
+            g_CommandAllocators[i] = CreateCommandAllocator(g_Device, D3D12_COMMAND_LIST_TYPE_DIRECT);
+        }
+        g_CommandList = CreateCommandList(g_Device, g_CommandAllocators[g_CurrentBackBufferIndex], D3D12_COMMAND_LIST_TYPE_DIRECT);
+
+        g_Fence = CreateFence(g_Device);
+        g_FenceEvent = CreateEventHandle();
+
+        g_IsInitialized = true;
+
+        // The render thread made sure the GPU is idle before it exited
+        int exitCode = RunMessageLoop();
+
+        ::CloseHandle(g_FenceEvent);
+        return exitCode;
+    }
+    catch (const std::exception& e)
+    {
+        // Config errors, a missing adapter or anything the render thread threw. The window may be gone already.
+        ::OutputDebugStringA(e.what());
+        ::OutputDebugStringA("\n");
+        ::MessageBoxA(NULL, e.what(), "DirectX12Intro", MB_OK | MB_ICONERROR);
+        return 1;
+    }
+}
@@ -0,0 +1,4570 @@
+// RuntimeBench
+// Command line benchmarks for the runtime pieces that don't need a GPU (the asset pipeline ones live in AssetPacker)
+//
+//   RuntimeBench pacing [--rate <Hz>] [--frames <N>] [--work <us>]
+//       Runs the FrameLimiter against a fake frame that takes ~work microseconds (+-25% jitter)
+//       and reports how close each wake up came to its deadline and the spread of the frame intervals.
+//   RuntimeBench latency [--frames <N>] [--refresh <Hz>] [--cpu <us>] [--gpu <us>] [--max-latency <N>]
+//       Runs the FrameSequencer in both latency modes against a simulated swap chain (GPU and display threads,
+//       DXGI style present queue) with a steady stream of input, and reports the input-to-present latency of each.
+//   RuntimeBench drs [--trace <file>] [--budget <ms>] [--frames <N>] [--save <file>]
+//       Replays a dynamic resolution trace (recorded with --drs-trace, or a synthetic one with load ramps and spikes)
+//       through the DynamicResolutionController and compares frames over budget against a fixed full resolution.
+//   RuntimeBench validate [--frames <N>] [--resources <N>]
+//       Drives the RuntimeValidator from a null backend (a fake renderer recording barriers, descriptor uses, signals
+//       and allocator resets): checks a clean run reports nothing and each injected bug is caught, then times the
+//       frame loop with validation off and on. Returns 1 if any check fails.
+//   RuntimeBench config [--file <path>] [--write <path>]
+//       Checks the RuntimeConfig parser (file syntax, command line overrides, errors, hot reload of a temporary file).
+//       --file prints the effective configuration of a file, --write writes one with every option at its default.
+//       Returns 1 if any check fails.
+//   RuntimeBench scenario <name> [--warmup <N>] [--frames <N>] [--csv <path>] [--baseline <path>] [--save-baseline <path>]
+//           [--slowdown <percent>]
+//       Runs a benchmark scenario (the same scripts as --benchmark) on a null backend: the CPU side is the null renderer,
+//       the GPU times and memory come from a simple per pixel model, delivered two frames late like the real ones.
+//       --slowdown makes the modelled GPU that much slower, to see a baseline check fail. Returns 1 on a regression.
+//   RuntimeBench multigpu [--frames <N>] [--cpu <us>] [--gpu <us>] [--copy <us>] [--history-point <percent>]
+//           [--sfr-fixed <percent>] [--slow-node <percent>]
+//       Checks the MultiGPUScheduler (node masks, AFR node assignment and history copies, SFR bands and load balancing),
+//       then runs single, AFR and SFR on a simulated two node device: per node a direct and a copy queue, a frame taking
+//       --gpu, history read --history-point of the way through it, cross-node copies of a full frame taking --copy,
+//       --sfr-fixed of the frame not splitting with the bands, node 1 --slow-node slower. Returns 1 if any check fails.
+//   RuntimeBench renderpass [--width <N>] [--height <N>]
+//       Checks the load/store actions InferRenderPassActions picks for a set of frames (a clear, a deferred frame, a depth
+//       prepass, transient and history targets, overwrites) and its errors, then prints the deferred frame's actions and
+//       the attachment traffic they save at the given size over preserving everything. Returns 1 if any check fails.
+//   RuntimeBench instancing [--objects <N>] [--frames <N>] [--moving <percent>]
+//       Animates a scene of repeated meshes (--moving of the objects move each frame, 1% get culled or unculled, a few
+//       change material) and submits it one draw per object and through the InstanceBatcher, both to a null backend
+//       recording the commands, and compares draws, commands and CPU time per frame. Then checks every visible object is
+//       drawn once with its data, one draw per group, sorted, and that moves don't rebuild. Returns 1 if any check fails.
+//   RuntimeBench videodecode [--streams <N>] [--frames <N>] [--decode <us>]
+//       Checks the VideoFramePool (reference slots, display order, skipping, seeking, slot reuse after sampling) and the
+//       VideoDecoderHeapCache, then plays --streams H.264 style IBBP streams against a fake decoder: one simulated decode
+//       queue taking --decode per frame, one graphics queue sampling every stream each vsync, both waiting on each
+//       other's fences. Every slot read is checked against the writes around it, once with a decoder keeping up and once
+//       with one too slow to. Returns 1 if any check fails.
+//   RuntimeBench capture [--frames <N>] [--latency <N>] [--encode <us>] [--buffers <N>] [--width <N>] [--height <N>]
+//       Checks the CaptureQueue (buffer reuse, drops, encoder failures, shutdown) and the TGA writer, then records every
+//       frame against a fake GPU whose fences complete --latency frames late, once with an encoder taking --encode and
+//       once with one taking 3 frames. Checks no buffer is mapped before its copy completed or reused while encoding,
+//       every accepted frame arrives intact and the render thread never waits. Returns 1 if any check fails.
+//   RuntimeBench readback [--frames <N>] [--requests <N>] [--gpu <us>] [--frames-in-flight <N>] [--ring <KB>]
+//       Checks the ReadbackQueue (batching, fences, wrapping, a full ring), then reads back --requests ranges of simulated
+//       GPU buffers per frame through a simulated queue thread taking --gpu per frame, once with a --ring KB ring and once
+//       with one too small. Checks every future resolves with the bytes of the frame that requested it, without waiting
+//       on it, and reports latency, copies and throughput. Returns 1 if any check fails.
+//   RuntimeBench gpumemory [--threads <N>] [--allocations <N>]
+//       Checks the GPUMemoryTracker (totals, high water marks, snapshots, diffs and their JSON, which is parsed back),
+//       then has --threads threads add and remove --allocations allocations each while snapshots are taken, checking
+//       every snapshot adds up, and times adds, removes, snapshots and their JSON. Returns 1 if any check fails.
+//   RuntimeBench shaderreload [--threads <N>] [--edits <N>]
+//       Checks the ShaderIncludeGraph (parsing, nested and missing includes, include directories, cycles), the FileWatcher
+//       on a temporary directory (writes, renames over a file, other directories) and the ShaderReloader with fake
+//       compiles (only affected permutations, errors keeping the old one, superseded compiles), then edits a shared
+//       include --edits times and runs frames until the programs using it are swapped in, reporting the latency.
+//       Returns 1 if any check fails.
+//   RuntimeBench permutations [--lookups <N>] [--list]
+//       Checks the ShaderPermutation keys of a sample material shader (most of it with static_asserts, so a broken key
+//       doesn't compile), the offline permutation list and the dense table, then times finding bytecode by key against
+//       by a string of defines in a hash map. --list prints the FXC command lines of the offline compile instead.
+//       Returns 1 if any check fails.
+//   RuntimeBench resize [--frames <N>] [--events <N>]
+//       Checks the ResizeCoalescer on scripted size events (a burst within a frame, the same size, dragging back, 0x0
+//       from minimizing, the latency stats), then feeds it 0 to --events random sizes per frame for --frames frames and
+//       checks every frame resizes at most once, to the latest size, with the latency measured from the first event.
+//       Returns 1 if any check fails.
+//   RuntimeBench renderthread [--events <N>]
+//       Checks the SPSCQueue (full, empty, wrapping, two threads), the RenderThread's overflow slot for resizes dropped
+//       from a full queue (0x0 included), then has this thread post --events events to a running render thread with
+//       stalling frames and shut it down the way WM_CLOSE does, checking the order, the last resize and the exit
+//       handshake, and that an exception in a frame still runs the exit function. Returns 1 if any check fails.
+//   RuntimeBench throwbench [--calls <N>]
+//       Checks ThrowIfFailed lets successes through and says where a failure happened, then times its success path
+//       after an out of line stand-in for a D3D call: unchecked, ThrowIfFailed, and a throw expression at the call site
+//       like it used to be. Returns 1 if any check fails.
+//
+// Only uses the STL plus the portable engine code, so it builds on Windows and Linux alike, e.g.
+//   g++ -std=c++17 -O2 -pthread -I../DirectX12Intro RuntimeBench.cpp ../DirectX12Intro/DynamicResolution.cpp
+//       ../DirectX12Intro/FrameLatency.cpp ../DirectX12Intro/FrameLimiter.cpp ../DirectX12Intro/RuntimeConfig.cpp
+//       ../DirectX12Intro/RuntimeValidator.cpp ../DirectX12Intro/Benchmark.cpp ../DirectX12Intro/MultiGPU.cpp
+//       ../DirectX12Intro/RenderPass.cpp ../DirectX12Intro/InstanceBatcher.cpp ../DirectX12Intro/VideoFramePool.cpp
+//       ../DirectX12Intro/CaptureQueue.cpp ../DirectX12Intro/ReadbackQueue.cpp ../DirectX12Intro/GPUMemoryTracker.cpp
+//       ../DirectX12Intro/ShaderIncludeGraph.cpp ../DirectX12Intro/FileWatcher.cpp ../DirectX12Intro/ShaderReloader.cpp
+//       ../DirectX12Intro/ThreadPool.cpp ../DirectX12Intro/ResizeCoalescer.cpp ../DirectX12Intro/RenderThread.cpp
+//       -o RuntimeBench
+// (on Windows the project adds Helpers.cpp, elsewhere ThrowHResult is defined below)
+
+#include "Benchmark.h"
+#include "CaptureQueue.h"
+#include "DynamicResolution.h"
+#include "FrameLatency.h"
+#include "FrameLimiter.h"
+#include "GPUMemoryTracker.h"
+#include "Helpers.h"
+#include "InstanceBatcher.h"
+#include "MultiGPU.h"
+#include "ReadbackQueue.h"
+#include "RenderPass.h"
+#include "RenderThread.h"
+#include "ResizeCoalescer.h"
+#include "RuntimeConfig.h"
+#include "RuntimeValidator.h"
+#include "ShaderIncludeGraph.h"
+#include "ShaderPermutation.h"
+#include "ShaderReloader.h"
+#include "SPSCQueue.h"
+#include "ThreadPool.h"
+#include "VideoFramePool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+// Helpers.cpp is Windows only, elsewhere the error path just has to say where it happened
+void ThrowHResult(HRESULT hr, const char* file, int line)
+{
+    char buffer[512];
+    std::snprintf(buffer, sizeof(buffer), "%s(%d): HRESULT 0x%08X", file, line, static_cast<unsigned>(hr));
+    throw std::runtime_error(buffer);
+}
+#endif
+
+namespace
+{
+    void PrintUsage()
+    {
+        std::printf(
+            "Usage:\n"
+            "  RuntimeBench pacing [--rate <Hz>] [--frames <N>] [--work <us>]\n"
+            "  RuntimeBench latency [--frames <N>] [--refresh <Hz>] [--cpu <us>] [--gpu <us>] [--max-latency <N>]\n"
+            "  RuntimeBench drs [--trace <file>] [--budget <ms>] [--frames <N>] [--save <file>]\n"
+            "  RuntimeBench validate [--frames <N>] [--resources <N>]\n"
+            "  RuntimeBench config [--file <path>] [--write <path>]\n"
+            "  RuntimeBench scenario <name> [--warmup <N>] [--frames <N>] [--csv <path>] [--baseline <path>] [--save-baseline <path>]\n"
+            "                        [--slowdown <percent>]\n"
+            "  RuntimeBench multigpu [--frames <N>] [--cpu <us>] [--gpu <us>] [--copy <us>] [--history-point <percent>]\n"
+            "                        [--sfr-fixed <percent>] [--slow-node <percent>]\n"
+            "  RuntimeBench renderpass [--width <N>] [--height <N>]\n"
+            "  RuntimeBench instancing [--objects <N>] [--frames <N>] [--moving <percent>]\n"
+            "  RuntimeBench videodecode [--streams <N>] [--frames <N>] [--decode <us>]\n"
+            "  RuntimeBench capture [--frames <N>] [--latency <N>] [--encode <us>] [--buffers <N>] [--width <N>] [--height <N>]\n"
+            "  RuntimeBench readback [--frames <N>] [--requests <N>] [--gpu <us>] [--frames-in-flight <N>] [--ring <KB>]\n"
+            "  RuntimeBench gpumemory [--threads <N>] [--allocations <N>]\n"
+            "  RuntimeBench shaderreload [--threads <N>] [--edits <N>]\n"
+            "  RuntimeBench permutations [--lookups <N>] [--list]\n"
+            "  RuntimeBench resize [--frames <N>] [--events <N>]\n"
+            "  RuntimeBench renderthread [--events <N>]\n"
+            "  RuntimeBench throwbench [--calls <N>]\n");
+    }
+
+    // Finds "--name <value>" among the optional arguments
+    uint32_t GetOption(int argc, char** argv, int first, const char* name, uint32_t defaultValue)
+    {
+        for (int i = first; i + 1 < argc; ++i)
+        {
+            if (std::strcmp(argv[i], name) == 0)
+            {
+                return static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+            }
+        }
+        return defaultValue;
+    }
+
+    const char* GetStringOption(int argc, char** argv, int first, const char* name, const char* defaultValue)
+    {
+        for (int i = first; i + 1 < argc; ++i)
+        {
+            if (std::strcmp(argv[i], name) == 0)
+            {
+                return argv[i + 1];
+            }
+        }
+        return defaultValue;
+    }
+
+    bool Check(const char* name, bool ok, const std::string& detail = std::string())
+    {
+        std::printf("  %-40s : %s%s%s\n", name, ok ? "ok" : "FAILED", detail.empty() ? "" : ", ", detail.c_str());
+        return ok;
+    }
+
+    // Busy work standing in for a frame's CPU time
+    void SimulateWork(std::chrono::microseconds duration)
+    {
+        auto end = std::chrono::steady_clock::now() + duration;
+        while (std::chrono::steady_clock::now() < end)
+        {
+        }
+    }
+
+    int Pacing(int argc, char** argv)
+    {
+        uint32_t rate = GetOption(argc, argv, 2, "--rate", 144);
+        uint32_t numFrames = GetOption(argc, argv, 2, "--frames", 1000);
+        uint32_t work = GetOption(argc, argv, 2, "--work", 2000);
+        if (rate == 0 || numFrames < 2)
+        {
+            throw std::runtime_error("--rate must be > 0 and --frames >= 2");
+        }
+
+        std::printf("Pacing %u frames at %u Hz (%.3f ms), ~%u us of work per frame\n", numFrames, rate, 1000.0 / rate, work);
+
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<double> jitter(0.75, 1.25);
+
+        FrameLimiter limiter(rate);
+        std::vector<double> intervals;
+        intervals.reserve(numFrames);
+        std::vector<std::pair<FrameLimiter::Clock::time_point, FrameLimiter::Clock::time_point>> waits; // entered, returned
+        waits.reserve(numFrames);
+
+        auto last = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < numFrames; ++i)
+        {
+            SimulateWork(std::chrono::microseconds(static_cast<int64_t>(work * jitter(random))));
+            auto entered = FrameLimiter::Clock::now();
+            limiter.Wait();
+
+            auto now = std::chrono::steady_clock::now();
+            waits.emplace_back(entered, now);
+            if (i > 0) // the first one has no previous deadline
+            {
+                intervals.push_back(std::chrono::duration<double, std::milli>(now - last).count());
+            }
+            last = now;
+        }
+
+        double mean = 0.0;
+        for (double interval : intervals)
+        {
+            mean += interval;
+        }
+        mean /= intervals.size();
+
+        double variance = 0.0;
+        for (double interval : intervals)
+        {
+            variance += (interval - mean) * (interval - mean);
+        }
+        std::sort(intervals.begin(), intervals.end());
+
+        FramePacingStats stats = limiter.GetStats();
+        std::printf("  achieved      : %.2f Hz\n", 1000.0 / mean);
+        std::printf("  interval      : %.3f ms mean, %.3f ms std dev, %.3f / %.3f ms 1st / 99th percentile\n",
+            mean, std::sqrt(variance / intervals.size()),
+            intervals[intervals.size() / 100], intervals[intervals.size() * 99 / 100]);
+        std::printf("  wake up error : %.4f ms mean, %.4f ms max, %.1f%% within 0.1 ms, %llu missed\n",
+            stats.AverageErrorMs, stats.MaxErrorMs, 100.0 * stats.NumWithin100us / stats.NumFrames,
+            static_cast<unsigned long long>(stats.NumMissed));
+        std::printf("  spin          : %.3f ms per frame, margin %.3f ms\n", stats.AverageSpinMs, stats.SpinMarginMs);
+
+        // Rebuild the schedule from the outside, the same way Wait keeps it, and measure the wake up error against
+        // it from our own timestamps. Those are a few ns either side of the limiter's, so the means should agree.
+        auto period = std::chrono::duration_cast<FrameLimiter::Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+        auto deadline = waits[0].first + period;
+        uint64_t measuredMissed = 0;
+        double measuredErrorMs = 0.0;
+        for (const auto& wait : waits)
+        {
+            if (wait.first >= deadline)
+            {
+                ++measuredMissed;
+                deadline = wait.first - deadline > period ? wait.first + period : deadline + period;
+                continue;
+            }
+            measuredErrorMs += std::abs(std::chrono::duration<double, std::milli>(wait.second - deadline).count());
+            deadline += period;
+        }
+        measuredErrorMs /= std::max<uint64_t>(1, waits.size() - measuredMissed);
+
+        // What the spin is there for. The limiter aims well under this, the rest is room for a loaded machine.
+        const double MAX_MEAN_ERROR_MS = 0.1;
+        char detail[96];
+        std::snprintf(detail, sizeof(detail), "%.4f ms, limit %.1f ms", stats.AverageErrorMs, MAX_MEAN_ERROR_MS);
+        bool passed = Check("mean wake up error within the limit", stats.AverageErrorMs <= MAX_MEAN_ERROR_MS, detail);
+        passed &= Check("every frame counted", stats.NumFrames == numFrames, std::to_string(stats.NumFrames) + " frames");
+        std::snprintf(detail, sizeof(detail), "%llu measured, %llu recorded",
+            static_cast<unsigned long long>(measuredMissed), static_cast<unsigned long long>(stats.NumMissed));
+        passed &= Check("missed frames match the timestamps", measuredMissed == stats.NumMissed, detail);
+        std::snprintf(detail, sizeof(detail), "%.4f ms measured, %.4f ms recorded", measuredErrorMs, stats.AverageErrorMs);
+        passed &= Check("mean error matches the timestamps", std::abs(measuredErrorMs - stats.AverageErrorMs) <= 0.02, detail);
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    // Stand-in for the swap chain, queue and display:
+    //   a GPU thread works through presented frames one after the other,
+    //   a display thread flips at most one finished frame per refresh,
+    //   Present blocks while more than maxLatency frames are waiting for the display (DXGI's default behaviour),
+    //   unless the swap chain is "waitable", in which case WaitForSwapChain does that job before the frame starts.
+    class SimulatedSwapChain : public IFrameWaits
+    {
+    public:
+        static const uint32_t NUM_BUFFERS = 3;
+
+        SimulatedSwapChain(std::chrono::microseconds refreshPeriod, std::chrono::microseconds gpuTime, uint32_t maxLatency, bool waitable)
+            : m_RefreshPeriod(refreshPeriod)
+            , m_GPUTime(gpuTime)
+            , m_MaxLatency(maxLatency)
+            , m_Waitable(waitable)
+        {
+            m_GPUThread = std::thread(&SimulatedSwapChain::GPUThread, this);
+            m_DisplayThread = std::thread(&SimulatedSwapChain::DisplayThread, this);
+        }
+
+        ~SimulatedSwapChain()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Stopping = true;
+            }
+            m_Changed.notify_all();
+            m_GPUThread.join();
+            m_DisplayThread.join();
+        }
+
+        void WaitForSwapChain() override
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Changed.wait(lock, [this]() { return m_Presented - m_Displayed < m_MaxLatency; });
+        }
+
+        void WaitForFrameFence(uint32_t backBufferIndex) override
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Changed.wait(lock, [this, backBufferIndex]() { return m_GPUDone >= m_BufferFrame[backBufferIndex]; });
+        }
+
+        void Present()
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_BufferFrame[m_CurrentBuffer] = ++m_Presented;
+            m_CurrentBuffer = (m_CurrentBuffer + 1) % NUM_BUFFERS;
+            m_Changed.notify_all();
+
+            if (!m_Waitable)
+            {
+                m_Changed.wait(lock, [this]() { return m_Presented - m_Displayed <= m_MaxLatency; });
+            }
+        }
+
+        uint32_t GetCurrentBackBufferIndex() const { return m_CurrentBuffer; }
+
+    private:
+        void GPUThread()
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            for (;;)
+            {
+                m_Changed.wait(lock, [this]() { return m_Stopping || m_GPUDone < m_Presented; });
+                if (m_Stopping)
+                {
+                    return;
+                }
+
+                lock.unlock();
+                std::this_thread::sleep_for(m_GPUTime);
+                lock.lock();
+
+                ++m_GPUDone;
+                m_Changed.notify_all();
+            }
+        }
+
+        void DisplayThread()
+        {
+            auto vsync = std::chrono::steady_clock::now();
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            while (!m_Stopping)
+            {
+                vsync += m_RefreshPeriod;
+                lock.unlock();
+                std::this_thread::sleep_until(vsync);
+                lock.lock();
+
+                if (m_Displayed < m_GPUDone)
+                {
+                    ++m_Displayed;
+                    m_Changed.notify_all();
+                }
+            }
+        }
+
+        std::chrono::microseconds m_RefreshPeriod;
+        std::chrono::microseconds m_GPUTime;
+        uint64_t m_MaxLatency;
+        bool m_Waitable;
+
+        std::mutex m_Mutex;
+        std::condition_variable m_Changed;
+        bool m_Stopping = false;
+        uint64_t m_Presented = 0;
+        uint64_t m_GPUDone = 0;
+        uint64_t m_Displayed = 0;
+        uint64_t m_BufferFrame[NUM_BUFFERS] = {};
+        uint32_t m_CurrentBuffer = 0;
+
+        std::thread m_GPUThread;
+        std::thread m_DisplayThread;
+    };
+
+    // Writes down the waits a FrameSequencer makes instead of blocking them, e.g. "swapchain, fence 1"
+    class RecordingFrameWaits : public IFrameWaits
+    {
+    public:
+        void WaitForSwapChain() override { Record("swapchain"); }
+        void WaitForFrameFence(uint32_t backBufferIndex) override { Record("fence " + std::to_string(backBufferIndex)); }
+
+        // What was waited on since the last call
+        std::string TakeCalls()
+        {
+            std::string calls;
+            calls.swap(m_Calls);
+            return calls;
+        }
+
+    private:
+        void Record(const std::string& call)
+        {
+            m_Calls += (m_Calls.empty() ? "" : ", ") + call;
+        }
+
+        std::string m_Calls;
+    };
+
+    // Drives both modes through a few frames and checks each wait lands in the right place, in the right order
+    bool CheckFrameWaitOrder()
+    {
+        bool passed = true;
+        for (LatencyMode mode : { LatencyMode::Default, LatencyMode::LowLatency })
+        {
+            RecordingFrameWaits waits;
+            FrameSequencer sequencer(waits, mode);
+
+            std::string begin, end;
+            bool ok = true;
+            for (uint32_t i = 0; i < 6; ++i)
+            {
+                uint32_t next = (i + 1) % 3;
+                sequencer.BeginFrame(i % 3);
+                std::string beginCalls = waits.TakeCalls();
+                sequencer.EndFrame(next);
+                std::string endCalls = waits.TakeCalls();
+
+                if (mode == LatencyMode::LowLatency)
+                {
+                    ok &= beginCalls == "swapchain, fence " + std::to_string(i % 3) && endCalls.empty();
+                }
+                else
+                {
+                    ok &= beginCalls.empty() && endCalls == "fence " + std::to_string(next);
+                }
+                if (i == 0)
+                {
+                    begin = beginCalls;
+                    end = endCalls;
+                }
+            }
+
+            passed &= Check((std::string(GetLatencyModeName(mode)) + " waits in order").c_str(), ok,
+                "first frame begin [" + begin + "], end [" + end + "]");
+        }
+        return passed;
+    }
+
+    int Latency(int argc, char** argv)
+    {
+        uint32_t numFrames = GetOption(argc, argv, 2, "--frames", 300);
+        uint32_t refreshRate = GetOption(argc, argv, 2, "--refresh", 120);
+        uint32_t cpuTime = GetOption(argc, argv, 2, "--cpu", 2000);
+        uint32_t gpuTime = GetOption(argc, argv, 2, "--gpu", 6000);
+        uint32_t maxLatency = GetOption(argc, argv, 2, "--max-latency", 1);
+        if (refreshRate == 0 || maxLatency == 0)
+        {
+            throw std::runtime_error("--refresh and --max-latency must be > 0");
+        }
+
+        std::printf("%u frames at %u Hz, %u us CPU, %u us GPU per frame\n", numFrames, refreshRate, cpuTime, gpuTime);
+
+        auto refreshPeriod = std::chrono::microseconds(1000000 / refreshRate);
+        double averageMs[2] = {};
+        for (LatencyMode mode : { LatencyMode::Default, LatencyMode::LowLatency })
+        {
+            // DXGI's default maximum frame latency is 3
+            uint32_t modeMaxLatency = mode == LatencyMode::LowLatency ? maxLatency : 3;
+            SimulatedSwapChain swapChain(refreshPeriod, std::chrono::microseconds(gpuTime), modeMaxLatency, mode == LatencyMode::LowLatency);
+            FrameSequencer sequencer(swapChain, mode);
+            InputLatencyTracker tracker;
+
+            // Input keeps arriving every half millisecond regardless of what the frame loop is doing
+            std::mutex inputMutex;
+            std::vector<std::chrono::steady_clock::time_point> input;
+            std::atomic<bool> stopInput{ false };
+            std::thread inputThread([&]()
+            {
+                while (!stopInput)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(inputMutex);
+                        input.push_back(std::chrono::steady_clock::now());
+                    }
+                    std::this_thread::sleep_for(std::chrono::microseconds(500));
+                }
+            });
+
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < numFrames; ++i)
+            {
+                sequencer.BeginFrame(swapChain.GetCurrentBackBufferIndex());
+                {
+                    std::lock_guard<std::mutex> lock(inputMutex);
+                    for (auto timestamp : input)
+                    {
+                        tracker.OnInput(timestamp);
+                    }
+                    input.clear();
+                }
+                tracker.OnFrameStart();
+
+                SimulateWork(std::chrono::microseconds(cpuTime));
+
+                swapChain.Present();
+                tracker.OnPresent();
+
+                sequencer.EndFrame(swapChain.GetCurrentBackBufferIndex());
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            stopInput = true;
+            inputThread.join();
+
+            InputLatencyStats stats = tracker.GetStats();
+            std::printf("  %-10s (max latency %u) : %6.2f fps, input to present %6.2f ms average, %6.2f min, %6.2f max\n",
+                GetLatencyModeName(mode), modeMaxLatency, numFrames / seconds, stats.AverageMs, stats.MinMs, stats.MaxMs);
+            averageMs[mode == LatencyMode::LowLatency ? 1 : 0] = stats.AverageMs;
+        }
+
+        bool passed = CheckFrameWaitOrder();
+        char detail[64];
+        std::snprintf(detail, sizeof(detail), "%.2f ms vs %.2f ms", averageMs[1], averageMs[0]);
+        passed &= Check("LowLatency input lag below Default", averageMs[1] < averageMs[0], detail);
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    // Full resolution frame times: a steady load with noise, a slow ramp well over budget and back, and a few one frame spikes
+    std::vector<DynamicResolutionTraceFrame> SynthesizeTrace(uint32_t numFrames, double budgetMs)
+    {
+        std::mt19937 random(42);
+        std::uniform_real_distribution<double> noise(0.95, 1.05);
+
+        std::vector<DynamicResolutionTraceFrame> frames(numFrames);
+        for (uint32_t i = 0; i < numFrames; ++i)
+        {
+            double load = 0.85;
+            double t = double(i) / numFrames;
+            if (t > 0.3 && t < 0.7)
+            {
+                // Up to 1.6x the budget in the middle of the ramp
+                load += 0.75 * std::sin((t - 0.3) / 0.4 * 3.14159265);
+            }
+            if (i % 97 == 50)
+            {
+                load *= 2.5;
+            }
+            frames[i] = { 1.0f, budgetMs * load * noise(random) };
+        }
+        return frames;
+    }
+
+    // Just the noise: a full resolution load a little over budget, which the controller should settle on and then
+    // leave alone
+    std::vector<DynamicResolutionTraceFrame> SynthesizeSteadyTrace(uint32_t numFrames, double budgetMs)
+    {
+        std::mt19937 random(7);
+        std::uniform_real_distribution<double> noise(0.95, 1.05);
+
+        std::vector<DynamicResolutionTraceFrame> frames(numFrames);
+        for (DynamicResolutionTraceFrame& frame : frames)
+        {
+            frame = { 1.0f, budgetMs * 1.2 * noise(random) };
+        }
+        return frames;
+    }
+
+    bool SameFrames(const std::vector<DynamicResolutionTraceFrame>& a, const std::vector<DynamicResolutionTraceFrame>& b)
+    {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+            [](const DynamicResolutionTraceFrame& x, const DynamicResolutionTraceFrame& y) { return x.Scale == y.Scale && x.GPUTimeMs == y.GPUTimeMs; });
+    }
+
+    void PrintReplay(const char* name, const DynamicResolutionReplayResult& result)
+    {
+        std::printf("  %-16s : %5.1f%% over budget, scale %.3f average / %.3f min, %u scale changes, GPU %.2f ms average / %.2f ms max\n",
+            name, 100.0 * result.NumOverBudget / std::max<size_t>(1, result.Frames.size()), result.AverageScale, result.MinScale,
+            result.NumScaleChanges, result.AverageGPUTimeMs, result.MaxGPUTimeMs);
+    }
+
+    int DynamicResolution(int argc, char** argv)
+    {
+        const char* tracePath = GetStringOption(argc, argv, 2, "--trace", nullptr);
+        const char* savePath = GetStringOption(argc, argv, 2, "--save", nullptr);
+        uint32_t budget = GetOption(argc, argv, 2, "--budget", 15);
+        uint32_t numFrames = GetOption(argc, argv, 2, "--frames", 2000);
+
+        DynamicResolutionSettings settings;
+        settings.TargetFrameTimeMs = budget;
+
+        std::vector<DynamicResolutionTraceFrame> trace = tracePath ? LoadDynamicResolutionTrace(tracePath) : SynthesizeTrace(numFrames, budget);
+        std::printf("%zu frames from %s, %u ms budget\n", trace.size(), tracePath ? tracePath : "a synthetic trace", budget);
+
+        DynamicResolutionSettings fixed = settings;
+        fixed.MinScale = fixed.MaxScale;
+        DynamicResolutionReplayResult fixedResult = ReplayDynamicResolutionTrace(trace, fixed);
+        PrintReplay("fixed resolution", fixedResult);
+
+        auto start = std::chrono::steady_clock::now();
+        DynamicResolutionReplayResult result = ReplayDynamicResolutionTrace(trace, settings);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        PrintReplay("dynamic", result);
+        std::printf("  controller cost    : %.1f ns per frame\n", seconds * 1e9 / std::max<size_t>(1, trace.size()));
+
+        bool passed = Check("fewer frames over budget than fixed", result.NumOverBudget < fixedResult.NumOverBudget,
+            std::to_string(result.NumOverBudget) + " vs " + std::to_string(fixedResult.NumOverBudget));
+        auto outside = std::find_if(result.Frames.begin(), result.Frames.end(), [&settings](const DynamicResolutionTraceFrame& frame)
+        {
+            return frame.Scale < settings.MinScale || frame.Scale > settings.MaxScale;
+        });
+        passed &= Check("scale within [MinScale, MaxScale]", outside == result.Frames.end(),
+            outside == result.Frames.end() ? std::string() : "frame " + std::to_string(outside - result.Frames.begin()));
+
+        // On noise alone the deadband, MinScaleChange and the upscale delay should keep the scale mostly still once
+        // it has come down: at most 2% of the frames, where the controller without them moves it nearly every frame
+        std::vector<DynamicResolutionTraceFrame> steadyTrace = SynthesizeSteadyTrace(1000, budget);
+        DynamicResolutionReplayResult steady = ReplayDynamicResolutionTrace(steadyTrace, settings);
+        DynamicResolutionSettings noHysteresis = settings;
+        noHysteresis.Deadband = 0.0;
+        noHysteresis.MinScaleChange = 0.0f;
+        noHysteresis.UpscaleDelayFrames = 0;
+        DynamicResolutionReplayResult steadyNoHysteresis = ReplayDynamicResolutionTrace(steadyTrace, noHysteresis);
+        PrintReplay("steady + noise", steady);
+        PrintReplay("  no hysteresis", steadyNoHysteresis);
+        passed &= Check("few scale changes on a noisy load", steady.NumScaleChanges <= steadyTrace.size() / 50,
+            std::to_string(steady.NumScaleChanges) + " vs " + std::to_string(steadyNoHysteresis.NumScaleChanges) + " without hysteresis");
+
+        // Saving what the controller did and replaying the file has to give the same run as replaying it from memory
+        std::string roundTripPath = savePath ? savePath : "RuntimeBenchDRSTrace.csv";
+        SaveDynamicResolutionTrace(roundTripPath, result.Frames);
+        std::vector<DynamicResolutionTraceFrame> loaded = LoadDynamicResolutionTrace(roundTripPath);
+        if (!savePath)
+        {
+            std::remove(roundTripPath.c_str());
+        }
+        DynamicResolutionReplayResult fromMemory = ReplayDynamicResolutionTrace(result.Frames, settings);
+        DynamicResolutionReplayResult fromFile = ReplayDynamicResolutionTrace(loaded, settings);
+        passed &= Check("saved trace loads back unchanged", SameFrames(loaded, result.Frames), std::to_string(loaded.size()) + " frames");
+        passed &= Check("replay of the saved trace is identical", SameFrames(fromFile.Frames, fromMemory.Frames)
+            && fromFile.NumOverBudget == fromMemory.NumOverBudget && fromFile.NumScaleChanges == fromMemory.NumScaleChanges);
+
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    // Bugs the null renderer can make on purpose, each once, halfway through the run
+    enum class InjectedBug
+    {
+        None,
+        WrongBarrierState, // back buffer transitioned from RENDER_TARGET when it's in PRESENT
+        StaleDescriptor,   // a resource is released and recreated at the same address, the old descriptor is still used
+        FenceBackwards,    // signals the value of the previous frame again
+        AllocatorReuse,    // resets an allocator one fence value too early
+    };
+
+    // Stand-in for the D3D12 renderer: the objects are just addresses, the GPU finishes each frame exactly when
+    // the CPU waits for it (3 frames in flight). Same hooks, in the same places, as main.cpp plus numResources
+    // textures going SRV -> RT -> SRV with a descriptor use each per frame.
+    class NullRenderer
+    {
+    public:
+        static const uint32_t NUM_FRAMES = 3;
+        static const uint32_t STATE_PRESENT = 0x0;       // D3D12_RESOURCE_STATE_PRESENT
+        static const uint32_t STATE_RENDER_TARGET = 0x4; // D3D12_RESOURCE_STATE_RENDER_TARGET
+        static const uint32_t STATE_SHADER_RESOURCE = 0xC0; // D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | NON_PIXEL
+
+        NullRenderer(RuntimeValidator& validator, uint32_t numResources)
+            : m_Validator(validator)
+            , m_Resources(numResources)
+        {
+            for (uint32_t i = 0; i < NUM_FRAMES; ++i)
+            {
+                m_Validator.OnResourceCreated(&m_BackBuffers[i], STATE_PRESENT, "Back buffer");
+                m_Validator.OnDescriptorCreated(GetDescriptor(&m_BackBuffers[i]), &m_BackBuffers[i]);
+            }
+            for (char& resource : m_Resources)
+            {
+                m_Validator.OnResourceCreated(&resource, STATE_SHADER_RESOURCE, "Texture");
+                m_Validator.OnDescriptorCreated(GetDescriptor(&resource), &resource);
+            }
+        }
+
+        void RenderFrame(InjectedBug bug)
+        {
+            uint32_t index = m_FrameIndex % NUM_FRAMES;
+
+            // Wait for the last frame that used this allocator
+            uint64_t completed = m_FrameFenceValues[index] - (bug == InjectedBug::AllocatorReuse && m_FrameFenceValues[index] > 0 ? 1 : 0);
+            m_Validator.OnAllocatorReset(&m_Allocators[index], completed);
+            m_Validator.OnCommandListReset(&m_CommandList);
+
+            for (char& resource : m_Resources)
+            {
+                m_Validator.OnBarrier(&m_CommandList, &resource, STATE_SHADER_RESOURCE, STATE_RENDER_TARGET);
+                m_Validator.OnDescriptorUsed(GetDescriptor(&resource));
+                m_Validator.OnBarrier(&m_CommandList, &resource, STATE_RENDER_TARGET, STATE_SHADER_RESOURCE);
+            }
+
+            if (bug == InjectedBug::StaleDescriptor)
+            {
+                m_Validator.OnResourceReleased(&m_Resources[0]);
+                m_Validator.OnResourceCreated(&m_Resources[0], STATE_SHADER_RESOURCE, "Texture (recreated)");
+                m_Validator.OnDescriptorUsed(GetDescriptor(&m_Resources[0]));
+            }
+
+            char* backBuffer = &m_BackBuffers[index];
+            m_Validator.OnBarrier(&m_CommandList, backBuffer,
+                bug == InjectedBug::WrongBarrierState ? STATE_RENDER_TARGET : STATE_PRESENT, STATE_RENDER_TARGET);
+            m_Validator.OnDescriptorUsed(GetDescriptor(backBuffer));
+            m_Validator.OnBarrier(&m_CommandList, backBuffer, STATE_RENDER_TARGET, STATE_PRESENT);
+
+            m_Validator.OnExecute(&m_CommandList);
+
+            uint64_t fenceValue = bug == InjectedBug::FenceBackwards ? m_FenceValue : ++m_FenceValue;
+            m_Validator.OnSignal(&m_Fence, fenceValue);
+            m_Validator.OnAllocatorSubmitted(&m_Allocators[index], &m_Fence, fenceValue);
+            m_FrameFenceValues[index] = fenceValue;
+
+            ++m_FrameIndex;
+        }
+
+        // Hooks per frame, for the per call cost
+        static size_t GetNumHooksPerFrame(uint32_t numResources) { return 9 + size_t(numResources) * 3; }
+
+    private:
+        static uint64_t GetDescriptor(const void* resource)
+        {
+            return reinterpret_cast<uintptr_t>(resource) * 64; // anything unique per resource
+        }
+
+        RuntimeValidator& m_Validator;
+        char m_BackBuffers[NUM_FRAMES] = {};
+        char m_Allocators[NUM_FRAMES] = {};
+        char m_CommandList = 0;
+        char m_Fence = 0;
+        std::vector<char> m_Resources;
+
+        uint64_t m_FenceValue = 0;
+        uint64_t m_FrameFenceValues[NUM_FRAMES] = {};
+        uint32_t m_FrameIndex = 0;
+    };
+
+    // Runs numFrames with the bug injected once halfway, returns the validator's error counts
+    RuntimeValidator RunNullRenderer(uint32_t numFrames, uint32_t numResources, InjectedBug bug, bool enabled)
+    {
+        RuntimeValidator validator(enabled);
+        validator.SetErrorHandler(nullptr); // counted, not printed
+        NullRenderer renderer(validator, numResources);
+        for (uint32_t i = 0; i < numFrames; ++i)
+        {
+            renderer.RenderFrame(i == numFrames / 2 ? bug : InjectedBug::None);
+        }
+        return validator;
+    }
+
+    int Validate(int argc, char** argv)
+    {
+        uint32_t numFrames = GetOption(argc, argv, 2, "--frames", 100000);
+        uint32_t numResources = GetOption(argc, argv, 2, "--resources", 32);
+
+        struct Case
+        {
+            const char* Name;
+            InjectedBug Bug;
+            ValidationErrorType Expected;
+        };
+        const Case cases[] = {
+            { "wrong barrier state", InjectedBug::WrongBarrierState, ValidationErrorType::BarrierStateMismatch },
+            { "stale descriptor", InjectedBug::StaleDescriptor, ValidationErrorType::ReleasedResourceUse },
+            { "fence going backwards", InjectedBug::FenceBackwards, ValidationErrorType::FenceValueNotIncreasing },
+            { "allocator reuse", InjectedBug::AllocatorReuse, ValidationErrorType::AllocatorResetInFlight },
+        };
+
+        bool passed = true;
+        const uint32_t checkFrames = 16;
+
+        RuntimeValidator clean = RunNullRenderer(checkFrames, numResources, InjectedBug::None, true);
+        std::printf("  %-22s : %llu errors (expected 0)\n", "clean run", static_cast<unsigned long long>(clean.GetErrorCount()));
+        passed &= clean.GetErrorCount() == 0;
+
+        for (const Case& check : cases)
+        {
+            RuntimeValidator validator = RunNullRenderer(checkFrames, numResources, check.Bug, true);
+            uint64_t expected = validator.GetErrorCount(check.Expected);
+            uint64_t other = validator.GetErrorCount() - expected;
+            bool ok = expected > 0 && other == 0;
+            std::printf("  %-22s : %s (%llu %s, %llu other)\n", check.Name, ok ? "caught" : "FAILED",
+                static_cast<unsigned long long>(expected), GetValidationErrorName(check.Expected), static_cast<unsigned long long>(other));
+            if (ok && !validator.GetErrors().empty())
+            {
+                std::printf("      %s\n", validator.GetErrors()[0].Message.c_str());
+            }
+            passed &= ok;
+        }
+
+        // Cost
+        double nsPerFrame[2];
+        for (int enabled = 0; enabled < 2; ++enabled)
+        {
+            auto start = std::chrono::steady_clock::now();
+            RunNullRenderer(numFrames, numResources, InjectedBug::None, enabled != 0);
+            nsPerFrame[enabled] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / numFrames;
+        }
+        size_t numHooks = NullRenderer::GetNumHooksPerFrame(numResources);
+        std::printf("  %u frames, %zu hooks per frame: %.0f ns per frame off, %.0f ns on (%.1f ns per hook), %.3f%% of a 16.7 ms frame\n",
+            numFrames, numHooks, nsPerFrame[0], nsPerFrame[1], (nsPerFrame[1] - nsPerFrame[0]) / numHooks,
+            100.0 * (nsPerFrame[1] - nsPerFrame[0]) / 16.7e6);
+
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    // Returns the exception message, or an empty string if nothing was thrown
+    template<typename Function>
+    std::string GetError(Function function)
+    {
+        try
+        {
+            function();
+        }
+        catch (const std::exception& e)
+        {
+            return e.what();
+        }
+        return std::string();
+    }
+
+    void WriteFile(const std::string& path, const std::string& text)
+    {
+        std::ofstream out(path, std::ios::trunc);
+        out << text;
+    }
+
+    int Config(int argc, char** argv)
+    {
+        const char* filePath = GetStringOption(argc, argv, 2, "--file", nullptr);
+        const char* writePath = GetStringOption(argc, argv, 2, "--write", nullptr);
+        if (writePath)
+        {
+            WriteFile(writePath, FormatConfig(RuntimeConfig()));
+            std::printf("Wrote the default configuration to %s\n", writePath);
+            return 0;
+        }
+        if (filePath)
+        {
+            std::printf("%s", FormatConfig(ConfigSource({ "--config", filePath }).Load()).c_str());
+            return 0;
+        }
+
+        bool passed = true;
+
+        {
+            RuntimeConfig config;
+            ParseConfigText("# comment\n  frames-in-flight = 2  \nvsync=off # trailing\n\nfps = 143.5\ndrs-trace = \"a b.csv\"\n", "text", config);
+            passed &= Check("file syntax", config.FramesInFlight == 2 && !config.Vsync && config.TargetFrameRate == 143.5
+                && config.DynamicResolutionTrace == "a b.csv");
+        }
+        {
+            RuntimeConfig config;
+            std::string error = GetError([&]() { ParseConfigText("vsync = true\nframes-in-flight = 9\n", "test.cfg", config); });
+            passed &= Check("out of range value names file:line", error.find("test.cfg:2") == 0, error);
+            error = GetError([&]() { ParseConfigText("vsinc = true\n", "test.cfg", config); });
+            passed &= Check("unknown name", error.find("unknown option") != std::string::npos, error);
+            error = GetError([&]() { ParseConfigText("width = 12.5\n", "test.cfg", config); });
+            passed &= Check("fraction for a whole number", !error.empty(), error);
+            error = GetError([&]() { ParseConfigText("validate = maybe\n", "test.cfg", config); });
+            passed &= Check("bad bool", !error.empty(), error);
+            error = GetError([&]() { ParseConfigText("fps = nan\n", "test.cfg", config); });
+            std::string infinity = GetError([&]() { ParseConfigText("gpu-budget = inf\n", "test.cfg", config); });
+            passed &= Check("not a number or infinite", !error.empty() && !infinity.empty() && std::isfinite(config.TargetFrameRate)
+                && std::isfinite(config.GPUBudgetMs), error);
+        }
+        {
+            RuntimeConfig config = ConfigSource({ "-w", "1920", "--height=1080", "-warp", "--no-vsync", "-fps", "60", "--worker-threads", "4" }).Load();
+            passed &= Check("command line forms", config.Width == 1920 && config.Height == 1080 && config.UseWarp && !config.Vsync
+                && config.TargetFrameRate == 60.0 && config.WorkerThreads == 4);
+            std::string error = GetError([]() { ConfigSource({ "--frames-in-flight" }); });
+            passed &= Check("missing value", !error.empty(), error);
+        }
+
+        // File + overrides + hot reload
+        std::string path = "RuntimeBenchConfigTest.cfg";
+        WriteFile(path, "vsync = true\nfps = 60\nframes-in-flight = 3\nreadback-ring-kb = 32\n");
+        {
+            ConfigSource source({ "--config", path, "--readback-ring-kb", "128" });
+            RuntimeConfig config = source.Load();
+            passed &= Check("command line overrides file", config.Vsync && config.TargetFrameRate == 60.0 && config.ReadbackRingSizeKB == 128);
+
+            std::vector<std::string> messages;
+            passed &= Check("no reload while unchanged", !source.Poll(config, messages, std::chrono::milliseconds(0)) && messages.empty());
+
+            // Some file systems only keep whole seconds, make sure the time moves
+            std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+            WriteFile(path, "vsync = false\nfps = 120\nframes-in-flight = 2\nreadback-ring-kb = 16\n");
+            bool applied = source.Poll(config, messages, std::chrono::milliseconds(0));
+            std::string detail;
+            for (const std::string& message : messages)
+            {
+                detail += (detail.empty() ? "" : "; ") + message;
+            }
+            passed &= Check("hot reload", applied && !config.Vsync && config.TargetFrameRate == 120.0 && config.FramesInFlight == 3
+                && config.ReadbackRingSizeKB == 128 && messages.size() == 3, detail);
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+            WriteFile(path, "vsync = \n");
+            messages.clear();
+            applied = source.Poll(config, messages, std::chrono::milliseconds(0));
+            passed &= Check("broken file keeps the old values", !applied && !config.Vsync && messages.size() == 1,
+                messages.empty() ? std::string() : messages[0]);
+        }
+        std::remove(path.c_str());
+
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    // Null backend GPU: a fixed cost plus a cost per pixel shaded, and a cheaper one per pixel upscaled
+    double ModelGPUTimeMs(const BenchmarkScenario& scenario, const BenchmarkFrame& frame, double slowdown)
+    {
+        const double FIXED_MS = 0.05;
+        const double MS_PER_MEGAPIXEL = 1.0;
+        const double UPSCALE_MS_PER_MEGAPIXEL = 0.25;
+
+        double megapixels = frame.Width * frame.Height / 1e6;
+        double ms = FIXED_MS;
+        if (scenario.ScaledRendering)
+        {
+            ms += megapixels * frame.RenderScale * frame.RenderScale * MS_PER_MEGAPIXEL + megapixels * UPSCALE_MS_PER_MEGAPIXEL;
+        }
+        else
+        {
+            ms += megapixels * MS_PER_MEGAPIXEL;
+        }
+        return ms * slowdown;
+    }
+
+    int Scenario(int argc, char** argv)
+    {
+        if (argc < 3)
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        const BenchmarkScenario* scenario = FindBenchmarkScenario(argv[2]);
+        if (!scenario)
+        {
+            std::printf("Unknown scenario %s, one of:\n", argv[2]);
+            for (const BenchmarkScenario& known : GetBenchmarkScenarios())
+            {
+                std::printf("  %-10s %s\n", known.Name, known.Description);
+            }
+            return 1;
+        }
+
+        RuntimeConfig defaults;
+        uint32_t numWarmupFrames = GetOption(argc, argv, 3, "--warmup", defaults.BenchmarkWarmupFrames);
+        uint32_t numFrames = GetOption(argc, argv, 3, "--frames", defaults.BenchmarkFrames);
+        std::string csvPath = GetStringOption(argc, argv, 3, "--csv", "");
+        std::string baselinePath = GetStringOption(argc, argv, 3, "--baseline", "");
+        std::string saveBaselinePath = GetStringOption(argc, argv, 3, "--save-baseline", "");
+        double slowdown = 1.0 + GetOption(argc, argv, 3, "--slowdown", 0) / 100.0;
+
+        // Same draws and barriers per frame as main.cpp: the back buffer's two transitions, plus the scene target's
+        // two and the upscale draw when rendering scaled
+        const uint32_t numDraws = scenario->ScaledRendering ? 1 : 0;
+        const uint32_t numBarriers = scenario->ScaledRendering ? 4 : 2;
+        const uint32_t GPU_LATENCY_FRAMES = 2;
+
+        RuntimeValidator validator(false);
+        NullRenderer renderer(validator, 256);
+        BenchmarkRun run(*scenario, numWarmupFrames, numFrames);
+        std::vector<double> gpuTimes; // by frame index, reported GPU_LATENCY_FRAMES later
+
+        while (!run.IsDone())
+        {
+            BenchmarkFrame frame = run.GetFrame();
+
+            auto start = std::chrono::steady_clock::now();
+            renderer.RenderFrame(InjectedBug::None);
+            double cpuTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            // Back buffers, plus the full size scene target when rendering scaled
+            double frameMB = frame.Width * frame.Height * 4.0 / (1024.0 * 1024.0);
+            double memoryMB = frameMB * (NullRenderer::NUM_FRAMES + (scenario->ScaledRendering ? 1 : 0));
+
+            uint32_t frameIndex = run.GetFrameIndex();
+            gpuTimes.push_back(ModelGPUTimeMs(*scenario, frame, slowdown));
+            run.EndFrame(cpuTimeMs, memoryMB, numDraws, numBarriers);
+            if (frameIndex >= GPU_LATENCY_FRAMES)
+            {
+                run.SetGPUTime(frameIndex - GPU_LATENCY_FRAMES, gpuTimes[frameIndex - GPU_LATENCY_FRAMES]);
+            }
+        }
+
+        // The flush at the end brings in the last frames' times
+        for (uint32_t i = static_cast<uint32_t>(gpuTimes.size() > GPU_LATENCY_FRAMES ? gpuTimes.size() - GPU_LATENCY_FRAMES : 0);
+            i < gpuTimes.size(); ++i)
+        {
+            run.SetGPUTime(i, gpuTimes[i]);
+        }
+
+        std::vector<BenchmarkMetric> summary = run.GetSummary();
+        std::printf("%s", FormatBenchmarkSummary(scenario->Name, summary).c_str());
+
+        if (!csvPath.empty())
+        {
+            run.WriteCSV(csvPath);
+            std::printf("Wrote %zu frames to %s\n", run.GetSamples().size(), csvPath.c_str());
+        }
+        if (!saveBaselinePath.empty())
+        {
+            SaveBenchmarkBaseline(saveBaselinePath, summary);
+            std::printf("Saved the baseline to %s\n", saveBaselinePath.c_str());
+        }
+        if (!baselinePath.empty())
+        {
+            std::vector<std::string> regressions = CheckBenchmarkBaseline(baselinePath, summary);
+            for (const std::string& regression : regressions)
+            {
+                std::printf("REGRESSION %s\n", regression.c_str());
+            }
+            std::printf("%s %s\n", regressions.empty() ? "No regressions against" : "Regressed against", baselinePath.c_str());
+            return regressions.empty() ? 0 : 1;
+        }
+        return 0;
+    }
+
+    struct MultiGPUSimulation
+    {
+        uint32_t NumNodes = 2;
+        uint32_t NumBackBuffers = 4;
+        uint32_t NumFrames = 1000;
+        uint32_t Height = 1080;
+        double CPUUs = 2000.0;       // recording a frame
+        double GPUUs = 10000.0;      // rendering a whole frame on one node
+        double HistoryPoint = 0.8;   // fraction of the frame rendered before the history is read
+        double CopyUs = 1000.0;      // a cross-node copy of a full frame (history or bands)
+        double SFRFixed = 0.15;      // fraction of the frame's GPU time every node pays in SFR (geometry, shadows)
+        double SlowNodeFactor = 1.0; // node 1's times are multiplied by this
+    };
+
+    struct MultiGPUSimulationResult
+    {
+        double FrameMs;       // average interval between presents
+        double P99IntervalMs;
+        uint32_t NumHistoryCopies;
+        bool HistoryCorrect;  // every frame saw the previous frame's history
+        bool SlotsRespected;  // no frame started recording before its back buffer's last frame was done on every node
+        float FinalSplit[MAX_NODES];
+        double BandImbalance; // slowest / fastest node time of the last SFR frame
+    };
+
+    // Stand-in for a linked adapter, driven by the real MultiGPUScheduler with the same waits as LinkedDevice.
+    // Every queue runs one thing at a time and is modelled by the time it's busy until, a fence by the time the work
+    // it follows ends. Nothing sleeps, a run is just arithmetic on simulated microseconds.
+    MultiGPUSimulationResult SimulateMultiGPU(const MultiGPUSimulation& simulation, MultiGPUMode mode)
+    {
+        struct SimulatedNode
+        {
+            double DirectFree = 0.0;
+            double CopyFree = 0.0;
+            double FenceTime = 0.0;           // when the last direct work signaled so far finishes
+            double CopyFenceTime = 0.0;
+            double Speed = 1.0;
+            int64_t HistoryFrame = -1;        // frame whose history this node's instance holds
+            std::vector<double> FrameDone;    // per back buffer, like LinkedDevice's FrameFenceValues
+            std::vector<double> BandMs;       // SFR band time per back buffer, read back when the slot is reused
+        };
+
+        MultiGPUScheduler scheduler(simulation.NumNodes, mode);
+        std::vector<SimulatedNode> nodes(scheduler.GetNumNodes());
+        for (uint32_t i = 0; i < nodes.size(); ++i)
+        {
+            nodes[i].Speed = i == 1 ? simulation.SlowNodeFactor : 1.0;
+            nodes[i].FrameDone.assign(simulation.NumBackBuffers, 0.0);
+            nodes[i].BandMs.assign(simulation.NumBackBuffers, 0.0);
+        }
+
+        MultiGPUSimulationResult result = {};
+        result.HistoryCorrect = true;
+        result.SlotsRespected = true;
+
+        double cpuFree = 0.0;
+        double lastPresent = 0.0;
+        std::vector<double> intervals;
+        double bandMs[MAX_NODES] = {};
+        for (uint32_t f = 0; f < simulation.NumFrames; ++f)
+        {
+            uint32_t backBuffer = f % simulation.NumBackBuffers;
+
+            // WaitForFrame, then the band times of the frame that used the slot are in
+            double slotFree = 0.0;
+            for (SimulatedNode& node : nodes)
+            {
+                slotFree = std::max(slotFree, node.FrameDone[backBuffer]);
+            }
+            double cpuStart = std::max(cpuFree, slotFree);
+            double cpuEnd = cpuStart + simulation.CPUUs;
+            cpuFree = cpuEnd;
+            if (mode == MultiGPUMode::SplitFrame && f >= simulation.NumBackBuffers)
+            {
+                for (uint32_t i = 0; i < nodes.size(); ++i)
+                {
+                    bandMs[i] = nodes[i].BandMs[backBuffer];
+                }
+                scheduler.UpdateSplit(bandMs);
+            }
+
+            MultiGPUFrame frame = scheduler.BeginFrame(backBuffer);
+            double done = 0.0;
+            if (scheduler.GetMode() == MultiGPUMode::SplitFrame)
+            {
+                // Every node renders its band, then node 0's copy queue pulls the other bands in and node 0 copies the
+                // whole frame to the back buffer (a local copy, a lot cheaper than across nodes)
+                double bandsDone = 0.0;
+                for (uint32_t i = 0; i < nodes.size(); ++i)
+                {
+                    SimulatedNode& node = nodes[i];
+                    NodeBand band = scheduler.GetBand(i, simulation.Height);
+                    double fraction = static_cast<double>(band.Bottom - band.Top) / simulation.Height;
+                    double us = simulation.GPUUs * node.Speed * (simulation.SFRFixed + (1.0 - simulation.SFRFixed) * fraction);
+                    double start = std::max(node.DirectFree, cpuEnd);
+                    node.DirectFree = start + us;
+                    node.FenceTime = node.DirectFree;
+                    node.BandMs[backBuffer] = us / 1000.0;
+                    bandsDone = std::max(bandsDone, node.FenceTime);
+                }
+
+                SimulatedNode& node0 = nodes[0];
+                NodeBand band0 = scheduler.GetBand(0, simulation.Height);
+                double composeStart = std::max(node0.CopyFree, bandsDone);
+                node0.CopyFree = composeStart + simulation.CopyUs * (1.0 - static_cast<double>(band0.Bottom) / simulation.Height);
+                node0.CopyFenceTime = node0.CopyFree;
+
+                node0.DirectFree = std::max(node0.DirectFree, node0.CopyFenceTime) + simulation.CopyUs * 0.1;
+                node0.FenceTime = node0.DirectFree;
+                done = node0.DirectFree;
+                for (SimulatedNode& node : nodes)
+                {
+                    node.FrameDone[backBuffer] = std::max(node.FenceTime, node.CopyFenceTime);
+                }
+
+                result.BandImbalance = *std::max_element(nodes[0].BandMs.begin(), nodes[0].BandMs.end()) > 0.0
+                    ? std::max(nodes[0].BandMs[backBuffer], nodes[1 % nodes.size()].BandMs[backBuffer])
+                        / std::min(nodes[0].BandMs[backBuffer], nodes[1 % nodes.size()].BandMs[backBuffer])
+                    : 1.0;
+            }
+            else
+            {
+                SimulatedNode& node = nodes[frame.PresentNode];
+                double copyDone = 0.0;
+                if (frame.CopyHistory)
+                {
+                    // QueueHistoryCopy: waits for the source's last frame and for this node's own last frame
+                    SimulatedNode& source = nodes[frame.HistorySourceNode];
+                    result.HistoryCorrect &= source.HistoryFrame == static_cast<int64_t>(f) - 1;
+                    double start = std::max({ node.CopyFree, source.FenceTime, node.FenceTime });
+                    node.CopyFree = start + simulation.CopyUs;
+                    node.CopyFenceTime = node.CopyFree;
+                    node.HistoryFrame = source.HistoryFrame;
+                    copyDone = node.CopyFree;
+                    ++result.NumHistoryCopies;
+                }
+                result.HistoryCorrect &= f == 0 || node.HistoryFrame == static_cast<int64_t>(f) - 1;
+
+                double start = std::max(node.DirectFree, cpuEnd);
+                double beforeHistory = start + simulation.GPUUs * node.Speed * simulation.HistoryPoint;
+                node.DirectFree = std::max(beforeHistory, copyDone) + simulation.GPUUs * node.Speed * (1.0 - simulation.HistoryPoint);
+                node.FenceTime = node.DirectFree;
+                node.HistoryFrame = f;
+                node.FrameDone[backBuffer] = std::max(node.FenceTime, frame.CopyHistory ? node.CopyFenceTime : 0.0);
+                done = node.DirectFree;
+            }
+
+            // A frame's recording must not start before the GPU is done with its slot
+            result.SlotsRespected &= cpuStart >= slotFree;
+
+            // Presents go out in order
+            double present = std::max(lastPresent, done);
+            if (f >= simulation.NumFrames / 10) // skip the ramp up
+            {
+                intervals.push_back((present - lastPresent) / 1000.0);
+            }
+            lastPresent = present;
+        }
+
+        double total = 0.0;
+        for (double interval : intervals)
+        {
+            total += interval;
+        }
+        result.FrameMs = intervals.empty() ? 0.0 : total / intervals.size();
+        std::sort(intervals.begin(), intervals.end());
+        result.P99IntervalMs = intervals.empty() ? 0.0 : intervals[std::min(intervals.size() - 1, intervals.size() * 99 / 100)];
+        for (uint32_t i = 0; i < scheduler.GetNumNodes(); ++i)
+        {
+            result.FinalSplit[i] = scheduler.GetSplit(i);
+        }
+        return result;
+    }
+
+    bool CheckMultiGPUScheduler()
+    {
+        bool passed = true;
+
+        // Node masks: one creation node, visible to at least that node, never outside the adapter
+        bool masksOk = true;
+        for (uint32_t numNodes = 1; numNodes <= MAX_NODES; ++numNodes)
+        {
+            for (NodeSharing sharing : { NodeSharing::PerNode, NodeSharing::PerNodeVisible, NodeSharing::Shared })
+            {
+                uint32_t numInstances = GetNumNodeInstances(sharing, numNodes);
+                masksOk &= numInstances == (sharing == NodeSharing::Shared ? 1 : numNodes);
+                for (uint32_t instance = 0; instance < numInstances; ++instance)
+                {
+                    NodeMasks masks = GetNodeMasks(sharing, instance, numNodes);
+                    bool oneBit = masks.CreationNodeMask != 0 && (masks.CreationNodeMask & (masks.CreationNodeMask - 1)) == 0;
+                    masksOk &= oneBit && (masks.VisibleNodeMask & masks.CreationNodeMask) == masks.CreationNodeMask
+                        && (masks.VisibleNodeMask & ~GetAllNodesMask(numNodes)) == 0;
+                    masksOk &= sharing != NodeSharing::PerNodeVisible || masks.VisibleNodeMask == GetAllNodesMask(numNodes);
+                    masksOk &= sharing != NodeSharing::PerNode || masks.VisibleNodeMask == masks.CreationNodeMask;
+                }
+                for (uint32_t node = 0; node < numNodes; ++node)
+                {
+                    // The instance a node uses must be visible to it
+                    NodeMasks masks = GetNodeMasks(sharing, GetNodeInstance(sharing, node), numNodes);
+                    masksOk &= (masks.VisibleNodeMask & GetNodeMask(node)) != 0;
+                }
+            }
+        }
+        passed &= Check("node masks", masksOk);
+
+        // AFR with 4 back buffers: nodes alternate and every frame but the first copies from the other node
+        {
+            MultiGPUScheduler scheduler(2, MultiGPUMode::AlternateFrame);
+            bool ok = true;
+            for (uint32_t f = 0; f < 16; ++f)
+            {
+                MultiGPUFrame frame = scheduler.BeginFrame(f % 4);
+                ok &= frame.PresentNode == f % 2 && frame.NodeMask == GetNodeMask(f % 2);
+                ok &= frame.CopyHistory == (f > 0) && (f == 0 || frame.HistorySourceNode == (f + 1) % 2);
+            }
+            passed &= Check("AFR alternates with 4 back buffers", ok);
+        }
+
+        // 3 back buffers on 2 nodes: buffers 2 and 0 are both on node 0, so every third frame stays put and copies nothing
+        {
+            MultiGPUScheduler scheduler(2, MultiGPUMode::AlternateFrame);
+            bool ok = true;
+            uint32_t numCopies = 0;
+            for (uint32_t f = 0; f < 12; ++f)
+            {
+                MultiGPUFrame frame = scheduler.BeginFrame(f % 3);
+                ok &= frame.PresentNode == (f % 3) % 2;
+                numCopies += frame.CopyHistory ? 1 : 0;
+            }
+            passed &= Check("AFR with 3 back buffers", ok && numCopies == 8, std::to_string(numCopies) + " copies in 12 frames");
+        }
+
+        // Single and one node adapters ignore the mode
+        {
+            MultiGPUScheduler single(2, MultiGPUMode::Single);
+            MultiGPUScheduler oneNode(1, MultiGPUMode::AlternateFrame);
+            MultiGPUFrame frame = oneNode.BeginFrame(1);
+            passed &= Check("single node fallback", single.GetNumNodes() == 1 && oneNode.GetMode() == MultiGPUMode::Single
+                && frame.PresentNode == 0 && !frame.CopyHistory);
+        }
+
+        // SFR bands tile the frame whatever the split
+        {
+            std::mt19937 random(1234);
+            std::uniform_real_distribution<double> time(1.0, 20.0);
+            bool ok = true;
+            for (uint32_t numNodes = 2; numNodes <= MAX_NODES; ++numNodes)
+            {
+                MultiGPUScheduler scheduler(numNodes, MultiGPUMode::SplitFrame);
+                for (uint32_t i = 0; i < 100; ++i)
+                {
+                    double times[MAX_NODES];
+                    for (double& t : times)
+                    {
+                        t = time(random);
+                    }
+                    scheduler.UpdateSplit(times);
+
+                    uint32_t height = 1 + random() % 2160;
+                    uint32_t row = 0;
+                    for (uint32_t node = 0; node < numNodes; ++node)
+                    {
+                        NodeBand band = scheduler.GetBand(node, height);
+                        ok &= band.Top == row && band.Bottom >= band.Top;
+                        row = band.Bottom;
+                    }
+                    ok &= row == height;
+                }
+            }
+            passed &= Check("SFR bands cover the frame", ok);
+        }
+
+        return passed;
+    }
+
+    int MultiGPU(int argc, char** argv)
+    {
+        MultiGPUSimulation simulation;
+        simulation.NumFrames = GetOption(argc, argv, 2, "--frames", simulation.NumFrames);
+        simulation.CPUUs = GetOption(argc, argv, 2, "--cpu", static_cast<uint32_t>(simulation.CPUUs));
+        simulation.GPUUs = GetOption(argc, argv, 2, "--gpu", static_cast<uint32_t>(simulation.GPUUs));
+        simulation.CopyUs = GetOption(argc, argv, 2, "--copy", static_cast<uint32_t>(simulation.CopyUs));
+        simulation.HistoryPoint = std::min(100u, GetOption(argc, argv, 2, "--history-point", 80)) / 100.0;
+        simulation.SFRFixed = std::min(100u, GetOption(argc, argv, 2, "--sfr-fixed", 15)) / 100.0;
+        simulation.SlowNodeFactor = 1.0 + GetOption(argc, argv, 2, "--slow-node", 0) / 100.0;
+        if (simulation.NumFrames < 20)
+        {
+            throw std::runtime_error("--frames must be >= 20");
+        }
+
+        std::printf("Scheduler checks:\n");
+        bool passed = CheckMultiGPUScheduler();
+
+        std::printf("\nSimulated 2 node device, %u frames: CPU %.0f us, GPU %.0f us per frame (node 1 x%.2f), history read at %.0f%%,"
+            " cross-node copy %.0f us, %.0f%% of a frame not split by SFR\n", simulation.NumFrames, simulation.CPUUs,
+            simulation.GPUUs, simulation.SlowNodeFactor, simulation.HistoryPoint * 100.0, simulation.CopyUs, simulation.SFRFixed * 100.0);
+        std::printf("  %-8s %10s %8s %12s %8s %s\n", "mode", "frame ms", "speedup", "p99 interval", "copies", "split");
+
+        MultiGPUSimulationResult single = SimulateMultiGPU(simulation, MultiGPUMode::Single);
+        for (MultiGPUMode mode : { MultiGPUMode::Single, MultiGPUMode::AlternateFrame, MultiGPUMode::SplitFrame })
+        {
+            MultiGPUSimulationResult result = SimulateMultiGPU(simulation, mode);
+            char split[64] = "";
+            if (mode == MultiGPUMode::SplitFrame)
+            {
+                std::snprintf(split, sizeof(split), "%.2f / %.2f (times within %.1f%%)", result.FinalSplit[0], result.FinalSplit[1],
+                    (result.BandImbalance - 1.0) * 100.0);
+            }
+            std::printf("  %-8s %10.3f %7.2fx %12.3f %8u %s\n", GetMultiGPUModeName(mode), result.FrameMs,
+                result.FrameMs > 0.0 ? single.FrameMs / result.FrameMs : 0.0, result.P99IntervalMs, result.NumHistoryCopies, split);
+
+            std::string name = std::string(GetMultiGPUModeName(mode)) + " history and slots";
+            passed &= Check(name.c_str(), result.HistoryCorrect && result.SlotsRespected);
+            if (mode == MultiGPUMode::SplitFrame)
+            {
+                passed &= Check("sfr load balanced", result.BandImbalance < 1.05);
+            }
+        }
+
+        // The same AFR run with 3 back buffers: frames that stay on a node skip the copy, the history must still line up
+        simulation.NumBackBuffers = 3;
+        MultiGPUSimulationResult threeBuffers = SimulateMultiGPU(simulation, MultiGPUMode::AlternateFrame);
+        passed &= Check("afr with 3 back buffers", threeBuffers.HistoryCorrect && threeBuffers.SlotsRespected,
+            std::to_string(threeBuffers.NumHistoryCopies) + " copies, " + std::to_string(threeBuffers.FrameMs).substr(0, 6) + " ms per frame");
+
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    // A frame's passes plus the actions they're expected to get, for the renderpass checks
+    struct RenderPassCase
+    {
+        const char* Name;
+        std::vector<RenderPassResource> Resources;
+        std::vector<RenderPassUsage> Passes;
+        std::vector<RenderPassActions> Expected;
+    };
+
+    RenderPassUsage MakePass(const char* name, std::vector<AttachmentUsage> renderTargets, std::vector<uint32_t> shaderReads = {})
+    {
+        RenderPassUsage pass;
+        pass.Name = name;
+        pass.RenderTargets = std::move(renderTargets);
+        pass.ShaderReads = std::move(shaderReads);
+        return pass;
+    }
+
+    RenderPassUsage MakeDepthPass(const char* name, std::vector<AttachmentUsage> renderTargets, AttachmentUsage depthStencil,
+        std::vector<uint32_t> shaderReads = {})
+    {
+        RenderPassUsage pass = MakePass(name, std::move(renderTargets), std::move(shaderReads));
+        pass.HasDepthStencil = true;
+        pass.DepthStencil = depthStencil;
+        return pass;
+    }
+
+    // Attachment usages, by what the pass does to the attachment
+    AttachmentUsage Cleared(uint32_t resource) { return { resource, true, false, false }; }
+    AttachmentUsage Overwritten(uint32_t resource) { return { resource, false, false, true }; }
+    AttachmentUsage Blended(uint32_t resource) { return { resource, false, true, false }; }
+    AttachmentUsage PartlyWritten(uint32_t resource) { return { resource, false, false, false }; }
+
+    const AttachmentActions CLEAR_PRESERVE = { LoadAction::Clear, StoreAction::Preserve };
+    const AttachmentActions CLEAR_DISCARD = { LoadAction::Clear, StoreAction::Discard };
+    const AttachmentActions PRESERVE_PRESERVE = { LoadAction::Preserve, StoreAction::Preserve };
+    const AttachmentActions PRESERVE_DISCARD = { LoadAction::Preserve, StoreAction::Discard };
+    const AttachmentActions DISCARD_PRESERVE = { LoadAction::Discard, StoreAction::Preserve };
+    const AttachmentActions DISCARD_DISCARD = { LoadAction::Discard, StoreAction::Discard };
+
+    bool operator==(const AttachmentActions& a, const AttachmentActions& b)
+    {
+        return a.Load == b.Load && a.Store == b.Store;
+    }
+
+    std::string FormatActions(const AttachmentActions& actions)
+    {
+        return std::string(GetLoadActionName(actions.Load)) + "/" + GetStoreActionName(actions.Store);
+    }
+
+    // Compares every attachment's actions, and names the first that's wrong
+    bool MatchesExpected(const RenderPassCase& test, const std::vector<RenderPassActions>& actions, std::string& detail)
+    {
+        for (size_t i = 0; i < test.Passes.size(); ++i)
+        {
+            const RenderPassUsage& pass = test.Passes[i];
+            for (size_t j = 0; j < pass.RenderTargets.size(); ++j)
+            {
+                if (!(actions[i].RenderTargets[j] == test.Expected[i].RenderTargets[j]))
+                {
+                    detail = pass.Name + " " + test.Resources[pass.RenderTargets[j].Resource].Name + " is "
+                        + FormatActions(actions[i].RenderTargets[j]) + ", expected " + FormatActions(test.Expected[i].RenderTargets[j]);
+                    return false;
+                }
+            }
+            if (pass.HasDepthStencil && !(actions[i].DepthStencil == test.Expected[i].DepthStencil))
+            {
+                detail = pass.Name + " " + test.Resources[pass.DepthStencil.Resource].Name + " is "
+                    + FormatActions(actions[i].DepthStencil) + ", expected " + FormatActions(test.Expected[i].DepthStencil);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<RenderPassCase> GetRenderPassCases()
+    {
+        std::vector<RenderPassCase> cases;
+
+        // What main.cpp records: nothing else touches the back buffer
+        cases.push_back({ "clear the back buffer", { { "BackBuffer", true } },
+            { MakePass("Clear", { Cleared(0) }) },
+            { { { CLEAR_PRESERVE } } } });
+
+        // A deferred frame: the G-buffer and depth only live within it, HDR is resolved by the tonemap,
+        // the UI blends over the tonemapped image
+        enum { BACK_BUFFER, ALBEDO, NORMAL, DEPTH, HDR };
+        cases.push_back({ "deferred frame",
+            { { "BackBuffer", true }, { "Albedo", false }, { "Normal", false }, { "Depth", false }, { "HDR", false } },
+            {
+                MakeDepthPass("GBuffer", { Cleared(ALBEDO), Cleared(NORMAL) }, Cleared(DEPTH)),
+                MakePass("Lighting", { Overwritten(HDR) }, { ALBEDO, NORMAL }),
+                MakePass("Tonemap", { Overwritten(BACK_BUFFER) }, { HDR }),
+                MakePass("UI", { Blended(BACK_BUFFER) }),
+            },
+            {
+                { { CLEAR_PRESERVE, CLEAR_PRESERVE }, CLEAR_DISCARD },
+                { { DISCARD_PRESERVE } },
+                { { DISCARD_PRESERVE } },
+                { { PRESERVE_PRESERVE } },
+            } });
+
+        // Depth laid down first, then tested against: kept in between, not after
+        cases.push_back({ "depth prepass",
+            { { "BackBuffer", true }, { "Depth", false } },
+            {
+                MakeDepthPass("DepthPrepass", {}, Cleared(1)),
+                MakeDepthPass("Main", { Cleared(0) }, Blended(1)),
+            },
+            {
+                { {}, CLEAR_PRESERVE },
+                { { CLEAR_PRESERVE }, PRESERVE_DISCARD },
+            } });
+
+        // A transient target that isn't entirely written has nothing worth loading the first time
+        cases.push_back({ "transient partial write",
+            { { "BackBuffer", true }, { "Decals", false } },
+            {
+                MakePass("Decals", { PartlyWritten(1) }),
+                MakePass("Composite", { Overwritten(0) }, { 1 }),
+            },
+            {
+                { { DISCARD_PRESERVE } },
+                { { DISCARD_PRESERVE } },
+            } });
+
+        // Last frame's image is loaded and accumulated into, then kept for the next frame
+        cases.push_back({ "external history",
+            { { "BackBuffer", true }, { "History", true } },
+            {
+                MakePass("Accumulate", { Blended(1) }),
+                MakePass("Copy", { Overwritten(0) }, { 1 }),
+            },
+            {
+                { { PRESERVE_PRESERVE } },
+                { { DISCARD_PRESERVE } },
+            } });
+
+        // Written, then cleared again before anything read it: the first write is wasted, at least don't store it
+        cases.push_back({ "overwritten before read",
+            { { "BackBuffer", true }, { "Scratch", false } },
+            {
+                MakePass("First", { Cleared(1) }),
+                MakePass("Second", { Cleared(1) }),
+                MakePass("Resolve", { Overwritten(0) }, { 1 }),
+            },
+            {
+                { { CLEAR_DISCARD } },
+                { { CLEAR_PRESERVE } },
+                { { DISCARD_PRESERVE } },
+            } });
+
+        return cases;
+    }
+
+    // Bytes moved between memory and the tiles: a load reads the attachment, a store writes it
+    double GetAttachmentTrafficMB(const AttachmentActions& actions, double sizeMB)
+    {
+        return (actions.Load == LoadAction::Preserve ? sizeMB : 0.0) + (actions.Store == StoreAction::Preserve ? sizeMB : 0.0);
+    }
+
+    int RenderPass(int argc, char** argv)
+    {
+        uint32_t width = GetOption(argc, argv, 2, "--width", 1920);
+        uint32_t height = GetOption(argc, argv, 2, "--height", 1080);
+
+        std::printf("Inference checks:\n");
+        bool passed = true;
+        std::vector<RenderPassCase> cases = GetRenderPassCases();
+        for (const RenderPassCase& test : cases)
+        {
+            std::string detail;
+            std::vector<RenderPassActions> actions;
+            std::string error = GetError([&]() { actions = InferRenderPassActions(test.Resources, test.Passes); });
+            bool ok = error.empty() && MatchesExpected(test, actions, detail);
+            passed &= Check(test.Name, ok, error.empty() ? detail : error);
+        }
+
+        {
+            std::vector<RenderPassResource> resources = { { "BackBuffer", true }, { "HDR", false } };
+            std::string error = GetError([&]() { InferRenderPassActions(resources, { MakePass("Twice", { Cleared(1), Cleared(1) }) }); });
+            passed &= Check("attachment bound twice", !error.empty(), error);
+            error = GetError([&]() { InferRenderPassActions(resources, { MakePass("Feedback", { Blended(1) }, { 1 }) }); });
+            passed &= Check("attachment also sampled", !error.empty(), error);
+            error = GetError([&]() { InferRenderPassActions(resources, { MakePass("Missing", { Cleared(2) }) }); });
+            passed &= Check("resource out of range", !error.empty(), error);
+        }
+
+        // The deferred frame's actions, and what they save over loading and storing everything
+        const RenderPassCase& deferred = cases[1];
+        const double BYTES_PER_PIXEL[] = { 4, 4, 4, 4, 8 }; // RGBA8 back buffer, albedo and normal, D32 depth, RGBA16F HDR
+        std::vector<RenderPassActions> actions = InferRenderPassActions(deferred.Resources, deferred.Passes);
+        std::printf("\nDeferred frame at %ux%u:\n  %-10s %-12s %-18s %10s\n", width, height, "pass", "attachment", "load/store", "MB moved");
+        double inferredMB = 0.0;
+        double preserveAllMB = 0.0;
+        for (size_t i = 0; i < deferred.Passes.size(); ++i)
+        {
+            const RenderPassUsage& pass = deferred.Passes[i];
+            std::vector<std::pair<const AttachmentUsage*, AttachmentActions>> attachments;
+            for (size_t j = 0; j < pass.RenderTargets.size(); ++j)
+            {
+                attachments.push_back({ &pass.RenderTargets[j], actions[i].RenderTargets[j] });
+            }
+            if (pass.HasDepthStencil)
+            {
+                attachments.push_back({ &pass.DepthStencil, actions[i].DepthStencil });
+            }
+
+            for (const auto& attachment : attachments)
+            {
+                double sizeMB = width * height * BYTES_PER_PIXEL[attachment.first->Resource] / (1024.0 * 1024.0);
+                double trafficMB = GetAttachmentTrafficMB(attachment.second, sizeMB);
+                inferredMB += trafficMB;
+                preserveAllMB += GetAttachmentTrafficMB(
+                    { attachment.first->Clear ? LoadAction::Clear : LoadAction::Preserve, StoreAction::Preserve }, sizeMB);
+                std::printf("  %-10s %-12s %-18s %10.2f\n", pass.Name.c_str(), deferred.Resources[attachment.first->Resource].Name.c_str(),
+                    FormatActions(attachment.second).c_str(), trafficMB);
+            }
+        }
+        std::printf("  %.2f MB per frame, %.2f MB loading and storing everything (%.0f%% saved)\n", inferredMB, preserveAllMB,
+            preserveAllMB > 0.0 ? (1.0 - inferredMB / preserveAllMB) * 100.0 : 0.0);
+
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    // Stands in for InstanceRenderer: the instance data goes to plain memory and each draw becomes the commands the
+    // real one would record, skipping state that's already set the same way
+    class NullInstanceBackend : public IInstanceBackend
+    {
+    public:
+        explicit NullInstanceBackend(uint32_t capacity)
+            : m_Memory(capacity)
+        {
+        }
+
+        void BeginFrame()
+        {
+            m_Used = 0;
+            m_Bound = { NONE, NONE, NONE };
+            m_Commands.clear();
+            m_NumDraws = 0;
+        }
+
+        InstanceData* AllocateInstances(uint32_t numInstances) override
+        {
+            if (numInstances > m_Memory.size() - m_Used)
+            {
+                return nullptr;
+            }
+            m_Allocation = m_Used;
+            m_Used += numInstances;
+            return &m_Memory[m_Allocation];
+        }
+
+        void DrawInstances(const InstanceKey& key, uint32_t firstInstance, uint32_t numInstances) override
+        {
+            if (key.PipelineState != m_Bound.PipelineState)
+            {
+                m_Commands.push_back({ COMMAND_SET_PIPELINE_STATE, key.PipelineState });
+            }
+            if (key.Material != m_Bound.Material)
+            {
+                m_Commands.push_back({ COMMAND_SET_MATERIAL, key.Material });
+            }
+            if (key.Mesh != m_Bound.Mesh)
+            {
+                m_Commands.push_back({ COMMAND_SET_MESH, key.Mesh });
+            }
+            m_Bound = key;
+            m_Commands.push_back({ COMMAND_SET_INSTANCES, uint64_t(m_Allocation + firstInstance) * sizeof(InstanceData) });
+            m_Commands.push_back({ COMMAND_DRAW, numInstances });
+            ++m_NumDraws;
+        }
+
+        const InstanceData* GetInstances() const { return m_Memory.data(); }
+        size_t GetNumCommands() const { return m_Commands.size(); }
+        uint32_t GetNumDraws() const { return m_NumDraws; }
+
+    private:
+        enum CommandType
+        {
+            COMMAND_SET_PIPELINE_STATE,
+            COMMAND_SET_MATERIAL,
+            COMMAND_SET_MESH,
+            COMMAND_SET_INSTANCES,
+            COMMAND_DRAW,
+        };
+
+        struct Command
+        {
+            CommandType Type;
+            uint64_t Argument;
+        };
+
+        static const uint32_t NONE = 0xFFFFFFFF;
+
+        std::vector<InstanceData> m_Memory;
+        uint32_t m_Used = 0;
+        uint32_t m_Allocation = 0;
+        InstanceKey m_Bound = { NONE, NONE, NONE };
+        std::vector<Command> m_Commands;
+        uint32_t m_NumDraws = 0;
+    };
+
+    // The scene as the game sees it, which the one draw per object path walks
+    struct SceneObject
+    {
+        InstanceKey Key;
+        InstanceData Data;
+        bool Visible;
+    };
+
+    // 64 meshes with 1 to 3 materials each out of 16, a pipeline state per material kind
+    InstanceKey MakeSceneKey(std::mt19937& random)
+    {
+        uint32_t mesh = random() % 64;
+        uint32_t material = (mesh * 3 + random() % 3) % 16;
+        return { mesh, material, material % 4 };
+    }
+
+    InstanceData MakeInstanceData(uint32_t id, float time)
+    {
+        InstanceData data = {};
+        float angle = time + id * 0.01f;
+        data.World[0][0] = std::cos(angle);
+        data.World[0][2] = std::sin(angle);
+        data.World[1][1] = 1.0f;
+        data.World[2][0] = -std::sin(angle);
+        data.World[2][2] = std::cos(angle);
+        data.World[0][3] = float(id % 317);
+        data.World[1][3] = time;
+        data.World[2][3] = float(id / 317);
+        data.UserData[0] = id;
+        return data;
+    }
+
+    // What changes in a frame: some objects move, some get culled or unculled, a few swap material
+    struct SceneUpdate
+    {
+        enum Type
+        {
+            Move,
+            ToggleVisible,
+            ChangeKey,
+        } Kind;
+        uint32_t Object;
+        InstanceKey Key;
+    };
+
+    std::vector<std::vector<SceneUpdate>> MakeSceneUpdates(uint32_t numObjects, uint32_t numFrames, uint32_t movingPercent, uint32_t seed)
+    {
+        std::mt19937 random(seed);
+        std::vector<std::vector<SceneUpdate>> frames(numFrames);
+        for (std::vector<SceneUpdate>& updates : frames)
+        {
+            for (uint32_t i = 0; i < numObjects * movingPercent / 100; ++i)
+            {
+                updates.push_back({ SceneUpdate::Move, static_cast<uint32_t>(random() % numObjects), {} });
+            }
+            for (uint32_t i = 0; i < numObjects / 100; ++i)
+            {
+                updates.push_back({ SceneUpdate::ToggleVisible, static_cast<uint32_t>(random() % numObjects), {} });
+            }
+            for (uint32_t i = 0; i < numObjects / 2000; ++i)
+            {
+                updates.push_back({ SceneUpdate::ChangeKey, static_cast<uint32_t>(random() % numObjects), MakeSceneKey(random) });
+            }
+        }
+        return frames;
+    }
+
+    // Draws the last Submit made against the scene: every visible object exactly once, in a draw of its own key,
+    // with its current data
+    bool CheckInstanceDraws(const InstanceBatcher& batcher, const NullInstanceBackend& backend, const std::vector<InstanceHandle>& handles,
+        std::string& detail)
+    {
+        std::vector<uint32_t> drawn(handles.size(), 0);
+        for (const InstanceBatch& batch : batcher.GetBatches())
+        {
+            for (uint32_t i = 0; i < batch.NumInstances; ++i)
+            {
+                const InstanceData& instance = backend.GetInstances()[batch.FirstInstance + i];
+                uint32_t id = instance.UserData[0];
+                if (id >= handles.size() || !(batcher.GetKey(handles[id]) == batch.Key)
+                    || std::memcmp(&instance, &batcher.GetData(handles[id]), sizeof(InstanceData)) != 0)
+                {
+                    detail = "object " + std::to_string(id) + " drawn wrong";
+                    return false;
+                }
+                ++drawn[id];
+            }
+        }
+        for (size_t id = 0; id < handles.size(); ++id)
+        {
+            if (drawn[id] != (batcher.IsVisible(handles[id]) ? 1u : 0u))
+            {
+                detail = "object " + std::to_string(id) + " drawn " + std::to_string(drawn[id]) + " times";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int Instancing(int argc, char** argv)
+    {
+        uint32_t numObjects = std::max(2000u, GetOption(argc, argv, 2, "--objects", 100000));
+        uint32_t numFrames = std::max(1u, GetOption(argc, argv, 2, "--frames", 200));
+        uint32_t movingPercent = std::min(100u, GetOption(argc, argv, 2, "--moving", 5));
+
+        std::mt19937 random(1234);
+        std::vector<SceneObject> scene(numObjects);
+        InstanceBatcher batcher;
+        std::vector<InstanceHandle> handles(numObjects);
+        for (uint32_t id = 0; id < numObjects; ++id)
+        {
+            scene[id] = { MakeSceneKey(random), MakeInstanceData(id, 0.0f), random() % 4 != 0 };
+            handles[id] = batcher.Add(scene[id].Key, scene[id].Data, scene[id].Visible);
+        }
+        std::vector<std::vector<SceneUpdate>> updates = MakeSceneUpdates(numObjects, numFrames, movingPercent, 5678);
+
+        // One draw per visible object, in scene order, each with its own single instance allocation
+        NullInstanceBackend perObject(numObjects);
+        uint64_t perObjectDraws = 0;
+        uint64_t perObjectCommands = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < numFrames; ++frame)
+        {
+            for (const SceneUpdate& update : updates[frame])
+            {
+                SceneObject& object = scene[update.Object];
+                switch (update.Kind)
+                {
+                case SceneUpdate::Move:
+                    object.Data = MakeInstanceData(update.Object, float(frame));
+                    break;
+                case SceneUpdate::ToggleVisible:
+                    object.Visible = !object.Visible;
+                    break;
+                case SceneUpdate::ChangeKey:
+                    object.Key = update.Key;
+                    break;
+                }
+            }
+
+            perObject.BeginFrame();
+            for (const SceneObject& object : scene)
+            {
+                if (object.Visible)
+                {
+                    *perObject.AllocateInstances(1) = object.Data;
+                    perObject.DrawInstances(object.Key, 0, 1);
+                }
+            }
+            perObjectDraws += perObject.GetNumDraws();
+            perObjectCommands += perObject.GetNumCommands();
+        }
+        double perObjectUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / numFrames;
+
+        // The same frames through the batcher
+        NullInstanceBackend batched(numObjects);
+        uint64_t batchedDraws = 0;
+        uint64_t batchedCommands = 0;
+        InstanceBatcherStats before = batcher.GetStats();
+        start = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < numFrames; ++frame)
+        {
+            for (const SceneUpdate& update : updates[frame])
+            {
+                InstanceHandle handle = handles[update.Object];
+                switch (update.Kind)
+                {
+                case SceneUpdate::Move:
+                    batcher.SetData(handle, MakeInstanceData(update.Object, float(frame)));
+                    break;
+                case SceneUpdate::ToggleVisible:
+                    batcher.SetVisible(handle, !batcher.IsVisible(handle));
+                    break;
+                case SceneUpdate::ChangeKey:
+                    batcher.SetKey(handle, update.Key);
+                    break;
+                }
+            }
+
+            batched.BeginFrame();
+            batcher.Submit(batched);
+            batchedDraws += batched.GetNumDraws();
+            batchedCommands += batched.GetNumCommands();
+        }
+        double batchedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / numFrames;
+        InstanceBatcherStats after = batcher.GetStats();
+
+        std::printf("%u objects, %u frames, %u%% moving, 1%% changing visibility and 0.05%% material per frame\n",
+            numObjects, numFrames, movingPercent);
+        std::printf("  %-12s %10s %10s %12s\n", "", "draws", "commands", "CPU us");
+        std::printf("  %-12s %10.0f %10.0f %12.1f\n", "per object", double(perObjectDraws) / numFrames,
+            double(perObjectCommands) / numFrames, perObjectUs);
+        std::printf("  %-12s %10.0f %10.0f %12.1f\n", "batched", double(batchedDraws) / numFrames,
+            double(batchedCommands) / numFrames, batchedUs);
+        std::printf("  %.0fx fewer draws, %.1fx less CPU time, %.0f membership changes and %.2f re-sorts per frame\n",
+            double(perObjectDraws) / std::max<uint64_t>(batchedDraws, 1), perObjectUs / batchedUs,
+            double(after.MembershipChanges - before.MembershipChanges) / numFrames, double(after.Rebuilds - before.Rebuilds) / numFrames);
+
+        std::printf("Checks:\n");
+        bool passed = true;
+        std::string detail;
+
+        batched.BeginFrame();
+        batcher.Submit(batched);
+        bool drawnOnce = CheckInstanceDraws(batcher, batched, handles, detail);
+        passed &= Check("every visible object drawn once", drawnOnce, detail);
+
+        std::vector<InstanceKey> keys;
+        for (uint32_t id = 0; id < numObjects; ++id)
+        {
+            if (scene[id].Visible)
+            {
+                keys.push_back(scene[id].Key);
+            }
+        }
+        auto lessKey = [](const InstanceKey& a, const InstanceKey& b)
+        {
+            return std::make_tuple(a.PipelineState, a.Material, a.Mesh) < std::make_tuple(b.PipelineState, b.Material, b.Mesh);
+        };
+        std::sort(keys.begin(), keys.end(), lessKey);
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        const std::vector<InstanceBatch>& batches = batcher.GetBatches();
+        passed &= Check("one draw per mesh, material and PSO", batches.size() == keys.size(),
+            std::to_string(batches.size()) + " draws, " + std::to_string(keys.size()) + " keys");
+        bool sorted = true;
+        for (size_t i = 1; i < batches.size(); ++i)
+        {
+            sorted &= lessKey(batches[i - 1].Key, batches[i].Key);
+        }
+        passed &= Check("draws sorted by PSO, material, mesh", sorted);
+
+        // Moving objects around doesn't touch the groups
+        InstanceBatcherStats moving = batcher.GetStats();
+        for (uint32_t frame = 0; frame < 8; ++frame)
+        {
+            for (uint32_t id = frame; id < numObjects; id += 8)
+            {
+                batcher.SetData(handles[id], MakeInstanceData(id, 1000.0f + frame));
+            }
+            batched.BeginFrame();
+            batcher.Submit(batched);
+        }
+        passed &= Check("moves don't rebuild", batcher.GetStats().MembershipChanges == moving.MembershipChanges
+            && batcher.GetStats().Rebuilds == moving.Rebuilds);
+        passed &= Check("moved data drawn", CheckInstanceDraws(batcher, batched, handles, detail), detail);
+
+        // Hiding the only member of a group removes its draw, showing it again brings it back
+        InstanceKey lonely = { 1000, 1000, 1000 };
+        batcher.SetKey(handles[0], lonely);
+        batcher.SetVisible(handles[0], true);
+        batched.BeginFrame();
+        batcher.Submit(batched);
+        size_t withLonely = batcher.GetBatches().size();
+        batcher.SetVisible(handles[0], false);
+        batched.BeginFrame();
+        batcher.Submit(batched);
+        passed &= Check("emptied group dropped", batcher.GetBatches().size() == withLonely - 1
+            && CheckInstanceDraws(batcher, batched, handles, detail), detail);
+
+        // Handles
+        InstanceHandle removed = handles[1];
+        batcher.Remove(removed);
+        std::string error = GetError([&]() { batcher.SetData(removed, InstanceData()); });
+        passed &= Check("removed handle refused", !error.empty(), error);
+        InstanceHandle reused = batcher.Add(scene[1].Key, MakeInstanceData(1, 0.0f));
+        passed &= Check("handle reused", reused == removed);
+        error = GetError([&]() { batcher.Remove(numObjects + 10); });
+        passed &= Check("unknown handle refused", !error.empty(), error);
+
+        NullInstanceBackend tiny(16);
+        tiny.BeginFrame();
+        passed &= Check("out of room draws nothing", !batcher.Submit(tiny) && tiny.GetNumDraws() == 0);
+
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    // An H.264 style stream in display order IBBPBBPBBP..., an I frame every gopLength frames. I and P frames are
+    // references, a P frame predicts from the two previous ones, a B frame from the references on both sides and is
+    // decoded after the later one. The DPB is a sliding window of maxReferences frames.
+    std::vector<VideoFrameInfo> MakeVideoFrames(uint32_t numFrames, uint32_t maxReferences, uint32_t gopLength, uint64_t frameDuration)
+    {
+        numFrames = (numFrames - 1) / 3 * 3 + 1; // ends on a P frame, no dangling B frames
+        std::vector<VideoFrameInfo> frames;
+        std::vector<uint64_t> held; // references, oldest first
+        uint64_t nextId = 1;
+        uint64_t previousAnchor = 0;
+
+        auto add = [&](uint32_t display, bool reference, std::vector<uint64_t> references)
+        {
+            VideoFrameInfo frame;
+            frame.FrameId = nextId++;
+            frame.PresentationTime = display * frameDuration;
+            frame.IsReference = reference;
+            frame.References = references;
+            if (reference)
+            {
+                held.push_back(frame.FrameId);
+                if (held.size() > maxReferences)
+                {
+                    frame.Unreference.push_back(held.front());
+                    held.erase(held.begin());
+                }
+            }
+            frames.push_back(frame);
+            return frame.FrameId;
+        };
+
+        for (uint32_t anchor = 0; anchor < numFrames; anchor += 3)
+        {
+            std::vector<uint64_t> references;
+            if (anchor % gopLength != 0)
+            {
+                references.assign(held.end() - std::min<size_t>(held.size(), 2), held.end());
+            }
+            uint64_t anchorId = add(anchor, true, references);
+            if (anchor > 0)
+            {
+                add(anchor - 2, false, { previousAnchor, anchorId });
+                add(anchor - 1, false, { previousAnchor, anchorId });
+            }
+            previousAnchor = anchorId;
+        }
+        return frames;
+    }
+
+    struct VideoSimulation
+    {
+        uint32_t NumStreams = 3;
+        uint32_t NumFrames = 600;   // per stream
+        uint32_t MaxReferences = 4;
+        uint64_t FrameUs = 33333;   // 30 fps video
+        uint64_t RefreshUs = 16667; // 60 Hz display
+        uint64_t DecodeUs = 4000;   // per frame on the decode queue
+        uint64_t GraphicsUs = 6000; // per frame on the graphics queue
+        uint64_t GraphicsLatencyUs = 16667; // the graphics queue runs a frame behind the CPU
+    };
+
+    struct VideoSimulationResult
+    {
+        VideoFramePoolStats Stats = {}; // of every stream
+        uint32_t NumSlots = 0;
+        uint32_t MaxReferencesHeld = 0;
+        uint64_t LateVSyncs = 0;    // the frame due wasn't ready, the previous one stayed
+        double DecodeBusy = 0.0;    // fraction of the time the decode queue worked
+        std::string Corruption;     // the first read of a slot that didn't see the frame it should have
+        bool InOrder = true;        // frames shown in presentation order
+    };
+
+    // Plays the streams on a simulated device: one decode queue running the decodes back to back, one graphics queue
+    // sampling every stream's current frame each vsync, a frame after the CPU recorded it. Every write and read of a slot is recorded with when it runs
+    // on its queue, afterwards each read has to see the frame it was meant to with no write to the slot overlapping it.
+    VideoSimulationResult SimulateVideoDecode(const VideoSimulation& simulation)
+    {
+        struct Access
+        {
+            uint32_t Stream;
+            uint32_t Slot;
+            uint64_t Start;
+            uint64_t End;
+            uint64_t FrameId;
+            const char* What;
+        };
+
+        VideoStreamDesc desc = { VideoCodec::H264, 1920, 1080, simulation.MaxReferences, 1 };
+        // Streams start showing frames once every stream's first I, P and B frames had time to decode
+        const uint64_t preroll = 2 * simulation.RefreshUs + 3 * simulation.NumStreams * simulation.DecodeUs;
+        const uint32_t gopLength = 12;
+
+        std::vector<VideoFramePool> pools;
+        std::vector<std::vector<VideoFrameInfo>> streams;
+        std::vector<size_t> nextDecode(simulation.NumStreams, 0);
+        std::vector<uint64_t> lastShown(simulation.NumStreams, 0); // frame id, 0 = none yet
+        std::vector<uint64_t> lastShownTime(simulation.NumStreams, 0);
+        for (uint32_t stream = 0; stream < simulation.NumStreams; ++stream)
+        {
+            pools.emplace_back(GetVideoFramePoolSize(desc));
+            streams.push_back(MakeVideoFrames(simulation.NumFrames, simulation.MaxReferences, gopLength, simulation.FrameUs));
+        }
+
+        VideoSimulationResult result;
+        result.NumSlots = pools[0].GetNumSlots();
+
+        std::vector<Access> writes;
+        std::vector<Access> reads;
+        std::vector<uint64_t> decodeEnds;   // by decode fence value - 1
+        std::vector<uint64_t> graphicsEnds; // by graphics fence value - 1
+        uint64_t decodeQueueEnd = 0;
+        uint64_t decodeBusy = 0;
+        size_t completedDecodes = 0;
+
+        uint64_t mediaEnd = preroll + (streams[0].size() + 1) * simulation.FrameUs;
+        for (uint64_t vsync = 0; vsync * simulation.RefreshUs < mediaEnd; ++vsync)
+        {
+            uint64_t now = vsync * simulation.RefreshUs;
+            while (completedDecodes < decodeEnds.size() && decodeEnds[completedDecodes] <= now)
+            {
+                ++completedDecodes;
+            }
+
+            // The graphics frame samples every stream's current frame, after waiting for their decodes
+            uint64_t graphicsFenceValue = graphicsEnds.size() + 1;
+            uint64_t graphicsStart = std::max(now + simulation.GraphicsLatencyUs, graphicsEnds.empty() ? 0 : graphicsEnds.back());
+            std::vector<std::pair<uint32_t, VideoPresentFrame>> presented;
+            for (uint32_t stream = 0; stream < simulation.NumStreams; ++stream)
+            {
+                uint64_t mediaTime = now >= preroll ? now - preroll : 0;
+                VideoPresentFrame present = pools[stream].Present(mediaTime, completedDecodes, graphicsFenceValue);
+                if (present.Slot != VIDEO_NO_SLOT)
+                {
+                    graphicsStart = std::max(graphicsStart, decodeEnds[present.DecodeFenceValue - 1]);
+                    presented.push_back({ stream, present });
+
+                    if (present.FrameId != lastShown[stream])
+                    {
+                        result.InOrder &= lastShown[stream] == 0 || present.PresentationTime > lastShownTime[stream];
+                        lastShown[stream] = present.FrameId;
+                        lastShownTime[stream] = present.PresentationTime;
+                    }
+                }
+
+                uint64_t due = std::min<uint64_t>(mediaTime / simulation.FrameUs, streams[stream].size() - 1) * simulation.FrameUs;
+                if (now >= preroll && (present.Slot == VIDEO_NO_SLOT || present.PresentationTime != due))
+                {
+                    ++result.LateVSyncs;
+                }
+            }
+            uint64_t graphicsEnd = graphicsStart + simulation.GraphicsUs;
+            graphicsEnds.push_back(graphicsEnd);
+            for (const auto& entry : presented)
+            {
+                reads.push_back({ entry.first, entry.second.Slot, graphicsStart, graphicsEnd, entry.second.FrameId, "sample" });
+            }
+
+            // The decode thread then submits whatever the pools have room for, a frame of each stream in turn
+            for (bool submitted = true; submitted;)
+            {
+                submitted = false;
+                for (uint32_t stream = 0; stream < simulation.NumStreams; ++stream)
+                {
+                    VideoDecodeTarget target;
+                    if (nextDecode[stream] == streams[stream].size() || !pools[stream].BeginDecode(streams[stream][nextDecode[stream]], target))
+                    {
+                        continue;
+                    }
+                    const VideoFrameInfo& frame = streams[stream][nextDecode[stream]++];
+                    uint64_t start = std::max(decodeQueueEnd, now);
+                    if (target.GraphicsFenceValue)
+                    {
+                        start = std::max(start, graphicsEnds[target.GraphicsFenceValue - 1]);
+                    }
+                    uint64_t end = start + simulation.DecodeUs;
+                    for (size_t i = 0; i < frame.References.size(); ++i)
+                    {
+                        reads.push_back({ stream, target.ReferenceSlots[i], start, end, frame.References[i], "reference" });
+                    }
+                    writes.push_back({ stream, target.OutputSlot, start, end, frame.FrameId, "" });
+
+                    decodeQueueEnd = end;
+                    decodeBusy += simulation.DecodeUs;
+                    decodeEnds.push_back(end);
+                    pools[stream].EndDecode(decodeEnds.size());
+                    result.MaxReferencesHeld = std::max(result.MaxReferencesHeld, pools[stream].GetNumReferences());
+                    submitted = true;
+                }
+            }
+        }
+
+        for (uint32_t stream = 0; stream < simulation.NumStreams; ++stream)
+        {
+            const VideoFramePoolStats& stats = pools[stream].GetStats();
+            result.Stats.Decoded += stats.Decoded;
+            result.Stats.Presented += stats.Presented;
+            result.Stats.Skipped += stats.Skipped;
+            result.Stats.Stalls += stats.Stalls;
+        }
+        result.DecodeBusy = double(decodeBusy) / double(std::max(decodeQueueEnd, uint64_t(1)));
+
+        // What each read saw: the last write to the slot before it, and nothing writing it meanwhile
+        for (const Access& read : reads)
+        {
+            const Access* seen = nullptr;
+            for (const Access& write : writes)
+            {
+                if (write.Stream != read.Stream || write.Slot != read.Slot)
+                {
+                    continue;
+                }
+                if (write.Start < read.End && write.End > read.Start)
+                {
+                    seen = nullptr;
+                    break;
+                }
+                if (write.End <= read.Start && (!seen || write.End > seen->End))
+                {
+                    seen = &write;
+                }
+            }
+            if (!seen || seen->FrameId != read.FrameId)
+            {
+                result.Corruption = std::string(read.What) + " of frame " + std::to_string(read.FrameId) + " in stream " +
+                    std::to_string(read.Stream) + " slot " + std::to_string(read.Slot) + " saw " +
+                    (seen ? "frame " + std::to_string(seen->FrameId) : std::string("a write in progress"));
+                break;
+            }
+        }
+        return result;
+    }
+
+    VideoFrameInfo MakeVideoFrame(uint64_t id, uint64_t time, bool reference, std::vector<uint64_t> references = {},
+        std::vector<uint64_t> unreference = {})
+    {
+        return { id, time, reference, references, unreference };
+    }
+
+    bool CheckVideoFramePool()
+    {
+        bool passed = true;
+        VideoDecodeTarget target;
+
+        VideoFramePool pool(6);
+        pool.BeginDecode(MakeVideoFrame(1, 0, true), target);
+        uint32_t first = target.OutputSlot;
+        pool.EndDecode(1);
+        pool.BeginDecode(MakeVideoFrame(2, 3, true, { 1 }), target);
+        pool.EndDecode(2);
+        passed &= Check("references map to their slots", target.ReferenceSlots.size() == 1 && target.ReferenceSlots[0] == first
+            && target.OutputSlot != first);
+
+        passed &= Check("not shown before its decode is done", pool.Present(0, 0, 1).Slot == VIDEO_NO_SLOT);
+        VideoPresentFrame present = pool.Present(3, 2, 2);
+        passed &= Check("latest frame due shown", present.FrameId == 2 && present.DecodeFenceValue == 2
+            && pool.GetStats().Skipped == 1, "frame " + std::to_string(present.FrameId));
+
+        // A B frame coming out after the frame shown is too late
+        pool.BeginDecode(MakeVideoFrame(3, 1, false, { 1, 2 }), target);
+        pool.EndDecode(3);
+        present = pool.Present(4, 3, 3);
+        passed &= Check("late frame skipped", present.FrameId == 2 && pool.GetStats().Skipped == 2 && pool.GetNumFree() == 4);
+
+        std::string error = GetError([&]() { pool.BeginDecode(MakeVideoFrame(4, 6, true, { 7 }), target); });
+        passed &= Check("unheld reference refused", !error.empty(), error);
+        error = GetError([&]() { pool.BeginDecode(MakeVideoFrame(2, 6, true), target); });
+        passed &= Check("frame id going back refused", !error.empty(), error);
+        pool.BeginDecode(MakeVideoFrame(4, 6, true), target);
+        error = GetError([&]() { pool.BeginDecode(MakeVideoFrame(5, 9, true), target); });
+        passed &= Check("BeginDecode twice refused", !error.empty(), error);
+        pool.EndDecode(4);
+
+        // Seeking back: the first frame after the flush replaces the current one though it's earlier
+        pool.Flush();
+        pool.BeginDecode(MakeVideoFrame(1, 0, true), target);
+        pool.EndDecode(5);
+        present = pool.Present(0, 5, 4);
+        passed &= Check("seek back shows the new frame", present.FrameId == 1 && present.PresentationTime == 0
+            && pool.GetNumReferences() == 1);
+
+        // A slot comes back with the graphics fence value of the last frame that sampled it
+        VideoFramePool intra(3);
+        intra.BeginDecode(MakeVideoFrame(1, 0, false), target);
+        uint32_t sampled = target.OutputSlot;
+        intra.EndDecode(1);
+        intra.Present(0, 1, 10);
+        intra.Present(0, 1, 11);
+        intra.BeginDecode(MakeVideoFrame(2, 1, false), target);
+        intra.EndDecode(2);
+        intra.BeginDecode(MakeVideoFrame(3, 2, false), target);
+        intra.EndDecode(3);
+        bool full = !intra.BeginDecode(MakeVideoFrame(4, 3, false), target);
+        intra.Present(1, 3, 12);
+        bool reused = intra.BeginDecode(MakeVideoFrame(4, 3, false), target);
+        passed &= Check("slot reused after its last sampling", full && reused && target.OutputSlot == sampled
+            && target.GraphicsFenceValue == 11, "waits for " + std::to_string(target.GraphicsFenceValue));
+        intra.EndDecode(4);
+
+        // Presenting can't free references
+        VideoFramePool small(3);
+        for (uint64_t id = 1; id <= 3; ++id)
+        {
+            small.BeginDecode(MakeVideoFrame(id, id, true), target);
+            small.EndDecode(id);
+            small.Present(id, id, id);
+        }
+        error = GetError([&]() { small.BeginDecode(MakeVideoFrame(4, 4, true), target); });
+        passed &= Check("pool smaller than the DPB refused", !error.empty(), error);
+        return passed;
+    }
+
+    bool CheckVideoDecoderHeapCache()
+    {
+        bool passed = true;
+        const VideoStreamDesc h264 = { VideoCodec::H264, 1920, 1080, 4, 1 };
+        const VideoStreamDesc h264Small = { VideoCodec::H264, 1920, 1080, 2, 0 };
+        const VideoStreamDesc h264Deep = { VideoCodec::H264, 1920, 1080, 16, 1 };
+        const VideoStreamDesc hevc = { VideoCodec::HEVC, 1280, 720, 6, 2 };
+        const VideoStreamDesc av1 = { VideoCodec::AV1, 3840, 2160, 8, 0 };
+
+        // Streams played one after the other, each creating a heap only if no idle one fits
+        VideoDecoderHeapCache cache(2);
+        auto play = [&](const VideoStreamDesc& desc)
+        {
+            VideoDecoderHeapId id = cache.Acquire(desc);
+            if (id == VIDEO_NO_HEAP)
+            {
+                id = cache.Add(desc);
+            }
+            return cache.Release(id);
+        };
+        play(h264);
+        play(h264);
+        play(hevc);
+        play(h264Small);
+        passed &= Check("compatible heaps reused", cache.GetStats().Created == 2 && cache.GetStats().Reused == 2,
+            std::to_string(cache.GetStats().Created) + " created");
+        passed &= Check("more references need a new heap", cache.Acquire(h264Deep) == VIDEO_NO_HEAP);
+
+        std::vector<VideoDecoderHeapId> destroyed = play(av1);
+        passed &= Check("least recently used idle heap destroyed", destroyed.size() == 1 && cache.GetNumIdle() == 2
+            && cache.Acquire(hevc) == VIDEO_NO_HEAP && cache.Acquire(h264) != VIDEO_NO_HEAP);
+
+        // Streams playing at the same time each get their own
+        VideoDecoderHeapCache concurrent(4);
+        VideoDecoderHeapId a = concurrent.Add(h264);
+        passed &= Check("heap in use not shared", concurrent.Acquire(h264) == VIDEO_NO_HEAP);
+        concurrent.Release(a);
+        std::string error = GetError([&]() { concurrent.Release(a); });
+        passed &= Check("double release refused", !error.empty(), error);
+        return passed;
+    }
+
+    int VideoDecode(int argc, char** argv)
+    {
+        VideoSimulation simulation;
+        simulation.NumStreams = std::max(1u, GetOption(argc, argv, 2, "--streams", simulation.NumStreams));
+        simulation.NumFrames = std::max(10u, GetOption(argc, argv, 2, "--frames", simulation.NumFrames));
+        simulation.DecodeUs = std::max(1u, GetOption(argc, argv, 2, "--decode", static_cast<uint32_t>(simulation.DecodeUs)));
+        // The keeping up run needs some headroom on the decode queue, the slow one is made from it
+        if (simulation.NumStreams * simulation.DecodeUs * 4 > simulation.FrameUs * 3)
+        {
+            throw std::runtime_error("--streams x --decode must stay under 3/4 of a 30 fps frame (25000 us)");
+        }
+
+        std::printf("Frame pool checks:\n");
+        bool passed = CheckVideoFramePool();
+        std::printf("Decoder heap cache checks:\n");
+        passed &= CheckVideoDecoderHeapCache();
+
+        // The same streams with a decoder taking 1.5 frames per frame of all streams
+        VideoSimulation slow = simulation;
+        slow.DecodeUs = simulation.FrameUs * 3 / (2 * simulation.NumStreams);
+
+        std::printf("\n%u H.264 IBBP streams of %u frames at 30 fps on a 60 Hz display, DPB of %u frames, %llu us per frame"
+            " on the graphics queue a frame behind the CPU\n", simulation.NumStreams, simulation.NumFrames, simulation.MaxReferences,
+            static_cast<unsigned long long>(simulation.GraphicsUs));
+        std::printf("  %-18s %6s %8s %8s %8s %6s %9s %9s\n", "decoder", "slots", "decoded", "shown", "skipped", "late", "max refs", "busy");
+        VideoSimulationResult results[2];
+        const VideoSimulation* simulations[2] = { &simulation, &slow };
+        for (int i = 0; i < 2; ++i)
+        {
+            results[i] = SimulateVideoDecode(*simulations[i]);
+            char name[32];
+            std::snprintf(name, sizeof(name), "%llu us/frame", static_cast<unsigned long long>(simulations[i]->DecodeUs));
+            std::printf("  %-18s %6u %8llu %8llu %8llu %6llu %9u %8.0f%%\n", name, results[i].NumSlots,
+                static_cast<unsigned long long>(results[i].Stats.Decoded), static_cast<unsigned long long>(results[i].Stats.Presented),
+                static_cast<unsigned long long>(results[i].Stats.Skipped), static_cast<unsigned long long>(results[i].LateVSyncs),
+                results[i].MaxReferencesHeld, results[i].DecodeBusy * 100.0);
+        }
+
+        std::printf("Simulation checks:\n");
+        const VideoSimulationResult& fast = results[0];
+        uint64_t numFrames = MakeVideoFrames(simulation.NumFrames, simulation.MaxReferences, 12, simulation.FrameUs).size() * simulation.NumStreams;
+        passed &= Check("every read saw its frame", fast.Corruption.empty(), fast.Corruption);
+        passed &= Check("every frame shown, in order", fast.Stats.Presented == numFrames && fast.Stats.Skipped == 0 && fast.InOrder,
+            std::to_string(fast.Stats.Presented) + " of " + std::to_string(numFrames));
+        passed &= Check("pool size never late", fast.LateVSyncs == 0, std::to_string(fast.LateVSyncs) + " late vsyncs");
+        passed &= Check("DPB within its size", fast.MaxReferencesHeld <= simulation.MaxReferences);
+        passed &= Check("slow decoder: reads still right", results[1].Corruption.empty(), results[1].Corruption);
+        passed &= Check("slow decoder: skips, in order", results[1].Stats.Skipped > 0 && results[1].InOrder);
+
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    // Capture pixel test pattern, channel 0..3 is R, G, B, A
+    uint8_t GetCapturePattern(uint32_t x, uint32_t y, uint32_t frame, uint32_t channel)
+    {
+        return static_cast<uint8_t>(x * 3 + y * 5 + frame * 7 + channel * 61);
+    }
+
+    // Which channel byte b of a pixel holds in memory
+    uint32_t GetCaptureChannel(CaptureFormat format, uint32_t b)
+    {
+        return format == CaptureFormat::BGRA8 && b < 3 ? 2 - b : b;
+    }
+
+    void FillCapturePixels(const CaptureDesc& desc, uint8_t* pixels, uint32_t frame)
+    {
+        for (uint32_t y = 0; y < desc.Height; ++y)
+        {
+            for (uint32_t x = 0; x < desc.Width * 4; ++x)
+            {
+                pixels[y * desc.RowPitch + x] = GetCapturePattern(x / 4, y, frame, GetCaptureChannel(desc.Format, x % 4));
+            }
+        }
+    }
+
+    bool CheckCapturePixels(const CaptureDesc& desc, const uint8_t* pixels, uint32_t frame)
+    {
+        for (uint32_t y = 0; y < desc.Height; ++y)
+        {
+            for (uint32_t x = 0; x < desc.Width * 4; ++x)
+            {
+                if (pixels[y * desc.RowPitch + x] != GetCapturePattern(x / 4, y, frame, GetCaptureChannel(desc.Format, x % 4)))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Stand-in for the GPU side of FrameCapture: a copy lands in its buffer (the pattern of the frame it was recorded
+    // in, row padding left as garbage) only once its fence completes. Every access the real thing wouldn't allow, a map
+    // before the copy is done or a copy into a buffer still being read, is recorded in Error.
+    class FakeCaptureGPU : public ICaptureBackend
+    {
+    public:
+        void CreateBuffer(uint32_t index, uint64_t size) override
+        {
+            if (index >= m_Buffers.size())
+            {
+                m_Buffers.resize(index + 1);
+                m_Mapped.resize(index + 1, false);
+            }
+            if (m_Mapped[index] || IsCopyPending(index))
+            {
+                Fail("buffer " + std::to_string(index) + " recreated while in use");
+            }
+            m_Buffers[index].assign(size, 0xCD);
+            ++m_NumCreated;
+        }
+
+        const uint8_t* MapBuffer(uint32_t index) override
+        {
+            if (IsCopyPending(index))
+            {
+                Fail("buffer " + std::to_string(index) + " mapped before its copy completed");
+            }
+            if (m_Mapped[index])
+            {
+                Fail("buffer " + std::to_string(index) + " mapped twice");
+            }
+            m_Mapped[index] = true;
+            return m_Buffers[index].data();
+        }
+
+        void UnmapBuffer(uint32_t index) override
+        {
+            if (!m_Mapped[index])
+            {
+                Fail("buffer " + std::to_string(index) + " unmapped but not mapped");
+            }
+            m_Mapped[index] = false;
+        }
+
+        // What FrameCapture::Capture records
+        void RecordCopy(uint32_t buffer, const CaptureDesc& desc, uint32_t frame)
+        {
+            if (m_Mapped[buffer] || IsCopyPending(buffer))
+            {
+                Fail("copy into buffer " + std::to_string(buffer) + " while it's in use");
+            }
+            if (uint64_t(desc.RowPitch) * desc.Height > m_Buffers[buffer].size())
+            {
+                Fail("copy doesn't fit buffer " + std::to_string(buffer));
+            }
+            m_Copies.push_back({ buffer, desc, frame, 0 });
+        }
+
+        // The queue signals fenceValue after the copies recorded so far
+        void Signal(uint64_t fenceValue)
+        {
+            for (Copy& copy : m_Copies)
+            {
+                copy.FenceValue = copy.FenceValue ? copy.FenceValue : fenceValue;
+            }
+        }
+
+        void Complete(uint64_t fenceValue)
+        {
+            m_Completed = std::max(m_Completed, fenceValue);
+            for (size_t i = 0; i < m_Copies.size();)
+            {
+                Copy& copy = m_Copies[i];
+                if (copy.FenceValue != 0 && copy.FenceValue <= m_Completed)
+                {
+                    FillCapturePixels(copy.Desc, m_Buffers[copy.Buffer].data(), copy.Frame);
+                    m_Copies.erase(m_Copies.begin() + i);
+                }
+                else
+                {
+                    ++i;
+                }
+            }
+        }
+
+        uint64_t GetCompletedValue() const { return m_Completed; }
+        uint32_t GetNumCreated() const { return m_NumCreated; }
+        uint32_t GetNumMapped() const { return static_cast<uint32_t>(std::count(m_Mapped.begin(), m_Mapped.end(), true)); }
+        const std::string& GetError() const { return m_Error; }
+
+    private:
+        struct Copy
+        {
+            uint32_t Buffer;
+            CaptureDesc Desc;
+            uint32_t Frame;
+            uint64_t FenceValue;
+        };
+
+        bool IsCopyPending(uint32_t buffer) const
+        {
+            return std::any_of(m_Copies.begin(), m_Copies.end(), [&](const Copy& copy) { return copy.Buffer == buffer; });
+        }
+
+        void Fail(const std::string& error)
+        {
+            m_Error = m_Error.empty() ? error : m_Error;
+        }
+
+        std::vector<std::vector<uint8_t>> m_Buffers;
+        std::vector<bool> m_Mapped;
+        std::vector<Copy> m_Copies;
+        uint64_t m_Completed = 0;
+        uint32_t m_NumCreated = 0;
+        std::string m_Error;
+    };
+
+    CaptureDesc MakeCaptureDesc(uint32_t width, uint32_t height, const std::string& path)
+    {
+        // D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+        return { width, height, CaptureFormat::RGBA8, (width * 4 + 255) & ~255u, path };
+    }
+
+    bool CheckCaptureQueue()
+    {
+        bool passed = true;
+        FakeCaptureGPU gpu;
+        std::atomic<uint32_t> numEncoded(0);
+        CaptureEncoder encoder = [&](const CapturedFrame& frame)
+        {
+            ++numEncoded;
+            return frame.Desc->Path != "fail";
+        };
+
+        {
+            CaptureQueue queue(gpu, 2, encoder);
+            uint32_t buffer;
+            CaptureDesc desc = MakeCaptureDesc(64, 64, "a");
+            desc.RowPitch = 200;
+            std::string error = GetError([&]() { queue.Request(desc, buffer); });
+            passed &= Check("row pitch too small", !error.empty(), error);
+
+            // Sizes come and go, free buffers are reused, grown when too small
+            uint64_t fenceValue = 0;
+            const uint32_t sizes[] = { 64, 32, 128 };
+            for (uint32_t size : sizes)
+            {
+                desc = MakeCaptureDesc(size, size, "a");
+                queue.Request(desc, buffer);
+                gpu.RecordCopy(buffer, desc, 0);
+                gpu.Signal(++fenceValue);
+                queue.FinishFrame(fenceValue);
+                gpu.Complete(fenceValue);
+                queue.Flush(fenceValue);
+            }
+            CaptureStats stats = queue.GetStats();
+            passed &= Check("smaller capture reuses a buffer, larger grows it", stats.NumBuffers == 1 && gpu.GetNumCreated() == 2,
+                std::to_string(stats.NumBuffers) + " buffers, " + std::to_string(gpu.GetNumCreated()) + " created");
+
+            // Two in flight, the third is dropped, nothing is mapped before the fence
+            bool requested[3];
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                desc = MakeCaptureDesc(16, 16, i == 0 ? "fail" : "b");
+                requested[i] = queue.Request(desc, buffer);
+                if (requested[i])
+                {
+                    gpu.RecordCopy(buffer, desc, 0);
+                }
+            }
+            gpu.Signal(++fenceValue);
+            queue.FinishFrame(fenceValue);
+            passed &= Check("drops when every buffer is busy", requested[0] && requested[1] && !requested[2] && queue.GetStats().Dropped == 1);
+
+            queue.Update(gpu.GetCompletedValue());
+            queue.Update(gpu.GetCompletedValue());
+            uint32_t encodedBefore = numEncoded;
+            gpu.Complete(fenceValue);
+            queue.Flush(fenceValue);
+            stats = queue.GetStats();
+            passed &= Check("waits for the fence, then encodes", encodedBefore == 3 && numEncoded == 5 && stats.Encoded == 4 && stats.Failed == 1,
+                std::to_string(stats.Encoded) + " encoded, " + std::to_string(stats.Failed) + " failed");
+
+            // Left behind at shutdown: one copying, one mapped
+            desc = MakeCaptureDesc(16, 16, "c");
+            queue.Request(desc, buffer);
+            gpu.RecordCopy(buffer, desc, 0);
+            gpu.Signal(++fenceValue);
+            queue.FinishFrame(fenceValue);
+            gpu.Complete(fenceValue);
+            queue.Update(fenceValue);
+            queue.Request(desc, buffer);
+            gpu.RecordCopy(buffer, desc, 0);
+        }
+        passed &= Check("shutdown unmaps everything", gpu.GetNumMapped() == 0);
+        passed &= Check("no buffer used while the GPU or worker had it", gpu.GetError().empty(), gpu.GetError());
+
+        // TGA: BGRA, rows packed, top row first
+        std::string path = "RuntimeBenchCaptureTest.tga";
+        const CaptureFormat formats[] = { CaptureFormat::RGBA8, CaptureFormat::BGRA8 };
+        for (CaptureFormat format : formats)
+        {
+            CaptureDesc desc = MakeCaptureDesc(3, 2, path);
+            desc.Format = format;
+            std::vector<uint8_t> pixels(desc.RowPitch * desc.Height, 0xCD);
+            FillCapturePixels(desc, pixels.data(), 5);
+            bool written = WriteCaptureTGA({ &desc, pixels.data(), 0 });
+
+            std::ifstream in(path, std::ios::binary);
+            std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            bool ok = written && file.size() == 18 + 3 * 2 * 4 && file[2] == 2 && file[12] == 3 && file[14] == 2 && file[16] == 32 &&
+                file[17] == 0x28;
+            for (uint32_t i = 0; ok && i < 3 * 2 * 4; ++i)
+            {
+                uint32_t x = i / 4 % 3;
+                uint32_t y = i / 12;
+                ok = file[18 + i] == GetCapturePattern(x, y, 5, GetCaptureChannel(CaptureFormat::BGRA8, i % 4));
+            }
+            passed &= Check(format == CaptureFormat::RGBA8 ? "TGA from RGBA" : "TGA from BGRA", ok);
+        }
+        std::remove(path.c_str());
+        return passed;
+    }
+
+    struct CaptureSimulation
+    {
+        uint32_t NumFrames = 240;
+        uint32_t FrameUs = 4000;
+        uint32_t LatencyFrames = 2; // from the frame's submit to its fence completing
+        uint32_t EncodeUs = 1000;
+        uint32_t NumBuffers = 6;
+        uint32_t Width = 320;
+        uint32_t Height = 180;
+    };
+
+    struct CaptureSimulationResult
+    {
+        CaptureStats Stats;
+        std::vector<uint32_t> Accepted;
+        std::vector<uint32_t> Encoded; // in the order the worker got them
+        uint64_t NumCorrupt;
+        std::string GPUError;
+        double AverageRenderUs; // Update, Request and FinishFrame, on the render thread
+        double MaxRenderUs;
+    };
+
+    // Records every frame: the render thread requests a capture each frame, the fake GPU completes a frame's fence
+    // LatencyFrames later, the encoder checks the pixels and takes EncodeUs
+    CaptureSimulationResult SimulateCapture(const CaptureSimulation& simulation)
+    {
+        CaptureSimulationResult result = {};
+        FakeCaptureGPU gpu;
+        std::mutex mutex;
+        CaptureEncoder encoder = [&](const CapturedFrame& frame)
+        {
+            uint32_t number = static_cast<uint32_t>(std::stoul(frame.Desc->Path.substr(6)));
+            bool intact = CheckCapturePixels(*frame.Desc, frame.Pixels, number);
+            std::this_thread::sleep_for(std::chrono::microseconds(simulation.EncodeUs));
+
+            std::lock_guard<std::mutex> lock(mutex);
+            result.Encoded.push_back(number);
+            result.NumCorrupt += intact ? 0 : 1;
+            return true;
+        };
+
+        {
+            CaptureQueue queue(gpu, simulation.NumBuffers, encoder);
+            CaptureDesc desc = MakeCaptureDesc(simulation.Width, simulation.Height, "");
+            auto next = std::chrono::steady_clock::now();
+            double totalUs = 0.0;
+            for (uint32_t i = 0; i < simulation.NumFrames; ++i)
+            {
+                desc.Path = "frame " + std::to_string(i);
+                uint32_t buffer;
+
+                auto start = std::chrono::steady_clock::now();
+                queue.Update(gpu.GetCompletedValue());
+                bool requested = queue.Request(desc, buffer);
+                queue.FinishFrame(i + 1);
+                double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+                totalUs += us;
+                result.MaxRenderUs = std::max(result.MaxRenderUs, us);
+
+                if (requested)
+                {
+                    // Recorded before the signal, so the order against FinishFrame doesn't matter
+                    gpu.RecordCopy(buffer, desc, i);
+                    result.Accepted.push_back(i);
+                }
+                gpu.Signal(i + 1);
+                if (i + 1 > simulation.LatencyFrames)
+                {
+                    gpu.Complete(i + 1 - simulation.LatencyFrames);
+                }
+
+                // Like vsync, a late frame doesn't make the next ones come back to back
+                next = std::max(next + std::chrono::microseconds(simulation.FrameUs), std::chrono::steady_clock::now());
+                std::this_thread::sleep_until(next);
+            }
+            result.AverageRenderUs = totalUs / simulation.NumFrames;
+
+            gpu.Complete(simulation.NumFrames);
+            queue.Flush(simulation.NumFrames);
+            result.Stats = queue.GetStats();
+        }
+        result.GPUError = gpu.GetError();
+        return result;
+    }
+
+    int Capture(int argc, char** argv)
+    {
+        CaptureSimulation simulation;
+        simulation.NumFrames = std::max(10u, GetOption(argc, argv, 2, "--frames", simulation.NumFrames));
+        simulation.LatencyFrames = GetOption(argc, argv, 2, "--latency", simulation.LatencyFrames);
+        simulation.EncodeUs = GetOption(argc, argv, 2, "--encode", simulation.EncodeUs);
+        // The frames in flight, the one encoding, the one waiting for the next Update to return it, and one spare
+        simulation.NumBuffers = std::max(1u, GetOption(argc, argv, 2, "--buffers", simulation.LatencyFrames + 4));
+        simulation.Width = std::max(1u, GetOption(argc, argv, 2, "--width", simulation.Width));
+        simulation.Height = std::max(1u, GetOption(argc, argv, 2, "--height", simulation.Height));
+        if (simulation.EncodeUs * 2 > simulation.FrameUs)
+        {
+            throw std::runtime_error("--encode must stay under half a frame (" + std::to_string(simulation.FrameUs / 2) +
+                " us), the slow run is made from it");
+        }
+
+        std::printf("Capture queue checks:\n");
+        bool passed = CheckCaptureQueue();
+
+        // The same recording with an encoder taking 3 frames per frame
+        CaptureSimulation slow = simulation;
+        slow.EncodeUs = simulation.FrameUs * 3;
+
+        std::printf("\nRecording %u frames of %ux%u at %u us per frame, fences completing %u frames late, %u readback buffers\n",
+            simulation.NumFrames, simulation.Width, simulation.Height, simulation.FrameUs, simulation.LatencyFrames,
+            simulation.NumBuffers);
+        std::printf("  %-12s %8s %8s %8s %8s %9s %16s\n", "encoder", "frames", "dropped", "encoded", "buffers", "latency", "render thread");
+        CaptureSimulationResult results[2];
+        const CaptureSimulation* simulations[2] = { &simulation, &slow };
+        for (int i = 0; i < 2; ++i)
+        {
+            results[i] = SimulateCapture(*simulations[i]);
+            const CaptureStats& stats = results[i].Stats;
+            char name[32];
+            std::snprintf(name, sizeof(name), "%u us", simulations[i]->EncodeUs);
+            std::printf("  %-12s %8u %8llu %8llu %8u %6.1f/%u %6.1f/%6.0f us\n", name, simulations[i]->NumFrames,
+                static_cast<unsigned long long>(stats.Dropped), static_cast<unsigned long long>(stats.Encoded), stats.NumBuffers,
+                stats.AverageLatencyFrames, stats.MaxLatencyFrames, results[i].AverageRenderUs, results[i].MaxRenderUs);
+        }
+
+        std::printf("Simulation checks:\n");
+        for (int i = 0; i < 2; ++i)
+        {
+            const CaptureSimulationResult& result = results[i];
+            std::string prefix = i == 0 ? "" : "slow encoder: ";
+            passed &= Check((prefix + "buffers only used when free").c_str(), result.GPUError.empty(), result.GPUError);
+            passed &= Check((prefix + "every accepted frame encoded intact").c_str(), result.Encoded == result.Accepted &&
+                result.NumCorrupt == 0, std::to_string(result.Encoded.size()) + " of " + std::to_string(result.Accepted.size()) +
+                ", " + std::to_string(result.NumCorrupt) + " corrupt");
+            passed &= Check((prefix + "buffers bounded").c_str(), result.Stats.NumBuffers <= simulations[i]->NumBuffers);
+        }
+        const CaptureSimulationResult& fast = results[0];
+        passed &= Check("keeps up, nothing dropped", fast.Stats.Dropped == 0, std::to_string(fast.Stats.Dropped) + " dropped");
+        passed &= Check("mapped the frame after the fence", fast.Stats.MaxLatencyFrames == simulation.LatencyFrames + 1,
+            std::to_string(fast.Stats.MaxLatencyFrames) + " frames");
+        passed &= Check("slow encoder: drops", results[1].Stats.Dropped > 0);
+        // Generous, the machine may be busy, but waiting on the worker would take an encode
+        passed &= Check("slow encoder: render thread never waits", results[1].MaxRenderUs * 2 < slow.EncodeUs,
+            std::to_string(static_cast<int>(results[1].MaxRenderUs)) + " us max");
+
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    // What a simulated GPU buffer holds in a frame
+    uint8_t GetReadbackPattern(uint32_t resource, uint64_t offset, uint32_t frame)
+    {
+        return static_cast<uint8_t>(resource * 101 + offset * 7 + (offset >> 8) + frame * 13);
+    }
+
+    bool CheckReadbackQueue()
+    {
+        bool passed = true;
+
+        std::vector<uint8_t> ring(256, 0);
+        std::string error = GetError([&]() { ReadbackQueue queue(ring.data(), ring.size(), 24); });
+        passed &= Check("alignment must be a power of 2", !error.empty(), error);
+        {
+            ReadbackQueue queue(ring.data(), ring.size());
+            error = GetError([&]() { queue.Request(nullptr, 0, 257); });
+            passed &= Check("bigger than the ring", !error.empty(), error);
+            error = GetError([&]() { queue.Request(nullptr, 0, 0); });
+            passed &= Check("empty readback", !error.empty(), error);
+        }
+
+        // Adjacent ranges of the same resource share a copy, as long as they're adjacent in the ring too (16 byte multiples)
+        {
+            ReadbackQueue queue(ring.data(), ring.size());
+            int a = 0;
+            int b = 0;
+            queue.Request(&a, 0, 16);
+            queue.Request(&a, 16, 32);
+            queue.Request(&a, 48, 16);
+            queue.Request(&b, 64, 16); // another resource
+            queue.Request(&b, 96, 16); // a gap in the source
+            queue.Request(&b, 112, 8);
+            queue.Request(&b, 120, 8); // a gap in the ring, the previous one was padded to 16
+            const std::vector<ReadbackCopy>& copies = queue.GetCopies();
+            passed &= Check("batched copies", copies.size() == 4 && copies[0].Size == 64 && copies[1].RingOffset == 64 &&
+                copies[2].Size == 24 && copies[3].RingOffset == 112, std::to_string(copies.size()) + " copies");
+            queue.FinishFrame(1);
+            passed &= Check("copies handed over once", queue.GetCopies().empty());
+        }
+
+        // Resolved only once the fence is reached, with the bytes in the ring then
+        {
+            ReadbackQueue queue(ring.data(), ring.size());
+            std::future<ReadbackResult> first = queue.Request(nullptr, 0, 100);
+            queue.FinishFrame(1);
+            std::future<ReadbackResult> second = queue.Request(nullptr, 0, 100);
+            std::future<ReadbackResult> full = queue.Request(nullptr, 0, 100);
+            queue.FinishFrame(2);
+            passed &= Check("drops when the ring is full", full.wait_for(std::chrono::seconds(0)) == std::future_status::ready &&
+                !GetError([&]() { full.get(); }).empty() && queue.GetStats().Dropped == 1);
+
+            std::fill(ring.begin(), ring.end(), uint8_t(1));
+            queue.Update(0);
+            bool early = first.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+            queue.Update(1);
+            ReadbackResult result = first.get();
+            passed &= Check("resolved at its fence, not before", !early && result.Bytes == std::vector<uint8_t>(100, 1) &&
+                result.LatencyFrames == 2 && second.wait_for(std::chrono::seconds(0)) != std::future_status::ready);
+
+            // The first one's space is free again: this one wraps to the start
+            std::future<ReadbackResult> wrapped = queue.Request(nullptr, 0, 100);
+            bool wraps = queue.GetCopies().size() == 1 && queue.GetCopies()[0].RingOffset == 0;
+            queue.FinishFrame(3);
+            queue.Update(3);
+            passed &= Check("ring wraps", wraps && wrapped.get().Bytes.size() == 100 && second.get().Bytes.size() == 100 &&
+                queue.GetUsed() == 0);
+        }
+        return passed;
+    }
+
+    struct ReadbackSimulation
+    {
+        uint32_t NumFrames = 300;
+        uint32_t NumRequests = 16;  // per frame, 4 to 256 bytes from 4 buffers, every 4th adjacent to the previous one
+        uint32_t GPUUs = 2000;      // per frame
+        uint32_t FramesInFlight = 3;
+        uint32_t RingKB = 64;
+    };
+
+    struct ReadbackSimulationResult
+    {
+        ReadbackStats Stats;
+        uint64_t NumChecked;
+        uint64_t NumDropped;  // futures that threw
+        uint64_t NumCorrupt;
+        uint64_t NumUnresolved;
+        double AverageCPUUs;  // Update, the requests and polling the futures, per frame
+        double MaxCPUUs;
+    };
+
+    // Stand-in for a direct queue: executes the submitted frames in order on its own thread, each taking GPUUs. A frame
+    // first writes its pattern into every buffer, then runs the readback copies, then signals its fence.
+    class SimulatedReadbackQueue
+    {
+    public:
+        SimulatedReadbackQueue(std::vector<std::vector<uint8_t>>& buffers, uint8_t* ring, uint32_t gpuUs)
+            : m_Buffers(buffers)
+            , m_Ring(ring)
+            , m_GPUUs(gpuUs)
+            , m_Thread(&SimulatedReadbackQueue::Run, this)
+        {
+        }
+
+        ~SimulatedReadbackQueue()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Stopping = true;
+            }
+            m_WorkAvailable.notify_all();
+            m_Thread.join();
+        }
+
+        void Execute(uint32_t frame, const std::vector<ReadbackCopy>& copies, uint64_t fenceValue)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Submitted.push_back({ frame, copies, fenceValue });
+            }
+            m_WorkAvailable.notify_one();
+        }
+
+        uint64_t GetCompletedValue() const { return m_Completed.load(std::memory_order_acquire); }
+
+        void WaitForFence(uint64_t fenceValue)
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_FenceSignaled.wait(lock, [&]() { return GetCompletedValue() >= fenceValue; });
+        }
+
+    private:
+        struct Submission
+        {
+            uint32_t Frame;
+            std::vector<ReadbackCopy> Copies;
+            uint64_t FenceValue;
+        };
+
+        void Run()
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            for (;;)
+            {
+                m_WorkAvailable.wait(lock, [&]() { return m_Stopping || !m_Submitted.empty(); });
+                if (m_Submitted.empty())
+                {
+                    return;
+                }
+                Submission submission = std::move(m_Submitted.front());
+                m_Submitted.pop_front();
+                lock.unlock();
+
+                std::this_thread::sleep_for(std::chrono::microseconds(m_GPUUs));
+                for (uint32_t i = 0; i < m_Buffers.size(); ++i)
+                {
+                    for (uint64_t offset = 0; offset < m_Buffers[i].size(); ++offset)
+                    {
+                        m_Buffers[i][offset] = GetReadbackPattern(i, offset, submission.Frame);
+                    }
+                }
+                for (const ReadbackCopy& copy : submission.Copies)
+                {
+                    const std::vector<uint8_t>& source = *static_cast<const std::vector<uint8_t>*>(copy.Resource);
+                    std::memcpy(m_Ring + copy.RingOffset, source.data() + copy.SourceOffset, copy.Size);
+                }
+
+                lock.lock();
+                m_Completed.store(submission.FenceValue, std::memory_order_release);
+                m_FenceSignaled.notify_all();
+            }
+        }
+
+        std::vector<std::vector<uint8_t>>& m_Buffers;
+        uint8_t* m_Ring;
+        uint32_t m_GPUUs;
+
+        std::mutex m_Mutex;
+        std::condition_variable m_WorkAvailable;
+        std::condition_variable m_FenceSignaled;
+        std::deque<Submission> m_Submitted;
+        bool m_Stopping = false;
+        std::atomic<uint64_t> m_Completed{ 0 };
+        std::thread m_Thread;
+    };
+
+    ReadbackSimulationResult SimulateReadback(const ReadbackSimulation& simulation)
+    {
+        struct Outstanding
+        {
+            std::future<ReadbackResult> Future;
+            uint32_t Resource;
+            uint64_t Offset;
+            uint64_t Size;
+            uint32_t Frame;
+        };
+
+        ReadbackSimulationResult result = {};
+        std::vector<std::vector<uint8_t>> buffers(4, std::vector<uint8_t>(64 * 1024));
+        std::vector<uint8_t> ring(simulation.RingKB * 1024);
+        std::mt19937 random(1234);
+
+        ReadbackQueue queue(ring.data(), ring.size());
+        std::vector<Outstanding> outstanding;
+        double totalUs = 0.0;
+
+        // Polls, never waits
+        auto collect = [&]()
+        {
+            for (size_t i = 0; i < outstanding.size();)
+            {
+                Outstanding& readback = outstanding[i];
+                if (readback.Future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                {
+                    ++i;
+                    continue;
+                }
+                try
+                {
+                    ReadbackResult bytes = readback.Future.get();
+                    bool intact = bytes.Bytes.size() == readback.Size;
+                    for (uint64_t j = 0; intact && j < readback.Size; ++j)
+                    {
+                        intact = bytes.Bytes[j] == GetReadbackPattern(readback.Resource, readback.Offset + j, readback.Frame);
+                    }
+                    result.NumCorrupt += intact ? 0 : 1;
+                    ++result.NumChecked;
+                }
+                catch (const std::runtime_error&)
+                {
+                    ++result.NumDropped;
+                }
+                outstanding[i] = std::move(outstanding.back());
+                outstanding.pop_back();
+            }
+        };
+
+        {
+            SimulatedReadbackQueue gpu(buffers, ring.data(), simulation.GPUUs);
+            for (uint32_t frame = 0; frame < simulation.NumFrames; ++frame)
+            {
+                // The frame pacing wait, like the app's: not on the readbacks
+                if (frame >= simulation.FramesInFlight)
+                {
+                    gpu.WaitForFence(frame + 1 - simulation.FramesInFlight);
+                }
+
+                auto start = std::chrono::steady_clock::now();
+                queue.Update(gpu.GetCompletedValue());
+                collect();
+
+                uint32_t resource = 0;
+                uint64_t offset = 0;
+                uint64_t size = 0;
+                for (uint32_t i = 0; i < simulation.NumRequests; ++i)
+                {
+                    if (i % 4 == 0 || offset + size + 256 > buffers[resource].size())
+                    {
+                        resource = random() % buffers.size();
+                        offset = random() % (buffers[resource].size() - 256);
+                    }
+                    else
+                    {
+                        offset += size; // right after the previous one
+                    }
+                    size = i % 4 == 0 ? 4 + random() % 253 : 16 * (1 + random() % 16);
+                    outstanding.push_back({ queue.Request(&buffers[resource], offset, size), resource, offset, size, frame });
+                }
+
+                double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+                totalUs += us;
+                result.MaxCPUUs = std::max(result.MaxCPUUs, us);
+
+                gpu.Execute(frame, queue.GetCopies(), frame + 1);
+                queue.FinishFrame(frame + 1);
+            }
+
+            gpu.WaitForFence(simulation.NumFrames);
+            queue.Update(simulation.NumFrames);
+            collect();
+            result.Stats = queue.GetStats();
+        }
+        result.NumUnresolved = outstanding.size();
+        result.AverageCPUUs = totalUs / simulation.NumFrames;
+        return result;
+    }
+
+    int Readback(int argc, char** argv)
+    {
+        ReadbackSimulation simulation;
+        simulation.NumFrames = std::max(10u, GetOption(argc, argv, 2, "--frames", simulation.NumFrames));
+        simulation.NumRequests = std::max(1u, GetOption(argc, argv, 2, "--requests", simulation.NumRequests));
+        simulation.GPUUs = GetOption(argc, argv, 2, "--gpu", simulation.GPUUs);
+        simulation.FramesInFlight = std::max(1u, GetOption(argc, argv, 2, "--frames-in-flight", simulation.FramesInFlight));
+        simulation.RingKB = std::max(1u, GetOption(argc, argv, 2, "--ring", simulation.RingKB));
+
+        std::printf("Readback queue checks:\n");
+        bool passed = CheckReadbackQueue();
+
+        // What the frames in flight can have outstanding, at most 256 bytes plus padding each: a ring too small for it
+        ReadbackSimulation small = simulation;
+        small.RingKB = std::max(1u, simulation.NumRequests * (simulation.FramesInFlight + 1) * 272 / 1024 / 4);
+
+        std::printf("\n%u frames of %u readbacks, %u us of GPU per frame, %u frames in flight\n", simulation.NumFrames,
+            simulation.NumRequests, simulation.GPUUs, simulation.FramesInFlight);
+        std::printf("  %-8s %9s %8s %8s %9s %9s %10s %16s\n", "ring", "requests", "copies", "dropped", "max used", "latency",
+            "KB/s", "CPU per frame");
+        ReadbackSimulationResult results[2];
+        const ReadbackSimulation* simulations[2] = { &simulation, &small };
+        for (int i = 0; i < 2; ++i)
+        {
+            results[i] = SimulateReadback(*simulations[i]);
+            const ReadbackStats& stats = results[i].Stats;
+            char name[32];
+            std::snprintf(name, sizeof(name), "%u KB", simulations[i]->RingKB);
+            std::printf("  %-8s %9llu %8llu %8llu %9llu %6.2f/%u %10.1f %6.1f/%6.0f us\n", name,
+                static_cast<unsigned long long>(stats.Requested), static_cast<unsigned long long>(stats.NumCopies),
+                static_cast<unsigned long long>(stats.Dropped), static_cast<unsigned long long>(stats.MaxRingUsed),
+                stats.AverageLatencyFrames, stats.MaxLatencyFrames, stats.BytesPerSecond / 1024.0, results[i].AverageCPUUs,
+                results[i].MaxCPUUs);
+        }
+
+        std::printf("Simulation checks:\n");
+        for (int i = 0; i < 2; ++i)
+        {
+            const ReadbackSimulationResult& result = results[i];
+            std::string prefix = i == 0 ? "" : "small ring: ";
+            passed &= Check((prefix + "every readback resolved").c_str(), result.NumUnresolved == 0 &&
+                result.NumChecked + result.NumDropped == result.Stats.Requested);
+            passed &= Check((prefix + "bytes from the right frame").c_str(), result.NumCorrupt == 0,
+                std::to_string(result.NumCorrupt) + " of " + std::to_string(result.NumChecked) + " wrong");
+            passed &= Check((prefix + "latency bounded by the frames in flight").c_str(),
+                result.Stats.MaxLatencyFrames <= simulations[i]->FramesInFlight + 1, std::to_string(result.Stats.MaxLatencyFrames) + " frames");
+        }
+        passed &= Check("nothing dropped", results[0].Stats.Dropped == 0 && results[0].NumDropped == 0);
+        passed &= Check("adjacent readbacks batched", results[0].Stats.NumCopies < results[0].Stats.Requested);
+        passed &= Check("small ring: drops, within the ring", results[1].Stats.Dropped > 0 &&
+            results[1].Stats.Dropped == results[1].NumDropped && results[1].Stats.MaxRingUsed <= small.RingKB * 1024);
+
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    // Just enough of a JSON parser to tell whether the text is one well formed value
+    class JSONValidator
+    {
+    public:
+        explicit JSONValidator(const std::string& text)
+            : m_Text(text)
+        {
+        }
+
+        bool IsValid()
+        {
+            return ParseValue() && (SkipSpace(), m_Position == m_Text.size());
+        }
+
+    private:
+        void SkipSpace()
+        {
+            while (m_Position < m_Text.size() && std::strchr(" \t\r\n", m_Text[m_Position]))
+            {
+                ++m_Position;
+            }
+        }
+
+        bool Consume(char c)
+        {
+            SkipSpace();
+            if (m_Position < m_Text.size() && m_Text[m_Position] == c)
+            {
+                ++m_Position;
+                return true;
+            }
+            return false;
+        }
+
+        bool ParseString()
+        {
+            if (!Consume('"'))
+            {
+                return false;
+            }
+            while (m_Position < m_Text.size())
+            {
+                char c = m_Text[m_Position++];
+                if (c == '"')
+                {
+                    return true;
+                }
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    return false;
+                }
+                if (c == '\\')
+                {
+                    if (m_Position >= m_Text.size() || !std::strchr("\"\\/bfnrtu", m_Text[m_Position]))
+                    {
+                        return false;
+                    }
+                    if (m_Text[m_Position++] == 'u')
+                    {
+                        for (int i = 0; i < 4; ++i, ++m_Position)
+                        {
+                            if (m_Position >= m_Text.size() || !std::isxdigit(static_cast<unsigned char>(m_Text[m_Position])))
+                            {
+                                return false;
+                            }
+                        }
+                    }
+                }
+            }
+            return false;
+        }
+
+        bool ParseNumber()
+        {
+            size_t start = m_Position;
+            if (m_Position < m_Text.size() && m_Text[m_Position] == '-')
+            {
+                ++m_Position;
+            }
+            while (m_Position < m_Text.size() && std::strchr("0123456789.eE+-", m_Text[m_Position]))
+            {
+                ++m_Position;
+            }
+            return m_Position > start && std::isdigit(static_cast<unsigned char>(m_Text[m_Position - 1]));
+        }
+
+        bool ParseValue()
+        {
+            SkipSpace();
+            if (m_Position >= m_Text.size())
+            {
+                return false;
+            }
+            char c = m_Text[m_Position];
+            if (c == '{' || c == '[')
+            {
+                char close = c == '{' ? '}' : ']';
+                ++m_Position;
+                if (Consume(close))
+                {
+                    return true;
+                }
+                do
+                {
+                    if (c == '{' && !(ParseString() && Consume(':')))
+                    {
+                        return false;
+                    }
+                    if (!ParseValue())
+                    {
+                        return false;
+                    }
+                } while (Consume(','));
+                return Consume(close);
+            }
+            if (c == '"')
+            {
+                return ParseString();
+            }
+            for (const char* literal : { "true", "false", "null" })
+            {
+                if (m_Text.compare(m_Position, std::strlen(literal), literal) == 0)
+                {
+                    m_Position += std::strlen(literal);
+                    return true;
+                }
+            }
+            return ParseNumber();
+        }
+
+        const std::string& m_Text;
+        size_t m_Position = 0;
+    };
+
+    bool IsValidJSON(const std::string& text)
+    {
+        return JSONValidator(text).IsValid();
+    }
+
+    bool Contains(const std::string& text, const std::string& part)
+    {
+        return text.find(part) != std::string::npos;
+    }
+
+    bool CheckGPUMemoryTracker()
+    {
+        bool passed = true;
+
+        std::printf("JSON validator checks:\n");
+        passed &= Check("accepts", IsValidJSON("{\"a\":[1,-2.5e3,\"x\\u000a\",true,null],\"b\":{}}"));
+        passed &= Check("rejects", !IsValidJSON("{\"a\":1,}") && !IsValidJSON("{\"a\" 1}") && !IsValidJSON("[1,2") &&
+            !IsValidJSON("\"a\nb\"") && !IsValidJSON("{} {}"));
+
+        std::printf("GPU memory tracker checks:\n");
+        GPUMemoryTracker tracker;
+        uint64_t target = tracker.Add(8 << 20, { GPUMemoryCategory::RenderTarget, "Scene", "Color" });
+        uint64_t depth = tracker.Add(4 << 20, { GPUMemoryCategory::DepthStencil, "Scene", "Depth" });
+        uint64_t upload = tracker.Add(64 << 20, { GPUMemoryCategory::Upload, "UploadRing", "Upload ring" });
+        uint64_t descriptors = tracker.Add(4096 * 32, { GPUMemoryCategory::DescriptorHeap, "Scene", "SRV" });
+
+        GPUMemoryTotal total = tracker.GetTotal();
+        GPUMemoryTotal scene = tracker.GetOwnerTotal("Scene");
+        passed &= Check("totals", total.Bytes == (76u << 20) + 4096 * 32 && total.Count == 4 && total.HighWater == total.Bytes,
+            std::to_string(total.Bytes) + " bytes");
+        passed &= Check("per owner", scene.Bytes == (12u << 20) + 4096 * 32 && scene.Count == 3 &&
+            tracker.GetOwnerTotal("UploadRing").Bytes == 64u << 20);
+        passed &= Check("per category", tracker.GetCategoryTotal(GPUMemoryCategory::RenderTarget).Bytes == 8u << 20 &&
+            tracker.GetCategoryTotal(GPUMemoryCategory::Upload).Count == 1 && tracker.GetCategoryTotal(GPUMemoryCategory::Texture).Count == 0);
+        passed &= Check("unknown owner is empty", tracker.GetOwnerTotal("Nobody").Bytes == 0 && tracker.GetOwnerTotal("Nobody").Count == 0);
+
+        tracker.Remove(upload);
+        total = tracker.GetTotal();
+        GPUMemoryTotal uploads = tracker.GetCategoryTotal(GPUMemoryCategory::Upload);
+        passed &= Check("removed, high water kept", total.Bytes == (12u << 20) + 4096 * 32 && total.Count == 3 &&
+            total.HighWater == (76u << 20) + 4096 * 32 && uploads.Bytes == 0 && uploads.HighWater == 64u << 20 &&
+            tracker.GetOwnerTotal("UploadRing").HighWater == 64u << 20);
+        tracker.ResetHighWater();
+        passed &= Check("high water reset", tracker.GetTotal().HighWater == tracker.GetTotal().Bytes &&
+            tracker.GetCategoryTotal(GPUMemoryCategory::Upload).HighWater == 0);
+
+        std::string error = GetError([&]() { tracker.Remove(upload); });
+        passed &= Check("removing twice throws", !error.empty(), error);
+        error = GetError([&]() { tracker.Remove(12345); });
+        passed &= Check("removing an unknown id throws", !error.empty(), error);
+        error = GetError([&]() { tracker.Add(1, { GPUMemoryCategory::Count, "Scene", "" }); });
+        passed &= Check("invalid category throws", !error.empty(), error);
+        passed &= Check("failed calls change nothing", tracker.GetTotal().Count == 3);
+
+        // Frame 10 to 20: the render target is resized, the depth buffer goes away
+        GPUMemorySnapshot before = tracker.TakeSnapshot(10);
+        tracker.Remove(target);
+        tracker.Remove(depth);
+        uint64_t resized = tracker.Add(12 << 20, { GPUMemoryCategory::RenderTarget, "Scene", "Color \"resized\"\\\n" });
+        uint64_t timer = tracker.Add(4096, { GPUMemoryCategory::Readback, "GPUTimer", "Timestamps" });
+        GPUMemorySnapshot after = tracker.TakeSnapshot(20);
+
+        passed &= Check("snapshot", after.Frame == 20 && after.Total.Bytes == tracker.GetTotal().Bytes &&
+            after.Allocations.size() == 3 && after.Allocations[0].Id == descriptors && after.Allocations[1].Id == resized &&
+            after.Allocations[2].Id == timer && after.Owners.size() == 3 && after.Owners["Scene"].Count == 2);
+
+        GPUMemoryDiff diff = DiffGPUMemory(before, after);
+        passed &= Check("diff totals", diff.FromFrame == 10 && diff.ToFrame == 20 && diff.TotalBytes == 4096,
+            std::to_string(diff.TotalBytes) + " bytes");
+        passed &= Check("diff categories",
+            diff.Categories[static_cast<uint32_t>(GPUMemoryCategory::RenderTarget)] == 4 << 20 &&
+            diff.Categories[static_cast<uint32_t>(GPUMemoryCategory::DepthStencil)] == -(4 << 20) &&
+            diff.Categories[static_cast<uint32_t>(GPUMemoryCategory::Readback)] == 4096 &&
+            diff.Categories[static_cast<uint32_t>(GPUMemoryCategory::DescriptorHeap)] == 0);
+        passed &= Check("diff owners", diff.Owners.size() == 1 && diff.Owners["GPUTimer"] == 4096,
+            std::to_string(diff.Owners.size()) + " changed"); // Scene: +12 MB -12 MB, UploadRing was already empty
+        passed &= Check("diff allocations", diff.Added.size() == 2 && diff.Added[0].Id == resized && diff.Added[1].Id == timer &&
+            diff.Removed.size() == 2 && diff.Removed[0].Id == target && diff.Removed[1].Id == depth);
+        GPUMemoryDiff none = DiffGPUMemory(after, after);
+        passed &= Check("diff of the same snapshot is empty", none.TotalBytes == 0 && none.Owners.empty() && none.Added.empty() &&
+            none.Removed.empty());
+        GPUMemoryDiff gone = DiffGPUMemory(after, GPUMemorySnapshot{});
+        passed &= Check("owners that went away", gone.Owners["GPUTimer"] == -4096 && gone.Removed.size() == 3);
+
+        std::string json = GPUMemorySnapshotToJSON(after);
+        passed &= Check("snapshot JSON is valid", IsValidJSON(json), json.substr(0, 60));
+        passed &= Check("snapshot JSON", Contains(json, "\"frame\":20") &&
+            Contains(json, "\"render_target\":{\"bytes\":12582912,\"high_water\":12582912,\"count\":1}") &&
+            !Contains(json, "\"upload\"") && !Contains(json, "\"texture\"") && // not used since the high water reset
+            Contains(json, "\"GPUTimer\":{\"bytes\":4096,") && Contains(json, "\"name\":\"Color \\\"resized\\\"\\\\\\u000a\""));
+        std::string totals = GPUMemorySnapshotToJSON(after, false);
+        passed &= Check("totals only JSON", IsValidJSON(totals) && !Contains(totals, "allocations") && totals.size() < json.size());
+        std::string diffJSON = GPUMemoryDiffToJSON(diff);
+        passed &= Check("diff JSON is valid", IsValidJSON(diffJSON), diffJSON.substr(0, 60));
+        passed &= Check("diff JSON", Contains(diffJSON, "\"total_bytes\":4096") && Contains(diffJSON, "\"depth_stencil\":-4194304") &&
+            Contains(diffJSON, "\"added\":[{\"id\":" + std::to_string(resized)) &&
+            Contains(diffJSON, "\"removed\":[{\"id\":" + std::to_string(target)) && !Contains(diffJSON, "descriptor_heap"));
+        passed &= Check("empty JSON is valid", IsValidJSON(GPUMemorySnapshotToJSON(GPUMemorySnapshot{})) &&
+            IsValidJSON(GPUMemoryDiffToJSON(none)));
+        return passed;
+    }
+
+    struct GPUMemoryStressResult
+    {
+        uint64_t NumSnapshots;
+        uint64_t NumInconsistent; // snapshots whose totals don't add up to their allocations
+        double NanosecondsPerPair;
+    };
+
+    // Threads adding and removing allocations (about half stay alive at a time) while another takes snapshots, as
+    // resources get created and released on the render thread, loader threads and wherever the last reference goes
+    GPUMemoryStressResult StressGPUMemoryTracker(GPUMemoryTracker& tracker, uint32_t numThreads, uint32_t numPairs)
+    {
+        GPUMemoryStressResult result = {};
+        std::atomic<bool> done(false);
+        std::thread snapshots([&]()
+        {
+            uint64_t frame = 0;
+            while (!done)
+            {
+                GPUMemorySnapshot snapshot = tracker.TakeSnapshot(++frame);
+                uint64_t bytes = 0;
+                uint64_t categoryBytes[GPU_MEMORY_CATEGORY_COUNT] = {};
+                for (const GPUMemoryAllocation& allocation : snapshot.Allocations)
+                {
+                    bytes += allocation.Bytes;
+                    categoryBytes[static_cast<uint32_t>(allocation.Tag.Category)] += allocation.Bytes;
+                }
+                bool consistent = bytes == snapshot.Total.Bytes && snapshot.Allocations.size() == snapshot.Total.Count;
+                for (uint32_t i = 0; i < GPU_MEMORY_CATEGORY_COUNT; ++i)
+                {
+                    consistent &= categoryBytes[i] == snapshot.Categories[i].Bytes;
+                }
+                ++result.NumSnapshots;
+                result.NumInconsistent += consistent ? 0 : 1;
+            }
+        });
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < numThreads; ++t)
+        {
+            threads.emplace_back([&tracker, t, numPairs]()
+            {
+                std::mt19937 random(t + 1);
+                std::string owner = "Thread " + std::to_string(t);
+                std::vector<uint64_t> alive;
+                for (uint32_t i = 0; i < numPairs; ++i)
+                {
+                    GPUMemoryCategory category = static_cast<GPUMemoryCategory>(random() % GPU_MEMORY_CATEGORY_COUNT);
+                    alive.push_back(tracker.Add(64 * 1024 * (1 + random() % 64), { category, owner, "Stress" }));
+                    if (alive.size() > 64)
+                    {
+                        size_t index = random() % alive.size();
+                        tracker.Remove(alive[index]);
+                        alive[index] = alive.back();
+                        alive.pop_back();
+                    }
+                }
+                for (uint64_t id : alive)
+                {
+                    tracker.Remove(id);
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        result.NanosecondsPerPair = ns / (double(numThreads) * numPairs);
+
+        done = true;
+        snapshots.join();
+        return result;
+    }
+
+    int GPUMemory(int argc, char** argv)
+    {
+        uint32_t numThreads = std::max(1u, GetOption(argc, argv, 2, "--threads", 4));
+        uint32_t numAllocations = std::max(1u, GetOption(argc, argv, 2, "--allocations", 100000));
+
+        bool passed = CheckGPUMemoryTracker();
+
+        // What tagging a resource costs on top of creating it, from one thread and from several at once
+        GPUMemoryTracker tracker;
+        std::printf("\nStress: %u threads adding and removing %u allocations each, snapshots taken meanwhile\n", numThreads,
+            numAllocations);
+        GPUMemoryStressResult single = StressGPUMemoryTracker(tracker, 1, numAllocations);
+        GPUMemoryStressResult contended = StressGPUMemoryTracker(tracker, numThreads, numAllocations);
+        std::printf("  add + remove : %.0f ns alone, %.0f ns with %u threads\n", single.NanosecondsPerPair,
+            contended.NanosecondsPerPair, numThreads);
+
+        // A snapshot of a big scene, like the app takes every few frames
+        for (uint32_t i = 0; i < 10000; ++i)
+        {
+            tracker.Add(64 * 1024, { static_cast<GPUMemoryCategory>(i % GPU_MEMORY_CATEGORY_COUNT), "Owner " + std::to_string(i % 32), "Resource" });
+        }
+        auto start = std::chrono::steady_clock::now();
+        GPUMemorySnapshot before = tracker.TakeSnapshot(1);
+        double snapshotMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+        std::string json = GPUMemorySnapshotToJSON(before);
+        double jsonMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        tracker.Add(64 * 1024, { GPUMemoryCategory::Buffer, "Owner 0", "Resource" });
+        start = std::chrono::steady_clock::now();
+        std::string diffJSON = GPUMemoryDiffToJSON(DiffGPUMemory(before, tracker.TakeSnapshot(2)));
+        double diffMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::printf("  10000 allocations: %.2f ms snapshot, %.2f ms to JSON (%zu KB), %.2f ms snapshot + diff to JSON (%zu bytes)\n",
+            snapshotMs, jsonMs, json.size() / 1024, diffMs, diffJSON.size());
+
+        std::printf("Stress checks:\n");
+        passed &= Check("snapshots taken meanwhile", single.NumSnapshots > 0 && contended.NumSnapshots > 0,
+            std::to_string(single.NumSnapshots + contended.NumSnapshots));
+        passed &= Check("every snapshot adds up", single.NumInconsistent == 0 && contended.NumInconsistent == 0,
+            std::to_string(single.NumInconsistent + contended.NumInconsistent) + " didn't");
+        uint64_t bytesLeft = 0;
+        uint32_t countLeft = 0;
+        for (uint32_t t = 0; t < numThreads; ++t)
+        {
+            GPUMemoryTotal owner = tracker.GetOwnerTotal("Thread " + std::to_string(t));
+            bytesLeft += owner.Bytes;
+            countLeft += owner.Count;
+        }
+        passed &= Check("all removed again", bytesLeft == 0 && countLeft == 0,
+            std::to_string(countLeft) + " allocations, " + std::to_string(bytesLeft) + " bytes left");
+        GPUMemoryTotal total = tracker.GetTotal();
+        passed &= Check("only the big scene left", total.Count == 10001 && total.Bytes == 10001 * 64 * 1024,
+            std::to_string(total.Count) + " left");
+        passed &= Check("owners kept their high water", tracker.GetOwnerTotal("Thread 0").Bytes == 0 &&
+            tracker.GetOwnerTotal("Thread 0").HighWater > 0);
+        passed &= Check("big snapshot JSON is valid", IsValidJSON(json) && IsValidJSON(diffJSON));
+
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    // Joins the name lists the checks print
+    std::string JoinNames(const std::vector<std::string>& names)
+    {
+        std::string joined;
+        for (const std::string& name : names)
+        {
+            joined += (joined.empty() ? "" : " ") + name;
+        }
+        return joined;
+    }
+
+    // Everything the watcher reports within timeout, waiting a little longer once something turned up for the rest
+    std::vector<std::string> PollFor(FileWatcher& watcher, std::chrono::milliseconds timeout)
+    {
+        std::set<std::string> changed;
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            for (const std::string& path : watcher.Poll())
+            {
+                changed.insert(path);
+            }
+            if (!changed.empty())
+            {
+                deadline = std::min(deadline, std::chrono::steady_clock::now() + std::chrono::milliseconds(50));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return std::vector<std::string>(changed.begin(), changed.end());
+    }
+
+    bool CheckShaderIncludeGraph(const std::string& dir)
+    {
+        bool passed = true;
+        std::printf("Include graph checks:\n");
+
+        std::vector<std::string> parsed = ShaderIncludeGraph::ParseIncludes("#include \"a.hlsli\"\n  #  include <b.hlsli>\n"
+            "// #include \"c.hlsli\"\n/* #include \"d.hlsli\"\n#include \"e.hlsli\" */ #define X 1\n#include\"f.hlsli\"\n#pragma once\n");
+        passed &= Check("parse, comments skipped", parsed == std::vector<std::string>({ "a.hlsli", "<b.hlsli", "f.hlsli" }),
+            JoinNames(parsed));
+        passed &= Check("normalize", ShaderIncludeGraph::Normalize("Shaders\\Common/../Upscale_PS.hlsl") == "Shaders/Upscale_PS.hlsl" &&
+            ShaderIncludeGraph::Normalize("./a//b.hlsl") == "a/b.hlsl");
+
+        // A includes Lighting (which includes Util, which includes Lighting again) and the shared header from the include
+        // directory, B only the shared header, C nothing but a commented out Util
+        std::filesystem::create_directories(dir + "/Common");
+        std::filesystem::create_directories(dir + "/Include");
+        WriteFile(dir + "/A_PS.hlsl", "#include \"Common/Lighting.hlsli\"\n#include <Shared.hlsli>\n");
+        WriteFile(dir + "/B_PS.hlsl", "#include \"Shared.hlsli\"\n");
+        WriteFile(dir + "/C_VS.hlsl", "// #include \"Util.hlsli\"\n");
+        WriteFile(dir + "/Common/Lighting.hlsli", "#include \"../Util.hlsli\"\n");
+        WriteFile(dir + "/Util.hlsli", "#include \"Common/Lighting.hlsli\"\n");
+        WriteFile(dir + "/Include/Shared.hlsli", "");
+
+        ShaderIncludeGraph graph({ dir + "/Include" });
+        graph.Scan(dir + "/A_PS.hlsl");
+        graph.Scan(dir + "/B_PS.hlsl");
+        graph.Scan(dir + "/C_VS.hlsl");
+
+        std::string a = dir + "/A_PS.hlsl", b = dir + "/B_PS.hlsl", c = dir + "/C_VS.hlsl";
+        std::string lighting = dir + "/Common/Lighting.hlsli", util = dir + "/Util.hlsli", shared = dir + "/Include/Shared.hlsli";
+        passed &= Check("includes resolved", graph.GetIncludes(a) == std::vector<std::string>({ lighting, shared }) &&
+            graph.GetIncludes(b) == std::vector<std::string>({ shared }) && graph.GetIncludes(c).empty(), JoinNames(graph.GetIncludes(a)));
+        passed &= Check("nested include, through a cycle", graph.OnFileChanged(util) == std::vector<std::string>({ a, lighting, util }),
+            JoinNames(graph.OnFileChanged(util)));
+        passed &= Check("include directory", graph.OnFileChanged(shared) == std::vector<std::string>({ a, b, shared }),
+            JoinNames(graph.OnFileChanged(shared)));
+        passed &= Check("unrelated files", graph.OnFileChanged(c) == std::vector<std::string>({ c }) &&
+            graph.OnFileChanged(dir + "/D_PS.hlsl").empty());
+        passed &= Check("same file another way", graph.OnFileChanged(dir + "\\Common\\..\\Util.hlsli") == graph.OnFileChanged(util));
+        std::vector<std::string> directories = graph.GetDirectories();
+        passed &= Check("directories to watch", directories == std::vector<std::string>({ dir, dir + "/Common", dir + "/Include" }),
+            JoinNames(directories));
+
+        // An include that isn't there yet, and one that went away
+        WriteFile(c, "#include \"Missing.hlsli\"\n");
+        graph.OnFileChanged(c);
+        passed &= Check("missing include is tracked", graph.OnFileChanged(dir + "/Missing.hlsli") == std::vector<std::string>({ c, dir + "/Missing.hlsli" }));
+        WriteFile(b, "float4 main() : SV_Target { return 0; }\n");
+        graph.OnFileChanged(b);
+        passed &= Check("removed include is dropped", graph.OnFileChanged(shared) == std::vector<std::string>({ a, shared }),
+            JoinNames(graph.OnFileChanged(shared)));
+        return passed;
+    }
+
+    bool CheckFileWatcher(const std::string& dir)
+    {
+        bool passed = true;
+        std::printf("File watcher checks:\n");
+
+        std::filesystem::create_directories(dir + "/Watched");
+        std::filesystem::create_directories(dir + "/Other");
+        FileWatcher watcher;
+        watcher.AddDirectory(dir + "/Watched");
+        watcher.AddDirectory(dir + "/Watched/"); // the same one
+        passed &= Check("missing directory throws", !GetError([&]() { watcher.AddDirectory(dir + "/Missing"); }).empty());
+        passed &= Check("nothing changed", watcher.Poll().empty());
+
+        WriteFile(dir + "/Watched/A.hlsl", "1");
+        WriteFile(dir + "/Watched/A.hlsl", "2");
+        std::vector<std::string> changed = PollFor(watcher, std::chrono::milliseconds(2000));
+        passed &= Check("write, reported once", changed == std::vector<std::string>({ dir + "/Watched/A.hlsl" }), JoinNames(changed));
+
+        // What editors do to save atomically
+        WriteFile(dir + "/Watched/B.hlsl.tmp", "1");
+        std::filesystem::rename(dir + "/Watched/B.hlsl.tmp", dir + "/Watched/B.hlsl");
+        changed = PollFor(watcher, std::chrono::milliseconds(2000));
+        passed &= Check("temporary file renamed over", std::find(changed.begin(), changed.end(), dir + "/Watched/B.hlsl") != changed.end(),
+            JoinNames(changed));
+
+        WriteFile(dir + "/Other/A.hlsl", "1");
+        changed = PollFor(watcher, std::chrono::milliseconds(200));
+        passed &= Check("other directories ignored", changed.empty(), JoinNames(changed));
+        return passed;
+    }
+
+    // Fake compiles: the "bytecode" is the text of the files, one containing "error" doesn't compile, and every compile
+    // of a program waits while its gate is closed
+    struct FakeShaderCompiler
+    {
+        std::mutex Mutex;
+        std::condition_variable Opened;
+        std::map<std::string, bool> Closed;
+        std::map<std::string, uint32_t> NumCompiles;
+        std::map<std::string, std::string> Current; // swapped in, render thread only
+        std::thread::id ApplyThread;
+
+        ShaderReloadCompile Make(const std::string& name, const std::vector<std::string>& files)
+        {
+            return [this, name, files]()
+            {
+                std::string text;
+                for (const std::string& file : files)
+                {
+                    std::ifstream in(file);
+                    text.append(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+                }
+                {
+                    std::unique_lock<std::mutex> lock(Mutex);
+                    ++NumCompiles[name];
+                    Opened.wait(lock, [&]() { return !Closed[name]; });
+                }
+                if (text.find("error") != std::string::npos)
+                {
+                    throw std::runtime_error(files[0] + "(1,1): error X3000: syntax error");
+                }
+                return ShaderReloadApply([this, name, text]()
+                {
+                    Current[name] = text;
+                    ApplyThread = std::this_thread::get_id();
+                });
+            };
+        }
+
+        void SetClosed(const std::string& name, bool closed)
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Closed[name] = closed;
+            Opened.notify_all();
+        }
+
+        uint32_t GetNumCompiles(const std::string& name)
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            return NumCompiles[name];
+        }
+    };
+
+    std::string GetEventNames(const std::vector<ShaderReloadEvent>& events)
+    {
+        std::vector<std::string> names;
+        for (const ShaderReloadEvent& event : events)
+        {
+            names.push_back(event.Program + (event.Succeeded ? "" : " (failed)"));
+        }
+        std::sort(names.begin(), names.end());
+        return JoinNames(names);
+    }
+
+    bool CheckShaderReloader(const std::string& dir, ThreadPool& pool)
+    {
+        bool passed = true;
+        std::printf("Reloader checks:\n");
+
+        std::filesystem::create_directories(dir + "/Reload");
+        std::string common = dir + "/Reload/Common.hlsli", blur = dir + "/Reload/Blur.hlsl", tonemap = dir + "/Reload/Tonemap.hlsl";
+        WriteFile(common, "common 1");
+        WriteFile(blur, "#include \"Common.hlsli\"\nblur 1");
+        WriteFile(tonemap, "tonemap 1");
+
+        // Two permutations of one file and another program
+        FakeShaderCompiler compiler;
+        ShaderReloader reloader(pool);
+        reloader.AddProgram("Blur_LOW", { blur }, compiler.Make("Blur_LOW", { blur }));
+        reloader.AddProgram("Blur_HIGH", { blur }, compiler.Make("Blur_HIGH", { blur }));
+        reloader.AddProgram("Tonemap", { tonemap }, compiler.Make("Tonemap", { tonemap }));
+
+        // A frame that starts the compiles, and the next one once they're done
+        auto update = [&]()
+        {
+            std::vector<ShaderReloadEvent> events = reloader.Update();
+            reloader.WaitForCompiles();
+            for (ShaderReloadEvent& event : reloader.Update())
+            {
+                events.push_back(std::move(event));
+            }
+            return events;
+        };
+
+        passed &= Check("nothing compiled up front", update().empty() && compiler.GetNumCompiles("Blur_LOW") == 0 && reloader.IsIdle());
+
+        reloader.OnFilesChanged({ common });
+        std::vector<ShaderReloadEvent> events = update();
+        passed &= Check("include changed: its permutations only", GetEventNames(events) == "Blur_HIGH Blur_LOW" &&
+            compiler.GetNumCompiles("Blur_LOW") == 1 && compiler.GetNumCompiles("Blur_HIGH") == 1 && compiler.GetNumCompiles("Tonemap") == 0,
+            GetEventNames(events));
+        passed &= Check("swapped in on the updating thread", compiler.Current["Blur_LOW"] == "#include \"Common.hlsli\"\nblur 1" &&
+            compiler.ApplyThread == std::this_thread::get_id() && reloader.IsIdle());
+
+        WriteFile(tonemap, "tonemap error");
+        reloader.OnFilesChanged({ tonemap });
+        events = update();
+        passed &= Check("compile error keeps the old one", GetEventNames(events) == "Tonemap (failed)" && Contains(events[0].Error, "X3000") &&
+            compiler.Current.count("Tonemap") == 0 && reloader.IsIdle(), events.empty() ? std::string() : events[0].Error);
+
+        // Changed again while compiling: the compile in flight is thrown away and the latest text wins
+        compiler.SetClosed("Tonemap", true);
+        WriteFile(tonemap, "tonemap 2");
+        reloader.OnFilesChanged({ tonemap });
+        uint32_t numCompiles = compiler.GetNumCompiles("Tonemap");
+        reloader.Update();
+        while (compiler.GetNumCompiles("Tonemap") == numCompiles)
+        {
+            std::this_thread::yield();
+        }
+        WriteFile(tonemap, "tonemap 3");
+        reloader.OnFilesChanged({ tonemap });
+        auto start = std::chrono::steady_clock::now();
+        events = reloader.Update();
+        double updateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        passed &= Check("update doesn't wait for compiles", events.empty() && updateMs < 50.0 && !reloader.IsIdle(),
+            std::to_string(updateMs) + " ms");
+        compiler.SetClosed("Tonemap", false);
+        events = update();
+        events = events.empty() ? update() : events;
+        ShaderReloadStats stats = reloader.GetStats();
+        passed &= Check("superseded compile discarded", GetEventNames(events) == "Tonemap" && compiler.Current["Tonemap"] == "tonemap 3" &&
+            compiler.GetNumCompiles("Tonemap") == 3 && stats.Discarded == 1, compiler.Current["Tonemap"]);
+        passed &= Check("stats", stats.Reloads == 3 && stats.Failed == 1 && stats.AverageLatencyMs > 0.0 &&
+            stats.MaxLatencyMs >= stats.AverageLatencyMs);
+        return passed;
+    }
+
+    int ShaderReload(int argc, char** argv)
+    {
+        uint32_t numThreads = std::max(1u, GetOption(argc, argv, 2, "--threads", 2));
+        uint32_t numEdits = std::max(1u, GetOption(argc, argv, 2, "--edits", 20));
+
+        std::string dir = "RuntimeBenchShaders";
+        std::filesystem::remove_all(dir);
+        ThreadPool pool(numThreads);
+
+        bool passed = CheckShaderIncludeGraph(dir + "/Graph");
+        passed &= CheckFileWatcher(dir + "/Watcher");
+        passed &= CheckShaderReloader(dir, pool);
+
+        // End to end through the watcher: edit a shared include, like saving it in an editor, and run frames until every
+        // program using it is swapped in
+        std::filesystem::create_directories(dir + "/Latency");
+        std::string common = dir + "/Latency/Common.hlsli";
+        WriteFile(common, "0");
+        FakeShaderCompiler compiler;
+        ShaderReloader reloader(pool);
+        const char* names[] = { "Opaque_PS", "Opaque_VS", "Shadow_VS", "Post_PS" };
+        for (const char* name : names)
+        {
+            std::string file = dir + "/Latency/" + name + ".hlsl";
+            WriteFile(file, std::string(name) == "Post_PS" ? "" : "#include \"Common.hlsli\"\n");
+            reloader.AddProgram(name, { file }, compiler.Make(name, { file, common }));
+        }
+        reloader.Watch();
+
+        std::printf("\nLatency: %u edits of an include used by 3 of 4 programs, %u compile threads, a frame every 1 ms\n", numEdits,
+            numThreads);
+        uint32_t numComplete = 0;
+        std::string detail;
+        for (uint32_t edit = 1; edit <= numEdits; ++edit)
+        {
+            WriteFile(common, std::to_string(edit));
+            std::vector<std::string> swapped;
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+            while (swapped.size() < 3 && std::chrono::steady_clock::now() < deadline)
+            {
+                for (const ShaderReloadEvent& event : reloader.Update())
+                {
+                    swapped.push_back(event.Program);
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            std::sort(swapped.begin(), swapped.end());
+            swapped.erase(std::unique(swapped.begin(), swapped.end()), swapped.end());
+            if (swapped == std::vector<std::string>({ "Opaque_PS", "Opaque_VS", "Shadow_VS" }))
+            {
+                ++numComplete;
+            }
+            else if (detail.empty())
+            {
+                detail = "edit " + std::to_string(edit) + ": " + JoinNames(swapped);
+            }
+        }
+        reloader.WaitForCompiles();
+        reloader.Update();
+
+        ShaderReloadStats stats = reloader.GetStats();
+        std::printf("  %llu reloads, %llu discarded, %.2f ms average latency (max %.2f), %.3f ms average compile\n",
+            static_cast<unsigned long long>(stats.Reloads), static_cast<unsigned long long>(stats.Discarded), stats.AverageLatencyMs,
+            stats.MaxLatencyMs, stats.AverageCompileMs);
+        std::printf("Latency checks:\n");
+        passed &= Check("every edit reloaded its programs", numComplete == numEdits, detail);
+        passed &= Check("unaffected program never compiled", compiler.GetNumCompiles("Post_PS") == 0);
+        passed &= Check("latest text swapped in", compiler.Current["Opaque_PS"] == "#include \"Common.hlsli\"\n" + std::to_string(numEdits));
+
+        std::filesystem::remove_all(dir);
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    // A material shader's permutations, the way a renderer would declare them: skinned or not, three lighting models,
+    // normal mapping only with lighting
+    enum class MaterialLighting : uint32_t { Unlit, Lambert, PBR, Count };
+
+    struct Skinned : ShaderFeatureBit { static constexpr const char* DEFINE = "SKINNED"; };
+    struct Lighting : ShaderFeatureEnum<MaterialLighting> { static constexpr const char* DEFINE = "LIGHTING"; };
+    struct NormalMap : ShaderFeatureBit { static constexpr const char* DEFINE = "NORMAL_MAP"; };
+
+    struct MaterialShader : ShaderPermutationSpace<MaterialShader, Skinned, Lighting, NormalMap>
+    {
+        static constexpr bool IsValid(Key key)
+        {
+            return !key.Get<NormalMap>() || key.Get<Lighting>() != MaterialLighting::Unlit;
+        }
+    };
+
+    // Checked by compiling
+    static_assert(MaterialShader::COUNT == 12 && MaterialShader::CountValid() == 10, "permutation counts");
+    static_assert(MaterialShader::GetStride<Skinned>() == 1 && MaterialShader::GetStride<Lighting>() == 2 &&
+        MaterialShader::GetStride<NormalMap>() == 6, "strides");
+    static_assert(MakeShaderKey<MaterialShader, true, MaterialLighting::PBR, true>().GetIndex() == 1 + 2 * 2 + 6, "key packing");
+    static_assert(MakeShaderKey<MaterialShader, true, MaterialLighting::PBR, true>().Get<Lighting>() == MaterialLighting::PBR &&
+        MakeShaderKey<MaterialShader, true, MaterialLighting::PBR, true>().Get<Skinned>(), "key unpacking");
+    static_assert(MakeShaderKey<MaterialShader, true, MaterialLighting::PBR, false>().With<Lighting>(MaterialLighting::Lambert).With<Skinned>(false)
+        == MakeShaderKey<MaterialShader, false, MaterialLighting::Lambert, false>(), "With");
+    static_assert(!IsValidShaderKey<MaterialShader, false, MaterialLighting::Unlit, true>(), "ruled out by IsValid");
+    static_assert(!IsValidShaderKey<MaterialShader, false, MaterialLighting::Count, false>(), "enum value out of range");
+    static_assert(!IsValidShaderKey<MaterialShader, 1, MaterialLighting::PBR, false>(), "int for a bool");
+    static_assert(!IsValidShaderKey<MaterialShader, false, MaterialLighting::PBR>(), "missing value");
+    static_assert(!IsValidShaderKey<MaterialShader, MaterialLighting::PBR, false, false>(), "values out of order");
+
+    // What the keys replace: the defines joined into a string and hashed on every lookup
+    std::string GetDefinesString(bool skinned, MaterialLighting lighting, bool normalMap)
+    {
+        return std::string("SKINNED=") + (skinned ? "1" : "0") + ";LIGHTING=" + std::to_string(static_cast<uint32_t>(lighting)) +
+            ";NORMAL_MAP=" + (normalMap ? "1" : "0");
+    }
+
+    bool CheckShaderPermutations()
+    {
+        bool passed = true;
+        std::printf("Permutation checks:\n");
+
+        std::vector<ShaderPermutation> permutations = GetShaderPermutations<MaterialShader>();
+        bool definesMatch = permutations.size() == 10;
+        for (const ShaderPermutation& permutation : permutations)
+        {
+            // The defines the compile gets have to describe the key the runtime looks up
+            MaterialShader::Key key = MaterialShader::Key::FromIndex(permutation.Index);
+            std::vector<std::pair<std::string, std::string>> expected = {
+                { "SKINNED", key.Get<Skinned>() ? "1" : "0" },
+                { "LIGHTING", std::to_string(static_cast<uint32_t>(key.Get<Lighting>())) },
+                { "NORMAL_MAP", key.Get<NormalMap>() ? "1" : "0" } };
+            definesMatch &= permutation.Defines == expected && MaterialShader::IsValid(key);
+        }
+        passed &= Check("offline list: valid ones, their defines", definesMatch, std::to_string(permutations.size()) + " permutations");
+        passed &= Check("offline file names", GetShaderPermutationFile("Material_PS", 11) == "Material_PS_11.cso");
+
+        bool roundTrip = true;
+        for (uint32_t i = 0; i < MaterialShader::COUNT; ++i)
+        {
+            MaterialShader::Key key = MaterialShader::Key::FromIndex(i);
+            roundTrip &= MaterialShader::MakeKey(key.Get<Skinned>(), key.Get<Lighting>(), key.Get<NormalMap>()) == key;
+        }
+        passed &= Check("runtime keys round trip", roundTrip);
+        passed &= Check("runtime out of range throws",
+            !GetError([]() { MaterialShader::MakeKey(false, static_cast<MaterialLighting>(3), false); }).empty() &&
+            !GetError([]() { MaterialShader::Key::FromIndex(MaterialShader::COUNT); }).empty());
+
+        ShaderPermutationTable<MaterialShader, std::string> table;
+        for (const ShaderPermutation& permutation : permutations)
+        {
+            table.Set(MaterialShader::Key::FromIndex(permutation.Index), GetShaderPermutationFile("Material_PS", permutation.Index));
+        }
+        constexpr MaterialShader::Key pbr = MakeShaderKey<MaterialShader, false, MaterialLighting::PBR, true>();
+        passed &= Check("table lookup", table.GetSize() == 10 && table.Get(pbr) == "Material_PS_10.cso" &&
+            table.Find(MaterialShader::MakeKey(false, MaterialLighting::Unlit, true)) == nullptr);
+        std::string error = GetError([&]() { table.Set(MaterialShader::MakeKey(true, MaterialLighting::Unlit, true), "x"); });
+        passed &= Check("table rejects ruled out keys", !error.empty() && table.GetSize() == 10, error);
+        ShaderPermutationTable<MaterialShader, std::string> empty;
+        passed &= Check("missing entry throws", !GetError([&]() { empty.Get(pbr); }).empty() && !empty.Contains(pbr));
+        return passed;
+    }
+
+    int Permutations(int argc, char** argv)
+    {
+        uint32_t numLookups = std::max(1u, GetOption(argc, argv, 2, "--lookups", 1000000));
+        bool list = false;
+        for (int i = 2; i < argc; ++i)
+        {
+            list |= std::strcmp(argv[i], "--list") == 0;
+        }
+
+        if (list)
+        {
+            // What the offline build runs, one FXC call per permutation
+            for (const ShaderPermutation& permutation : GetShaderPermutations<MaterialShader>())
+            {
+                std::string defines;
+                for (const auto& define : permutation.Defines)
+                {
+                    defines += " /D " + define.first + "=" + define.second;
+                }
+                std::printf("fxc /T ps_5_1 /E main%s /Fo %s Shaders/Material_PS.hlsl\n", defines.c_str(),
+                    GetShaderPermutationFile("Material_PS", permutation.Index).c_str());
+            }
+            return 0;
+        }
+
+        bool passed = CheckShaderPermutations();
+
+        // The same fake bytecode found both ways, for the same random permutations
+        std::mt19937 random(7);
+        std::vector<std::tuple<bool, MaterialLighting, bool>> requests;
+        for (uint32_t i = 0; i < 4096; ++i)
+        {
+            MaterialLighting lighting = static_cast<MaterialLighting>(random() % 3);
+            requests.emplace_back(random() % 2 != 0, lighting, lighting != MaterialLighting::Unlit && random() % 2 != 0);
+        }
+
+        std::unordered_map<std::string, std::vector<uint8_t>> byDefines;
+        ShaderPermutationTable<MaterialShader, std::vector<uint8_t>> byKey;
+        for (const ShaderPermutation& permutation : GetShaderPermutations<MaterialShader>())
+        {
+            MaterialShader::Key key = MaterialShader::Key::FromIndex(permutation.Index);
+            std::vector<uint8_t> bytecode(64, static_cast<uint8_t>(permutation.Index));
+            byDefines[GetDefinesString(key.Get<Skinned>(), key.Get<Lighting>(), key.Get<NormalMap>())] = bytecode;
+            byKey.Set(key, bytecode);
+        }
+
+        uint64_t checksum[2] = {};
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < numLookups; ++i)
+        {
+            const auto& request = requests[i % requests.size()];
+            checksum[0] += byDefines.at(GetDefinesString(std::get<0>(request), std::get<1>(request), std::get<2>(request)))[0];
+        }
+        double stringNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / numLookups;
+        start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < numLookups; ++i)
+        {
+            const auto& request = requests[i % requests.size()];
+            checksum[1] += byKey.Get(MaterialShader::MakeKey(std::get<0>(request), std::get<1>(request), std::get<2>(request)))[0];
+        }
+        double keyNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / numLookups;
+
+        std::printf("\nLookup: %u random permutations of %u\n", numLookups, MaterialShader::CountValid());
+        std::printf("  defines string + hash map : %.1f ns\n", stringNs);
+        std::printf("  key + dense table         : %.1f ns\n", keyNs);
+        passed &= Check("both find the same bytecode", checksum[0] == checksum[1]);
+
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    int Resize(int argc, char** argv)
+    {
+        uint32_t numFrames = std::max(1u, GetOption(argc, argv, 2, "--frames", 1000));
+        uint32_t maxEvents = GetOption(argc, argv, 2, "--events", 8);
+
+        using Clock = ResizeCoalescer::Clock;
+        const Clock::time_point start = Clock::now();
+        auto at = [start](uint32_t ms) { return start + std::chrono::milliseconds(ms); };
+
+        bool passed = true;
+        std::printf("Coalescing\n");
+        {
+            ResizeCoalescer coalescer;
+            uint32_t width = 0;
+            uint32_t height = 0;
+            passed &= Check("nothing pending", !coalescer.ConsumePending(1280, 720, width, height));
+
+            // A border drag: a burst of sizes within one frame turns into one resize to the last of them
+            for (uint32_t i = 0; i < 100; ++i)
+            {
+                coalescer.OnSize(1280 + i, 720 + i / 2, at(i));
+            }
+            bool resized = coalescer.ConsumePending(1280, 720, width, height);
+            passed &= Check("burst resizes once", resized && width == 1379 && height == 769,
+                std::to_string(width) + "x" + std::to_string(height));
+            passed &= Check("consumed", !coalescer.ConsumePending(1379, 769, width, height));
+            coalescer.OnResized(at(150));
+
+            // Latency runs from the first event of the burst
+            ResizeCoalescer::Stats stats = coalescer.GetStats();
+            passed &= Check("burst counted", stats.NumEvents == 100 && stats.NumResizes == 1);
+            passed &= Check("latency from the first event", std::abs(stats.LastLatencyMs - 150.0) < 1e-6,
+                std::to_string(stats.LastLatencyMs) + " ms");
+
+            // The same size again, and dragged away and back before the frame, leave the swap chain alone
+            coalescer.OnSize(1379, 769, at(200));
+            passed &= Check("same size is a no-op", !coalescer.ConsumePending(1379, 769, width, height));
+            coalescer.OnSize(1600, 900, at(210));
+            coalescer.OnSize(1379, 769, at(211));
+            passed &= Check("dragged back is a no-op", !coalescer.ConsumePending(1379, 769, width, height));
+
+            // Minimized: 0x0 (or one zero side) keeps the old buffers, restoring to the old size is a no-op too
+            coalescer.OnSize(0, 0, at(300));
+            coalescer.OnSize(0, 769, at(301));
+            coalescer.OnSize(1379, 0, at(302));
+            passed &= Check("minimized is ignored", !coalescer.ConsumePending(1379, 769, width, height));
+            coalescer.OnSize(1379, 769, at(400));
+            passed &= Check("restored to the same size is a no-op", !coalescer.ConsumePending(1379, 769, width, height));
+
+            // Minimizing in the middle of a drag keeps the size dragged to
+            coalescer.OnSize(800, 600, at(500));
+            coalescer.OnSize(0, 0, at(501));
+            resized = coalescer.ConsumePending(1379, 769, width, height);
+            passed &= Check("minimized mid drag keeps the drag", resized && width == 800 && height == 600,
+                std::to_string(width) + "x" + std::to_string(height));
+            coalescer.OnResized(at(550));
+
+            stats = coalescer.GetStats();
+            passed &= Check("no-ops aren't resizes", stats.NumEvents == 109 && stats.NumResizes == 2,
+                std::to_string(stats.NumEvents) + " events, " + std::to_string(stats.NumResizes) + " resizes");
+            passed &= Check("latency stats", std::abs(stats.LastLatencyMs - 50.0) < 1e-6 &&
+                std::abs(stats.MaxLatencyMs - 150.0) < 1e-6 && std::abs(stats.AverageLatencyMs - 100.0) < 1e-6,
+                "last " + std::to_string(stats.LastLatencyMs) + ", max " + std::to_string(stats.MaxLatencyMs) +
+                ", average " + std::to_string(stats.AverageLatencyMs) + " ms");
+            passed &= Check("no resizes, no latency", ResizeCoalescer().GetStats().AverageLatencyMs == 0.0);
+        }
+
+        // A synthetic event source: 0 to --events sizes early in each 16 ms frame, some of them minimizes or repeats,
+        // applied at the start of the next frame like the render loop does
+        std::printf("Dragging for %u frames\n", numFrames);
+        {
+            ResizeCoalescer coalescer;
+            std::mt19937 random(3);
+            uint32_t currentWidth = 1280;
+            uint32_t currentHeight = 720;
+            uint32_t lastWidth = currentWidth;
+            uint32_t lastHeight = currentHeight;
+            uint32_t numEvents = 0;
+            uint32_t expectedResizes = 0;
+            bool wrongSize = false;
+            double maxLatencyMs = 0.0;
+            for (uint32_t frame = 0; frame < numFrames; ++frame)
+            {
+                uint32_t frameStart = frame * 16;
+                uint32_t firstEvent = 0;
+                bool pending = false;
+                uint32_t count = maxEvents > 0 ? random() % (maxEvents + 1) : 0;
+                uint32_t eventTime = frameStart + random() % 8;
+                for (uint32_t i = 0; i < count; ++i, eventTime += random() % 2)
+                {
+                    uint32_t width = random() % 8 == 0 ? 0 : 1200 + random() % 3 * 40;
+                    uint32_t height = width == 0 ? 0 : 700 + random() % 2 * 20;
+                    coalescer.OnSize(width, height, at(eventTime));
+                    ++numEvents;
+                    if (width != 0)
+                    {
+                        firstEvent = pending ? firstEvent : eventTime;
+                        pending = true;
+                        lastWidth = width;
+                        lastHeight = height;
+                    }
+                }
+
+                uint32_t width = 0;
+                uint32_t height = 0;
+                bool resized = coalescer.ConsumePending(currentWidth, currentHeight, width, height);
+                bool expected = lastWidth != currentWidth || lastHeight != currentHeight;
+                wrongSize |= resized != expected || (resized && (width != lastWidth || height != lastHeight));
+                if (resized)
+                {
+                    currentWidth = width;
+                    currentHeight = height;
+                    coalescer.OnResized(at(frameStart + 16));
+                    maxLatencyMs = std::max(maxLatencyMs, double(frameStart + 16 - firstEvent));
+                    ++expectedResizes;
+                }
+            }
+
+            ResizeCoalescer::Stats stats = coalescer.GetStats();
+            std::printf("  %u events, %u resizes, latency %.1f ms average, %.1f ms max\n",
+                stats.NumEvents, stats.NumResizes, stats.AverageLatencyMs, stats.MaxLatencyMs);
+            passed &= Check("every event counted", stats.NumEvents == numEvents);
+            passed &= Check("one resize a frame, to the latest size", !wrongSize && stats.NumResizes == expectedResizes);
+            passed &= Check("max latency from the first event", std::abs(stats.MaxLatencyMs - maxLatencyMs) < 1e-6,
+                std::to_string(stats.MaxLatencyMs) + " ms");
+        }
+
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    int RenderThreadBench(int argc, char** argv)
+    {
+        uint32_t numEvents = std::max(1u, GetOption(argc, argv, 2, "--events", 100000));
+
+        bool passed = true;
+        std::printf("SPSCQueue\n");
+        {
+            SPSCQueue<uint32_t, 8> queue;
+            uint32_t item = 0;
+            passed &= Check("empty pops nothing", !queue.TryPop(item) && queue.Size() == 0);
+
+            // Round the ring a few times, full and empty each time
+            bool fifo = true;
+            bool full = true;
+            uint32_t next = 0;
+            uint32_t expected = 0;
+            for (uint32_t round = 0; round < 5; ++round)
+            {
+                for (uint32_t i = 0; i < 8; ++i)
+                {
+                    full &= queue.TryPush(next++);
+                }
+                full &= !queue.TryPush(1000) && queue.Size() == 8;
+
+                // One slot back makes room for exactly one more
+                fifo &= queue.TryPop(item) && item == expected++;
+                full &= queue.TryPush(next++) && !queue.TryPush(1000);
+
+                while (queue.TryPop(item))
+                {
+                    fifo &= item == expected++;
+                }
+                fifo &= queue.Size() == 0;
+            }
+            passed &= Check("full refuses, one pop makes one slot", full);
+            passed &= Check("first in first out across wraps", fifo && expected == next, std::to_string(expected) + " popped");
+
+            // Two threads with a small ring, so both the full and the empty paths get hit all the time
+            SPSCQueue<uint32_t, 16> shared;
+            std::atomic<uint64_t> fullSpins{ 0 };
+            std::thread producer([&]()
+            {
+                uint64_t spins = 0;
+                for (uint32_t i = 0; i < numEvents; ++i)
+                {
+                    while (!shared.TryPush(i))
+                    {
+                        ++spins;
+                        std::this_thread::yield();
+                    }
+                }
+                fullSpins = spins;
+            });
+            uint32_t received = 0;
+            bool inOrder = true;
+            uint64_t emptySpins = 0;
+            while (received < numEvents)
+            {
+                if (shared.TryPop(item))
+                {
+                    inOrder &= item == received++;
+                }
+                else
+                {
+                    ++emptySpins;
+                    std::this_thread::yield();
+                }
+            }
+            producer.join();
+            passed &= Check("two threads, every item once in order", inOrder && !shared.TryPop(item),
+                std::to_string(fullSpins.load()) + " full, " + std::to_string(emptySpins) + " empty");
+        }
+
+        std::printf("Overflow resize\n");
+        {
+            // Not started, so this thread is both the window and the render thread and decides when the queue drains
+            std::vector<WindowEvent> handled;
+            RenderThread* self = nullptr;
+            bool postFromHandler = false;
+            RenderThread renderThread([&](const WindowEvent& event)
+            {
+                handled.push_back(event);
+                if (postFromHandler)
+                {
+                    // A slot just came free, a newer resize that makes it into the queue replaces the parked one
+                    postFromHandler = false;
+                    self->PostEvent(WindowEventType::Resize, 640, 480);
+                }
+            }, []() {});
+            self = &renderThread;
+
+            auto fill = [&]()
+            {
+                for (uint32_t i = 0; i < RenderThread::EVENT_QUEUE_SIZE; ++i)
+                {
+                    renderThread.PostEvent(WindowEventType::KeyDown, i);
+                }
+            };
+            auto lastResize = [&](const WindowEvent*& last, uint32_t& count)
+            {
+                last = nullptr;
+                count = 0;
+                for (const WindowEvent& event : handled)
+                {
+                    if (event.Type == WindowEventType::Resize)
+                    {
+                        last = &event;
+                        ++count;
+                    }
+                }
+            };
+
+            const WindowEvent* last = nullptr;
+            uint32_t count = 0;
+            fill();
+            bool dropped = !renderThread.PostEvent(WindowEventType::Resize, 1920, 1080);
+            renderThread.ProcessEvents();
+            lastResize(last, count);
+            passed &= Check("dropped resize is kept", dropped && count == 1 && handled.back().Type == WindowEventType::Resize &&
+                last->Param0 == 1920 && last->Param1 == 1080);
+            passed &= Check("the queue drained first", handled.size() == RenderThread::EVENT_QUEUE_SIZE + 1 &&
+                handled[RenderThread::EVENT_QUEUE_SIZE - 1].Param0 == RenderThread::EVENT_QUEUE_SIZE - 1);
+
+            // Minimized while the queue is full, the 0x0 mustn't read as an empty slot
+            handled.clear();
+            fill();
+            renderThread.PostEvent(WindowEventType::Resize, 0, 0);
+            renderThread.ProcessEvents();
+            lastResize(last, count);
+            passed &= Check("dropped 0x0 is kept", count == 1 && last->Param0 == 0 && last->Param1 == 0);
+
+            // Two dropped resizes, only the newer one arrives
+            handled.clear();
+            fill();
+            renderThread.PostEvent(WindowEventType::Resize, 800, 600);
+            renderThread.PostEvent(WindowEventType::Resize, 65535, 65535);
+            renderThread.ProcessEvents();
+            lastResize(last, count);
+            passed &= Check("newer dropped resize wins", count == 1 && last->Param0 == 65535 && last->Param1 == 65535);
+
+            // A newer resize that fits in the queue clears the parked one, the stale size never comes after it
+            handled.clear();
+            fill();
+            renderThread.PostEvent(WindowEventType::Resize, 1024, 768);
+            postFromHandler = true;
+            renderThread.ProcessEvents();
+            lastResize(last, count);
+            passed &= Check("queued resize supersedes the parked one", count == 1 && last->Param0 == 640 && last->Param1 == 480);
+
+            handled.clear();
+            renderThread.ProcessEvents();
+            passed &= Check("nothing parked afterwards", handled.empty());
+
+            RenderThreadStats stats = renderThread.GetStats();
+            uint64_t posted = 4 * (RenderThread::EVENT_QUEUE_SIZE + 1) + 2;
+            passed &= Check("stats", stats.EventsPosted == posted && stats.EventsDropped == 5 &&
+                stats.EventsProcessed == posted - 5 && stats.NumFrames == 0,
+                std::to_string(stats.EventsPosted) + " posted, " + std::to_string(stats.EventsDropped) + " dropped, " +
+                std::to_string(stats.EventsProcessed) + " processed");
+        }
+
+        std::printf("Window thread and render thread, %u events\n", numEvents);
+        {
+            // The window thread posts key presses numbered in order and a resize every so often, the render thread
+            // stalls now and then (a long Present) so the queue overflows
+            std::vector<uint32_t> keys;
+            uint32_t lastWidth = 0;
+            uint32_t lastHeight = 0;
+            std::atomic<bool> exitPosted{ false };
+            std::atomic<uint32_t> exitCalls{ 0 };
+            std::atomic<uint64_t> framesAtExit{ 0 };
+            std::atomic<uint64_t> frames{ 0 };
+            std::atomic<bool> framesAfterExit{ false };
+            std::thread::id frameThread;
+            std::thread::id exitThread;
+
+            RenderThread renderThread([&](const WindowEvent& event)
+            {
+                if (event.Type == WindowEventType::KeyDown)
+                {
+                    keys.push_back(event.Param0);
+                }
+                else if (event.Type == WindowEventType::Resize)
+                {
+                    lastWidth = event.Param0;
+                    lastHeight = event.Param1;
+                }
+            }, [&]()
+            {
+                frameThread = std::this_thread::get_id();
+                framesAfterExit = framesAfterExit || exitCalls > 0;
+                uint64_t frame = frames++;
+                std::this_thread::sleep_for(std::chrono::microseconds(frame % 50 == 0 ? 5000 : 100));
+            }, [&]()
+            {
+                exitThread = std::this_thread::get_id();
+                framesAtExit = frames.load();
+                ++exitCalls;
+                exitPosted = true; // PostMessage back to the window thread
+            });
+            renderThread.Start();
+
+            std::mt19937 random(5);
+            uint32_t postedWidth = 0;
+            uint32_t postedHeight = 0;
+            uint32_t key = 0;
+            for (uint32_t i = 0; i < numEvents; ++i)
+            {
+                if (random() % 64 == 0)
+                {
+                    // Now and then a minimize
+                    postedWidth = random() % 4 == 0 ? 0 : 640 + random() % 1280;
+                    postedHeight = postedWidth == 0 ? 0 : 360 + random() % 720;
+                    renderThread.PostEvent(WindowEventType::Resize, postedWidth, postedHeight);
+                }
+                else
+                {
+                    renderThread.PostEvent(WindowEventType::KeyDown, key++);
+                }
+                if (i % 4096 == 0)
+                {
+                    std::this_thread::sleep_for(std::chrono::microseconds(500));
+                }
+            }
+            // The last one is always a resize, so a drop at the end would show
+            postedWidth = 0;
+            postedHeight = 0;
+            renderThread.PostEvent(WindowEventType::Resize, postedWidth, postedHeight);
+
+            // Give the render thread a frame or two to catch up, then shut down like WM_CLOSE: request the stop and
+            // keep pumping (here, posting) until the exit function says it's done, only then join
+            uint64_t stopFrame = frames.load() + 2;
+            while (frames.load() < stopFrame)
+            {
+                std::this_thread::yield();
+            }
+            RenderThreadStats stats = renderThread.GetStats(); // every event posted so far has been through ProcessEvents
+            renderThread.RequestStop();
+            uint32_t pumped = 0;
+            while (!exitPosted)
+            {
+                renderThread.PostEvent(WindowEventType::MouseMove, pumped++, 0);
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+            while (!renderThread.HasExited())
+            {
+                std::this_thread::yield();
+            }
+            renderThread.Join();
+
+            uint64_t numFrames = renderThread.GetStats().NumFrames;
+            std::printf("  %llu frames, %llu events posted, %llu dropped, latency %.3f ms average, %.3f ms max\n",
+                static_cast<unsigned long long>(numFrames), static_cast<unsigned long long>(stats.EventsPosted),
+                static_cast<unsigned long long>(stats.EventsDropped), stats.AverageEventLatencyMs, stats.MaxEventLatencyMs);
+
+            bool ordered = std::is_sorted(keys.begin(), keys.end()) && std::adjacent_find(keys.begin(), keys.end()) == keys.end();
+            passed &= Check("keys in order, none twice", ordered && (keys.empty() || keys.back() < key),
+                std::to_string(keys.size()) + " of " + std::to_string(key) + " arrived");
+            passed &= Check("last resize arrived", lastWidth == postedWidth && lastHeight == postedHeight,
+                std::to_string(lastWidth) + "x" + std::to_string(lastHeight));
+            passed &= Check("posted = processed + dropped", stats.EventsPosted == stats.EventsProcessed + stats.EventsDropped);
+            passed &= Check("exit ran once, on the render thread", exitCalls == 1 && exitThread == frameThread &&
+                exitThread != std::this_thread::get_id());
+            passed &= Check("no frame after the exit", !framesAfterExit && framesAtExit == numFrames,
+                std::to_string(numFrames) + " frames, " + std::to_string(pumped) + " events pumped during the stop");
+        }
+
+        std::printf("Exception in a frame\n");
+        {
+            std::atomic<bool> exited{ false };
+            RenderThread renderThread(nullptr, []() { throw std::runtime_error("device removed"); }, [&]() { exited = true; });
+            renderThread.Start();
+            while (!renderThread.HasExited())
+            {
+                std::this_thread::yield();
+            }
+            std::string error = GetError([&]() { renderThread.Join(); });
+            passed &= Check("exit still runs, Join rethrows", exited && error == "device removed", error);
+            passed &= Check("rethrown once", GetError([&]() { renderThread.Join(); }).empty());
+        }
+
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+
+    // Stands in for a D3D call, out of line so the check can't be folded into it
+    HELPERS_NOINLINE HRESULT FakeD3DCall(const std::vector<HRESULT>& results, size_t i)
+    {
+        return results[i];
+    }
+
+    // ThrowIfFailed the way it was before, with the throw expression at every call site
+    inline void ThrowIfFailedInlineThrow(HRESULT hr)
+    {
+        if (FAILED(hr))
+        {
+            throw std::runtime_error("HRESULT " + std::to_string(hr));
+        }
+    }
+
+    int ThrowBench(int argc, char** argv)
+    {
+        uint32_t numCalls = std::max(1u, GetOption(argc, argv, 2, "--calls", 10000000));
+
+        bool passed = true;
+        std::printf("ThrowIfFailed\n");
+        {
+            std::string error = GetError([]() { ThrowIfFailed(S_OK); ThrowIfFailed(HRESULT(1)); }); // S_FALSE succeeds too
+            passed &= Check("success doesn't throw", error.empty(), error);
+            int line = __LINE__ + 1;
+            error = GetError([]() { ThrowIfFailed(HRESULT(0x80004005)); }); // E_FAIL
+            bool located = error.find("RuntimeBench.cpp") != std::string::npos && error.find(std::to_string(line)) != std::string::npos;
+            passed &= Check("failure throws with file and line", located, error);
+        }
+
+        // Successes only, S_OK and S_FALSE mixed so the values aren't constant
+        std::vector<HRESULT> results(4096);
+        std::mt19937 random(1);
+        for (HRESULT& result : results)
+        {
+            result = HRESULT(random() % 2);
+        }
+
+        // Each variant checks every result, the sum keeps the calls alive
+        auto time = [&](const char* name, auto check)
+        {
+            uint64_t sum = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < numCalls; ++i)
+            {
+                HRESULT hr = FakeD3DCall(results, i & 4095);
+                check(hr);
+                sum += uint64_t(hr);
+            }
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / numCalls;
+            std::printf("  %-40s : %.2f ns per call (%llu)\n", name, ns, static_cast<unsigned long long>(sum));
+            return ns;
+        };
+
+        std::printf("Success path, %u calls\n", numCalls);
+        double unchecked = time("unchecked", [](HRESULT) {});
+        double outOfLine = time("ThrowIfFailed", [](HRESULT hr) { ThrowIfFailed(hr); });
+        double inlineThrow = time("throw at the call site", [](HRESULT hr) { ThrowIfFailedInlineThrow(hr); });
+        std::printf("  ThrowIfFailed adds %.2f ns per call, a throw at the call site %.2f ns\n", outOfLine - unchecked,
+            inlineThrow - unchecked);
+
+        std::printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+        return passed ? 0 : 1;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        if (argc >= 2 && std::strcmp(argv[1], "pacing") == 0)
+        {
+            return Pacing(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "latency") == 0)
+        {
+            return Latency(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "drs") == 0)
+        {
+            return DynamicResolution(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "validate") == 0)
+        {
+            return Validate(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "config") == 0)
+        {
+            return Config(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "scenario") == 0)
+        {
+            return Scenario(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "multigpu") == 0)
+        {
+            return MultiGPU(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "renderpass") == 0)
+        {
+            return RenderPass(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "instancing") == 0)
+        {
+            return Instancing(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "videodecode") == 0)
+        {
+            return VideoDecode(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "capture") == 0)
+        {
+            return Capture(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "readback") == 0)
+        {
+            return Readback(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "gpumemory") == 0)
+        {
+            return GPUMemory(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "shaderreload") == 0)
+        {
+            return ShaderReload(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "permutations") == 0)
+        {
+            return Permutations(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "resize") == 0)
+        {
+            return Resize(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "renderthread") == 0)
+        {
+            return RenderThreadBench(argc, argv);
+        }
+        if (argc >= 2 && std::strcmp(argv[1], "throwbench") == 0)
+        {
+            return ThrowBench(argc, argv);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+    }
+
+    PrintUsage();
+    return 1;
+}